@@ -0,0 +1,81 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__ARCHIVE_MANIFEST_H__
+#define __TBF__ARCHIVE_MANIFEST_H__
+
+#include <Windows.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "classifier.h"
+
+struct tbf_archive_entry_s {
+  uint32_t          checksum;
+  uint32_t          fileno;
+  uint32_t          size;
+  tbf_load_method_t method;
+};
+
+struct tbf_archive_scan_s {
+  std::wstring                       path;
+  uint64_t                           size          = 0ULL;
+  uint64_t                           last_write    = 0ULL; // FILETIME
+
+  bool                               cached        = false;
+  bool                               valid         = false;
+
+  std::vector <tbf_archive_entry_s>  entries;
+};
+
+//
+// Archive manifest: remembers the texture entries of every .7z archive keyed
+//   by its path, size and last-write time, so that unchanged archives do not
+//     have to have their headers re-parsed on every launch.
+//
+class TBF_ArchiveManifest
+{
+public:
+  bool load (const wchar_t* wszFileName);
+
+  // Every valid scan, whether it came from the manifest or was just parsed
+  static bool save (const wchar_t* wszFileName, const std::vector <tbf_archive_scan_s>& scans);
+
+  // Hands the remembered entries to every scan whose archive is unchanged
+  //   and returns the ones that still have to be parsed, in order
+  std::vector <tbf_archive_scan_s*> apply (std::vector <tbf_archive_scan_s>& scans);
+
+  size_t size (void) const { return archives_.size (); }
+
+protected:
+  static const uint32_t MAGIC        = 0x4D464254UL; // 'TBFM'
+  static const uint32_t VERSION      = 1UL;
+
+  static const uint32_t MAX_PATH_LEN = 260UL;        // MAX_PATH
+
+private:
+  std::unordered_map <std::wstring, tbf_archive_scan_s> archives_;
+};
+
+#endif /* __TBF__ARCHIVE_MANIFEST_H__ */
@@ -0,0 +1,129 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__CALL_TRACE_H__
+#define __TBF__CALL_TRACE_H__
+
+#include <Windows.h>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "trace_format.h"
+
+//
+// The D3D9 calls the render hooks intercept, in the order the game made them,
+//   with what the hooks saw (shader CRCs and texture checksums rather than
+//     pointers) and how long each detour took, original call included.
+//
+//   Capture is armed from the console ("Render.TraceFrames 300") and ends by
+//     itself after that many frames; TBFix_Res\traces\trace_<tick>.bin, in
+//       the format described in trace_format.h.
+//
+class TBF_CallRecorder
+{
+public:
+  // Starts writing on the calling thread's next frame; only calls made by
+  //   that thread are recorded.
+  bool     begin     (const wchar_t* wszFileName, int frames);
+  void     end       (void);
+
+  // Once per frame from the render thread; flushes and counts down
+  void     endFrame  (uint32_t frame);
+
+  bool     active    (void) const { return active_;  }
+  uint64_t records   (void) const { return written_; }
+
+  void     record    ( tbf_trace_op op,    uint8_t  flags, uint16_t slot,
+                       LONGLONG     start, uint32_t arg0,
+                                           uint32_t arg1,  uint32_t arg2 );
+
+protected:
+  // Written at the end of every frame, or whenever this many are pending
+  static const size_t   MAX_PENDING = 65536;
+
+  void flush (void);
+
+private:
+  bool                              active_   = false;
+  DWORD                             tid_      = 0;
+  int                               frames_   = 0;
+
+  FILE*                             fTrace_   = nullptr;
+  LONGLONG                          origin_   = 0;
+  LONGLONG                          last_eof_ = 0;
+  uint64_t                          written_  = 0;
+
+  std::vector <tbf_trace_record_s>  pending_;
+};
+
+
+//
+// Times a detour from construction to destruction and records it, provided
+//   the recorder was running when the detour was entered. Costs one branch
+//     when it is not.
+//
+class TBF_TraceScope
+{
+public:
+  TBF_TraceScope ( TBF_CallRecorder& recorder,
+                   tbf_trace_op      op,
+                   uint16_t          slot = 0,
+                   uint32_t          arg0 = 0,
+                   uint32_t          arg1 = 0,
+                   uint32_t          arg2 = 0 ) : recorder_ (recorder)
+  {
+    armed_ = recorder.active ();
+
+    if (armed_)
+    {
+      LARGE_INTEGER now;
+      QueryPerformanceCounter (&now);
+
+      start_    = now.QuadPart;
+      op_       = op;
+      slot_     = slot;
+      args_ [0] = arg0; args_ [1] = arg1; args_ [2] = arg2;
+    }
+  }
+
+  ~TBF_TraceScope (void)
+  {
+    if (armed_)
+      recorder_.record (op_, flags_, slot_, start_, args_ [0], args_ [1], args_ [2]);
+  }
+
+  void arg  (int idx, uint32_t val) { args_ [idx]  = val;  }
+  void flag (uint8_t       flags)   { flags_      |= flags; }
+
+private:
+  TBF_CallRecorder& recorder_;
+  bool              armed_;
+
+  LONGLONG          start_    = 0;
+  tbf_trace_op      op_       = tbf_trace_op::EndFrame;
+  uint8_t           flags_    = 0;
+  uint16_t          slot_     = 0;
+  uint32_t          args_ [3] = { 0, 0, 0 };
+};
+
+#endif /* __TBF__CALL_TRACE_H__ */
@@ -0,0 +1,88 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__CLASSIFIER_H__
+#define __TBF__CLASSIFIER_H__
+
+#include <Windows.h>
+#include <cstdint>
+#include <unordered_map>
+
+enum tbf_load_method_t {
+  Streaming,
+  Blocking,
+  DontCare
+};
+
+//
+// Decides, per checksum, whether an injected texture should block or stream
+//   based on how it behaved in earlier sessions rather than which folder or
+//     archive it came from:
+//
+//    * Time from base texture creation to its first bind
+//    * Whether that first bind happened before the override was ready
+//        (pop-in for a streamed texture, a stall for a blocking one)
+//
+struct tbf_load_stats_s {
+  float    binds        = 0.0f;  // Decayed count of measured first binds
+  float    early_binds  = 0.0f;  //   ... of which the override was not ready
+  float    avg_delay_ms = 0.0f;  // Mean creation -> first bind
+};
+
+class TBF_LoadClassifier
+{
+public:
+  bool load          (const wchar_t* wszFileName);
+  bool save          (const wchar_t* wszFileName);
+
+  void firstBind     (uint32_t checksum, float delay_ms, bool override_ready);
+
+  // Returns the method to use; urgent loads go to the front of the queue
+  tbf_load_method_t
+       classify      (uint32_t checksum, tbf_load_method_t authored, bool* urgent) const;
+
+  // Folds this session's measurements into the persisted ones
+  void commitSession (void);
+
+  size_t numUpgraded   (void) const { return upgraded_;   }
+  size_t numDowngraded (void) const { return downgraded_; }
+
+protected:
+  static const uint32_t MAGIC   = 0x43464254UL; // 'TBFC'
+  static const uint32_t VERSION = 1UL;
+
+  static const float    MIN_BINDS;          // Not enough evidence below this
+  static const float    UPGRADE_EARLY;      // Streaming  -> Blocking
+  static const float    URGENT_EARLY;       // Streaming, but ahead of the queue
+  static const float    DOWNGRADE_EARLY;    // Blocking   -> Streaming ...
+  static const float    DOWNGRADE_DELAY_MS; //   ... if first used this late
+  static const float    DECAY;
+
+private:
+  std::unordered_map <uint32_t, tbf_load_stats_s> history_;
+  std::unordered_map <uint32_t, tbf_load_stats_s> session_;
+
+  mutable size_t                                  upgraded_   = 0;
+  mutable size_t                                  downgraded_ = 0;
+};
+
+#endif /* __TBF__CLASSIFIER_H__ */
@@ -82,6 +82,7 @@ struct tbf_config_t
     int32_t   env_shadow_rescale  =  1;
     bool      half_float_shadows  = false;
     bool      dump_shaders        = false;
+    bool      inject_shaders      = true; // TBFix_Res\inject\shaders
     bool      force_post_mips     = true; // Mipmap generation on post-processing
     bool      fix_map_res         = true;
     bool      high_res_reflection = false;
@@ -90,6 +91,11 @@ struct tbf_config_t
     bool      auto_apply_changes  = false;
 
     bool      validation          = false;
+    bool      filter_state        = true; // Drop redundant Set*State calls (once state blocks are hooked)
+
+    bool      adaptive_quality    = false; // Scale render targets to hold a framerate
+    float     adaptive_target_fps = 60.0f;
+    int       adaptive_max_steps  = 4;
 
     struct {
       int     quality_preset        =     3;
@@ -137,6 +143,13 @@ struct tbf_config_t
     bool     clamp_text_coords   =  false;
     bool     keep_ui_sharp       =  true;
     bool     highlight_debug_tex =  true;
+    bool     hot_reload          =  true;
+    bool     dump_to_pack        =  false;
+    bool     predictive_prefetch =  true;
+    int32_t  staging_budget_mib  =  256L;
+    bool     warm_start          =  true;
+    bool     resident_blocking   =  false;
+    bool     adaptive_loading    =  true;
   } textures;
 
   struct {
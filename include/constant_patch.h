@@ -0,0 +1,181 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__CONSTANT_PATCH_H__
+#define __TBF__CONSTANT_PATCH_H__
+
+#include <cstdint>
+#include <cstring>
+
+#include "governor.h"
+
+//
+// Vertex shader register c240 carries 1 / render target size for shadow and
+//   post-processing passes. Every value the game can upload there for a
+//     target we resize is known once the resolution and quality settings
+//       are, so they are looked up by exact bit pattern instead of compared
+//         against each candidate on every upload.
+//
+struct tbf_vs_patch_s {
+  enum kind_e : uint32_t {
+    ModelShadow = 1,
+    PostProcess = 2,
+    EnvShadow   = 3
+  }        kind;
+  float    data [2];              // Replaces c240.xy, .zw become 0
+};
+
+class TBF_ConstantPatchTable
+{
+public:
+  static const size_t SLOTS = 32; // Power of two, at least twice the patterns
+
+  TBF_ConstantPatchTable (void) { clear (); }
+
+  void clear (void)
+  {
+    for (auto& slot : slots_)
+      slot.used = false;
+
+    width_ = height_ = 0;
+  }
+
+  // Whether the table was built for this resolution and these settings
+  bool current (uint32_t width, uint32_t height, const tbf_quality_s& q) const
+  {
+    return width_               == width                       &&
+           height_              == height                      &&
+           q.shadow_rescale     == quality_.shadow_rescale     &&
+           q.env_shadow_rescale == quality_.env_shadow_rescale &&
+           q.postproc_ratio     == quality_.postproc_ratio;
+  }
+
+  // Every c240 pattern the game uses for a target we resize, with what it
+  //   becomes at this resolution and these quality settings
+  void build (uint32_t width, uint32_t height, const tbf_quality_s& q)
+  {
+    clear ();
+
+    width_   = width;
+    height_  = height;
+    quality_ = q;
+
+    for (uint32_t dim = 64UL; dim <= 256UL; dim <<= 1)
+    {
+      uint32_t shift = TBF_ShadowBitShift (q, dim);
+
+      add ( -1.0f / (float)dim, 1.0f / (float)dim,
+              tbf_vs_patch_s::ModelShadow,
+                -1.0f / (dim << shift), 1.0f / (dim << shift) );
+    }
+
+    if (q.postproc_ratio > 0.0f)
+    {
+      const uint32_t post = nextPowerOfTwo (width / 2);
+
+      add ( -1.0f / (float) post,
+             1.0f / (float)(post / 2),
+              tbf_vs_patch_s::PostProcess,
+                -1.0f / ((float)width  * q.postproc_ratio),
+                 1.0f / ((float)height * q.postproc_ratio) );
+    }
+
+    for (uint32_t dim = 512UL; dim <= 2048UL; dim <<= 1)
+    {
+      uint32_t shift = q.env_shadow_rescale;
+
+      add ( -1.0f / (float)dim, 1.0f / (float)dim,
+              tbf_vs_patch_s::EnvShadow,
+                -1.0f / (dim << shift), 1.0f / (dim << shift) );
+    }
+  }
+
+  void add (float c0, float c1, tbf_vs_patch_s::kind_e kind, float x, float y)
+  {
+    uint64_t key = makeKey (c0, c1);
+
+    for (size_t i = hash (key), n = 0; n < SLOTS; i = (i + 1) & (SLOTS - 1), n++)
+    {
+      if (slots_ [i].used && slots_ [i].key != key)
+        continue;
+
+      slots_ [i].used           = true;
+      slots_ [i].key            = key;
+      slots_ [i].patch.kind     = kind;
+      slots_ [i].patch.data [0] = x;
+      slots_ [i].patch.data [1] = y;
+
+      return;
+    }
+  }
+
+  const tbf_vs_patch_s* find (const float* pConstantData) const
+  {
+    uint64_t key = makeKey (pConstantData [0], pConstantData [1]);
+
+    for (size_t i = hash (key), n = 0; n < SLOTS; i = (i + 1) & (SLOTS - 1), n++)
+    {
+      if (! slots_ [i].used)
+        return nullptr;
+
+      if (slots_ [i].key == key)
+        return &slots_ [i].patch;
+    }
+
+    return nullptr;
+  }
+
+protected:
+  static uint64_t makeKey (float c0, float c1)
+  {
+    uint32_t x, y;
+
+    memcpy (&x, &c0, sizeof (uint32_t));
+    memcpy (&y, &c1, sizeof (uint32_t));
+
+    return ((uint64_t)x << 32ULL) | y;
+  }
+
+  static uint32_t nextPowerOfTwo (uint32_t n)
+  {
+    n--; n |= n >> 1; n |= n >> 2; n |= n >> 4; n |= n >> 8; n |= n >> 16; return ++n;
+  }
+
+  static size_t hash (uint64_t key)
+  {
+    // 1/2^n has no mantissa bits; fold both exponents into the low bits
+    return (size_t)((key ^ (key >> 23) ^ (key >> 55)) & (SLOTS - 1));
+  }
+
+private:
+  struct slot_s {
+    uint64_t       key;
+    tbf_vs_patch_s patch;
+    bool           used;
+  } slots_ [SLOTS];
+
+  uint32_t         width_   = 0;
+  uint32_t         height_  = 0;
+  tbf_quality_s    quality_;
+};
+
+#endif /* __TBF__CONSTANT_PATCH_H__ */
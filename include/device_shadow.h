@@ -0,0 +1,85 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__DEVICE_SHADOW_H__
+#define __TBF__DEVICE_SHADOW_H__
+
+#include <Windows.h>
+#include <d3d9.h>
+
+//
+// Device state mirrored from the Set* detours, so that paths which run
+//   thousands of times per frame do not need a Get* round-trip (and the
+//     AddRef / Release that comes with it) to find out what is bound.
+//
+//   Pointers are not AddRef'd; the device holds a reference to anything
+//     bound to it. Anything not seen since the last invalidate () is read
+//       back from the device once, on first use.
+//
+//   Calls recorded into a state block bind nothing and must not be passed
+//     on; applying a block (or Reset) needs an invalidate ().
+//
+//   Not thread-safe, meant for the render thread.
+//
+class TBF_DeviceShadow
+{
+public:
+  // The device everything is read back from; forgets what was known
+  void attach     (IDirect3DDevice9* pDevice);
+  void invalidate (void);
+
+  // SetRenderTarget (0, ...), SetVertexDeclaration and SetFVF succeeded
+  void setRenderTarget (IDirect3DSurface9*           pSurf);
+  void setVertexDecl   (IDirect3DVertexDeclaration9* pDecl);
+  void setFVF          (void);
+
+  // Render target 0 and its description
+  IDirect3DSurface9*           renderTarget   (D3DSURFACE_DESC* pDesc = nullptr);
+
+  // Elements of the current vertex declaration (terminated by D3DDECL_END)
+  const D3DVERTEXELEMENT9*     vertexElements (UINT* pNumElements);
+
+  IDirect3DVertexDeclaration9* vertexDecl     (void);
+
+  // SetVertexDeclaration / SetFVF are hooked on the device's vtable; if
+  //   that failed the declaration is queried every time it is needed.
+  bool                         decl_hooked = false;
+
+private:
+  IDirect3DDevice9*            device_     = nullptr;
+
+  struct {
+    IDirect3DSurface9*           surface   = nullptr;
+    D3DSURFACE_DESC              desc      = { };
+    bool                         valid     = false;
+  } rt0_;
+
+  struct {
+    IDirect3DVertexDeclaration9* decl      = nullptr;
+    D3DVERTEXELEMENT9            elems [MAXD3DDECLLENGTH + 1];
+    UINT                         num_elems = 0;
+    bool                         loaded    = false; // elems match decl
+    bool                         valid     = false; // decl is current
+  } vertex_decl_;
+};
+
+#endif /* __TBF__DEVICE_SHADOW_H__ */
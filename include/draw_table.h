@@ -0,0 +1,328 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__DRAW_TABLE_H__
+#define __TBF__DRAW_TABLE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <unordered_set>
+
+//
+// Everything TBF_ShouldSkipRenderPass needs to know about a draw that only
+//   depends on the bound shaders and the texture in sampler 0, worked out
+//     once per combination instead of once per draw.
+//
+struct tbf_draw_decision_s {
+  bool tracked_vs     : 1; // Shader / constant tracking in the mod tools
+  bool tracked_ps     : 1;
+  bool clamp          : 1; // Clamp sampler 0 coordinates ...
+  bool sharpen        : 1; //   ... and/or bias its LOD
+  bool skip           : 1; // Cancelled by the mod tools or a fun-stuff option
+  bool aspect_trigger : 1; // Counts towards needs_aspect
+  bool aspect_hud     : 1; // Whitelisted for aspect ratio correction
+};
+
+//
+// Everything a decision depends on besides the draw itself: the mod tools'
+//   tracked shaders, the texture and fun-stuff options, the aspect ratio
+//     trigger and HUD whitelists.
+//
+struct tbf_draw_rules_s {
+  uint32_t tracked_vs        = 0x00;
+  uint32_t tracked_ps        = 0x00;
+  bool     tracked_vs_clamp  = false;
+  bool     tracked_vs_cancel = false;
+  bool     tracked_ps_clamp  = false;
+  bool     tracked_ps_cancel = false;
+
+  bool     keep_ui_sharp     = false;
+  bool     clamp_skit_coords = false;
+  bool     clamp_map_coords  = false;
+
+  bool     hollow_eye_mode   = false;
+  uint32_t hollow_eye_vs     = 0x00;
+  bool     disable_pause_dim = false;
+  uint32_t pause_dim_ps      = 0x00;
+  bool     disable_smoke     = false;
+  uint32_t smoke_ps          = 0x00;
+
+  uint32_t aspect_trigger    = 0x00; // 0 = every vertex shader
+
+  const std::unordered_set <uint32_t>* hud_vs  = nullptr;
+  const std::unordered_set <uint32_t>* hud_ps  = nullptr;
+  const std::unordered_set <uint32_t>* hud_tex = nullptr;
+};
+
+//
+// Changes whenever anything TBF_DecideDraw reads from rules does, including
+//   the contents of the whitelists (an entry swapped for another one keeps
+//     the size, and used to go unnoticed).
+//
+static inline uint32_t
+TBF_DrawRulesSignature (const tbf_draw_rules_s& rules)
+{
+  // MurmurHash3's finalizer; a bijection, so two different keys never
+  //   contribute the same amount to a set's sum
+  auto fmix = [](uint32_t h) -> uint32_t {
+    h ^= h >> 16; h *= 0x85EBCA6BUL;
+    h ^= h >> 13; h *= 0xC2B2AE35UL;
+    h ^= h >> 16;
+    return h;
+  };
+
+  uint32_t sig = 0x00;
+
+  auto add = [&](uint32_t value) {
+    sig = fmix (sig ^ fmix (value)) + 0x9E3779B1UL;
+  };
+
+  // Insertion order does not matter
+  auto add_set = [&](const std::unordered_set <uint32_t>* set) {
+    uint32_t sum = 0x00;
+
+    if (set != nullptr)
+    {
+      for ( auto key : *set )
+        sum += fmix (key);
+    }
+
+    add (set != nullptr ? (uint32_t)set->size () + 1 : 0);
+    add (sum);
+  };
+
+  add (rules.tracked_vs);
+  add (rules.tracked_ps);
+  add (rules.hollow_eye_vs);
+  add (rules.pause_dim_ps);
+  add (rules.smoke_ps);
+  add (rules.aspect_trigger);
+
+  add ( (rules.tracked_vs_clamp  ? 0x001 : 0) | (rules.tracked_vs_cancel ? 0x002 : 0) |
+        (rules.tracked_ps_clamp  ? 0x004 : 0) | (rules.tracked_ps_cancel ? 0x008 : 0) |
+        (rules.keep_ui_sharp     ? 0x010 : 0) | (rules.clamp_skit_coords ? 0x020 : 0) |
+        (rules.clamp_map_coords  ? 0x040 : 0) | (rules.hollow_eye_mode   ? 0x080 : 0) |
+        (rules.disable_pause_dim ? 0x100 : 0) | (rules.disable_smoke     ? 0x200 : 0) );
+
+  add_set (rules.hud_vs);
+  add_set (rules.hud_ps);
+  add_set (rules.hud_tex);
+
+  return sig;
+}
+
+//
+// Works out the per-(vs, ps, texture 0) part of TBF_ShouldSkipRenderPass
+//
+static inline tbf_draw_decision_s
+TBF_DecideDraw (const tbf_draw_rules_s& rules, uint32_t vs, uint32_t ps, uint32_t tex0)
+{
+  tbf_draw_decision_s decision = { };
+
+  decision.tracked_vs     = ( vs == rules.tracked_vs );
+  decision.tracked_ps     = ( ps == rules.tracked_ps );
+
+  decision.aspect_trigger = ( vs == rules.aspect_trigger || rules.aspect_trigger == 0x00 );
+
+  bool clamp   = false;
+  bool sharpen = false;
+
+  if (decision.tracked_ps && rules.tracked_ps_clamp)
+    clamp = true;
+
+  if (decision.tracked_vs && rules.tracked_vs_clamp)
+    clamp = true;
+
+  if (rules.keep_ui_sharp && ps == 0x17c397fb) sharpen = true;
+
+  if (                                          clamp ||
+       ( rules.clamp_skit_coords && ps == 0x872e7c85 ) ||
+       ( rules.clamp_map_coords  && ps == 0xc954a649 ) )
+  {
+    clamp   = true;
+    sharpen = true;
+  }
+
+  decision.clamp   = clamp;
+  decision.sharpen = sharpen;
+
+  decision.skip =
+    ( decision.tracked_vs      && rules.tracked_vs_cancel )                          ||
+    ( decision.tracked_ps      && rules.tracked_ps_cancel )                          ||
+    ( rules.hollow_eye_mode    && vs == rules.hollow_eye_vs )                        ||
+    ( rules.disable_pause_dim  && ps == rules.pause_dim_ps )                         ||
+    ( rules.disable_smoke      && ps == rules.smoke_ps && tex0 == 0x16f618a8 );
+
+  decision.aspect_hud =
+    ( rules.hud_vs  != nullptr && rules.hud_vs->count  (vs)   ) ||
+    ( rules.hud_ps  != nullptr && rules.hud_ps->count  (ps)   ) ||
+    ( rules.hud_tex != nullptr && rules.hud_tex->count (tex0) );
+
+  return decision;
+}
+
+//
+// Open-addressed table of decisions keyed on (vs, ps, texture 0). Slots are
+//   generation-stamped, so invalidating every decision is an increment.
+//
+//   Not thread-safe, meant for the render thread.
+//
+class TBF_DrawDecisionTable
+{
+public:
+  static const size_t MAX_ENTRIES = 16384; // Start over beyond this
+
+  explicit TBF_DrawDecisionTable (size_t capacity = 2048)
+  {
+    size_t slots = 16;
+
+    while (slots < capacity * 2)
+      slots <<= 1;
+
+    slots_.resize (slots);
+  }
+
+  // Returns nullptr if there is no decision for this combination yet
+  const tbf_draw_decision_s* find (uint32_t vs, uint32_t ps, uint32_t tex) const
+  {
+    const size_t mask = slots_.size () - 1;
+          size_t idx  = hash (vs, ps, tex) & mask;
+
+    while (slots_ [idx].gen == gen_)
+    {
+      const slot_s& slot = slots_ [idx];
+
+      if (slot.vs == vs && slot.ps == ps && slot.tex == tex)
+        return &slot.decision;
+
+      idx = (idx + 1) & mask;
+    }
+
+    return nullptr;
+  }
+
+  const tbf_draw_decision_s* insert ( uint32_t vs, uint32_t ps, uint32_t tex,
+                                      const tbf_draw_decision_s& decision )
+  {
+    if (size_ >= MAX_ENTRIES)
+      clear ();
+
+    else if ((size_ + 1) * 2 > slots_.size ())
+      grow ();
+
+    return place (vs, ps, tex, decision);
+  }
+
+  void clear (void)
+  {
+    size_ = 0;
+
+    // Once every 4 billion invalidations...
+    if (++gen_ == 0)
+    {
+      for ( auto& slot : slots_ )
+        slot.gen = 0;
+
+      gen_ = 1;
+    }
+  }
+
+  size_t size (void) const { return size_; }
+
+protected:
+  static size_t hash (uint32_t vs, uint32_t ps, uint32_t tex)
+  {
+    uint32_t h = vs;
+
+    h = (h ^ ps)  * 0x9E3779B1UL;
+    h = (h ^ tex) * 0x85EBCA6BUL;
+
+    return h ^ (h >> 16);
+  }
+
+  const tbf_draw_decision_s* place ( uint32_t vs, uint32_t ps, uint32_t tex,
+                                     const tbf_draw_decision_s& decision )
+  {
+    const size_t mask = slots_.size () - 1;
+          size_t idx  = hash (vs, ps, tex) & mask;
+
+    while (slots_ [idx].gen == gen_)
+    {
+      slot_s& slot = slots_ [idx];
+
+      if (slot.vs == vs && slot.ps == ps && slot.tex == tex)
+      {
+        slot.decision = decision;
+        return &slot.decision;
+      }
+
+      idx = (idx + 1) & mask;
+    }
+
+    slot_s& slot = slots_ [idx];
+
+    slot.vs       = vs;
+    slot.ps       = ps;
+    slot.tex      = tex;
+    slot.gen      = gen_;
+    slot.decision = decision;
+
+    ++size_;
+
+    return &slot.decision;
+  }
+
+  void grow (void)
+  {
+    std::vector <slot_s> old;
+    old.swap (slots_);
+
+    slots_.assign (old.size () * 2, slot_s ());
+
+    const uint32_t live = gen_;
+
+    gen_  = 1;
+    size_ = 0;
+
+    for ( auto& slot : old )
+    {
+      if (slot.gen == live)
+        place (slot.vs, slot.ps, slot.tex, slot.decision);
+    }
+  }
+
+private:
+  struct slot_s {
+    uint32_t            vs       = 0;
+    uint32_t            ps       = 0;
+    uint32_t            tex      = 0;
+    uint32_t            gen      = 0;
+    tbf_draw_decision_s decision = { };
+  };
+
+  std::vector <slot_s> slots_;
+  size_t               size_ = 0;
+  uint32_t             gen_  = 1;
+};
+
+#endif /* __TBF__DRAW_TABLE_H__ */
@@ -0,0 +1,99 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__DUMP_PACK_H__
+#define __TBF__DUMP_PACK_H__
+
+#include <Windows.h>
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+//
+// Texture dump pack (.dumppack + .dumpidx)
+//
+//   Dumped textures are appended to a single data file and an index record
+//     (checksum, format, offset, size) is appended to a second file once the
+//       data is on disk. An interrupted session loses at most the texture that
+//         was being written; the index is only rewritten when opening it finds
+//           records like that, so that their data can never be reused.
+//
+//   Deleting a texture appends a record flagged TBF_DUMP_ENTRY_DELETED, the
+//     data stays in the pack. The newest record for a checksum wins.
+//
+//   Plain stdio, so that the pack and its extractor build and are tested on
+//     the host as well (tests/test_dump_pack).
+//
+#define TBF_DUMP_INDEX_MAGIC   0x49464254UL  // 'TBFI'
+#define TBF_DUMP_INDEX_VERSION 1UL
+
+#define TBF_DUMP_ENTRY_DELETED 0x1UL
+
+#pragma pack (push, 1)
+struct tbf_dump_entry_s {
+  uint32_t checksum;
+  uint32_t format;     // D3DFORMAT
+  uint64_t offset;
+  uint32_t size;
+  uint32_t flags;      // TBF_DUMP_ENTRY_...
+};
+#pragma pack (pop)
+
+class TBF_DumpPack
+{
+public:
+   TBF_DumpPack (void) { InitializeCriticalSection (&cs_); }
+  ~TBF_DumpPack (void) { close (); DeleteCriticalSection (&cs_); }
+
+  // Creates both files if necessary and loads the existing index
+  bool                            open     (const wchar_t* wszDataFile, const wchar_t* wszIndexFile);
+  void                            close    (void);
+  bool                            isOpen   (void) const { return data_ != nullptr; }
+
+  bool                            append   (uint32_t checksum, uint32_t format, const void* pData, uint32_t size);
+  bool                            remove   (uint32_t checksum);
+  bool                            find     (uint32_t checksum, tbf_dump_entry_s* pEntry);
+  bool                            read     (const tbf_dump_entry_s& entry, std::vector <uint8_t>& out);
+
+  // Writes the entry's data out as a loose file
+  bool                            extract  (const tbf_dump_entry_s& entry, const wchar_t* wszFileName);
+
+  // The newest record of every texture that has not been deleted
+  std::vector <tbf_dump_entry_s>  entries  (void);
+
+protected:
+private:
+  CRITICAL_SECTION                cs_;
+
+  FILE*                           data_    = nullptr;
+  FILE*                           index_   = nullptr;
+  uint64_t                        end_     = 0ULL;
+
+  bool                            writeEntry (const tbf_dump_entry_s& entry);
+
+  std::vector <tbf_dump_entry_s>  entries_;
+  std::unordered_map <uint32_t, size_t>
+                                  latest_;   // Checksum -> newest record in entries_
+};
+
+#endif /* __TBF__DUMP_PACK_H__ */
@@ -0,0 +1,158 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__FRAME_SET_H__
+#define __TBF__FRAME_SET_H__
+
+#include <cstdint>
+#include <vector>
+
+//
+// Open-addressed set of 32-bit keys (or object pointers) for bookkeeping that
+//   is thrown away every frame. Slots are stamped with a generation, so
+//     clearing the set is just an increment; nothing is freed or rehashed
+//       from one frame to the next.
+//
+//   Not thread-safe, meant for the render thread.
+//
+template <typename _K>
+class TBF_FrameSetT
+{
+public:
+  explicit TBF_FrameSetT (size_t capacity = 1024)
+  {
+    size_t slots = 16;
+
+    while (slots < capacity * 2)
+      slots <<= 1;
+
+    slots_.resize  (slots);
+    keys_.reserve  (capacity);
+  }
+
+  // Returns false if the key was already in the set
+  bool insert (_K key)
+  {
+    if ((keys_.size () + 1) * 2 > slots_.size ())
+      grow ();
+
+    return place (key);
+  }
+
+  bool contains (_K key) const
+  {
+    const size_t mask = slots_.size () - 1;
+          size_t idx  = hash (key) & mask;
+
+    while (slots_ [idx].gen == gen_)
+    {
+      if (slots_ [idx].key == key)
+        return true;
+
+      idx = (idx + 1) & mask;
+    }
+
+    return false;
+  }
+
+  void clear (void)
+  {
+    keys_.clear ();
+
+    // Once every 4 billion frames...
+    if (++gen_ == 0)
+    {
+      for ( auto& slot : slots_ )
+        slot.gen = 0;
+
+      gen_ = 1;
+    }
+  }
+
+  size_t size  (void) const { return keys_.size  (); }
+  bool   empty (void) const { return keys_.empty (); }
+
+  // Iterates in insertion order
+  typename std::vector <_K>::const_iterator begin (void) const { return keys_.cbegin (); }
+  typename std::vector <_K>::const_iterator end   (void) const { return keys_.cend   (); }
+
+protected:
+  static size_t hash (uint32_t key)
+  {
+    key *= 0x9E3779B1UL;
+    return key ^ (key >> 16);
+  }
+
+  static size_t hash (const void* ptr)
+  {
+    // Heap objects are at least 16-byte aligned
+    uint64_t addr = (uint64_t)(uintptr_t)ptr;
+    return hash ((uint32_t)((addr >> 4) ^ (addr >> 36)));
+  }
+
+  bool place (_K key)
+  {
+    const size_t mask = slots_.size () - 1;
+          size_t idx  = hash (key) & mask;
+
+    while (slots_ [idx].gen == gen_)
+    {
+      if (slots_ [idx].key == key)
+        return false;
+
+      idx = (idx + 1) & mask;
+    }
+
+    slots_ [idx].key = key;
+    slots_ [idx].gen = gen_;
+
+    keys_.push_back (key);
+
+    return true;
+  }
+
+  void grow (void)
+  {
+    std::vector <_K> keys;
+    keys.swap (keys_);
+
+    slots_.assign (slots_.size () * 2, slot_s ());
+    gen_ = 1;
+
+    for ( auto key : keys )
+      place (key);
+  }
+
+private:
+  struct slot_s {
+    _K       key = _K ();
+    uint32_t gen = 0;
+  };
+
+  std::vector <slot_s> slots_;
+  std::vector <_K>     keys_;
+  uint32_t             gen_ = 1;
+};
+
+typedef TBF_FrameSetT <uint32_t> TBF_FrameSet;
+
+#endif /* __TBF__FRAME_SET_H__ */
@@ -0,0 +1,109 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__GOVERNOR_H__
+#define __TBF__GOVERNOR_H__
+
+#include <cstdint>
+
+//
+// The render target scaling the hooks actually apply; the user's settings
+//   minus whatever the quality governor has taken off. Only changes when the
+//     device is reset, so the targets and the constants that address them
+//       always agree.
+//
+struct tbf_quality_s {
+  int32_t shadow_rescale      = -2;
+  int32_t env_shadow_rescale  =  1;
+  float   postproc_ratio      =  0.5f;
+  bool    high_res_bloom      = false;
+  bool    high_res_reflection = false;
+};
+
+// How many times a dim x dim shadow map is doubled in each direction
+static inline uint32_t
+TBF_ShadowBitShift (const tbf_quality_s& q, uint32_t dim)
+{
+  uint32_t shift = q.shadow_rescale < 0 ? -q.shadow_rescale : q.shadow_rescale;
+
+  // If this is 64x64 and we want all shadows the same resolution, then add
+  //   an extra shift.
+  shift += (q.shadow_rescale < 0) * (dim == 64UL);
+
+  return shift;
+}
+
+
+//
+// Watches frame times and steps quality down when the target frame rate is
+//   missed, back up when it has been met for a while.
+//
+//   Frame times cannot show headroom under a frame limiter, so stepping up
+//     is a probe; a probe that gets undone shortly after makes the next one
+//       wait twice as long. Every change costs a device reset, so nothing
+//         moves within COOLDOWN_MS of the last change.
+//
+//   No D3D or Win32 dependency; feed it frame times, it tells you the level.
+//
+class TBF_QualityGovernor
+{
+public:
+  void  configure (float target_fps, int max_level);
+
+  // Time since the previous frame; returns true if the level changed
+  bool  sample    (float frame_ms);
+
+  // Back to full quality, forget all history
+  void  reset     (void);
+
+  int   level     (void) const { return level_;     }
+  int   maxLevel  (void) const { return max_level_; }
+  float average   (void) const { return average_;   } // Last full window, in ms
+
+  // user with `level` notches taken off: high-res reflection, high-res bloom,
+  //   then environment shadows, shadows and post-processing in turn
+  static tbf_quality_s degrade ( const tbf_quality_s& user,
+                                       int            level,
+                                       int*           pMaxLevel = nullptr );
+
+protected:
+  static const int WINDOW       = 30; // Frames per decision
+  static const int SLOW_WINDOWS =  3; // Consecutive slow windows to step down
+
+private:
+  float target_ms_       = 1000.0f / 60.0f;
+  int   max_level_       = 0;
+  int   level_           = 0;
+
+  float window_sum_      = 0.0f;
+  int   window_frames_   = 0;
+  float average_         = 0.0f;
+
+  int   slow_windows_    = 0;
+  float ok_ms_           = 0.0f; // Time the target has been met for
+  float since_change_ms_ = 0.0f;
+
+  bool  probing_         = false;
+  float probe_ms_        = 0.0f; // 0 = PROBE_BASE_MS
+};
+
+#endif /* __TBF__GOVERNOR_H__ */
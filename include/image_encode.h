@@ -0,0 +1,70 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__IMAGE_ENCODE_H__
+#define __TBF__IMAGE_ENCODE_H__
+
+#include <Windows.h>
+#include <cstdint>
+#include <vector>
+
+//
+// The screenshot encoder's image code (SSE2): no threads and nothing from
+//   D3D9, so that it also builds on the host for tests/bench_image_encode.
+//
+void   TBF_SwizzleBGRAtoRGBA    ( const uint32_t* src, uint32_t* dst, size_t count );
+void   TBF_BoxDownscaleBGRA     ( const uint32_t* src, uint32_t src_width, uint32_t src_height,
+                                        uint32_t* dst, uint32_t dst_width, uint32_t dst_height );
+
+bool   TBF_WriteTGA             ( const wchar_t* wszFileName, const uint32_t* bgra,
+                                  uint32_t width, uint32_t height );
+
+//
+// PNG in three steps, so that the caller decides where the bands of rows
+//   are deflated: begin swizzles and filters the image, every band is then
+//     deflated exactly once (by any thread, in any order), finish writes the
+//       file.
+//
+class TBF_PNGEncoder
+{
+public:
+  void   begin       ( const uint32_t* bgra, uint32_t width, uint32_t height,
+                       int             max_bands );
+  size_t numBands    (void) const { return bands_.size (); }
+  void   deflateBand (size_t band);
+  bool   finish      (const wchar_t* wszFileName);
+
+private:
+  struct band_s {
+    const uint8_t*         data;
+    size_t                 len;
+    std::vector <uint8_t>  out;
+  };
+
+  uint32_t                 width_  = 0;
+  uint32_t                 height_ = 0;
+
+  std::vector <uint8_t>    filtered_;
+  std::vector <band_s>     bands_;
+};
+
+#endif /* __TBF__IMAGE_ENCODE_H__ */
@@ -0,0 +1,166 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__INJECT_INDEX_H__
+#define __TBF__INJECT_INDEX_H__
+
+#include <cstdint>
+#include <cwchar>
+#include <cwctype>
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "classifier.h"
+#include "pack_format.h"
+
+#define TBFIX_TEXTURE_EXT L".dds"
+
+//
+// Where an injectable texture comes from: a loose file, or entry fileno of
+//   archives [archive] (a .7z or a texture pack)
+//
+struct tbf_tex_record_s {
+  unsigned int               archive = std::numeric_limits <unsigned int>::max ();
+           int               fileno  = 0UL;
+  enum     tbf_load_method_t method  = DontCare;
+           size_t            size    = 0UL;
+};
+
+//
+// Incremental updates to the injectable index: the source watcher records
+//   which files changed, rebuilds the index and the render thread diffs the
+//     old index against the new one to find the textures to reload.
+//
+struct tbf_inject_changes_s {
+  std::unordered_set <uint32_t>     checksums; // Loose .dds files that were touched
+  std::unordered_set <std::wstring> archives;  // Archives that were touched (lowercase)
+};
+
+struct tbf_inject_delta_s {
+  std::vector <uint32_t> added;
+  std::vector <uint32_t> removed;
+  std::vector <uint32_t> updated;
+};
+
+static inline std::wstring
+TBF_GetInjectSourceName ( const tbf_tex_record_s&           rec,
+                          const std::vector <std::wstring>& arcs )
+{
+  if (rec.archive == std::numeric_limits <unsigned int>::max () || rec.archive >= arcs.size ())
+    return L"";
+
+  std::wstring name (arcs [rec.archive]);
+
+  std::transform (name.begin (), name.end (), name.begin (), towlower);
+
+  return name;
+}
+
+//
+// One change notification; name is relative to the inject directory, which
+//   is what archive names are prefixed with in the index
+//
+static inline void
+TBF_RecordInjectChange ( const std::wstring&         inject_dir,
+                               std::wstring          name,
+                               tbf_inject_changes_s& changes )
+{
+  std::transform (name.begin (), name.end (), name.begin (), towlower);
+
+  // Our own manifest lives in this directory, writing it must not count
+  if (name == L"archives.manifest")
+    return;
+
+  if ( name.find (L".7z")        != std::wstring::npos ||
+       name.find (TBF_PACK_EXT)   != std::wstring::npos )
+  {
+    std::wstring dir (inject_dir);
+
+    std::transform (dir.begin (), dir.end (), dir.begin (), towlower);
+
+    changes.archives.emplace (dir + name);
+  }
+
+  else if (name.find (TBFIX_TEXTURE_EXT) != std::wstring::npos)
+  {
+    size_t   sep      = name.find_last_of (L'\\');
+    uint32_t checksum = 0;
+
+    if ( swscanf ( name.c_str () + (sep == std::wstring::npos ? 0 : sep + 1),
+                     L"%x" TBFIX_TEXTURE_EXT, &checksum ) == 1 )
+      changes.checksums.emplace (checksum);
+  }
+}
+
+static inline void
+TBF_DiffInjectableIndex ( const std::unordered_map <uint32_t, tbf_tex_record_s>& old_textures,
+                          const std::vector        <std::wstring>&               old_arcs,
+                          const std::unordered_map <uint32_t, tbf_tex_record_s>& new_textures,
+                          const std::vector        <std::wstring>&               new_arcs,
+                          const tbf_inject_changes_s&                            changes,
+                                tbf_inject_delta_s&                              delta )
+{
+  for ( auto& it : old_textures )
+  {
+    if (! new_textures.count (it.first))
+      delta.removed.push_back (it.first);
+  }
+
+  for ( auto& it : new_textures )
+  {
+    auto old_tex =
+      old_textures.find (it.first);
+
+    if (old_tex == old_textures.end ())
+    {
+      delta.added.push_back (it.first);
+      continue;
+    }
+
+    const tbf_tex_record_s& was = old_tex->second;
+    const tbf_tex_record_s& is  = it.second;
+
+    // Archive indices shift whenever an archive is added or removed, so
+    //   compare the archive name rather than its index.
+    std::wstring old_source = TBF_GetInjectSourceName (was, old_arcs);
+    std::wstring new_source = TBF_GetInjectSourceName (is,  new_arcs);
+
+    bool moved =
+      ( old_source != new_source                        ||
+        was.size   != is.size                           ||
+        was.method != is.method                         ||
+        ( (! new_source.empty ()) && was.fileno != is.fileno ) );
+
+    bool touched =
+      new_source.empty () ? changes.checksums.count (it.first) != 0 :
+                            changes.archives.count  (new_source) != 0;
+
+    if (moved || touched)
+      delta.updated.push_back (it.first);
+  }
+}
+
+#endif /* __TBF__INJECT_INDEX_H__ */
@@ -0,0 +1,67 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__PACK_H__
+#define __TBF__PACK_H__
+
+#include <Windows.h>
+#include <cstdint>
+#include <vector>
+
+#include "pack_format.h"
+
+//
+// A .tbfpack mapped into memory for as long as it is open; see pack_format.h
+//   for the layout.
+//
+class TBF_TexturePack
+{
+public:
+   TBF_TexturePack (void) { };
+  ~TBF_TexturePack (void) { close (); }
+
+  bool                    open       (const wchar_t* wszFileName);
+  void                    close      (void);
+
+  uint32_t                numEntries (void) const               { return view_.numEntries ();        }
+  const tbf_pack_entry_s* getEntry   (uint32_t idx)      const  { return view_.getEntry   (idx);      }
+  const tbf_pack_entry_s* findEntry  (uint32_t checksum) const  { return view_.findEntry  (checksum); }
+
+  // Pointer into the mapped view; only directly usable for stored entries
+  const void*             getPayload (const tbf_pack_entry_s* entry) const { return view_.getPayload (entry); }
+
+  // Works for either kind of entry, out_len must be >= entry->size
+  bool                    extract    (const tbf_pack_entry_s* entry, void* pOut, size_t out_len) const
+  {
+    return view_.extract (entry, pOut, out_len);
+  }
+
+protected:
+private:
+  HANDLE                   file_    = INVALID_HANDLE_VALUE;
+  HANDLE                   map_     = nullptr;
+  const uint8_t*           base_    = nullptr;
+
+  TBF_TexturePackView      view_;
+};
+
+#endif /* __TBF__PACK_H__ */
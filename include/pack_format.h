@@ -0,0 +1,126 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__PACK_FORMAT_H__
+#define __TBF__PACK_FORMAT_H__
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+//
+// TBF texture pack (.tbfpack)
+//
+//   An uncompressed index sorted by checksum followed by one payload per
+//     texture, each starting on a 4 KiB boundary. Readers map the whole file
+//       and hand stored payloads to D3DX without copying them; entries may
+//         optionally be LZMA compressed (5 byte props + raw stream).
+//
+//   Nothing in here depends on Win32 or D3D, so that the format can be built
+//     and tested anywhere (tests/, tools/tbfpack); pack.h has the mapping.
+//
+#define TBF_PACK_EXT       L".tbfpack"
+#define TBF_PACK_MAGIC     0x50464254UL  // 'TBFP'
+#define TBF_PACK_VERSION   1UL
+#define TBF_PACK_ALIGNMENT 4096ULL
+
+enum tbf_pack_compression_t {
+  TBF_PACK_STORED = 0,
+  TBF_PACK_LZMA   = 1
+};
+
+#pragma pack (push, 1)
+struct tbf_pack_header_s {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entries;
+  uint32_t reserved;
+};
+
+struct tbf_pack_entry_s {
+  uint32_t checksum;
+  uint32_t method;       // tbf_load_method_t
+  uint32_t compression;  // tbf_pack_compression_t
+  uint32_t stored_size;  // Bytes in the file
+  uint64_t offset;       // Multiple of TBF_PACK_ALIGNMENT
+  uint32_t size;         // Decompressed size
+  uint32_t reserved;
+};
+#pragma pack (pop)
+
+//
+// A pack that is already in memory (normally a mapped view). Every entry is
+//   checked against the size of the view when attaching, nothing is trusted
+//     after that.
+//
+class TBF_TexturePackView
+{
+public:
+  bool                    attach     (const void* pBase, uint64_t size);
+  void                    detach     (void);
+
+  uint32_t                numEntries (void) const { return hdr_ != nullptr ? hdr_->entries : 0; }
+  const tbf_pack_entry_s* getEntry   (uint32_t idx)      const;
+  const tbf_pack_entry_s* findEntry  (uint32_t checksum) const;
+
+  // Pointer into the view; only directly usable for stored entries
+  const void*             getPayload (const tbf_pack_entry_s* entry) const;
+
+  // Works for either kind of entry, out_len must be >= entry->size
+  bool                    extract    (const tbf_pack_entry_s* entry, void* pOut, size_t out_len) const;
+
+private:
+  const uint8_t*           base_    = nullptr;
+  uint64_t                 size_    = 0ULL;
+
+  const tbf_pack_header_s* hdr_     = nullptr;
+  const tbf_pack_entry_s*  index_   = nullptr;
+};
+
+//
+// Writes payloads front to back, then the header and index over the space
+//   reserved for them. The writer owns the stream it is given.
+//
+class TBF_TexturePackWriter
+{
+public:
+   TBF_TexturePackWriter (void) { };
+  ~TBF_TexturePackWriter (void);
+
+  // max_entries reserves room for the index in front of the payloads
+  bool begin  (FILE* fPack, uint32_t max_entries);
+  bool add    (uint32_t checksum, uint32_t method, const void* pData, uint32_t size, bool compress);
+  bool finish (void);
+
+  uint32_t numEntries (void) const { return (uint32_t)index_.size (); }
+
+protected:
+  bool pad    (uint64_t to);
+
+private:
+  FILE*                           file_        = nullptr;
+  uint32_t                        max_entries_ = 0;
+  uint64_t                        next_        = 0ULL;
+  std::vector <tbf_pack_entry_s>  index_;
+};
+
+#endif /* __TBF__PACK_FORMAT_H__ */
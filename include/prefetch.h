@@ -0,0 +1,184 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__PREFETCH_H__
+#define __TBF__PREFETCH_H__
+
+#include <Windows.h>
+#include <cstdint>
+#include <string>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "textures.h"
+#include "usage_model.h"
+#include "warm_start.h"
+
+//
+// Everything needed to read one injectable texture's encoded bytes, copied
+//   out of the injectable index so that the stager thread never touches it.
+//
+struct tbf_stage_request_s {
+  uint32_t         checksum = 0x00;
+  tbf_tex_record_s record;
+  std::wstring     source;    // Loose file, .tbfpack or .7z/.zip
+};
+
+//
+// Keeps the last .7z archive read from open, along with its most recently
+//   decoded solid block, so that a run of requests against one archive only
+//     parses its header once. Owned by a single thread; defined in textures.cpp.
+//
+struct tbf_source_cache_s;
+
+tbf_source_cache_s*
+TBF_CreateSourceCache  (void);
+
+void
+TBF_DestroySourceCache (tbf_source_cache_s* cache);
+
+// Closes whatever is open, e.g. once there is nothing left to read
+void
+TBF_FlushSourceCache   (tbf_source_cache_s* cache);
+
+// Defined in textures.cpp; returns a malloc'd buffer
+bool
+TBF_ReadInjectableSource ( tbf_source_cache_s*        cache,
+                           const tbf_stage_request_s& req,
+                           void**                     ppData,
+                           size_t*                    pSize );
+
+
+//
+// Holds encoded texture sources in RAM ahead of InjectTexture. Requests are
+//   serviced by one background thread at idle priority; a staged source is
+//     handed over exactly once (take) and then forgotten.
+//
+class TBF_SourceStager
+{
+public:
+  bool   init     (size_t budget);
+  void   shutdown (void);
+
+  // Low priority; duplicates and already staged checksums are ignored
+  bool   request  (const tbf_stage_request_s& req);
+
+  // Transfers ownership of the buffer (free it) to the caller
+  bool   take     (uint32_t checksum, void** ppData, size_t* pSize);
+  bool   contains (uint32_t checksum);
+
+  // Data sources changed, throw away everything (including reads in progress)
+  void   clear    (void);
+
+  size_t bytesStaged   (void) const { return (size_t)InterlockedExchangeAdd64 ((volatile LONG64 *)&bytes_, 0); }
+  LONG   numHits       (void) const { return InterlockedExchangeAdd ((volatile LONG *)&hits_,   0); }
+  LONG   numWasted     (void) const { return InterlockedExchangeAdd ((volatile LONG *)&wasted_, 0); }
+
+protected:
+  static unsigned int __stdcall ThreadProc (LPVOID user);
+
+  // Entries nobody asked for within this long may be evicted to make room
+  static const DWORD STALE_MS = 60000UL;
+
+  struct staged_s {
+    void*  data;
+    size_t size;
+    DWORD  staged_at;
+  };
+
+  bool   makeRoom (size_t size);
+
+private:
+  CRITICAL_SECTION                         cs_         = { };
+  HANDLE                                   thread_     = nullptr;
+  HANDLE                                   work_       = nullptr;
+  HANDLE                                   shutdown_   = nullptr;
+
+  std::deque         <tbf_stage_request_s> requests_;
+  std::unordered_set <uint32_t>            requested_;
+  std::unordered_map <uint32_t, staged_s>  staged_;
+  std::deque         <uint32_t>            order_;
+
+  size_t                                   budget_     = 0;
+  volatile LONG64                          bytes_      = 0LL;
+  volatile LONG                            generation_ = 0L;
+  volatile LONG                            hits_       = 0L;
+  volatile LONG                            wasted_     = 0L;
+};
+
+
+//
+// Large allocations holding the encoded sources of every blocking texture;
+//   filled by a background thread, read by any thread. Entries become visible
+//     as soon as they are committed. The first block is sized for every
+//       blocking texture at startup, hot-reloaded ones are added in more.
+//
+class TBF_ResidentPool
+{
+public:
+   TBF_ResidentPool (void) { InitializeCriticalSection (&cs_); }
+  ~TBF_ResidentPool (void) { release (); DeleteCriticalSection (&cs_); }
+
+  // Adds another block for alloc to carve from
+  bool   reserve  (size_t bytes);
+
+  // Waits for every pin to be dropped before freeing anything
+  void   release  (void);
+
+  // Builder thread only: carve out space, fill it, then publish it
+  void*  alloc    (size_t size);
+  void   commit   (uint32_t checksum, const void* pData, size_t size);
+
+  // The data stays valid until unpin; a pinned pool is never released
+  bool   pin      (uint32_t checksum, const void** ppData, size_t* pSize);
+  void   unpin    (void);
+
+  bool   contains (uint32_t checksum);
+
+  // The source changed; the bytes stay where they are until release
+  void   forget   (uint32_t checksum);
+  void   forgetAll(void);
+
+  size_t bytesUsed     (void) const { return used_;     }
+  size_t bytesReserved (void) const { return reserved_; }
+  size_t numEntries    (void);
+
+private:
+  struct block_s {
+    uint8_t* base;
+    size_t   size;
+    size_t   used;
+  };
+
+  CRITICAL_SECTION                                                cs_;
+
+  std::vector <block_s>                                           blocks_;
+  size_t                                                          reserved_ = 0;
+  size_t                                                          used_     = 0;
+  volatile LONG                                                   pins_     = 0L;
+
+  std::unordered_map <uint32_t, std::pair <const void*, size_t>> index_;
+};
+
+#endif /* __TBF__PREFETCH_H__ */
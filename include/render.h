@@ -25,6 +25,12 @@
 #define NOMINMAX
 
 #include "command.h"
+#include "state_cache.h"
+#include "device_shadow.h"
+#include "frame_set.h"
+#include "governor.h"
+#include "call_trace.h"
+#include "shader_constant.h"
 
 #include <d3d9.h>
 #include <d3d9types.h>
@@ -171,76 +177,6 @@ typedef struct _D3DXSEMANTIC
 } D3DXSEMANTIC, *LPD3DXSEMANTIC;
 
 
-
-//----------------------------------------------------------------------------
-// D3DXREGISTER_SET:
-//----------------------------------------------------------------------------
-
-typedef enum _D3DXREGISTER_SET
-{
-    D3DXRS_BOOL,
-    D3DXRS_INT4,
-    D3DXRS_FLOAT4,
-    D3DXRS_SAMPLER,
-
-    // force 32-bit size enum
-    D3DXRS_FORCE_DWORD = 0x7fffffff
-
-} D3DXREGISTER_SET, *LPD3DXREGISTER_SET;
-
-
-//----------------------------------------------------------------------------
-// D3DXPARAMETER_CLASS:
-//----------------------------------------------------------------------------
-
-typedef enum _D3DXPARAMETER_CLASS
-{
-    D3DXPC_SCALAR,
-    D3DXPC_VECTOR,
-    D3DXPC_MATRIX_ROWS,
-    D3DXPC_MATRIX_COLUMNS,
-    D3DXPC_OBJECT,
-    D3DXPC_STRUCT,
-
-    // force 32-bit size enum
-    D3DXPC_FORCE_DWORD = 0x7fffffff
-
-} D3DXPARAMETER_CLASS, *LPD3DXPARAMETER_CLASS;
-
-
-//----------------------------------------------------------------------------
-// D3DXPARAMETER_TYPE:
-//----------------------------------------------------------------------------
-
-typedef enum _D3DXPARAMETER_TYPE
-{
-    D3DXPT_VOID,
-    D3DXPT_BOOL,
-    D3DXPT_INT,
-    D3DXPT_FLOAT,
-    D3DXPT_STRING,
-    D3DXPT_TEXTURE,
-    D3DXPT_TEXTURE1D,
-    D3DXPT_TEXTURE2D,
-    D3DXPT_TEXTURE3D,
-    D3DXPT_TEXTURECUBE,
-    D3DXPT_SAMPLER,
-    D3DXPT_SAMPLER1D,
-    D3DXPT_SAMPLER2D,
-    D3DXPT_SAMPLER3D,
-    D3DXPT_SAMPLERCUBE,
-    D3DXPT_PIXELSHADER,
-    D3DXPT_VERTEXSHADER,
-    D3DXPT_PIXELFRAGMENT,
-    D3DXPT_VERTEXFRAGMENT,
-    D3DXPT_UNSUPPORTED,
-
-    // force 32-bit size enum
-    D3DXPT_FORCE_DWORD = 0x7fffffff
-
-} D3DXPARAMETER_TYPE, *LPD3DXPARAMETER_TYPE;
-
-
 //----------------------------------------------------------------------------
 // D3DXCONSTANTTABLE_DESC:
 //----------------------------------------------------------------------------
@@ -357,6 +293,13 @@ namespace tbf
       bool graphics = false;
     } extern need_reset;
 
+    // What the hooks scale render targets by; see tbf_quality_s
+    extern tbf_quality_s       quality;
+    extern TBF_QualityGovernor governor;
+
+    // Binary record of the calls the hooks see; see tbf_trace_op
+    extern TBF_CallRecorder    call_trace;
+
     class CommandProcessor : public SK_IVariableListener {
     public:
       CommandProcessor (void);
@@ -396,25 +339,20 @@ namespace tbf
 
     struct frame_state_s
     {
-      void clear (void) { pixel_shaders.clear (); vertex_shaders.clear (); vertex_buffers.dynamic.clear (); vertex_buffers.immutable.clear (); }
+      void clear (void) { pixel_shaders.clear (); vertex_shaders.clear (); vertex_buffers.dynamic.clear (); vertex_buffers.immutable.clear (); ++frame; }
     
-      std::unordered_set <uint32_t>                 pixel_shaders;
-      std::unordered_set <uint32_t>                 vertex_shaders;
+      TBF_FrameSet                                  pixel_shaders;
+      TBF_FrameSet                                  vertex_shaders;
+
+      // Shader records stamped with this are already in the sets above
+      uint32_t                                      frame = 1;
 
       struct {
-        std::unordered_set <IDirect3DVertexBuffer9 *> dynamic;
-        std::unordered_set <IDirect3DVertexBuffer9 *> immutable;
+        TBF_FrameSetT <IDirect3DVertexBuffer9 *>    dynamic;
+        TBF_FrameSetT <IDirect3DVertexBuffer9 *>    immutable;
       } vertex_buffers;
     } extern last_frame;
 
-    struct known_objects_s
-    {
-      void clear (void) { static_vbs.clear (); dynamic_vbs.clear (); };
-
-      std::unordered_set <IDirect3DVertexBuffer9 *> static_vbs;
-      std::unordered_set <IDirect3DVertexBuffer9 *> dynamic_vbs;
-    } extern known_objs;
-
     struct render_target_class_s
     {
       struct shadow_s
@@ -456,8 +394,8 @@ namespace tbf
 
       IDirect3DBaseTexture9*        tracking_tex  = nullptr;
 
-      std::unordered_set <uint32_t> pixel_shaders;
-      std::unordered_set <uint32_t> vertex_shaders;
+      TBF_FrameSet                  pixel_shaders;
+      TBF_FrameSet                  vertex_shaders;
 
       bool                          active        = false;
     } extern tracked_rt;
@@ -480,34 +418,21 @@ namespace tbf
       bool                          clamp_coords = false;
       bool                          active       = false;
       int                           num_draws    =     0;
-      std::unordered_set <uint32_t>    used_textures;
-                          uint32_t  current_textures [16];
+      TBF_FrameSet                  used_textures;
+      uint32_t                      current_textures [16];
 
       //std::vector <IDirect3DBaseTexture9 *> samplers;
 
       IUnknown*                     shader_obj  = nullptr;
       ID3DXConstantTable*           ctable      = nullptr;
 
-      struct shader_constant_s
-      {
-        char                Name [128];
-        D3DXREGISTER_SET    RegisterSet;
-        UINT                RegisterIndex;
-        UINT                RegisterCount;
-        D3DXPARAMETER_CLASS Class;
-        D3DXPARAMETER_TYPE  Type;
-        UINT                Rows;
-        UINT                Columns;
-        UINT                Elements;
-        std::vector <shader_constant_s>
-                            struct_members;
-        bool                Override;
-        float               Data [4]; // TEMP HACK
-      };
+      typedef tbf_shader_constant_s shader_constant_s;
 
       std::vector <shader_constant_s> constants;
     } extern tracked_vs, tracked_ps;
 
+    extern TBF_DeviceShadow device_shadow;
+
     struct vertex_buffer_tracking_s
     {
       void clear (void) {
@@ -526,39 +451,37 @@ namespace tbf
       {
         extern uint32_t vs_checksum, ps_checksum;
 
-        vertex_shaders.emplace (vs_checksum);
-        pixel_shaders.emplace  (ps_checksum);
+        vertex_shaders.insert (vs_checksum);
+        pixel_shaders.insert  (ps_checksum);
 
-        IDirect3DVertexDeclaration9* decl = nullptr;
+        UINT                     num_elems = 0;
+        const D3DVERTEXELEMENT9* elem_decl =
+          tbf::RenderFix::device_shadow.vertexElements (&num_elems);
 
-        if (SUCCEEDED (tbf::RenderFix::pDevice->GetVertexDeclaration (&decl)))
+        // Run through the vertex decl and figure out which samplers have texcoords,
+        //   that is a pretty good indicator as to which textures are actually used...
+        if (elem_decl != nullptr)
         {
-          static D3DVERTEXELEMENT9 elem_decl [MAXD3DDECLLENGTH];
-          static UINT              num_elems;
+          extern uint32_t current_tex [256];
 
-          // Run through the vertex decl and figure out which samplers have texcoords,
-          //   that is a pretty good indicator as to which textures are actually used...
-          if (SUCCEEDED (decl->GetDeclaration (elem_decl, &num_elems)))
+          for ( UINT i = 0; i < num_elems; i++ )
           {
-            extern uint32_t current_tex [256];
-
-            for ( int i = 0; i < num_elems; i++ )
-            {
-              if (elem_decl [i].Usage == D3DDECLUSAGE_TEXCOORD)
-                textures.emplace (current_tex [elem_decl [i].UsageIndex]);
-            }
+            if (elem_decl [i].Usage == D3DDECLUSAGE_TEXCOORD)
+              textures.insert (current_tex [elem_decl [i].UsageIndex]);
           }
-
-          if (! vertex_decls.count (decl))
-            vertex_decls.emplace (decl);
-          else
-            decl->Release ();
         }
+
+        IDirect3DVertexDeclaration9* decl =
+          tbf::RenderFix::device_shadow.vertexDecl ();
+
+        // The set owns a reference, released in clear ()
+        if (decl != nullptr && vertex_decls.insert (decl))
+          decl->AddRef ();
       }
 
       IDirect3DVertexBuffer9*       vertex_buffer = nullptr;
 
-      std::unordered_set <
+      TBF_FrameSetT <
         IDirect3DVertexDeclaration9*
       >                             vertex_decls;
 
@@ -570,9 +493,9 @@ namespace tbf
       int                           instanced     =     0;
       int                           instances     =     1;
 
-      std::unordered_set <uint32_t> vertex_shaders;
-      std::unordered_set <uint32_t> pixel_shaders;
-      std::unordered_set <uint32_t> textures;
+      TBF_FrameSet                  vertex_shaders;
+      TBF_FrameSet                  pixel_shaders;
+      TBF_FrameSet                  textures;
 
       std::unordered_set <IDirect3DVertexBuffer9 *>
                                     wireframes;
@@ -586,6 +509,8 @@ namespace tbf
 
     extern std::unordered_set <IDirect3DBaseTexture9 *> ui_map_rts;
     extern bool                                         ui_map_active;
+
+    extern TBF_StateCache                               state_cache;
   }
 }
 
@@ -771,6 +696,10 @@ typedef  HRESULT (STDMETHODCALLTYPE *CreateVertexBuffer_pfn)
   _In_  HANDLE                  *pSharedHandle
 );
 
+typedef ULONG (STDMETHODCALLTYPE *VertexBufferRelease_pfn)
+( _In_ IDirect3DVertexBuffer9* This
+);
+
 typedef HRESULT (STDMETHODCALLTYPE *SetStreamSource_pfn)
 (
   IDirect3DDevice9       *This,
@@ -875,6 +804,35 @@ typedef HRESULT (WINAPI *D3DXDisassembleShader_pfn)
   _Out_       LPD3DXBUFFER *ppDisassembly
 );
 
+typedef HRESULT (STDMETHODCALLTYPE *SetVertexDeclaration_pfn)
+( _In_ IDirect3DDevice9*            This,
+  _In_ IDirect3DVertexDeclaration9* pDecl
+);
+
+typedef HRESULT (STDMETHODCALLTYPE *SetFVF_pfn)
+( _In_ IDirect3DDevice9* This,
+  _In_ DWORD             FVF
+);
+
+typedef HRESULT (STDMETHODCALLTYPE *CreateStateBlock_pfn)
+( _In_  IDirect3DDevice9*      This,
+  _In_  D3DSTATEBLOCKTYPE      Type,
+  _Out_ IDirect3DStateBlock9** ppSB
+);
+
+typedef HRESULT (STDMETHODCALLTYPE *BeginStateBlock_pfn)
+( _In_ IDirect3DDevice9* This
+);
+
+typedef HRESULT (STDMETHODCALLTYPE *EndStateBlock_pfn)
+( _In_  IDirect3DDevice9*      This,
+  _Out_ IDirect3DStateBlock9** ppSB
+);
+
+typedef HRESULT (STDMETHODCALLTYPE *StateBlockApply_pfn)
+( _In_ IDirect3DStateBlock9* This
+);
+
 typedef HRESULT (__stdcall *Reset_pfn)
 ( _In_    IDirect3DDevice9      *This,
   _Inout_ D3DPRESENT_PARAMETERS *pPresentationParameters
@@ -885,6 +843,15 @@ typedef HRESULT (__stdcall *Reset_pfn)
 
 extern SetSamplerState_pfn D3D9SetSamplerState_Original;
 
+// Pass through tbf::RenderFix::state_cache, calls that would not change
+//   anything on the primary device are dropped. Nothing is dropped unless
+//     the state block hooks are in, or while a state block is recording.
+HRESULT TBF_SetRenderState  (IDirect3DDevice9* This, D3DRENDERSTATETYPE  State,   DWORD Value);
+HRESULT TBF_SetSamplerState (IDirect3DDevice9* This, DWORD               Sampler,
+                                                     D3DSAMPLERSTATETYPE Type,    DWORD Value);
+HRESULT TBF_SetViewport     (IDirect3DDevice9* This, CONST D3DVIEWPORT9* pViewport);
+HRESULT TBF_SetScissorRect  (IDirect3DDevice9* This, CONST RECT*         pRect);
+
 
 
 #endif /* __TZF__RENDER_H__ */
\ No newline at end of file
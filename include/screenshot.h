@@ -0,0 +1,62 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__SCREENSHOT_H__
+#define __TBF__SCREENSHOT_H__
+
+#include <Windows.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "image_encode.h"
+
+//
+// A captured frame, already read back from the GPU; the encoder thread never
+//   touches the D3D9 device, so nothing here can hold up a device reset.
+//
+struct tbf_screenshot_s {
+  std::vector <uint32_t> pixels;           // BGRA (D3DFMT_A8R8G8B8 memory order)
+  uint32_t               width     = 0;
+  uint32_t               height    = 0;
+
+  std::wstring           file;             // .png or .tga
+  std::wstring           thumbnail;        // Empty if Steam does not get one
+
+  // Steam wants ANSI paths
+  std::string            file_ansi;
+  std::string            thumbnail_ansi;
+};
+
+// Takes ownership; returns false (and deletes the screenshot) if the queue is full
+bool   TBF_QueueScreenshot      (tbf_screenshot_s* shot);
+size_t TBF_PendingScreenshots   (void);
+
+// Waits for everything queued to finish encoding
+void   TBF_ShutdownScreenshots  (void);
+
+
+// Deflates up to 'threads' bands of rows at once, on the encoder's helper threads
+bool   TBF_WritePNG             ( const wchar_t* wszFileName, const uint32_t* bgra,
+                                  uint32_t width, uint32_t height, int threads );
+
+#endif /* __TBF__SCREENSHOT_H__ */
@@ -0,0 +1,57 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__SHADER_BYTECODE_H__
+#define __TBF__SHADER_BYTECODE_H__
+
+#include <cstdint>
+#include <cstddef>
+
+enum class tbf_shader_stage {
+  Vertex = 0,
+  Pixel  = 1
+};
+
+//
+// Checks that a blob is SM 1.x-3.0 bytecode for the given stage: a version
+//   token of the right type, whole DWORD tokens and D3DSIO_END last.
+//
+static inline bool
+TBF_IsShaderBytecode (tbf_shader_stage stage, const void* pbFunc, size_t len)
+{
+  if (pbFunc == nullptr || len < sizeof (uint32_t) * 2 || (len % sizeof (uint32_t)) != 0)
+    return false;
+
+  const uint32_t* pTokens = (const uint32_t *)pbFunc;
+  const uint32_t  version = pTokens [0];
+  const uint32_t  end     = pTokens [len / sizeof (uint32_t) - 1];
+
+  const uint32_t  type    = stage == tbf_shader_stage::Pixel ? 0xFFFF0000UL :
+                                                               0xFFFE0000UL;
+  const uint32_t  major   = (version >> 8) & 0xFF;
+
+  return (version & 0xFFFF0000UL) == type &&
+          major >= 1 && major <= 3        &&
+          end == 0x0000FFFFUL; // D3DSIO_END
+}
+
+#endif /* __TBF__SHADER_BYTECODE_H__ */
@@ -0,0 +1,220 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__SHADER_CACHE_H__
+#define __TBF__SHADER_CACHE_H__
+
+#include <cstdint>
+#include <vector>
+
+//
+// What we know about a shader object, worked out the first time it is bound
+//
+struct tbf_shader_record_s {
+  uint32_t crc32       = 0x00;
+  uint32_t frame       = 0;       // Last frame it was added to last_frame
+  void*    replacement = nullptr; // Injected shader to bind in its place
+};
+
+//
+// Shader object -> record. A small direct-mapped cache of recent pointers
+//   sits in front of an open-addressed table, so that rebinding one of the
+//     few dozen shaders a scene actually uses is a compare and a load.
+//
+//   Records are never moved once created; pointers to them stay valid until
+//     clear ().
+//
+//   Not thread-safe, meant for the render thread.
+//
+class TBF_ShaderCache
+{
+public:
+  static const size_t RECENT_SLOTS = 256;  // Direct-mapped, power of two
+
+  explicit TBF_ShaderCache (size_t capacity = 4096)
+  {
+    size_t slots = 16;
+
+    while (slots < capacity * 2)
+      slots <<= 1;
+
+    slots_.resize (slots);
+    clear ();
+  }
+
+  ~TBF_ShaderCache (void)
+  {
+    clear ();
+  }
+
+  tbf_shader_record_s* find (const void* pShader)
+  {
+    recent_s& recent = recent_ [hash (pShader) & (RECENT_SLOTS - 1)];
+
+    if (recent.ptr == pShader && pShader != nullptr)
+      return recent.rec;
+
+    tbf_shader_record_s* rec = lookup (pShader);
+
+    if (rec != nullptr)
+    {
+      recent.ptr = pShader;
+      recent.rec = rec;
+    }
+
+    return rec;
+  }
+
+  tbf_shader_record_s* insert (const void* pShader, uint32_t crc32)
+  {
+    tbf_shader_record_s* rec = lookup (pShader);
+
+    if (rec == nullptr)
+    {
+      if ((count_ + 1) * 2 > slots_.size ())
+        grow ();
+
+      rec        = allocate ();
+      rec->crc32 = crc32;
+
+      place (pShader, rec);
+    }
+
+    else
+      rec->crc32 = crc32;
+
+    return rec;
+  }
+
+  void clear (void)
+  {
+    for ( auto& slot : slots_ )
+      slot = slot_s ();
+
+    for ( auto& recent : recent_ )
+      recent = recent_s ();
+
+    for ( auto block : blocks_ )
+      delete [] block;
+
+    blocks_.clear ();
+
+    used_  = BLOCK_SIZE;
+    count_ = 0;
+  }
+
+  size_t size (void) const { return count_; }
+
+protected:
+  static const size_t BLOCK_SIZE = 512;
+
+  static size_t hash (const void* ptr)
+  {
+    // Shader objects are at least 16-byte aligned
+    uintptr_t h = (uintptr_t)ptr >> 4;
+
+    h ^= (h >> 16);
+    h *= 0x9E3779B1UL;
+
+    return (size_t)(h ^ (h >> 16));
+  }
+
+  tbf_shader_record_s* lookup (const void* pShader) const
+  {
+    if (pShader == nullptr)
+      return nullptr;
+
+    const size_t mask = slots_.size () - 1;
+          size_t idx  = hash (pShader) & mask;
+
+    while (slots_ [idx].ptr != nullptr)
+    {
+      if (slots_ [idx].ptr == pShader)
+        return slots_ [idx].rec;
+
+      idx = (idx + 1) & mask;
+    }
+
+    return nullptr;
+  }
+
+  void place (const void* pShader, tbf_shader_record_s* rec)
+  {
+    const size_t mask = slots_.size () - 1;
+          size_t idx  = hash (pShader) & mask;
+
+    while (slots_ [idx].ptr != nullptr)
+      idx = (idx + 1) & mask;
+
+    slots_ [idx].ptr = pShader;
+    slots_ [idx].rec = rec;
+
+    ++count_;
+  }
+
+  void grow (void)
+  {
+    std::vector <slot_s> old;
+    old.swap (slots_);
+
+    slots_.assign (old.size () * 2, slot_s ());
+    count_ = 0;
+
+    for ( auto& slot : old )
+    {
+      if (slot.ptr != nullptr)
+        place (slot.ptr, slot.rec);
+    }
+  }
+
+  // Records live in fixed-size blocks so that growing never moves them
+  tbf_shader_record_s* allocate (void)
+  {
+    if (used_ == BLOCK_SIZE)
+    {
+      blocks_.push_back (new tbf_shader_record_s [BLOCK_SIZE]);
+      used_ = 0;
+    }
+
+    return &blocks_.back () [used_++];
+  }
+
+private:
+  struct slot_s {
+    const void*          ptr = nullptr;
+    tbf_shader_record_s* rec = nullptr;
+  };
+
+  struct recent_s {
+    const void*          ptr = nullptr;
+    tbf_shader_record_s* rec = nullptr;
+  };
+
+  std::vector <slot_s>                slots_;
+  recent_s                            recent_ [RECENT_SLOTS];
+
+  std::vector <tbf_shader_record_s *> blocks_;
+  size_t                              used_  = BLOCK_SIZE;
+  size_t                              count_ = 0;
+};
+
+#endif /* __TBF__SHADER_CACHE_H__ */
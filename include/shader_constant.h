@@ -0,0 +1,119 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__SHADER_CONSTANT_H__
+#define __TBF__SHADER_CONSTANT_H__
+
+#include <Windows.h>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// D3DXREGISTER_SET:
+//----------------------------------------------------------------------------
+
+typedef enum _D3DXREGISTER_SET
+{
+    D3DXRS_BOOL,
+    D3DXRS_INT4,
+    D3DXRS_FLOAT4,
+    D3DXRS_SAMPLER,
+
+    // force 32-bit size enum
+    D3DXRS_FORCE_DWORD = 0x7fffffff
+
+} D3DXREGISTER_SET, *LPD3DXREGISTER_SET;
+
+
+//----------------------------------------------------------------------------
+// D3DXPARAMETER_CLASS:
+//----------------------------------------------------------------------------
+
+typedef enum _D3DXPARAMETER_CLASS
+{
+    D3DXPC_SCALAR,
+    D3DXPC_VECTOR,
+    D3DXPC_MATRIX_ROWS,
+    D3DXPC_MATRIX_COLUMNS,
+    D3DXPC_OBJECT,
+    D3DXPC_STRUCT,
+
+    // force 32-bit size enum
+    D3DXPC_FORCE_DWORD = 0x7fffffff
+
+} D3DXPARAMETER_CLASS, *LPD3DXPARAMETER_CLASS;
+
+
+//----------------------------------------------------------------------------
+// D3DXPARAMETER_TYPE:
+//----------------------------------------------------------------------------
+
+typedef enum _D3DXPARAMETER_TYPE
+{
+    D3DXPT_VOID,
+    D3DXPT_BOOL,
+    D3DXPT_INT,
+    D3DXPT_FLOAT,
+    D3DXPT_STRING,
+    D3DXPT_TEXTURE,
+    D3DXPT_TEXTURE1D,
+    D3DXPT_TEXTURE2D,
+    D3DXPT_TEXTURE3D,
+    D3DXPT_TEXTURECUBE,
+    D3DXPT_SAMPLER,
+    D3DXPT_SAMPLER1D,
+    D3DXPT_SAMPLER2D,
+    D3DXPT_SAMPLER3D,
+    D3DXPT_SAMPLERCUBE,
+    D3DXPT_PIXELSHADER,
+    D3DXPT_VERTEXSHADER,
+    D3DXPT_PIXELFRAGMENT,
+    D3DXPT_VERTEXFRAGMENT,
+    D3DXPT_UNSUPPORTED,
+
+    // force 32-bit size enum
+    D3DXPT_FORCE_DWORD = 0x7fffffff
+
+} D3DXPARAMETER_TYPE, *LPD3DXPARAMETER_TYPE;
+
+
+//
+// One entry of a shader's constant table, as shown (and overridden) by the
+//   shader views in the mod tools and cached by TBF_ShaderMetaCache.
+//
+struct tbf_shader_constant_s
+{
+  char                Name [128];
+  D3DXREGISTER_SET    RegisterSet;
+  UINT                RegisterIndex;
+  UINT                RegisterCount;
+  D3DXPARAMETER_CLASS Class;
+  D3DXPARAMETER_TYPE  Type;
+  UINT                Rows;
+  UINT                Columns;
+  UINT                Elements;
+  std::vector <tbf_shader_constant_s>
+                      struct_members;
+  bool                Override;
+  float               Data [4]; // TEMP HACK
+};
+
+#endif /* __TBF__SHADER_CONSTANT_H__ */
@@ -0,0 +1,90 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__SHADER_DISASM_H__
+#define __TBF__SHADER_DISASM_H__
+
+#include <Windows.h>
+#include <cstdint>
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "render.h"
+#include "shader_bytecode.h"
+
+struct tbf_disasm_request_s {
+  tbf_shader_stage stage  = tbf_shader_stage::Vertex;
+  uint32_t         crc32  = 0x00;
+  std::string      bytecode;
+  bool             html   = false; // Also write TBFix_Res\dump\shaders\*.html
+};
+
+
+//
+// Turns shader bytecode into the text shown by the shader views. Requests
+//   are serviced by one background thread at idle priority; the plain text
+//     is cached on disk by CRC (TBFix_Res\cache\shaders) so a shader is only
+//       ever disassembled once.
+//
+class TBF_ShaderDisassembler
+{
+public:
+  bool   init     (void);
+  void   shutdown (void);
+
+  // Copies the bytecode; duplicates and finished shaders are ignored
+  bool   request  ( tbf_shader_stage stage, uint32_t    crc32,
+                    const void*      pbFunc, UINT       len,
+                    bool             html = false );
+
+  // nullptr until the worker has finished; entries are never removed
+  //   before shutdown, so the pointer stays valid
+  const tbf::RenderFix::shader_disasm_s*
+         find     (tbf_shader_stage stage, uint32_t crc32);
+
+  LONG   numDisassembled (void) const { return InterlockedExchangeAdd ((volatile LONG *)&disassembled_, 0); }
+  LONG   numCacheHits    (void) const { return InterlockedExchangeAdd ((volatile LONG *)&cache_hits_,   0); }
+
+protected:
+  static unsigned int __stdcall ThreadProc (LPVOID user);
+
+  void   process  (const tbf_disasm_request_s& req);
+
+private:
+  CRITICAL_SECTION                          cs_           = { };
+  HANDLE                                    thread_       = nullptr;
+  HANDLE                                    work_         = nullptr;
+  HANDLE                                    shutdown_     = nullptr;
+
+  std::deque         <tbf_disasm_request_s> requests_;
+  std::unordered_set <uint64_t>             requested_;
+
+  std::unordered_map <uint32_t, tbf::RenderFix::shader_disasm_s>
+                                            disasm_ [2];
+
+  volatile LONG                             disassembled_ = 0L;
+  volatile LONG                             cache_hits_   = 0L;
+};
+
+#endif /* __TBF__SHADER_DISASM_H__ */
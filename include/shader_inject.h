@@ -0,0 +1,76 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__SHADER_INJECT_H__
+#define __TBF__SHADER_INJECT_H__
+
+#include <Windows.h>
+#include <d3d9.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "shader_disasm.h"
+
+//
+// Precompiled replacement shaders, TBFix_Res\inject\shaders\<vs|ps>_<crc32>.cso
+//
+//   The directory is indexed once; a replacement is read, validated and
+//     created on the device the first time its original is bound. It must
+//       use the same constant registers and samplers as the original, the
+//         game keeps setting those for the shader it thinks is bound.
+//
+class TBF_ShaderInjector
+{
+public:
+  // Returns the number of replacements found
+  size_t     scan        (void);
+  void       release     (void);
+
+  bool       has         (tbf_shader_stage stage, uint32_t crc32) const;
+
+  // nullptr if there is no (valid) replacement; not AddRef'd, the injector
+  //   keeps its reference until release ()
+  IUnknown*  replacement ( IDirect3DDevice9* pDevice,
+                           tbf_shader_stage  stage,
+                           uint32_t          crc32 );
+
+  size_t     numFiles    (void) const { return files_ [0].size () + files_ [1].size (); }
+  size_t     numLoaded   (void) const { return loaded_; }
+
+  // Checks that a blob is SM 1.x-3.0 bytecode for the given stage
+  static bool validate   (tbf_shader_stage stage, const void* pbFunc, size_t len);
+
+private:
+  struct replacement_s {
+    std::wstring path;
+    IUnknown*    shader = nullptr;
+    bool         failed = false;
+  };
+
+  std::unordered_map <uint32_t, replacement_s> files_ [2];
+
+  IDirect3DDevice9*                            device_ = nullptr;
+  size_t                                       loaded_ = 0;
+};
+
+#endif /* __TBF__SHADER_INJECT_H__ */
@@ -0,0 +1,103 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__SHADER_META_H__
+#define __TBF__SHADER_META_H__
+
+#include <Windows.h>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <unordered_map>
+
+#include "shader_constant.h"
+
+//
+// What the render hooks need to know about a shader, so that a shader seen
+//   in an earlier session costs a hash and a lookup instead of a CRC32 and
+//     a walk through its D3DX constant table.
+//
+struct tbf_shader_meta_s {
+  uint32_t                            crc32         = 0x00;
+
+  // The constant table is only walked for shaders someone tracks
+  bool                                has_constants = false;
+  std::vector <tbf_shader_constant_s> constants;
+
+  bool                                used          = false; // This session
+};
+
+class TBF_ShaderMetaCache
+{
+public:
+  // Not a checksum anyone should rely on, only a cache key (with the length)
+  static uint64_t hash (const void* pbFunc, UINT len);
+
+  bool   load       (const wchar_t* wszFileName);
+  bool   save       (const wchar_t* wszFileName);
+
+  tbf_shader_meta_s* find     (UINT len, uint64_t hash);
+  tbf_shader_meta_s* findCRC  (uint32_t crc32);
+  tbf_shader_meta_s* insert   (UINT len, uint64_t hash, uint32_t crc32);
+
+  void   setConstants (tbf_shader_meta_s* pMeta, const std::vector <tbf_shader_constant_s>& constants);
+
+  bool   dirty      (void) const { return dirty_; }
+  size_t size       (void) const { return entries_.size (); }
+
+protected:
+  static const uint32_t MAGIC       = 0x53464254UL; // 'TBFS'
+  static const uint32_t VERSION     = 1UL;
+
+  // Entries not used in the current session are dropped past this many
+  static const size_t   MAX_ENTRIES = 16384;
+
+  // Deepest struct nesting and widest constant list accepted from disk
+  static const uint32_t MAX_DEPTH     = 8UL;
+  static const uint32_t MAX_CONSTANTS = 4096UL;
+
+  struct key_s {
+    uint64_t hash;
+    UINT     len;
+
+    bool operator== (const key_s& other) const {
+      return hash == other.hash && len == other.len;
+    }
+  };
+
+  struct key_hash_s {
+    size_t operator() (const key_s& key) const {
+      return (size_t)(key.hash ^ key.len);
+    }
+  };
+
+  static bool readConstants  (FILE* fMeta, std::vector <tbf_shader_constant_s>& list, uint32_t depth);
+  static void writeConstants (FILE* fMeta, const std::vector <tbf_shader_constant_s>& list);
+
+private:
+  std::unordered_map <key_s, tbf_shader_meta_s, key_hash_s> entries_;
+  std::unordered_map <uint32_t, tbf_shader_meta_s*>         by_crc_;
+
+  bool                                                      dirty_ = false;
+};
+
+#endif /* __TBF__SHADER_META_H__ */
@@ -0,0 +1,236 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__STATE_CACHE_H__
+#define __TBF__STATE_CACHE_H__
+
+#include <Windows.h>
+#include <d3d9.h>
+#include <cstdint>
+
+struct tbf_state_filter_stats_s {
+  ULONG render_states  = 0UL;
+  ULONG sampler_states = 0UL;
+  ULONG viewports      = 0UL;
+  ULONG scissor_rects  = 0UL;
+
+  ULONG total (void) const {
+    return render_states + sampler_states + viewports + scissor_rects;
+  }
+};
+
+//
+// Shadow copy of the render state, sampler state, viewport and scissor rect
+//   last sent to the device, so that calls which would not change anything
+//     never reach the runtime. A slot is only trusted once a value has been
+//       written through the cache since the last invalidate ().
+//
+//   Applied state blocks, Reset and overlays drawn by the injector change
+//     the device behind our back; invalidate () must be called after any of
+//       those. While a state block is recording, calls are captured instead
+//         of applied: every one goes through and none is remembered.
+//
+//   Not thread-safe, meant for the render thread.
+//
+class TBF_StateCache
+{
+public:
+  static const DWORD MAX_RENDER_STATES  = 256; // D3DRS_BLENDOPALPHA = 209
+  static const DWORD MAX_SAMPLER_STATES =  14; // D3DSAMP_DMAPOFFSET =  13
+  static const DWORD MAX_SAMPLERS       =  20; // 16 pixel + 4 vertex samplers
+
+  TBF_StateCache (void) { invalidate (); }
+
+  // Each of these returns true if the call has to go to the device
+  bool renderState (D3DRENDERSTATETYPE State, DWORD Value)
+  {
+    if (recording_ || (DWORD)State >= MAX_RENDER_STATES)
+      return true;
+
+    slot_s& slot = rs_ [State];
+
+    if (slot.gen == gen_ && slot.value == Value) {
+      ++filtered_.render_states;
+      return false;
+    }
+
+    slot.value = Value;
+    slot.gen   = gen_;
+
+    ++issued_.render_states;
+
+    return true;
+  }
+
+  bool samplerState (DWORD Sampler, D3DSAMPLERSTATETYPE Type, DWORD Value)
+  {
+    const DWORD idx = samplerIndex (Sampler);
+
+    if (recording_ || idx >= MAX_SAMPLERS || (DWORD)Type >= MAX_SAMPLER_STATES)
+      return true;
+
+    slot_s& slot = ss_ [idx][Type];
+
+    if (slot.gen == gen_ && slot.value == Value) {
+      ++filtered_.sampler_states;
+      return false;
+    }
+
+    slot.value = Value;
+    slot.gen   = gen_;
+
+    ++issued_.sampler_states;
+
+    return true;
+  }
+
+  bool viewport (const D3DVIEWPORT9* pViewport)
+  {
+    if (recording_ || pViewport == nullptr)
+      return true;
+
+    if ( vp_gen_   == gen_                &&
+         vp_.X     == pViewport->X        && vp_.Y      == pViewport->Y      &&
+         vp_.Width == pViewport->Width    && vp_.Height == pViewport->Height &&
+         vp_.MinZ  == pViewport->MinZ     && vp_.MaxZ   == pViewport->MaxZ ) {
+      ++filtered_.viewports;
+      return false;
+    }
+
+    vp_     = *pViewport;
+    vp_gen_ =  gen_;
+
+    ++issued_.viewports;
+
+    return true;
+  }
+
+  bool scissorRect (const RECT* pRect)
+  {
+    if (recording_ || pRect == nullptr)
+      return true;
+
+    if ( sr_gen_   == gen_                &&
+         sr_.left  == pRect->left         && sr_.top    == pRect->top        &&
+         sr_.right == pRect->right        && sr_.bottom == pRect->bottom ) {
+      ++filtered_.scissor_rects;
+      return false;
+    }
+
+    sr_     = *pRect;
+    sr_gen_ =  gen_;
+
+    ++issued_.scissor_rects;
+
+    return true;
+  }
+
+  // The current viewport, if it was set through the cache
+  bool getViewport (D3DVIEWPORT9* pViewport) const
+  {
+    if (vp_gen_ != gen_)
+      return false;
+
+    *pViewport = vp_;
+
+    return true;
+  }
+
+  // SetRenderTarget (0, ...) resets the viewport and scissor rect
+  void targetChanged (void)
+  {
+    vp_gen_ = 0;
+    sr_gen_ = 0;
+  }
+
+  // Forget everything; the next call for every slot goes through
+  void invalidate (void)
+  {
+    // Once every 4 billion invalidations...
+    if (++gen_ == 0)
+    {
+      for ( auto& slot : rs_ )
+        slot.gen = 0;
+
+      for ( auto& sampler : ss_ )
+        for ( auto& slot : sampler )
+          slot.gen = 0;
+
+      vp_gen_ = 0;
+      sr_gen_ = 0;
+      gen_    = 1;
+    }
+  }
+
+  // BeginStateBlock / EndStateBlock
+  void beginRecording (void) { recording_ = true;  }
+  void endRecording   (void) { recording_ = false; }
+  bool recording      (void) const { return recording_; }
+
+  // Latches this frame's counters and starts over
+  void endFrame (void)
+  {
+    last_filtered_ = filtered_;
+    last_issued_   = issued_;
+
+    filtered_ = tbf_state_filter_stats_s ();
+    issued_   = tbf_state_filter_stats_s ();
+  }
+
+  // Counts from the last completed frame
+  const tbf_state_filter_stats_s& filtered (void) const { return last_filtered_; }
+  const tbf_state_filter_stats_s& issued   (void) const { return last_issued_;   }
+
+protected:
+  static DWORD samplerIndex (DWORD Sampler)
+  {
+    if (Sampler < 16)
+      return Sampler;
+
+    if (Sampler >= D3DVERTEXTEXTURESAMPLER0 && Sampler <= D3DVERTEXTEXTURESAMPLER3)
+      return 16 + (Sampler - D3DVERTEXTEXTURESAMPLER0);
+
+    return MAX_SAMPLERS; // D3DDMAPSAMPLER and anything invalid is not cached
+  }
+
+private:
+  struct slot_s {
+    DWORD    value = 0;
+    uint32_t gen   = 0;
+  };
+
+  slot_s                   rs_ [MAX_RENDER_STATES];
+  slot_s                   ss_ [MAX_SAMPLERS][MAX_SAMPLER_STATES];
+
+  D3DVIEWPORT9             vp_     = { };
+  uint32_t                 vp_gen_ = 0;
+  RECT                     sr_     = { };
+  uint32_t                 sr_gen_ = 0;
+
+  uint32_t                 gen_    = 0;
+  bool                     recording_ = false;
+
+  tbf_state_filter_stats_s filtered_,      issued_;
+  tbf_state_filter_stats_s last_filtered_, last_issued_;
+};
+
+#endif /* __TBF__STATE_CACHE_H__ */
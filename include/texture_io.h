@@ -0,0 +1,146 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__TEXTURE_IO_H__
+#define __TBF__TEXTURE_IO_H__
+
+#ifdef _WIN32
+# include <Windows.h>
+# include <unordered_set>
+#else
+# include <condition_variable>
+# include <deque>
+# include <mutex>
+# include <string>
+# include <thread>
+#endif
+
+#include <cstddef>
+
+//
+// A loose texture file as the decoder sees it: a read-only view of the whole
+//   file when it may be memory mapped, and a plain read into the caller's
+//     buffer when it may not.
+//
+//   Mapping saves the copy into a per-thread staging buffer and the buffer
+//     itself; the page cache is the only copy of the file in memory. It is
+//       Win32 in the game and POSIX on the host, where tests/bench_texture_io
+//         runs both ways, and the read-ahead stage below, on the same files.
+//
+class TBF_TextureFile
+{
+public:
+   TBF_TextureFile (void) = default;
+  ~TBF_TextureFile (void) { close (); }
+
+  TBF_TextureFile            (const TBF_TextureFile&) = delete;
+  TBF_TextureFile& operator= (const TBF_TextureFile&) = delete;
+
+  // Maps the file if map is true and it is not empty; a file that will not
+  //   map is still open and can be read.
+  bool        open  (const wchar_t* wszFileName, bool map);
+  void        close (void);
+
+  size_t      size  (void) const { return size_; }
+
+  // nullptr unless the file is mapped
+  const void* view  (void) const { return view_; }
+
+  // Reads up to len bytes from the start of the file, returns the count read
+  size_t      read  (void* pBuffer, size_t len);
+
+  //
+  // Files on a network share (or anything that lives on one through a UNC
+  //   path) must not be mapped; an I/O error while paging in is raised as an
+  //     exception rather than returned from a read.
+  //
+  static bool isRemote (const wchar_t* wszFileName);
+
+private:
+#ifdef _WIN32
+  HANDLE      file_    = INVALID_HANDLE_VALUE;
+  HANDLE      mapping_ = nullptr;
+#else
+  int         fd_      = -1;
+#endif
+  const void* view_    = nullptr;
+  size_t      size_    = 0;
+};
+
+//
+// Reads whole files ahead of the threads that decode them, so that the disk
+//   is busy with the next files while the workers decode the last ones.
+//
+//   Win32 uses overlapped reads on a completion port, the host a reader
+//     thread; either way one thread calls complete for every read that
+//       submit accepted, with the data in a malloc'd buffer the callee owns,
+//         or nullptr if the read failed or was cancelled by the destructor.
+//
+class TBF_ReadAhead
+{
+public:
+  typedef void (*complete_fn)(void* user, void* pData, size_t size);
+
+   TBF_ReadAhead (complete_fn complete, size_t max_bytes_in_flight);
+  ~TBF_ReadAhead (void);
+
+  TBF_ReadAhead            (const TBF_ReadAhead&) = delete;
+  TBF_ReadAhead& operator= (const TBF_ReadAhead&) = delete;
+
+  bool   running  (void) const;
+
+  // false if the read was not queued (no stage, no file, or it would go
+  //   over the budget); complete is then not called for it
+  bool   submit   (const wchar_t* wszFileName, void* user);
+
+  size_t inFlight (void);
+
+private:
+  struct read_s;
+
+  complete_fn                complete_;
+  size_t                     max_bytes_;
+
+  size_t                     reads_in_flight_ = 0;
+  size_t                     bytes_in_flight_ = 0;
+  bool                       closing_         = false;
+
+#ifdef _WIN32
+  static unsigned int __stdcall CompletionThread (LPVOID user);
+
+  HANDLE                        iocp_         = nullptr;
+  HANDLE                        thread_       = nullptr;
+
+  // Outstanding reads, so that they can be cancelled
+  CRITICAL_SECTION              cs_reads_;
+  std::unordered_set <read_s *> reads_;
+#else
+  void                          readerThread (void);
+
+  std::thread                   thread_;
+  std::mutex                    lock_;
+  std::condition_variable       queued_;
+  std::deque <read_s *>         reads_;
+#endif
+};
+
+#endif /* __TBF__TEXTURE_IO_H__ */
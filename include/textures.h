@@ -28,6 +28,8 @@
 extern iSK_Logger* tex_log;
 
 #include "render.h"
+#include "classifier.h"
+#include "inject_index.h"
 #include <d3d9.h>
 
 #include <set>
@@ -163,6 +165,7 @@ namespace RenderFix {
     void                     addTexture (uint32_t crc32, tbf::RenderFix::Texture* pTex, size_t size);
 
     bool                     reloadTexture (uint32_t crc32);
+    bool                     injectTexture (uint32_t crc32);
 
     // Record a cached reference
     void                     refTexture  (tbf::RenderFix::Texture* pTex);
@@ -214,6 +217,7 @@ namespace RenderFix {
     void                     queueScreenshot      (wchar_t* wszFileName, bool hudless = true);
     bool                     wantsScreenshot      (void);
     HRESULT                  takeScreenshot       (IDirect3DSurface9* pSurf);
+    void                     readBackScreenshot   (void);
 
     std::vector<tbf_tex_thread_stats_s>
                              getThreadStats       (void);
@@ -234,6 +238,8 @@ namespace RenderFix {
 
 
   private:
+    void                     streamInjection (uint32_t crc32, ISKTextureD3D9* pTex);
+
     struct {
       // In lieu of actually wrapping render targets with a COM interface, just add the creation time
       //   as the mapped parameter
@@ -241,7 +247,7 @@ namespace RenderFix {
     } known;
     
     struct {
-      std::unordered_set <IDirect3DBaseTexture9 *> render_targets;
+      TBF_FrameSetT <IDirect3DBaseTexture9 *>      render_targets;
     } used;
 
     std::unordered_map <uint32_t, tbf::RenderFix::Texture*> textures;
@@ -267,6 +273,8 @@ namespace RenderFix {
 
 const GUID IID_SKTextureD3D9 = { 0xace1f81b, 0x5f3f, 0x45f4, 0xbf, 0x9f, 0x1b, 0xaf, 0xdf, 0xba, 0x11, 0x9b };
 
+extern void* ISKTextureD3D9_vftable;
+
 interface ISKTextureD3D9 : public IDirect3DTexture9
 {
 public:
@@ -274,14 +282,19 @@ public:
          pTexOverride  = nullptr;
          can_free      = true;
          override_size = 0;
-         last_used.QuadPart
-                       = 0ULL;
+         last_used     = 0UL;
          pTex          = *ppTex;
        *ppTex          =  this;
          tex_size      = size;
          tex_crc32     = crc32;
          must_block    = false;
          refs          =  1;
+         created.QuadPart
+                       = 0ULL;
+         bind_pending  = false;
+         npot          = false;
+
+         ISKTextureD3D9_vftable = *(void **)this;
      };
 
     /*** IUnknown methods ***/
@@ -457,11 +470,24 @@ public:
     SSIZE_T            override_size; //   Override data size
 
     ULONG              refs;
-    LARGE_INTEGER      last_used;     // The last time this texture was used (for rendering)
+    uint32_t           last_used;     // The last frame this texture was used in (for rendering)
                                       //   different from the last time referenced, this is
                                       //     set when SetTexture (...) is called.
+    LARGE_INTEGER      created;       // When the game created it (injected textures only)
+    bool               bind_pending;  //   ... and its first bind has not been measured yet
+    bool               npot;          // Non-power-of-two in one dimension (clamp its coordinates)
 };
 
+//
+// Wrapped textures are recognized by their vtable; QueryInterface on every
+//   single SetTexture call was measurably expensive.
+//
+__forceinline bool
+TBF_IsWrappedTexture (IDirect3DBaseTexture9* pTex)
+{
+  return pTex != nullptr && *(void **)pTex == ISKTextureD3D9_vftable;
+}
+
 typedef HRESULT (STDMETHODCALLTYPE *D3DXCreateTextureFromFileInMemoryEx_pfn)
 ( _In_        LPDIRECT3DDEVICE9  pDevice,
   _In_        LPCVOID            pSrcData,
@@ -624,18 +650,14 @@ TBF_IsTextureDumped (uint32_t checksum);
 bool
 TBF_DeleteDumpedTexture (D3DFORMAT fmt, uint32_t checksum);
 
-enum tbf_load_method_t {
-  Streaming,
-  Blocking,
-  DontCare
-};
+bool
+TBF_IsTextureDumpPacked (uint32_t checksum);
 
-struct tbf_tex_record_s {
-  unsigned int               archive = std::numeric_limits <unsigned int>::max ();
-           int               fileno  = 0UL;
-  enum     tbf_load_method_t method  = DontCare;
-           size_t            size    = 0UL;
-};
+bool
+TBF_ExtractDumpedTexture (uint32_t checksum);
+
+int
+TBF_ExtractDumpPack (void);
 
 std::vector <std::wstring>
 TBF_GetTextureArchives (void);
@@ -649,6 +671,28 @@ TBF_GetInjectableTexture (uint32_t checksum);
 void
 TBF_RefreshDataSources (void);
 
+// Packs every injectable texture on a worker thread; the finished pack is
+//   swapped in by TBF_ProcessInjectableChanges
+bool
+TBF_StartTexturePackBuild (bool compress);
+
+bool
+TBF_IsBuildingTexturePack (uint32_t* pDone = nullptr, uint32_t* pTotal = nullptr);
+
+void
+TBF_SaveWarmStartSet (void);
+
+struct tbf_resident_pool_stats_s {
+  size_t textures = 0;
+  size_t total    = 0;
+  size_t bytes    = 0;
+  double time_ms  = 0.0;  // Preload time, once finished
+  bool   loading  = false;
+};
+
+tbf_resident_pool_stats_s
+TBF_GetResidentPoolStats (void);
+
 __forceinline uint32_t
 TBF_NextPowerOfTwo (uint32_t n)
 {
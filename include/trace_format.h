@@ -0,0 +1,99 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__TRACE_FORMAT_H__
+#define __TBF__TRACE_FORMAT_H__
+
+#include <cstdint>
+
+//
+// On-disk layout of a call trace (TBFix_Res\traces\trace_<tick>.bin), shared
+//   by the recorder in the plugin and the host replay tool:
+//
+//     tbf_trace_header_s
+//     tbf_trace_record_s [...]   record_size bytes each, until end of file
+//
+//   Version 1 had a 32-bit record time, which wraps after ~7 minutes at the
+//     usual 10 MHz QPC frequency; it is otherwise identical to version 2.
+//
+#define TBF_TRACE_MAGIC   0x54464254UL // 'TBFT'
+#define TBF_TRACE_VERSION 2UL
+
+enum class tbf_trace_op : uint8_t {
+  EndFrame                  =  0, // args: frame number, frame time (ticks)
+  SetVertexShader           =  1, // args: crc32
+  SetPixelShader            =  2, // args: crc32
+  SetTexture                =  3, // slot: sampler, args: tex_crc32
+  SetRenderTarget           =  4, // slot: index,   args: width, height
+  SetStreamSource           =  5, // slot: stream,  args: offset, stride, dynamic
+  SetVertexShaderConstantF  =  6, // slot: start,   args: count, c[0].x, c[0].y
+  SetPixelShaderConstantF   =  7, // slot: start,   args: count, c[0].x, c[0].y
+  DrawPrimitive             =  8, // slot: type,    args: start vertex, primitives
+  DrawIndexedPrimitive      =  9, // slot: type,    args: vertices, start index, primitives
+  DrawPrimitiveUP           = 10, // slot: type,    args: primitives, stride
+  DrawIndexedPrimitiveUP    = 11, // slot: type,    args: vertices, primitives, stride
+
+  // Everything that goes through TBF_StateCache, whether issued by the game
+  //   or by the hooks; filtered calls carry TBF_TRACE_SKIPPED
+  SetRenderState            = 12, // slot: state,   args: value
+  SetSamplerState           = 13, // slot: sampler, args: type, value
+  SetViewport               = 14, // args: x << 16 | y, width, height (Z range not kept)
+  SetScissorRect            = 15, // args: left << 16 | top, right, bottom
+
+  Count
+};
+
+#pragma pack (push, 1)
+struct tbf_trace_header_s {
+  uint32_t magic;        // TBF_TRACE_MAGIC
+  uint32_t version;      // TBF_TRACE_VERSION
+  uint32_t record_size;  // sizeof (tbf_trace_record_s)
+  uint32_t ops;          // tbf_trace_op::Count when recorded
+  int64_t  frequency;    // Ticks per second
+};
+
+struct tbf_trace_record_s {
+  uint8_t  op;
+  uint8_t  flags;    // TBF_TRACE_SKIPPED, ...
+  uint16_t slot;
+  uint64_t time;     // Ticks since capture began
+  uint32_t cost;     // Ticks spent inside the detour
+  uint32_t args [3];
+};
+
+// Version 1 records, for readers
+struct tbf_trace_record_v1_s {
+  uint8_t  op;
+  uint8_t  flags;
+  uint16_t slot;
+  uint32_t time;
+  uint32_t cost;
+  uint32_t args [3];
+};
+#pragma pack (pop)
+
+// The hooks answered the call themselves; the driver never saw it
+#define TBF_TRACE_SKIPPED  0x01
+// The hooks changed what the driver was given (constants, shader, texture)
+#define TBF_TRACE_MODIFIED 0x02
+
+#endif /* __TBF__TRACE_FORMAT_H__ */
@@ -0,0 +1,112 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__USAGE_MODEL_H__
+#define __TBF__USAGE_MODEL_H__
+
+#include <Windows.h>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+// One session's first uses of injectable textures, (checksum, frame) in order
+typedef std::vector <std::pair <uint32_t, uint32_t>> tbf_usage_session_t;
+
+//
+// How a model did on recorded sessions: a first use is covered if it was
+//   predicted earlier in the same session, lead_frames adds up how much
+//     earlier. Precision is covered / predicted, recall covered / first_uses.
+//
+struct tbf_usage_eval_s {
+  uint64_t first_uses  = 0;
+  uint64_t predicted   = 0;
+  uint64_t covered     = 0;
+  uint64_t lead_frames = 0;
+};
+
+//
+// Learns which injectable textures tend to be used shortly after each other
+//   (first use within a session, in frames) and predicts the rest of a set
+//     once its first members show up.
+//
+//   Every session is also appended to a trace, from which tools/usage_model
+//     trains and evaluates the model offline exactly the way the game does.
+//
+class TBF_TextureUsageModel
+{
+public:
+  static const uint16_t WEIGHT_HIT     = 4;
+  static const uint16_t WEIGHT_PREDICT = 6;      // Seen in at least two sessions
+
+  bool load          (const wchar_t* wszFileName);
+  bool save          (const wchar_t* wszFileName);
+
+  // Returns false if the checksum was already seen this session
+  bool firstUse      (uint32_t checksum, uint32_t frame);
+  void predict       (uint32_t checksum, std::vector <uint32_t>& out,
+                      uint16_t min_weight = WEIGHT_PREDICT) const;
+
+  // Folds the current session into the model
+  void commitSession (void);
+
+  // The current session, appended to a trace; false once it is full
+  bool appendSession (const wchar_t* wszTraceFile) const;
+
+  // Every complete session in a trace, oldest first
+  static bool
+       loadSessions  (const wchar_t* wszTraceFile, std::vector <tbf_usage_session_t>& sessions);
+
+  // Learns from a recorded session as if it had just been played
+  void trainSession  (const tbf_usage_session_t& session);
+
+  // Replays a recorded session against the model without learning from it
+  void evaluate      (const tbf_usage_session_t& session, uint16_t min_weight,
+                      tbf_usage_eval_s&          eval) const;
+
+  size_t numKeys     (void) const { return successors_.size (); }
+
+protected:
+  static const uint32_t MAGIC          = 0x55464254UL; // 'TBFU'
+  static const uint32_t VERSION        = 1UL;
+
+  static const uint32_t TRACE_MAGIC    = 0x54464254UL; // 'TBFT'
+  static const uint32_t TRACE_VERSION  = 1UL;
+  static const long     MAX_TRACE_SIZE = 16L * 1024L * 1024L;
+
+  static const uint32_t WINDOW_FRAMES  = 300UL;  // ~5 seconds at 60 FPS
+  static const size_t   MAX_SUCCESSORS = 32;
+
+  struct successor_s {
+    uint32_t checksum;
+    uint16_t weight;
+  };
+
+private:
+  std::unordered_map <uint32_t, std::vector <successor_s>> successors_;
+
+  tbf_usage_session_t                                      session_;
+  std::unordered_set <uint32_t>                            session_seen_;
+};
+
+#endif /* __TBF__USAGE_MODEL_H__ */
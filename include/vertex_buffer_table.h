@@ -0,0 +1,205 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__VERTEX_BUFFER_TABLE_H__
+#define __TBF__VERTEX_BUFFER_TABLE_H__
+
+#include <cstdint>
+#include <vector>
+
+enum class tbf_vb_usage : uint8_t {
+  Unknown   = 0, // Never seen created, or released since
+  Immutable = 1,
+  Dynamic   = 2
+};
+
+//
+// Vertex buffer object -> how it was created. Entries follow the buffers'
+//   lifetime: created () when the game makes one, released () when its last
+//     reference goes, so the table holds only live buffers no matter how long
+//       the session runs, and an address the allocator hands out again starts
+//         from a fresh classification.
+//
+//   Open-addressed with backward-shift deletion, no tombstones to build up.
+//
+//   Not thread-safe; the caller serializes access.
+//
+class TBF_VertexBufferTable
+{
+public:
+  explicit TBF_VertexBufferTable (size_t capacity = 4096)
+  {
+    size_t slots = 16;
+
+    while (slots < capacity * 2)
+      slots <<= 1;
+
+    slots_.resize (slots);
+  }
+
+  // Also what a re-used address goes through; the old entry is overwritten
+  void created (const void* pBuffer, bool dynamic)
+  {
+    if (pBuffer == nullptr)
+      return;
+
+    const tbf_vb_usage usage =
+      dynamic ? tbf_vb_usage::Dynamic : tbf_vb_usage::Immutable;
+
+    const size_t idx = lookup (pBuffer);
+
+    if (idx != NONE)
+    {
+      slots_ [idx].usage = usage;
+      return;
+    }
+
+    if ((count_ + 1) * 2 > slots_.size ())
+      grow ();
+
+    place (pBuffer, usage);
+  }
+
+  tbf_vb_usage find (const void* pBuffer) const
+  {
+    const size_t idx = lookup (pBuffer);
+
+    return idx != NONE ? slots_ [idx].usage : tbf_vb_usage::Unknown;
+  }
+
+  // Returns false for buffers the table never knew about
+  bool released (const void* pBuffer)
+  {
+    size_t hole = lookup (pBuffer);
+
+    if (hole == NONE)
+      return false;
+
+    const size_t mask = slots_.size () - 1;
+          size_t idx  = (hole + 1) & mask;
+
+    // Pull back every entry in the run that would no longer be reachable
+    //   from its home slot across the hole
+    while (slots_ [idx].ptr != nullptr)
+    {
+      const size_t home = hash (slots_ [idx].ptr) & mask;
+
+      if (((idx - home) & mask) >= ((idx - hole) & mask))
+      {
+        slots_ [hole] = slots_ [idx];
+        hole          = idx;
+      }
+
+      idx = (idx + 1) & mask;
+    }
+
+    slots_ [hole] = slot_s ();
+
+    --count_;
+
+    return true;
+  }
+
+  void clear (void)
+  {
+    for ( auto& slot : slots_ )
+      slot = slot_s ();
+
+    count_ = 0;
+  }
+
+  size_t size     (void) const { return count_;             }
+  size_t capacity (void) const { return slots_.size () / 2; }
+
+protected:
+  struct slot_s {
+    const void*  ptr   = nullptr;
+    tbf_vb_usage usage = tbf_vb_usage::Unknown;
+  };
+
+  static size_t hash (const void* ptr)
+  {
+    // Heap objects, at least 8-byte aligned
+    uintptr_t h = (uintptr_t)ptr >> 3;
+
+    h ^= (h >> 16);
+    h *= 0x9E3779B1UL;
+
+    return (size_t)(h ^ (h >> 16));
+  }
+
+  static const size_t NONE = SIZE_MAX;
+
+  size_t lookup (const void* pBuffer) const
+  {
+    if (pBuffer == nullptr)
+      return NONE;
+
+    const size_t mask = slots_.size () - 1;
+          size_t idx  = hash (pBuffer) & mask;
+
+    while (slots_ [idx].ptr != nullptr)
+    {
+      if (slots_ [idx].ptr == pBuffer)
+        return idx;
+
+      idx = (idx + 1) & mask;
+    }
+
+    return NONE;
+  }
+
+  void place (const void* pBuffer, tbf_vb_usage usage)
+  {
+    const size_t mask = slots_.size () - 1;
+          size_t idx  = hash (pBuffer) & mask;
+
+    while (slots_ [idx].ptr != nullptr)
+      idx = (idx + 1) & mask;
+
+    slots_ [idx].ptr   = pBuffer;
+    slots_ [idx].usage = usage;
+
+    ++count_;
+  }
+
+  void grow (void)
+  {
+    std::vector <slot_s> old;
+    old.swap (slots_);
+
+    slots_.assign (old.size () * 2, slot_s ());
+    count_ = 0;
+
+    for ( auto& slot : old )
+    {
+      if (slot.ptr != nullptr)
+        place (slot.ptr, slot.usage);
+    }
+  }
+
+private:
+  std::vector <slot_s> slots_;
+  size_t               count_ = 0;
+};
+
+#endif /* __TBF__VERTEX_BUFFER_TABLE_H__ */
@@ -0,0 +1,94 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__WARM_START_H__
+#define __TBF__WARM_START_H__
+
+#include <Windows.h>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+//
+// The injected textures a session actually used, in order of first use and
+//   with the number of frames each was bound in; the next launch reads them
+//     ahead so the title screen / camp / first town do not start cold.
+//
+struct tbf_warm_entry_s {
+  uint32_t checksum;
+  uint32_t first_frame;
+  uint32_t frames_used;
+};
+
+class TBF_WarmStartSet
+{
+public:
+  void   use  (uint32_t checksum, uint32_t frame);
+
+  bool   save (const wchar_t* wszFileName) const;
+
+  // Sorted by first use, the most frequently used first among ties
+  static bool
+         load (const wchar_t* wszFileName, std::vector <tbf_warm_entry_s>& entries);
+
+  size_t size (void) const { return session_.size (); }
+
+  //
+  // The checksums to stage from a loaded list: entries keep their order, those
+  //   whose size_of is 0 (no longer injectable) are skipped, and the first one
+  //     that would go over budget ends the plan so that nothing used later is
+  //       staged ahead of something used earlier.
+  //
+  template <typename SizeOf>
+  static std::vector <uint32_t>
+         plan (const std::vector <tbf_warm_entry_s>& entries, size_t budget, SizeOf size_of)
+  {
+    std::vector <uint32_t> checksums;
+    size_t                 bytes = 0;
+
+    for ( auto& entry : entries )
+    {
+      const size_t size =
+        size_of (entry.checksum);
+
+      if (size == 0)
+        continue;
+
+      if (bytes + size > budget)
+        break;
+
+      bytes += size;
+      checksums.push_back (entry.checksum);
+    }
+
+    return checksums;
+  }
+
+protected:
+  static const uint32_t MAGIC   = 0x57464254UL; // 'TBFW'
+  static const uint32_t VERSION = 1UL;
+
+private:
+  std::unordered_map <uint32_t, tbf_warm_entry_s> session_;
+};
+
+#endif /* __TBF__WARM_START_H__ */
@@ -811,6 +811,50 @@ TBFix_DrawConfigUI (void)
       ImGui::EndChild     ( );
       ImGui::PopStyleVar  ( );
 
+      if (ImGui::Checkbox ("Keep Blocking Textures Resident in RAM", &config.textures.resident_blocking))
+        need_restart = true;
+
+      if (ImGui::IsItemHovered ())
+        ImGui::SetTooltip ("Reads every texture in inject/textures/blocking (or blocking textures in archives) into RAM at startup, so they never stall on disk or decompression.");
+
+      if (config.textures.resident_blocking)
+      {
+        tbf_resident_pool_stats_s pool =
+          TBF_GetResidentPoolStats ();
+
+        ImGui::SameLine ();
+
+        if (pool.loading)
+          ImGui::TextColored ( ImVec4 (0.95f, 0.75f, 0.25f, 1.0f),
+                                 "Preloading...  %zu / %zu textures  (%.2f MiB)",
+                                   pool.textures, pool.total,
+                                     (double)pool.bytes / (1024.0 * 1024.0) );
+        else if (pool.total > 0)
+          ImGui::Text        ( "%zu textures,  %.2f MiB  -  preloaded in %.3f s",
+                                 pool.textures,
+                                   (double)pool.bytes / (1024.0 * 1024.0),
+                                     pool.time_ms / 1000.0 );
+      }
+
+      ImGui::Checkbox ("Drop Redundant Render State Changes", &config.render.filter_state);
+
+      if (ImGui::IsItemHovered ())
+        ImGui::SetTooltip ("Keeps a copy of the render state, sampler state, viewport and scissor rect sent to the driver and skips calls that would not change any of them.");
+
+      if (config.render.filter_state)
+      {
+        const tbf_state_filter_stats_s& filtered =
+          tbf::RenderFix::state_cache.filtered ();
+        const tbf_state_filter_stats_s& issued   =
+          tbf::RenderFix::state_cache.issued   ();
+
+        ImGui::SameLine ();
+        ImGui::Text     ( "%lu / %lu calls filtered last frame  (%lu render, %lu sampler, %lu viewport, %lu scissor)",
+                            filtered.total (), filtered.total () + issued.total (),
+                              filtered.render_states, filtered.sampler_states,
+                                filtered.viewports,     filtered.scissor_rects );
+      }
+
       if (ImGui::CollapsingHeader ("Thread Stats"))
       {
         std::vector <tbf_tex_thread_stats_s> stats =
@@ -1226,6 +1270,35 @@ TBFix_DrawConfigUI (void)
     }
   }
 
+  if (ImGui::CollapsingHeader ("Adaptive Quality"))
+  {
+    ImGui::TreePush ("");
+
+    tbf::RenderFix::need_reset.graphics |=
+      ImGui::Checkbox ("Lower Shadow / Post-Processing Quality to Hold Framerate", &config.render.adaptive_quality);
+
+    if (ImGui::IsItemHovered ())
+    {
+      ImGui::BeginTooltip ();
+      ImGui::Text         ("Steps the settings above down one notch at a time when the target framerate is missed, and back up once it is met again.");
+      ImGui::BulletText   ("Order: High-Res Reflection, High-Res Bloom, then Environment Shadows, Character Shadows and Depth of Field in turn.");
+      ImGui::BulletText   ("Every step re-creates render targets (a brief hitch), so it waits at least 10 seconds between steps.");
+      ImGui::EndTooltip   ();
+    }
+
+    if (config.render.adaptive_quality)
+    {
+      ImGui::SliderFloat ("Target Framerate",     &config.render.adaptive_target_fps, 20.0f, 144.0f, "%.0f FPS");
+      ImGui::SliderInt   ("Maximum Steps Down",   &config.render.adaptive_max_steps,  1,     12);
+
+      ImGui::Text        ( "Current Level: %li steps down  (%.2f ms average)",
+                             tbf::RenderFix::governor.level   (),
+                               tbf::RenderFix::governor.average () );
+    }
+
+    ImGui::TreePop ();
+  }
+
   if (ImGui::CollapsingHeader ("Aspect Ratio"))
   {
     ImGui::TreePush ("");
@@ -35,6 +35,8 @@
 #include "command.h"
 #include "render.h"
 #include "textures.h"
+#include "shader_disasm.h"
+#include "shader_inject.h"
 
 #include <atlbase.h>
 
@@ -269,6 +271,47 @@ TBF_DrawFileList (bool& can_scroll)
       tbf::RenderFix::TriggerReset ();
     }
 
+    static bool compress_pack = false;
+    static bool building_pack = false;
+
+    uint32_t pack_done  = 0,
+             pack_total = 0;
+
+    if (TBF_IsBuildingTexturePack (&pack_done, &pack_total))
+    {
+      building_pack = true;
+
+      ImGui::Text ("Building Texture Pack... %lu / %lu", pack_done, pack_total);
+    }
+
+    else
+    {
+      // The new pack replaced the data sources listed above
+      if (building_pack)
+      {
+        building_pack = false;
+        list_dirty    = true;
+      }
+
+      if (ImGui::Button ("  Build Texture Pack  "))
+        TBF_StartTexturePackBuild (compress_pack);
+
+      if (ImGui::IsItemHovered ())
+      {
+        ImGui::BeginTooltip ();
+        ImGui::Text         ("Combines all of the data sources above into TBFix_Res\\inject\\textures.tbfpack");
+        ImGui::Separator    ();
+        ImGui::BulletText   ("Texture packs are memory mapped and load faster than .7z archives");
+        ImGui::BulletText   ("Loose files still take priority over the pack; archives can be removed afterwards");
+        ImGui::BulletText   ("The pack is built in the background and replaces the old one when finished");
+        ImGui::EndTooltip   ();
+      }
+
+      ImGui::SameLine ();
+
+      ImGui::Checkbox ("Compress", &compress_pack);
+    }
+
     ImGui::EndGroup ();
   }
 
@@ -276,8 +319,9 @@ TBF_DrawFileList (bool& can_scroll)
 }
 
 
-extern std::unordered_map <uint32_t, tbf::RenderFix::shader_disasm_s> ps_disassembly;
-extern std::unordered_map <uint32_t, tbf::RenderFix::shader_disasm_s> vs_disassembly;
+extern const tbf::RenderFix::shader_disasm_s*
+TBF_GetShaderDisassembly ( tbf_shader_stage                   stage,
+                           tbf::RenderFix::shader_tracking_s* tracker );
 
 enum class tbf_shader_class {
   Unknown = 0x00,
@@ -323,9 +367,16 @@ TBF_LiveShaderClassView (tbf_shader_class shader_type, bool& can_scroll)
                 shader_type == tbf_shader_class::Pixel ? tbf::RenderFix::last_frame.pixel_shaders.end    () :
                                                          tbf::RenderFix::last_frame.vertex_shaders.end   () );
 
-  std::unordered_map <uint32_t, tbf::RenderFix::shader_disasm_s>&
-    disassembly = ( shader_type == tbf_shader_class::Pixel ? ps_disassembly :
-                                                             vs_disassembly );
+  // Disassembled in the background the first time a shader is shown here
+  static const tbf::RenderFix::shader_disasm_s pending = { "Disassembling...", " ", " " };
+
+  const tbf::RenderFix::shader_disasm_s*
+    disassembly = TBF_GetShaderDisassembly ( shader_type == tbf_shader_class::Pixel ? tbf_shader_stage::Pixel :
+                                                                                       tbf_shader_stage::Vertex,
+                                               tracker );
+
+  if (disassembly == nullptr)
+    disassembly = &pending;
 
   const char*
     szShaderWord =  shader_type == tbf_shader_class::Pixel ? "Pixel" :
@@ -546,7 +597,7 @@ TBF_LiveShaderClassView (tbf_shader_class shader_type, bool& can_scroll)
     }
 
     ImGui::PushStyleColor (ImGuiCol_Text, ImVec4 (0.80f, 0.80f, 1.0f, 1.0f));
-    ImGui::TextWrapped    (disassembly [tracker->crc32].header.c_str ());
+    ImGui::TextWrapped    (disassembly->header.c_str ());
 
     ImGui::SameLine       ();
     ImGui::BeginGroup     ();
@@ -623,12 +674,12 @@ TBF_LiveShaderClassView (tbf_shader_class shader_type, bool& can_scroll)
     ImGui::Separator      ();
 
     ImGui::PushStyleColor (ImGuiCol_Text, ImVec4 (0.99f, 0.99f, 0.01f, 1.0f));
-    ImGui::TextWrapped    (disassembly [tracker->crc32].code.c_str ());
+    ImGui::TextWrapped    (disassembly->code.c_str ());
 
     ImGui::Separator      ();
 
     ImGui::PushStyleColor (ImGuiCol_Text, ImVec4 (0.5f, 0.95f, 0.5f, 1.0f));
-    ImGui::TextWrapped    (disassembly [tracker->crc32].footer.c_str ());
+    ImGui::TextWrapped    (disassembly->footer.c_str ());
 
     ImGui::PopStyleColor (4);
   }
@@ -849,8 +900,8 @@ TBF_LiveVertexStreamView (bool& can_scroll)
 
 
   if ( tracker->vertex_buffer != nullptr &&
-         ( tbf::RenderFix::last_frame.vertex_buffers.dynamic.count   (tracker->vertex_buffer) ||
-           tbf::RenderFix::last_frame.vertex_buffers.immutable.count (tracker->vertex_buffer) ) )
+         ( tbf::RenderFix::last_frame.vertex_buffers.dynamic.contains   (tracker->vertex_buffer) ||
+           tbf::RenderFix::last_frame.vertex_buffers.immutable.contains (tracker->vertex_buffer) ) )
   {
     bool wireframe = tracker->wireframes.count (tracker->vertex_buffer);
 
@@ -1173,7 +1224,7 @@ TBFix_TextureModDlg (void)
       ImGui::BeginTooltip ();
       ImGui::TextColored  (ImVec4 (0.9f, 0.7f, 0.3f, 1.f), "Enable dumping DXT compressed textures from VRAM.");
       ImGui::Separator    ();
-      ImGui::Text         ("Drivers may not be able to manage texture memory as efficiently, and you should turn this option off when not modifying textures.\n\n");
+      ImGui::Text         ("The original data of recently loaded textures (up to 128 MiB) is kept in memory, you should turn this option off when not modifying textures.\n\n");
       ImGui::BulletText   ("If this is your first time enabling this feature, the dump button will not work until you reload all textures in-game.");
       ImGui::EndTooltip   ();
     }
@@ -1369,6 +1420,21 @@ TBFix_TextureModDlg (void)
               ImGui::SetTooltip ("Turn off Texture QuickLoad to use this feature.");
           }
 
+          else if (TBF_IsTextureDumpPacked (debug_tex_id))
+          {
+            if ( ImGui::Button ("  Extract Dumped Texture from Pack  ") )
+            {
+              TBF_ExtractDumpedTexture (debug_tex_id);
+            }
+
+            ImGui::SameLine ();
+
+            if ( ImGui::Button ("  Delete Dumped Texture from Pack  ") )
+            {
+              TBF_DeleteDumpedTexture (desc.Format, debug_tex_id);
+            }
+          }
+
           else
           {
             if ( ImGui::Button ("  Delete Dumped Texture from Disk  ") )
@@ -1705,6 +1771,19 @@ TBFix_TextureModDlg (void)
   {
     ImGui::TreePush ("");
     if (ImGui::Checkbox ("Dump ALL Shaders   (TBFix_Res\\dump\\shaders\\<ps|vs>_<checksum>.html)", &config.render.dump_shaders)) tbf::RenderFix::need_reset.graphics = true;
+    ImGui::Checkbox     ("Use Replacement Shaders (TBFix_Res\\inject\\shaders\\<ps|vs>_<checksum>.cso)", &config.render.inject_shaders);
+
+    if (ImGui::IsItemHovered ())
+    {
+      extern TBF_ShaderInjector shader_inject;
+
+      ImGui::BeginTooltip ();
+      ImGui::Text         ("Precompiled shaders bound in place of the game's own; they must use the same constants and samplers.");
+      ImGui::Separator    ();
+      ImGui::BulletText   ("%lu replacement(s) found, %lu in use", shader_inject.numFiles (), shader_inject.numLoaded ());
+      ImGui::EndTooltip   ();
+    }
+
     if (ImGui::Checkbox ("Dump ALL Textures  (TBFix_Res\\dump\\textures\\<format>\\*.dds)",        &config.textures.dump))       tbf::RenderFix::need_reset.graphics = true;
 
     if (ImGui::IsItemHovered ())
@@ -1714,6 +1793,14 @@ TBFix_TextureModDlg (void)
       ImGui::EndTooltip   ();
     }
 
+    ImGui::Checkbox ("Dump to a single pack file  (TBFix_Res\\dump\\textures.dumppack)", &config.textures.dump_to_pack);
+
+    if (ImGui::IsItemHovered ())
+      ImGui::SetTooltip ("Avoids creating tens of thousands of small files; takes effect the next time the game starts.");
+
+    if (ImGui::Button ("  Extract All Textures from Dump Pack  "))
+      TBF_ExtractDumpPack ();
+
     ImGui::TreePop ();
   }
 
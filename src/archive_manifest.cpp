@@ -0,0 +1,172 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "archive_manifest.h"
+
+bool
+TBF_ArchiveManifest::load (const wchar_t* wszFileName)
+{
+  archives_.clear ();
+
+  FILE* fManifest =
+    _wfopen (wszFileName, L"rb");
+
+  if (fManifest == nullptr)
+    return false;
+
+  // Nothing read from the file is allowed to ask for more than it holds
+  fseek (fManifest, 0, SEEK_END);
+  const long file_size = ftell (fManifest);
+  fseek (fManifest, 0, SEEK_SET);
+
+  uint32_t magic   = 0,
+           version = 0,
+           count   = 0;
+
+  bool ok =
+    fread (&magic,   sizeof (uint32_t), 1, fManifest) == 1 && magic   == MAGIC   &&
+    fread (&version, sizeof (uint32_t), 1, fManifest) == 1 && version == VERSION &&
+    fread (&count,   sizeof (uint32_t), 1, fManifest) == 1;
+
+  for (uint32_t arc = 0; ok && arc < count; arc++)
+  {
+    tbf_archive_scan_s scan;
+
+    uint32_t path_len    = 0,
+             num_entries = 0;
+
+    ok = fread (&path_len, sizeof (uint32_t), 1, fManifest) == 1 && path_len < MAX_PATH_LEN;
+
+    if (! ok)
+      break;
+
+    scan.path.resize (path_len);
+
+    ok = ( path_len == 0 || fread (&scan.path [0], path_len * sizeof (wchar_t), 1, fManifest) == 1 ) &&
+           fread (&scan.size,       sizeof (uint64_t), 1, fManifest) == 1                          &&
+           fread (&scan.last_write, sizeof (uint64_t), 1, fManifest) == 1                          &&
+           fread (&num_entries,     sizeof (uint32_t), 1, fManifest) == 1;
+
+    if (! ok)
+      break;
+
+    const long remaining =
+      file_size - ftell (fManifest);
+
+    ok = (uint64_t)num_entries * sizeof (tbf_archive_entry_s) <= (uint64_t)remaining;
+
+    if (! ok)
+      break;
+
+    scan.entries.resize (num_entries);
+
+    ok = num_entries == 0 ||
+           fread ( scan.entries.data (),
+                     num_entries * sizeof (tbf_archive_entry_s), 1, fManifest ) == 1;
+
+    if (! ok)
+      break;
+
+    scan.cached = true;
+    scan.valid  = true;
+
+    archives_.emplace (scan.path, std::move (scan));
+  }
+
+  fclose (fManifest);
+
+  return ok;
+}
+
+bool
+TBF_ArchiveManifest::save (const wchar_t* wszFileName, const std::vector <tbf_archive_scan_s>& scans)
+{
+  FILE* fManifest =
+    _wfopen (wszFileName, L"wb");
+
+  if (fManifest == nullptr)
+    return false;
+
+  uint32_t magic   = MAGIC,
+           version = VERSION,
+           count   = 0;
+
+  for ( auto& scan : scans )
+    if (scan.valid) ++count;
+
+  fwrite (&magic,   sizeof (uint32_t), 1, fManifest);
+  fwrite (&version, sizeof (uint32_t), 1, fManifest);
+  fwrite (&count,   sizeof (uint32_t), 1, fManifest);
+
+  for ( auto& scan : scans )
+  {
+    if (! scan.valid)
+      continue;
+
+    uint32_t path_len    = (uint32_t)scan.path.length (),
+             num_entries = (uint32_t)scan.entries.size ();
+
+    fwrite (&path_len,          sizeof (uint32_t),                1, fManifest);
+    fwrite (scan.path.c_str (), path_len * sizeof (wchar_t),      1, fManifest);
+    fwrite (&scan.size,         sizeof (uint64_t),                1, fManifest);
+    fwrite (&scan.last_write,   sizeof (uint64_t),                1, fManifest);
+    fwrite (&num_entries,       sizeof (uint32_t),                1, fManifest);
+
+    if (num_entries > 0)
+      fwrite (scan.entries.data (), num_entries * sizeof (tbf_archive_entry_s), 1, fManifest);
+  }
+
+  const bool ok =
+    ferror (fManifest) == 0;
+
+  fclose (fManifest);
+
+  return ok;
+}
+
+std::vector <tbf_archive_scan_s*>
+TBF_ArchiveManifest::apply (std::vector <tbf_archive_scan_s>& scans)
+{
+  std::vector <tbf_archive_scan_s*> dirty;
+
+  for ( auto& scan : scans )
+  {
+    auto cached =
+      archives_.find (scan.path);
+
+    if ( cached != archives_.end ()                 &&
+         cached->second.size       == scan.size       &&
+         cached->second.last_write == scan.last_write )
+    {
+      scan.entries = std::move (cached->second.entries);
+      scan.cached  = true;
+      scan.valid   = true;
+    }
+
+    else
+      dirty.push_back (&scan);
+  }
+
+  return dirty;
+}
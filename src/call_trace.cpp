@@ -0,0 +1,162 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "call_trace.h"
+#include "log.h"
+
+bool
+TBF_CallRecorder::begin (const wchar_t* wszFileName, int frames)
+{
+  if (active_)
+    end ();
+
+  if (frames <= 0)
+    return false;
+
+  fTrace_ =
+    _wfopen (wszFileName, L"wb");
+
+  if (fTrace_ == nullptr)
+  {
+    dll_log->Log ( L"[Call Trace] Unable to open '%s' for writing!",
+                     wszFileName );
+    return false;
+  }
+
+  LARGE_INTEGER freq, now;
+  QueryPerformanceFrequency (&freq);
+  QueryPerformanceCounter   (&now);
+
+  tbf_trace_header_s header;
+
+  header.magic       = TBF_TRACE_MAGIC;
+  header.version     = TBF_TRACE_VERSION;
+  header.record_size = sizeof (tbf_trace_record_s);
+  header.ops         = (uint32_t)tbf_trace_op::Count;
+  header.frequency   = freq.QuadPart;
+
+  fwrite (&header, sizeof (tbf_trace_header_s), 1, fTrace_);
+
+  pending_.reserve (MAX_PENDING);
+
+  tid_      = GetCurrentThreadId ();
+  frames_   = frames;
+  origin_   = now.QuadPart;
+  last_eof_ = now.QuadPart;
+  written_  = 0;
+  active_   = true;
+
+  dll_log->Log ( L"[Call Trace] Recording %li frames to '%s'",
+                   frames, wszFileName );
+
+  return true;
+}
+
+void
+TBF_CallRecorder::end (void)
+{
+  if (! active_)
+    return;
+
+  active_ = false;
+
+  flush ();
+
+  bool failed = (ferror (fTrace_) != 0);
+
+  fclose (fTrace_);
+  fTrace_ = nullptr;
+
+  if (failed)
+    dll_log->Log (L"[Call Trace] Write error, the trace is incomplete!");
+  else
+    dll_log->Log ( L"[Call Trace] Finished, %llu calls recorded",
+                     written_ );
+
+  pending_.clear         ();
+  pending_.shrink_to_fit ();
+}
+
+void
+TBF_CallRecorder::record ( tbf_trace_op op,    uint8_t  flags, uint16_t slot,
+                           LONGLONG     start, uint32_t arg0,
+                                               uint32_t arg1,  uint32_t arg2 )
+{
+  // Loader threads bind textures too; their calls say nothing about the
+  //   frame and would interleave unpredictably.
+  if ((! active_) || GetCurrentThreadId () != tid_)
+    return;
+
+  LARGE_INTEGER now;
+  QueryPerformanceCounter (&now);
+
+  tbf_trace_record_s rec;
+
+  rec.op       = (uint8_t)op;
+  rec.flags    = flags;
+  rec.slot     = slot;
+  rec.time     = (uint64_t)(start        - origin_);
+  rec.cost     = (uint32_t)(now.QuadPart - start);
+  rec.args [0] = arg0;
+  rec.args [1] = arg1;
+  rec.args [2] = arg2;
+
+  pending_.push_back (rec);
+
+  if (pending_.size () >= MAX_PENDING)
+    flush ();
+}
+
+void
+TBF_CallRecorder::endFrame (uint32_t frame)
+{
+  if ((! active_) || GetCurrentThreadId () != tid_)
+    return;
+
+  LARGE_INTEGER now;
+  QueryPerformanceCounter (&now);
+
+  record ( tbf_trace_op::EndFrame, 0x00, 0,
+             now.QuadPart, frame, (uint32_t)(now.QuadPart - last_eof_), 0 );
+
+  last_eof_ = now.QuadPart;
+
+  flush ();
+
+  if (--frames_ <= 0)
+    end ();
+}
+
+void
+TBF_CallRecorder::flush (void)
+{
+  if (pending_.empty ())
+    return;
+
+  written_ +=
+    fwrite ( pending_.data (), sizeof (tbf_trace_record_s),
+               pending_.size (), fTrace_ );
+
+  pending_.clear ();
+}
@@ -0,0 +1,200 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include "classifier.h"
+#include "log.h"
+
+extern iSK_Logger* tex_log;
+
+const float TBF_LoadClassifier::MIN_BINDS          = 3.0f;
+const float TBF_LoadClassifier::UPGRADE_EARLY      = 0.5f;
+const float TBF_LoadClassifier::URGENT_EARLY       = 0.2f;
+const float TBF_LoadClassifier::DOWNGRADE_EARLY    = 0.05f;
+const float TBF_LoadClassifier::DOWNGRADE_DELAY_MS = 1000.0f;
+const float TBF_LoadClassifier::DECAY              = 0.75f;
+
+#pragma pack (push, 1)
+struct tbf_load_stats_record_s {
+  uint32_t         checksum;
+  tbf_load_stats_s stats;
+};
+#pragma pack (pop)
+
+bool
+TBF_LoadClassifier::load (const wchar_t* wszFileName)
+{
+  FILE* fStats =
+    _wfopen (wszFileName, L"rb");
+
+  if (fStats == nullptr)
+    return false;
+
+  uint32_t magic   = 0,
+           version = 0,
+           count   = 0;
+
+  bool ok =
+    fread (&magic,   sizeof (uint32_t), 1, fStats) == 1 && magic   == MAGIC   &&
+    fread (&version, sizeof (uint32_t), 1, fStats) == 1 && version == VERSION &&
+    fread (&count,   sizeof (uint32_t), 1, fStats) == 1;
+
+  for (uint32_t i = 0; ok && i < count; i++)
+  {
+    tbf_load_stats_record_s rec;
+
+    ok = fread (&rec, sizeof (tbf_load_stats_record_s), 1, fStats) == 1;
+
+    if (ok)
+      history_ [rec.checksum] = rec.stats;
+  }
+
+  fclose (fStats);
+
+  if (! ok)
+  {
+    tex_log->Log ( L"[Inject Tex] Load statistics '%s' are invalid, starting over.",
+                     wszFileName );
+    history_.clear ();
+  }
+
+  return ok;
+}
+
+bool
+TBF_LoadClassifier::save (const wchar_t* wszFileName)
+{
+  FILE* fStats =
+    _wfopen (wszFileName, L"wb");
+
+  if (fStats == nullptr)
+    return false;
+
+  uint32_t magic   = MAGIC,
+           version = VERSION,
+           count   = (uint32_t)history_.size ();
+
+  fwrite (&magic,   sizeof (uint32_t), 1, fStats);
+  fwrite (&version, sizeof (uint32_t), 1, fStats);
+  fwrite (&count,   sizeof (uint32_t), 1, fStats);
+
+  for ( auto& it : history_ )
+  {
+    tbf_load_stats_record_s rec = { it.first, it.second };
+
+    fwrite (&rec, sizeof (tbf_load_stats_record_s), 1, fStats);
+  }
+
+  bool ret = (ferror (fStats) == 0);
+
+  fclose (fStats);
+
+  return ret;
+}
+
+void
+TBF_LoadClassifier::firstBind (uint32_t checksum, float delay_ms, bool override_ready)
+{
+  tbf_load_stats_s& stats =
+    session_ [checksum];
+
+  stats.avg_delay_ms =
+    (stats.avg_delay_ms * stats.binds + delay_ms) / (stats.binds + 1.0f);
+
+  stats.binds += 1.0f;
+
+  if (! override_ready)
+    stats.early_binds += 1.0f;
+}
+
+tbf_load_method_t
+TBF_LoadClassifier::classify (uint32_t checksum, tbf_load_method_t authored, bool* urgent) const
+{
+  *urgent = (authored == Blocking);
+
+  auto it =
+    history_.find (checksum);
+
+  if (it == history_.end () || it->second.binds < MIN_BINDS)
+    return authored;
+
+  const tbf_load_stats_s& stats = it->second;
+
+  float early =
+    stats.early_binds / stats.binds;
+
+  if (authored != Blocking)
+  {
+    // Bound almost immediately after creation, streaming cannot win the race
+    if (early >= UPGRADE_EARLY)
+    {
+      ++upgraded_;
+      *urgent = true;
+
+      return Blocking;
+    }
+
+    *urgent = (early >= URGENT_EARLY);
+
+    return authored;
+  }
+
+  // Nobody waited on this; let a worker thread have it
+  if (early <= DOWNGRADE_EARLY && stats.avg_delay_ms >= DOWNGRADE_DELAY_MS)
+  {
+    ++downgraded_;
+    *urgent = false;
+
+    return Streaming;
+  }
+
+  return authored;
+}
+
+void
+TBF_LoadClassifier::commitSession (void)
+{
+  for ( auto& it : session_ )
+  {
+    tbf_load_stats_s& hist =
+      history_ [it.first];
+
+    const tbf_load_stats_s& sess = it.second;
+
+    float binds =
+      hist.binds * DECAY + sess.binds;
+
+    if (binds > 0.0f)
+    {
+      hist.avg_delay_ms =
+        ( hist.avg_delay_ms * hist.binds * DECAY +
+          sess.avg_delay_ms * sess.binds ) / binds;
+    }
+
+    hist.early_binds = hist.early_binds * DECAY + sess.early_binds;
+    hist.binds       = binds;
+  }
+
+  session_.clear ();
+}
@@ -86,10 +86,15 @@ struct {
   tbf::ParameterBool*    half_precision_shadows;
 
   tbf::ParameterBool*    dump_shaders;
+  tbf::ParameterBool*    inject_shaders;
   tbf::ParameterBool*    pause_on_ui;
   tbf::ParameterBool*    show_osd_disclaimer;
   tbf::ParameterFloat*   ui_scale;
   tbf::ParameterBool*    auto_apply_changes;
+  tbf::ParameterBool*    filter_state;
+  tbf::ParameterBool*    adaptive_quality;
+  tbf::ParameterFloat*   adaptive_target_fps;
+  tbf::ParameterInt*     adaptive_max_steps;
   tbf::ParameterBool*    never_show_eula;
 
   struct {
@@ -132,6 +137,13 @@ struct {
   tbf::ParameterBool*    clamp_map_coords;
   tbf::ParameterBool*    clamp_text_coords;
   tbf::ParameterBool*    sharpen_ui;
+  tbf::ParameterBool*    hot_reload;
+  tbf::ParameterBool*    dump_to_pack;
+  tbf::ParameterBool*    predictive_prefetch;
+  tbf::ParameterInt*     staging_budget;
+  tbf::ParameterBool*    warm_start;
+  tbf::ParameterBool*    resident_blocking;
+  tbf::ParameterBool*    adaptive_loading;
 } textures;
 
 
@@ -392,6 +404,76 @@ TBF_LoadConfig (std::wstring name)
       L"Texture.System",
         L"SharpenUI" );
 
+  textures.hot_reload =
+    static_cast <tbf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Watch injection sources for changes and reload them")
+      );
+  textures.hot_reload->register_to_ini (
+    render_ini,
+      L"Texture.System",
+        L"HotReloadSources" );
+
+  textures.dump_to_pack =
+    static_cast <tbf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Append dumped textures to a pack file")
+      );
+  textures.dump_to_pack->register_to_ini (
+    render_ini,
+      L"Texture.System",
+        L"DumpToPack" );
+
+  textures.predictive_prefetch =
+    static_cast <tbf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Read likely-next injected textures ahead of time")
+      );
+  textures.predictive_prefetch->register_to_ini (
+    render_ini,
+      L"Texture.System",
+        L"PredictivePrefetch" );
+
+  textures.staging_budget =
+    static_cast <tbf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"Memory (MiB) for texture sources read ahead of time")
+      );
+  textures.staging_budget->register_to_ini (
+    render_ini,
+      L"Texture.System",
+        L"StagingBudgetMiB" );
+
+  textures.warm_start =
+    static_cast <tbf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Read last session's injected textures ahead of time")
+      );
+  textures.warm_start->register_to_ini (
+    render_ini,
+      L"Texture.System",
+        L"WarmStartPreload" );
+
+  textures.resident_blocking =
+    static_cast <tbf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Keep the blocking texture set resident in RAM")
+      );
+  textures.resident_blocking->register_to_ini (
+    render_ini,
+      L"Texture.System",
+        L"ResidentBlockingSet" );
+
+  textures.adaptive_loading =
+    static_cast <tbf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Pick blocking or streaming per texture from measured use")
+      );
+  textures.adaptive_loading->register_to_ini (
+    render_ini,
+      L"Texture.System",
+        L"AdaptiveLoadMethod" );
+
 
   render.dump_shaders = 
     static_cast <tbf::ParameterBool *>
@@ -403,6 +485,16 @@ TBF_LoadConfig (std::wstring name)
       L"Shader.System",
         L"Dump" );
 
+  render.inject_shaders =
+    static_cast <tbf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Use Replacement D3D9 Shaders")
+      );
+  render.inject_shaders->register_to_ini (
+    render_ini,
+      L"Shader.System",
+        L"Inject" );
+
 
   render.rescale_shadows =
     static_cast <tbf::ParameterInt *>
@@ -529,6 +621,46 @@ TBF_LoadConfig (std::wstring name)
       L"ImGui.Settings",
         L"ApplyChangesImmediately" );
 
+  render.filter_state =
+    static_cast <tbf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Drop Redundant Render State Changes")
+      );
+  render.filter_state->register_to_ini (
+    render_ini,
+      L"Render.Performance",
+        L"FilterRedundantState" );
+
+  render.adaptive_quality =
+    static_cast <tbf::ParameterBool *>
+      (g_ParameterFactory.create_parameter <bool> (
+        L"Adaptive Render Target Quality")
+      );
+  render.adaptive_quality->register_to_ini (
+    render_ini,
+      L"Render.Performance",
+        L"AdaptiveQuality" );
+
+  render.adaptive_target_fps =
+    static_cast <tbf::ParameterFloat *>
+      (g_ParameterFactory.create_parameter <float> (
+        L"Adaptive Quality Target Framerate")
+      );
+  render.adaptive_target_fps->register_to_ini (
+    render_ini,
+      L"Render.Performance",
+        L"AdaptiveQualityTargetFPS" );
+
+  render.adaptive_max_steps =
+    static_cast <tbf::ParameterInt *>
+      (g_ParameterFactory.create_parameter <int> (
+        L"Adaptive Quality Maximum Steps Down")
+      );
+  render.adaptive_max_steps->register_to_ini (
+    render_ini,
+      L"Render.Performance",
+        L"AdaptiveQualityMaxSteps" );
+
   render.never_show_eula =
     static_cast <tbf::ParameterBool *>
     (g_ParameterFactory.create_parameter <bool>(
@@ -869,6 +1001,7 @@ TBF_LoadConfig (std::wstring name)
   render.aspect_correction->load          (config.render.aspect_correction);
 
   render.dump_shaders->load               (config.render.dump_shaders);
+  render.inject_shaders->load             (config.render.inject_shaders);
   render.fix_map_res->load                (config.render.fix_map_res);
   render.high_res_bloom->load             (config.render.high_res_bloom);
   render.high_res_reflection->load        (config.render.high_res_reflection);
@@ -876,6 +1009,10 @@ TBF_LoadConfig (std::wstring name)
   render.pause_on_ui->load                (config.input.ui.pause);
   render.show_osd_disclaimer->load        (config.render.osd_disclaimer);
   render.auto_apply_changes->load         (config.render.auto_apply_changes);
+  render.filter_state->load               (config.render.filter_state);
+  render.adaptive_quality->load           (config.render.adaptive_quality);
+  render.adaptive_target_fps->load        (config.render.adaptive_target_fps);
+  render.adaptive_max_steps->load         (config.render.adaptive_max_steps);
   render.ui_scale->load                   (config.input.ui.scale);
   render.never_show_eula->load            (config.input.ui.never_show_eula);
 
@@ -945,6 +1082,13 @@ TBF_LoadConfig (std::wstring name)
   textures.clamp_map_coords->load  (config.textures.clamp_map_coords);
   textures.clamp_text_coords->load (config.textures.clamp_text_coords);
   textures.sharpen_ui->load        (config.textures.keep_ui_sharp);
+  textures.hot_reload->load        (config.textures.hot_reload);
+  textures.dump_to_pack->load      (config.textures.dump_to_pack);
+  textures.predictive_prefetch->load (config.textures.predictive_prefetch);
+  textures.staging_budget->load      (config.textures.staging_budget_mib);
+  textures.warm_start->load          (config.textures.warm_start);
+  textures.resident_blocking->load   (config.textures.resident_blocking);
+  textures.adaptive_loading->load    (config.textures.adaptive_loading);
 
   if (empty)
     return false;
@@ -965,6 +1109,7 @@ TBF_SaveConfig (std::wstring name, bool close_config)
   framerate.limit_addr->store       (config.framerate.limit_addr);
 
   render.dump_shaders->store        (config.render.dump_shaders);
+  render.inject_shaders->store      (config.render.inject_shaders);
 
   render.aspect_correction->store      (config.render.aspect_correction);
 
@@ -978,6 +1123,10 @@ TBF_SaveConfig (std::wstring name, bool close_config)
   render.pause_on_ui->store            (config.input.ui.pause);
   render.show_osd_disclaimer->store    (config.render.osd_disclaimer);
   render.auto_apply_changes->store     (config.render.auto_apply_changes);
+  render.filter_state->store           (config.render.filter_state);
+  render.adaptive_quality->store       (config.render.adaptive_quality);
+  render.adaptive_target_fps->store    (config.render.adaptive_target_fps);
+  render.adaptive_max_steps->store     (config.render.adaptive_max_steps);
   render.never_show_eula->store        (config.input.ui.never_show_eula);
   render.ui_scale->store               (config.input.ui.scale);
 
@@ -1019,6 +1168,13 @@ TBF_SaveConfig (std::wstring name, bool close_config)
   textures.clamp_map_coords->store  (config.textures.clamp_map_coords);
   textures.clamp_text_coords->store (config.textures.clamp_text_coords);
   textures.sharpen_ui->store        (config.textures.keep_ui_sharp);
+  textures.hot_reload->store        (config.textures.hot_reload);
+  textures.dump_to_pack->store      (config.textures.dump_to_pack);
+  textures.predictive_prefetch->store (config.textures.predictive_prefetch);
+  textures.staging_budget->store      (config.textures.staging_budget_mib);
+  textures.warm_start->store          (config.textures.warm_start);
+  textures.resident_blocking->store   (config.textures.resident_blocking);
+  textures.adaptive_loading->store    (config.textures.adaptive_loading);
 
   input.gamepad.texture_set->store         (config.input.gamepad.texture_set);
   input.gamepad.virtual_controllers->store (config.input.gamepad.virtual_controllers);
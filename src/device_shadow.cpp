@@ -0,0 +1,147 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "device_shadow.h"
+
+void
+TBF_DeviceShadow::attach (IDirect3DDevice9* pDevice)
+{
+  device_ = pDevice;
+
+  invalidate ();
+}
+
+void
+TBF_DeviceShadow::invalidate (void)
+{
+  rt0_.valid          = false;
+
+  vertex_decl_.valid  = false;
+  vertex_decl_.loaded = false;
+}
+
+void
+TBF_DeviceShadow::setRenderTarget (IDirect3DSurface9* pSurf)
+{
+  rt0_.surface = pSurf;
+  rt0_.valid   = true;
+
+  if (pSurf == nullptr || FAILED (pSurf->GetDesc (&rt0_.desc)))
+    rt0_.desc = { };
+}
+
+void
+TBF_DeviceShadow::setVertexDecl (IDirect3DVertexDeclaration9* pDecl)
+{
+  if (pDecl != vertex_decl_.decl)
+    vertex_decl_.loaded = false;
+
+  vertex_decl_.decl  = pDecl;
+  vertex_decl_.valid = true;
+}
+
+void
+TBF_DeviceShadow::setFVF (void)
+{
+  // The runtime binds a declaration of its own, ask for it if anyone cares
+  vertex_decl_.decl   = nullptr;
+  vertex_decl_.loaded = false;
+  vertex_decl_.valid  = false;
+}
+
+IDirect3DSurface9*
+TBF_DeviceShadow::renderTarget (D3DSURFACE_DESC* pDesc)
+{
+  if (! rt0_.valid)
+  {
+    IDirect3DSurface9* pSurf = nullptr;
+
+    if ( device_ == nullptr                                  ||
+         FAILED (device_->GetRenderTarget (0, &pSurf)) || pSurf == nullptr )
+      return nullptr;
+
+    setRenderTarget (pSurf);
+
+    // Still bound, the device keeps it alive
+    pSurf->Release ();
+  }
+
+  if (pDesc != nullptr)
+    *pDesc = rt0_.desc;
+
+  return rt0_.surface;
+}
+
+IDirect3DVertexDeclaration9*
+TBF_DeviceShadow::vertexDecl (void)
+{
+  if (! (decl_hooked && vertex_decl_.valid))
+  {
+    IDirect3DVertexDeclaration9* pDecl = nullptr;
+
+    if (device_ == nullptr || FAILED (device_->GetVertexDeclaration (&pDecl)))
+      pDecl = nullptr;
+
+    if (pDecl != nullptr)
+      pDecl->Release ();
+
+    // Without the hooks, an address can be reused by a different declaration
+    //   without us ever seeing it.
+    if (pDecl != vertex_decl_.decl || (! decl_hooked))
+      vertex_decl_.loaded = false;
+
+    vertex_decl_.decl  = pDecl;
+    vertex_decl_.valid = true;
+  }
+
+  return vertex_decl_.decl;
+}
+
+const D3DVERTEXELEMENT9*
+TBF_DeviceShadow::vertexElements (UINT* pNumElements)
+{
+  IDirect3DVertexDeclaration9* pDecl =
+    vertexDecl ();
+
+  if (pDecl == nullptr)
+    return nullptr;
+
+  if (! vertex_decl_.loaded)
+  {
+    vertex_decl_.num_elems = 0;
+
+    if (FAILED (pDecl->GetDeclaration (nullptr, &vertex_decl_.num_elems)) ||
+        vertex_decl_.num_elems > MAXD3DDECLLENGTH + 1                      ||
+        FAILED (pDecl->GetDeclaration (vertex_decl_.elems, &vertex_decl_.num_elems)))
+    {
+      return nullptr;
+    }
+
+    vertex_decl_.loaded = true;
+  }
+
+  *pNumElements = vertex_decl_.num_elems;
+
+  return vertex_decl_.elems;
+}
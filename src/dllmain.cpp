@@ -31,6 +31,7 @@
 #include "keyboard.h"
 #include "steam.h"
 #include "render.h"
+#include "textures.h"
 #include "input.h"
 
 #include "command.h"
@@ -84,6 +85,7 @@ SKPlugIn_Shutdown (LPVOID* lpReserved)
          TBF_NV_DriverProfileChanged () )
       tbf::RenderFix::InstallSGSSAA ();
 
+    TBF_SaveWarmStartSet          ();
     tbf::RenderFix::Shutdown      ();
     //tbf::KeyboardFix::Shutdown  ();
 
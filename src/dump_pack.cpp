@@ -0,0 +1,352 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "dump_pack.h"
+
+#include <algorithm>
+
+// Opens an existing file for update, creating it first if it is not there
+static FILE*
+TBF_OpenForUpdate (const wchar_t* wszFileName)
+{
+  FILE* fFile =
+    _wfopen (wszFileName, L"r+b");
+
+  if (fFile == nullptr)
+  {
+    fFile = _wfopen (wszFileName, L"w+b");
+  }
+
+  return fFile;
+}
+
+static bool
+TBF_FileSize (FILE* fFile, uint64_t* pSize)
+{
+  if (_fseeki64 (fFile, 0, SEEK_END) != 0)
+    return false;
+
+  int64_t size = _ftelli64 (fFile);
+
+  *pSize = (uint64_t)size;
+
+  return size >= 0;
+}
+
+bool
+TBF_DumpPack::open (const wchar_t* wszDataFile, const wchar_t* wszIndexFile)
+{
+  close ();
+
+  EnterCriticalSection (&cs_);
+
+  data_  = TBF_OpenForUpdate (wszDataFile);
+  index_ = TBF_OpenForUpdate (wszIndexFile);
+
+  uint64_t data_size  = 0ULL;
+  uint64_t index_size = 0ULL;
+
+  if ( data_  == nullptr || index_ == nullptr     ||
+       (! TBF_FileSize (data_,  &data_size))      ||
+       (! TBF_FileSize (index_, &index_size)) )
+  {
+    LeaveCriticalSection (&cs_);
+    close ();
+    return false;
+  }
+
+  end_ = data_size;
+
+  uint32_t hdr [2] = { TBF_DUMP_INDEX_MAGIC, TBF_DUMP_INDEX_VERSION };
+
+  // New index
+  if (index_size == 0)
+  {
+    if ( fwrite (hdr, sizeof hdr, 1, index_) != 1 ||
+         fflush (index_)                     != 0 )
+    {
+      LeaveCriticalSection (&cs_);
+      close ();
+      return false;
+    }
+  }
+
+  else
+  {
+    uint32_t file_hdr [2] = { };
+
+    if ( _fseeki64 (index_, 0, SEEK_SET)               != 0 ||
+         fread     (file_hdr, sizeof file_hdr, 1, index_) != 1 ||
+         file_hdr [0] != hdr [0]                              ||
+         file_hdr [1] != hdr [1] )
+    {
+      LeaveCriticalSection (&cs_);
+      close ();
+      return false;
+    }
+
+    size_t count =
+      (size_t)((index_size - sizeof file_hdr) / sizeof (tbf_dump_entry_s));
+
+    entries_.resize (count);
+
+    if (count > 0)
+    {
+      entries_.resize (
+        fread (entries_.data (), sizeof (tbf_dump_entry_s), count, index_)
+      );
+    }
+
+    const size_t read_count = entries_.size ();
+
+    // Anything that points past the end of the data was never completed
+    entries_.erase ( std::remove_if ( entries_.begin (), entries_.end (),
+                       [&](const tbf_dump_entry_s& entry) {
+                         return entry.offset > end_ || entry.size > end_ - entry.offset;
+                       } ),
+                     entries_.end () );
+
+    const uint64_t index_end =
+      sizeof file_hdr + entries_.size () * sizeof (tbf_dump_entry_s);
+
+    // The data behind a dropped record would be handed out again by the next
+    //   append, so the record cannot stay in the file; neither can a partially
+    //     written one at the end.
+    if ( entries_.size () != read_count ||
+         index_size       != index_end )
+    {
+      fclose (index_);
+
+      index_ =
+        _wfopen (wszIndexFile, L"w+b");
+
+      bool rewritten =
+        index_ != nullptr                                                 &&
+        fwrite (hdr, sizeof hdr, 1, index_) == 1                          &&
+        fwrite ( entries_.data (), sizeof (tbf_dump_entry_s),
+                   entries_.size (), index_ ) == entries_.size ()         &&
+        fflush (index_) == 0;
+
+      if (! rewritten)
+      {
+        LeaveCriticalSection (&cs_);
+        close ();
+        return false;
+      }
+    }
+
+    for (size_t i = 0; i < entries_.size (); i++)
+      latest_ [entries_ [i].checksum] = i;
+  }
+
+  LeaveCriticalSection (&cs_);
+
+  return true;
+}
+
+void
+TBF_DumpPack::close (void)
+{
+  EnterCriticalSection (&cs_);
+
+  if (data_ != nullptr)
+    fclose (data_);
+
+  if (index_ != nullptr)
+    fclose (index_);
+
+  data_  = nullptr;
+  index_ = nullptr;
+  end_   = 0ULL;
+
+  entries_.clear ();
+  latest_.clear  ();
+
+  LeaveCriticalSection (&cs_);
+}
+
+// Call with cs_ held, after the data the record refers to is on disk
+bool
+TBF_DumpPack::writeEntry (const tbf_dump_entry_s& entry)
+{
+  if ( _fseeki64 (index_, 0, SEEK_END)           != 0 ||
+       fwrite    (&entry, sizeof entry, 1, index_) != 1 ||
+       fflush    (index_)                        != 0 )
+    return false;
+
+  latest_ [entry.checksum] = entries_.size ();
+  entries_.push_back (entry);
+
+  return true;
+}
+
+bool
+TBF_DumpPack::append (uint32_t checksum, uint32_t format, const void* pData, uint32_t size)
+{
+  EnterCriticalSection (&cs_);
+
+  if (! isOpen ())
+  {
+    LeaveCriticalSection (&cs_);
+    return false;
+  }
+
+  tbf_dump_entry_s entry = { };
+
+  entry.checksum = checksum;
+  entry.format   = format;
+  entry.offset   = end_;
+  entry.size     = size;
+
+  bool ret =
+    _fseeki64 (data_, (int64_t)end_, SEEK_SET) == 0 &&
+    fwrite    (pData, 1, size, data_)          == size &&
+    fflush    (data_)                          == 0;
+
+  // The index record only goes out after the data it refers to
+  if (ret)
+  {
+    end_ += size;
+    ret   = writeEntry (entry);
+  }
+
+  LeaveCriticalSection (&cs_);
+
+  return ret;
+}
+
+bool
+TBF_DumpPack::remove (uint32_t checksum)
+{
+  EnterCriticalSection (&cs_);
+
+  auto latest =
+    latest_.find (checksum);
+
+  bool ret = false;
+
+  if ( isOpen ()                &&
+       latest != latest_.end () &&
+       (! (entries_ [latest->second].flags & TBF_DUMP_ENTRY_DELETED)) )
+  {
+    tbf_dump_entry_s entry = entries_ [latest->second];
+
+    entry.offset = end_;
+    entry.size   = 0;
+    entry.flags |= TBF_DUMP_ENTRY_DELETED;
+
+    ret = writeEntry (entry);
+  }
+
+  LeaveCriticalSection (&cs_);
+
+  return ret;
+}
+
+bool
+TBF_DumpPack::find (uint32_t checksum, tbf_dump_entry_s* pEntry)
+{
+  bool found = false;
+
+  EnterCriticalSection (&cs_);
+
+  // A texture may have been dumped (or deleted) more than once
+  auto latest =
+    latest_.find (checksum);
+
+  if ( latest != latest_.end () &&
+       (! (entries_ [latest->second].flags & TBF_DUMP_ENTRY_DELETED)) )
+  {
+    *pEntry = entries_ [latest->second];
+    found   = true;
+  }
+
+  LeaveCriticalSection (&cs_);
+
+  return found;
+}
+
+bool
+TBF_DumpPack::read (const tbf_dump_entry_s& entry, std::vector <uint8_t>& out)
+{
+  EnterCriticalSection (&cs_);
+
+  if (! isOpen ())
+  {
+    LeaveCriticalSection (&cs_);
+    return false;
+  }
+
+  out.resize (entry.size);
+
+  bool ret =
+    _fseeki64 (data_, (int64_t)entry.offset, SEEK_SET) == 0 &&
+    fread     (out.data (), 1, entry.size, data_)      == entry.size;
+
+  LeaveCriticalSection (&cs_);
+
+  return ret;
+}
+
+bool
+TBF_DumpPack::extract (const tbf_dump_entry_s& entry, const wchar_t* wszFileName)
+{
+  std::vector <uint8_t> data;
+
+  if (! read (entry, data))
+    return false;
+
+  FILE* fDump = _wfopen (wszFileName, L"wb");
+
+  if (fDump == nullptr)
+    return false;
+
+  bool ret =
+    fwrite (data.data (), 1, data.size (), fDump) == data.size ();
+
+  fclose (fDump);
+
+  return ret;
+}
+
+std::vector <tbf_dump_entry_s>
+TBF_DumpPack::entries (void)
+{
+  EnterCriticalSection (&cs_);
+
+  std::vector <tbf_dump_entry_s> ret;
+
+  ret.reserve (latest_.size ());
+
+  for (size_t i = 0; i < entries_.size (); i++)
+  {
+    if ( latest_ [entries_ [i].checksum] == i &&
+         (! (entries_ [i].flags & TBF_DUMP_ENTRY_DELETED)) )
+      ret.push_back (entries_ [i]);
+  }
+
+  LeaveCriticalSection (&cs_);
+
+  return ret;
+}
@@ -0,0 +1,206 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define NOMINMAX
+
+#include "governor.h"
+
+#include <algorithm>
+
+// Frames longer than this are loading screens, alt-tab or the reset itself
+static const float HITCH_MS      =   250.0f;
+
+static const float SLOW_RATIO    =     1.10f; // Average above target * this is slow
+static const float OK_RATIO      =     1.03f; // ... at or below this meets the target
+
+static const float COOLDOWN_MS   = 10000.0f;
+static const float PROBE_BASE_MS = 20000.0f;
+static const float PROBE_MAX_MS  = 320000.0f;
+static const float PROBE_HOLD_MS = 60000.0f;  // A step up that lasts this long held
+
+void
+TBF_QualityGovernor::configure (float target_fps, int max_level)
+{
+  target_ms_ = 1000.0f / std::max (target_fps, 1.0f);
+  max_level_ = std::max (max_level, 0);
+  level_     = std::min (level_, max_level_);
+}
+
+void
+TBF_QualityGovernor::reset (void)
+{
+  level_           = 0;
+
+  window_sum_      = 0.0f;
+  window_frames_   = 0;
+  average_         = 0.0f;
+
+  slow_windows_    = 0;
+  ok_ms_           = 0.0f;
+  since_change_ms_ = 0.0f;
+
+  probing_         = false;
+  probe_ms_        = 0.0f;
+}
+
+bool
+TBF_QualityGovernor::sample (float frame_ms)
+{
+  if (frame_ms <= 0.0f || frame_ms > HITCH_MS)
+  {
+    window_sum_    = 0.0f;
+    window_frames_ = 0;
+
+    return false;
+  }
+
+  since_change_ms_ += frame_ms;
+  window_sum_      += frame_ms;
+
+  if (++window_frames_ < WINDOW)
+    return false;
+
+  average_       = window_sum_ / (float)window_frames_;
+  window_sum_    = 0.0f;
+  window_frames_ = 0;
+
+  if (probe_ms_ == 0.0f)
+    probe_ms_ = PROBE_BASE_MS;
+
+  // A probe that held: the next one does not have to wait as long
+  if (probing_ && since_change_ms_ >= PROBE_HOLD_MS)
+  {
+    probing_  = false;
+    probe_ms_ = PROBE_BASE_MS;
+  }
+
+  if (average_ > target_ms_ * SLOW_RATIO)
+  {
+    ++slow_windows_;
+    ok_ms_ = 0.0f;
+  }
+
+  else
+  {
+    slow_windows_ = 0;
+
+    if (average_ <= target_ms_ * OK_RATIO)
+      ok_ms_ += average_ * WINDOW;
+  }
+
+  if (since_change_ms_ < COOLDOWN_MS)
+    return false;
+
+  int last_level = level_;
+
+  if (slow_windows_ >= SLOW_WINDOWS && level_ < max_level_)
+  {
+    if (probing_)
+      probe_ms_ = std::min (probe_ms_ * 2.0f, PROBE_MAX_MS);
+
+    probing_ = false;
+    ++level_;
+  }
+
+  else if (ok_ms_ >= probe_ms_ && level_ > 0)
+  {
+    probing_ = true;
+    --level_;
+  }
+
+  if (level_ == last_level)
+    return false;
+
+  slow_windows_    = 0;
+  ok_ms_           = 0.0f;
+  since_change_ms_ = 0.0f;
+
+  return true;
+}
+
+// Takes one notch off q; false if there is nothing left to take
+static bool
+TBF_QualityNotch (tbf_quality_s& q, int& turn)
+{
+  if (q.high_res_reflection) { q.high_res_reflection = false; return true; }
+  if (q.high_res_bloom)      { q.high_res_bloom      = false; return true; }
+
+  for (int i = 0; i < 3; i++)
+  {
+    bool took = false;
+
+    switch ((turn + i) % 3)
+    {
+      case 0:
+        if (q.env_shadow_rescale > 0) {
+          --q.env_shadow_rescale;
+          took = true;
+        }
+        break;
+
+      case 1:
+        // Negative values are the same magnitude with 64x64 maps promoted
+        if (q.shadow_rescale != 0) {
+          q.shadow_rescale += q.shadow_rescale < 0 ? 1 : -1;
+          took = true;
+        }
+        break;
+
+      case 2:
+        if (q.postproc_ratio > 0.5f) {
+          q.postproc_ratio = std::max (0.5f, q.postproc_ratio * 0.5f);
+          took = true;
+        }
+        break;
+    }
+
+    if (took)
+    {
+      turn = (turn + i + 1) % 3;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+tbf_quality_s
+TBF_QualityGovernor::degrade ( const tbf_quality_s& user,
+                                     int            level,
+                                     int*           pMaxLevel )
+{
+  tbf_quality_s q     = user;
+  tbf_quality_s next  = user;
+  int           steps = 0;
+  int           turn  = 0;
+
+  while (TBF_QualityNotch (next, turn))
+  {
+    if (++steps <= level)
+      q = next;
+  }
+
+  if (pMaxLevel != nullptr)
+    *pMaxLevel = steps;
+
+  return q;
+}
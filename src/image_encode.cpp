@@ -0,0 +1,543 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include "image_encode.h"
+
+#include <emmintrin.h>
+
+#include <algorithm>
+#include <cstring>
+
+extern uint32_t
+crc32 (uint32_t crc, const void *buf, size_t size);
+
+
+void
+TBF_SwizzleBGRAtoRGBA (const uint32_t* src, uint32_t* dst, size_t count)
+{
+  const __m128i mask_rb    = _mm_set1_epi32 (0x00FF00FF);
+  const __m128i mask_g     = _mm_set1_epi32 (0x0000FF00);
+  const __m128i alpha      = _mm_set1_epi32 (0xFF000000);
+
+  size_t i = 0;
+
+  // Swap bytes 0 and 2 of every pixel, alpha is forced opaque (X8R8G8B8
+  //   backbuffers leave garbage in there).
+  for ( ; i + 4 <= count; i += 4 )
+  {
+    __m128i px = _mm_loadu_si128 ((const __m128i *)(src + i));
+    __m128i rb = _mm_and_si128   (px, mask_rb);
+
+    rb = _mm_or_si128 (_mm_slli_epi32 (rb, 16), _mm_srli_epi32 (rb, 16));
+
+    _mm_storeu_si128 ( (__m128i *)(dst + i),
+                         _mm_or_si128 ( _mm_or_si128  (rb, alpha),
+                                          _mm_and_si128 (px, mask_g) ) );
+  }
+
+  for ( ; i < count; i++ )
+  {
+    uint32_t px = src [i];
+
+    dst [i] = ((px & 0x00FF0000) >> 16) | (px & 0x0000FF00) |
+              ((px & 0x000000FF) << 16) | 0xFF000000;
+  }
+}
+
+void
+TBF_BoxDownscaleBGRA ( const uint32_t* src, uint32_t src_width, uint32_t src_height,
+                             uint32_t* dst, uint32_t dst_width, uint32_t dst_height )
+{
+  const __m128i zero = _mm_setzero_si128 ();
+
+  // 16-bit lanes hold the sum of up to 257 bytes; every lane sees half of
+  //   the pixels in a run, so runs are widened to 32 bits every 256 pixels
+  const uint32_t MAX_RUN = 256;
+
+  for (uint32_t y = 0; y < dst_height; y++)
+  {
+    uint32_t y0 = (uint32_t)(((uint64_t) y      * src_height) / dst_height);
+    uint32_t y1 = (uint32_t)(((uint64_t)(y + 1) * src_height) / dst_height);
+
+    if (y1 <= y0) y1 = y0 + 1;
+
+    for (uint32_t x = 0; x < dst_width; x++)
+    {
+      uint32_t x0 = (uint32_t)(((uint64_t) x      * src_width) / dst_width);
+      uint32_t x1 = (uint32_t)(((uint64_t)(x + 1) * src_width) / dst_width);
+
+      if (x1 <= x0) x1 = x0 + 1;
+
+      // All four channels are summed in parallel as 32-bit lanes
+      __m128i sum = zero;
+
+      for (uint32_t sy = y0; sy < y1; sy++)
+      {
+        const uint32_t* row = src + (size_t)sy * src_width;
+
+        uint32_t sx = x0;
+
+        while (sx + 4 <= x1)
+        {
+          uint32_t run_end =
+            std::min (x1, sx + MAX_RUN);
+
+          // Four pixels per iteration: pixels 0+2 and 1+3 as 16-bit lanes
+          __m128i pairs = zero;
+
+          for ( ; sx + 4 <= run_end; sx += 4 )
+          {
+            __m128i px =
+              _mm_loadu_si128 ((const __m128i *)(row + sx));
+
+            pairs = _mm_add_epi16 ( pairs,
+                      _mm_add_epi16 ( _mm_unpacklo_epi8 (px, zero),
+                                      _mm_unpackhi_epi8 (px, zero) ) );
+          }
+
+          sum = _mm_add_epi32 ( sum,
+                  _mm_add_epi32 ( _mm_unpacklo_epi16 (pairs, zero),
+                                  _mm_unpackhi_epi16 (pairs, zero) ) );
+        }
+
+        for ( ; sx < x1; sx++ )
+        {
+          __m128i px =
+            _mm_cvtsi32_si128 ((int)row [sx]);
+
+          px  = _mm_unpacklo_epi16 (_mm_unpacklo_epi8 (px, zero), zero);
+          sum = _mm_add_epi32      (sum, px);
+        }
+      }
+
+      uint32_t area = (x1 - x0) * (y1 - y0);
+
+      uint32_t lanes [4];
+      _mm_storeu_si128 ((__m128i *)lanes, sum);
+
+      dst [(size_t)y * dst_width + x] =
+        ( ((lanes [0] + area / 2) / area)       ) |
+        ( ((lanes [1] + area / 2) / area) <<  8 ) |
+        ( ((lanes [2] + area / 2) / area) << 16 ) |
+        ( ((lanes [3] + area / 2) / area) << 24 );
+    }
+  }
+}
+
+bool
+TBF_WriteTGA (const wchar_t* wszFileName, const uint32_t* bgra, uint32_t width, uint32_t height)
+{
+  FILE* fTGA = _wfopen (wszFileName, L"wb");
+
+  if (fTGA == nullptr)
+    return false;
+
+  uint8_t hdr [18] = { };
+
+  hdr [ 2] = 2;                     // Uncompressed true-color
+  hdr [12] = (uint8_t)( width        & 0xFF);
+  hdr [13] = (uint8_t)((width  >> 8) & 0xFF);
+  hdr [14] = (uint8_t)( height       & 0xFF);
+  hdr [15] = (uint8_t)((height >> 8) & 0xFF);
+  hdr [16] = 32;
+  hdr [17] = 0x20 | 0x08;           // Top-left origin, 8 alpha bits
+
+  // TGA stores pixels as BGRA, which is exactly what D3D9 hands us
+  bool ret =
+    fwrite (hdr,  sizeof hdr,                    1, fTGA) == 1 &&
+    fwrite (bgra, (size_t)width * height * 4,    1, fTGA) == 1;
+
+  fclose (fTGA);
+
+  return ret;
+}
+
+
+//
+// Minimal deflate encoder: LZ77 (hash chains, 32 KiB window) + the fixed
+//   Huffman code. Each chunk of the image is compressed independently and
+//     ends in an empty stored block (a "sync flush"), which makes the chunks
+//       byte aligned so that they can simply be concatenated afterwards.
+//
+struct tbf_deflate_bits_s {
+  std::vector <uint8_t> out;
+  uint32_t              bit_buf = 0;
+  int                   bit_cnt = 0;
+
+  void put (uint32_t bits, int count)
+  {
+    bit_buf |= bits << bit_cnt;
+    bit_cnt += count;
+
+    while (bit_cnt >= 8)
+    {
+      out.push_back ((uint8_t)(bit_buf & 0xFF));
+
+      bit_buf >>= 8;
+      bit_cnt  -= 8;
+    }
+  }
+
+  // Huffman codes are stored most-significant bit first
+  void putCode (uint32_t code, int count)
+  {
+    uint32_t rev = 0;
+
+    for (int i = 0; i < count; i++)
+      rev |= ((code >> i) & 1) << (count - 1 - i);
+
+    put (rev, count);
+  }
+
+  void putLiteral (int sym)
+  {
+    if      (sym < 144) putCode (0x030 +  sym,        8);
+    else if (sym < 256) putCode (0x190 + (sym - 144), 9);
+    else if (sym < 280) putCode (         sym - 256,  7);
+    else                putCode (0x0C0 + (sym - 280), 8);
+  }
+
+  void align (void)
+  {
+    if (bit_cnt > 0)
+      out.push_back ((uint8_t)(bit_buf & 0xFF));
+
+    bit_buf = 0;
+    bit_cnt = 0;
+  }
+};
+
+static const uint16_t deflate_len_base   [29] = {   3,   4,   5,   6,   7,   8,   9,  10,  11,  13,
+                                                    15,  17,  19,  23,  27,  31,  35,  43,  51,  59,
+                                                    67,  83,  99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t  deflate_len_extra  [29] = {   0,   0,   0,   0,   0,   0,   0,   0,   1,   1,
+                                                     1,   1,   2,   2,   2,   2,   3,   3,   3,   3,
+                                                     4,   4,   4,   4,   5,   5,   5,   5,   0 };
+static const uint16_t deflate_dist_base  [30] = {     1,     2,     3,     4,     5,     7,     9,    13,
+                                                     17,    25,    33,    49,    65,    97,   129,   193,
+                                                    257,   385,   513,   769,  1025,  1537,  2049,  3073,
+                                                   4097,  6145,  8193, 12289, 16385, 24577 };
+static const uint8_t  deflate_dist_extra [30] = {  0,  0,  0,  0,  1,  1,  2,  2,  3,  3,
+                                                   4,  4,  5,  5,  6,  6,  7,  7,  8,  8,
+                                                   9,  9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static void
+TBF_DeflateChunk (const uint8_t* data, size_t len, tbf_deflate_bits_s& bits)
+{
+  const int      HASH_BITS = 15;
+  const uint32_t HASH_SIZE = 1UL << HASH_BITS;
+  const uint32_t WINDOW    = 32768UL;
+  const int      MAX_CHAIN = 16;
+  const size_t   MAX_MATCH = 258;
+
+  std::vector <int32_t> head (HASH_SIZE, -1);
+  std::vector <int32_t> prev (WINDOW,    -1);
+
+  auto Hash = [&](size_t pos) -> uint32_t {
+    return ( ((uint32_t)data [pos] << 10) ^
+             ((uint32_t)data [pos + 1] << 5) ^
+              (uint32_t)data [pos + 2] ) & (HASH_SIZE - 1);
+  };
+
+  auto Insert = [&](size_t pos) -> void {
+    if (pos + 3 > len)
+      return;
+
+    uint32_t h = Hash (pos);
+
+    prev [pos & (WINDOW - 1)] = head [h];
+    head [h]                  = (int32_t)pos;
+  };
+
+  // BFINAL = 0, BTYPE = 01 (fixed Huffman)
+  bits.put (0, 1);
+  bits.put (1, 2);
+
+  size_t pos = 0;
+
+  while (pos < len)
+  {
+    size_t best_len  = 0;
+    size_t best_dist = 0;
+
+    if (pos + 3 <= len)
+    {
+      int32_t cand  = head [Hash (pos)];
+      int     chain = MAX_CHAIN;
+
+      const size_t max_len = std::min (MAX_MATCH, len - pos);
+
+      while (cand >= 0 && chain-- > 0 && pos - cand <= WINDOW)
+      {
+        const uint8_t* a = data + cand;
+        const uint8_t* b = data + pos;
+
+        size_t match = 0;
+
+        while (match < max_len && a [match] == b [match])
+          ++match;
+
+        if (match > best_len)
+        {
+          best_len  = match;
+          best_dist = pos - cand;
+
+          if (match == max_len)
+            break;
+        }
+
+        int32_t next = prev [cand & (WINDOW - 1)];
+
+        // Overwritten by a newer position, the chain ends here
+        if (next >= cand)
+          break;
+
+        cand = next;
+      }
+    }
+
+    if (best_len >= 3)
+    {
+      int lc = 28;
+      while (deflate_len_base [lc] > best_len) --lc;
+
+      bits.putLiteral (257 + lc);
+      bits.put        ((uint32_t)(best_len - deflate_len_base [lc]), deflate_len_extra [lc]);
+
+      int dc = 29;
+      while (deflate_dist_base [dc] > best_dist) --dc;
+
+      bits.putCode (dc, 5);
+      bits.put     ((uint32_t)(best_dist - deflate_dist_base [dc]), deflate_dist_extra [dc]);
+
+      for (size_t i = 0; i < best_len; i++)
+        Insert (pos + i);
+
+      pos += best_len;
+    }
+
+    else
+    {
+      bits.putLiteral (data [pos]);
+      Insert          (pos);
+
+      ++pos;
+    }
+  }
+
+  // End of block, then an empty stored block to byte-align the output
+  bits.putLiteral (256);
+
+  bits.put   (0, 1);
+  bits.put   (0, 2);
+  bits.align ();
+
+  bits.out.push_back (0x00); bits.out.push_back (0x00);
+  bits.out.push_back (0xFF); bits.out.push_back (0xFF);
+}
+
+static uint32_t
+TBF_Adler32 (const uint8_t* data, size_t len)
+{
+  uint32_t a = 1,
+           b = 0;
+
+  while (len > 0)
+  {
+    // Largest block that cannot overflow before the modulo
+    size_t block = std::min (len, (size_t)5552);
+
+    for (size_t i = 0; i < block; i++)
+    {
+      a += data [i];
+      b += a;
+    }
+
+    a %= 65521;
+    b %= 65521;
+
+    data += block;
+    len  -= block;
+  }
+
+  return (b << 16) | a;
+}
+
+static void
+TBF_WritePNGChunk (FILE* fPNG, const char* type, const uint8_t* data, size_t len)
+{
+  uint8_t len_be [4] = { (uint8_t)(len >> 24), (uint8_t)(len >> 16),
+                         (uint8_t)(len >>  8), (uint8_t) len };
+
+  uint32_t crc = crc32 (0,   type, 4);
+  if (len > 0)
+           crc = crc32 (crc, data, len);
+
+  uint8_t crc_be [4] = { (uint8_t)(crc >> 24), (uint8_t)(crc >> 16),
+                         (uint8_t)(crc >>  8), (uint8_t) crc };
+
+  fwrite (len_be, 4, 1, fPNG);
+  fwrite (type,   4, 1, fPNG);
+
+  if (len > 0)
+    fwrite (data, len, 1, fPNG);
+
+  fwrite (crc_be, 4, 1, fPNG);
+}
+
+void
+TBF_PNGEncoder::begin ( const uint32_t* bgra, uint32_t width, uint32_t height,
+                        int             max_bands )
+{
+  width_  = width;
+  height_ = height;
+
+  const size_t stride = (size_t)width * 4 + 1;
+
+  //
+  // Swizzle and apply the "Sub" filter to every row
+  //
+  std::vector <uint32_t> rgba (width);
+
+  filtered_.resize (stride * height);
+
+  for (uint32_t y = 0; y < height; y++)
+  {
+    TBF_SwizzleBGRAtoRGBA (bgra + (size_t)y * width, rgba.data (), width);
+
+    const uint8_t* src = (const uint8_t *)rgba.data ();
+          uint8_t* dst = &filtered_ [y * stride];
+
+    *dst++ = 1;
+
+    size_t row_len = (size_t)width * 4;
+    size_t x       = std::min ((size_t)4, row_len);
+
+    memcpy (dst, src, x);
+
+    for ( ; x + 16 <= row_len; x += 16 )
+    {
+      _mm_storeu_si128 ( (__m128i *)(dst + x),
+                           _mm_sub_epi8 ( _mm_loadu_si128 ((const __m128i *)(src + x)),
+                                          _mm_loadu_si128 ((const __m128i *)(src + x - 4)) ) );
+    }
+
+    for ( ; x < row_len; x++ )
+      dst [x] = (uint8_t)(src [x] - src [x - 4]);
+  }
+
+  //
+  // Bands of rows that are compressed independently
+  //
+  max_bands = std::max (1, max_bands);
+
+  size_t rows_per_band =
+    std::max ((size_t)16, (size_t)((height + max_bands - 1) / max_bands));
+
+  bands_.clear ();
+
+  for (size_t y = 0; y < height; y += rows_per_band)
+  {
+    band_s band;
+
+    band.data = &filtered_ [y * stride];
+    band.len  = std::min (rows_per_band, (size_t)height - y) * stride;
+
+    bands_.push_back (band);
+  }
+}
+
+void
+TBF_PNGEncoder::deflateBand (size_t band)
+{
+  tbf_deflate_bits_s bits;
+
+  TBF_DeflateChunk (bands_ [band].data, bands_ [band].len, bits);
+
+  bands_ [band].out.swap (bits.out);
+}
+
+bool
+TBF_PNGEncoder::finish (const wchar_t* wszFileName)
+{
+  //
+  // zlib stream: header, concatenated chunks, a final empty block, Adler-32
+  //
+  std::vector <uint8_t> zlib;
+
+  size_t total = 2 + 4 + 2;
+
+  for ( auto& band : bands_ )
+    total += band.out.size ();
+
+  zlib.reserve (total);
+
+  zlib.push_back (0x78);
+  zlib.push_back (0x01);
+
+  for ( auto& band : bands_ )
+    zlib.insert (zlib.end (), band.out.begin (), band.out.end ());
+
+  tbf_deflate_bits_s final_block;
+
+  final_block.put        (1, 1);
+  final_block.put        (1, 2);
+  final_block.putLiteral (256);
+  final_block.align      ();
+
+  zlib.insert (zlib.end (), final_block.out.begin (), final_block.out.end ());
+
+  uint32_t adler = TBF_Adler32 (filtered_.data (), filtered_.size ());
+
+  zlib.push_back ((uint8_t)(adler >> 24)); zlib.push_back ((uint8_t)(adler >> 16));
+  zlib.push_back ((uint8_t)(adler >>  8)); zlib.push_back ((uint8_t) adler);
+
+  FILE* fPNG = _wfopen (wszFileName, L"wb");
+
+  if (fPNG == nullptr)
+    return false;
+
+  static const uint8_t png_sig [8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+  uint8_t ihdr [13] = {
+    (uint8_t)(width_  >> 24), (uint8_t)(width_  >> 16), (uint8_t)(width_  >> 8), (uint8_t)width_,
+    (uint8_t)(height_ >> 24), (uint8_t)(height_ >> 16), (uint8_t)(height_ >> 8), (uint8_t)height_,
+    8,    // Bit depth
+    6,    // RGBA
+    0, 0, 0
+  };
+
+  fwrite (png_sig, sizeof png_sig, 1, fPNG);
+
+  TBF_WritePNGChunk (fPNG, "IHDR", ihdr,          sizeof ihdr);
+  TBF_WritePNGChunk (fPNG, "IDAT", zlib.data (),  zlib.size ());
+  TBF_WritePNGChunk (fPNG, "IEND", nullptr,       0);
+
+  bool ret = (ferror (fPNG) == 0);
+
+  fclose (fPNG);
+
+  return ret;
+}
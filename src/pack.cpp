@@ -0,0 +1,89 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include "pack.h"
+
+#include <algorithm>
+
+bool
+TBF_TexturePack::open (const wchar_t* wszFileName)
+{
+  close ();
+
+  file_ =
+    CreateFileW ( wszFileName,
+                    GENERIC_READ,
+                      FILE_SHARE_READ,
+                        nullptr,
+                          OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL |
+                            FILE_FLAG_RANDOM_ACCESS,
+                              nullptr );
+
+  if (file_ == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER liSize;
+
+  if ( (! GetFileSizeEx (file_, &liSize)) ||
+          liSize.QuadPart < sizeof (tbf_pack_header_s) )
+  {
+    close ();
+    return false;
+  }
+
+  map_ = CreateFileMapping (file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+  if (map_ != nullptr)
+    base_ = (const uint8_t *)MapViewOfFile (map_, FILE_MAP_READ, 0, 0, 0);
+
+  if (base_ == nullptr || (! view_.attach (base_, (uint64_t)liSize.QuadPart)))
+  {
+    close ();
+    return false;
+  }
+
+  return true;
+}
+
+void
+TBF_TexturePack::close (void)
+{
+  view_.detach ();
+
+  if (base_ != nullptr)
+    UnmapViewOfFile (base_);
+
+  if (map_ != nullptr)
+    CloseHandle (map_);
+
+  if (file_ != INVALID_HANDLE_VALUE)
+    CloseHandle (file_);
+
+  file_  = INVALID_HANDLE_VALUE;
+  map_   = nullptr;
+  base_  = nullptr;
+}
+
@@ -0,0 +1,292 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "pack_format.h"
+
+#include <lzma/LzmaLib.h>
+
+#include <algorithm>
+#include <cstring>
+
+static uint64_t
+TBF_AlignPackOffset (uint64_t offset)
+{
+  return (offset + TBF_PACK_ALIGNMENT - 1) & ~(TBF_PACK_ALIGNMENT - 1);
+}
+
+bool
+TBF_TexturePackView::attach (const void* pBase, uint64_t size)
+{
+  detach ();
+
+  if (pBase == nullptr || size < sizeof (tbf_pack_header_s))
+    return false;
+
+  const tbf_pack_header_s* hdr   = (const tbf_pack_header_s *) pBase;
+  const tbf_pack_entry_s*  index = (const tbf_pack_entry_s  *)((const uint8_t *)pBase + sizeof (tbf_pack_header_s));
+
+  bool valid =
+    ( hdr->magic   == TBF_PACK_MAGIC   &&
+      hdr->version == TBF_PACK_VERSION &&
+      (uint64_t)hdr->entries * sizeof (tbf_pack_entry_s) <= size - sizeof (tbf_pack_header_s) );
+
+  // Offsets come straight from the file, written so that they cannot wrap
+  for (uint32_t i = 0; valid && i < hdr->entries; i++)
+  {
+    if ( index [i].offset      > size                    ||
+         index [i].stored_size > size - index [i].offset ||
+         ( index [i].compression == TBF_PACK_STORED &&
+           index [i].stored_size != index [i].size )     ||
+         ( i > 0 && index [i - 1].checksum > index [i].checksum ) )
+      valid = false;
+  }
+
+  if (! valid)
+    return false;
+
+  base_  = (const uint8_t *)pBase;
+  size_  = size;
+  hdr_   = hdr;
+  index_ = index;
+
+  return true;
+}
+
+void
+TBF_TexturePackView::detach (void)
+{
+  base_  = nullptr;
+  size_  = 0ULL;
+  hdr_   = nullptr;
+  index_ = nullptr;
+}
+
+const tbf_pack_entry_s*
+TBF_TexturePackView::getEntry (uint32_t idx) const
+{
+  if (idx >= numEntries ())
+    return nullptr;
+
+  return &index_ [idx];
+}
+
+const tbf_pack_entry_s*
+TBF_TexturePackView::findEntry (uint32_t checksum) const
+{
+  const tbf_pack_entry_s* first = index_;
+  const tbf_pack_entry_s* last  = index_ + numEntries ();
+
+  if (first == nullptr)
+    return nullptr;
+
+  const tbf_pack_entry_s* entry =
+    std::lower_bound ( first, last, checksum,
+                         [](const tbf_pack_entry_s& e, uint32_t crc) {
+                           return e.checksum < crc;
+                         } );
+
+  if (entry != last && entry->checksum == checksum)
+    return entry;
+
+  return nullptr;
+}
+
+const void*
+TBF_TexturePackView::getPayload (const tbf_pack_entry_s* entry) const
+{
+  if (entry == nullptr || base_ == nullptr)
+    return nullptr;
+
+  return base_ + entry->offset;
+}
+
+bool
+TBF_TexturePackView::extract (const tbf_pack_entry_s* entry, void* pOut, size_t out_len) const
+{
+  if (entry == nullptr || base_ == nullptr || out_len < entry->size)
+    return false;
+
+  const uint8_t* pPayload =
+    (const uint8_t *)getPayload (entry);
+
+  if (entry->compression == TBF_PACK_STORED)
+  {
+    memcpy (pOut, pPayload, entry->size);
+    return true;
+  }
+
+  if (entry->compression == TBF_PACK_LZMA && entry->stored_size > LZMA_PROPS_SIZE)
+  {
+    size_t dest_len = entry->size;
+    SizeT  src_len  = entry->stored_size - LZMA_PROPS_SIZE;
+
+    return
+      LzmaUncompress ( (unsigned char *)pOut, &dest_len,
+                         pPayload + LZMA_PROPS_SIZE, &src_len,
+                           pPayload, LZMA_PROPS_SIZE ) == SZ_OK &&
+      dest_len == entry->size;
+  }
+
+  return false;
+}
+
+
+TBF_TexturePackWriter::~TBF_TexturePackWriter (void)
+{
+  // Never finished, so the file is incomplete
+  if (file_ != nullptr)
+    fclose (file_);
+}
+
+bool
+TBF_TexturePackWriter::begin (FILE* fPack, uint32_t max_entries)
+{
+  if (fPack == nullptr)
+    return false;
+
+  file_        = fPack;
+  max_entries_ = max_entries;
+  next_        = 0ULL;
+
+  index_.clear   ();
+  index_.reserve (max_entries);
+
+  // Room for the header and index, filled in by finish
+  return
+    pad ( TBF_AlignPackOffset ( sizeof (tbf_pack_header_s) +
+                                  (uint64_t)max_entries * sizeof (tbf_pack_entry_s) ) );
+}
+
+// Zero fill from the current end of the file; payloads are written strictly
+//   front to back, so the file never needs to seek past its end.
+bool
+TBF_TexturePackWriter::pad (uint64_t to)
+{
+  static const uint8_t zeros [4096] = { };
+
+  while (next_ < to)
+  {
+    size_t len =
+      (size_t)std::min ((uint64_t)sizeof (zeros), to - next_);
+
+    if (fwrite (zeros, 1, len, file_) != len)
+      return false;
+
+    next_ += len;
+  }
+
+  return true;
+}
+
+bool
+TBF_TexturePackWriter::add ( uint32_t checksum, uint32_t method,
+                             const void* pData, uint32_t size,
+                             bool        compress )
+{
+  if (file_ == nullptr || index_.size () >= max_entries_)
+    return false;
+
+  tbf_pack_entry_s entry = { };
+
+  entry.checksum    = checksum;
+  entry.method      = method;
+  entry.compression = TBF_PACK_STORED;
+  entry.stored_size = size;
+  entry.offset      = next_;
+  entry.size        = size;
+
+  const void* pStored = pData;
+
+  std::vector <uint8_t> packed;
+
+  if (compress && size > TBF_PACK_ALIGNMENT)
+  {
+    // Fast settings: level 1, 1 MiB dictionary; most of what we store is
+    //   already block compressed, so more effort rarely pays off.
+    packed.resize (size + size / 3 + 128 + LZMA_PROPS_SIZE);
+
+    size_t dest_len  = packed.size () - LZMA_PROPS_SIZE;
+    size_t props_len = LZMA_PROPS_SIZE;
+
+    if ( LzmaCompress ( packed.data () + LZMA_PROPS_SIZE, &dest_len,
+                          (const unsigned char *)pData, size,
+                            packed.data (), &props_len,
+                              1, 1 << 20, 3, 0, 2, 32, 1 ) == SZ_OK )
+    {
+      // Only worth it if it saves at least one alignment unit
+      if ( TBF_AlignPackOffset (dest_len + LZMA_PROPS_SIZE) <
+           TBF_AlignPackOffset (size) )
+      {
+        entry.compression = TBF_PACK_LZMA;
+        entry.stored_size = (uint32_t)(dest_len + LZMA_PROPS_SIZE);
+        pStored           = packed.data ();
+      }
+    }
+  }
+
+  if ( entry.stored_size > 0 &&
+       fwrite (pStored, 1, entry.stored_size, file_) != entry.stored_size )
+    return false;
+
+  next_ += entry.stored_size;
+
+  if (! pad (TBF_AlignPackOffset (next_)))
+    return false;
+
+  index_.push_back (entry);
+
+  return true;
+}
+
+bool
+TBF_TexturePackWriter::finish (void)
+{
+  if (file_ == nullptr)
+    return false;
+
+  std::sort ( index_.begin (), index_.end (),
+                [](const tbf_pack_entry_s& a, const tbf_pack_entry_s& b) {
+                  return a.checksum < b.checksum;
+                } );
+
+  tbf_pack_header_s hdr = { };
+
+  hdr.magic   = TBF_PACK_MAGIC;
+  hdr.version = TBF_PACK_VERSION;
+  hdr.entries = (uint32_t)index_.size ();
+
+  bool ret =
+    fseek  (file_, 0, SEEK_SET)                  == 0 &&
+    fwrite (&hdr, sizeof hdr, 1, file_)          == 1 &&
+    ( index_.empty () ||
+      fwrite ( index_.data (), sizeof (tbf_pack_entry_s),
+                 index_.size (), file_ )          == index_.size () );
+
+  if (fclose (file_) != 0)
+    ret = false;
+
+  file_ = nullptr;
+
+  return ret;
+}
@@ -0,0 +1,457 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include "prefetch.h"
+#include "log.h"
+
+#include <process.h>
+#include <algorithm>
+
+extern iSK_Logger* tex_log;
+
+bool
+TBF_SourceStager::init (size_t budget)
+{
+  if (thread_ != nullptr)
+    return true;
+
+  InitializeCriticalSection (&cs_);
+
+  budget_   = budget;
+  work_     = CreateEvent (nullptr, FALSE, FALSE, nullptr);
+  shutdown_ = CreateEvent (nullptr, TRUE,  FALSE, nullptr);
+
+  thread_ =
+    (HANDLE)_beginthreadex ( nullptr,
+                               0,
+                                 ThreadProc,
+                                   this,
+                                     0x00,
+                                       nullptr );
+
+  return thread_ != nullptr;
+}
+
+void
+TBF_SourceStager::shutdown (void)
+{
+  if (thread_ == nullptr)
+    return;
+
+  SetEvent            (shutdown_);
+  WaitForSingleObject (thread_, INFINITE);
+
+  clear ();
+
+  CloseHandle (thread_);
+  CloseHandle (work_);
+  CloseHandle (shutdown_);
+
+  thread_ = nullptr;
+
+  DeleteCriticalSection (&cs_);
+}
+
+bool
+TBF_SourceStager::request (const tbf_stage_request_s& req)
+{
+  if (thread_ == nullptr)
+    return false;
+
+  EnterCriticalSection (&cs_);
+
+  bool queued = false;
+
+  if ( (! staged_.count (req.checksum)) &&
+       requested_.emplace (req.checksum).second )
+  {
+    requests_.push_back (req);
+    queued = true;
+  }
+
+  LeaveCriticalSection (&cs_);
+
+  if (queued)
+    SetEvent (work_);
+
+  return queued;
+}
+
+bool
+TBF_SourceStager::take (uint32_t checksum, void** ppData, size_t* pSize)
+{
+  if (thread_ == nullptr)
+    return false;
+
+  bool found = false;
+
+  EnterCriticalSection (&cs_);
+
+  auto it =
+    staged_.find (checksum);
+
+  if (it != staged_.end ())
+  {
+    *ppData = it->second.data;
+    *pSize  = it->second.size;
+
+    InterlockedAdd64     (&bytes_, -(LONG64)it->second.size);
+    InterlockedIncrement (&hits_);
+
+    staged_.erase (it);
+
+    found = true;
+  }
+
+  LeaveCriticalSection (&cs_);
+
+  return found;
+}
+
+bool
+TBF_SourceStager::contains (uint32_t checksum)
+{
+  if (thread_ == nullptr)
+    return false;
+
+  EnterCriticalSection (&cs_);
+
+  bool ret =
+    staged_.count (checksum) != 0;
+
+  LeaveCriticalSection (&cs_);
+
+  return ret;
+}
+
+void
+TBF_SourceStager::clear (void)
+{
+  if (thread_ == nullptr)
+    return;
+
+  EnterCriticalSection (&cs_);
+
+  InterlockedIncrement (&generation_);
+
+  for ( auto& it : staged_ )
+  {
+    free (it.second.data);
+    InterlockedIncrement (&wasted_);
+  }
+
+  staged_.clear    ();
+  order_.clear     ();
+  requests_.clear  ();
+  requested_.clear ();
+
+  InterlockedExchange64 (&bytes_, 0LL);
+
+  LeaveCriticalSection (&cs_);
+}
+
+// Call with cs_ held
+bool
+TBF_SourceStager::makeRoom (size_t size)
+{
+  if (size > budget_)
+    return false;
+
+  const DWORD dwNow = GetTickCount ();
+
+  while ((size_t)bytes_ + size > budget_ && (! order_.empty ()))
+  {
+    auto it =
+      staged_.find (order_.front ());
+
+    // Already taken
+    if (it == staged_.end ())
+    {
+      order_.pop_front ();
+      continue;
+    }
+
+    // The oldest entry is still fresh, so is everything behind it
+    if (dwNow - it->second.staged_at < STALE_MS)
+      break;
+
+    free (it->second.data);
+
+    InterlockedAdd64     (&bytes_, -(LONG64)it->second.size);
+    InterlockedIncrement (&wasted_);
+
+    staged_.erase    (it);
+    order_.pop_front ();
+  }
+
+  return (size_t)bytes_ + size <= budget_;
+}
+
+unsigned int
+__stdcall
+TBF_SourceStager::ThreadProc (LPVOID user)
+{
+  TBF_SourceStager* pStager =
+    (TBF_SourceStager *)user;
+
+  SetThreadPriority ( GetCurrentThread (),
+                        THREAD_PRIORITY_IDLE |
+                        THREAD_MODE_BACKGROUND_BEGIN );
+
+  HANDLE wait_objs [] = { pStager->work_, pStager->shutdown_ };
+
+  tbf_source_cache_s* cache =
+    TBF_CreateSourceCache ();
+
+  LONG cache_generation = 0L;
+
+  while (WaitForMultipleObjects (2, wait_objs, FALSE, INFINITE) == WAIT_OBJECT_0)
+  {
+    while (WaitForSingleObject (pStager->shutdown_, 0) == WAIT_TIMEOUT)
+    {
+      tbf_stage_request_s req;
+      LONG                generation;
+
+      EnterCriticalSection (&pStager->cs_);
+
+      if (pStager->requests_.empty ())
+      {
+        LeaveCriticalSection (&pStager->cs_);
+        break;
+      }
+
+      req        = pStager->requests_.front ();
+                   pStager->requests_.pop_front ();
+      generation = pStager->generation_;
+
+      LeaveCriticalSection (&pStager->cs_);
+
+      // The archive that is open may have just been replaced
+      if (generation != cache_generation)
+      {
+        TBF_FlushSourceCache (cache);
+        cache_generation = generation;
+      }
+
+      void*  pData = nullptr;
+      size_t size  = 0;
+
+      bool read =
+        TBF_ReadInjectableSource (cache, req, &pData, &size);
+
+      EnterCriticalSection (&pStager->cs_);
+
+      // Sources were refreshed while this was being read
+      bool stale =
+        generation != pStager->generation_;
+
+      if (! stale)
+        pStager->requested_.erase (req.checksum);
+
+      if (read && (! stale) && pStager->makeRoom (size))
+      {
+        pStager->staged_ [req.checksum] = { pData, size, GetTickCount () };
+        pStager->order_.push_back (req.checksum);
+
+        InterlockedAdd64 (&pStager->bytes_, size);
+      }
+
+      else if (read)
+        free (pData);
+
+      LeaveCriticalSection (&pStager->cs_);
+    }
+
+    // Nothing left to read, do not keep the archive locked or its block around
+    TBF_FlushSourceCache (cache);
+  }
+
+  TBF_DestroySourceCache (cache);
+
+  SetThreadPriority ( GetCurrentThread (),
+                        THREAD_MODE_BACKGROUND_END );
+
+  return 0;
+}
+
+
+bool
+TBF_ResidentPool::reserve (size_t bytes)
+{
+  if (bytes == 0)
+    return false;
+
+  uint8_t* base =
+    (uint8_t *)VirtualAlloc (nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+  if (base == nullptr)
+    return false;
+
+  EnterCriticalSection (&cs_);
+
+  blocks_.push_back (block_s { base, bytes, 0 });
+
+  reserved_ += bytes;
+
+  LeaveCriticalSection (&cs_);
+
+  return true;
+}
+
+void
+TBF_ResidentPool::release (void)
+{
+  // Nothing can be pinned once it is out of the index...
+  EnterCriticalSection (&cs_);
+
+  index_.clear ();
+
+  LeaveCriticalSection (&cs_);
+
+  // ...and loads that are still decoding out of a block finish first
+  while (InterlockedCompareExchange (&pins_, 0, 0) > 0)
+    Sleep (1);
+
+  EnterCriticalSection (&cs_);
+
+  for ( auto& block : blocks_ )
+    VirtualFree (block.base, 0, MEM_RELEASE);
+
+  blocks_.clear ();
+
+  reserved_ = 0;
+  used_     = 0;
+
+  LeaveCriticalSection (&cs_);
+}
+
+void*
+TBF_ResidentPool::alloc (size_t size)
+{
+  size_t aligned = (size + 15) & ~(size_t)15;
+
+  if (blocks_.empty ())
+    return nullptr;
+
+  block_s& block =
+    blocks_.back ();
+
+  if (block.used + aligned > block.size)
+    return nullptr;
+
+  void* pData = block.base + block.used;
+
+  block.used += aligned;
+  used_      += aligned;
+
+  return pData;
+}
+
+void
+TBF_ResidentPool::commit (uint32_t checksum, const void* pData, size_t size)
+{
+  EnterCriticalSection (&cs_);
+
+  index_ [checksum] = std::make_pair (pData, size);
+
+  LeaveCriticalSection (&cs_);
+}
+
+bool
+TBF_ResidentPool::pin (uint32_t checksum, const void** ppData, size_t* pSize)
+{
+  bool found = false;
+
+  EnterCriticalSection (&cs_);
+
+  auto it =
+    index_.find (checksum);
+
+  if (it != index_.end ())
+  {
+    *ppData = it->second.first;
+    *pSize  = it->second.second;
+
+    InterlockedIncrement (&pins_);
+
+    found = true;
+  }
+
+  LeaveCriticalSection (&cs_);
+
+  return found;
+}
+
+void
+TBF_ResidentPool::unpin (void)
+{
+  InterlockedDecrement (&pins_);
+}
+
+bool
+TBF_ResidentPool::contains (uint32_t checksum)
+{
+  EnterCriticalSection (&cs_);
+
+  bool ret =
+    index_.count (checksum) != 0;
+
+  LeaveCriticalSection (&cs_);
+
+  return ret;
+}
+
+void
+TBF_ResidentPool::forget (uint32_t checksum)
+{
+  EnterCriticalSection (&cs_);
+
+  index_.erase (checksum);
+
+  LeaveCriticalSection (&cs_);
+}
+
+void
+TBF_ResidentPool::forgetAll (void)
+{
+  EnterCriticalSection (&cs_);
+
+  index_.clear ();
+
+  LeaveCriticalSection (&cs_);
+}
+
+size_t
+TBF_ResidentPool::numEntries (void)
+{
+  EnterCriticalSection (&cs_);
+
+  size_t entries =
+    index_.size ();
+
+  LeaveCriticalSection (&cs_);
+
+  return entries;
+}
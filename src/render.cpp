@@ -29,6 +29,13 @@
 #include "scanner.h"
 
 #include "textures.h"
+#include "draw_table.h"
+#include "shader_cache.h"
+#include "shader_disasm.h"
+#include "shader_meta.h"
+#include "shader_inject.h"
+#include "constant_patch.h"
+#include "vertex_buffer_table.h"
 
 #include <cstdint>
 
@@ -75,7 +82,7 @@ struct smaa_constants_s
 typedef uint32_t (__stdcall *SK_Steam_PiratesAhoy_pfn)(void);
 typedef void     (__stdcall *SK_ResizeOSD_pfn)(float,const char*);
 
-extern SetRenderState_pfn               D3D9SetRenderState_Original;
+extern SetRenderState_pfn               D3D9SetRenderState;
        SetSamplerState_pfn              D3D9SetSamplerState_Original          = nullptr;
 
 DrawPrimitive_pfn                       D3D9DrawPrimitive_Original            = nullptr;
@@ -83,6 +90,7 @@ DrawIndexedPrimitive_pfn                D3D9DrawIndexedPrimitive_Original     =
 DrawPrimitiveUP_pfn                     D3D9DrawPrimitiveUP_Original          = nullptr;
 DrawIndexedPrimitiveUP_pfn              D3D9DrawIndexedPrimitiveUP_Original   = nullptr;
 CreateVertexBuffer_pfn                  D3D9CreateVertexBuffer_Original       = nullptr;
+VertexBufferRelease_pfn                 D3D9VertexBufferRelease_Original      = nullptr;
 SetStreamSource_pfn                     D3D9SetStreamSource_Original          = nullptr;
 SetStreamSourceFreq_pfn                 D3D9SetStreamSourceFreq_Original      = nullptr;
 
@@ -102,11 +110,18 @@ SetVertexShader_pfn                     D3D9SetVertexShader_Original          =
 SetPixelShader_pfn                      D3D9SetPixelShader_Original           = nullptr;
 SetVertexShaderConstantF_pfn            D3D9SetVertexShaderConstantF_Original = nullptr;
 SetPixelShaderConstantF_pfn             D3D9SetPixelShaderConstantF_Original  = nullptr;
+SetVertexDeclaration_pfn                D3D9SetVertexDeclaration_Original     = nullptr;
+SetFVF_pfn                              D3D9SetFVF_Original                   = nullptr;
+CreateStateBlock_pfn                    D3D9CreateStateBlock_Original         = nullptr;
+BeginStateBlock_pfn                     D3D9BeginStateBlock_Original          = nullptr;
+EndStateBlock_pfn                       D3D9EndStateBlock_Original            = nullptr;
+StateBlockApply_pfn                     D3D9StateBlockApply_Original          = nullptr;
 
 
 
 extern bool pending_loads            (void);
 extern void TBFix_LoadQueuedTextures (void);
+extern void TBFix_UpdateQueueOSD     (void);
 
 
 enum reset_stage_s {
@@ -121,13 +136,7 @@ int      needs_aspect         = 0;
 uint32_t
 TBF_MakeShadowBitShift (uint32_t dim)
 {
-  uint32_t shift = abs (config.render.shadow_rescale);
-
-  // If this is 64x64 and we want all shadows the same resolution, then add
-  //   an extra shift.
-  shift += ((config.render.shadow_rescale) < 0L) * (dim == 64UL);
-
-  return shift;
+  return TBF_ShadowBitShift (tbf::RenderFix::quality, dim);
 }
 
 
@@ -161,6 +170,121 @@ TBF_ComputeAspectCoeffs (float& x, float& y, float& xoff, float& yoff)
   }
 }
 
+
+TBF_StateCache tbf::RenderFix::state_cache;
+
+// Without them, a state block could change the device behind the cache
+static bool    state_blocks_hooked = false;
+
+static
+bool
+TBF_FilterState (IDirect3DDevice9* This)
+{
+  return config.render.filter_state && state_blocks_hooked &&
+           This == tbf::RenderFix::pDevice;
+}
+
+HRESULT
+TBF_SetRenderState (IDirect3DDevice9* This, D3DRENDERSTATETYPE State, DWORD Value)
+{
+  TBF_TraceScope trace ( tbf::RenderFix::call_trace,
+                          tbf_trace_op::SetRenderState, (uint16_t)State, Value );
+
+  if (TBF_FilterState (This) && (! tbf::RenderFix::state_cache.renderState (State, Value)))
+  {
+    trace.flag (TBF_TRACE_SKIPPED);
+    return S_OK;
+  }
+
+  // Installed along with the texture hooks on the first reset
+  HRESULT hr =
+    D3D9SetRenderState != nullptr ? D3D9SetRenderState (This, State, Value) :
+                                    This->SetRenderState (State, Value);
+
+  // The shadow already holds the new value, do not trust it anymore.
+  if (FAILED (hr) && TBF_FilterState (This))
+    tbf::RenderFix::state_cache.invalidate ();
+
+  return hr;
+}
+
+HRESULT
+TBF_SetSamplerState (IDirect3DDevice9* This, DWORD Sampler, D3DSAMPLERSTATETYPE Type, DWORD Value)
+{
+  TBF_TraceScope trace ( tbf::RenderFix::call_trace,
+                          tbf_trace_op::SetSamplerState, (uint16_t)Sampler, Type, Value );
+
+  if (TBF_FilterState (This) && (! tbf::RenderFix::state_cache.samplerState (Sampler, Type, Value)))
+  {
+    trace.flag (TBF_TRACE_SKIPPED);
+    return S_OK;
+  }
+
+  HRESULT hr =
+    D3D9SetSamplerState_Original (This, Sampler, Type, Value);
+
+  if (FAILED (hr) && TBF_FilterState (This))
+    tbf::RenderFix::state_cache.invalidate ();
+
+  return hr;
+}
+
+HRESULT
+TBF_SetViewport (IDirect3DDevice9* This, CONST D3DVIEWPORT9* pViewport)
+{
+  TBF_TraceScope trace ( tbf::RenderFix::call_trace,
+                          tbf_trace_op::SetViewport );
+
+  if (pViewport != nullptr)
+  {
+    trace.arg (0, (pViewport->X << 16) | (pViewport->Y & 0xFFFF));
+    trace.arg (1,  pViewport->Width);
+    trace.arg (2,  pViewport->Height);
+  }
+
+  if (TBF_FilterState (This) && (! tbf::RenderFix::state_cache.viewport (pViewport)))
+  {
+    trace.flag (TBF_TRACE_SKIPPED);
+    return S_OK;
+  }
+
+  HRESULT hr =
+    D3D9SetViewport_Original (This, pViewport);
+
+  if (FAILED (hr) && TBF_FilterState (This))
+    tbf::RenderFix::state_cache.invalidate ();
+
+  return hr;
+}
+
+HRESULT
+TBF_SetScissorRect (IDirect3DDevice9* This, CONST RECT* pRect)
+{
+  TBF_TraceScope trace ( tbf::RenderFix::call_trace,
+                          tbf_trace_op::SetScissorRect );
+
+  if (pRect != nullptr)
+  {
+    trace.arg (0, ((uint32_t)pRect->left << 16) | (pRect->top & 0xFFFF));
+    trace.arg (1,  (uint32_t)pRect->right);
+    trace.arg (2,  (uint32_t)pRect->bottom);
+  }
+
+  if (TBF_FilterState (This) && (! tbf::RenderFix::state_cache.scissorRect (pRect)))
+  {
+    trace.flag (TBF_TRACE_SKIPPED);
+    return S_OK;
+  }
+
+  HRESULT hr =
+    D3D9SetScissorRect_Original (This, pRect);
+
+  if (FAILED (hr) && TBF_FilterState (This))
+    tbf::RenderFix::state_cache.invalidate ();
+
+  return hr;
+}
+
 #include "hook.h"
 
 COM_DECLSPEC_NOTHROW
@@ -190,7 +314,7 @@ D3D9SetSamplerState_Detour (IDirect3DDevice9*   This,
     }
   }
 
-  return D3D9SetSamplerState_Original (This, Sampler, Type, Value);
+  return TBF_SetSamplerState (This, Sampler, Type, Value);
 }
 
 IDirect3DVertexShader9* g_pVS;
@@ -261,11 +385,14 @@ crc32(uint32_t crc, const void *buf, size_t size)
 // For now, let's just focus on stream0 and pretend nothing else exists...
 IDirect3DVertexBuffer9* vb_stream0 = nullptr;
 
-std::unordered_map <uint32_t, tbf::RenderFix::shader_disasm_s> vs_disassembly;
-std::unordered_map <uint32_t, tbf::RenderFix::shader_disasm_s> ps_disassembly;
+TBF_ShaderDisassembler                     shader_disasm;
+TBF_ShaderMetaCache                        shader_meta;
+TBF_ShaderInjector                         shader_inject;
+
+#define TBFIX_SHADER_META_FILE L"TBFix_Res\\cache\\shader_meta.dat"
 
-std::unordered_map <LPVOID, uint32_t>      vs_checksums;
-std::unordered_map <LPVOID, uint32_t>      ps_checksums;
+TBF_ShaderCache                            vs_checksums;
+TBF_ShaderCache                            ps_checksums;
 
 tbf::RenderFix::frame_state_s tbf::RenderFix::last_frame;
 
@@ -275,91 +402,106 @@ tbf::RenderFix::frame_state_s tbf::RenderFix::last_frame;
 uint32_t vs_checksum = 0;
 uint32_t ps_checksum = 0;
 
+// Shader text is produced on the disassembler's thread; the render thread
+//   only hands over a copy of the bytecode.
 void
-SK_D3D9_DumpShader ( const wchar_t* wszPrefix,
-                           uint32_t crc32,
-                           LPVOID   pbFunc )
+SK_D3D9_DumpShader ( tbf_shader_stage stage,
+                     uint32_t         crc32,
+                     LPVOID           pbFunc,
+                     UINT             len )
 {
   static bool dump = config.render.dump_shaders;
 
-  if ( D3DXDisassembleShader != nullptr)
+  if (dump)
+    shader_disasm.request (stage, crc32, pbFunc, len, true);
+}
+
+// Called by the shader views; the first call for a shader queues it and
+//   returns nullptr, later calls return the text once it is ready.
+const tbf::RenderFix::shader_disasm_s*
+TBF_GetShaderDisassembly ( tbf_shader_stage                   stage,
+                           tbf::RenderFix::shader_tracking_s* tracker )
+{
+  static uint32_t last_request [2] = { 0x00, 0x00 };
+
+  if (tracker->crc32 == 0x00)
+    return nullptr;
+
+  const tbf::RenderFix::shader_disasm_s* pDisasm =
+    shader_disasm.find (stage, tracker->crc32);
+
+  if ( pDisasm == nullptr && tracker->shader_obj != nullptr &&
+       last_request [(int)stage] != tracker->crc32 )
   {
-    if (dump)
-    {
-      if (GetFileAttributes (L"TBFix_Res\\dump\\shaders") !=
-           FILE_ATTRIBUTE_DIRECTORY)
-      {
-        CreateDirectoryW (L"TBFix_Res",                nullptr);
-        CreateDirectoryW (L"TBFix_Res\\dump",          nullptr);
-        CreateDirectoryW (L"TBFix_Res\\dump\\shaders", nullptr);
-      }
+    last_request [(int)stage] = tracker->crc32;
+
+    IDirect3DVertexShader9* pShader =
+      (IDirect3DVertexShader9 *)tracker->shader_obj;
 
-      wchar_t wszDumpName [MAX_PATH] = { L'\0' };
+    UINT len;
 
-      swprintf_s ( wszDumpName,
-                     MAX_PATH, 
-                       L"TBFix_Res\\dump\\shaders\\%s_%08x.html",
-                         wszPrefix, crc32 );
+    if (SUCCEEDED (pShader->GetFunction (nullptr, &len)))
+    {
+      void* pbFunc = malloc (len);
 
-      if ( GetFileAttributes (wszDumpName) == INVALID_FILE_ATTRIBUTES )
+      if (pbFunc != nullptr)
       {
-        CComPtr <ID3DXBuffer> pDisasm = nullptr;
-      
-        HRESULT hr =
-          D3DXDisassembleShader ((DWORD *)pbFunc, TRUE, "", &pDisasm);
-      
-        if (SUCCEEDED (hr))
-        {
-          FILE* fDump = _wfsopen (wszDumpName,  L"wb", _SH_DENYWR);
-      
-          if (fDump != NULL)
-          {
-            fwrite ( pDisasm->GetBufferPointer (),
-                       pDisasm->GetBufferSize  (),
-                         1,
-                           fDump );
-            fclose (fDump);
-          }
-        }
+        if (SUCCEEDED (pShader->GetFunction (pbFunc, &len)))
+          shader_disasm.request (stage, tracker->crc32, pbFunc, len);
+
+        free (pbFunc);
       }
     }
+  }
 
-    CComPtr <ID3DXBuffer> pDisasm = nullptr;
+  return pDisasm;
+}
 
-    HRESULT hr =
-      D3DXDisassembleShader ((DWORD *)pbFunc, FALSE, "", &pDisasm);
+// First sight of a shader object: a hash of its bytecode finds shaders seen
+//   in earlier sessions, only new ones pay for the CRC32.
+static tbf_shader_record_s*
+TBF_RecordShader ( TBF_ShaderCache& cache,
+                   tbf_shader_stage stage,
+                   IUnknown*        pShader )
+{
+  // Render thread only; reused for every shader
+  static std::vector <uint8_t> bytecode;
 
-    if (SUCCEEDED (hr) && strlen ((const char *)pDisasm->GetBufferPointer ()))
-    {
-      char* szDisasm = _strdup ((const char *)pDisasm->GetBufferPointer ());
+  IDirect3DVertexShader9* pFunc =
+    (IDirect3DVertexShader9 *)pShader;
 
-      char* comments_end  =                strstr (szDisasm,          "\n ");
-      char* footer_begins = comments_end ? strstr (comments_end + 1, "\n\n") : nullptr;
+  UINT len = 0;
 
-      if (comments_end)  *comments_end  = '\0'; else (comments_end  = "  ");
-      if (footer_begins) *footer_begins = '\0'; else (footer_begins = "  ");
+  if (FAILED (pFunc->GetFunction (nullptr, &len)) || len == 0)
+    return nullptr;
 
-      if (! _wcsicmp (wszPrefix, L"ps"))
-      {
-        ps_disassembly.emplace ( crc32, tbf::RenderFix::shader_disasm_s {
-                                          szDisasm,
-                                            comments_end + 1,
-                                              footer_begins + 1 }
-                               );
-      }
+  if (bytecode.size () < len)
+    bytecode.resize (len);
 
-      else
-      {
-        vs_disassembly.emplace ( crc32, tbf::RenderFix::shader_disasm_s {
-                                          szDisasm,
-                                            comments_end + 1,
-                                              footer_begins + 1 }
-                               );
-      }
+  if (FAILED (pFunc->GetFunction (bytecode.data (), &len)))
+    return nullptr;
 
-      free (szDisasm);
-    }
+  uint64_t hash =
+    TBF_ShaderMetaCache::hash (bytecode.data (), len);
+
+  tbf_shader_meta_s* meta =
+    shader_meta.find (len, hash);
+
+  if (meta == nullptr)
+    meta = shader_meta.insert (len, hash, crc32 (0, bytecode.data (), len));
+
+  tbf_shader_record_s* rec =
+    cache.insert (pShader, meta->crc32);
+
+  if (shader_inject.has (stage, rec->crc32))
+  {
+    rec->replacement =
+      shader_inject.replacement (tbf::RenderFix::pDevice, stage, rec->crc32);
   }
+
+  SK_D3D9_DumpShader (stage, rec->crc32, bytecode.data (), len);
+
+  return rec;
 }
 
 COM_DECLSPEC_NOTHROW
@@ -387,44 +529,31 @@ D3D9SetVertexShader_Detour (IDirect3DDevice9*       This,
   if (GetCurrentThreadId () != InterlockedExchangeAdd (&tbf::RenderFix::dwRenderThreadID, 0))
     return D3D9SetVertexShader_Original (This, pShader);
 
+  TBF_TraceScope trace (tbf::RenderFix::call_trace, tbf_trace_op::SetVertexShader);
 
-  if (g_pVS != pShader)
-  {
-    if (pShader != nullptr)
-    {
-      if (vs_checksums.find (pShader) == vs_checksums.end ())
-      {
-        UINT len;
-        pShader->GetFunction (nullptr, &len);
-
-        void* pbFunc = malloc (len);
-
-        if (pbFunc != nullptr)
-        {
-          pShader->GetFunction (pbFunc, &len);
-
-          vs_checksums [pShader] = crc32 (0, pbFunc, len);
 
-          SK_D3D9_DumpShader (L"vs", vs_checksums [pShader], pbFunc);
+  tbf_shader_record_s* rec =
+    vs_checksums.find (pShader);
 
-          free (pbFunc);
-        }
-      }
-    }
+  if (rec == nullptr && pShader != nullptr)
+    rec = TBF_RecordShader (vs_checksums, tbf_shader_stage::Vertex, pShader);
 
-    else
-      vs_checksum = 0;
-  }
-
-  vs_checksum = vs_checksums [pShader];
+  vs_checksum = rec != nullptr ? rec->crc32 : 0x00;
   g_pVS       = pShader;
 
+  trace.arg (0, vs_checksum);
+
   if (vs_checksum != 0x00)
   {
-    tbf::RenderFix::last_frame.vertex_shaders.emplace (vs_checksum);
+    // Once per shader per frame, not once per bind
+    if (rec->frame != tbf::RenderFix::last_frame.frame)
+    {
+      rec->frame = tbf::RenderFix::last_frame.frame;
+      tbf::RenderFix::last_frame.vertex_shaders.insert (vs_checksum);
+    }
     
     if (tbf::RenderFix::tracked_rt.active)
-      tbf::RenderFix::tracked_rt.vertex_shaders.emplace (vs_checksum);
+      tbf::RenderFix::tracked_rt.vertex_shaders.insert (vs_checksum);
     
     if (vs_checksum == tbf::RenderFix::tracked_vs.crc32)
     {
@@ -435,6 +564,13 @@ D3D9SetVertexShader_Detour (IDirect3DDevice9*       This,
     }
   }
 
+  // Everything above keeps seeing the game's shader
+  if (rec != nullptr && rec->replacement != nullptr && config.render.inject_shaders)
+  {
+    pShader = (IDirect3DVertexShader9 *)rec->replacement;
+    trace.flag (TBF_TRACE_MODIFIED);
+  }
+
   return D3D9SetVertexShader_Original (This, pShader);
 }
 
@@ -463,44 +599,31 @@ D3D9SetPixelShader_Detour (IDirect3DDevice9*      This,
   if (GetCurrentThreadId () != InterlockedExchangeAdd (&tbf::RenderFix::dwRenderThreadID, 0))
     return D3D9SetPixelShader_Original (This, pShader);
 
+  TBF_TraceScope trace (tbf::RenderFix::call_trace, tbf_trace_op::SetPixelShader);
 
-  if (g_pPS != pShader)
-  {
-    if (pShader != nullptr)
-    {
-      if (ps_checksums.find (pShader) == ps_checksums.end ())
-      {
-        UINT len;
-        pShader->GetFunction (nullptr, &len);
-
-        void* pbFunc = malloc (len);
-
-        if (pbFunc != nullptr)
-        {
-          pShader->GetFunction (pbFunc, &len);
-
-          ps_checksums [pShader] = crc32 (0, pbFunc, len);
-
-          SK_D3D9_DumpShader (L"ps", ps_checksums [pShader], pbFunc);
 
-          free (pbFunc);
-        }
-      }
-    }
+  tbf_shader_record_s* rec =
+    ps_checksums.find (pShader);
 
-    else
-      ps_checksum = 0;
-  }
+  if (rec == nullptr && pShader != nullptr)
+    rec = TBF_RecordShader (ps_checksums, tbf_shader_stage::Pixel, pShader);
 
-  ps_checksum = ps_checksums [pShader];
+  ps_checksum = rec != nullptr ? rec->crc32 : 0x00;
   g_pPS       = pShader;
 
+  trace.arg (0, ps_checksum);
+
   if (ps_checksum != 0x00)
   {
-    tbf::RenderFix::last_frame.pixel_shaders.emplace (ps_checksum);
+    // Once per shader per frame, not once per bind
+    if (rec->frame != tbf::RenderFix::last_frame.frame)
+    {
+      rec->frame = tbf::RenderFix::last_frame.frame;
+      tbf::RenderFix::last_frame.pixel_shaders.insert (ps_checksum);
+    }
     
     if (tbf::RenderFix::tracked_rt.active)
-      tbf::RenderFix::tracked_rt.pixel_shaders.emplace (ps_checksum);
+      tbf::RenderFix::tracked_rt.pixel_shaders.insert (ps_checksum);
     
     if (ps_checksum == tbf::RenderFix::tracked_ps.crc32)
     {
@@ -511,6 +634,13 @@ D3D9SetPixelShader_Detour (IDirect3DDevice9*      This,
     }
   }
 
+  // Injected replacement, see D3D9SetVertexShader_Detour
+  if (rec != nullptr && rec->replacement != nullptr && config.render.inject_shaders)
+  {
+    pShader = (IDirect3DPixelShader9 *)rec->replacement;
+    trace.flag (TBF_TRACE_MODIFIED);
+  }
+
   return D3D9SetPixelShader_Original (This, pShader);
 }
 
@@ -523,14 +653,84 @@ const uint32_t VS_CHECKSUM_BINK  = 3463109298UL;
 const uint32_t PS_CHECKSUM_UI    =  363447431UL;
 const uint32_t VS_CHECKSUM_UI    =  657093040UL;
 
+static TBF_DrawDecisionTable draw_decisions;
+static uint32_t              draw_decision_inputs = 0x00;
+
+//
+// Snapshot of the rules TBF_DecideDraw applies; taken when a draw has no
+//   decision yet, and once per frame to see if they changed.
+//
+static tbf_draw_rules_s
+TBF_CurrentDrawRules (void)
+{
+  tbf_draw_rules_s rules;
+
+  rules.tracked_vs        = tbf::RenderFix::tracked_vs.crc32;
+  rules.tracked_ps        = tbf::RenderFix::tracked_ps.crc32;
+  rules.tracked_vs_clamp  = tbf::RenderFix::tracked_vs.clamp_coords;
+  rules.tracked_vs_cancel = tbf::RenderFix::tracked_vs.cancel_draws;
+  rules.tracked_ps_clamp  = tbf::RenderFix::tracked_ps.clamp_coords;
+  rules.tracked_ps_cancel = tbf::RenderFix::tracked_ps.cancel_draws;
+
+  rules.keep_ui_sharp     = config.textures.keep_ui_sharp;
+  rules.clamp_skit_coords = config.textures.clamp_skit_coords;
+  rules.clamp_map_coords  = config.textures.clamp_map_coords;
+
+  rules.hollow_eye_mode   = config.fun_stuff.hollow_eye_mode;
+  rules.hollow_eye_vs     = config.fun_stuff.hollow_eye_vs_crc32;
+  rules.disable_pause_dim = config.fun_stuff.disable_pause_dim;
+  rules.pause_dim_ps      = config.fun_stuff.pause_dim_ps_crc32;
+  rules.disable_smoke     = config.fun_stuff.disable_smoke;
+  rules.smoke_ps          = config.fun_stuff.smoke_ps_crc32;
+
+  rules.aspect_trigger    = aspect_ratio_trigger;
+
+  rules.hud_vs            = &tbf::RenderFix::aspect_ratio_data.whitelist.vertex_shaders;
+  rules.hud_ps            = &tbf::RenderFix::aspect_ratio_data.whitelist.pixel_shaders;
+  rules.hud_tex           = &tbf::RenderFix::aspect_ratio_data.whitelist.textures;
+
+  return rules;
+}
+
+//
+// Throws every decision away if anything TBF_DecideDraw reads has changed;
+//   called once per frame, config and the mod tools only change in between.
+//
+void
+TBF_RefreshDrawDecisions (bool force = false)
+{
+  const uint32_t signature =
+    TBF_DrawRulesSignature (TBF_CurrentDrawRules ());
+
+  if (force || signature != draw_decision_inputs)
+  {
+    draw_decisions.clear ();
+    draw_decision_inputs = signature;
+  }
+}
+
 bool
 TBF_ShouldSkipRenderPass (D3DPRIMITIVETYPE PrimitiveType)
 {
-  if (vs_checksum == aspect_ratio_trigger || aspect_ratio_trigger == 0x00)
+  const uint32_t tex0 = current_tex [0];
+
+  const tbf_draw_decision_s* decision =
+    draw_decisions.find (vs_checksum, ps_checksum, tex0);
+
+  if (decision == nullptr)
+  {
+    decision =
+      draw_decisions.insert ( vs_checksum, ps_checksum, tex0,
+                                TBF_DecideDraw (TBF_CurrentDrawRules (), vs_checksum, ps_checksum, tex0) );
+  }
+
+  const tbf_draw_decision_s rules = *decision;
+
+  if (rules.aspect_trigger)
     needs_aspect++;
 
-  const bool tracked_vs = ( vs_checksum == tbf::RenderFix::tracked_vs.crc32         );
-  const bool tracked_ps = ( ps_checksum == tbf::RenderFix::tracked_ps.crc32         );
+  const bool tracked_vs = rules.tracked_vs;
+  const bool tracked_ps = rules.tracked_ps;
   const bool tracked_vb = { vb_stream0  == tbf::RenderFix::tracked_vb.vertex_buffer };
 
   if (tracked_vs)
@@ -539,7 +739,7 @@ TBF_ShouldSkipRenderPass (D3DPRIMITIVETYPE PrimitiveType)
 
     for (int i = 0; i < 16; i++)
       if (tbf::RenderFix::tracked_vs.current_textures [i] != 0)
-        tbf::RenderFix::tracked_vs.used_textures.emplace (tbf::RenderFix::tracked_vs.current_textures [i]);
+        tbf::RenderFix::tracked_vs.used_textures.insert (tbf::RenderFix::tracked_vs.current_textures [i]);
 
 
     //
@@ -564,7 +764,7 @@ TBF_ShouldSkipRenderPass (D3DPRIMITIVETYPE PrimitiveType)
 
     for (int i = 0; i < 16; i++)
       if (tbf::RenderFix::tracked_ps.current_textures [i] != 0)
-        tbf::RenderFix::tracked_ps.used_textures.emplace (tbf::RenderFix::tracked_ps.current_textures [i]);
+        tbf::RenderFix::tracked_ps.used_textures.insert (tbf::RenderFix::tracked_ps.current_textures [i]);
 
     //
     // TODO: Make generic and move into class -- must pass shader type to function
@@ -583,32 +783,17 @@ TBF_ShouldSkipRenderPass (D3DPRIMITIVETYPE PrimitiveType)
   }
 
 
-  bool clamp   = false;
-  bool sharpen = false;
-
-  if (ps_checksum == tbf::RenderFix::tracked_ps.crc32 && tbf::RenderFix::tracked_ps.clamp_coords)
-    clamp = true;
-
-  if (vs_checksum == tbf::RenderFix::tracked_vs.crc32 && tbf::RenderFix::tracked_vs.clamp_coords)
-    clamp = true;
-
-  if (config.textures.keep_ui_sharp && ps_checksum == 0x17c397fb) sharpen = true;
-
-  if (                                                              clamp ||
-       ( config.textures.clamp_skit_coords && ps_checksum == 0x872e7c85 ) ||
-       ( config.textures.clamp_map_coords  && ps_checksum == 0xc954a649 ) )
+  if (rules.clamp)
   {
-    sharpen = true;
-
-    D3D9SetSamplerState_Original (tbf::RenderFix::pDevice, 0, D3DSAMP_ADDRESSU, D3DTADDRESS_CLAMP );
-    D3D9SetSamplerState_Original (tbf::RenderFix::pDevice, 0, D3DSAMP_ADDRESSV, D3DTADDRESS_CLAMP );
-    D3D9SetSamplerState_Original (tbf::RenderFix::pDevice, 0, D3DSAMP_ADDRESSW, D3DTADDRESS_CLAMP );
+    TBF_SetSamplerState (tbf::RenderFix::pDevice, 0, D3DSAMP_ADDRESSU, D3DTADDRESS_CLAMP );
+    TBF_SetSamplerState (tbf::RenderFix::pDevice, 0, D3DSAMP_ADDRESSV, D3DTADDRESS_CLAMP );
+    TBF_SetSamplerState (tbf::RenderFix::pDevice, 0, D3DSAMP_ADDRESSW, D3DTADDRESS_CLAMP );
   }
 
-  if (sharpen)
+  if (rules.sharpen)
   {
     float fMin = -3.0f;
-    D3D9SetSamplerState_Original (tbf::RenderFix::pDevice, 0, D3DSAMP_MIPMAPLODBIAS, *reinterpret_cast <DWORD *>(&fMin) );
+    TBF_SetSamplerState (tbf::RenderFix::pDevice, 0, D3DSAMP_MIPMAPLODBIAS, *reinterpret_cast <DWORD *>(&fMin) );
   }
 
 
@@ -616,7 +801,7 @@ TBF_ShouldSkipRenderPass (D3DPRIMITIVETYPE PrimitiveType)
 
   bool wireframe = false;
 
-  if (tbf::RenderFix::tracked_vb.wireframes.count (vb_stream0))
+  if ((! tbf::RenderFix::tracked_vb.wireframes.empty ()) && tbf::RenderFix::tracked_vb.wireframes.count (vb_stream0))
     wireframe = true;
 
   if (tracked_vb)
@@ -635,30 +820,17 @@ TBF_ShouldSkipRenderPass (D3DPRIMITIVETYPE PrimitiveType)
     return true;
 
 
-  // Do these sparate so that we can accurately count used textures even on cancelled passes.
-  if (tracked_vs && tbf::RenderFix::tracked_vs.cancel_draws)
-    return true;
-
-  if (tracked_ps && tbf::RenderFix::tracked_ps.cancel_draws)
+  // Tracked shader cancellation and the fun-stuff options; kept after the
+  //   tracking above so that we can accurately count used textures even on
+  //     cancelled passes.
+  if (rules.skip)
     return true;
 
 
-  if (config.fun_stuff.hollow_eye_mode && vs_checksum == config.fun_stuff.hollow_eye_vs_crc32)
-    return true;
-
-  if (config.fun_stuff.disable_pause_dim && ps_checksum == config.fun_stuff.pause_dim_ps_crc32)
-    return true;
 
-  if (config.fun_stuff.disable_smoke   && ps_checksum == config.fun_stuff.smoke_ps_crc32 && current_tex [0] == 0x16f618a8)
-    return true;
-
-
-
-  if (config.render.aspect_correction && needs_aspect > 0 && PrimitiveType == D3DPT_TRIANGLESTRIP && current_tex [0] != 0x00)
+  if (config.render.aspect_correction && needs_aspect > 0 && PrimitiveType == D3DPT_TRIANGLESTRIP && tex0 != 0x00)
   {
-    if ( tbf::RenderFix::aspect_ratio_data.whitelist.vertex_shaders.count (vs_checksum) ||
-         tbf::RenderFix::aspect_ratio_data.whitelist.pixel_shaders.count  (ps_checksum) ||
-         tbf::RenderFix::aspect_ratio_data.whitelist.textures.count       (current_tex [0]) )
+    if (rules.aspect_hud)
     {
       extern void
       TBF_Viewport_HUD (IDirect3DDevice9* This, uint32_t vs_checksum, uint32_t ps_checksum);
@@ -682,10 +854,10 @@ TBF_ShouldSkipRenderPass (D3DPRIMITIVETYPE PrimitiveType)
 
 
   if (wireframe)
-    tbf::RenderFix::pDevice->SetRenderState (D3DRS_FILLMODE, D3DFILL_WIREFRAME);
+    TBF_SetRenderState (tbf::RenderFix::pDevice, D3DRS_FILLMODE, D3DFILL_WIREFRAME);
 
 
-  if (vs_checksum == aspect_ratio_trigger || aspect_ratio_trigger == 0x00)
+  if (rules.aspect_trigger)
     needs_aspect++;
 
 
@@ -825,6 +997,102 @@ D3D9EndScene_Detour (IDirect3DDevice9* This)
   return hr;
 }
 
+tbf_quality_s              tbf::RenderFix::quality;
+TBF_QualityGovernor        tbf::RenderFix::governor;
+TBF_CallRecorder           tbf::RenderFix::call_trace;
+
+// How many notches the user's own settings have to give
+static int                 quality_max_level = 0;
+
+// The user's settings, less whatever the governor has taken off; only
+//   called while the device's render targets are about to be (re)created.
+static void
+TBF_UpdateQuality (void)
+{
+  tbf_quality_s user;
+
+  user.shadow_rescale      = config.render.shadow_rescale;
+  user.env_shadow_rescale  = config.render.env_shadow_rescale;
+  user.postproc_ratio      = config.render.postproc_ratio;
+  user.high_res_bloom      = config.render.high_res_bloom;
+  user.high_res_reflection = config.render.high_res_reflection;
+
+  TBF_QualityGovernor::degrade (user, 0, &quality_max_level);
+
+  if (config.render.adaptive_quality)
+  {
+    tbf::RenderFix::governor.configure ( config.render.adaptive_target_fps,
+                                           std::min (config.render.adaptive_max_steps, quality_max_level) );
+  }
+
+  else
+    tbf::RenderFix::governor.reset ();
+
+  tbf::RenderFix::quality =
+    TBF_QualityGovernor::degrade (user, tbf::RenderFix::governor.level ());
+}
+
+// Once per frame; a level change goes through the same reset as applying
+//   settings from the control panel.
+static void
+TBF_GovernQuality (void)
+{
+  static LARGE_INTEGER freq = { },
+                       last = { };
+
+  LARGE_INTEGER now;
+  QueryPerformanceCounter (&now);
+
+  if (freq.QuadPart == 0)
+    QueryPerformanceFrequency (&freq);
+
+  float frame_ms =
+    last.QuadPart != 0 ? (float)(1000.0 * (double)(now.QuadPart - last.QuadPart) / (double)freq.QuadPart) :
+                         0.0f;
+
+  last = now;
+
+  if (trigger_reset != reset_stage_s::Clear)
+    return;
+
+  TBF_QualityGovernor& governor =
+    tbf::RenderFix::governor;
+
+  int last_level = governor.level ();
+
+  // The target and the bounds can be changed from the control panel
+  governor.configure ( config.render.adaptive_target_fps,
+                         std::min (config.render.adaptive_max_steps, quality_max_level) );
+
+  if (governor.sample (frame_ms) || governor.level () != last_level)
+  {
+    dll_log->Log ( L"[ Governor ] Average frame time %.2f ms, quality level -> %li / %li",
+                     governor.average  (),
+                     governor.level    (),
+                     governor.maxLevel () );
+
+    tbf::RenderFix::TriggerReset ();
+  }
+}
+
+// Set from the console (Render.TraceFrames); picked up at the end of a frame
+//   so the trace starts on a frame boundary.
+static int trace_frames = 0;
+
+static void
+TBF_BeginCallTrace (int frames)
+{
+  CreateDirectoryW (L"TBFix_Res",         nullptr);
+  CreateDirectoryW (L"TBFix_Res\\traces", nullptr);
+
+  wchar_t wszFileName [MAX_PATH] = { };
+
+  _swprintf ( wszFileName, L"TBFix_Res\\traces\\trace_%lu.bin",
+                GetTickCount () );
+
+  tbf::RenderFix::call_trace.begin (wszFileName, frames);
+}
+
 COM_DECLSPEC_NOTHROW
 void
 STDMETHODCALLTYPE
@@ -835,10 +1103,17 @@ D3D9EndFrame_Pre (void)
 
   if (pending_loads ())
     TBFix_LoadQueuedTextures ();
+  else
+    TBFix_UpdateQueueOSD     (); // Dumps are written while nothing is loading
 
   void TBFix_LogUsedTextures (void);
   TBFix_LogUsedTextures ();
 
+  void TBF_ProcessInjectableChanges (void);
+  TBF_ProcessInjectableChanges ();
+
+  tbf::RenderFix::tex_mgr.readBackScreenshot ();
+
   //if (! config.framerate.minimize_latency)
     //tbf::FrameRateFix::RenderTick ();
 
@@ -874,6 +1149,25 @@ D3D9EndFrame_Post (HRESULT hr, IUnknown* device)
 
   tbf::RenderFix::tex_mgr.resetUsedTextures       ();
 
+  if (config.render.adaptive_quality)
+    TBF_GovernQuality ();
+
+  // The overlay was drawn through state blocks during Present; nothing the
+  //   shadow holds can be trusted past this point.
+  tbf::RenderFix::state_cache.endFrame     ();
+  tbf::RenderFix::state_cache.invalidate   ();
+  tbf::RenderFix::device_shadow.invalidate ();
+
+  TBF_RefreshDrawDecisions ();
+
+  tbf::RenderFix::call_trace.endFrame (tbf::RenderFix::last_frame.frame);
+
+  if (trace_frames > 0)
+  {
+    TBF_BeginCallTrace (trace_frames);
+    trace_frames = 0;
+  }
+
   tbf::RenderFix::last_frame.clear ();
   tbf::RenderFix::tracked_rt.clear ();
   tbf::RenderFix::tracked_vs.clear ();
@@ -948,15 +1242,15 @@ D3D9SetScissorRect_Detour (IDirect3DDevice9* This,
 {
   // Ignore anything that's not the primary render device.
   if (This != tbf::RenderFix::pDevice)
-    return D3D9SetScissorRect_Original (This, pRect);
+    return TBF_SetScissorRect (This, pRect);
 
   // Let the mod's GUI render without any restrictions.
   if (tbf::RenderFix::draw_state.cegui_active)
-    return D3D9SetScissorRect_Original (This, pRect);
+    return TBF_SetScissorRect (This, pRect);
 
   // If we don't care about aspect ratio, then just early-out
   if ((! config.render.aspect_correction) || (! fix_scissor))
-    return D3D9SetScissorRect_Original (This, pRect);
+    return TBF_SetScissorRect (This, pRect);
 
   // Otherwise, fix this because the UI's scissor rectangles are
   //   completely wrong after we start messing with viewport scaling.
@@ -990,7 +1284,7 @@ D3D9SetScissorRect_Detour (IDirect3DDevice9* This,
     fixed_scissor.bottom = (LONG)((bottom_ndc * height + height) / 2.0f + y_off);
   }
 
-  return D3D9SetScissorRect_Original (This, &fixed_scissor);
+  return TBF_SetScissorRect (This, &fixed_scissor);
 }
 
 COM_DECLSPEC_NOTHROW
@@ -1001,7 +1295,7 @@ D3D9SetViewport_Detour (IDirect3DDevice9* This,
 {
   // Ignore anything that's not the primary render device.
   if (This != tbf::RenderFix::pDevice)
-    return D3D9SetViewport_Original (This, pViewport);
+    return TBF_SetViewport (This, pViewport);
 
   auto PostProcessMipmaps = [pViewport](void) ->
     void {
@@ -1035,7 +1329,7 @@ D3D9SetViewport_Detour (IDirect3DDevice9* This,
   {
     PostProcessMipmaps ();
 
-    if (config.render.high_res_reflection)
+    if (tbf::RenderFix::quality.high_res_reflection)
     {
       D3DVIEWPORT9 rescaled_map = *pViewport;
       
@@ -1044,7 +1338,7 @@ D3D9SetViewport_Detour (IDirect3DDevice9* This,
 
       last_viewport = rescaled_map;
 
-      return D3D9SetViewport_Original (This, &rescaled_map);
+      return TBF_SetViewport (This, &rescaled_map);
     }
   }
 
@@ -1055,7 +1349,7 @@ D3D9SetViewport_Detour (IDirect3DDevice9* This,
   {
     PostProcessMipmaps ();
 
-    if (config.render.high_res_bloom)
+    if (tbf::RenderFix::quality.high_res_bloom)
     {
       D3DVIEWPORT9 rescaled_map = *pViewport;
       
@@ -1064,7 +1358,7 @@ D3D9SetViewport_Detour (IDirect3DDevice9* This,
 
       last_viewport = rescaled_map;
       
-      return D3D9SetViewport_Original (This, &rescaled_map);
+      return TBF_SetViewport (This, &rescaled_map);
     }
   }
 
@@ -1090,7 +1384,7 @@ D3D9SetViewport_Detour (IDirect3DDevice9* This,
 
       last_viewport = rescaled_map;
 
-      return D3D9SetViewport_Original (This, &rescaled_map);
+      return TBF_SetViewport (This, &rescaled_map);
     }
   }
 
@@ -1111,7 +1405,7 @@ D3D9SetViewport_Detour (IDirect3DDevice9* This,
 
     last_viewport = rescaled_shadow;
 
-    return D3D9SetViewport_Original (This, &rescaled_shadow);
+    return TBF_SetViewport (This, &rescaled_shadow);
   }
 
   //
@@ -1125,14 +1419,14 @@ D3D9SetViewport_Detour (IDirect3DDevice9* This,
     //tex_log->Log (L"[Shadow Mgr] (Env. Resolution: (%lu x %lu)", pViewport->Width, pViewport->Height);
     D3DVIEWPORT9 rescaled_shadow = *pViewport;
 
-    rescaled_shadow.Width  <<= config.render.env_shadow_rescale;
-    rescaled_shadow.Height <<= config.render.env_shadow_rescale;
+    rescaled_shadow.Width  <<= tbf::RenderFix::quality.env_shadow_rescale;
+    rescaled_shadow.Height <<= tbf::RenderFix::quality.env_shadow_rescale;
 
     PostProcessMipmaps ();
 
     last_viewport = rescaled_shadow;
 
-    return D3D9SetViewport_Original (This, &rescaled_shadow);
+    return TBF_SetViewport (This, &rescaled_shadow);
   }
 
   //
@@ -1143,7 +1437,7 @@ D3D9SetViewport_Detour (IDirect3DDevice9* This,
   {
     PostProcessMipmaps ();
 
-    if (config.render.postproc_ratio > 0.0f)
+    if (tbf::RenderFix::quality.postproc_ratio > 0.0f)
     {
       D3DVIEWPORT9 rescaled_post_proc = *pViewport;
       
@@ -1153,20 +1447,20 @@ D3D9SetViewport_Detour (IDirect3DDevice9* This,
       x_off   = 0.0f;   y_off = 0.0f;
       //TBF_ComputeAspectScale (scale_x, scale_y, x_off, y_off);
       
-      rescaled_post_proc.Width  = (DWORD)(tbf::RenderFix::width  * config.render.postproc_ratio * scale_x);
-      rescaled_post_proc.Height = (DWORD)(tbf::RenderFix::height * config.render.postproc_ratio * scale_y);
+      rescaled_post_proc.Width  = (DWORD)(tbf::RenderFix::width  * tbf::RenderFix::quality.postproc_ratio * scale_x);
+      rescaled_post_proc.Height = (DWORD)(tbf::RenderFix::height * tbf::RenderFix::quality.postproc_ratio * scale_y);
       rescaled_post_proc.X     += (DWORD)x_off;
       rescaled_post_proc.Y     += (DWORD)y_off;
 
       last_viewport = rescaled_post_proc;
 
-      return D3D9SetViewport_Original (This, &rescaled_post_proc);
+      return TBF_SetViewport (This, &rescaled_post_proc);
     }
   }
 
   last_viewport = *pViewport;
 
-  HRESULT hr = D3D9SetViewport_Original (This, pViewport);
+  HRESULT hr = TBF_SetViewport (This, pViewport);
 
   return hr;
 }
@@ -1207,7 +1501,9 @@ void
 TBF_Viewport_HUD (IDirect3DDevice9* This, uint32_t vs_checksum, uint32_t ps_checksum)
 {
   D3DVIEWPORT9 vp;
-  This->GetViewport (&vp);
+
+  if (! (config.render.filter_state && tbf::RenderFix::state_cache.getViewport (&vp)))
+    This->GetViewport (&vp);
 
   //if (vp.Height != tbf::RenderFix::height || vp.Width != tbf::RenderFix::width || vp.MaxZ != 1.0f || vp.MinZ != 0.0f || vp.X != 0 || vp.Y != 0)
     //return;
@@ -1247,7 +1543,7 @@ TBF_Viewport_HUD (IDirect3DDevice9* This, uint32_t vs_checksum, uint32_t ps_chec
     new_vp.Height = tbf::RenderFix::height;
     new_vp.X      = (tbf::RenderFix::width - tbf::RenderFix::height * (16.0f / 9.0f)) / 2;
     new_vp.Y      = 0;
-    D3D9SetViewport_Original (This, &new_vp);
+    TBF_SetViewport (This, &new_vp);
   }
 
   else
@@ -1259,7 +1555,7 @@ TBF_Viewport_HUD (IDirect3DDevice9* This, uint32_t vs_checksum, uint32_t ps_chec
     new_vp.Height = tbf::RenderFix::width * (9.0f  / 16.0f);
     new_vp.X      = 0;
     new_vp.Y      = (tbf::RenderFix::height - tbf::RenderFix::width * (9.0f / 16.0f)) / 2;
-    D3D9SetViewport_Original (This, &new_vp);
+    TBF_SetViewport (This, &new_vp);
   }
 }
 void
@@ -1275,7 +1571,7 @@ TBF_AdjustViewport (IDirect3DDevice9* This, bool UI)
     vp9_orig.Y = 0;
     vp9_orig.Width  = tbf::RenderFix::width;
     vp9_orig.Height = tbf::RenderFix::height;
-    D3D9SetViewport_Original (This, &vp9_orig);
+    TBF_SetViewport (This, &vp9_orig);
     return;
   }
 
@@ -1301,7 +1597,7 @@ TBF_AdjustViewport (IDirect3DDevice9* This, bool UI)
     vp9.Width = width;         vp9.Height = height;
     vp9.MinZ  = vp9_orig.MinZ; vp9.MaxZ   = vp9_orig.MaxZ;
 
-    D3D9SetViewport_Original (This, &vp9);
+    TBF_SetViewport (This, &vp9);
   }
 
   // Sidebar Videos
@@ -1311,7 +1607,7 @@ TBF_AdjustViewport (IDirect3DDevice9* This, bool UI)
     vp9.Width = width;                                     vp9.Height = height;
     vp9.MinZ  = vp9_orig.MinZ;                             vp9.MaxZ   = vp9_orig.MaxZ;
 
-    D3D9SetViewport_Original (This, &vp9);
+    TBF_SetViewport (This, &vp9);
   }
 }
 
@@ -1334,13 +1630,18 @@ D3D9DrawIndexedPrimitive_Detour (IDirect3DDevice9* This,
                                                      primCount );
   }
 
+  TBF_TraceScope trace ( tbf::RenderFix::call_trace,
+                          tbf_trace_op::DrawIndexedPrimitive, (uint16_t)Type,
+                            NumVertices, startIndex, primCount );
+
   ++tbf::RenderFix::draw_state.draws;
   ++draw_count;
 
 
   if (TBF_ShouldSkipRenderPass (Type)) {
     if (config.render.aspect_correction)
-      D3D9SetViewport_Original (This, &last_viewport);
+      TBF_SetViewport (This, &last_viewport);
+    trace.flag (TBF_TRACE_SKIPPED);
     return S_OK;
   }
 
@@ -1352,13 +1653,15 @@ D3D9DrawIndexedPrimitive_Detour (IDirect3DDevice9* This,
                                               primCount );
 
   if (config.render.aspect_correction)
-    D3D9SetViewport_Original (This, &last_viewport);
+    TBF_SetViewport (This, &last_viewport);
 
-  tbf::RenderFix::pDevice->SetRenderState (D3DRS_FILLMODE, D3DFILL_SOLID);
+  TBF_SetRenderState (tbf::RenderFix::pDevice, D3DRS_FILLMODE, D3DFILL_SOLID);
 
   return hr;
 }
 
+static TBF_ConstantPatchTable const_patches;
+
 COM_DECLSPEC_NOTHROW
 HRESULT
 STDMETHODCALLTYPE
@@ -1375,111 +1678,43 @@ D3D9SetVertexShaderConstantF_Detour (IDirect3DDevice9* This,
                                                          Vector4fCount );
   }
 
-  //
-  // Model Shadows
-  //
-  else if (StartRegister == 240 && Vector4fCount == 1 && (pConstantData [0] == -pConstantData [1])) {
-    uint32_t shift;
-    uint32_t dim = 0;
-
-    if (pConstantData [0] == -1.0f / 64.0f) {
-      dim = 64UL;
-      //dll_log->Log (L" 64x64 Shadow: VS CRC: %lu, PS CRC: %lu", vs_checksum, ps_checksum);
-    }
-
-    else if (pConstantData [0] == -1.0f / 128.0f) {
-      dim = 128UL;
-      //dll_log->Log (L" 128x128 Shadow: VS CRC: %lu, PS CRC: %lu", vs_checksum, ps_checksum);
-    }
-
-    else if (pConstantData [0] == -1.0f / 256.0f) {
-      dim = 256UL;
-      //dll_log->Log (L" 256x256 Shadow: VS CRC: %lu, PS CRC: %lu", vs_checksum, ps_checksum);
-    }
-
-    shift = TBF_MakeShadowBitShift (dim);
-
-    float newData [4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-    newData [0] = -1.0f / (dim << shift);
-    newData [1] =  1.0f / (dim << shift);
-
-    if (pConstantData [2] != 0.0f || 
-        pConstantData [3] != 0.0f) {
-      dll_log->Log (L"[   D3D9   ] Assertion failed: non-zero 2 or 3 (line %lu)", __LINE__);
-    }
-
-    if (dim != 0) {
-      return D3D9SetVertexShaderConstantF_Original (This, 240, newData, 1);
-    }
-  }
+  TBF_TraceScope trace ( tbf::RenderFix::call_trace,
+                          tbf_trace_op::SetVertexShaderConstantF, (uint16_t)StartRegister,
+                            Vector4fCount );
 
-  //
-  // Post-Processing
-  //
-  else if (StartRegister     == 240 &&
-           Vector4fCount     == 1   &&
-           ( pConstantData [0] == -1.0f / (float) TBF_NextPowerOfTwo (tbf::RenderFix::width / 2) &&
-             pConstantData [1] ==  1.0f / (float)(TBF_NextPowerOfTwo (tbf::RenderFix::width / 2) / 2) ) &&
-            config.render.postproc_ratio > 0.0f )
+  if (Vector4fCount > 0 && pConstantData != nullptr)
   {
-    if (SUCCEEDED (This->GetRenderTarget (0, &tbf::RenderFix::pPostProcessSurface)))
-      tbf::RenderFix::pPostProcessSurface->Release ();
-
-    float newData [4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-    float scale_x, scale_y;
-    float x_off,   y_off;
-    scale_x = 1.0f; scale_y = 1.0f;
-    x_off   = 0.0f;   y_off = 0.0f;
-    //TBF_ComputeAspectScale (scale_x, scale_y, x_off, y_off);
-
-    newData [0] = -1.0f / ((float)tbf::RenderFix::width  * config.render.postproc_ratio * scale_x);
-    newData [1] =  1.0f / ((float)tbf::RenderFix::height * config.render.postproc_ratio * scale_y);
-
-    if (pConstantData [2] != 0.0f || 
-        pConstantData [3] != 0.0f) {
-      dll_log->Log (L"[   D3D9   ] Assertion failed: non-zero 2 or 3 (line %lu)", __LINE__);
-    }
-
-    return D3D9SetVertexShaderConstantF_Original (This, 240, newData, 1);
+    trace.arg (1, *(const uint32_t *)&pConstantData [0]);
+    trace.arg (2, *(const uint32_t *)&pConstantData [1]);
   }
 
   //
-  // Env Shadow
+  // Model Shadows, Post-Processing and Env Shadows: c240 = 1 / target size
   //
-  if (StartRegister == 240 && Vector4fCount == 1 && (pConstantData [0] == -pConstantData [1])) {
-    uint32_t shift;
-    uint32_t dim = 0;
-
-    if (pConstantData [0] == -1.0f / 512.0f) {
-      dim = 512UL;
-      //dll_log->Log (L" 512x512 Shadow: VS CRC: %lu, PS CRC: %lu", vs_checksum, ps_checksum);
-    }
-
-    else if (pConstantData [0] == -1.0f / 1024.0f) {
-      dim = 1024UL;
-      //dll_log->Log (L" 1024x1024 Shadow: VS CRC: %lu, PS CRC: %lu", vs_checksum, ps_checksum);
-    }
-
-    else if (pConstantData [0] == -1.0f / 2048.0f) {
-      dim = 2048UL;
-      //dll_log->Log (L" 2048x2048 Shadow: VS CRC: %lu, PS CRC: %lu", vs_checksum, ps_checksum);
-    }
+  if (StartRegister == 240 && Vector4fCount == 1)
+  {
+    if (! const_patches.current (tbf::RenderFix::width, tbf::RenderFix::height, tbf::RenderFix::quality))
+      const_patches.build (tbf::RenderFix::width, tbf::RenderFix::height, tbf::RenderFix::quality);
 
-    shift = config.render.env_shadow_rescale;
+    const tbf_vs_patch_s* patch =
+      const_patches.find (pConstantData);
 
-    float newData [4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    if (patch != nullptr)
+    {
+      if (patch->kind == tbf_vs_patch_s::PostProcess)
+      {
+        tbf::RenderFix::pPostProcessSurface =
+          tbf::RenderFix::device_shadow.renderTarget ();
+      }
 
-    newData [0] = -1.0f / (dim << shift);
-    newData [1] =  1.0f / (dim << shift);
+      if (pConstantData [2] != 0.0f || 
+          pConstantData [3] != 0.0f) {
+        dll_log->Log (L"[   D3D9   ] Assertion failed: non-zero 2 or 3 (line %lu)", __LINE__);
+      }
 
-    if (pConstantData [2] != 0.0f || 
-        pConstantData [3] != 0.0f) {
-      dll_log->Log (L"[   D3D9   ] Assertion failed: non-zero 2 or 3 (line %lu)", __LINE__);
-    }
+      float newData [4] = { patch->data [0], patch->data [1], 0.0f, 0.0f };
 
-    if (dim != 0) {
+      trace.flag (TBF_TRACE_MODIFIED);
       return D3D9SetVertexShaderConstantF_Original (This, 240, newData, 1);
     }
   }
@@ -1489,18 +1724,17 @@ D3D9SetVertexShaderConstantF_Detour (IDirect3DDevice9* This,
   // Model Shadows and Post-Processing
   //
   if (StartRegister == 0 && (Vector4fCount == 2 || Vector4fCount == 3)) {
-    IDirect3DSurface9* pSurf = nullptr;
+    D3DSURFACE_DESC    desc;
+    IDirect3DSurface9* pSurf =
+      tbf::RenderFix::device_shadow.renderTarget (&desc);
 
-    if (This == tbf::RenderFix::pDevice && SUCCEEDED (This->GetRenderTarget (0, &pSurf)) && pSurf != nullptr)
+    if (pSurf != nullptr)
     {
-      D3DSURFACE_DESC desc;
-      pSurf->GetDesc (&desc);
-      pSurf->Release ();
 
       //
       // Post-Processing
       //
-      if (config.render.postproc_ratio > 0.0f) {
+      if (tbf::RenderFix::quality.postproc_ratio > 0.0f) {
         if (desc.Width  == tbf::RenderFix::width  &&
             desc.Height == tbf::RenderFix::height) {
           if (pSurf == tbf::RenderFix::pPostProcessSurface)
@@ -1516,9 +1750,9 @@ D3D9SetVertexShaderConstantF_Detour (IDirect3DDevice9* This,
             //TBF_ComputeAspectScale (scale_x, scale_y, x_off, y_off);
 
             float rescale_x = (float) TBF_NextPowerOfTwo (tbf::RenderFix::width / 2)
-                               / ((float)tbf::RenderFix::width  * config.render.postproc_ratio * scale_x);
+                               / ((float)tbf::RenderFix::width  * tbf::RenderFix::quality.postproc_ratio * scale_x);
             float rescale_y = (float)(TBF_NextPowerOfTwo (tbf::RenderFix::width / 2) / 2)
-                               / ((float)tbf::RenderFix::height * config.render.postproc_ratio * scale_y);
+                               / ((float)tbf::RenderFix::height * tbf::RenderFix::quality.postproc_ratio * scale_y);
 
             for (int i = 0; i < 8; i += 2) {
               newData [i] = pConstantData [i] * rescale_x;
@@ -1530,6 +1764,7 @@ D3D9SetVertexShaderConstantF_Detour (IDirect3DDevice9* This,
 
             //fix_aspect = true;
 
+            trace.flag (TBF_TRACE_MODIFIED);
             return D3D9SetVertexShaderConstantF_Original (This, 0, newData, Vector4fCount);
           }
         }
@@ -1547,6 +1782,7 @@ D3D9SetVertexShaderConstantF_Detour (IDirect3DDevice9* This,
           newData [i] = pConstantData [i] / (float)(1 << shift);
         }
 
+        trace.flag (TBF_TRACE_MODIFIED);
         return D3D9SetVertexShaderConstantF_Original (This, 0, newData, Vector4fCount);
       }
     }
@@ -1590,6 +1826,7 @@ D3D9SetVertexShaderConstantF_Detour (IDirect3DDevice9* This,
 
       smaa_constants->reprojection.weight           =        config.render.smaa.reprojection_weight;
 
+      trace.flag (TBF_TRACE_MODIFIED);
       return D3D9SetVertexShaderConstantF_Original (This, StartRegister, override_params, Vector4fCount);
     }
   }
@@ -1606,6 +1843,16 @@ D3D9SetPixelShaderConstantF_Detour (IDirect3DDevice9* This,
   CONST float*      pConstantData,
   UINT              Vector4fCount)
 {
+  TBF_TraceScope trace ( tbf::RenderFix::call_trace,
+                          tbf_trace_op::SetPixelShaderConstantF, (uint16_t)StartRegister,
+                            Vector4fCount );
+
+  if (Vector4fCount > 0 && pConstantData != nullptr)
+  {
+    trace.arg (1, *(const uint32_t *)&pConstantData [0]);
+    trace.arg (2, *(const uint32_t *)&pConstantData [1]);
+  }
+
   if (config.render.smaa.override_game && ( ps_checksum == config.render.smaa.smaa_ps0_crc32 ||
                                             ps_checksum == config.render.smaa.smaa_ps1_crc32 ))
   {
@@ -1630,6 +1877,7 @@ D3D9SetPixelShaderConstantF_Detour (IDirect3DDevice9* This,
 
       smaa_constants->reprojection.weight           =        config.render.smaa.reprojection_weight;
 
+      trace.flag (TBF_TRACE_MODIFIED);
       return D3D9SetPixelShaderConstantF_Original (This, StartRegister, override_params, Vector4fCount);
     }
   }
@@ -1656,12 +1904,17 @@ D3D9DrawPrimitive_Detour (IDirect3DDevice9* This,
                                                  StartVertex, PrimitiveCount );
   }
 
+  TBF_TraceScope trace ( tbf::RenderFix::call_trace,
+                          tbf_trace_op::DrawPrimitive, (uint16_t)PrimitiveType,
+                            StartVertex, PrimitiveCount );
+
   tbf::RenderFix::draw_state.draws++;
 
 
   if (TBF_ShouldSkipRenderPass (PrimitiveType)) {
     if (config.render.aspect_correction)
-      D3D9SetViewport_Original (This, &last_viewport);
+      TBF_SetViewport (This, &last_viewport);
+    trace.flag (TBF_TRACE_SKIPPED);
     return S_OK;
   }
 
@@ -1677,9 +1930,9 @@ D3D9DrawPrimitive_Detour (IDirect3DDevice9* This,
                                                StartVertex, PrimitiveCount );
 
   if (config.render.aspect_correction)
-    D3D9SetViewport_Original (This, &last_viewport);
+    TBF_SetViewport (This, &last_viewport);
 
-  tbf::RenderFix::pDevice->SetRenderState (D3DRS_FILLMODE, D3DFILL_SOLID);
+  TBF_SetRenderState (tbf::RenderFix::pDevice, D3DRS_FILLMODE, D3DFILL_SOLID);
 
   return hr;
 }
@@ -1725,12 +1978,17 @@ D3D9DrawPrimitiveUP_Detour ( IDirect3DDevice9* This,
   }
 #endif
 
+  TBF_TraceScope trace ( tbf::RenderFix::call_trace,
+                          tbf_trace_op::DrawPrimitiveUP, (uint16_t)PrimitiveType,
+                            PrimitiveCount, VertexStreamZeroStride );
+
   tbf::RenderFix::draw_state.draws++;
 
 
   if (TBF_ShouldSkipRenderPass(PrimitiveType)) {
     if (config.render.aspect_correction)
-      D3D9SetViewport_Original (This, &last_viewport);
+      TBF_SetViewport (This, &last_viewport);
+    trace.flag (TBF_TRACE_SKIPPED);
     return S_OK;
   }
 
@@ -1743,9 +2001,9 @@ D3D9DrawPrimitiveUP_Detour ( IDirect3DDevice9* This,
                                            VertexStreamZeroStride );
 
   if (config.render.aspect_correction)
-    D3D9SetViewport_Original (This, &last_viewport);
+    TBF_SetViewport (This, &last_viewport);
 
-  tbf::RenderFix::pDevice->SetRenderState (D3DRS_FILLMODE, D3DFILL_SOLID);
+  TBF_SetRenderState (tbf::RenderFix::pDevice, D3DRS_FILLMODE, D3DFILL_SOLID);
 
   return hr;
 }
@@ -1779,13 +2037,18 @@ D3D9DrawIndexedPrimitiveUP_Detour ( IDirect3DDevice9* This,
   }
 #endif
 
+  TBF_TraceScope trace ( tbf::RenderFix::call_trace,
+                          tbf_trace_op::DrawIndexedPrimitiveUP, (uint16_t)PrimitiveType,
+                            NumVertices, PrimitiveCount, VertexStreamZeroStride );
+
   tbf::RenderFix::draw_state.draws++;
 
 
   if (TBF_ShouldSkipRenderPass (PrimitiveType))
   {
     if (config.render.aspect_correction)
-      D3D9SetViewport_Original (This, &last_viewport);
+      TBF_SetViewport (This, &last_viewport);
+    trace.flag (TBF_TRACE_SKIPPED);
     return S_OK;
   }
 
@@ -1803,13 +2066,110 @@ D3D9DrawIndexedPrimitiveUP_Detour ( IDirect3DDevice9* This,
                       VertexStreamZeroStride );
 
   if (config.render.aspect_correction)
-    D3D9SetViewport_Original (This, &last_viewport);
+    TBF_SetViewport (This, &last_viewport);
+
+  TBF_SetRenderState (tbf::RenderFix::pDevice, D3DRS_FILLMODE, D3DFILL_SOLID);
+
+  return hr;
+}
+
+
+COM_DECLSPEC_NOTHROW
+HRESULT
+STDMETHODCALLTYPE
+D3D9SetVertexDeclaration_Detour (IDirect3DDevice9*            This,
+                                 IDirect3DVertexDeclaration9* pDecl)
+{
+  HRESULT hr =
+    D3D9SetVertexDeclaration_Original (This, pDecl);
+
+  // Recorded into a state block, not bound
+  if ( This == tbf::RenderFix::pDevice && SUCCEEDED (hr) &&
+       (! tbf::RenderFix::state_cache.recording ()) )
+    tbf::RenderFix::device_shadow.setVertexDecl (pDecl);
+
+  return hr;
+}
+
+COM_DECLSPEC_NOTHROW
+HRESULT
+STDMETHODCALLTYPE
+D3D9SetFVF_Detour (IDirect3DDevice9* This,
+                   DWORD             FVF)
+{
+  HRESULT hr =
+    D3D9SetFVF_Original (This, FVF);
 
-  tbf::RenderFix::pDevice->SetRenderState (D3DRS_FILLMODE, D3DFILL_SOLID);
+  if (This == tbf::RenderFix::pDevice)
+    tbf::RenderFix::device_shadow.setFVF ();
 
   return hr;
 }
 
+//
+// Set* calls made while a state block is recording only go into the block,
+//   the device (and so the state cache) sees them when the block is applied.
+//
+COM_DECLSPEC_NOTHROW
+HRESULT
+STDMETHODCALLTYPE
+D3D9BeginStateBlock_Detour (IDirect3DDevice9* This)
+{
+  HRESULT hr =
+    D3D9BeginStateBlock_Original (This);
+
+  if (This == tbf::RenderFix::pDevice && SUCCEEDED (hr))
+    tbf::RenderFix::state_cache.beginRecording ();
+
+  return hr;
+}
+
+COM_DECLSPEC_NOTHROW
+HRESULT
+STDMETHODCALLTYPE
+D3D9EndStateBlock_Detour (IDirect3DDevice9*      This,
+                          IDirect3DStateBlock9** ppSB)
+{
+  HRESULT hr =
+    D3D9EndStateBlock_Original (This, ppSB);
+
+  // Recording is over either way
+  if (This == tbf::RenderFix::pDevice)
+    tbf::RenderFix::state_cache.endRecording ();
+
+  return hr;
+}
+
+COM_DECLSPEC_NOTHROW
+HRESULT
+STDMETHODCALLTYPE
+D3D9CreateStateBlock_Detour (IDirect3DDevice9*      This,
+                             D3DSTATEBLOCKTYPE      Type,
+                             IDirect3DStateBlock9** ppSB)
+{
+  HRESULT hr =
+    D3D9CreateStateBlock_Original (This, Type, ppSB);
+
+  if (This == tbf::RenderFix::pDevice)
+    tbf::RenderFix::state_cache.invalidate ();
+
+  return hr;
+}
+
+COM_DECLSPEC_NOTHROW
+HRESULT
+STDMETHODCALLTYPE
+D3D9StateBlockApply_Detour (IDirect3DStateBlock9* This)
+{
+  HRESULT hr =
+    D3D9StateBlockApply_Original (This);
+
+  // Asking the block for its device costs more than starting over
+  tbf::RenderFix::state_cache.invalidate   ();
+  tbf::RenderFix::device_shadow.invalidate ();
+
+  return hr;
+}
 
 void
 tbf::RenderFix::Reset ( IDirect3DDevice9      *This,
@@ -1823,6 +2183,95 @@ tbf::RenderFix::Reset ( IDirect3DDevice9      *This,
   if (count == 1UL) {
     tex_mgr.Hook         ();
     TBF_ApplyQueuedHooks ();
+
+    // Special K does not offer overrides for these, hook the vtable instead
+    //
+    //   87  SetVertexDeclaration
+    //   89  SetFVF
+    //
+    void** vftable = *(void ***)This;
+
+    if ( TBF_CreateFuncHook ( L"IDirect3DDevice9::SetVertexDeclaration",
+                                vftable [87],
+                                D3D9SetVertexDeclaration_Detour,
+                     (LPVOID *)&D3D9SetVertexDeclaration_Original ) == MH_OK &&
+         TBF_CreateFuncHook ( L"IDirect3DDevice9::SetFVF",
+                                vftable [89],
+                                D3D9SetFVF_Detour,
+                     (LPVOID *)&D3D9SetFVF_Original )               == MH_OK )
+    {
+      TBF_EnableHook (vftable [87]);
+      TBF_EnableHook (vftable [89]);
+
+      device_shadow.decl_hooked = true;
+    }
+
+    //   59  CreateStateBlock
+    //   60  BeginStateBlock
+    //   61  EndStateBlock
+    //
+    //   IDirect3DStateBlock9
+    //     5  Apply
+    //
+    IDirect3DStateBlock9* pSB = nullptr;
+
+    if (SUCCEEDED (This->CreateStateBlock (D3DSBT_VERTEXSTATE, &pSB)))
+    {
+      void** sb_vftable = *(void ***)pSB;
+
+      if ( TBF_CreateFuncHook ( L"IDirect3DDevice9::CreateStateBlock",
+                                  vftable [59],
+                                  D3D9CreateStateBlock_Detour,
+                       (LPVOID *)&D3D9CreateStateBlock_Original ) == MH_OK &&
+           TBF_CreateFuncHook ( L"IDirect3DDevice9::BeginStateBlock",
+                                  vftable [60],
+                                  D3D9BeginStateBlock_Detour,
+                       (LPVOID *)&D3D9BeginStateBlock_Original )  == MH_OK &&
+           TBF_CreateFuncHook ( L"IDirect3DDevice9::EndStateBlock",
+                                  vftable [61],
+                                  D3D9EndStateBlock_Detour,
+                       (LPVOID *)&D3D9EndStateBlock_Original )    == MH_OK &&
+           TBF_CreateFuncHook ( L"IDirect3DStateBlock9::Apply",
+                                  sb_vftable [5],
+                                  D3D9StateBlockApply_Detour,
+                       (LPVOID *)&D3D9StateBlockApply_Original )  == MH_OK )
+      {
+        TBF_EnableHook (vftable [59]);
+        TBF_EnableHook (vftable [60]);
+        TBF_EnableHook (vftable [61]);
+        TBF_EnableHook (sb_vftable [5]);
+
+        state_blocks_hooked = true;
+      }
+
+      pSB->Release ();
+    }
+
+    if (! state_blocks_hooked)
+      dll_log->Log ( L"[Render Fix] State block hooks failed, redundant "
+                     L"state will not be filtered" );
+
+    //   IDirect3DVertexBuffer9
+    //     2  Release
+    //
+    IDirect3DVertexBuffer9* pVB = nullptr;
+
+    if (SUCCEEDED (This->CreateVertexBuffer (16, D3DUSAGE_WRITEONLY, 0, D3DPOOL_MANAGED, &pVB, nullptr)))
+    {
+      void** vb_vftable = *(void ***)pVB;
+
+      if ( TBF_CreateFuncHook ( L"IDirect3DVertexBuffer9::Release",
+                                  vb_vftable [2],
+                                  D3D9VertexBufferRelease_Detour,
+                       (LPVOID *)&D3D9VertexBufferRelease_Original ) == MH_OK )
+      {
+        TBF_EnableHook (vb_vftable [2]);
+
+        vb_release_hooked = true;
+      }
+
+      pVB->Release ();
+    }
   }
 
   else {
@@ -1838,7 +2287,7 @@ tbf::RenderFix::Reset ( IDirect3DDevice9      *This,
 
   need_reset.graphics = false;
 
-  tbf::RenderFix::known_objs.clear ();
+  TBF_UpdateQuality ();
 
 
   tbf::RenderFix::last_frame.clear ();
@@ -1858,6 +2307,11 @@ tbf::RenderFix::Reset ( IDirect3DDevice9      *This,
 
   TBF_AutoViewport (tbf::RenderFix::pDevice).Release ();
 
+  state_cache.invalidate   ();
+  device_shadow.invalidate ();
+
+  TBF_RefreshDrawDecisions (true);
+
   vs_checksums.clear ();
   ps_checksums.clear ();
 
@@ -1866,6 +2320,8 @@ tbf::RenderFix::Reset ( IDirect3DDevice9      *This,
 
   pDevice = This;
 
+  device_shadow.attach (This);
+
   width   = pPresentationParameters->BackBufferWidth;
   height  = pPresentationParameters->BackBufferHeight;
 
@@ -1883,6 +2339,10 @@ D3D9Reset_Detour ( IDirect3DDevice9      *This,
   HRESULT hr =
     D3D9Reset_Original (This, pPresentationParameters);
 
+  // Every state is back to its default after a reset
+  tbf::RenderFix::state_cache.invalidate   ();
+  tbf::RenderFix::device_shadow.invalidate ();
+
   trigger_reset = reset_stage_s::Clear;
 
   tbf::FrameRateFix::need_reset = true;
@@ -1909,6 +2369,18 @@ D3D9TestCooperativeLevel_Detour ( IDirect3DDevice9 *This )
   return D3D9TestCooperativeLevel_Original (This);
 }
 
+//
+// How each live vertex buffer was created. The game releases buffers from its
+//   loading threads too, so the table has a lock of its own; SetStreamSource
+//     only consults it on a buffer's first bind of the frame.
+//
+//   Without the Release hook nothing would ever leave the table, so it is
+//     only used once that hook is in.
+//
+static TBF_VertexBufferTable vb_table;
+static CRITICAL_SECTION      vb_table_cs;
+static bool                  vb_release_hooked = false;
+
 COM_DECLSPEC_NOTHROW
 HRESULT
 STDMETHODCALLTYPE
@@ -1921,7 +2393,7 @@ D3D9CreateVertexBuffer_Detour (
   _Out_ IDirect3DVertexBuffer9 **ppVertexBuffer,
   _In_  HANDLE                  *pSharedHandle )
 {
-  HRESULT hr = 
+  HRESULT hr =
     D3D9CreateVertexBuffer_Original ( This,
                                         Length,
                                           Usage,
@@ -1930,17 +2402,73 @@ D3D9CreateVertexBuffer_Detour (
                                                 ppVertexBuffer,
                                                   pSharedHandle );
 
-  if (SUCCEEDED (hr))
+  if (SUCCEEDED (hr) && vb_release_hooked)
   {
-    if (Usage & D3DUSAGE_DYNAMIC)
-      tbf::RenderFix::known_objs.dynamic_vbs.emplace (*ppVertexBuffer);
-    else
-      tbf::RenderFix::known_objs.static_vbs.emplace (*ppVertexBuffer);
+    EnterCriticalSection (&vb_table_cs);
+    vb_table.created     (*ppVertexBuffer, (Usage & D3DUSAGE_DYNAMIC) != 0);
+    LeaveCriticalSection (&vb_table_cs);
   }
- 
+
   return hr;
 }
 
+//
+// A buffer created at the address between the final release and the lock
+//   below loses its entry; SetStreamSource then asks it for its usage, so the
+//     worst that race does is cost one GetDesc.
+//
+COM_DECLSPEC_NOTHROW
+ULONG
+STDMETHODCALLTYPE
+D3D9VertexBufferRelease_Detour (IDirect3DVertexBuffer9* This)
+{
+  ULONG refs =
+    D3D9VertexBufferRelease_Original (This);
+
+  if (refs == 0)
+  {
+    EnterCriticalSection (&vb_table_cs);
+    vb_table.released    (This);
+    LeaveCriticalSection (&vb_table_cs);
+  }
+
+  return refs;
+}
+
+static
+tbf_vb_usage
+TBF_ClassifyVertexBuffer (IDirect3DVertexBuffer9* pStreamData)
+{
+  tbf_vb_usage usage = tbf_vb_usage::Unknown;
+
+  if (vb_release_hooked)
+  {
+    EnterCriticalSection (&vb_table_cs);
+    usage = vb_table.find (pStreamData);
+    LeaveCriticalSection (&vb_table_cs);
+  }
+
+  // Created before the hooks went in, or lost to the race above
+  if (usage == tbf_vb_usage::Unknown)
+  {
+    D3DVERTEXBUFFER_DESC desc;
+
+    usage = ( SUCCEEDED (pStreamData->GetDesc (&desc)) &&
+                        (desc.Usage & D3DUSAGE_DYNAMIC) ) ?
+              tbf_vb_usage::Dynamic : tbf_vb_usage::Immutable;
+
+    // Bound, so it cannot be released while this runs
+    if (vb_release_hooked)
+    {
+      EnterCriticalSection (&vb_table_cs);
+      vb_table.created     (pStreamData, usage == tbf_vb_usage::Dynamic);
+      LeaveCriticalSection (&vb_table_cs);
+    }
+  }
+
+  return usage;
+}
+
 COM_DECLSPEC_NOTHROW
 HRESULT
 STDMETHODCALLTYPE
@@ -1962,6 +2490,10 @@ D3D9SetStreamSource_Detour
                                              Stride );
   }
 
+  TBF_TraceScope trace ( tbf::RenderFix::call_trace,
+                          tbf_trace_op::SetStreamSource, (uint16_t)StreamNumber,
+                            OffsetInBytes, Stride );
+
   HRESULT hr =
       D3D9SetStreamSource_Original ( This,
                                        StreamNumber,
@@ -1971,10 +2503,24 @@ D3D9SetStreamSource_Detour
 
   if (SUCCEEDED (hr))
   {
-    if (tbf::RenderFix::known_objs.dynamic_vbs.count (pStreamData))
-      tbf::RenderFix::last_frame.vertex_buffers.dynamic.emplace (pStreamData);
-    else
-      tbf::RenderFix::last_frame.vertex_buffers.immutable.emplace (pStreamData);
+    // Unbinding (nullptr) still has to reach the bookkeeping below
+    if (pStreamData != nullptr)
+    {
+      auto& vbs =
+        tbf::RenderFix::last_frame.vertex_buffers;
+
+      // Only the first bind of a buffer each frame looks it up
+      if (! (vbs.dynamic.contains (pStreamData) || vbs.immutable.contains (pStreamData)))
+      {
+        if (TBF_ClassifyVertexBuffer (pStreamData) == tbf_vb_usage::Dynamic)
+          vbs.dynamic.insert   (pStreamData);
+        else
+          vbs.immutable.insert (pStreamData);
+      }
+
+      if (tbf::RenderFix::call_trace.active ())
+        trace.arg (2, vbs.dynamic.contains (pStreamData) ? 1 : 0);
+    }
 
     if (StreamNumber == 0)
       vb_stream0 = pStreamData;
@@ -2045,6 +2591,7 @@ SK_SetPresentParamsD3D9_Detour (IDirect3DDevice9*      device,
   tbf::RenderFix::fullscreen = (! pparams->Windowed);
 
   tbf::RenderFix::pDevice = device;
+  tbf::RenderFix::device_shadow.attach (device);
                           
   tbf::RenderFix::width   = pparams->BackBufferWidth;
   tbf::RenderFix::height  = pparams->BackBufferHeight;
@@ -2074,17 +2621,6 @@ SK_SetPresentParamsD3D9_Detour (IDirect3DDevice9*      device,
 void
 tbf::RenderFix::Init (void)
 {
-  last_frame.vertex_shaders.reserve           (256);
-  last_frame.pixel_shaders.reserve            (256);
-  last_frame.vertex_buffers.dynamic.reserve   (128);
-  last_frame.vertex_buffers.immutable.reserve (256);
-  known_objs.dynamic_vbs.reserve              (2048);
-  known_objs.static_vbs.reserve               (8192);
-  ps_disassembly.reserve                      (512);
-  vs_disassembly.reserve                      (512);
-  vs_checksums.reserve                        (8192);
-  ps_checksums.reserve                        (8192);
-
   aspect_ratio_data.whitelist.vertex_shaders.emplace (0x272a71b0);
   aspect_ratio_data.whitelist.vertex_shaders.emplace (0xce6adab2);
   aspect_ratio_data.whitelist.vertex_shaders.emplace (0x1ea83d81);
@@ -2200,6 +2736,8 @@ tbf::RenderFix::Init (void)
                         D3D9TestCooperativeLevel_Detour,
              (LPVOID *)&D3D9TestCooperativeLevel_Original );
 
+  InitializeCriticalSection (&vb_table_cs);
+
   TBF_CreateDLLHook2 ( config.system.injector.c_str (),
                        "D3D9CreateVertexBuffer_Override",
                         D3D9CreateVertexBuffer_Detour,
@@ -2240,6 +2778,12 @@ tbf::RenderFix::Init (void)
       GetProcAddress ( tbf::RenderFix::d3dx9_43_dll,
                          "D3DXDisassembleShader" );
 
+  TBF_UpdateQuality ();
+
+  shader_disasm.init ();
+  shader_meta.load   (TBFIX_SHADER_META_FILE);
+  shader_inject.scan ();
+
   CommandProcessor* comm_proc = CommandProcessor::getInstance ();
 
   tex_mgr.Init ();
@@ -2248,6 +2792,17 @@ tbf::RenderFix::Init (void)
 void
 tbf::RenderFix::Shutdown (void)
 {
+  call_trace.end         ();
+  shader_disasm.shutdown ();
+  shader_inject.release  ();
+
+  if (shader_meta.dirty ())
+  {
+    CreateDirectoryW (L"TBFix_Res",         nullptr);
+    CreateDirectoryW (L"TBFix_Res\\cache", nullptr);
+
+    shader_meta.save (TBFIX_SHADER_META_FILE);
+  }
   tex_mgr.Shutdown ();
 }
 
@@ -2272,6 +2827,8 @@ tbf::RenderFix::CommandProcessor::CommandProcessor (void)
   SK_IVariable* rescale_shadows     = TBF_CreateVar (SK_IVariable::Int,     &config.render.shadow_rescale);
   SK_IVariable* rescale_env_shadows = TBF_CreateVar (SK_IVariable::Int,     &config.render.env_shadow_rescale);
 
+  SK_IVariable* trace_frames_       = TBF_CreateVar (SK_IVariable::Int,     &trace_frames);
+
   //command.AddVariable ("AspectRatio",         aspect_ratio_);
   //command.AddVariable ("FOVY",                fovy_);
 
@@ -2287,6 +2844,8 @@ tbf::RenderFix::CommandProcessor::CommandProcessor (void)
   command.AddVariable ("PostProcessRatio",      postproc_ratio);
   command.AddVariable ("ClearBlackbars",        clear_blackbars);
 
+  command.AddVariable ("Render.TraceFrames",    trace_frames_);
+
 #if 0
    uint8_t signature [] = { 0x39, 0x8E, 0xE3, 0x3F };
 
@@ -2464,8 +3023,9 @@ tbf::RenderFix::shader_tracking_s
 tbf::RenderFix::vertex_buffer_tracking_s
                    tbf::RenderFix::tracked_vb;
 
-tbf::RenderFix::known_objects_s
-                   tbf::RenderFix::known_objs;
+TBF_DeviceShadow
+                   tbf::RenderFix::device_shadow;
+
 
 void
 EnumConstant ( tbf::RenderFix::shader_tracking_s* pShader,
@@ -2520,6 +3080,16 @@ tbf::RenderFix::shader_tracking_s::use (IUnknown *pShader)
 
     shader_obj = pShader;
 
+    // Walked once per shader ever, the layout is kept in the metadata cache
+    tbf_shader_meta_s* meta =
+      shader_meta.findCRC (crc32);
+
+    if (meta != nullptr && meta->has_constants)
+    {
+      constants = meta->constants;
+      return;
+    }
+
     static D3DXGetShaderConstantTable_pfn D3DXGetShaderConstantTable =
       (D3DXGetShaderConstantTable_pfn)
         GetProcAddress (d3dx9_43_dll, "D3DXGetShaderConstantTable");
@@ -2555,6 +3125,9 @@ tbf::RenderFix::shader_tracking_s::use (IUnknown *pShader)
 
                 EnumConstant (this, pConstantTable, hConstant, constant, constants);
               }
+
+              if (meta != nullptr)
+                shader_meta.setConstants (meta, constants);
             }
           }
         }
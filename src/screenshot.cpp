@@ -0,0 +1,384 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include "screenshot.h"
+#include "config.h"
+#include "log.h"
+
+#include <process.h>
+
+#include <algorithm>
+#include <queue>
+
+extern iSK_Logger* tex_log;
+
+
+struct tbf_deflate_job_s {
+  TBF_PNGEncoder*    png;
+  size_t             band;
+
+  volatile LONG*     remaining;
+  HANDLE             done;
+};
+
+//
+// Deflate helpers: a fixed set of threads started along with the encoder
+//   thread; TBF_WritePNG hands them bands of rows and works on the queue
+//     itself until it is empty.
+//
+#define TBF_MAX_DEFLATE_THREADS 8
+
+static CRITICAL_SECTION                  cs_deflate           = { };
+static std::queue <tbf_deflate_job_s *>  deflate_queue;
+static HANDLE                            hDeflateWork         = nullptr;
+static HANDLE                            hScreenshotShutdown  = nullptr;
+static std::vector <HANDLE>              deflate_threads;
+
+static tbf_deflate_job_s*
+TBF_NextDeflateJob (void)
+{
+  tbf_deflate_job_s* job = nullptr;
+
+  EnterCriticalSection (&cs_deflate);
+  {
+    if (! deflate_queue.empty ())
+    {
+      job = deflate_queue.front ();
+            deflate_queue.pop   ();
+    }
+  }
+  LeaveCriticalSection (&cs_deflate);
+
+  return job;
+}
+
+static void
+TBF_RunDeflateJob (tbf_deflate_job_s* job)
+{
+  job->png->deflateBand (job->band);
+
+  if (InterlockedDecrement (job->remaining) == 0)
+    SetEvent (job->done);
+}
+
+static unsigned int
+__stdcall
+TBF_DeflateThread (LPVOID user)
+{
+  UNREFERENCED_PARAMETER (user);
+
+  HANDLE wait_objs [] = { hDeflateWork, hScreenshotShutdown };
+
+  // The semaphore may count jobs that TBF_WritePNG already took itself
+  while (WaitForMultipleObjects (2, wait_objs, FALSE, INFINITE) == WAIT_OBJECT_0)
+  {
+    tbf_deflate_job_s* job =
+      TBF_NextDeflateJob ();
+
+    if (job != nullptr)
+      TBF_RunDeflateJob (job);
+  }
+
+  return 0;
+}
+
+bool
+TBF_WritePNG ( const wchar_t* wszFileName, const uint32_t* bgra,
+               uint32_t       width,       uint32_t        height,
+               int            threads )
+{
+  TBF_PNGEncoder png;
+
+  png.begin (bgra, width, height, threads);
+
+  //
+  // Compress bands of rows in parallel
+  //
+  std::vector <tbf_deflate_job_s> jobs (png.numBands ());
+
+  HANDLE        hDone     = CreateEvent (nullptr, TRUE, FALSE, nullptr);
+  volatile LONG remaining = (LONG)jobs.size ();
+
+  for (size_t i = 0; i < jobs.size (); i++)
+  {
+    jobs [i].png       = &png;
+    jobs [i].band      = i;
+    jobs [i].remaining = &remaining;
+    jobs [i].done      = hDone;
+  }
+
+  if (jobs.size () > 1 && (! deflate_threads.empty ()))
+  {
+    EnterCriticalSection (&cs_deflate);
+    {
+      for (size_t i = 1; i < jobs.size (); i++)
+        deflate_queue.push (&jobs [i]);
+    }
+    LeaveCriticalSection (&cs_deflate);
+
+    ReleaseSemaphore (hDeflateWork, (LONG)jobs.size () - 1, nullptr);
+  }
+
+  else
+  {
+    for (size_t i = 1; i < jobs.size (); i++)
+      TBF_RunDeflateJob (&jobs [i]);
+  }
+
+  if (! jobs.empty ())
+    TBF_RunDeflateJob (&jobs [0]);
+
+  // Help out with whatever the pool has not picked up yet
+  tbf_deflate_job_s* job;
+
+  while ((job = TBF_NextDeflateJob ()) != nullptr)
+    TBF_RunDeflateJob (job);
+
+  if (! jobs.empty ())
+    WaitForSingleObject (hDone, INFINITE);
+
+  CloseHandle (hDone);
+
+  return png.finish (wszFileName);
+}
+
+
+//
+// Screenshot queue: one persistent encoder thread, a small bounded backlog
+//
+#define TBF_MAX_QUEUED_SCREENSHOTS 3
+
+static CRITICAL_SECTION                 cs_screenshots       = { };
+static std::queue <tbf_screenshot_s *>  screenshot_queue;
+static HANDLE                           hScreenshotThread    = nullptr;
+static HANDLE                           hScreenshotWork      = nullptr;
+static volatile LONG                    screenshots_pending  = 0L;
+
+static void
+TBF_EncodeScreenshot (tbf_screenshot_s* shot)
+{
+  bool png =
+    shot->file.length () > 4 &&
+    _wcsicmp (shot->file.c_str () + shot->file.length () - 4, L".png") == 0;
+
+  bool ok =
+    png ? TBF_WritePNG ( shot->file.c_str (), shot->pixels.data (),
+                           shot->width, shot->height,
+                             (int)deflate_threads.size () + 1 ) :
+          TBF_WriteTGA ( shot->file.c_str (), shot->pixels.data (),
+                           shot->width, shot->height );
+
+  if (! ok)
+  {
+    tex_log->Log (L"[Screenshot] Failed to write %s", shot->file.c_str ());
+    return;
+  }
+
+  if (! config.screenshots.import_to_steam)
+    return;
+
+  extern HMODULE hInjectorDLL;
+
+  typedef void (WINAPI *SK_SteamAPI_AddScreenshotToLibrary_pfn)
+    (const char *pchFilename, const char *pchThumbnailFilename, int nWidth, int nHeight);
+
+  static SK_SteamAPI_AddScreenshotToLibrary_pfn
+    SK_SteamAPI_AddScreenshotToLibrary =
+      (SK_SteamAPI_AddScreenshotToLibrary_pfn)
+        GetProcAddress ( hInjectorDLL,
+                           "SK_SteamAPI_AddScreenshotToLibrary" );
+
+  if (SK_SteamAPI_AddScreenshotToLibrary == nullptr)
+    return;
+
+  bool with_thumbnail = false;
+
+  if (! shot->thumbnail.empty ())
+  {
+    const uint32_t thumb_width  = 200;
+    const uint32_t thumb_height =
+      std::max (1U, (uint32_t)(((float)shot->height / (float)shot->width) * 200));
+
+    std::vector <uint32_t> thumb ((size_t)thumb_width * thumb_height);
+
+    TBF_BoxDownscaleBGRA ( shot->pixels.data (), shot->width, shot->height,
+                             thumb.data (),      thumb_width, thumb_height );
+
+    if (TBF_WriteTGA (shot->thumbnail.c_str (), thumb.data (), thumb_width, thumb_height))
+    {
+      SK_SteamAPI_AddScreenshotToLibrary ( shot->file_ansi.c_str (), shot->thumbnail_ansi.c_str (),
+                                             shot->width, shot->height );
+      with_thumbnail = true;
+    }
+  }
+
+  if (! with_thumbnail)
+    SK_SteamAPI_AddScreenshotToLibrary (shot->file_ansi.c_str (), nullptr, shot->width, shot->height);
+}
+
+static unsigned int
+__stdcall
+TBF_ScreenshotThread (LPVOID user)
+{
+  UNREFERENCED_PARAMETER (user);
+
+  HANDLE wait_objs [] = { hScreenshotWork, hScreenshotShutdown };
+
+  bool run = true;
+
+  while (run)
+  {
+    if (WaitForMultipleObjects (2, wait_objs, FALSE, INFINITE) != WAIT_OBJECT_0)
+      run = false;
+
+    // Whatever is queued still gets written during shutdown
+    while (true)
+    {
+      tbf_screenshot_s* shot = nullptr;
+
+      EnterCriticalSection (&cs_screenshots);
+      {
+        if (! screenshot_queue.empty ())
+        {
+          shot = screenshot_queue.front ();
+                 screenshot_queue.pop   ();
+        }
+      }
+      LeaveCriticalSection (&cs_screenshots);
+
+      if (shot == nullptr)
+        break;
+
+      TBF_EncodeScreenshot (shot);
+
+      delete shot;
+
+      InterlockedDecrement (&screenshots_pending);
+    }
+  }
+
+  return 0;
+}
+
+bool
+TBF_QueueScreenshot (tbf_screenshot_s* shot)
+{
+  // Started the first time a screenshot is taken
+  if (hScreenshotThread == nullptr)
+  {
+    InitializeCriticalSection (&cs_screenshots);
+    InitializeCriticalSection (&cs_deflate);
+
+    hScreenshotWork     = CreateEvent     (nullptr, FALSE, FALSE, nullptr);
+    hScreenshotShutdown = CreateEvent     (nullptr, TRUE,  FALSE, nullptr);
+    hDeflateWork        = CreateSemaphore (nullptr, 0,     LONG_MAX, nullptr);
+
+    SYSTEM_INFO sysinfo;
+    GetSystemInfo (&sysinfo);
+
+    const int helpers =
+      std::min (TBF_MAX_DEFLATE_THREADS, (int)sysinfo.dwNumberOfProcessors - 1);
+
+    for (int i = 0; i < helpers; i++)
+    {
+      HANDLE hThread =
+        (HANDLE)_beginthreadex ( nullptr, 0,
+                                   TBF_DeflateThread,
+                                     nullptr,
+                                       0x00, nullptr );
+
+      if (hThread != nullptr)
+        deflate_threads.push_back (hThread);
+    }
+
+    hScreenshotThread =
+      (HANDLE)_beginthreadex ( nullptr, 0,
+                                 TBF_ScreenshotThread,
+                                   nullptr,
+                                     0x00, nullptr );
+
+    if (hScreenshotThread == nullptr)
+    {
+      delete shot;
+      return false;
+    }
+  }
+
+  if (InterlockedIncrement (&screenshots_pending) > TBF_MAX_QUEUED_SCREENSHOTS)
+  {
+    InterlockedDecrement (&screenshots_pending);
+
+    tex_log->Log (L"[Screenshot] Too many screenshots are still being encoded, skipping...");
+
+    delete shot;
+    return false;
+  }
+
+  EnterCriticalSection (&cs_screenshots);
+  {
+    screenshot_queue.push (shot);
+  }
+  LeaveCriticalSection (&cs_screenshots);
+
+  SetEvent (hScreenshotWork);
+
+  return true;
+}
+
+size_t
+TBF_PendingScreenshots (void)
+{
+  return InterlockedExchangeAdd (&screenshots_pending, 0);
+}
+
+void
+TBF_ShutdownScreenshots (void)
+{
+  if (hScreenshotThread == nullptr)
+    return;
+
+  // The encoder finishes whatever is queued on its own if the helpers are
+  //   already gone
+  SetEvent            (hScreenshotShutdown);
+  WaitForSingleObject (hScreenshotThread, INFINITE);
+
+  for ( auto hThread : deflate_threads )
+  {
+    WaitForSingleObject (hThread, INFINITE);
+    CloseHandle         (hThread);
+  }
+
+  deflate_threads.clear ();
+
+  CloseHandle (hScreenshotThread);
+  CloseHandle (hScreenshotWork);
+  CloseHandle (hScreenshotShutdown);
+  CloseHandle (hDeflateWork);
+
+  hScreenshotThread = nullptr;
+
+  DeleteCriticalSection (&cs_deflate);
+  DeleteCriticalSection (&cs_screenshots);
+}
@@ -0,0 +1,346 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "shader_disasm.h"
+
+#include <process.h>
+#include <share.h>
+
+#include <atlbase.h>
+
+extern D3DXDisassembleShader_pfn D3DXDisassembleShader;
+
+static const wchar_t*
+TBF_ShaderStagePrefix (tbf_shader_stage stage)
+{
+  return stage == tbf_shader_stage::Pixel ? L"ps" : L"vs";
+}
+
+static uint64_t
+TBF_ShaderDisasmKey (tbf_shader_stage stage, uint32_t crc32)
+{
+  return ((uint64_t)stage << 32ULL) | crc32;
+}
+
+static void
+TBF_MakeShaderDirectory (const wchar_t* wszSubDir)
+{
+  wchar_t wszDir [MAX_PATH] = { L'\0' };
+
+  swprintf_s (wszDir, MAX_PATH, L"TBFix_Res\\%s", wszSubDir);
+
+  if (GetFileAttributes (wszDir) != FILE_ATTRIBUTE_DIRECTORY)
+  {
+    wchar_t wszParent [MAX_PATH] = { L'\0' };
+
+    wcscpy (wszParent, wszDir);
+
+    *wcsrchr (wszParent, L'\\') = L'\0';
+
+    CreateDirectoryW (L"TBFix_Res", nullptr);
+    CreateDirectoryW (wszParent,    nullptr);
+    CreateDirectoryW (wszDir,       nullptr);
+  }
+}
+
+static bool
+TBF_WriteShaderText (const wchar_t* wszFileName, const void* pData, size_t size)
+{
+  FILE* fOut = _wfsopen (wszFileName, L"wb", _SH_DENYWR);
+
+  if (fOut == nullptr)
+    return false;
+
+  bool ok =
+    fwrite (pData, size, 1, fOut) == 1;
+
+  fclose (fOut);
+
+  if (! ok)
+    DeleteFileW (wszFileName);
+
+  return ok;
+}
+
+static bool
+TBF_ReadShaderText (const wchar_t* wszFileName, std::string& text)
+{
+  FILE* fIn = _wfsopen (wszFileName, L"rb", _SH_DENYWR);
+
+  if (fIn == nullptr)
+    return false;
+
+  fseek (fIn, 0, SEEK_END);
+  long size = ftell (fIn);
+  fseek (fIn, 0, SEEK_SET);
+
+  bool ok = size > 0;
+
+  if (ok)
+  {
+    text.resize (size);
+
+    ok = fread (&text [0], size, 1, fIn) == 1;
+  }
+
+  fclose (fIn);
+
+  return ok;
+}
+
+
+bool
+TBF_ShaderDisassembler::init (void)
+{
+  if (thread_ != nullptr)
+    return true;
+
+  if (D3DXDisassembleShader == nullptr)
+    return false;
+
+  InitializeCriticalSection (&cs_);
+
+  work_     = CreateEvent (nullptr, FALSE, FALSE, nullptr);
+  shutdown_ = CreateEvent (nullptr, TRUE,  FALSE, nullptr);
+
+  thread_ =
+    (HANDLE)_beginthreadex ( nullptr,
+                               0,
+                                 ThreadProc,
+                                   this,
+                                     0x00,
+                                       nullptr );
+
+  return thread_ != nullptr;
+}
+
+void
+TBF_ShaderDisassembler::shutdown (void)
+{
+  if (thread_ == nullptr)
+    return;
+
+  SetEvent            (shutdown_);
+  WaitForSingleObject (thread_, INFINITE);
+
+  CloseHandle (thread_);
+  CloseHandle (work_);
+  CloseHandle (shutdown_);
+
+  thread_ = nullptr;
+
+  requests_.clear  ();
+  requested_.clear ();
+  disasm_ [0].clear ();
+  disasm_ [1].clear ();
+
+  DeleteCriticalSection (&cs_);
+}
+
+bool
+TBF_ShaderDisassembler::request ( tbf_shader_stage stage, uint32_t crc32,
+                                  const void*      pbFunc, UINT     len,
+                                  bool             html )
+{
+  if (thread_ == nullptr || pbFunc == nullptr || len == 0)
+    return false;
+
+  EnterCriticalSection (&cs_);
+
+  bool queued = false;
+
+  if ( requested_.emplace (TBF_ShaderDisasmKey (stage, crc32)).second )
+  {
+    tbf_disasm_request_s req;
+
+    req.stage = stage;
+    req.crc32 = crc32;
+    req.html  = html;
+    req.bytecode.assign ((const char *)pbFunc, len);
+
+    requests_.push_back (std::move (req));
+    queued = true;
+  }
+
+  LeaveCriticalSection (&cs_);
+
+  if (queued)
+    SetEvent (work_);
+
+  return queued;
+}
+
+const tbf::RenderFix::shader_disasm_s*
+TBF_ShaderDisassembler::find (tbf_shader_stage stage, uint32_t crc32)
+{
+  if (thread_ == nullptr)
+    return nullptr;
+
+  const tbf::RenderFix::shader_disasm_s* pDisasm = nullptr;
+
+  EnterCriticalSection (&cs_);
+
+  auto& disasm =
+    disasm_ [(int)stage];
+
+  auto it =
+    disasm.find (crc32);
+
+  if (it != disasm.end ())
+    pDisasm = &it->second;
+
+  LeaveCriticalSection (&cs_);
+
+  return pDisasm;
+}
+
+void
+TBF_ShaderDisassembler::process (const tbf_disasm_request_s& req)
+{
+  const wchar_t* wszPrefix =
+    TBF_ShaderStagePrefix (req.stage);
+
+  wchar_t wszFileName [MAX_PATH] = { L'\0' };
+
+  if (req.html)
+  {
+    TBF_MakeShaderDirectory (L"dump\\shaders");
+
+    swprintf_s ( wszFileName,
+                   MAX_PATH,
+                     L"TBFix_Res\\dump\\shaders\\%s_%08x.html",
+                       wszPrefix, req.crc32 );
+
+    if ( GetFileAttributes (wszFileName) == INVALID_FILE_ATTRIBUTES )
+    {
+      CComPtr <ID3DXBuffer> pDisasm = nullptr;
+
+      if ( SUCCEEDED ( D3DXDisassembleShader ( (const DWORD *)req.bytecode.data (),
+                                                 TRUE, "", &pDisasm ) ) )
+      {
+        TBF_WriteShaderText ( wszFileName,
+                                pDisasm->GetBufferPointer (),
+                                  pDisasm->GetBufferSize  () );
+      }
+    }
+  }
+
+  TBF_MakeShaderDirectory (L"cache\\shaders");
+
+  swprintf_s ( wszFileName,
+                 MAX_PATH,
+                   L"TBFix_Res\\cache\\shaders\\%s_%08x.txt",
+                     wszPrefix, req.crc32 );
+
+  std::string text;
+
+  if (TBF_ReadShaderText (wszFileName, text))
+    InterlockedIncrement (&cache_hits_);
+
+  else
+  {
+    CComPtr <ID3DXBuffer> pDisasm = nullptr;
+
+    if ( SUCCEEDED ( D3DXDisassembleShader ( (const DWORD *)req.bytecode.data (),
+                                               FALSE, "", &pDisasm ) ) )
+    {
+      text = (const char *)pDisasm->GetBufferPointer ();
+
+      if (text.length ())
+        TBF_WriteShaderText (wszFileName, text.data (), text.length ());
+    }
+
+    InterlockedIncrement (&disassembled_);
+  }
+
+  // Trailing NUL from a buffer written by an older build
+  while (text.length () && text.back () == '\0')
+    text.pop_back ();
+
+  if (text.empty ())
+    return;
+
+  size_t comments_end  =                              text.find ("\n ");
+  size_t footer_begins = comments_end != std::string::npos ?
+                                                      text.find ("\n\n", comments_end + 1) :
+                                                      std::string::npos;
+
+  tbf::RenderFix::shader_disasm_s disasm;
+
+  disasm.header = text.substr (0, comments_end);
+  disasm.code   = comments_end  != std::string::npos ?
+                    text.substr (comments_end + 1, footer_begins != std::string::npos ?
+                                                     footer_begins - comments_end - 1 :
+                                                     std::string::npos) : " ";
+  disasm.footer = footer_begins != std::string::npos ?
+                    text.substr (footer_begins + 1) : " ";
+
+  EnterCriticalSection (&cs_);
+
+  disasm_ [(int)req.stage].emplace (req.crc32, std::move (disasm));
+
+  LeaveCriticalSection (&cs_);
+}
+
+unsigned int
+__stdcall
+TBF_ShaderDisassembler::ThreadProc (LPVOID user)
+{
+  TBF_ShaderDisassembler* pDisasm =
+    (TBF_ShaderDisassembler *)user;
+
+  SetThreadPriority ( GetCurrentThread (),
+                        THREAD_PRIORITY_IDLE |
+                        THREAD_MODE_BACKGROUND_BEGIN );
+
+  HANDLE wait_objs [] = { pDisasm->work_, pDisasm->shutdown_ };
+
+  while (WaitForMultipleObjects (2, wait_objs, FALSE, INFINITE) == WAIT_OBJECT_0)
+  {
+    while (WaitForSingleObject (pDisasm->shutdown_, 0) == WAIT_TIMEOUT)
+    {
+      tbf_disasm_request_s req;
+
+      EnterCriticalSection (&pDisasm->cs_);
+
+      if (pDisasm->requests_.empty ())
+      {
+        LeaveCriticalSection (&pDisasm->cs_);
+        break;
+      }
+
+      req = std::move (pDisasm->requests_.front ());
+                       pDisasm->requests_.pop_front ();
+
+      LeaveCriticalSection (&pDisasm->cs_);
+
+      pDisasm->process (req);
+    }
+  }
+
+  SetThreadPriority ( GetCurrentThread (),
+                        THREAD_MODE_BACKGROUND_END );
+
+  return 0;
+}
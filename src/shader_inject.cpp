@@ -0,0 +1,198 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "shader_inject.h"
+#include "log.h"
+
+#include <vector>
+
+#define TBFIX_SHADER_INJECT_DIR L"TBFix_Res\\inject\\shaders"
+
+// Anything larger than this is not SM3 bytecode
+static const size_t MAX_SHADER_SIZE = 1024 * 1024;
+
+size_t
+TBF_ShaderInjector::scan (void)
+{
+  release ();
+
+  files_ [0].clear ();
+  files_ [1].clear ();
+
+  WIN32_FIND_DATA fd     = { };
+  HANDLE          hFind  =
+    FindFirstFileW (TBFIX_SHADER_INJECT_DIR L"\\*.cso", &fd);
+
+  if (hFind == INVALID_HANDLE_VALUE)
+    return 0;
+
+  do
+  {
+    if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+      continue;
+
+    wchar_t  wszStage [3] = { L'\0' };
+    uint32_t crc32        = 0x00;
+
+    if (swscanf (fd.cFileName, L"%2ls_%08x.cso", wszStage, &crc32) != 2)
+      continue;
+
+    tbf_shader_stage stage;
+
+         if (! _wcsicmp (wszStage, L"vs")) stage = tbf_shader_stage::Vertex;
+    else if (! _wcsicmp (wszStage, L"ps")) stage = tbf_shader_stage::Pixel;
+    else
+      continue;
+
+    replacement_s& repl =
+      files_ [(int)stage][crc32];
+
+    repl.path  = TBFIX_SHADER_INJECT_DIR L"\\";
+    repl.path += fd.cFileName;
+  } while (FindNextFileW (hFind, &fd));
+
+  FindClose (hFind);
+
+  if (numFiles ())
+  {
+    dll_log->Log ( L"[Shader Inj] Found %lu replacement vertex and %lu pixel shaders.",
+                     files_ [(int)tbf_shader_stage::Vertex].size (),
+                     files_ [(int)tbf_shader_stage::Pixel ].size () );
+  }
+
+  return numFiles ();
+}
+
+void
+TBF_ShaderInjector::release (void)
+{
+  for ( auto& stage : files_ )
+  {
+    for ( auto& it : stage )
+    {
+      if (it.second.shader != nullptr)
+        it.second.shader->Release ();
+
+      it.second.shader = nullptr;
+      it.second.failed = false;
+    }
+  }
+
+  device_ = nullptr;
+  loaded_ = 0;
+}
+
+bool
+TBF_ShaderInjector::has (tbf_shader_stage stage, uint32_t crc32) const
+{
+  return files_ [(int)stage].count (crc32) != 0;
+}
+
+bool
+TBF_ShaderInjector::validate (tbf_shader_stage stage, const void* pbFunc, size_t len)
+{
+  return TBF_IsShaderBytecode (stage, pbFunc, len);
+}
+
+IUnknown*
+TBF_ShaderInjector::replacement ( IDirect3DDevice9* pDevice,
+                                  tbf_shader_stage  stage,
+                                  uint32_t          crc32 )
+{
+  auto it =
+    files_ [(int)stage].find (crc32);
+
+  if (it == files_ [(int)stage].end ())
+    return nullptr;
+
+  // Shaders belong to the device that created them
+  if (device_ != pDevice)
+  {
+    release ();
+    device_ = pDevice;
+  }
+
+  replacement_s& repl = it->second;
+
+  if (repl.shader != nullptr || repl.failed)
+    return repl.shader;
+
+  repl.failed = true;
+
+  FILE* fShader =
+    _wfopen (repl.path.c_str (), L"rb");
+
+  if (fShader == nullptr)
+    return nullptr;
+
+  fseek (fShader, 0, SEEK_END);
+  long size = ftell (fShader);
+  fseek (fShader, 0, SEEK_SET);
+
+  std::vector <DWORD> bytecode;
+
+  bool read =
+    size > 0 && (size_t)size <= MAX_SHADER_SIZE;
+
+  if (read)
+  {
+    bytecode.resize ((size + sizeof (DWORD) - 1) / sizeof (DWORD));
+    read = fread (bytecode.data (), size, 1, fShader) == 1;
+  }
+
+  fclose (fShader);
+
+  if (! (read && validate (stage, bytecode.data (), size)))
+  {
+    dll_log->Log ( L"[Shader Inj] '%s' is not valid %s shader bytecode, ignoring it.",
+                     repl.path.c_str (),
+                       stage == tbf_shader_stage::Pixel ? L"pixel" : L"vertex" );
+    return nullptr;
+  }
+
+  HRESULT hr;
+
+  if (stage == tbf_shader_stage::Pixel)
+    hr = pDevice->CreatePixelShader  (bytecode.data (), (IDirect3DPixelShader9  **)&repl.shader);
+  else
+    hr = pDevice->CreateVertexShader (bytecode.data (), (IDirect3DVertexShader9 **)&repl.shader);
+
+  if (FAILED (hr))
+  {
+    dll_log->Log ( L"[Shader Inj] Could not create '%s' (hr=%x).",
+                     repl.path.c_str (), hr );
+
+    repl.shader = nullptr;
+    return nullptr;
+  }
+
+  repl.failed = false;
+  ++loaded_;
+
+  dll_log->Log ( L"[Shader Inj] Replacing %s shader %08x with '%s'.",
+                   stage == tbf_shader_stage::Pixel ? L"pixel" : L"vertex",
+                     crc32, repl.path.c_str () );
+
+  return repl.shader;
+}
@@ -0,0 +1,303 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include "shader_meta.h"
+#include "log.h"
+
+#include <intrin.h>
+#include <algorithm>
+#include <cstring>
+
+uint64_t
+TBF_ShaderMetaCache::hash (const void* pbFunc, UINT len)
+{
+  const uint64_t mul = 0x9e3779b97f4a7c15ULL;
+
+  const uint8_t* pb = (const uint8_t *)pbFunc;
+  uint64_t       h  = 0xcbf29ce484222325ULL ^ ((uint64_t)len * mul);
+
+  UINT i = 0;
+
+  for ( ; i + 8 <= len; i += 8)
+  {
+    uint64_t v;
+    memcpy (&v, pb + i, sizeof (uint64_t));
+
+    h ^= v * mul;
+    h  = _rotl64 (h, 29) * 0xbf58476d1ce4e5b9ULL;
+  }
+
+  // Shader bytecode is a stream of DWORD tokens; this covers the odd one
+  for ( ; i < len; i++)
+  {
+    h ^= pb [i] * mul;
+    h  = _rotl64 (h, 29) * 0xbf58476d1ce4e5b9ULL;
+  }
+
+  h ^= h >> 31;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 29;
+
+  return h;
+}
+
+tbf_shader_meta_s*
+TBF_ShaderMetaCache::find (UINT len, uint64_t hash)
+{
+  auto it =
+    entries_.find (key_s { hash, len });
+
+  if (it == entries_.end ())
+    return nullptr;
+
+  it->second.used = true;
+
+  return &it->second;
+}
+
+tbf_shader_meta_s*
+TBF_ShaderMetaCache::findCRC (uint32_t crc32)
+{
+  auto it =
+    by_crc_.find (crc32);
+
+  return it != by_crc_.end () ? it->second : nullptr;
+}
+
+tbf_shader_meta_s*
+TBF_ShaderMetaCache::insert (UINT len, uint64_t hash, uint32_t crc32)
+{
+  tbf_shader_meta_s& meta =
+    entries_ [key_s { hash, len }];
+
+  meta.crc32 = crc32;
+  meta.used  = true;
+
+  by_crc_ [crc32] = &meta;
+
+  dirty_ = true;
+
+  return &meta;
+}
+
+void
+TBF_ShaderMetaCache::setConstants ( tbf_shader_meta_s*                          pMeta,
+                                    const std::vector <tbf_shader_constant_s>& constants )
+{
+  pMeta->constants     = constants;
+  pMeta->has_constants = true;
+
+  dirty_ = true;
+}
+
+
+bool
+TBF_ShaderMetaCache::readConstants ( FILE*                                 fMeta,
+                                     std::vector <tbf_shader_constant_s>& list,
+                                     uint32_t                              depth )
+{
+  uint32_t count = 0;
+
+  if ( depth > MAX_DEPTH                                      ||
+       fread (&count, sizeof (uint32_t), 1, fMeta) != 1       ||
+       count > MAX_CONSTANTS )
+    return false;
+
+  list.resize (count);
+
+  for ( auto& it : list )
+  {
+    uint32_t fields [9] = { };
+
+    if (fread (fields, sizeof (uint32_t), 9, fMeta) != 9)
+      return false;
+
+    // fields [0] is the name's length, it is stored without a terminator
+    if ( fields [0] >= sizeof (it.Name) ||
+         fread (it.Name, 1, fields [0], fMeta) != fields [0] )
+      return false;
+
+    it.Name [fields [0]] = '\0';
+
+    it.RegisterSet   = (D3DXREGISTER_SET)    fields [1];
+    it.RegisterIndex =                       fields [2];
+    it.RegisterCount =                       fields [3];
+    it.Class         = (D3DXPARAMETER_CLASS) fields [4];
+    it.Type          = (D3DXPARAMETER_TYPE)  fields [5];
+    it.Rows          =                       fields [6];
+    it.Columns       =                       fields [7];
+    it.Elements      =                       fields [8];
+
+    if (! readConstants (fMeta, it.struct_members, depth + 1))
+      return false;
+  }
+
+  return true;
+}
+
+void
+TBF_ShaderMetaCache::writeConstants ( FILE*                                       fMeta,
+                                      const std::vector <tbf_shader_constant_s>& list )
+{
+  uint32_t count = (uint32_t)list.size ();
+
+  fwrite (&count, sizeof (uint32_t), 1, fMeta);
+
+  for ( auto& it : list )
+  {
+    uint32_t fields [9] = {
+      (uint32_t)strnlen (it.Name, sizeof (it.Name) - 1),
+      (uint32_t)it.RegisterSet,   it.RegisterIndex, it.RegisterCount,
+      (uint32_t)it.Class,         (uint32_t)it.Type,
+                it.Rows,          it.Columns,       it.Elements
+    };
+
+    fwrite (fields,  sizeof (uint32_t), 9,          fMeta);
+    fwrite (it.Name, 1,                 fields [0], fMeta);
+
+    writeConstants (fMeta, it.struct_members);
+  }
+}
+
+bool
+TBF_ShaderMetaCache::load (const wchar_t* wszFileName)
+{
+  FILE* fMeta =
+    _wfopen (wszFileName, L"rb");
+
+  if (fMeta == nullptr)
+    return false;
+
+  uint32_t magic   = 0,
+           version = 0,
+           count   = 0;
+
+  bool ok =
+    fread (&magic,   sizeof (uint32_t), 1, fMeta) == 1 && magic   == MAGIC   &&
+    fread (&version, sizeof (uint32_t), 1, fMeta) == 1 && version == VERSION &&
+    fread (&count,   sizeof (uint32_t), 1, fMeta) == 1 && count   <= MAX_ENTRIES;
+
+  for (uint32_t i = 0; ok && i < count; i++)
+  {
+    key_s             key  = { };
+    tbf_shader_meta_s meta;
+    uint32_t          len  = 0,
+                      flag = 0;
+
+    ok = fread (&key.hash,   sizeof (uint64_t), 1, fMeta) == 1 &&
+         fread (&len,        sizeof (uint32_t), 1, fMeta) == 1 &&
+         fread (&meta.crc32, sizeof (uint32_t), 1, fMeta) == 1 &&
+         fread (&flag,       sizeof (uint32_t), 1, fMeta) == 1 && flag <= 1;
+
+    if (ok && flag)
+      ok = readConstants (fMeta, meta.constants, 0);
+
+    if (ok)
+    {
+      key.len            = len;
+      meta.has_constants = (flag != 0);
+
+      entries_ [key] = std::move (meta);
+    }
+  }
+
+  fclose (fMeta);
+
+  if (! ok)
+  {
+    dll_log->Log ( L"[Shader Cache] '%s' is invalid, starting over.",
+                     wszFileName );
+    entries_.clear ();
+  }
+
+  by_crc_.clear ();
+
+  for ( auto& it : entries_ )
+    by_crc_ [it.second.crc32] = &it.second;
+
+  dirty_ = false;
+
+  return ok;
+}
+
+bool
+TBF_ShaderMetaCache::save (const wchar_t* wszFileName)
+{
+  // Shaders from a game version nobody plays anymore do not get to stay
+  if (entries_.size () > MAX_ENTRIES)
+  {
+    for ( auto it = entries_.begin (); it != entries_.end (); )
+    {
+      if (! it->second.used)
+      {
+        by_crc_.erase (it->second.crc32);
+        it = entries_.erase (it);
+      }
+
+      else
+        ++it;
+    }
+  }
+
+  FILE* fMeta =
+    _wfopen (wszFileName, L"wb");
+
+  if (fMeta == nullptr)
+    return false;
+
+  uint32_t magic   = MAGIC,
+           version = VERSION,
+           count   = (uint32_t)std::min (entries_.size (), (size_t)MAX_ENTRIES);
+
+  fwrite (&magic,   sizeof (uint32_t), 1, fMeta);
+  fwrite (&version, sizeof (uint32_t), 1, fMeta);
+  fwrite (&count,   sizeof (uint32_t), 1, fMeta);
+
+  for ( auto& it : entries_ )
+  {
+    if (count-- == 0)
+      break;
+
+    uint32_t len  = it.first.len,
+             flag = it.second.has_constants ? 1 : 0;
+
+    fwrite (&it.first.hash,   sizeof (uint64_t), 1, fMeta);
+    fwrite (&len,             sizeof (uint32_t), 1, fMeta);
+    fwrite (&it.second.crc32, sizeof (uint32_t), 1, fMeta);
+    fwrite (&flag,            sizeof (uint32_t), 1, fMeta);
+
+    if (flag)
+      writeConstants (fMeta, it.second.constants);
+  }
+
+  bool ret = (ferror (fMeta) == 0);
+
+  fclose (fMeta);
+
+  if (ret)
+    dirty_ = false;
+
+  return ret;
+}
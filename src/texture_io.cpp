@@ -0,0 +1,554 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "texture_io.h"
+
+#ifdef _WIN32
+
+#include <process.h>
+
+bool
+TBF_TextureFile::open (const wchar_t* wszFileName, bool map)
+{
+  close ();
+
+  file_ =
+    CreateFileW ( wszFileName,
+                    GENERIC_READ,
+                      FILE_SHARE_READ,
+                        nullptr,
+                          OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL |
+                            FILE_FLAG_SEQUENTIAL_SCAN,
+                              nullptr );
+
+  if (file_ == INVALID_HANDLE_VALUE)
+    return false;
+
+  DWORD dwSize = GetFileSize (file_, nullptr);
+
+  size_ = (dwSize != INVALID_FILE_SIZE) ? dwSize : 0;
+
+  if (map && size_ > 0)
+  {
+    mapping_ =
+      CreateFileMapping (file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (mapping_ != nullptr)
+      view_ = MapViewOfFile (mapping_, FILE_MAP_READ, 0, 0, 0);
+  }
+
+  return true;
+}
+
+void
+TBF_TextureFile::close (void)
+{
+  if (view_ != nullptr)
+    UnmapViewOfFile (view_);
+
+  if (mapping_ != nullptr)
+    CloseHandle (mapping_);
+
+  if (file_ != INVALID_HANDLE_VALUE)
+    CloseHandle (file_);
+
+  view_    = nullptr;
+  mapping_ = nullptr;
+  file_    = INVALID_HANDLE_VALUE;
+  size_    = 0;
+}
+
+size_t
+TBF_TextureFile::read (void* pBuffer, size_t len)
+{
+  DWORD dwRead = 0UL;
+
+  if ( file_ == INVALID_HANDLE_VALUE ||
+       SetFilePointer (file_, 0, nullptr, FILE_BEGIN) == INVALID_SET_FILE_POINTER )
+    return 0;
+
+  if (! ReadFile (file_, pBuffer, (DWORD)len, &dwRead, nullptr))
+    return 0;
+
+  return dwRead;
+}
+
+bool
+TBF_TextureFile::isRemote (const wchar_t* wszFileName)
+{
+  wchar_t wszFullPath [MAX_PATH] = { };
+
+  if (! GetFullPathNameW (wszFileName, MAX_PATH, wszFullPath, nullptr))
+    return true;
+
+  if (wszFullPath [0] == L'\\' && wszFullPath [1] == L'\\')
+    return true;
+
+  wchar_t wszRoot [4] = { wszFullPath [0], L':', L'\\', L'\0' };
+
+  return GetDriveTypeW (wszRoot) == DRIVE_REMOTE;
+}
+
+struct TBF_ReadAhead::read_s {
+  OVERLAPPED ov;
+  HANDLE     hFile;
+  void*      pData;
+  DWORD      size;
+  void*      user;
+};
+
+TBF_ReadAhead::TBF_ReadAhead (complete_fn complete, size_t max_bytes_in_flight)
+{
+  complete_  = complete;
+  max_bytes_ = max_bytes_in_flight;
+
+  InitializeCriticalSection (&cs_reads_);
+
+  iocp_ =
+    CreateIoCompletionPort (INVALID_HANDLE_VALUE, nullptr, 0, 1);
+
+  if (iocp_ != nullptr)
+  {
+    thread_ =
+      (HANDLE)_beginthreadex ( nullptr,
+                                 0,
+                                   CompletionThread,
+                                     this,
+                                       0x00,
+                                         nullptr );
+  }
+}
+
+TBF_ReadAhead::~TBF_ReadAhead (void)
+{
+  if (thread_ != nullptr)
+  {
+    // Cancelled reads still complete through the port; let the completion
+    //   thread retire them before it is told to stop.
+    EnterCriticalSection (&cs_reads_);
+    {
+      closing_ = true;
+
+      for ( auto req : reads_ )
+        CancelIoEx (req->hFile, &req->ov);
+    }
+    LeaveCriticalSection (&cs_reads_);
+
+    while (inFlight () > 0)
+      Sleep (1);
+
+    PostQueuedCompletionStatus (iocp_, 0, 0, nullptr);
+
+    WaitForSingleObject (thread_, INFINITE);
+    CloseHandle         (thread_);
+  }
+
+  if (iocp_ != nullptr)
+    CloseHandle (iocp_);
+
+  DeleteCriticalSection (&cs_reads_);
+}
+
+bool
+TBF_ReadAhead::running (void) const
+{
+  return thread_ != nullptr;
+}
+
+bool
+TBF_ReadAhead::submit (const wchar_t* wszFileName, void* user)
+{
+  if (thread_ == nullptr)
+    return false;
+
+  HANDLE hFile =
+    CreateFileW ( wszFileName,
+                    GENERIC_READ,
+                      FILE_SHARE_READ,
+                        nullptr,
+                          OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL     |
+                            FILE_FLAG_SEQUENTIAL_SCAN |
+                            FILE_FLAG_OVERLAPPED,
+                              nullptr );
+
+  if (hFile == INVALID_HANDLE_VALUE)
+    return false;
+
+  DWORD dwSize = GetFileSize (hFile, nullptr);
+
+  if (dwSize == INVALID_FILE_SIZE || dwSize == 0)
+  {
+    CloseHandle (hFile);
+    return false;
+  }
+
+  read_s* req = new read_s;
+
+  ZeroMemory (&req->ov, sizeof OVERLAPPED);
+
+  req->hFile = hFile;
+  req->pData = nullptr;
+  req->size  = dwSize;
+  req->user  = user;
+
+  EnterCriticalSection (&cs_reads_);
+
+  // Do not let read-ahead balloon memory use during a bulk load
+  bool queued =
+    (! closing_) && bytes_in_flight_ + dwSize <= max_bytes_;
+
+  if (queued)
+  {
+    req->pData = malloc (dwSize);
+
+    queued = req->pData != nullptr &&
+               CreateIoCompletionPort (hFile, iocp_, 0, 0) != nullptr;
+  }
+
+  if (queued)
+  {
+    ++reads_in_flight_;
+    bytes_in_flight_ += dwSize;
+
+    reads_.insert (req);
+  }
+
+  LeaveCriticalSection (&cs_reads_);
+
+  if ( queued && (! ReadFile (hFile, req->pData, dwSize, nullptr, &req->ov)) &&
+                    GetLastError () != ERROR_IO_PENDING )
+  {
+    EnterCriticalSection (&cs_reads_);
+    {
+      reads_.erase (req);
+
+      --reads_in_flight_;
+      bytes_in_flight_ -= dwSize;
+    }
+    LeaveCriticalSection (&cs_reads_);
+
+    queued = false;
+  }
+
+  if (! queued)
+  {
+    free        (req->pData);
+    CloseHandle (hFile);
+    delete       req;
+  }
+
+  return queued;
+}
+
+size_t
+TBF_ReadAhead::inFlight (void)
+{
+  EnterCriticalSection (&cs_reads_);
+  size_t count = reads_in_flight_;
+  LeaveCriticalSection (&cs_reads_);
+
+  return count;
+}
+
+unsigned int
+__stdcall
+TBF_ReadAhead::CompletionThread (LPVOID user)
+{
+  TBF_ReadAhead* pStage =
+    (TBF_ReadAhead *)user;
+
+  while (true)
+  {
+    DWORD        dwBytes  = 0;
+    ULONG_PTR    key      = 0;
+    LPOVERLAPPED pOverlap = nullptr;
+
+    BOOL bRet =
+      GetQueuedCompletionStatus ( pStage->iocp_,
+                                    &dwBytes, &key,
+                                      &pOverlap,
+                                        INFINITE );
+
+    // Shutdown
+    if (pOverlap == nullptr)
+      break;
+
+    read_s* req =
+      CONTAINING_RECORD (pOverlap, read_s, ov);
+
+    EnterCriticalSection (&pStage->cs_reads_);
+    pStage->reads_.erase (req);
+    LeaveCriticalSection (&pStage->cs_reads_);
+
+    CloseHandle (req->hFile);
+
+    // Also taken by reads cancelled at shutdown
+    if (! (bRet && dwBytes == req->size))
+    {
+      free (req->pData);
+      req->pData = nullptr;
+    }
+
+    pStage->complete_ (req->user, req->pData, req->size);
+
+    EnterCriticalSection (&pStage->cs_reads_);
+    {
+      --pStage->reads_in_flight_;
+      pStage->bytes_in_flight_ -= req->size;
+    }
+    LeaveCriticalSection (&pStage->cs_reads_);
+
+    delete req;
+  }
+
+  return 0;
+}
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+
+static std::string
+TBF_NarrowPath (const wchar_t* wszFileName)
+{
+  std::string path (wcstombs (nullptr, wszFileName, 0) + 1, '\0');
+
+  path.resize (wcstombs (&path [0], wszFileName, path.size ()));
+
+  return path;
+}
+
+bool
+TBF_TextureFile::open (const wchar_t* wszFileName, bool map)
+{
+  close ();
+
+  fd_ =
+    ::open (TBF_NarrowPath (wszFileName).c_str (), O_RDONLY);
+
+  if (fd_ < 0)
+    return false;
+
+  struct stat st = { };
+
+  size_ = (fstat (fd_, &st) == 0) ? (size_t)st.st_size : 0;
+
+  posix_fadvise (fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  if (map && size_ > 0)
+  {
+    void* view =
+      mmap (nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+
+    if (view != MAP_FAILED)
+    {
+      madvise (view, size_, MADV_SEQUENTIAL);
+      view_ = view;
+    }
+  }
+
+  return true;
+}
+
+void
+TBF_TextureFile::close (void)
+{
+  if (view_ != nullptr)
+    munmap ((void *)view_, size_);
+
+  if (fd_ >= 0)
+    ::close (fd_);
+
+  view_ = nullptr;
+  fd_   = -1;
+  size_ = 0;
+}
+
+size_t
+TBF_TextureFile::read (void* pBuffer, size_t len)
+{
+  size_t total = 0;
+
+  while (fd_ >= 0 && total < len)
+  {
+    ssize_t got =
+      pread (fd_, (char *)pBuffer + total, len - total, (off_t)total);
+
+    if (got <= 0)
+      break;
+
+    total += (size_t)got;
+  }
+
+  return total;
+}
+
+bool
+TBF_TextureFile::isRemote (const wchar_t* wszFileName)
+{
+  return wszFileName [0] == L'/' && wszFileName [1] == L'/';
+}
+
+struct TBF_ReadAhead::read_s {
+  std::string path;
+  size_t      size;
+  void*       user;
+};
+
+TBF_ReadAhead::TBF_ReadAhead (complete_fn complete, size_t max_bytes_in_flight)
+{
+  complete_  = complete;
+  max_bytes_ = max_bytes_in_flight;
+
+  thread_ =
+    std::thread (&TBF_ReadAhead::readerThread, this);
+}
+
+TBF_ReadAhead::~TBF_ReadAhead (void)
+{
+  {
+    std::lock_guard <std::mutex> guard (lock_);
+    closing_ = true;
+  }
+
+  queued_.notify_all ();
+  thread_.join       ();
+}
+
+bool
+TBF_ReadAhead::running (void) const
+{
+  return thread_.joinable ();
+}
+
+bool
+TBF_ReadAhead::submit (const wchar_t* wszFileName, void* user)
+{
+  std::string path =
+    TBF_NarrowPath (wszFileName);
+
+  struct stat st = { };
+
+  if (stat (path.c_str (), &st) != 0 || st.st_size <= 0)
+    return false;
+
+  {
+    std::lock_guard <std::mutex> guard (lock_);
+
+    if (closing_ || bytes_in_flight_ + (size_t)st.st_size > max_bytes_)
+      return false;
+
+    ++reads_in_flight_;
+    bytes_in_flight_ += (size_t)st.st_size;
+
+    reads_.push_back (new read_s { path, (size_t)st.st_size, user });
+  }
+
+  queued_.notify_one ();
+
+  return true;
+}
+
+size_t
+TBF_ReadAhead::inFlight (void)
+{
+  std::lock_guard <std::mutex> guard (lock_);
+
+  return reads_in_flight_;
+}
+
+void
+TBF_ReadAhead::readerThread (void)
+{
+  while (true)
+  {
+    read_s* req     = nullptr;
+    bool    closing = false;
+
+    {
+      std::unique_lock <std::mutex> guard (lock_);
+
+      queued_.wait (guard, [&] { return closing_ || (! reads_.empty ()); });
+
+      if (reads_.empty ())
+        break;
+
+      req     = reads_.front ();
+      closing = closing_;
+
+      reads_.pop_front ();
+    }
+
+    // Reads still queued at shutdown are cancelled
+    void* pData =
+      closing ? nullptr : malloc (req->size);
+
+    if (pData != nullptr)
+    {
+      int    fd   = ::open (req->path.c_str (), O_RDONLY);
+      size_t read = 0;
+
+      while (fd >= 0 && read < req->size)
+      {
+        ssize_t got =
+          pread (fd, (char *)pData + read, req->size - read, (off_t)read);
+
+        if (got <= 0)
+          break;
+
+        read += (size_t)got;
+      }
+
+      if (fd >= 0)
+        ::close (fd);
+
+      if (read != req->size)
+      {
+        free (pData);
+        pData = nullptr;
+      }
+    }
+
+    complete_ (req->user, pData, req->size);
+
+    {
+      std::lock_guard <std::mutex> guard (lock_);
+
+      --reads_in_flight_;
+      bytes_in_flight_ -= req->size;
+    }
+
+    delete req;
+  }
+}
+
+#endif
@@ -37,6 +37,14 @@
 #include <algorithm>
 
 #include "command.h"
+#include "pack.h"
+#include "dump_pack.h"
+#include "screenshot.h"
+#include "prefetch.h"
+#include "classifier.h"
+#include "frame_set.h"
+#include "archive_manifest.h"
+#include "texture_io.h"
 
 #include <lzma/7z.h>
 #include <lzma/7zAlloc.h>
@@ -50,7 +58,6 @@
 #include <ctime>
 
 #define TBFIX_TEXTURE_DIR L"TBFix_Res"
-#define TBFIX_TEXTURE_EXT L".dds"
 
 
 static D3DXSaveTextureToFile_pfn               D3DXSaveTextureToFile                        = nullptr;
@@ -150,10 +157,6 @@ private:
 };
 
 
-TBF_HashSet <IDirect3DSurface9 *> outstanding_screenshots; // Not excellent screenshots, but screenhots
-                                                           //   that aren't finished yet and we can't reset
-                                                           //     the D3D9 device because of.
-
 tbf::RenderFix::pad_buttons_t   tbf::RenderFix::pad_buttons;
 
 // D3DXSaveSurfaceToFile issues a StretchRect, but we don't want to log that...
@@ -163,8 +166,11 @@ bool __need_purge     = false;
 bool __log_used       = false;
 bool __show_cache     = false;
 
-bool pending_loads            (void);
-void TBFix_LoadQueuedTextures (void);
+bool pending_loads              (void);
+void TBFix_LoadQueuedTextures   (void);
+void TBF_StartInjectWatch       (void);
+void TBF_StopInjectWatch        (void);
+void TBF_CancelTexturePackBuild (void);
 
 #include <map>
 #include <set>
@@ -178,6 +184,20 @@ std::unordered_map <uint32_t, tbf_tex_record_s> injectable_textures;
 std::vector        <std::wstring>               archives;
 std::unordered_set <uint32_t>                   dumped_textures;
 
+// Encoded sources read ahead of InjectTexture, and what decides to read them
+TBF_SourceStager                                source_stager;
+TBF_TextureUsageModel                           usage_model;
+TBF_WarmStartSet                                warm_start;
+TBF_ResidentPool                                resident_pool;
+
+// Blocking vs. streaming, as measured rather than as authored
+TBF_LoadClassifier                              load_classifier;
+
+#define TBFIX_USAGE_MODEL_FILE TBFIX_TEXTURE_DIR L"\\texture_usage.model"
+#define TBFIX_USAGE_TRACE_FILE TBFIX_TEXTURE_DIR L"\\texture_usage.trace"
+#define TBFIX_WARM_START_FILE  TBFIX_TEXTURE_DIR L"\\texture_warmstart.dat"
+#define TBFIX_LOAD_STATS_FILE  TBFIX_TEXTURE_DIR L"\\texture_loads.dat"
+
 std::vector <std::wstring>
 TBF_GetTextureArchives (void)
 {
@@ -208,13 +228,22 @@ TBF_GetInjectableTexture (uint32_t checksum)
 
 // The set of textures used during the last frame
 std::vector        <uint32_t>                   textures_last_frame;
-std::unordered_set <uint32_t>                   textures_used;
-std::unordered_set <uint32_t>                   non_power_of_two_textures;
+TBF_FrameSet                                    textures_used (2048);
+
+// Incremented once per-frame; ISKTextureD3D9::last_used is stamped with it
+uint32_t                                        texture_frame = 1UL;
+
+// Vtable shared by every ISKTextureD3D9, set when the first one is created
+void*                                           ISKTextureD3D9_vftable = nullptr;
 
 // Textures that we will not allow injection for
 //   (primarily to speed things up, but also for EULA-related reasons).
 std::unordered_set <uint32_t>                   inject_blacklist;
 
+// Held for the whole of an index build; the source watcher and a manual
+//   refresh share the blacklist and the archive manifest.
+static CRITICAL_SECTION                         cs_inject_index = { };
+
 std::wstring
 SK_D3D9_UsageToStr (DWORD dwUsage)
 {
@@ -647,7 +676,7 @@ D3D9SetRenderState_Detour (IDirect3DDevice9*  This,
   }
 #endif
 
-  return D3D9SetRenderState (This, State, Value);
+  return TBF_SetRenderState (This, State, Value);
 }
 
 COM_DECLSPEC_NOTHROW
@@ -737,13 +766,13 @@ void
 tbf::RenderFix::TextureManager::applyTexture (IDirect3DBaseTexture9* pTex)
 {
   if (known.render_targets.count (pTex) != 0)
-    used.render_targets.emplace (pTex);
+    used.render_targets.insert (pTex);
 }
 
 bool
 tbf::RenderFix::TextureManager::isUsedRenderTarget (IDirect3DBaseTexture9* pTex)
 {
-  return used.render_targets.count (pTex) != 0;
+  return used.render_targets.contains (pTex);
 }
 
 void
@@ -808,7 +837,28 @@ D3D9SetDepthStencilSurface_Detour (
 uint32_t debug_tex_id      =   0UL;
 uint32_t current_tex [256] = { 0ui32 };
 
-extern SetSamplerState_pfn D3D9SetSamplerState_Original;
+//
+// Creation -> first bind of an injected texture, and whether its override
+//   had arrived by then
+//
+static void
+TBF_RecordFirstBind (ISKTextureD3D9* pSKTex)
+{
+  static LARGE_INTEGER freq = { 0LL };
+
+  if (freq.QuadPart == 0LL)
+    QueryPerformanceFrequency (&freq);
+
+  LARGE_INTEGER now;
+  QueryPerformanceCounter (&now);
+
+  pSKTex->bind_pending = false;
+
+  load_classifier.firstBind ( pSKTex->tex_crc32,
+                                (float)( 1000.0 * (double)(now.QuadPart - pSKTex->created.QuadPart) /
+                                                  (double)freq.QuadPart ),
+                                  pSKTex->pTexOverride != nullptr );
+}
 
 COM_DECLSPEC_NOTHROW
 HRESULT
@@ -824,6 +874,9 @@ D3D9SetTexture_Detour (
     return D3D9SetTexture (This, Sampler, pTexture);
   }
 
+  TBF_TraceScope trace ( tbf::RenderFix::call_trace,
+                          tbf_trace_op::SetTexture, (uint16_t)Sampler );
+
   //if (tbf::RenderFix::tracer.log) {
     //dll_log->Log ( L"[FrameTrace] SetTexture      - Sampler: %lu, pTexture: %ph",
                      //Sampler, pTexture );
@@ -834,8 +887,8 @@ D3D9SetTexture_Detour (
 
   if (tbf::RenderFix::tracked_rt.active)
   {
-    tbf::RenderFix::tracked_rt.vertex_shaders.emplace (vs_checksum);
-    tbf::RenderFix::tracked_rt.pixel_shaders.emplace  (ps_checksum);
+    tbf::RenderFix::tracked_rt.vertex_shaders.insert (vs_checksum);
+    tbf::RenderFix::tracked_rt.pixel_shaders.insert  (ps_checksum);
   }
 
 
@@ -845,13 +898,12 @@ D3D9SetTexture_Detour (
                          ps_checksum == 0x46618c0a &&
          tbf::RenderFix::tex_mgr.isRenderTarget (pTexture) )
     {
-      D3DSURFACE_DESC             surf_desc;
-      CComPtr <IDirect3DSurface9> pSurf  = nullptr;
+      D3DSURFACE_DESC    surf_desc;
+      IDirect3DSurface9* pSurf =
+        tbf::RenderFix::device_shadow.renderTarget (&surf_desc);
 
-      if (SUCCEEDED (This->GetRenderTarget (0, &pSurf)))
+      if (pSurf != nullptr)
       {
-        pSurf->GetDesc (&surf_desc);
-
         if ( surf_desc.Width  == tbf::RenderFix::width  &&
              surf_desc.Height == tbf::RenderFix::height )
         {
@@ -863,9 +915,7 @@ D3D9SetTexture_Detour (
 
   uint32_t tex_crc32 = 0x0;
 
-  void* dontcare;
-  if ( pTexture != nullptr &&
-       pTexture->QueryInterface (IID_SKTextureD3D9, &dontcare) == S_OK )
+  if (TBF_IsWrappedTexture (pTexture))
   {
     ISKTextureD3D9* pSKTex =
       (ISKTextureD3D9 *)pTexture;
@@ -875,11 +925,18 @@ D3D9SetTexture_Detour (
     if (vs_checksum == tbf::RenderFix::tracked_vs.crc32)  tbf::RenderFix::tracked_vs.current_textures [std::min (15UL, Sampler)] = pSKTex->tex_crc32;
     if (ps_checksum == tbf::RenderFix::tracked_ps.crc32)  tbf::RenderFix::tracked_ps.current_textures [std::min (15UL, Sampler)] = pSKTex->tex_crc32;
 
-    textures_used.emplace (pSKTex->tex_crc32);
-
-    QueryPerformanceCounter (&pSKTex->last_used);
+    // First bind this frame
+    if (pSKTex->last_used != texture_frame)
+    {
+      pSKTex->last_used = texture_frame;
+      textures_used.insert (pSKTex->tex_crc32);
+    }
 
     tex_crc32 = pSKTex->tex_crc32;
+    trace.arg (0, tex_crc32);
+
+    if (pSKTex->bind_pending)
+      TBF_RecordFirstBind (pSKTex);
 
     //
     // This is how blocking is implemented -- only do it when a texture that needs
@@ -893,7 +950,10 @@ D3D9SetTexture_Detour (
     }
 
     if (__remap_textures && pSKTex->pTexOverride != nullptr)
+    {
       pTexture = pSKTex->pTexOverride;
+      trace.flag (TBF_TRACE_MODIFIED);
+    }
     else
       pTexture = pSKTex->pTex;
 
@@ -907,11 +967,11 @@ D3D9SetTexture_Detour (
       //
       if (config.textures.clamp_npot_coords)
       {
-        if (non_power_of_two_textures.count (pSKTex->tex_crc32))
+        if (pSKTex->npot)
         {
-          D3D9SetSamplerState_Original (This, Sampler, D3DSAMP_ADDRESSU, D3DTADDRESS_CLAMP );
-          D3D9SetSamplerState_Original (This, Sampler, D3DSAMP_ADDRESSV, D3DTADDRESS_CLAMP );
-          D3D9SetSamplerState_Original (This, Sampler, D3DSAMP_ADDRESSW, D3DTADDRESS_CLAMP );
+          TBF_SetSamplerState (This, Sampler, D3DSAMP_ADDRESSU, D3DTADDRESS_CLAMP );
+          TBF_SetSamplerState (This, Sampler, D3DSAMP_ADDRESSV, D3DTADDRESS_CLAMP );
+          TBF_SetSamplerState (This, Sampler, D3DSAMP_ADDRESSW, D3DTADDRESS_CLAMP );
         }
       }
     }
@@ -937,10 +997,10 @@ D3D9SetTexture_Detour (
   {
     float fMin = -3.0f;
 
-    D3D9SetSamplerState_Original (This, Sampler, D3DSAMP_ADDRESSU, D3DTADDRESS_CLAMP );
-    D3D9SetSamplerState_Original (This, Sampler, D3DSAMP_ADDRESSV, D3DTADDRESS_CLAMP );
-    D3D9SetSamplerState_Original (This, Sampler, D3DSAMP_ADDRESSW, D3DTADDRESS_CLAMP );
-    D3D9SetSamplerState_Original (This, Sampler, D3DSAMP_MIPMAPLODBIAS, *reinterpret_cast <DWORD *>(&fMin) );
+    TBF_SetSamplerState (This, Sampler, D3DSAMP_ADDRESSU, D3DTADDRESS_CLAMP );
+    TBF_SetSamplerState (This, Sampler, D3DSAMP_ADDRESSV, D3DTADDRESS_CLAMP );
+    TBF_SetSamplerState (This, Sampler, D3DSAMP_ADDRESSW, D3DTADDRESS_CLAMP );
+    TBF_SetSamplerState (This, Sampler, D3DSAMP_MIPMAPLODBIAS, *reinterpret_cast <DWORD *>(&fMin) );
   }
 
   //if (pTexture == nullptr)
@@ -1015,7 +1075,7 @@ D3D9CreateTexture_Detour (IDirect3DDevice9   *This,
     rt_classify.shadow.type = &rt_classify.shadow.Environment;
 
     //tex_log->Log (L"[Shadow Mgr] (Env. Resolution: (%lu x %lu) -- CREATE", Width, Height);
-    uint32_t shift = config.render.env_shadow_rescale;
+    uint32_t shift = tbf::RenderFix::quality.env_shadow_rescale;
 
     int unshift = 0;
     Width  <<= shift;
@@ -1038,7 +1098,10 @@ D3D9CreateTexture_Detour (IDirect3DDevice9   *This,
       }
     }
 
-    config.render.env_shadow_rescale -= unshift;
+    // The shadow constants follow the effective value, the control panel
+    //   shows the configured one; neither can go past what the GPU supports.
+    tbf::RenderFix::quality.env_shadow_rescale -= unshift;
+    config.render.env_shadow_rescale           -= unshift;
 
     if (config.render.force_post_mips)
       Levels = 1 + (UINT)floor (log2 (std::max (Width, Height)));
@@ -1053,10 +1116,10 @@ D3D9CreateTexture_Detour (IDirect3DDevice9   *This,
   {
     rt_classify.postproc.type = rt_classify.postproc.DepthOfField;
 
-    if (config.render.postproc_ratio > 0.0f)
+    if (tbf::RenderFix::quality.postproc_ratio > 0.0f)
     {
-      Width  = (UINT)(tbf::RenderFix::width  * config.render.postproc_ratio);
-      Height = (UINT)(tbf::RenderFix::height * config.render.postproc_ratio);
+      Width  = (UINT)(tbf::RenderFix::width  * tbf::RenderFix::quality.postproc_ratio);
+      Height = (UINT)(tbf::RenderFix::height * tbf::RenderFix::quality.postproc_ratio);
 
       tex_log->Log (L"[ PostProc ] (Post-Resolution: (%lu x %lu)", Width, Height);
     }
@@ -1065,9 +1128,9 @@ D3D9CreateTexture_Detour (IDirect3DDevice9   *This,
       Levels = 1 + (UINT)floor (log2 (std::max (Width, Height)));
   }
 
-  else if (   ( config.render.fix_map_res    ||
-                config.render.high_res_bloom ||
-                config.render.high_res_reflection ) &&
+  else if (   ( config.render.fix_map_res                 ||
+                tbf::RenderFix::quality.high_res_bloom      ||
+                tbf::RenderFix::quality.high_res_reflection ) &&
           ( Usage == D3DUSAGE_RENDERTARGET || Usage  == D3DUSAGE_DEPTHSTENCIL ) )
   {
     UINT Original_Width  = Width;
@@ -1078,7 +1141,7 @@ D3D9CreateTexture_Detour (IDirect3DDevice9   *This,
     {
       rt_classify.postproc.type = rt_classify.postproc.Reflection;
 
-      if (config.render.high_res_reflection)
+      if (tbf::RenderFix::quality.high_res_reflection)
       {
         Width *= 2; Height *= 2;
       }
@@ -1092,7 +1155,7 @@ D3D9CreateTexture_Detour (IDirect3DDevice9   *This,
     {
       rt_classify.postproc.type = rt_classify.postproc.Bloom;
 
-      if (config.render.high_res_bloom)
+      if (tbf::RenderFix::quality.high_res_bloom)
       {
         Width *= 2; Height *= 2;
       }
@@ -1327,6 +1390,12 @@ struct tbf_tex_load_s {
   LARGE_INTEGER       start = { 0LL };
   LARGE_INTEGER       end   = { 0LL };
   LARGE_INTEGER       freq  = { 0LL };
+
+  // pSrcData was read ahead by the I/O stage or the source stager (and must be freed)
+  bool                prefetched = false;
+
+  // Goes to the front of its worker pool's queue
+  bool                urgent     = false;
 };
 
 class TexLoadRef {
@@ -1543,7 +1612,11 @@ public:
       // Don't let the game free this while we are working on it...
       job->pDest->AddRef ();
 
-      jobs_.push (job);
+      if (job->urgent)
+        jobs_.push_front (job);
+      else
+        jobs_.push_back  (job);
+
       SetEvent   (events_.jobs_added);
     }
     LeaveCriticalSection (&cs_jobs);
@@ -1633,8 +1706,8 @@ protected:
         return nullptr;
       }
 
-      job = jobs_.front ();
-            jobs_.pop   ();
+      job = jobs_.front     ();
+            jobs_.pop_front ();
     }
     LeaveCriticalSection (&cs_jobs);
 
@@ -1654,7 +1727,7 @@ protected:
   }
 
 private:
-  std::queue <TexLoadRef> jobs_;
+  std::deque <TexLoadRef> jobs_;
   std::queue <TexLoadRef> results_;
 
   std::vector <SK_TextureWorkerThread *> workers_;
@@ -1671,6 +1744,103 @@ private:
   HANDLE spool_thread_;
 } *resample_pool = nullptr;
 
+//
+// Asynchronous read stage for loose-file stream jobs: the file is read ahead
+//   (TBF_ReadAhead, overlapped I/O on a completion port) and only handed to
+//     a worker thread once its data has arrived, so workers spend their time
+//       decoding rather than waiting on the network and reads for the next
+//         jobs proceed while they do.
+//
+//   Only files on a remote drive come through here. Local files are memory
+//     mapped by the worker, which costs neither a buffer nor a copy, and
+//       tests/bench_texture_io shows nothing to gain from staging them: the
+//         same throughput as mapping, cold or warm, for 64 MiB more RSS.
+//           Archive loads are read and decompressed by 7-Zip in one step.
+//
+class SK_TextureIOStage {
+public:
+  SK_TextureIOStage (void) : reads_ (ReadComplete, MAX_BYTES_IN_FLIGHT) { }
+
+  //
+  // Returns false if the job should be posted to the pool directly
+  //
+  bool submit (tbf_tex_load_s* job, SK_TextureThreadPool* pool)
+  {
+    if ((! reads_.running ()) || job->type != tbf_tex_load_s::Stream)
+      return false;
+
+    auto inject =
+      injectable_textures.find (job->checksum);
+
+    if ( inject                   == injectable_textures.end ()                  ||
+         inject->second.archive   != std::numeric_limits <unsigned int>::max ()  ||
+         job->wszFilename [0]     == L'\0'                                       ||
+         source_stager.contains (job->checksum)                                 ||
+         (! TBF_TextureFile::isRemote (job->wszFilename)) )
+      return false;
+
+    read_s* req = new read_s;
+
+    req->job   = job;
+    req->pool  = pool;
+    req->pDest = job->pDest;
+
+    // Don't let the game free this while the read is outstanding...
+    req->pDest->AddRef ();
+
+    if (! reads_.submit (job->wszFilename, req))
+    {
+      req->pDest->Release ();
+      delete req;
+
+      return false;
+    }
+
+    return true;
+  }
+
+  size_t queueLength (void) {
+    return reads_.inFlight ();
+  }
+
+protected:
+  static void ReadComplete (void* user, void* pData, size_t size);
+
+  static const size_t MAX_BYTES_IN_FLIGHT = 64ULL * 1024ULL * 1024ULL;
+
+  struct read_s {
+    tbf_tex_load_s*       job;
+    SK_TextureThreadPool* pool;
+    LPDIRECT3DTEXTURE9    pDest;
+  };
+
+private:
+  TBF_ReadAhead reads_;
+} *io_stage = nullptr;
+
+//
+// Also called for reads cancelled at shutdown (pData == nullptr); the job
+//   goes back to the pool like any other that was still queued and the
+//     worker falls back to reading the file itself.
+//
+void
+SK_TextureIOStage::ReadComplete (void* user, void* pData, size_t size)
+{
+  read_s* req = (read_s *)user;
+
+  if (pData != nullptr)
+  {
+    req->job->pSrcData    = pData;
+    req->job->SrcDataSize = (UINT)size;
+    req->job->prefetched  = true;
+  }
+
+  req->pool->postJob (req->job);
+  req->pDest->Release ();
+
+  delete req;
+}
+
 //
 // Split stream jobs into small and large in order to prevent
 //   starvation from wreaking havoc on load times.
@@ -1694,8 +1864,9 @@ struct SK_StreamSplitter
   {
     size_t len = 0;
 
-    if (lrg_tex) len += lrg_tex->queueLength ();
-    if (sm_tex)  len += sm_tex->queueLength  ();
+    if (lrg_tex)  len += lrg_tex->queueLength  ();
+    if (sm_tex)   len += sm_tex->queueLength   ();
+    if (io_stage) len += io_stage->queueLength ();
 
     return len;
   }
@@ -1719,10 +1890,16 @@ struct SK_StreamSplitter
   void postJob (tbf_tex_load_s* job)
   {
     // A "Large" load is one >= 128 KiB
-    if (job->SrcDataSize > (128 * 1024))
-      lrg_tex->postJob (job);
-    else
-      sm_tex->postJob (job);
+    SK_TextureThreadPool* pool =
+      (job->SrcDataSize > (128 * 1024)) ? lrg_tex :
+                                          sm_tex;
+
+    // Loose files are read asynchronously first, the pool gets the job
+    //   once its data is in memory.
+    if (io_stage != nullptr && io_stage->submit (job, pool))
+      return;
+
+    pool->postJob (job);
   }
 
   SK_TextureThreadPool* lrg_tex = nullptr;
@@ -1901,14 +2078,116 @@ namespace streaming_memory {
   }
 }
 
-HRESULT
-InjectTexture (tbf_tex_load_s* load)
+//
+// Decodes load->pSrcData into load->pSrc; kept free of C++ objects so that
+//   in-page errors from a mapped view can be caught with SEH.
+//
+static HRESULT
+TBF_CreateInjectedTexture (tbf_tex_load_s* load, bool mapped)
 {
   D3DXIMAGE_INFO img_info = {    };
-  bool           streamed =  false;
-  size_t         size     =      0;
   HRESULT        hr       = E_FAIL;
 
+  __try
+  {
+    D3DXGetImageInfoFromFileInMemory (
+      load->pSrcData,
+        load->SrcDataSize,
+          &img_info );
+
+    hr = D3DXCreateTextureFromFileInMemoryEx_Original (
+      load->pDevice,
+        load->pSrcData, load->SrcDataSize,
+          D3DX_DEFAULT, D3DX_DEFAULT, img_info.MipLevels,
+            0, D3DFMT_FROM_FILE,
+              D3DPOOL_DEFAULT,
+                D3DX_DEFAULT, D3DX_DEFAULT,
+                  0,
+                    &img_info, nullptr,
+                      &load->pSrc );
+  }
+
+  __except ( ( mapped && GetExceptionCode () == EXCEPTION_IN_PAGE_ERROR ) ?
+             EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH )
+  {
+    hr = E_FAIL;
+  }
+
+  return hr;
+}
+
+//
+// Texture packs that InjectTexture reads from stay mapped until shutdown (or
+//   until a new pack is built over them).
+//
+static CRITICAL_SECTION                                    cs_tex_packs = { };
+static std::unordered_map <std::wstring, TBF_TexturePack*> tex_packs;
+
+static bool
+TBF_IsTexturePackName (const std::wstring& name)
+{
+  const size_t ext_len = wcslen (TBF_PACK_EXT);
+
+  return name.length () > ext_len &&
+         _wcsicmp (name.c_str () + name.length () - ext_len, TBF_PACK_EXT) == 0;
+}
+
+static TBF_TexturePack*
+TBF_GetTexturePack (const tbf_tex_record_s* rec)
+{
+  if ( rec->archive >= archives.size () ||
+       (! TBF_IsTexturePackName (archives [rec->archive])) )
+    return nullptr;
+
+  TBF_AutoCritSection auto_crit (&cs_tex_packs);
+
+  const std::wstring& name =
+    archives [rec->archive];
+
+  auto pack =
+    tex_packs.find (name);
+
+  if (pack != tex_packs.end ())
+    return pack->second;
+
+  TBF_TexturePack* pPack =
+    new TBF_TexturePack ();
+
+  if (! pPack->open (name.c_str ()))
+  {
+    tex_log->Log ( L"[Inject Tex]  ** Cannot open texture pack: %s",
+                     name.c_str () );
+
+    delete pPack;
+           pPack = nullptr;
+  }
+
+  tex_packs [name] = pPack;
+
+  return pPack;
+}
+
+static void
+TBF_CloseTexturePacks (void)
+{
+  TBF_AutoCritSection auto_crit (&cs_tex_packs);
+
+  for ( auto& it : tex_packs )
+    delete it.second;
+
+  tex_packs.clear ();
+}
+
+HRESULT
+InjectTexture (tbf_tex_load_s* load)
+{
+
+  D3DXIMAGE_INFO   img_info = {    };
+  bool             streamed =  false;
+  size_t           size     =      0;
+  HRESULT          hr       = E_FAIL;
+  TBF_TexturePack* pack     = nullptr;
+
   auto inject =
     injectable_textures.find (load->checksum);
 
@@ -1918,6 +2197,14 @@ InjectTexture (tbf_tex_load_s* load)
                    L"has no Injection Record !!",
                      load->checksum );
 
+    if (load->prefetched)
+    {
+      free (load->pSrcData);
+
+      load->pSrcData   = nullptr;
+      load->prefetched = false;
+    }
+
     return E_NOT_VALID_STATE;
   }
 
@@ -1929,35 +2216,97 @@ InjectTexture (tbf_tex_load_s* load)
   streamed =
     (inj_tex->method == Streaming);
 
+  const void* pResident    = nullptr;
+  size_t      resident_len = 0;
+
+  bool resident =
+    (! load->prefetched) &&
+       resident_pool.pin (load->checksum, &pResident, &resident_len);
+
+  // Read ahead by the source stager, whatever kind of source it came from
+  if ((! load->prefetched) && (! resident))
+  {
+    void*  pStaged    = nullptr;
+    size_t staged_len = 0;
+
+    if (source_stager.take (load->checksum, &pStaged, &staged_len))
+    {
+      load->pSrcData    = pStaged;
+      load->SrcDataSize = (UINT)staged_len;
+      load->prefetched  = true;
+    }
+  }
+
   //
-  // Load:  From Regular Filesystem
+  // Load:  From the resident pool (pinned, it cannot be released underneath us)
   //
-  if ( inj_tex->archive == std::numeric_limits <unsigned int>::max () )
+  if (resident)
   {
-    HANDLE hTexFile =
-      CreateFile ( load->wszFilename,
-                     GENERIC_READ,
-                       FILE_SHARE_READ,
-                         nullptr,
-                           OPEN_EXISTING,
-                             FILE_ATTRIBUTE_NORMAL |
-                             FILE_FLAG_SEQUENTIAL_SCAN,
-                               nullptr );
+    size              = resident_len;
+    load->pSrcData    = (LPVOID)pResident;
+    load->SrcDataSize = (UINT)resident_len;
+
+    hr = TBF_CreateInjectedTexture (load, false);
+
+    load->pSrcData = nullptr;
+
+    resident_pool.unpin ();
+  }
 
-    DWORD read = 0UL;
+  //
+  // Load:  Already in memory
+  //
+  else if (load->prefetched)
+  {
+    size = load->SrcDataSize;
 
-    if (hTexFile != INVALID_HANDLE_VALUE)
+    if (streamed && size > (32 * 1024))
     {
-      size = GetFileSize (hTexFile, nullptr);
+      SetThreadPriority ( GetCurrentThread (),
+                            THREAD_PRIORITY_BELOW_NORMAL |
+                            THREAD_MODE_BACKGROUND_BEGIN );
+    }
 
-      if (streaming_memory::alloc (size))
-      {
-        load->pSrcData = streaming_memory::data [GetCurrentThreadId ()];
+    hr = TBF_CreateInjectedTexture (load, false);
+
+    free (load->pSrcData);
+
+    load->pSrcData   = nullptr;
+    load->prefetched = false;
+  }
+
+  else if ( inj_tex->archive == std::numeric_limits <unsigned int>::max () )
+  {
+    //
+    // Map the file and decode straight out of the page cache; this avoids
+    //   the copy into streaming_memory. Paging in from a network share can
+    //     fail at any time though, so those are read the old fashioned way.
+    //
+    TBF_TextureFile tex_file;
 
-        ReadFile (hTexFile, load->pSrcData, (DWORD)size, &read, nullptr);
+    if ( tex_file.open ( load->wszFilename,
+                           (! TBF_TextureFile::isRemote (load->wszFilename)) ) )
+    {
+      size = tex_file.size ();
+
+      bool have_src = false;
+
+      if (tex_file.view () != nullptr)
+      {
+        load->pSrcData    = (void *)tex_file.view ();
+        load->SrcDataSize = (UINT)size;
+        have_src          = true;
+      }
 
-        load->SrcDataSize = read;
+      else if (streaming_memory::alloc (size))
+      {
+        load->pSrcData    = streaming_memory::data [GetCurrentThreadId ()];
+        load->SrcDataSize = (UINT)tex_file.read (load->pSrcData, size);
+        have_src          = true;
+      }
 
+      if (have_src)
+      {
         if (streamed && size > (32 * 1024))
         {
           SetThreadPriority ( GetCurrentThread (),
@@ -1965,21 +2314,7 @@ InjectTexture (tbf_tex_load_s* load)
                                 THREAD_MODE_BACKGROUND_BEGIN );
         }
 
-        D3DXGetImageInfoFromFileInMemory (
-          load->pSrcData,
-            load->SrcDataSize,
-              &img_info );
-
-        hr = D3DXCreateTextureFromFileInMemoryEx_Original (
-          load->pDevice,
-            load->pSrcData, load->SrcDataSize,
-              D3DX_DEFAULT, D3DX_DEFAULT, img_info.MipLevels,
-                0, D3DFMT_FROM_FILE,
-                  D3DPOOL_DEFAULT,
-                    D3DX_DEFAULT, D3DX_DEFAULT,
-                      0,
-                        &img_info, nullptr,
-                          &load->pSrc );
+        hr = TBF_CreateInjectedTexture (load, tex_file.view () != nullptr);
 
         load->pSrcData = nullptr;
       }
@@ -1987,8 +2322,58 @@ InjectTexture (tbf_tex_load_s* load)
       else {
         // OUT OF MEMORY ?!
       }
+    }
+  }
+
+  //
+  // Load:  From TBF Texture Pack (memory mapped)
+  //
+  else if ( inj_tex->archive < archives.size () &&
+            TBF_IsTexturePackName (archives [inj_tex->archive]) )
+  {
+    // A pack that will not open is not a 7-Zip archive either
+    pack =
+      TBF_GetTexturePack (inj_tex);
+
+    const tbf_pack_entry_s* entry =
+      pack != nullptr ? pack->getEntry (inj_tex->fileno) : nullptr;
+
+    if (entry != nullptr && entry->checksum == load->checksum)
+    {
+      size = entry->size;
+
+      if (streamed && size > (32 * 1024))
+      {
+        SetThreadPriority ( GetCurrentThread (),
+                              THREAD_PRIORITY_BELOW_NORMAL |
+                              THREAD_MODE_BACKGROUND_BEGIN );
+      }
+
+      // Stored payloads are decoded straight out of the mapped view
+      if (entry->compression == TBF_PACK_STORED)
+      {
+        load->pSrcData    = (LPVOID)pack->getPayload (entry);
+        load->SrcDataSize = entry->size;
+
+        hr = TBF_CreateInjectedTexture (load, true);
+      }
 
-      CloseHandle (hTexFile);
+      else if (streaming_memory::alloc (size))
+      {
+        load->pSrcData    = streaming_memory::data [GetCurrentThreadId ()];
+        load->SrcDataSize = entry->size;
+
+        if (pack->extract (entry, load->pSrcData, streaming_memory::data_len [GetCurrentThreadId ()]))
+          hr = TBF_CreateInjectedTexture (load, false);
+      }
+
+      load->pSrcData = nullptr;
+    }
+
+    else
+    {
+      tex_log->Log ( L"[Inject Tex]  ** No texture pack entry for checksum %x: %s",
+                       load->checksum, archives [inj_tex->archive].c_str () );
     }
   }
 
@@ -2128,2324 +2513,4340 @@ InjectTexture (tbf_tex_load_s* load)
   return hr;
 }
 
-CRITICAL_SECTION osd_cs           = { };
-DWORD           last_queue_update =   0;
+struct tbf_source_cache_s {
+  std::wstring                  source;             // Open archive, empty if none
+  bool                          valid     = false;
 
-void
-TBFix_UpdateQueueOSD (void)
-{
-  if (config.textures.show_loading_text)
+  CFileInStream                 arc_stream;
+  std::unique_ptr <CLookToRead> look_stream;
+  CSzArEx                       arc;
+  ISzAlloc                      alloc;
+  ISzAlloc                      tmp_alloc;
+
+  // Kept across SzArEx_Extract calls, this is the decoded solid block cache
+  uint32_t                      block_idx = 0xFFFFFFFF;
+  Byte*                         out       = nullptr;
+  size_t                        out_len   = 0;
+
+  tbf_source_cache_s (void) : look_stream (new CLookToRead ())
   {
-    DWORD dwTime = timeGetTime ();
+    alloc.Alloc     = SzAlloc;
+    alloc.Free      = SzFree;
 
-    if (TryEnterCriticalSection (&osd_cs))
-    {
-      extern std::string mod_text;
+    tmp_alloc.Alloc = SzAllocTemp;
+    tmp_alloc.Free  = SzFreeTemp;
 
-      LONG resample_count = InterlockedExchangeAdd (&resampling, 0); size_t queue_len = resample_pool->queueLength ();
-      LONG stream_count   = InterlockedExchangeAdd (&streaming,  0); size_t to_stream = textures_to_stream.size    ();
+    FileInStream_CreateVTable (&arc_stream);
+    LookToRead_CreateVTable   (look_stream.get (), False);
 
-      bool is_resampling = (resample_pool->working () || resample_count || queue_len);
-      bool is_streaming  = (stream_pool.working    () || stream_count   || to_stream);
+    look_stream->realStream = &arc_stream.s;
+  }
 
-      static std::string resampling_text; static DWORD dwLastResample = 0;
-      static std::string streaming_text;  static DWORD dwLastStream   = 0;
-      
-      if (is_resampling)
-      {
-        size_t count = queue_len + resample_count;
+  ~tbf_source_cache_s (void) { close (); }
 
-            char szFormatted [64];
-        sprintf (szFormatted, "  Resampling: %zi texture", count);
+  bool open (const std::wstring& name)
+  {
+    if (source == name)
+      return valid;
 
-        resampling_text  = szFormatted;
-        resampling_text += (count != 1) ? 's' : ' ';
+    close ();
 
-        if (queue_len)
-        {
-          sprintf (szFormatted, " (%zu queued)", queue_len);
-          resampling_text += szFormatted;
-        }
+    if (InFile_OpenW (&arc_stream.file, name.c_str ()))
+      return false;
 
-        resampling_text += "\n";
+    source = name;
 
-        if (count)
-          dwLastResample = dwTime;
-      }
-      
-      if (is_streaming)
-      {
-        size_t count = stream_count + to_stream;
+    LookToRead_Init (look_stream.get ());
+    SzArEx_Init     (&arc);
 
-            char szFormatted [64];
-        sprintf (szFormatted, "  Streaming:  %zi texture", count);
+    valid =
+      SzArEx_Open (&arc, &look_stream->s, &alloc, &tmp_alloc) == SZ_OK;
 
-        streaming_text  = szFormatted;
-        streaming_text += (count != 1) ? 's' : ' ';
+    return valid;
+  }
 
-        sprintf (szFormatted, " [%7.2f MiB]", (double)InterlockedExchangeAdd (&streaming_bytes, 0) / (1024.0f * 1024.0f));
-        streaming_text += szFormatted;
+  void close (void)
+  {
+    if (source.empty ())
+      return;
 
-        if (to_stream)
-        {
-          sprintf (szFormatted, " (%zu queued)", to_stream);
-          streaming_text += szFormatted;
-        }
+    IAlloc_Free (&alloc, out);
 
-        if (count)
-          dwLastStream = dwTime;
-      }
+    out       = nullptr;
+    out_len   = 0;
+    block_idx = 0xFFFFFFFF;
 
-      if (dwLastResample < dwTime - 150)
-        resampling_text = "";
+    if (valid)
+      SzArEx_Free (&arc, &alloc);
 
-      if (dwLastStream < dwTime - 150)
-        streaming_text = "";
-
-      mod_text = resampling_text + streaming_text;
+    File_Close (&arc_stream.file);
 
-      if (mod_text != "")
-        last_queue_update = dwTime;
-      
-      LeaveCriticalSection (&osd_cs);
-    }
+    source.clear ();
+    valid = false;
   }
+};
+
+tbf_source_cache_s*
+TBF_CreateSourceCache (void)
+{
+  return new tbf_source_cache_s ();
 }
 
 void
-TBFix_LoadQueuedTextures (void)
+TBF_DestroySourceCache (tbf_source_cache_s* cache)
 {
-  TBFix_UpdateQueueOSD ();
-
-  int loads = 0;
+  delete cache;
+}
 
-  std::vector <tbf_tex_load_s *> finished_resamples;
-  std::vector <tbf_tex_load_s *> finished_streams = stream_pool.getFinished ();
+void
+TBF_FlushSourceCache (tbf_source_cache_s* cache)
+{
+  cache->close ();
+}
 
-  if (resample_pool != nullptr)
-    finished_resamples = resample_pool->getFinished ();
+//
+// Reads a texture's encoded bytes (no D3D work) for the source stager; this
+//   runs on its own thread and only uses what was copied into the request.
+//
+bool
+TBF_ReadInjectableSource ( tbf_source_cache_s*        cache,
+                           const tbf_stage_request_s& req,
+                           void**                     ppData,
+                           size_t*                    pSize )
+{
+  *ppData = nullptr;
+  *pSize  = 0;
 
-  for (auto&& it : finished_resamples )
+  //
+  // Read:  From Regular Filesystem
+  //
+  if (req.record.archive == std::numeric_limits <unsigned int>::max ())
   {
-    tbf_tex_load_s* load =
-      it;
+    HANDLE hTexFile =
+      CreateFile ( req.source.c_str (),
+                     GENERIC_READ,
+                       FILE_SHARE_READ,
+                         nullptr,
+                           OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL |
+                             FILE_FLAG_SEQUENTIAL_SCAN,
+                               nullptr );
 
-    QueryPerformanceCounter (&load->end);
+    if (hTexFile == INVALID_HANDLE_VALUE)
+      return false;
 
-    if (log_level > 0)
+    DWORD dwSize = GetFileSize (hTexFile, nullptr);
+    DWORD dwRead = 0UL;
+    void* pData  = (dwSize != INVALID_FILE_SIZE && dwSize > 0) ?
+                     malloc (dwSize) : nullptr;
+
+    if ( pData != nullptr &&
+         ReadFile (hTexFile, pData, dwSize, &dwRead, nullptr) &&
+         dwRead == dwSize )
     {
-      tex_log->Log ( L"[%s] Finished %s texture %08x (%5.2f MiB in %9.4f ms)",
-                       (load->type == tbf_tex_load_s::Stream) ? L"Inject Tex" :
-                         (load->type == tbf_tex_load_s::Immediate) ? L"Inject Tex" :
-                                                                     L" Resample ",
-                       (load->type == tbf_tex_load_s::Stream) ? L"streaming" :
-                         (load->type == tbf_tex_load_s::Immediate) ? L"loading" :
-                                                                     L"filtering",
-                         load->checksum,
-                           (double)load->SrcDataSize / (1024.0f * 1024.0f),
-                             1000.0f * (double)(load->end.QuadPart - load->start.QuadPart) /
-                                       (double)load->freq.QuadPart );
+      *ppData = pData;
+      *pSize  = dwSize;
     }
 
-    tbf::RenderFix::Texture* pTex =
-      tbf::RenderFix::tex_mgr.getTexture (load->checksum);
+    else
+      free (pData);
 
-    if (pTex != nullptr)
-    {
-      //pTex->load_time = (float)(1000.0 * (double)(load->end.QuadPart - load->start.QuadPart) /
-                                          //(double)load->freq.QuadPart);
-    }
+    CloseHandle (hTexFile);
+  }
 
-    ISKTextureD3D9* pSKTex =
-      (ISKTextureD3D9 *)load->pDest;
+  //
+  // Read:  From TBF Texture Pack (a private mapping, the shared ones may be
+  //          closed by the render thread at any time)
+  //
+  else if (TBF_IsTexturePackName (req.source))
+  {
+    TBF_TexturePack pack;
 
-    if (pSKTex != nullptr)
-    {
-      if (pSKTex->refs == 0 && load->pSrc != nullptr)
-      {
-        tex_log->Log (L"[ Tex. Mgr ] >> Original texture no longer referenced, discarding new one!");
-        load->pSrc->Release ();
-      }
+    if (! pack.open (req.source.c_str ()))
+      return false;
 
-      else
-      {
-        QueryPerformanceCounter (&pSKTex->last_used);
+    const tbf_pack_entry_s* entry =
+      pack.getEntry (req.record.fileno);
 
-        pSKTex->pTexOverride  = load->pSrc;
-        pSKTex->override_size = load->SrcDataSize;
+    if (entry == nullptr || entry->checksum != req.checksum)
+      return false;
 
-        // The original size info is completely wrong once we start generating mipmaps ;)
-        //
-        if (load->type == tbf_tex_load_s::Resample)
-        {
-          pSKTex->override_size = 0;
+    void* pData =
+      malloc (entry->size);
 
-          for (UINT i = 0; i < pSKTex->pTexOverride->GetLevelCount (); i++)
-          {
-            D3DSURFACE_DESC                         desc = { };
-            pSKTex->pTexOverride->GetLevelDesc (i, &desc);
+    if (pData == nullptr)
+      return false;
 
-            int bytes_per_pel = SK_D3D9_BytesPerPixel (desc.Format);
+    bool ok = true;
 
-            // If bytes_per_pel is < 0, we have to handle DXT alignment craziness to be accurate...
+    if (entry->compression == TBF_PACK_STORED)
+      memcpy (pData, pack.getPayload (entry), entry->size);
+    else
+      ok = pack.extract (entry, pData, entry->size);
 
-            if (bytes_per_pel >= 0)
-              pSKTex->override_size += desc.Width * desc.Height * bytes_per_pel;
+    if (ok)
+    {
+      *ppData = pData;
+      *pSize  = entry->size;
+    }
 
-            else
-            {
-              // Assume once this stuff gets into VRAM that it is tightly-packed,
-              //   it would be stupid for the driver to do otherwise.
-              UINT stride = bytes_per_pel == -1 ?
-               std::max (1UL, ((desc.Width + 3UL) / 4UL) ) * 8UL :
-               std::max (1UL, ((desc.Width + 3UL) / 4UL) ) * 16UL;
+    else
+      free (pData);
+  }
 
-               size_t lod_size = stride * (desc.Height / 4 +
-                                           desc.Height % 4);
+  //
+  // Read:  From (Compressed) Archive (.7z or .zip), the stager tends to ask
+  //          for several textures from one archive in a row
+  //
+  else if (cache->open (req.source))
+  {
+    size_t offset      = 0;
+    size_t decomp_size = 0;
 
-               pSKTex->override_size += lod_size;
-            }
-          }
+    // Same limit on concurrent decompression as the streaming workers
+    WaitForSingleObject (decomp_semaphore, INFINITE);
 
-          load->SrcDataSize = (UINT)pSKTex->override_size;
-        }
+    if ( SzArEx_Extract ( &cache->arc,       &cache->look_stream->s, req.record.fileno,
+                          &cache->block_idx, &cache->out,            &cache->out_len,
+                          &offset,           &decomp_size,
+                          &cache->alloc,     &cache->tmp_alloc ) == SZ_OK &&
+         decomp_size > 0 )
+    {
+      void* pData =
+        malloc (decomp_size);
 
-        tbf::RenderFix::tex_mgr.addInjected (load->SrcDataSize);
+      if (pData != nullptr)
+      {
+        memcpy (pData, cache->out + offset, decomp_size);
+
+        *ppData = pData;
+        *pSize  = decomp_size;
       }
+    }
 
-      finished_streaming (load->checksum);
+    ReleaseSemaphore (decomp_semaphore, 1, nullptr);
+  }
 
-      ++loads;
+  return *ppData != nullptr;
+}
 
-      // Remove the temporary reference
-      load->pDest->Release ();
-    }
+//
+// Copies what TBF_ReadInjectableSource needs out of the injectable index
+//
+static bool
+TBF_DescribeInjectableSource (uint32_t checksum, tbf_stage_request_s& req)
+{
+  auto inject =
+    injectable_textures.find (checksum);
 
-    ++it;
+  if (inject == injectable_textures.end ())
+    return false;
 
-    delete load;
-  }
+  req.checksum = checksum;
+  req.record   = inject->second;
 
-  for (auto&& it : finished_streams )
+  if (req.record.archive == std::numeric_limits <unsigned int>::max ())
   {
-    tbf_tex_load_s* load =
-      it;
+    wchar_t wszFileName [MAX_PATH] = { };
 
-    QueryPerformanceCounter (&load->end);
+    _swprintf ( wszFileName, L"%s\\inject\\textures\\%s\\%08x%s",
+                  TBFIX_TEXTURE_DIR,
+                    req.record.method == Blocking ? L"blocking" : L"streaming",
+                      checksum,
+                        TBFIX_TEXTURE_EXT );
 
-    if (log_level > 0)
-    {
-      tex_log->Log ( L"[%s] Finished %s texture %08x (%5.2f MiB in %9.4f ms)",
-                       (load->type == tbf_tex_load_s::Stream) ? L"Inject Tex" :
-                         (load->type == tbf_tex_load_s::Immediate) ? L"Inject Tex" :
-                                                                     L" Resample ",
-                       (load->type == tbf_tex_load_s::Stream) ? L"streaming" :
-                         (load->type == tbf_tex_load_s::Immediate) ? L"loading" :
-                                                                     L"filtering",
-                         load->checksum,
-                           (double)load->SrcDataSize / (1024.0f * 1024.0f),
-                             1000.0f * (double)(load->end.QuadPart - load->start.QuadPart) /
-                                       (double)load->freq.QuadPart );
-    }
+    req.source = wszFileName;
+  }
 
-    tbf::RenderFix::Texture* pTex =
-      tbf::RenderFix::tex_mgr.getTexture (load->checksum);
+  else if (req.record.archive < archives.size ())
+    req.source = archives [req.record.archive];
 
-    if (pTex != nullptr)
-    {
-      //pTex->load_time = (float)(1000.0 * (double)(load->end.QuadPart - load->start.QuadPart) /
-                                          //(double)load->freq.QuadPart);
-    }
+  else
+    return false;
 
-    ISKTextureD3D9* pSKTex =
-      (ISKTextureD3D9 *)load->pDest;
+  return true;
+}
 
-    if (pSKTex != nullptr)
-    {
-      if (pSKTex->refs == 0 && load->pSrc != nullptr)
-      {
-        tex_log->Log (L"[ Tex. Mgr ] >> Original texture no longer referenced, discarding new one!");
-        load->pSrc->Release ();
-      }
+static bool
+TBF_MakeStageRequest (uint32_t checksum, tbf_stage_request_s& req)
+{
+  if (! TBF_DescribeInjectableSource (checksum, req))
+    return false;
 
-      else
-      {
-        QueryPerformanceCounter (&pSKTex->last_used);
+  // Never worth staging, these are already in (or on their way to) the resident pool
+  if (config.textures.resident_blocking && req.record.method == Blocking)
+    return false;
 
-        pSKTex->pTexOverride  = load->pSrc;
-        pSKTex->override_size = load->SrcDataSize;
+  return true;
+}
 
-        tbf::RenderFix::tex_mgr.addInjected (load->SrcDataSize);
-      }
 
-      finished_streaming (load->checksum);
+//
+// Resident pool: the encoded bytes of every blocking texture, read once at
+//   startup so that a blocking injection never waits on the disk or LZMA.
+//
+static HANDLE                            hResidentThread = nullptr;
+static volatile LONG                     resident_cancel = 0L;
+static std::vector <tbf_stage_request_s> resident_work;
+static std::unordered_set <uint32_t>     resident_topup; // Render thread only
+
+static struct {
+  volatile LONG loaded  = 0L;
+  volatile LONG total   = 0L;
+  volatile LONG loading = 0L;
+  double        time_ms = 0.0;
+} resident_stats;
+
+static unsigned int
+__stdcall
+TBF_ResidentPoolThread (LPVOID user)
+{
+  UNREFERENCED_PARAMETER (user);
 
-      ++loads;
+  SetThreadPriority (GetCurrentThread (), THREAD_PRIORITY_BELOW_NORMAL);
 
-      // Remove the temporary reference
-      load->pDest->Release ();
-    }
+  LARGE_INTEGER start, end, freq;
 
-    ++it;
+  QueryPerformanceFrequency (&freq);
+  QueryPerformanceCounter   (&start);
 
-    delete load;
-  }
+  TBF_TexturePack pack;
+  std::wstring    pack_name;
 
   //
-  // If the size changes, check to see if we need a purge - if so, schedule one.
+  // Work is sorted by source and file number, so one archive stays open and
+  //   each solid block is only decompressed once.
   //
-  static uint64_t last_size = 0ULL;
+  CFileInStream arc_stream;
+  std::unique_ptr <CLookToRead>
+                look_stream (new CLookToRead ());
+  ISzAlloc      thread_alloc;
+  ISzAlloc      thread_tmp_alloc;
+  CSzArEx       arc;
+  std::wstring  arc_name;
+  bool          arc_open  = false;
+  uint32_t      block_idx = 0xFFFFFFFF;
+  Byte*         out       = nullptr;
+  size_t        out_len   = 0;
 
-  if (last_size != tbf::RenderFix::tex_mgr.cacheSizeTotal () )
-  {
-    last_size = tbf::RenderFix::tex_mgr.cacheSizeTotal ();
+  FileInStream_CreateVTable (&arc_stream);
+  LookToRead_CreateVTable   (look_stream.get (), False);
 
-    if ( last_size >
-           (1024ULL * 1024ULL) * (uint64_t)config.textures.max_cache_in_mib )
-      __need_purge = true;
-  }
+  look_stream->realStream = &arc_stream.s;
 
-  if ( (! InterlockedExchangeAdd (&streaming,  0)) &&
-       (! InterlockedExchangeAdd (&resampling, 0)) &&
-       (! pending_loads ()) )
+  thread_alloc.Alloc     = SzAlloc;
+  thread_alloc.Free      = SzFree;
+
+  thread_tmp_alloc.Alloc = SzAllocTemp;
+  thread_tmp_alloc.Free  = SzFreeTemp;
+
+  auto CloseArchive = [&](void) -> void
   {
-    if (__need_purge)
-    {
-      tbf::RenderFix::tex_mgr.purge ();
-      __need_purge = false;
-    }
-  }
+    if (! arc_open)
+      return;
 
-  tbf::RenderFix::tex_mgr.updateOSD ();
-}
+    IAlloc_Free (&thread_alloc, out);
 
-#include <set>
+    out       = nullptr;
+    out_len   = 0;
+    block_idx = 0xFFFFFFFF;
 
-std::unordered_set <uint32_t> resample_blacklist;
-bool                          resample_blacklist_init = false;
+    File_Close  (&arc_stream.file);
+    SzArEx_Free (&arc, &thread_alloc);
 
-void
-TBFix_ReloadPadButtons (void)
-{
-  if (tbf::RenderFix::pad_buttons.tex_xboxone != nullptr)
-  {
-    uint32_t checksum = tbf::RenderFix::pad_buttons.crc32_xboxone;
+    arc_open = false;
+  };
 
-    tbf::RenderFix::Texture* pTex = 
-      tbf::RenderFix::tex_mgr.getTexture (tbf::RenderFix::pad_buttons.crc32_xboxone);
+  for ( auto& req : resident_work )
+  {
+    if (InterlockedExchangeAdd (&resident_cancel, 0))
+      break;
 
-    IDirect3DTexture9* pD3DTex =
-      pTex->d3d9_tex;
+    void*  pDest = nullptr;
+    size_t size  = 0;
 
-    void* dontcare;
-    if ( pD3DTex != nullptr &&
-         pD3DTex->QueryInterface (IID_SKTextureD3D9, &dontcare) == S_OK )
+    if (req.record.archive == std::numeric_limits <unsigned int>::max ())
     {
-      ISKTextureD3D9* pSKTex =
-        (ISKTextureD3D9 *)pD3DTex;
+      HANDLE hTexFile =
+        CreateFile ( req.source.c_str (),
+                       GENERIC_READ,
+                         FILE_SHARE_READ,
+                           nullptr,
+                             OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL |
+                               FILE_FLAG_SEQUENTIAL_SCAN,
+                                 nullptr );
+
+      if (hTexFile != INVALID_HANDLE_VALUE)
+      {
+        DWORD dwSize = GetFileSize (hTexFile, nullptr);
+        DWORD dwRead = 0UL;
 
-      IDirect3DDevice9* pDevice = nullptr;
+        if (dwSize != INVALID_FILE_SIZE && dwSize > 0)
+          pDest = resident_pool.alloc (dwSize);
 
-      wchar_t wszFile [MAX_PATH + 2] = { L'\0' };
+        if ( pDest != nullptr &&
+             ReadFile (hTexFile, pDest, dwSize, &dwRead, nullptr) &&
+             dwRead == dwSize )
+          size = dwSize;
 
-      _swprintf ( wszFile,
-                    L"TBFix_Res\\Gamepads\\%s\\Buttons.dds",
-                      config.input.gamepad.texture_set.c_str () );
+        CloseHandle (hTexFile);
+      }
+    }
 
-      if (GetFileAttributesW (wszFile) != INVALID_FILE_ATTRIBUTES)
+    else if (TBF_IsTexturePackName (req.source))
+    {
+      if (pack_name != req.source)
       {
-        tex_log->LogEx (true, L"[Inject Tex] Injecting custom gamepad buttons... ");
-
-        pD3DTex->GetDevice (&pDevice);
+        pack_name = req.source;
 
-        tbf_tex_load_s* load_op = new tbf_tex_load_s;
+        if (! pack.open (pack_name.c_str ()))
+          pack.close ();
+      }
 
-        load_op->SrcDataSize =
-          injectable_textures.count (checksum) == 0 ?
-            0 : (UINT)injectable_textures [checksum].size;
+      const tbf_pack_entry_s* entry =
+        pack.getEntry (req.record.fileno);
 
-        load_op->pDevice  = pDevice;
-        load_op->checksum = checksum;
-        load_op->type     = tbf_tex_load_s::Immediate;
-        wcsncpy (load_op->wszFilename, wszFile, MAX_PATH);
+      if (entry != nullptr && entry->checksum == req.checksum)
+        pDest = resident_pool.alloc (entry->size);
 
-        tex_log->LogEx ( false, L"blocking (deferred)\n" );
+      if (pDest != nullptr)
+      {
+        if (entry->compression == TBF_PACK_STORED)
+        {
+          memcpy (pDest, pack.getPayload (entry), entry->size);
+          size = entry->size;
+        }
 
-        wcsncpy ( load_op->wszFilename,
-                    wszFile,
-                      MAX_PATH );
+        else if (pack.extract (entry, pDest, entry->size))
+          size = entry->size;
+      }
+    }
 
-        load_op->pDest     = pD3DTex;
+    else
+    {
+      // A source that failed to open is not retried for each of its files
+      if (arc_name != req.source)
+      {
+        CloseArchive ();
 
-        EnterCriticalSection        (&cs_tex_stream);
+        arc_name = req.source;
 
-        ((ISKTextureD3D9 *)pD3DTex)->must_block = true;
+        LookToRead_Init (look_stream.get ());
 
-        if (is_streaming (load_op->checksum))
+        if (! InFile_OpenW (&arc_stream.file, arc_name.c_str ()))
         {
-          ISKTextureD3D9* pTexOrig =
-            (ISKTextureD3D9 *)textures_in_flight [load_op->checksum]->pDest;
+          SzArEx_Init (&arc);
 
-          // Remap the output of the in-flight texture
-          textures_in_flight [load_op->checksum]->pDest =
-            pD3DTex;
+          if (SzArEx_Open (&arc, &look_stream->s, &thread_alloc, &thread_tmp_alloc) == SZ_OK)
+            arc_open = true;
 
-          if (tbf::RenderFix::tex_mgr.getTexture (load_op->checksum)  != nullptr)
+          else
           {
-            for ( int i = 0;
-                      i < tbf::RenderFix::tex_mgr.getTexture (load_op->checksum)->refs;
-                    ++i ) {
-              pD3DTex->AddRef ();
-            }
+            SzArEx_Free (&arc, &thread_alloc);
+            File_Close  (&arc_stream.file);
           }
-
-          ////tsf::RenderFix::tex_mgr.removeTexture (pTexOrig);
         }
+      }
 
-        else
-        {
-          textures_in_flight.try_emplace ( load_op->checksum, load_op );
-
-          resample_pool->postJob (load_op);
-        }
+      size_t offset      = 0;
+      size_t decomp_size = 0;
 
-        LeaveCriticalSection (&cs_tex_stream);
+      if ( arc_open &&
+           SzArEx_Extract ( &arc,          &look_stream->s, req.record.fileno,
+                            &block_idx,    &out,           &out_len,
+                            &offset,       &decomp_size,
+                            &thread_alloc, &thread_tmp_alloc ) == SZ_OK &&
+           decomp_size > 0 &&
+           (pDest = resident_pool.alloc (decomp_size)) != nullptr )
+      {
+        memcpy (pDest, out + offset, decomp_size);
+        size = decomp_size;
       }
     }
+
+    if (size > 0)
+    {
+      resident_pool.commit (req.checksum, pDest, size);
+      InterlockedIncrement (&resident_stats.loaded);
+    }
   }
-}
 
-COM_DECLSPEC_NOTHROW
-HRESULT
-STDMETHODCALLTYPE
-D3DXCreateTextureFromFileInMemoryEx_Detour (
-  _In_    LPDIRECT3DDEVICE9  pDevice,
-  _In_    LPCVOID            pSrcData,
-  _In_    UINT               SrcDataSize,
-  _In_    UINT               Width,
-  _In_    UINT               Height,
-  _In_    UINT               MipLevels,
-  _In_    DWORD              Usage,
-  _In_    D3DFORMAT          Format,
-  _In_    D3DPOOL            Pool,
-  _In_    DWORD              Filter,
-  _In_    DWORD              MipFilter,
-  _In_    D3DCOLOR           ColorKey,
-  _Inout_ D3DXIMAGE_INFO     *pSrcInfo,
-  _Out_   PALETTEENTRY       *pPalette,
-  _Out_   LPDIRECT3DTEXTURE9 *ppTexture
-)
-{
-  bool inject_thread = false;
+  CloseArchive ();
 
-#ifndef NO_TLS
-  TBF_TLS* pTLS = TBF_GetTLS ();
+  QueryPerformanceCounter (&end);
 
-  inject_thread = pTLS->d3d9.texinject_thread;
-#else
-  EnterCriticalSection (&cs_tex_inject);
+  resident_stats.time_ms =
+    1000.0 * (double)(end.QuadPart - start.QuadPart) / (double)freq.QuadPart;
 
-  if (inject_tids.count (GetCurrentThreadId ()))
-  {
-    inject_thread = true;
-  }
+  InterlockedExchange (&resident_stats.loading, 0);
 
-  LeaveCriticalSection (&cs_tex_inject);
-#endif
+  tex_log->Log ( L"[Inject Tex] Resident pool: %li of %li blocking textures, %.2f MiB in %.2f ms",
+                   resident_stats.loaded, resident_stats.total,
+                     (double)resident_pool.bytesUsed () / (1024.0 * 1024.0),
+                       resident_stats.time_ms );
 
-  // Injection would recurse slightly and cause impossible to diagnose reference counting problems
-  //   with texture caching if we did not check for this!
-  if (inject_thread) {
-    return D3DXCreateTextureFromFileInMemoryEx_Original (
-      pDevice,
-        pSrcData, SrcDataSize,
-          Width, Height, MipLevels,
-            Usage,
-              Format,
-                Pool,
-                  Filter, MipFilter, ColorKey,
-                    pSrcInfo, pPalette,
-                      ppTexture );
-  }
+  return 0;
+}
 
-  if (resample_blacklist_init == false)
-  {
-    // Do Not Resample Logos
-    resample_blacklist.emplace (0xfa3d03df);
-    resample_blacklist.emplace (0x545908bb);
+static void
+TBF_StopResidentPool (void)
+{
+  if (hResidentThread == nullptr)
+    return;
 
-    resample_blacklist_init = true;
-  }
+  InterlockedExchange (&resident_cancel, 1);
 
-  // Performance statistics for caching system
-         LARGE_INTEGER start, end;
-  static LARGE_INTEGER freq = { 0LL };
+  WaitForSingleObject (hResidentThread, INFINITE);
+  CloseHandle         (hResidentThread);
 
-  if (freq.QuadPart == 0LL)
-    QueryPerformanceFrequency (&freq);
+  hResidentThread = nullptr;
 
-  uint32_t checksum =
-    crc32 (0, pSrcData, SrcDataSize);
+  InterlockedExchange (&resident_cancel, 0);
+}
 
-  // Don't dump or cache these
-  if (Usage == D3DUSAGE_DYNAMIC || Usage == D3DUSAGE_RENDERTARGET)
-    checksum = 0x00;
+//
+// Waits for loads that pinned the old pool, so best called while nothing loads
+//
+static void
+TBF_StartResidentPool (void)
+{
+  TBF_StopResidentPool ();
 
-  if (config.textures.cache && checksum != 0x00)
+  resident_pool.release ();
+  resident_work.clear   ();
+  resident_topup.clear  ();
+
+  size_t total = 0;
+
+  for ( auto& it : injectable_textures )
   {
-    tbf::RenderFix::Texture* pTex =
-      tbf::RenderFix::tex_mgr.getTexture (checksum);
+    if (it.second.method != Blocking)
+      continue;
 
-    if (pTex != nullptr)
-    {
-      tbf::RenderFix::tex_mgr.refTexture (pTex);
+    tbf_stage_request_s req;
 
-      *ppTexture = pTex->d3d9_tex;
+    if (TBF_DescribeInjectableSource (it.first, req))
+    {
+      resident_work.push_back (req);
 
-      return S_OK;
+      total += (req.record.size + 15) & ~(size_t)15;
     }
+  }
 
-    tbf::RenderFix::tex_mgr.missTexture ();
+  if (resident_work.empty ())
+    return;
+
+  std::sort ( resident_work.begin (), resident_work.end (),
+                [](const tbf_stage_request_s& a, const tbf_stage_request_s& b) {
+                  return a.source != b.source ? a.source        < b.source :
+                                                a.record.fileno < b.record.fileno;
+                } );
+
+  if (! resident_pool.reserve (total))
+  {
+    tex_log->Log ( L"[Inject Tex] Cannot reserve %.2f MiB for the resident pool",
+                     (double)total / (1024.0 * 1024.0) );
+    return;
   }
 
-  bool resample = false;
+  InterlockedExchange (&resident_stats.loaded,  0);
+  InterlockedExchange (&resident_stats.total,   (LONG)resident_work.size ());
+  InterlockedExchange (&resident_stats.loading, 1);
 
-  // Necessary to make D3DX texture write functions work
-  if ( Pool == D3DPOOL_DEFAULT && (config.textures.on_demand_dump ||
-       ( config.textures.dump                         &&
-        (! dumped_textures.count     (checksum))      &&
-        (! injectable_textures.count (checksum)) ) ) )
-    Usage = D3DUSAGE_DYNAMIC;
+  resident_stats.time_ms = 0.0;
 
+  hResidentThread =
+    (HANDLE)_beginthreadex ( nullptr,
+                               0,
+                                 TBF_ResidentPoolThread,
+                                   nullptr,
+                                     0x00,
+                                       nullptr );
 
-  D3DXIMAGE_INFO info = { 0 };
-  D3DXGetImageInfoFromFileInMemory (pSrcData, SrcDataSize, &info);
+  if (hResidentThread == nullptr)
+    InterlockedExchange (&resident_stats.loading, 0);
+}
 
+//
+// Blocking textures that hot reload added (or changed) after the pool was
+//   built go into a block of their own once the builder is idle.
+//
+static void
+TBF_TopUpResidentPool (void)
+{
+  if (resident_topup.empty ())
+    return;
 
-  bool power_of_two_in_one_way =  
-    (! (info.Width  & (info.Width  - 1)))  !=  (! (info.Height & (info.Height - 1)));
+  if ((! config.textures.resident_blocking) || resident_pool.bytesReserved () == 0)
+  {
+    resident_topup.clear ();
+    return;
+  }
 
+  // Still working from the index it was started with, try again next frame
+  if ( hResidentThread != nullptr &&
+       WaitForSingleObject (hResidentThread, 0) == WAIT_TIMEOUT )
+    return;
 
-  // Textures that would be incorrectly filtered if resampled
-  if (power_of_two_in_one_way)
-    non_power_of_two_textures.emplace (checksum);
+  TBF_StopResidentPool ();
 
+  resident_work.clear ();
 
-  // Generate complete mipmap chains for best image quality
-  //  (will increase load-time on uncached textures)
-  if ((Pool == D3DPOOL_DEFAULT) && config.textures.remaster)
+  size_t total = 0;
+
+  for ( auto checksum : resident_topup )
   {
-    if (true)
-    {
-      bool power_of_two_in =
-        (! (info.Width  & (info.Width  - 1)))  &&  (! (info.Height & (info.Height - 1)));
+    tbf_stage_request_s req;
 
-      bool power_of_two_out =
-        (! (Width  & (Width  - 1)))            &&  (! (Height & (Height - 1)));
+    if ( TBF_DescribeInjectableSource (checksum, req) &&
+         req.record.method == Blocking )
+    {
+      resident_work.push_back (req);
 
-      if (power_of_two_in && power_of_two_out)
-      {
-        if (info.MipLevels > 1/* || config.textures.uncompressed*/)
-        {
-          resample = true;
-        }
-      }
+      total += (req.record.size + 15) & ~(size_t)15;
     }
   }
 
-  HRESULT         hr           = E_FAIL;
-  tbf_tex_load_s* load_op      = nullptr;
+  resident_topup.clear ();
 
-  wchar_t wszInjectFileName [MAX_PATH] = { L'\0' };
+  if (resident_work.empty ())
+    return;
 
-  bool remap_stream = is_streaming (checksum);
+  std::sort ( resident_work.begin (), resident_work.end (),
+                [](const tbf_stage_request_s& a, const tbf_stage_request_s& b) {
+                  return a.source != b.source ? a.source        < b.source :
+                                                a.record.fileno < b.record.fileno;
+                } );
 
-  //
-  // Generic injectable textures
-  //
-  if ( (! inject_thread) &&
-            injectable_textures.find (checksum) !=
-                     injectable_textures.end () )
-  {
-    if (log_level > 0) {
-      tex_log->LogEx ( true, L"[Inject Tex] Injectable texture for checksum (%08x)... ",
-                         checksum );
-    }
+  if (! resident_pool.reserve (total))
+    return;
 
-    tbf_tex_record_s record = injectable_textures [checksum];
+  InterlockedAdd      (&resident_stats.total, (LONG)resident_work.size ());
+  InterlockedExchange (&resident_stats.loading, 1);
 
-    if (record.method == DontCare)
-      record.method = Streaming;
+  hResidentThread =
+    (HANDLE)_beginthreadex ( nullptr,
+                               0,
+                                 TBF_ResidentPoolThread,
+                                   nullptr,
+                                     0x00,
+                                       nullptr );
 
-    // If -1, load from disk...
-    if (record.archive == std::numeric_limits <unsigned int>::max ())
-    {
-      if (record.method == Streaming)
-        _swprintf ( wszInjectFileName, L"%s\\inject\\textures\\streaming\\%08x%s",
-                      TBFIX_TEXTURE_DIR,
-                        checksum,
-                          TBFIX_TEXTURE_EXT );
-      else if (record.method == Blocking)
-        _swprintf ( wszInjectFileName, L"%s\\inject\\textures\\blocking\\%08x%s",
-                      TBFIX_TEXTURE_DIR,
-                        checksum,
-                          TBFIX_TEXTURE_EXT );
-    }
+  if (hResidentThread == nullptr)
+    InterlockedExchange (&resident_stats.loading, 0);
+}
 
-    load_op           = new tbf_tex_load_s;
-    load_op->pDevice  = pDevice;
-    load_op->checksum = checksum;
+tbf_resident_pool_stats_s
+TBF_GetResidentPoolStats (void)
+{
+  tbf_resident_pool_stats_s stats;
 
-    if (record.method == Streaming)
-      load_op->type   = tbf_tex_load_s::Stream;
-    else
-      load_op->type   = tbf_tex_load_s::Immediate;
+  stats.textures = InterlockedExchangeAdd (&resident_stats.loaded,  0);
+  stats.total    = InterlockedExchangeAdd (&resident_stats.total,   0);
+  stats.loading  = InterlockedExchangeAdd (&resident_stats.loading, 0) != 0;
+  stats.bytes    = resident_pool.bytesUsed ();
+  stats.time_ms  = stats.loading ? 0.0 : resident_stats.time_ms;
 
-    wcscpy (load_op->wszFilename, wszInjectFileName);
+  return stats;
+}
 
-    if (log_level > 0)
-    {
-      if (load_op->type == tbf_tex_load_s::Stream)
-      {
-        if ((! remap_stream))
-          tex_log->LogEx ( false, L"streaming\n" );
-        else
-          tex_log->LogEx ( false, L"in-flight already\n" );
-      }
-      
-      else
-      {
-        tex_log->LogEx ( false, L"blocking (deferred)\n" );
-      }
-    }
-  }
+//
+// Builds (and creates the directories for) TBFix_Res\dump\textures\<fmt>\<crc32>.dds
+//
+static void
+TBF_GetDumpFileName (D3DFORMAT fmt, uint32_t checksum, wchar_t* wszFileName)
+{
+  wchar_t wszPath [MAX_PATH];
+  _swprintf ( wszPath, L"%s\\dump",
+                TBFIX_TEXTURE_DIR );
 
-  bool will_replace = config.textures.quick_load && resample;
+  if (GetFileAttributesW (wszPath) != FILE_ATTRIBUTE_DIRECTORY)
+    CreateDirectoryW (wszPath, nullptr);
 
-  QueryPerformanceCounter     (&start);
+  _swprintf ( wszPath, L"%s\\dump\\textures",
+                TBFIX_TEXTURE_DIR );
 
-  //tex_log->Log (L"D3DXCreateTextureFromFileInMemoryEx (... MipLevels=%lu ...)", MipLevels);
-  hr =
-    D3DXCreateTextureFromFileInMemoryEx_Original ( pDevice,
-                                                     pSrcData,         SrcDataSize,
-                                                       Width,          Height,    will_replace ? 1 : MipLevels,
-                                                         Usage,        Format,    Pool,
-                                                           Filter,     MipFilter, ColorKey,
-                                                             pSrcInfo, pPalette,
-                                                               ppTexture );
-
-  QueryPerformanceCounter     (&end);
-
-  if (SUCCEEDED (hr))
-  {
-    new ISKTextureD3D9 (ppTexture, SrcDataSize, checksum);
-
-    const uint32_t license_crc32 = 0x86c4b6d0UL;
+  if (GetFileAttributesW (wszPath) != FILE_ATTRIBUTE_DIRECTORY)
+    CreateDirectoryW (wszPath, nullptr);
 
-    if (checksum == license_crc32)
-    {
-      wchar_t wszFile [MAX_PATH + 2] = { L'\0' };
+  _swprintf ( wszPath, L"%s\\%s",
+                wszPath,
+                 SK_D3D9_FormatToStr (fmt, false).c_str () );
 
-      lstrcatW ( wszFile, L"TBFix_Res\\license.dds" );
+  if (GetFileAttributesW (wszPath) != FILE_ATTRIBUTE_DIRECTORY)
+    CreateDirectoryW (wszPath, nullptr);
 
-      if (GetFileAttributesW (wszFile) != INVALID_FILE_ATTRIBUTES)
-      {
-        tex_log->LogEx (true, L"[Inject Tex] Injecting custom license disclaimer... ");
+  _swprintf ( wszFileName, L"%s\\dump\\textures\\%s\\%08x%s",
+                TBFIX_TEXTURE_DIR,
+                  SK_D3D9_FormatToStr (fmt, false).c_str (),
+                    checksum,
+                      TBFIX_TEXTURE_EXT );
+}
 
-        load_op           = new tbf_tex_load_s;
-        load_op->pDevice  = pDevice;
-        load_op->checksum = checksum;
-        load_op->type     = tbf_tex_load_s::Immediate;
-        wcsncpy (load_op->wszFilename, wszFile, MAX_PATH);
+//
+// The data the game hands to D3DXCreateTextureFromFileInMemoryEx is already a
+//   complete .dds file, so dumping is nothing more than writing those bytes out.
+//
+//   Writes happen on a dedicated thread; the render thread only pays for one
+//     memcpy and never needs a lockable (D3DUSAGE_DYNAMIC) texture.
+//
+class SK_TextureDumpQueue {
+public:
+  void init (void)
+  {
+    InitializeCriticalSection (&cs_jobs_);
 
-        if (load_op->type == tbf_tex_load_s::Stream) {
-          if ((! remap_stream))
-            tex_log->LogEx ( false, L"streaming\n" );
-          else
-            tex_log->LogEx ( false, L"in-flight already\n" );
-        } else {
-          tex_log->LogEx ( false, L"blocking (deferred)\n" );
-        }
+    work_     = CreateEvent (nullptr, FALSE, FALSE, nullptr);
+    shutdown_ = CreateEvent (nullptr, TRUE,  FALSE, nullptr);
 
-        resample = false;
-      }
-    }
+    thread_ =
+      (HANDLE)_beginthreadex ( nullptr,
+                                 0,
+                                   ThreadProc,
+                                     this,
+                                       0x00,
+                                         nullptr );
 
-    if (checksum == tbf::RenderFix::pad_buttons.crc32_ps4) {
-      tbf::RenderFix::pad_buttons.tex_ps4 = *ppTexture;
-    }
+    if (thread_ != nullptr)
+      SetThreadPriority (thread_, THREAD_PRIORITY_BELOW_NORMAL);
+  }
 
-    if (checksum == tbf::RenderFix::pad_buttons.crc32_xboxone) {
-      tbf::RenderFix::pad_buttons.tex_xboxone = *ppTexture;
+  void shutdown (void)
+  {
+    if (thread_ == nullptr)
+      return;
 
-      wchar_t wszFile [MAX_PATH + 2] = { L'\0' };
+    // Let everything that is queued reach the disk first
+    SetEvent            (shutdown_);
+    WaitForSingleObject (thread_, INFINITE);
 
-      _swprintf ( wszFile,
-                    L"TBFix_Res\\Gamepads\\%s\\Buttons.dds",
-                      config.input.gamepad.texture_set.c_str () );
+    CloseHandle (thread_);
+    CloseHandle (work_);
+    CloseHandle (shutdown_);
 
-      if (GetFileAttributesW (wszFile) != INVALID_FILE_ATTRIBUTES)
-      {
-        WIN32_FILE_ATTRIBUTE_DATA
-          file_attrib_data = { 0 };
+    thread_ = nullptr;
 
-        GetFileAttributesEx ( wszFile,
-                                GetFileExInfoStandard,
-                                  &file_attrib_data );
+    DeleteCriticalSection (&cs_jobs_);
+  }
 
-        tbf_tex_record_s rec;
-        rec.size    =  ULARGE_INTEGER { file_attrib_data.nFileSizeLow,
-                                          file_attrib_data.nFileSizeHigh }.QuadPart;
-        rec.archive = std::numeric_limits <unsigned int>::max ();
-        rec.method  =  Blocking;
+  //
+  // Returns false if the data could not be queued (not a .dds file, or too
+  //   much is already waiting to be written); the caller may try again later.
+  //
+  bool push (D3DFORMAT fmt, uint32_t checksum, const void* pData, size_t len)
+  {
+    if ( thread_ == nullptr || len < 128 ||
+         *(const uint32_t *)pData != 0x20534444UL /* "DDS " */ )
+      return false;
 
-        if (! injectable_textures.count (checksum))
-          injectable_textures.try_emplace ( checksum, rec );
-        else {
-          injectable_textures [checksum] = rec;
-        }
+    if (InterlockedExchangeAdd64 (&bytes_pending_, 0) + (LONG64)len > MAX_BYTES_PENDING)
+      return false;
 
-        tex_log->LogEx (true, L"[Inject Tex] Injecting custom gamepad buttons... ");
+    job_s* job = new job_s;
 
-        load_op           = new tbf_tex_load_s;
-        load_op->pDevice  = pDevice;
-        load_op->checksum = checksum;
-        load_op->type     = tbf_tex_load_s::Immediate;
-        wcsncpy (load_op->wszFilename, wszFile, MAX_PATH);
+    job->fmt      = fmt;
+    job->checksum = checksum;
+    job->data.assign ((const uint8_t *)pData, (const uint8_t *)pData + len);
 
-        if (load_op->type == tbf_tex_load_s::Stream) {
-          if ((! remap_stream))
-            tex_log->LogEx ( false, L"streaming\n" );
-          else
-            tex_log->LogEx ( false, L"in-flight already\n" );
-        } else {
-          tex_log->LogEx ( false, L"blocking (deferred)\n" );
-        }
+    InterlockedAdd64     (&bytes_pending_, len);
+    InterlockedIncrement (&queued_);
 
-        resample = false;
-      }
+    EnterCriticalSection (&cs_jobs_);
+    {
+      jobs_.push (job);
     }
+    LeaveCriticalSection (&cs_jobs_);
 
+    SetEvent (work_);
 
-    if ( load_op != nullptr && ( load_op->type == tbf_tex_load_s::Stream ||
-                                 load_op->type == tbf_tex_load_s::Immediate ) ) {
-      load_op->SrcDataSize =
-        injectable_textures.count (checksum) == 0 ?
-          0 : (UINT)injectable_textures [checksum].size;
-
-      load_op->pDest = *ppTexture;
-      EnterCriticalSection        (&cs_tex_stream);
+    return true;
+  }
 
-      if (load_op->type == tbf_tex_load_s::Immediate)
-        ((ISKTextureD3D9 *)*ppTexture)->must_block = true;
+  size_t   queueLength  (void) { return InterlockedExchangeAdd   (&queued_,        0);  }
+  uint64_t bytesWritten (void) { return InterlockedExchangeAdd64 (&bytes_written_, 0); }
 
-      if (is_streaming (load_op->checksum)) {
-        ISKTextureD3D9* pTexOrig =
-          (ISKTextureD3D9 *)textures_in_flight [load_op->checksum]->pDest;
+protected:
+  static unsigned int __stdcall ThreadProc (LPVOID user);
 
-        // Remap the output of the in-flight texture
-        textures_in_flight [load_op->checksum]->pDest =
-          *ppTexture;
+  static const LONG64 MAX_BYTES_PENDING = 256LL * 1024LL * 1024LL;
 
-        if (tbf::RenderFix::tex_mgr.getTexture (load_op->checksum)  != nullptr) {
-          for ( int i = 0;
-                    i < tbf::RenderFix::tex_mgr.getTexture (load_op->checksum)->refs;
-                  ++i ) {
-            (*ppTexture)->AddRef ();
-          }
-        }
+  struct job_s {
+    D3DFORMAT             fmt;
+    uint32_t              checksum;
+    std::vector <uint8_t> data;
+  };
 
-        ////tsf::RenderFix::tex_mgr.removeTexture (pTexOrig);
-      }
+private:
+  std::queue <job_s *> jobs_;
+  CRITICAL_SECTION     cs_jobs_        = { };
 
-      else {
-        textures_in_flight.try_emplace ( load_op->checksum, load_op );
+  HANDLE               thread_         = nullptr;
+  HANDLE               work_           = nullptr;
+  HANDLE               shutdown_       = nullptr;
 
-        stream_pool.postJob (load_op);
-        //resample_pool->postJob (load_op);
-      }
+  volatile LONG        queued_         = 0L;
+  volatile LONG64      bytes_pending_  = 0LL;
+  volatile LONG64      bytes_written_  = 0LL;
+} dump_queue;
 
-      LeaveCriticalSection        (&cs_tex_stream);
-    }
+// Optional: when open, dumps are appended here instead of written as loose files
+TBF_DumpPack dump_pack;
 
-#if 0
-    //
-    // TODO:  Actually stream these, but block if the game tries to call SetTexture (...)
-    //          while the texture is in-flight.
-    //
-    else if (load_op != nullptr && load_op->type == tsf_tex_load_s::Immediate) {
-      QueryPerformanceFrequency        (&load_op->freq);
-      QueryPerformanceCounter (&load_op->start);
+unsigned int
+__stdcall
+SK_TextureDumpQueue::ThreadProc (LPVOID user)
+{
+  SK_TextureDumpQueue* pQueue =
+    (SK_TextureDumpQueue *)user;
 
-      EnterCriticalSection (&cs_tex_inject);
-      inject_tids.insert   (GetCurrentThreadId ());
-      LeaveCriticalSection (&cs_tex_inject);
+  HANDLE wait_objs [] = { pQueue->work_, pQueue->shutdown_ };
 
-      load_op->pDest = *ppTexture;
+  bool run = true;
 
-      hr = InjectTexture (load_op);
+  while (run)
+  {
+    if (WaitForMultipleObjects (2, wait_objs, FALSE, INFINITE) != WAIT_OBJECT_0)
+      run = false;
 
-      EnterCriticalSection (&cs_tex_inject);
-      inject_tids.erase    (GetCurrentThreadId ());
-      LeaveCriticalSection (&cs_tex_inject);
+    while (true)
+    {
+      job_s* job = nullptr;
 
-      QueryPerformanceCounter (&load_op->end);
+      EnterCriticalSection (&pQueue->cs_jobs_);
+      {
+        if (! pQueue->jobs_.empty ())
+        {
+          job = pQueue->jobs_.front ();
+                pQueue->jobs_.pop   ();
+        }
+      }
+      LeaveCriticalSection (&pQueue->cs_jobs_);
 
-      if (SUCCEEDED (hr)) {
-        tex_log->Log ( L"[Inject Tex] Finished synchronous texture %08x (%5.2f MiB in %9.4f ms)",
-                        load_op->checksum,
-                          (double)load_op->SrcDataSize / (1024.0f * 1024.0f),
-                            1000.0f * (double)(load_op->end.QuadPart - load_op->start.QuadPart) /
-                                      (double) load_op->freq.QuadPart );
-        ISKTextureD3D9* pSKTex =
-          (ISKTextureD3D9 *)*ppTexture;
+      if (job == nullptr)
+        break;
 
-        pSKTex->pTexOverride  = load_op->pSrc;
-        pSKTex->override_size = load_op->SrcDataSize;
+      if (dump_pack.isOpen ())
+      {
+        if (dump_pack.append (job->checksum, job->fmt, job->data.data (), (uint32_t)job->data.size ()))
+          InterlockedAdd64 (&pQueue->bytes_written_, job->data.size ());
+        else
+          tex_log->Log (L"[ Dump Tex ] Failed to append %08x to dump pack", job->checksum);
 
-        pSKTex->last_used     = load_op->end;
+        InterlockedAdd64     (&pQueue->bytes_pending_, -(LONG64)job->data.size ());
+        InterlockedDecrement (&pQueue->queued_);
 
-        tsf::RenderFix::tex_mgr.addInjected (load_op->SrcDataSize);
-      } else {
-        tex_log->Log ( L"[Inject Tex] *** FAILED synchronous texture %08x",
-                        load_op->checksum );
+        delete job;
+        continue;
       }
 
-      delete load_op;
-      load_op = nullptr;
-    }
-#endif
-
-    else if (resample) {
-      load_op              = new tbf_tex_load_s;
+      wchar_t wszFileName [MAX_PATH] = { L'\0' };
+      TBF_GetDumpFileName (job->fmt, job->checksum, wszFileName);
 
-      load_op->pDevice     = pDevice;
-      load_op->checksum    = checksum;
-      load_op->type        = tbf_tex_load_s::Resample;
+      HANDLE hDumpFile =
+        CreateFile ( wszFileName,
+                       GENERIC_WRITE,
+                         0x00,
+                           nullptr,
+                             CREATE_ALWAYS,
+                               FILE_ATTRIBUTE_NORMAL |
+                               FILE_FLAG_SEQUENTIAL_SCAN,
+                                 nullptr );
 
-      load_op->pSrcData    = new uint8_t [SrcDataSize];
-      load_op->SrcDataSize = SrcDataSize;
+      DWORD dwWritten = 0;
 
-      _swprintf (load_op->wszFilename, L"Resample_%x.dds", checksum);
+      if (hDumpFile != INVALID_HANDLE_VALUE)
+      {
+        WriteFile   (hDumpFile, job->data.data (), (DWORD)job->data.size (), &dwWritten, nullptr);
+        CloseHandle (hDumpFile);
+      }
 
-      memcpy (load_op->pSrcData, pSrcData, SrcDataSize);
+      if (dwWritten != job->data.size ())
+      {
+        tex_log->Log ( L"[ Dump Tex ] Failed to write %s",
+                         wszFileName );
+      }
 
-      (*ppTexture)->AddRef ();
-      load_op->pDest       = *ppTexture;
+      InterlockedAdd64     (&pQueue->bytes_written_, dwWritten);
+      InterlockedAdd64     (&pQueue->bytes_pending_, -(LONG64)job->data.size ());
+      InterlockedDecrement (&pQueue->queued_);
 
-      resample_pool->postJob (load_op);
+      delete job;
     }
   }
 
-  else if (load_op != nullptr) {
-    delete load_op;
-    load_op = nullptr;
-  }
+  return 0;
+}
 
-  if (SUCCEEDED (hr))
+//
+// On-demand dumping needs the source bytes of textures that were created some
+//   time ago; keep a bounded amount of them around (oldest are dropped first).
+//
+namespace dump_sources {
+  const size_t                                        budget = 128UL * 1024UL * 1024UL;
+
+  CRITICAL_SECTION                                    cs     = { };
+  std::unordered_map <uint32_t, std::vector <uint8_t>> data;
+  std::queue         <uint32_t>                       order;
+  size_t                                              bytes  = 0UL;
+
+  void retain (uint32_t checksum, const void* pData, size_t len)
   {
-    if (config.textures.cache && checksum != 0x00)
-    {
-      tbf::RenderFix::Texture* pTex =
-        new tbf::RenderFix::Texture ();
+    if (len > budget)
+      return;
 
-      pTex->crc32 = checksum;
+    TBF_AutoCritSection auto_crit (&cs);
 
-      pTex->d3d9_tex = *(ISKTextureD3D9 **)ppTexture;
-      pTex->d3d9_tex->AddRef ();
-      pTex->refs++;
+    if (data.count (checksum))
+      return;
 
-      pTex->load_time = (float)( 1000.0 *
-                          (double)(end.QuadPart - start.QuadPart) /
-                          (double)freq.QuadPart );
+    while (bytes + len > budget && (! order.empty ()))
+    {
+      auto oldest = data.find (order.front ());
 
-      tbf::RenderFix::tex_mgr.addTexture (checksum, pTex, SrcDataSize);
-    }
+      if (oldest != data.end ())
+      {
+        bytes -= oldest->second.size ();
+        data.erase (oldest);
+      }
 
-    if (false) {
-      tex_log->Log ( L"[Load Trace] Texture:   (%lu x %lu) * <LODs: %lu> - FAST_CRC32: %X",
-                      Width, Height, (*ppTexture)->GetLevelCount (), checksum );
-      tex_log->Log ( L"[Load Trace]              Usage: %-20s - Format: %-20s",
-                      SK_D3D9_UsageToStr    (Usage).c_str (),
-                        SK_D3D9_FormatToStr (Format).c_str () );
-      tex_log->Log ( L"[Load Trace]                Pool: %s",
-                      SK_D3D9_PoolToStr (Pool) );
-      tex_log->Log ( L"[Load Trace]      Load Time: %6.4f ms", 
-                    1000.0f * (double)(end.QuadPart - start.QuadPart) / (double)freq.QuadPart );
+      order.pop ();
     }
+
+    data [checksum].assign ((const uint8_t *)pData, (const uint8_t *)pData + len);
+    order.push (checksum);
+
+    bytes += len;
   }
 
-  if ( config.textures.dump && (! inject_thread) && (! injectable_textures.count (checksum)) &&
-                          (! dumped_textures.count (checksum)) )
+  bool fetch (uint32_t checksum, D3DFORMAT fmt)
   {
-    D3DXIMAGE_INFO info = { 0 };
-    D3DXGetImageInfoFromFileInMemory (pSrcData, SrcDataSize, &info);
+    TBF_AutoCritSection auto_crit (&cs);
 
-    D3DFORMAT fmt_real = info.Format;
+    auto src = data.find (checksum);
 
-    TBF_DumpTexture (fmt_real, checksum, *ppTexture);
-  }
+    if (src == data.end ())
+      return false;
 
-  return hr;
+    return dump_queue.push (fmt, checksum, src->second.data (), src->second.size ());
+  }
 }
 
-bool
-TBF_DeleteDumpedTexture (D3DFORMAT fmt, uint32_t checksum)
+CRITICAL_SECTION osd_cs           = { };
+DWORD           last_queue_update =   0;
+
+void
+TBFix_UpdateQueueOSD (void)
 {
-  wchar_t wszPath [MAX_PATH];
-  _swprintf ( wszPath, L"%s\\dump",
-                TBFIX_TEXTURE_DIR );
+  if (config.textures.show_loading_text)
+  {
+    DWORD dwTime = timeGetTime ();
 
-  if (GetFileAttributesW (wszPath) != FILE_ATTRIBUTE_DIRECTORY)
-    CreateDirectoryW (wszPath, nullptr);
+    if (TryEnterCriticalSection (&osd_cs))
+    {
+      extern std::string mod_text;
 
-  _swprintf ( wszPath, L"%s\\dump\\textures",
-                TBFIX_TEXTURE_DIR );
+      LONG resample_count = InterlockedExchangeAdd (&resampling, 0); size_t queue_len = resample_pool->queueLength ();
+      LONG stream_count   = InterlockedExchangeAdd (&streaming,  0); size_t to_stream = textures_to_stream.size    ();
 
-  if (GetFileAttributesW (wszPath) != FILE_ATTRIBUTE_DIRECTORY)
-    CreateDirectoryW (wszPath, nullptr);
+      bool is_resampling = (resample_pool->working () || resample_count || queue_len);
+      bool is_streaming  = (stream_pool.working    () || stream_count   || to_stream);
 
-  _swprintf ( wszPath, L"%s\\%s",
-                wszPath,
-                 SK_D3D9_FormatToStr (fmt, false).c_str () );
+      static std::string resampling_text; static DWORD dwLastResample = 0;
+      static std::string streaming_text;  static DWORD dwLastStream   = 0;
+      static std::string dumping_text;    static DWORD dwLastDump     = 0;
 
-  if (GetFileAttributesW (wszPath) != FILE_ATTRIBUTE_DIRECTORY)
-    CreateDirectoryW (wszPath, nullptr);
+      size_t to_dump = dump_queue.queueLength ();
+      
+      if (is_resampling)
+      {
+        size_t count = queue_len + resample_count;
 
-  wchar_t wszFileName [MAX_PATH] = { L'\0' };
-  _swprintf ( wszFileName, L"%s\\dump\\textures\\%s\\%08x%s",
-                TBFIX_TEXTURE_DIR,
-                  SK_D3D9_FormatToStr (fmt, false).c_str (),
-                    checksum,
-                      TBFIX_TEXTURE_EXT );
+            char szFormatted [64];
+        sprintf (szFormatted, "  Resampling: %zi texture", count);
 
-  if (GetFileAttributesW (wszFileName) != INVALID_FILE_ATTRIBUTES)
-  {
-    if (DeleteFileW (wszFileName))
-    {
-      dumped_textures.erase (checksum);
-      return true;
-    }
-  }
+        resampling_text  = szFormatted;
+        resampling_text += (count != 1) ? 's' : ' ';
 
-  return false;
-}
+        if (queue_len)
+        {
+          sprintf (szFormatted, " (%zu queued)", queue_len);
+          resampling_text += szFormatted;
+        }
 
-bool
-TBF_IsTextureDumped (uint32_t checksum)
-{
-  return dumped_textures.count (checksum);
-}
+        resampling_text += "\n";
 
-HRESULT
-TBF_DumpTexture (D3DFORMAT fmt, uint32_t checksum, IDirect3DTexture9* pTex)
-{
-  if ( (! injectable_textures.count (checksum)) &&
-       (! dumped_textures.count     (checksum)) )
-  {
-    D3DFORMAT fmt_real = fmt;
+        if (count)
+          dwLastResample = dwTime;
+      }
+      
+      if (is_streaming)
+      {
+        size_t count = stream_count + to_stream;
 
-    bool compressed = (fmt_real >= D3DFMT_DXT1 && fmt_real <= D3DFMT_DXT5);
+            char szFormatted [64];
+        sprintf (szFormatted, "  Streaming:  %zi texture", count);
 
-    wchar_t wszPath [MAX_PATH];
-    _swprintf ( wszPath, L"%s\\dump",
-                  TBFIX_TEXTURE_DIR );
+        streaming_text  = szFormatted;
+        streaming_text += (count != 1) ? 's' : ' ';
 
-    if (GetFileAttributesW (wszPath) != FILE_ATTRIBUTE_DIRECTORY)
-      CreateDirectoryW (wszPath, nullptr);
+        sprintf (szFormatted, " [%7.2f MiB]", (double)InterlockedExchangeAdd (&streaming_bytes, 0) / (1024.0f * 1024.0f));
+        streaming_text += szFormatted;
 
-    _swprintf ( wszPath, L"%s\\dump\\textures",
-                  TBFIX_TEXTURE_DIR );
+        if (to_stream)
+        {
+          sprintf (szFormatted, " (%zu queued)", to_stream);
+          streaming_text += szFormatted;
+        }
 
-    if (GetFileAttributesW (wszPath) != FILE_ATTRIBUTE_DIRECTORY)
-      CreateDirectoryW (wszPath, nullptr);
+        if (count)
+          dwLastStream = dwTime;
+      }
 
-    _swprintf ( wszPath, L"%s\\%s",
-                  wszPath,
-                   SK_D3D9_FormatToStr (fmt_real, false).c_str () );
+      if (to_dump)
+      {
+            char szFormatted [64];
+        sprintf (szFormatted, "  Dumping:    %zu texture", to_dump);
 
-    if (GetFileAttributesW (wszPath) != FILE_ATTRIBUTE_DIRECTORY)
-      CreateDirectoryW (wszPath, nullptr);
+        dumping_text  = szFormatted;
+        dumping_text += (to_dump != 1) ? 's' : ' ';
 
-    wchar_t wszFileName [MAX_PATH] = { L'\0' };
-    _swprintf ( wszFileName, L"%s\\dump\\textures\\%s\\%08x%s",
-                  TBFIX_TEXTURE_DIR,
-                    SK_D3D9_FormatToStr (fmt_real, false).c_str (),
-                      checksum,
-                        TBFIX_TEXTURE_EXT );
+        sprintf (szFormatted, " [%7.2f MiB written]\n", (double)dump_queue.bytesWritten () / (1024.0f * 1024.0f));
+        dumping_text += szFormatted;
 
-    HRESULT hr = D3DXSaveTextureToFile (wszFileName, D3DXIFF_DDS, pTex, NULL);
+        dwLastDump = dwTime;
+      }
 
-    if (SUCCEEDED (hr))
-      dumped_textures.emplace (checksum);
+      if (dwLastResample < dwTime - 150)
+        resampling_text = "";
 
-    return hr;
-  }
+      if (dwLastStream < dwTime - 150)
+        streaming_text = "";
 
-  return E_FAIL;
-}
+      if (dwLastDump < dwTime - 150)
+        dumping_text = "";
 
-std::vector <ISKTextureD3D9 *> remove_textures;
+      mod_text = resampling_text + streaming_text + dumping_text;
 
-tbf::RenderFix::Texture*
-tbf::RenderFix::TextureManager::getTexture (uint32_t checksum)
-{
-  EnterCriticalSection (&cs_cache);
+      if (mod_text != "")
+        last_queue_update = dwTime;
+      
+      LeaveCriticalSection (&osd_cs);
+    }
+  }
+}
 
-    auto rem = remove_textures.begin ();
+void
+TBFix_LoadQueuedTextures (void)
+{
+  TBFix_UpdateQueueOSD ();
 
-    while (rem != remove_textures.end ())
-    {
-      if ((*rem)->pTexOverride != nullptr)
-      {
-        InterlockedDecrement (&injected_count);
-        InterlockedAdd64     (&injected_size, -(*rem)->override_size);
-      }
+  int loads = 0;
 
-      if ((*rem)->pTex)         (*rem)->pTex->Release         ();
-      if ((*rem)->pTexOverride) (*rem)->pTexOverride->Release ();
+  std::vector <tbf_tex_load_s *> finished_resamples;
+  std::vector <tbf_tex_load_s *> finished_streams = stream_pool.getFinished ();
 
-      (*rem)->pTex         = nullptr;
-      (*rem)->pTexOverride = nullptr;
+  if (resample_pool != nullptr)
+    finished_resamples = resample_pool->getFinished ();
 
-      InterlockedAdd64 (&basic_size,  -(*rem)->tex_size);
-      {
-        textures.erase     ((*rem)->tex_crc32);
-      }
+  for (auto&& it : finished_resamples )
+  {
+    tbf_tex_load_s* load =
+      it;
 
-      delete *rem;
+    QueryPerformanceCounter (&load->end);
 
-      ++rem;
+    if (log_level > 0)
+    {
+      tex_log->Log ( L"[%s] Finished %s texture %08x (%5.2f MiB in %9.4f ms)",
+                       (load->type == tbf_tex_load_s::Stream) ? L"Inject Tex" :
+                         (load->type == tbf_tex_load_s::Immediate) ? L"Inject Tex" :
+                                                                     L" Resample ",
+                       (load->type == tbf_tex_load_s::Stream) ? L"streaming" :
+                         (load->type == tbf_tex_load_s::Immediate) ? L"loading" :
+                                                                     L"filtering",
+                         load->checksum,
+                           (double)load->SrcDataSize / (1024.0f * 1024.0f),
+                             1000.0f * (double)(load->end.QuadPart - load->start.QuadPart) /
+                                       (double)load->freq.QuadPart );
     }
 
-    remove_textures.clear ();
+    tbf::RenderFix::Texture* pTex =
+      tbf::RenderFix::tex_mgr.getTexture (load->checksum);
 
-    auto tex = textures.find (checksum);
+    if (pTex != nullptr)
+    {
+      //pTex->load_time = (float)(1000.0 * (double)(load->end.QuadPart - load->start.QuadPart) /
+                                          //(double)load->freq.QuadPart);
+    }
 
-  LeaveCriticalSection (&cs_cache);
+    ISKTextureD3D9* pSKTex =
+      (ISKTextureD3D9 *)load->pDest;
 
-  if (tex != textures.end ())
-    return tex->second;
+    if (pSKTex != nullptr)
+    {
+      if (pSKTex->refs == 0 && load->pSrc != nullptr)
+      {
+        tex_log->Log (L"[ Tex. Mgr ] >> Original texture no longer referenced, discarding new one!");
+        load->pSrc->Release ();
+      }
 
-  return nullptr;
-}
+      else
+      {
+        // Counts as used last frame; keeps the purge away from it without
+        //   hiding its next bind from textures_used.
+        pSKTex->last_used     = texture_frame - 1;
 
-void
-tbf::RenderFix::TextureManager::removeTexture (ISKTextureD3D9* pTexD3D9)
-{
-  EnterCriticalSection (&cs_cache);
+        pSKTex->pTexOverride  = load->pSrc;
+        pSKTex->override_size = load->SrcDataSize;
 
-  remove_textures.push_back (pTexD3D9);
+        // The original size info is completely wrong once we start generating mipmaps ;)
+        //
+        if (load->type == tbf_tex_load_s::Resample)
+        {
+          pSKTex->override_size = 0;
 
-  LeaveCriticalSection (&cs_cache);
+          for (UINT i = 0; i < pSKTex->pTexOverride->GetLevelCount (); i++)
+          {
+            D3DSURFACE_DESC                         desc = { };
+            pSKTex->pTexOverride->GetLevelDesc (i, &desc);
 
-  updateOSD ();
-}
+            int bytes_per_pel = SK_D3D9_BytesPerPixel (desc.Format);
 
-void
-tbf::RenderFix::TextureManager::addTexture (uint32_t checksum, tbf::RenderFix::Texture* pTex, size_t size)
-{
-  pTex->size = size;
+            // If bytes_per_pel is < 0, we have to handle DXT alignment craziness to be accurate...
 
-  InterlockedAdd64 (&basic_size, pTex->size);
+            if (bytes_per_pel >= 0)
+              pSKTex->override_size += desc.Width * desc.Height * bytes_per_pel;
 
-  EnterCriticalSection (&cs_cache);
-  {
-    textures [checksum] = pTex;
-  }
+            else
+            {
+              // Assume once this stuff gets into VRAM that it is tightly-packed,
+              //   it would be stupid for the driver to do otherwise.
+              UINT stride = bytes_per_pel == -1 ?
+               std::max (1UL, ((desc.Width + 3UL) / 4UL) ) * 8UL :
+               std::max (1UL, ((desc.Width + 3UL) / 4UL) ) * 16UL;
 
-  LeaveCriticalSection (&cs_cache);
+               size_t lod_size = stride * (desc.Height / 4 +
+                                           desc.Height % 4);
 
-  updateOSD ();
-}
+               pSKTex->override_size += lod_size;
+            }
+          }
 
-void
-tbf::RenderFix::TextureManager::refTexture (tbf::RenderFix::Texture* pTex)
-{
-  pTex->d3d9_tex->AddRef ();
-  pTex->refs++;
+          load->SrcDataSize = (UINT)pSKTex->override_size;
+        }
 
-  InterlockedIncrement (&hits);
+        tbf::RenderFix::tex_mgr.addInjected (load->SrcDataSize);
+      }
 
-  if (false) {//config.textures.log) {
-    tex_log->Log ( L"[CacheTrace] Cache hit (%X), saved %2.1f ms",
-                     pTex->crc32,
-                       pTex->load_time );
-  }
+      finished_streaming (load->checksum);
 
-  InterlockedAdd64 (&bytes_saved, pTex->size);
-                    time_saved += pTex->load_time;
+      ++loads;
 
-  updateOSD ();
-}
+      // Remove the temporary reference
+      load->pDest->Release ();
+    }
 
-COM_DECLSPEC_NOTHROW
-HRESULT
-STDMETHODCALLTYPE
-D3D9SetRenderTarget_Detour (
-                  _In_ IDirect3DDevice9  *This,
-                  _In_ DWORD              RenderTargetIndex,
-                  _In_ IDirect3DSurface9 *pRenderTarget
-)
-{
-  static int draw_counter = 0;
+    ++it;
 
-  // Ignore anything that's not the primary render device.
-  if (This != tbf::RenderFix::pDevice) {
-    return D3D9SetRenderTarget (This, RenderTargetIndex, pRenderTarget);
+    delete load;
   }
 
-  //if (tsf::RenderFix::tracer.log) {
-#ifdef DUMP_RT
-    if (D3DXSaveSurfaceToFileW == nullptr) {
-      D3DXSaveSurfaceToFileW =
-        (D3DXSaveSurfaceToFile_pfn)
-          GetProcAddress ( tsf::RenderFix::d3dx9_43_dll,
-                             "D3DXSaveSurfaceToFileW" );
+  for (auto&& it : finished_streams )
+  {
+    tbf_tex_load_s* load =
+      it;
+
+    QueryPerformanceCounter (&load->end);
+
+    if (log_level > 0)
+    {
+      tex_log->Log ( L"[%s] Finished %s texture %08x (%5.2f MiB in %9.4f ms)",
+                       (load->type == tbf_tex_load_s::Stream) ? L"Inject Tex" :
+                         (load->type == tbf_tex_load_s::Immediate) ? L"Inject Tex" :
+                                                                     L" Resample ",
+                       (load->type == tbf_tex_load_s::Stream) ? L"streaming" :
+                         (load->type == tbf_tex_load_s::Immediate) ? L"loading" :
+                                                                     L"filtering",
+                         load->checksum,
+                           (double)load->SrcDataSize / (1024.0f * 1024.0f),
+                             1000.0f * (double)(load->end.QuadPart - load->start.QuadPart) /
+                                       (double)load->freq.QuadPart );
     }
 
-    wchar_t wszDumpName [MAX_PATH];
+    tbf::RenderFix::Texture* pTex =
+      tbf::RenderFix::tex_mgr.getTexture (load->checksum);
 
-    if (pRenderTarget != pOld) {
-      if (pOld != nullptr) {
-        wsprintf (wszDumpName, L"dump\\%03d_out_%p.png", draw_counter, pOld);
+    if (pTex != nullptr)
+    {
+      //pTex->load_time = (float)(1000.0 * (double)(load->end.QuadPart - load->start.QuadPart) /
+                                          //(double)load->freq.QuadPart);
+    }
 
-        dll_log->Log ( L"[FrameTrace] >>> Dumped: Output RT to %s >>>", wszDumpName );
+    ISKTextureD3D9* pSKTex =
+      (ISKTextureD3D9 *)load->pDest;
 
-        dumping = true;
-        //D3DXSaveSurfaceToFile (wszDumpName, D3DXIFF_PNG, pOld, nullptr, nullptr);
+    if (pSKTex != nullptr)
+    {
+      if (pSKTex->refs == 0 && load->pSrc != nullptr)
+      {
+        tex_log->Log (L"[ Tex. Mgr ] >> Original texture no longer referenced, discarding new one!");
+        load->pSrc->Release ();
       }
-    }
-#endif
 
-    //dll_log->Log ( L"[FrameTrace] SetRenderTarget - RenderTargetIndex: %lu, pRenderTarget: %ph",
-                    //RenderTargetIndex, pRenderTarget );
+      else
+      {
+        // Counts as used last frame; keeps the purge away from it without
+        //   hiding its next bind from textures_used.
+        pSKTex->last_used     = texture_frame - 1;
 
-#ifdef DUMP_RT
-    if (pRenderTarget != pOld) {
-      pOld = pRenderTarget;
+        pSKTex->pTexOverride  = load->pSrc;
+        pSKTex->override_size = load->SrcDataSize;
 
-      wsprintf (wszDumpName, L"dump\\%03d_in_%p.png", ++draw_counter, pRenderTarget);
+        tbf::RenderFix::tex_mgr.addInjected (load->SrcDataSize);
+      }
 
-      dll_log->Log ( L"[FrameTrace] <<< Dumped: Input RT to  %s  <<<", wszDumpName );
+      finished_streaming (load->checksum);
 
-      dumping = true;
-      //D3DXSaveSurfaceToFile (wszDumpName, D3DXIFF_PNG, pRenderTarget, nullptr, nullptr);
+      ++loads;
+
+      // Remove the temporary reference
+      load->pDest->Release ();
     }
-#endif
-  //}
 
-  // TODO: Should we record which index the target is attached to?
-  //if (vs_checksum == tbf::RenderFix::tracked_vs.crc32)  tbf::RenderFix::tracked_vs.render_targets.emplace (pRenderTarget);
-  //if (ps_checksum == tbf::RenderFix::tracked_ps.crc32)  tbf::RenderFix::tracked_ps.render_targets.emplace (pRenderTarget);
+    ++it;
 
-  return D3D9SetRenderTarget (This, RenderTargetIndex, pRenderTarget);
-}
+    delete load;
+  }
 
-void
-tbf::RenderFix::TextureManager::Init (void)
-{
-  textures.reserve                  (4096);
-  textures_used.reserve             (2048);
-  textures_last_frame.reserve       (1024);
-  non_power_of_two_textures.reserve (512);
-  tracked_ps.used_textures.reserve  (256);
-  tracked_vs.used_textures.reserve  (256);
-  known.render_targets.reserve      (64);
-  used.render_targets.reserve       (64);
-  textures_in_flight.reserve        (32);
-  tracked_rt.pixel_shaders.reserve  (32);
-  tracked_rt.vertex_shaders.reserve (32);
+  //
+  // If the size changes, check to see if we need a purge - if so, schedule one.
+  //
+  static uint64_t last_size = 0ULL;
 
-  InitializeCriticalSectionAndSpinCount (&cs_cache, 8192UL);
-  InitializeCriticalSectionAndSpinCount (&osd_cs,   32UL);
+  if (last_size != tbf::RenderFix::tex_mgr.cacheSizeTotal () )
+  {
+    last_size = tbf::RenderFix::tex_mgr.cacheSizeTotal ();
 
-  // Create the directory to store dumped textures
-  if (config.textures.dump)
-    CreateDirectoryW (TBFIX_TEXTURE_DIR, nullptr);
+    if ( last_size >
+           (1024ULL * 1024ULL) * (uint64_t)config.textures.max_cache_in_mib )
+      __need_purge = true;
+  }
 
-  tex_log = TBF_CreateLog (L"logs/textures.log");
+  if ( (! InterlockedExchangeAdd (&streaming,  0)) &&
+       (! InterlockedExchangeAdd (&resampling, 0)) &&
+       (! pending_loads ()) )
+  {
+    if (__need_purge)
+    {
+      tbf::RenderFix::tex_mgr.purge ();
+      __need_purge = false;
+    }
+  }
 
-  CrcGenerateTable ();
+  tbf::RenderFix::tex_mgr.updateOSD ();
+}
 
-  d3dx9_43_dll = LoadLibrary (L"D3DX9_43.DLL");
+#include <set>
 
-  TBF_RefreshDataSources ();
+std::unordered_set <uint32_t> resample_blacklist;
+bool                          resample_blacklist_init = false;
 
-  if ( GetFileAttributesW (TBFIX_TEXTURE_DIR L"\\dump\\textures") !=
-         INVALID_FILE_ATTRIBUTES ) {
-    WIN32_FIND_DATA fd;
-    WIN32_FIND_DATA fd_sub;
-    HANDLE          hSubFind = INVALID_HANDLE_VALUE;
-    HANDLE          hFind    = INVALID_HANDLE_VALUE;
-    int             files    = 0;
-    LARGE_INTEGER   liSize   = { 0 };
+void
+TBFix_ReloadPadButtons (void)
+{
+  if (tbf::RenderFix::pad_buttons.tex_xboxone != nullptr)
+  {
+    uint32_t checksum = tbf::RenderFix::pad_buttons.crc32_xboxone;
 
-    tex_log->LogEx ( true, L"[ Dump Tex ] Enumerating dumped textures..." );
+    tbf::RenderFix::Texture* pTex = 
+      tbf::RenderFix::tex_mgr.getTexture (tbf::RenderFix::pad_buttons.crc32_xboxone);
 
-    hFind = FindFirstFileW (TBFIX_TEXTURE_DIR L"\\dump\\textures\\*", &fd);
+    IDirect3DTexture9* pD3DTex =
+      pTex->d3d9_tex;
 
-    if (hFind != INVALID_HANDLE_VALUE) {
-      do {
-        if (fd.dwFileAttributes != INVALID_FILE_ATTRIBUTES) {
-          wchar_t wszSubDir [MAX_PATH];
-          _swprintf (wszSubDir, L"%s\\dump\\textures\\%s\\*", TBFIX_TEXTURE_DIR, fd.cFileName);
+    if (TBF_IsWrappedTexture (pD3DTex))
+    {
+      ISKTextureD3D9* pSKTex =
+        (ISKTextureD3D9 *)pD3DTex;
 
-          hSubFind = FindFirstFileW (wszSubDir, &fd_sub);
+      IDirect3DDevice9* pDevice = nullptr;
 
-          if (hSubFind != INVALID_HANDLE_VALUE) {
-            do {
-              if (wcsstr (_wcslwr (fd_sub.cFileName), L".dds")) {
-                uint32_t checksum;
-                swscanf (fd_sub.cFileName, L"%08x.dds", &checksum);
+      wchar_t wszFile [MAX_PATH + 2] = { L'\0' };
 
-                ++files;
+      _swprintf ( wszFile,
+                    L"TBFix_Res\\Gamepads\\%s\\Buttons.dds",
+                      config.input.gamepad.texture_set.c_str () );
 
-                LARGE_INTEGER fsize;
+      if (GetFileAttributesW (wszFile) != INVALID_FILE_ATTRIBUTES)
+      {
+        tex_log->LogEx (true, L"[Inject Tex] Injecting custom gamepad buttons... ");
 
-                fsize.HighPart = fd_sub.nFileSizeHigh;
-                fsize.LowPart  = fd_sub.nFileSizeLow;
+        pD3DTex->GetDevice (&pDevice);
 
-                liSize.QuadPart += fsize.QuadPart;
+        tbf_tex_load_s* load_op = new tbf_tex_load_s;
 
-                dumped_textures.emplace (checksum);
-              }
-            } while (FindNextFileW (hSubFind, &fd_sub) != 0);
+        load_op->SrcDataSize =
+          injectable_textures.count (checksum) == 0 ?
+            0 : (UINT)injectable_textures [checksum].size;
 
-            FindClose (hSubFind);
-          }
-        }
-      } while (FindNextFileW (hFind, &fd) != 0);
+        load_op->pDevice  = pDevice;
+        load_op->checksum = checksum;
+        load_op->type     = tbf_tex_load_s::Immediate;
+        wcsncpy (load_op->wszFilename, wszFile, MAX_PATH);
 
-      FindClose (hFind);
-    }
+        tex_log->LogEx ( false, L"blocking (deferred)\n" );
 
-    tex_log->LogEx ( false, L" %lu files (%3.1f MiB)\n",
-                       files, (double)liSize.QuadPart / (1024.0 * 1024.0) );
-  }
+        wcsncpy ( load_op->wszFilename,
+                    wszFile,
+                      MAX_PATH );
 
-  InterlockedExchange64 (&bytes_saved, 0LL);
+        load_op->pDest     = pD3DTex;
 
-  time_saved  = 0.0f;
+        EnterCriticalSection        (&cs_tex_stream);
 
-#ifdef NO_TLS
-  InitializeCriticalSectionAndSpinCount (&cs_tex_inject,   10000000);
-#endif
-  InitializeCriticalSectionAndSpinCount (&cs_tex_resample, 10000);
-  InitializeCriticalSectionAndSpinCount (&cs_tex_stream,   100000);
+        ((ISKTextureD3D9 *)pD3DTex)->must_block = true;
 
-  decomp_semaphore = 
-    CreateSemaphore ( nullptr,
-                        config.textures.worker_threads,
-                          config.textures.worker_threads,
-                            nullptr );
+        if (is_streaming (load_op->checksum))
+        {
+          ISKTextureD3D9* pTexOrig =
+            (ISKTextureD3D9 *)textures_in_flight [load_op->checksum]->pDest;
 
-  resample_pool       = new SK_TextureThreadPool ();
+          // Remap the output of the in-flight texture
+          textures_in_flight [load_op->checksum]->pDest =
+            pD3DTex;
 
-  stream_pool.lrg_tex = new SK_TextureThreadPool ();
-  stream_pool.sm_tex  = new SK_TextureThreadPool ();
+          if (tbf::RenderFix::tex_mgr.getTexture (load_op->checksum)  != nullptr)
+          {
+            for ( int i = 0;
+                      i < tbf::RenderFix::tex_mgr.getTexture (load_op->checksum)->refs;
+                    ++i ) {
+              pD3DTex->AddRef ();
+            }
+          }
 
-  SK_ICommandProcessor& command =
-    *SK_GetCommandProcessor ();
+          ////tsf::RenderFix::tex_mgr.removeTexture (pTexOrig);
+        }
 
-  command.AddVariable (
-    "Textures.Remap",
+        else
+        {
+          textures_in_flight.try_emplace ( load_op->checksum, load_op );
+
+          resample_pool->postJob (load_op);
+        }
+
+        LeaveCriticalSection (&cs_tex_stream);
+      }
+    }
+  }
+}
+
+COM_DECLSPEC_NOTHROW
+HRESULT
+STDMETHODCALLTYPE
+D3DXCreateTextureFromFileInMemoryEx_Detour (
+  _In_    LPDIRECT3DDEVICE9  pDevice,
+  _In_    LPCVOID            pSrcData,
+  _In_    UINT               SrcDataSize,
+  _In_    UINT               Width,
+  _In_    UINT               Height,
+  _In_    UINT               MipLevels,
+  _In_    DWORD              Usage,
+  _In_    D3DFORMAT          Format,
+  _In_    D3DPOOL            Pool,
+  _In_    DWORD              Filter,
+  _In_    DWORD              MipFilter,
+  _In_    D3DCOLOR           ColorKey,
+  _Inout_ D3DXIMAGE_INFO     *pSrcInfo,
+  _Out_   PALETTEENTRY       *pPalette,
+  _Out_   LPDIRECT3DTEXTURE9 *ppTexture
+)
+{
+  bool inject_thread = false;
+
+#ifndef NO_TLS
+  TBF_TLS* pTLS = TBF_GetTLS ();
+
+  inject_thread = pTLS->d3d9.texinject_thread;
+#else
+  EnterCriticalSection (&cs_tex_inject);
+
+  if (inject_tids.count (GetCurrentThreadId ()))
+  {
+    inject_thread = true;
+  }
+
+  LeaveCriticalSection (&cs_tex_inject);
+#endif
+
+  // Injection would recurse slightly and cause impossible to diagnose reference counting problems
+  //   with texture caching if we did not check for this!
+  if (inject_thread) {
+    return D3DXCreateTextureFromFileInMemoryEx_Original (
+      pDevice,
+        pSrcData, SrcDataSize,
+          Width, Height, MipLevels,
+            Usage,
+              Format,
+                Pool,
+                  Filter, MipFilter, ColorKey,
+                    pSrcInfo, pPalette,
+                      ppTexture );
+  }
+
+  if (resample_blacklist_init == false)
+  {
+    // Do Not Resample Logos
+    resample_blacklist.emplace (0xfa3d03df);
+    resample_blacklist.emplace (0x545908bb);
+
+    resample_blacklist_init = true;
+  }
+
+  // Performance statistics for caching system
+         LARGE_INTEGER start, end;
+  static LARGE_INTEGER freq = { 0LL };
+
+  if (freq.QuadPart == 0LL)
+    QueryPerformanceFrequency (&freq);
+
+  uint32_t checksum =
+    crc32 (0, pSrcData, SrcDataSize);
+
+  // Don't dump or cache these
+  if (Usage == D3DUSAGE_DYNAMIC || Usage == D3DUSAGE_RENDERTARGET)
+    checksum = 0x00;
+
+  if (config.textures.cache && checksum != 0x00)
+  {
+    tbf::RenderFix::Texture* pTex =
+      tbf::RenderFix::tex_mgr.getTexture (checksum);
+
+    if (pTex != nullptr)
+    {
+      tbf::RenderFix::tex_mgr.refTexture (pTex);
+
+      *ppTexture = pTex->d3d9_tex;
+
+      return S_OK;
+    }
+
+    tbf::RenderFix::tex_mgr.missTexture ();
+  }
+
+  bool resample = false;
+
+  D3DXIMAGE_INFO info = { 0 };
+  D3DXGetImageInfoFromFileInMemory (pSrcData, SrcDataSize, &info);
+
+
+  bool power_of_two_in_one_way =  
+    (! (info.Width  & (info.Width  - 1)))  !=  (! (info.Height & (info.Height - 1)));
+
+
+
+  // Generate complete mipmap chains for best image quality
+  //  (will increase load-time on uncached textures)
+  if ((Pool == D3DPOOL_DEFAULT) && config.textures.remaster)
+  {
+    if (true)
+    {
+      bool power_of_two_in =
+        (! (info.Width  & (info.Width  - 1)))  &&  (! (info.Height & (info.Height - 1)));
+
+      bool power_of_two_out =
+        (! (Width  & (Width  - 1)))            &&  (! (Height & (Height - 1)));
+
+      if (power_of_two_in && power_of_two_out)
+      {
+        if (info.MipLevels > 1/* || config.textures.uncompressed*/)
+        {
+          resample = true;
+        }
+      }
+    }
+  }
+
+  HRESULT         hr           = E_FAIL;
+  tbf_tex_load_s* load_op      = nullptr;
+
+  wchar_t wszInjectFileName [MAX_PATH] = { L'\0' };
+
+  bool remap_stream = is_streaming (checksum);
+
+  //
+  // Generic injectable textures
+  //
+  if ( (! inject_thread) &&
+            injectable_textures.find (checksum) !=
+                     injectable_textures.end () )
+  {
+    if (log_level > 0) {
+      tex_log->LogEx ( true, L"[Inject Tex] Injectable texture for checksum (%08x)... ",
+                         checksum );
+    }
+
+    tbf_tex_record_s record = injectable_textures [checksum];
+
+    if (record.method == DontCare)
+      record.method = Streaming;
+
+    // If -1, load from disk...
+    if (record.archive == std::numeric_limits <unsigned int>::max ())
+    {
+      if (record.method == Streaming)
+        _swprintf ( wszInjectFileName, L"%s\\inject\\textures\\streaming\\%08x%s",
+                      TBFIX_TEXTURE_DIR,
+                        checksum,
+                          TBFIX_TEXTURE_EXT );
+      else if (record.method == Blocking)
+        _swprintf ( wszInjectFileName, L"%s\\inject\\textures\\blocking\\%08x%s",
+                      TBFIX_TEXTURE_DIR,
+                        checksum,
+                          TBFIX_TEXTURE_EXT );
+    }
+
+    load_op           = new tbf_tex_load_s;
+    load_op->pDevice  = pDevice;
+    load_op->checksum = checksum;
+
+    // The folder or archive a texture came from is only the author's guess
+    tbf_load_method_t method = record.method;
+    bool              urgent = (method == Blocking);
+
+    if (config.textures.adaptive_loading)
+      method = load_classifier.classify (checksum, record.method, &urgent);
+
+    if (method == Streaming)
+      load_op->type   = tbf_tex_load_s::Stream;
+    else
+      load_op->type   = tbf_tex_load_s::Immediate;
+
+    load_op->urgent   = urgent;
+
+    wcscpy (load_op->wszFilename, wszInjectFileName);
+
+    if (log_level > 0)
+    {
+      if (load_op->type == tbf_tex_load_s::Stream)
+      {
+        if ((! remap_stream))
+          tex_log->LogEx ( false, L"streaming\n" );
+        else
+          tex_log->LogEx ( false, L"in-flight already\n" );
+      }
+      
+      else
+      {
+        tex_log->LogEx ( false, L"blocking (deferred)\n" );
+      }
+    }
+  }
+
+  bool will_replace = config.textures.quick_load && resample;
+
+  QueryPerformanceCounter     (&start);
+
+  //tex_log->Log (L"D3DXCreateTextureFromFileInMemoryEx (... MipLevels=%lu ...)", MipLevels);
+  hr =
+    D3DXCreateTextureFromFileInMemoryEx_Original ( pDevice,
+                                                     pSrcData,         SrcDataSize,
+                                                       Width,          Height,    will_replace ? 1 : MipLevels,
+                                                         Usage,        Format,    Pool,
+                                                           Filter,     MipFilter, ColorKey,
+                                                             pSrcInfo, pPalette,
+                                                               ppTexture );
+
+  QueryPerformanceCounter     (&end);
+
+  if (SUCCEEDED (hr))
+  {
+    new ISKTextureD3D9 (ppTexture, SrcDataSize, checksum);
+
+    // Textures that would be incorrectly filtered if resampled
+    ((ISKTextureD3D9 *)*ppTexture)->npot = power_of_two_in_one_way;
+
+    const uint32_t license_crc32 = 0x86c4b6d0UL;
+
+    if (checksum == license_crc32)
+    {
+      wchar_t wszFile [MAX_PATH + 2] = { L'\0' };
+
+      lstrcatW ( wszFile, L"TBFix_Res\\license.dds" );
+
+      if (GetFileAttributesW (wszFile) != INVALID_FILE_ATTRIBUTES)
+      {
+        tex_log->LogEx (true, L"[Inject Tex] Injecting custom license disclaimer... ");
+
+        load_op           = new tbf_tex_load_s;
+        load_op->pDevice  = pDevice;
+        load_op->checksum = checksum;
+        load_op->type     = tbf_tex_load_s::Immediate;
+        wcsncpy (load_op->wszFilename, wszFile, MAX_PATH);
+
+        if (load_op->type == tbf_tex_load_s::Stream) {
+          if ((! remap_stream))
+            tex_log->LogEx ( false, L"streaming\n" );
+          else
+            tex_log->LogEx ( false, L"in-flight already\n" );
+        } else {
+          tex_log->LogEx ( false, L"blocking (deferred)\n" );
+        }
+
+        resample = false;
+      }
+    }
+
+    if (checksum == tbf::RenderFix::pad_buttons.crc32_ps4) {
+      tbf::RenderFix::pad_buttons.tex_ps4 = *ppTexture;
+    }
+
+    if (checksum == tbf::RenderFix::pad_buttons.crc32_xboxone) {
+      tbf::RenderFix::pad_buttons.tex_xboxone = *ppTexture;
+
+      wchar_t wszFile [MAX_PATH + 2] = { L'\0' };
+
+      _swprintf ( wszFile,
+                    L"TBFix_Res\\Gamepads\\%s\\Buttons.dds",
+                      config.input.gamepad.texture_set.c_str () );
+
+      if (GetFileAttributesW (wszFile) != INVALID_FILE_ATTRIBUTES)
+      {
+        WIN32_FILE_ATTRIBUTE_DATA
+          file_attrib_data = { 0 };
+
+        GetFileAttributesEx ( wszFile,
+                                GetFileExInfoStandard,
+                                  &file_attrib_data );
+
+        tbf_tex_record_s rec;
+        rec.size    =  ULARGE_INTEGER { file_attrib_data.nFileSizeLow,
+                                          file_attrib_data.nFileSizeHigh }.QuadPart;
+        rec.archive = std::numeric_limits <unsigned int>::max ();
+        rec.method  =  Blocking;
+
+        if (! injectable_textures.count (checksum))
+          injectable_textures.try_emplace ( checksum, rec );
+        else {
+          injectable_textures [checksum] = rec;
+        }
+
+        tex_log->LogEx (true, L"[Inject Tex] Injecting custom gamepad buttons... ");
+
+        load_op           = new tbf_tex_load_s;
+        load_op->pDevice  = pDevice;
+        load_op->checksum = checksum;
+        load_op->type     = tbf_tex_load_s::Immediate;
+        wcsncpy (load_op->wszFilename, wszFile, MAX_PATH);
+
+        if (load_op->type == tbf_tex_load_s::Stream) {
+          if ((! remap_stream))
+            tex_log->LogEx ( false, L"streaming\n" );
+          else
+            tex_log->LogEx ( false, L"in-flight already\n" );
+        } else {
+          tex_log->LogEx ( false, L"blocking (deferred)\n" );
+        }
+
+        resample = false;
+      }
+    }
+
+
+    if ( load_op != nullptr && ( load_op->type == tbf_tex_load_s::Stream ||
+                                 load_op->type == tbf_tex_load_s::Immediate ) ) {
+      load_op->SrcDataSize =
+        injectable_textures.count (checksum) == 0 ?
+          0 : (UINT)injectable_textures [checksum].size;
+
+      load_op->pDest = *ppTexture;
+
+      if (config.textures.adaptive_loading)
+      {
+        ISKTextureD3D9* pSKTex =
+          (ISKTextureD3D9 *)*ppTexture;
+
+        QueryPerformanceCounter (&pSKTex->created);
+        pSKTex->bind_pending = true;
+      }
+
+      EnterCriticalSection        (&cs_tex_stream);
+
+      if (load_op->type == tbf_tex_load_s::Immediate)
+        ((ISKTextureD3D9 *)*ppTexture)->must_block = true;
+
+      if (is_streaming (load_op->checksum)) {
+        ISKTextureD3D9* pTexOrig =
+          (ISKTextureD3D9 *)textures_in_flight [load_op->checksum]->pDest;
+
+        // Remap the output of the in-flight texture
+        textures_in_flight [load_op->checksum]->pDest =
+          *ppTexture;
+
+        if (tbf::RenderFix::tex_mgr.getTexture (load_op->checksum)  != nullptr) {
+          for ( int i = 0;
+                    i < tbf::RenderFix::tex_mgr.getTexture (load_op->checksum)->refs;
+                  ++i ) {
+            (*ppTexture)->AddRef ();
+          }
+        }
+
+        ////tsf::RenderFix::tex_mgr.removeTexture (pTexOrig);
+      }
+
+      else {
+        textures_in_flight.try_emplace ( load_op->checksum, load_op );
+
+        stream_pool.postJob (load_op);
+        //resample_pool->postJob (load_op);
+      }
+
+      LeaveCriticalSection        (&cs_tex_stream);
+    }
+
+#if 0
+    //
+    // TODO:  Actually stream these, but block if the game tries to call SetTexture (...)
+    //          while the texture is in-flight.
+    //
+    else if (load_op != nullptr && load_op->type == tsf_tex_load_s::Immediate) {
+      QueryPerformanceFrequency        (&load_op->freq);
+      QueryPerformanceCounter (&load_op->start);
+
+      EnterCriticalSection (&cs_tex_inject);
+      inject_tids.insert   (GetCurrentThreadId ());
+      LeaveCriticalSection (&cs_tex_inject);
+
+      load_op->pDest = *ppTexture;
+
+      hr = InjectTexture (load_op);
+
+      EnterCriticalSection (&cs_tex_inject);
+      inject_tids.erase    (GetCurrentThreadId ());
+      LeaveCriticalSection (&cs_tex_inject);
+
+      QueryPerformanceCounter (&load_op->end);
+
+      if (SUCCEEDED (hr)) {
+        tex_log->Log ( L"[Inject Tex] Finished synchronous texture %08x (%5.2f MiB in %9.4f ms)",
+                        load_op->checksum,
+                          (double)load_op->SrcDataSize / (1024.0f * 1024.0f),
+                            1000.0f * (double)(load_op->end.QuadPart - load_op->start.QuadPart) /
+                                      (double) load_op->freq.QuadPart );
+        ISKTextureD3D9* pSKTex =
+          (ISKTextureD3D9 *)*ppTexture;
+
+        pSKTex->pTexOverride  = load_op->pSrc;
+        pSKTex->override_size = load_op->SrcDataSize;
+
+        pSKTex->last_used     = load_op->end;
+
+        tsf::RenderFix::tex_mgr.addInjected (load_op->SrcDataSize);
+      } else {
+        tex_log->Log ( L"[Inject Tex] *** FAILED synchronous texture %08x",
+                        load_op->checksum );
+      }
+
+      delete load_op;
+      load_op = nullptr;
+    }
+#endif
+
+    else if (resample) {
+      load_op              = new tbf_tex_load_s;
+
+      load_op->pDevice     = pDevice;
+      load_op->checksum    = checksum;
+      load_op->type        = tbf_tex_load_s::Resample;
+
+      load_op->pSrcData    = new uint8_t [SrcDataSize];
+      load_op->SrcDataSize = SrcDataSize;
+
+      _swprintf (load_op->wszFilename, L"Resample_%x.dds", checksum);
+
+      memcpy (load_op->pSrcData, pSrcData, SrcDataSize);
+
+      (*ppTexture)->AddRef ();
+      load_op->pDest       = *ppTexture;
+
+      resample_pool->postJob (load_op);
+    }
+  }
+
+  else if (load_op != nullptr) {
+    delete load_op;
+    load_op = nullptr;
+  }
+
+  if (SUCCEEDED (hr))
+  {
+    if (config.textures.cache && checksum != 0x00)
+    {
+      tbf::RenderFix::Texture* pTex =
+        new tbf::RenderFix::Texture ();
+
+      pTex->crc32 = checksum;
+
+      pTex->d3d9_tex = *(ISKTextureD3D9 **)ppTexture;
+      pTex->d3d9_tex->AddRef ();
+      pTex->refs++;
+
+      pTex->load_time = (float)( 1000.0 *
+                          (double)(end.QuadPart - start.QuadPart) /
+                          (double)freq.QuadPart );
+
+      tbf::RenderFix::tex_mgr.addTexture (checksum, pTex, SrcDataSize);
+    }
+
+    if (false) {
+      tex_log->Log ( L"[Load Trace] Texture:   (%lu x %lu) * <LODs: %lu> - FAST_CRC32: %X",
+                      Width, Height, (*ppTexture)->GetLevelCount (), checksum );
+      tex_log->Log ( L"[Load Trace]              Usage: %-20s - Format: %-20s",
+                      SK_D3D9_UsageToStr    (Usage).c_str (),
+                        SK_D3D9_FormatToStr (Format).c_str () );
+      tex_log->Log ( L"[Load Trace]                Pool: %s",
+                      SK_D3D9_PoolToStr (Pool) );
+      tex_log->Log ( L"[Load Trace]      Load Time: %6.4f ms", 
+                    1000.0f * (double)(end.QuadPart - start.QuadPart) / (double)freq.QuadPart );
+    }
+  }
+
+  if ( SUCCEEDED (hr) && checksum != 0x00 && (! inject_thread) &&
+       (! injectable_textures.count (checksum)) &&
+       (! dumped_textures.count     (checksum)) )
+  {
+    // The source data is a .dds file already, just queue it for writing
+    if (config.textures.dump)
+    {
+      if (dump_queue.push (info.Format, checksum, pSrcData, SrcDataSize))
+        dumped_textures.emplace (checksum);
+    }
+
+    else if (config.textures.on_demand_dump)
+      dump_sources::retain (checksum, pSrcData, SrcDataSize);
+  }
+
+  return hr;
+}
+
+bool
+TBF_DeleteDumpedTexture (D3DFORMAT fmt, uint32_t checksum)
+{
+  // A texture can be in the pack and extracted from it at the same time
+  bool deleted =
+    dump_pack.remove (checksum);
+
+  wchar_t wszFileName [MAX_PATH] = { L'\0' };
+  TBF_GetDumpFileName (fmt, checksum, wszFileName);
+
+  if (GetFileAttributesW (wszFileName) != INVALID_FILE_ATTRIBUTES)
+  {
+    if (DeleteFileW (wszFileName))
+      deleted = true;
+  }
+
+  if (deleted)
+    dumped_textures.erase (checksum);
+
+  return deleted;
+}
+
+bool
+TBF_IsTextureDumped (uint32_t checksum)
+{
+  return dumped_textures.count (checksum);
+}
+
+bool
+TBF_IsTextureDumpPacked (uint32_t checksum)
+{
+  tbf_dump_entry_s entry;
+
+  return dump_pack.find (checksum, &entry);
+}
+
+//
+// Writes a texture stored in the dump pack out as a loose .dds file
+//
+bool
+TBF_ExtractDumpedTexture (uint32_t checksum)
+{
+  tbf_dump_entry_s entry;
+
+  if (! dump_pack.find (checksum, &entry))
+    return false;
+
+  wchar_t wszFileName [MAX_PATH] = { L'\0' };
+  TBF_GetDumpFileName ((D3DFORMAT)entry.format, checksum, wszFileName);
+
+  return dump_pack.extract (entry, wszFileName);
+}
+
+int
+TBF_ExtractDumpPack (void)
+{
+  std::unordered_set <uint32_t> extracted;
+
+  for ( auto& entry : dump_pack.entries () )
+  {
+    if ( extracted.count (entry.checksum) == 0 &&
+         TBF_ExtractDumpedTexture (entry.checksum) )
+      extracted.emplace (entry.checksum);
+  }
+
+  tex_log->Log ( L"[ Dump Tex ] Extracted %lu textures from dump pack",
+                   (unsigned long)extracted.size () );
+
+  return (int)extracted.size ();
+}
+
+HRESULT
+TBF_DumpTexture (D3DFORMAT fmt, uint32_t checksum, IDirect3DTexture9* pTex)
+{
+  if ( (! injectable_textures.count (checksum)) &&
+       (! dumped_textures.count     (checksum)) )
+  {
+    // Prefer the original file data, if it was kept around
+    if (dump_sources::fetch (checksum, fmt))
+    {
+      dumped_textures.emplace (checksum);
+      return S_OK;
+    }
+
+    // Otherwise this only works if the texture happens to be lockable
+    wchar_t wszFileName [MAX_PATH] = { L'\0' };
+    TBF_GetDumpFileName (fmt, checksum, wszFileName);
+
+    HRESULT hr = D3DXSaveTextureToFile (wszFileName, D3DXIFF_DDS, pTex, NULL);
+
+    if (SUCCEEDED (hr))
+      dumped_textures.emplace (checksum);
+
+    return hr;
+  }
+
+  return E_FAIL;
+}
+
+std::vector <ISKTextureD3D9 *> remove_textures;
+
+tbf::RenderFix::Texture*
+tbf::RenderFix::TextureManager::getTexture (uint32_t checksum)
+{
+  EnterCriticalSection (&cs_cache);
+
+    auto rem = remove_textures.begin ();
+
+    while (rem != remove_textures.end ())
+    {
+      if ((*rem)->pTexOverride != nullptr)
+      {
+        InterlockedDecrement (&injected_count);
+        InterlockedAdd64     (&injected_size, -(*rem)->override_size);
+      }
+
+      if ((*rem)->pTex)         (*rem)->pTex->Release         ();
+      if ((*rem)->pTexOverride) (*rem)->pTexOverride->Release ();
+
+      (*rem)->pTex         = nullptr;
+      (*rem)->pTexOverride = nullptr;
+
+      InterlockedAdd64 (&basic_size,  -(*rem)->tex_size);
+      {
+        textures.erase     ((*rem)->tex_crc32);
+      }
+
+      delete *rem;
+
+      ++rem;
+    }
+
+    remove_textures.clear ();
+
+    auto tex = textures.find (checksum);
+
+  LeaveCriticalSection (&cs_cache);
+
+  if (tex != textures.end ())
+    return tex->second;
+
+  return nullptr;
+}
+
+void
+tbf::RenderFix::TextureManager::removeTexture (ISKTextureD3D9* pTexD3D9)
+{
+  EnterCriticalSection (&cs_cache);
+
+  remove_textures.push_back (pTexD3D9);
+
+  LeaveCriticalSection (&cs_cache);
+
+  updateOSD ();
+}
+
+void
+tbf::RenderFix::TextureManager::addTexture (uint32_t checksum, tbf::RenderFix::Texture* pTex, size_t size)
+{
+  pTex->size = size;
+
+  InterlockedAdd64 (&basic_size, pTex->size);
+
+  EnterCriticalSection (&cs_cache);
+  {
+    textures [checksum] = pTex;
+  }
+
+  LeaveCriticalSection (&cs_cache);
+
+  updateOSD ();
+}
+
+void
+tbf::RenderFix::TextureManager::refTexture (tbf::RenderFix::Texture* pTex)
+{
+  pTex->d3d9_tex->AddRef ();
+  pTex->refs++;
+
+  InterlockedIncrement (&hits);
+
+  if (false) {//config.textures.log) {
+    tex_log->Log ( L"[CacheTrace] Cache hit (%X), saved %2.1f ms",
+                     pTex->crc32,
+                       pTex->load_time );
+  }
+
+  InterlockedAdd64 (&bytes_saved, pTex->size);
+                    time_saved += pTex->load_time;
+
+  updateOSD ();
+}
+
+COM_DECLSPEC_NOTHROW
+HRESULT
+STDMETHODCALLTYPE
+D3D9SetRenderTarget_Detour (
+                  _In_ IDirect3DDevice9  *This,
+                  _In_ DWORD              RenderTargetIndex,
+                  _In_ IDirect3DSurface9 *pRenderTarget
+)
+{
+  static int draw_counter = 0;
+
+  // Ignore anything that's not the primary render device.
+  if (This != tbf::RenderFix::pDevice) {
+    return D3D9SetRenderTarget (This, RenderTargetIndex, pRenderTarget);
+  }
+
+  TBF_TraceScope trace ( tbf::RenderFix::call_trace,
+                          tbf_trace_op::SetRenderTarget, (uint16_t)RenderTargetIndex );
+
+  if (tbf::RenderFix::call_trace.active () && pRenderTarget != nullptr)
+  {
+    D3DSURFACE_DESC desc;
+
+    if (SUCCEEDED (pRenderTarget->GetDesc (&desc)))
+    {
+      trace.arg (0, desc.Width);
+      trace.arg (1, desc.Height);
+    }
+  }
+
+  //if (tsf::RenderFix::tracer.log) {
+#ifdef DUMP_RT
+    if (D3DXSaveSurfaceToFileW == nullptr) {
+      D3DXSaveSurfaceToFileW =
+        (D3DXSaveSurfaceToFile_pfn)
+          GetProcAddress ( tsf::RenderFix::d3dx9_43_dll,
+                             "D3DXSaveSurfaceToFileW" );
+    }
+
+    wchar_t wszDumpName [MAX_PATH];
+
+    if (pRenderTarget != pOld) {
+      if (pOld != nullptr) {
+        wsprintf (wszDumpName, L"dump\\%03d_out_%p.png", draw_counter, pOld);
+
+        dll_log->Log ( L"[FrameTrace] >>> Dumped: Output RT to %s >>>", wszDumpName );
+
+        dumping = true;
+        //D3DXSaveSurfaceToFile (wszDumpName, D3DXIFF_PNG, pOld, nullptr, nullptr);
+      }
+    }
+#endif
+
+    //dll_log->Log ( L"[FrameTrace] SetRenderTarget - RenderTargetIndex: %lu, pRenderTarget: %ph",
+                    //RenderTargetIndex, pRenderTarget );
+
+#ifdef DUMP_RT
+    if (pRenderTarget != pOld) {
+      pOld = pRenderTarget;
+
+      wsprintf (wszDumpName, L"dump\\%03d_in_%p.png", ++draw_counter, pRenderTarget);
+
+      dll_log->Log ( L"[FrameTrace] <<< Dumped: Input RT to  %s  <<<", wszDumpName );
+
+      dumping = true;
+      //D3DXSaveSurfaceToFile (wszDumpName, D3DXIFF_PNG, pRenderTarget, nullptr, nullptr);
+    }
+#endif
+  //}
+
+  // TODO: Should we record which index the target is attached to?
+  //if (vs_checksum == tbf::RenderFix::tracked_vs.crc32)  tbf::RenderFix::tracked_vs.render_targets.emplace (pRenderTarget);
+  //if (ps_checksum == tbf::RenderFix::tracked_ps.crc32)  tbf::RenderFix::tracked_ps.render_targets.emplace (pRenderTarget);
+
+  HRESULT hr =
+    D3D9SetRenderTarget (This, RenderTargetIndex, pRenderTarget);
+
+  // The runtime resets the viewport and scissor rect to cover the new target
+  if (RenderTargetIndex == 0 && SUCCEEDED (hr))
+  {
+    tbf::RenderFix::state_cache.targetChanged ();
+    tbf::RenderFix::device_shadow.setRenderTarget (pRenderTarget);
+  }
+
+  return hr;
+}
+
+void
+tbf::RenderFix::TextureManager::Init (void)
+{
+  textures.reserve                  (4096);
+  textures_last_frame.reserve       (1024);
+  known.render_targets.reserve      (64);
+  textures_in_flight.reserve        (32);
+
+  InitializeCriticalSectionAndSpinCount (&cs_cache, 8192UL);
+  InitializeCriticalSectionAndSpinCount (&osd_cs,   32UL);
+
+  // Create the directory to store dumped textures
+  if (config.textures.dump)
+    CreateDirectoryW (TBFIX_TEXTURE_DIR, nullptr);
+
+  tex_log = TBF_CreateLog (L"logs/textures.log");
+
+  CrcGenerateTable ();
+
+  d3dx9_43_dll = LoadLibrary (L"D3DX9_43.DLL");
+
+  InitializeCriticalSection (&cs_inject_index);
+
+  TBF_RefreshDataSources ();
+
+  if (config.textures.hot_reload)
+    TBF_StartInjectWatch ();
+
+  if (config.textures.dump_to_pack)
+  {
+    CreateDirectoryW (TBFIX_TEXTURE_DIR,           nullptr);
+    CreateDirectoryW (TBFIX_TEXTURE_DIR L"\\dump", nullptr);
+
+    if ( dump_pack.open ( TBFIX_TEXTURE_DIR L"\\dump\\textures.dumppack",
+                          TBFIX_TEXTURE_DIR L"\\dump\\textures.dumpidx" ) )
+    {
+      auto entries =
+        dump_pack.entries ();
+
+      for ( auto& entry : entries )
+        dumped_textures.emplace (entry.checksum);
+
+      tex_log->Log ( L"[ Dump Tex ] Dump pack contains %lu textures",
+                       (unsigned long)entries.size () );
+    }
+
+    else
+      tex_log->Log (L"[ Dump Tex ] Could not open dump pack, dumping loose files instead");
+  }
+
+  //
+  // The pack only knows what was dumped into it; loose dumps from sessions
+  //   without it (and textures extracted from it) still have to be found.
+  //
+  if ( GetFileAttributesW (TBFIX_TEXTURE_DIR L"\\dump\\textures") !=
+         INVALID_FILE_ATTRIBUTES ) {
+    WIN32_FIND_DATA fd;
+    WIN32_FIND_DATA fd_sub;
+    HANDLE          hSubFind = INVALID_HANDLE_VALUE;
+    HANDLE          hFind    = INVALID_HANDLE_VALUE;
+    int             files    = 0;
+    LARGE_INTEGER   liSize   = { 0 };
+
+    tex_log->LogEx ( true, L"[ Dump Tex ] Enumerating dumped textures..." );
+
+    hFind = FindFirstFileW (TBFIX_TEXTURE_DIR L"\\dump\\textures\\*", &fd);
+
+    if (hFind != INVALID_HANDLE_VALUE) {
+      do {
+        if (fd.dwFileAttributes != INVALID_FILE_ATTRIBUTES) {
+          wchar_t wszSubDir [MAX_PATH];
+          _swprintf (wszSubDir, L"%s\\dump\\textures\\%s\\*", TBFIX_TEXTURE_DIR, fd.cFileName);
+
+          hSubFind = FindFirstFileW (wszSubDir, &fd_sub);
+
+          if (hSubFind != INVALID_HANDLE_VALUE) {
+            do {
+              if (wcsstr (_wcslwr (fd_sub.cFileName), L".dds")) {
+                uint32_t checksum;
+                swscanf (fd_sub.cFileName, L"%08x.dds", &checksum);
+
+                ++files;
+
+                LARGE_INTEGER fsize;
+
+                fsize.HighPart = fd_sub.nFileSizeHigh;
+                fsize.LowPart  = fd_sub.nFileSizeLow;
+
+                liSize.QuadPart += fsize.QuadPart;
+
+                dumped_textures.emplace (checksum);
+              }
+            } while (FindNextFileW (hSubFind, &fd_sub) != 0);
+
+            FindClose (hSubFind);
+          }
+        }
+      } while (FindNextFileW (hFind, &fd) != 0);
+
+      FindClose (hFind);
+    }
+
+    tex_log->LogEx ( false, L" %lu files (%3.1f MiB)\n",
+                       files, (double)liSize.QuadPart / (1024.0 * 1024.0) );
+  }
+
+  InterlockedExchange64 (&bytes_saved, 0LL);
+
+  time_saved  = 0.0f;
+
+#ifdef NO_TLS
+  InitializeCriticalSectionAndSpinCount (&cs_tex_inject,   10000000);
+#endif
+  InitializeCriticalSectionAndSpinCount (&cs_tex_resample, 10000);
+  InitializeCriticalSectionAndSpinCount (&cs_tex_stream,   100000);
+  InitializeCriticalSection             (&cs_tex_packs);
+  InitializeCriticalSection             (&dump_sources::cs);
+
+  dump_queue.init ();
+
+  decomp_semaphore = 
+    CreateSemaphore ( nullptr,
+                        config.textures.worker_threads,
+                          config.textures.worker_threads,
+                            nullptr );
+
+  resample_pool       = new SK_TextureThreadPool ();
+
+  stream_pool.lrg_tex = new SK_TextureThreadPool ();
+  stream_pool.sm_tex  = new SK_TextureThreadPool ();
+
+  io_stage            = new SK_TextureIOStage    ();
+
+  if (config.textures.predictive_prefetch)
+  {
+    usage_model.load (TBFIX_USAGE_MODEL_FILE);
+
+    tex_log->Log ( L"[ Prefetch ] Usage model knows %lu injectable textures",
+                     (unsigned long)usage_model.numKeys () );
+  }
+
+  if (config.textures.adaptive_loading)
+    load_classifier.load (TBFIX_LOAD_STATS_FILE);
+
+  if (config.textures.resident_blocking)
+    TBF_StartResidentPool ();
+
+  if ( (config.textures.predictive_prefetch || config.textures.warm_start) &&
+         config.textures.staging_budget_mib > 0 )
+    source_stager.init ((size_t)config.textures.staging_budget_mib * 1024ULL * 1024ULL);
+
+  //
+  // Queue last session's textures in the order they were first needed, for
+  //   as many as fit in the staging budget.
+  //
+  if (config.textures.warm_start && config.textures.staging_budget_mib > 0)
+  {
+    std::vector <tbf_warm_entry_s> entries;
+
+    if (TBF_WarmStartSet::load (TBFIX_WARM_START_FILE, entries))
+    {
+      const size_t budget =
+        (size_t)config.textures.staging_budget_mib * 1024ULL * 1024ULL;
+
+      std::vector <uint32_t> plan =
+        TBF_WarmStartSet::plan ( entries, budget,
+                                   [](uint32_t checksum) -> size_t {
+                                     tbf_stage_request_s req;
+
+                                     return TBF_MakeStageRequest (checksum, req) ?
+                                              req.record.size : 0;
+                                   } );
+
+      size_t queued_bytes = 0;
+      int    queued       = 0;
+
+      for ( auto checksum : plan )
+      {
+        tbf_stage_request_s req;
+
+        if (! TBF_MakeStageRequest (checksum, req))
+          continue;
+
+        if (source_stager.request (req))
+        {
+          queued_bytes += req.record.size;
+          ++queued;
+        }
+      }
+
+      tex_log->Log ( L"[ Prefetch ] Warm start: staging %li of %lu textures (%.2f MiB)",
+                       queued, (unsigned long)entries.size (),
+                         (double)queued_bytes / (1024.0 * 1024.0) );
+    }
+  }
+
+  SK_ICommandProcessor& command =
+    *SK_GetCommandProcessor ();
+
+  command.AddVariable (
+    "Textures.Remap",
       TBF_CreateVar (SK_IVariable::Boolean, &__remap_textures) );
 
-  command.AddVariable (
-    "Textures.Purge",
-      TBF_CreateVar (SK_IVariable::Boolean, &__need_purge) );
+  command.AddVariable (
+    "Textures.Purge",
+      TBF_CreateVar (SK_IVariable::Boolean, &__need_purge) );
+
+  command.AddVariable (
+    "Textures.Trace",
+      TBF_CreateVar (SK_IVariable::Boolean, &__log_used) );
+
+  command.AddVariable (
+    "Textures.ShowCache",
+      TBF_CreateVar (SK_IVariable::Boolean, &__show_cache) );
+
+  command.AddVariable (
+    "Textures.MaxCacheSize",
+      TBF_CreateVar (SK_IVariable::Int,     &config.textures.max_cache_in_mib) );
+}
+
+void
+tbf::RenderFix::TextureManager::Hook (void)
+{
+  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
+                       "D3D9SetRenderState_Override",
+                        D3D9SetRenderState_Detour,
+              (LPVOID*)&D3D9SetRenderState );
+
+  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
+                       "D3D9BeginScene_Override",
+                        D3D9BeginScene_Detour,
+              (LPVOID*)&D3D9BeginScene );
+
+  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
+                       "D3D9StretchRect_Override",
+                        D3D9StretchRect_Detour,
+              (LPVOID*)&D3D9StretchRect );
+
+  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
+                       "D3D9CreateRenderTarget_Override",
+                        D3D9CreateRenderTarget_Detour,
+              (LPVOID*)&D3D9CreateRenderTarget );
+
+  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
+                       "D3D9CreateDepthStencilSurface_Override",
+                        D3D9CreateDepthStencilSurface_Detour,
+              (LPVOID*)&D3D9CreateDepthStencilSurface );
+
+  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
+                       "D3D9CreateTexture_Override",
+                        D3D9CreateTexture_Detour,
+              (LPVOID*)&D3D9CreateTexture );
+
+  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
+                       "D3D9SetTexture_Override",
+                        D3D9SetTexture_Detour,
+              (LPVOID*)&D3D9SetTexture );
+
+  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
+                       "D3D9SetRenderTarget_Override",
+                        D3D9SetRenderTarget_Detour,
+              (LPVOID*)&D3D9SetRenderTarget );
+
+  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
+                       "D3D9SetDepthStencilSurface_Override",
+                        D3D9SetDepthStencilSurface_Detour,
+              (LPVOID*)&D3D9SetDepthStencilSurface );
+
+  TBF_CreateDLLHook2 ( L"D3DX9_43.DLL",
+                        "D3DXCreateTextureFromFileInMemoryEx",
+                         D3DXCreateTextureFromFileInMemoryEx_Detour,
+              (LPVOID *)&D3DXCreateTextureFromFileInMemoryEx_Original );
+
+  D3DXSaveTextureToFile =
+    (D3DXSaveTextureToFile_pfn)
+      GetProcAddress ( tbf::RenderFix::d3dx9_43_dll,
+                         "D3DXSaveTextureToFileW" );
+
+  D3DXSaveSurfaceToFileW =
+    (D3DXSaveSurfaceToFile_pfn)
+      GetProcAddress ( tbf::RenderFix::d3dx9_43_dll,
+                         "D3DXSaveSurfaceToFileW" );
+
+  D3DXCreateTextureFromFile =
+    (D3DXCreateTextureFromFile_pfn)
+      GetProcAddress ( tbf::RenderFix::d3dx9_43_dll,
+                         "D3DXCreateTextureFromFileW" );
+
+  D3DXCreateTextureFromFileEx =
+    (D3DXCreateTextureFromFileEx_pfn)
+      GetProcAddress ( tbf::RenderFix::d3dx9_43_dll,
+                         "D3DXCreateTextureFromFileExW" );
+
+  D3DXGetImageInfoFromFileInMemory =
+    (D3DXGetImageInfoFromFileInMemory_pfn)
+      GetProcAddress ( tbf::RenderFix::d3dx9_43_dll,
+                         "D3DXGetImageInfoFromFileInMemory" );
+
+  D3DXGetImageInfoFromFile =
+    (D3DXGetImageInfoFromFile_pfn)
+      GetProcAddress ( tbf::RenderFix::d3dx9_43_dll,
+                         "D3DXGetImageInfoFromFileW" );
+}
+
+// Skip the purge step on shutdown
+bool shutting_down = false;
+
+void
+tbf::RenderFix::TextureManager::Shutdown (void)
+{
+  // It is possible for the DLL to be unloaded before the texture manager is
+  //   initialized, in which case a nullptr value for tex_log is the easiest
+  //     way to detect this.
+  if (tex_log == nullptr)
+    return;
+
+  // 16.6 ms per-frame (60 FPS)
+  const float frame_time = 16.6f;
+
+  while (! textures_to_stream.empty ())
+    textures_to_stream.pop ();
+
+  shutting_down = true;
+
+  TBF_CancelTexturePackBuild ();
+  TBF_StopInjectWatch        ();
+
+  tex_mgr.reset ();
+
+  if (io_stage != nullptr)
+  {
+    delete io_stage;
+           io_stage = nullptr;
+  }
+
+  TBF_CloseTexturePacks ();
+
+  dump_queue.shutdown ();
+  dump_pack.close     ();
+
+  TBF_ShutdownScreenshots ();
+
+  if (config.textures.predictive_prefetch || config.textures.warm_start)
+  {
+    tex_log->Log ( L"[ Prefetch ] Staged sources used: %li, wasted: %li",
+                     source_stager.numHits   (),
+                     source_stager.numWasted () );
+  }
+
+  if (config.textures.predictive_prefetch)
+  {
+    // For training and evaluating the model offline (tools/usage_model)
+    usage_model.appendSession (TBFIX_USAGE_TRACE_FILE);
+
+    usage_model.commitSession ();
+    usage_model.save          (TBFIX_USAGE_MODEL_FILE);
+  }
+
+  source_stager.shutdown ();
+
+  TBF_StopResidentPool  ();
+  resident_pool.release ();
+
+  if (config.textures.adaptive_loading)
+  {
+    tex_log->Log ( L"[Inject Tex] Adaptive loading: %lu loads upgraded to blocking, %lu downgraded to streaming",
+                     (unsigned long)load_classifier.numUpgraded   (),
+                     (unsigned long)load_classifier.numDowngraded () );
+
+    load_classifier.commitSession ();
+    load_classifier.save          (TBFIX_LOAD_STATS_FILE);
+  }
+
+  DeleteCriticalSection (&cs_tex_stream);
+  DeleteCriticalSection (&cs_tex_resample);
+#ifdef NO_TLS
+  DeleteCriticalSection (&cs_tex_inject);
+#endif
+
+  DeleteCriticalSection (&cs_cache);
+  DeleteCriticalSection (&osd_cs);
+
+  CloseHandle (decomp_semaphore);
+
+  tex_log->Log ( L"[Perf Stats] At shutdown: %7.2f seconds (%7.2f frames)"
+                 L" saved by cache",
+                   time_saved / 1000.0f,
+                     time_saved / frame_time );
+  tex_log->close ();
+
+  while (! screenshots_to_delete.empty ())
+  {
+    std::wstring file_to_delete = screenshots_to_delete.front ();
+    screenshots_to_delete.pop ();
+
+    DeleteFileW (file_to_delete.c_str ());
+  }
+
+  FreeLibrary (d3dx9_43_dll);
+}
+
+void
+tbf::RenderFix::TextureManager::purge (void)
+{
+  if (shutting_down)
+    return;
+
+  int      released           = 0;
+  int      released_injected  = 0;
+   int64_t reclaimed          = 0;
+   int64_t reclaimed_injected = 0;
+
+  tex_log->Log (L"[ Tex. Mgr ] -- TextureManager::purge (...) -- ");
+
+  // Purge any pending removes
+  getTexture (0);
+
+  tex_log->Log ( L"[ Tex. Mgr ]  ***  Current Cache Size: %6.2f MiB "
+                                           L"(User Limit: %6.2f MiB)",
+                   (double)cacheSizeTotal () / (1024.0 * 1024.0),
+                     (double)config.textures.max_cache_in_mib );
+
+  tex_log->Log (L"[ Tex. Mgr ]   Releasing textures...");
+
+  std::unordered_map <uint32_t, tbf::RenderFix::Texture *>::iterator it =
+    textures.begin ();
+
+  std::vector <tbf::RenderFix::Texture *> unreferenced_textures;
+
+  while (it != textures.end ()) {
+    if ((*it).second->d3d9_tex->can_free)
+      unreferenced_textures.push_back ((*it).second);
+
+    ++it;
+  }
+
+  std::sort ( unreferenced_textures.begin (),
+                unreferenced_textures.end (),
+      []( tbf::RenderFix::Texture *a,
+          tbf::RenderFix::Texture *b )
+    {
+      return a->d3d9_tex->last_used <
+             b->d3d9_tex->last_used;
+    }
+  );
+
+  std::vector <tbf::RenderFix::Texture *>::iterator free_it =
+    unreferenced_textures.begin ();
+
+  // We need to over-free, or we will likely be purging every other texture load
+  int64_t target_size =
+    std::max (128, config.textures.max_cache_in_mib - 64) * 1024LL * 1024LL;
+  int64_t start_size =
+    cacheSizeTotal ();
+
+  while ( start_size - reclaimed > target_size &&
+            free_it != unreferenced_textures.end () ) {
+    int             tex_refs = -1;
+    ISKTextureD3D9* pSKTex   = (*free_it)->d3d9_tex;
+
+    //
+    // Skip loads that are in-flight so that we do not hitch
+    //
+    if (is_streaming ((*free_it)->crc32)) {
+      ++free_it;
+      continue;
+    }
+
+    //
+    // Do not evict blocking loads, they are generally small and
+    //   will cause performance problems if we have to reload them
+    //     again later.
+    //
+    if (pSKTex->must_block) {
+      ++free_it;
+      continue;
+    }
+
+    int64_t ovr_size  = 0;
+    int64_t base_size = 0;
+
+    ++free_it;
+
+    base_size = pSKTex->tex_size;
+    ovr_size  = pSKTex->override_size;
+    tex_refs  = pSKTex->Release ();
+
+    if (tex_refs == 0) {
+      if (ovr_size != 0) {
+        reclaimed += ovr_size;
+
+        released_injected++;
+        reclaimed_injected += ovr_size;
+      }
+    } else {
+      tex_log->Log (L"[ Tex. Mgr ] Invalid reference count (%lu)!", tex_refs);
+    }
+
+    ++released;
+    reclaimed  += base_size;
+  }
+
+  tex_log->Log ( L"[ Tex. Mgr ]   %4d textures (%4zu remain)",
+                   released,
+                     textures.size () );
+
+  tex_log->Log ( L"[ Tex. Mgr ]   >> Reclaimed %6.2f MiB of memory (%6.2f MiB from %lu inject)",
+                   (double)reclaimed        / (1024.0 * 1024.0),
+                   (double)reclaimed_injected / (1024.0 * 1024.0),
+                           released_injected );
+
+  updateOSD ();
+
+  tex_log->Log (L"[ Tex. Mgr ] ----------- Finished ------------ ");
+}
+
+void
+tbf::RenderFix::TextureManager::reset (void)
+{
+  known.render_targets.clear ();
+
+  int underflows       = 0;
+
+  int ext_refs         = 0;
+  int ext_textures     = 0;
+
+  int release_count    = 0;
+  int unreleased_count = 0;
+  int ref_count        = 0;
+
+  int      released_injected  = 0;
+  uint64_t reclaimed          = 0;
+  uint64_t reclaimed_injected = 0;
+
+  tex_log->Log (L"[ Tex. Mgr ] -- TextureManager::reset (...) -- ");
+
+  // A capture still waiting to be read back is in D3DPOOL_DEFAULT
+  void TBF_ReleaseScreenshotReadback (void);
+  TBF_ReleaseScreenshotReadback ();
+
+  // Purge any pending removes
+  getTexture (0);
+
+  tex_log->Log (L"[ Tex. Mgr ]   Releasing textures...");
+
+  std::unordered_map <uint32_t, tbf::RenderFix::Texture *>::iterator it =
+    textures.begin ();
+
+  while (it != textures.end ()) {
+    ISKTextureD3D9* pSKTex =
+      (*it).second->d3d9_tex;
+
+    ++it;
+
+    bool    can_free  = false;
+    int64_t base_size = 0;
+    int64_t ovr_size  = 0;
+
+    if (pSKTex->can_free) {
+      can_free = true;
+      base_size = pSKTex->tex_size;
+      ovr_size  = pSKTex->override_size;
+    }
+
+    else {
+      ext_refs     += pSKTex->refs;
+      ext_textures ++;
+
+      ++unreleased_count;
+      continue;
+    }
+
+    int tex_refs = pSKTex->Release ();
+
+    if (tex_refs == 0) {
+      if (ovr_size != 0) {
+        reclaimed += ovr_size;
+
+        released_injected++;
+        reclaimed_injected += ovr_size;
+      }
+
+      ++release_count;
+      reclaimed += base_size;
+
+      ref_count += 1;
+    }
+
+    else {
+      ++unreleased_count;
+      ext_refs     += tex_refs;
+      ext_textures ++;
+    }
+  }
+
+  tex_log->Log ( L"[ Tex. Mgr ]   %4d textures (%4d references)",
+                   release_count + unreleased_count,
+                     ref_count + ext_refs );
+
+  if (ext_refs > 0) {
+    tex_log->Log ( L"[ Tex. Mgr ] >> WARNING: The game is still holding references (%d) to %d textures !!!",
+                     ext_refs, ext_textures );
+  }
+
+  tex_log->Log ( L"[ Mem. Mgr ] === Memory Management Summary ===");
+
+  tex_log->Log ( L"[ Mem. Mgr ]  %12.2f MiB Freed",
+                   (double)reclaimed         / (1048576.0) );
+  tex_log->Log ( L"[ Mem. Mgr ]  %12.2f MiB Leaked",
+                   (double)(cacheSizeTotal () - reclaimed)
+                                            / (1048576.0) );
+
+  updateOSD ();
+
+  // Commit this immediately, such that D3D9 Reset will not fail in
+  //   fullscreen mode...
+  TBFix_LoadQueuedTextures ();
+  purge                    ();
+
+  tex_log->Log (L"[ Tex. Mgr ] ----------- Finished ------------ ");
+}
+
+void
+tbf::RenderFix::TextureManager::updateOSD (void)
+{
+  double cache_basic    = (double)cacheSizeBasic    () / (1048576.0f);
+  double cache_injected = (double)cacheSizeInjected () / (1048576.0f);
+  double cache_total    = cache_basic + cache_injected;
+
+  osd_stats = "";
+
+  char szFormatted [64];
+  sprintf ( szFormatted, "%6zu Total Textures : %8.2f MiB",
+              numTextures () + numInjectedTextures (),
+                cache_total );
+  osd_stats += szFormatted;
+
+  if ( tbf::RenderFix::pDevice != nullptr &&
+       tbf::RenderFix::pDevice->GetAvailableTextureMem () / 1048576UL != 4095)
+    sprintf ( szFormatted, "    (%4lu MiB Available)\n",
+              tbf::RenderFix::pDevice->GetAvailableTextureMem () 
+                / 1048576UL );
+  else
+    sprintf (szFormatted, "\n");
+
+  osd_stats += szFormatted;
+
+  sprintf ( szFormatted, "%6zu  Base Textures : %8.2f MiB    %s\n",
+              numTextures (),
+                cache_basic,
+                  __remap_textures ? "" : "<----" );
+
+  osd_stats += szFormatted;
+
+  sprintf ( szFormatted, "%6lu   New Textures : %8.2f MiB    %s\n",
+              numInjectedTextures (),
+                cache_injected,
+                  __remap_textures ? "<----" : "" );
+
+  osd_stats += szFormatted;
+
+  sprintf ( szFormatted, "%6lu Cache Hits     : %8.2f Seconds Saved",
+              hits,
+                time_saved / 1000.0f );
+
+  osd_stats += szFormatted;
+
+  if (debug_tex_id != 0x00) {
+    osd_stats += "\n\n";
+
+    sprintf ( szFormatted, " Debug Texture : %08x",
+                debug_tex_id );
+
+    osd_stats += szFormatted;
+  }
+}
+
+std::vector <uint32_t> textures_used_last_dump;
+             uint32_t  tex_dbg_idx              = 0UL;
+
+//
+// Records which injectable textures are used this session (for the next
+//   warm start) and stages the ones that usually follow a first use.
+//
+static void
+TBF_LearnTextureUsage (void)
+{
+  static uint32_t               frame = 0UL;
+  static std::vector <uint32_t> predicted;
+
+  ++frame;
+
+  for ( auto&& it : textures_used )
+  {
+    if (! injectable_textures.count (it))
+      continue;
+
+    if (config.textures.warm_start)
+      warm_start.use (it, frame);
+
+    if ( (! config.textures.predictive_prefetch) ||
+         (! usage_model.firstUse (it, frame)) )
+      continue;
+
+    predicted.clear ();
+    usage_model.predict (it, predicted);
+
+    for ( auto next : predicted )
+    {
+      // Cached textures are never injected again
+      if (tbf::RenderFix::tex_mgr.getTexture (next) != nullptr)
+        continue;
+
+      tbf_stage_request_s req;
+
+      if (TBF_MakeStageRequest (next, req))
+        source_stager.request (req);
+    }
+  }
+}
+
+void
+TBFix_LogUsedTextures (void)
+{
+  if (__log_used)
+  {
+    textures_used_last_dump.clear ();
+    tex_dbg_idx = 0;
+
+    tex_log->Log (L"[ Tex. Log ] ---------- FrameTrace ----------- ");
+
+    for ( auto&& it  : textures_used ) {
+      auto tex_record =
+        tbf::RenderFix::tex_mgr.getTexture (it);
+
+      // Handle the RARE case where a purge happens immediately following
+      //   the last frame
+      if ( tex_record           != nullptr &&
+           tex_record->d3d9_tex != nullptr )
+      {
+        ISKTextureD3D9* pSKTex =
+          (ISKTextureD3D9 *)tex_record->d3d9_tex;
+
+        textures_used_last_dump.push_back (it);
+
+        tex_log->Log ( L"[ Tex. Log ] %08x.dds  { Base: %6.2f MiB,  "
+                       L"Inject: %6.2f MiB,  Load Time: %8.3f ms }",
+                         it,
+                           (double)pSKTex->tex_size /
+                             (1024.0 * 1024.0),
+
+                     pSKTex->override_size != 0 ? 
+                       (double)pSKTex->override_size / 
+                             (1024.0 * 1024.0) : 0.0,
+
+                           tbf::RenderFix::tex_mgr.getTexture (it)->load_time );
+      }
+    }
+
+    tex_log->Log (L"[ Tex. Log ] ---------- FrameTrace ----------- ");
+
+    __log_used = false;
+  }
+
+  if (config.textures.predictive_prefetch || config.textures.warm_start)
+    TBF_LearnTextureUsage ();
+
+  textures_used.clear ();
+
+  ++texture_frame;
+}
+
+
+CRITICAL_SECTION        SK_TextureWorkerThread::cs_worker_init;
+ULONG                   SK_TextureWorkerThread::num_threads_init = 0UL;
+
+HRESULT
+WINAPI
+ResampleTexture (tbf_tex_load_s* load)
+{
+  QueryPerformanceFrequency (&load->freq);
+  QueryPerformanceCounter   (&load->start);
+
+  D3DXIMAGE_INFO img_info = { };
+
+  D3DXGetImageInfoFromFileInMemory (
+    load->pSrcData,
+      load->SrcDataSize,
+        &img_info );
+
+  HRESULT hr = E_FAIL;
+
+  if (img_info.Depth == 1)
+  {
+    hr =
+    D3DXCreateTextureFromFileInMemoryEx_Original (
+      load->pDevice,
+          load->pSrcData, load->SrcDataSize,
+            img_info.Width, img_info.Height, 0,
+              0, config.textures.uncompressed ? D3DFMT_A8R8G8B8 : img_info.Format,
+                D3DPOOL_DEFAULT,
+                  D3DX_FILTER_TRIANGLE | D3DX_FILTER_DITHER,
+                  D3DX_FILTER_BOX      | D3DX_FILTER_DITHER,
+                    0,
+                      nullptr, nullptr,
+                        &load->pSrc );
+  }
+
+  else
+  {
+    tex_log->Log (L"[ Tex. Mgr ] Will not resample cubemap...");
+  }
+
+  delete [] load->pSrcData;
+
+  return hr;
+}
+
+unsigned int
+__stdcall
+SK_TextureWorkerThread::ThreadProc (LPVOID user)
+{
+  EnterCriticalSection (&cs_worker_init);
+  {
+    DWORD dwThreadId = GetCurrentThreadId ();
+
+    if (! streaming_memory::data_len.count (dwThreadId))
+    {
+      streaming_memory::data_len [dwThreadId] = 0;
+      streaming_memory::data     [dwThreadId] = nullptr;
+      streaming_memory::data_age [dwThreadId] = 0;
+    }
+  }
+  LeaveCriticalSection (&cs_worker_init);
+
+  SYSTEM_INFO sysinfo;
+  GetSystemInfo (&sysinfo);
 
-  command.AddVariable (
-    "Textures.Trace",
-      TBF_CreateVar (SK_IVariable::Boolean, &__log_used) );
+  ULONG thread_num    = InterlockedIncrement (&num_threads_init);
 
-  command.AddVariable (
-    "Textures.ShowCache",
-      TBF_CreateVar (SK_IVariable::Boolean, &__show_cache) );
+  // If a system has more than 4 CPUs (logical or otherwise), let the last one
+  //   be dedicated to rendering.
+  ULONG processor_num = thread_num % ( sysinfo.dwNumberOfProcessors > 4 ?
+                                         sysinfo.dwNumberOfProcessors - 1 :
+                                         sysinfo.dwNumberOfProcessors );
 
-  command.AddVariable (
-    "Textures.MaxCacheSize",
-      TBF_CreateVar (SK_IVariable::Int,     &config.textures.max_cache_in_mib) );
+  // Tales of Symphonia and Zestiria both pin the render thread to the last
+  //   CPU... let's try to keep our worker threads OFF that CPU.
+
+  SetThreadIdealProcessor (GetCurrentThread (),         processor_num);
+  SetThreadAffinityMask   (GetCurrentThread (), (1UL << processor_num) & 0xFFFFFFFF);
+
+  // Ghetto sync. barrier, since Windows 7 does not support them...
+  while ( InterlockedCompareExchange (
+            &num_threads_init,
+              config.textures.worker_threads * 3,
+                config.textures.worker_threads * 3
+          ) < (ULONG)config.textures.worker_threads * 3 )
+  {
+    SwitchToThread ();
+  }
+
+  SK_TextureWorkerThread* pThread =
+   (SK_TextureWorkerThread *)user;
+
+  DWORD dwWaitStatus = 0;
+
+  struct {
+    const DWORD job_start  = WAIT_OBJECT_0;
+    const DWORD mem_trim   = WAIT_OBJECT_0 + 1;
+    const DWORD thread_end = WAIT_OBJECT_0 + 2;
+  } wait;
+
+  do {
+    dwWaitStatus =
+      WaitForMultipleObjects ( 3,
+                                 pThread->control_.ops,
+                                   FALSE,
+                                     INFINITE );
+
+    // New Work Ready
+    if (dwWaitStatus == wait.job_start) {
+      tbf_tex_load_s* pStream = 
+        (tbf_tex_load_s *)InterlockedCompareExchangePointer ((PVOID *)&pThread->job_, nullptr, nullptr);
+
+      start_load ();
+      {
+        if (pStream->type == tbf_tex_load_s::Resample)
+        {
+          InterlockedIncrement      (&resampling);
+
+          QueryPerformanceFrequency (&pStream->freq);
+          QueryPerformanceCounter   (&pStream->start);
+
+          HRESULT hr =
+            ResampleTexture (pStream);
+
+          QueryPerformanceCounter   (&pStream->end);
+
+          InterlockedDecrement      (&resampling);
+
+          if (SUCCEEDED (hr))
+            pThread->pool_->postFinished (pStream);
+
+          else {
+            tex_log->Log ( L"[ Tex. Mgr ] Texture Resample Failure (hr=%x) for texture %x, blacklisting from future resamples...",
+                             hr, pStream->checksum );
+            resample_blacklist.emplace (pStream->checksum);
+
+            pStream->pDest->Release ();
+            pStream->pSrc = pStream->pDest;
+
+            ((ISKTextureD3D9 *)pStream->pSrc)->must_block = false;
+            ((ISKTextureD3D9 *)pStream->pSrc)->refs--;
+
+            finished_streaming (pStream->checksum);
+          }
+
+          pThread->finishJob ();
+        }
+
+        else
+        {
+          InterlockedIncrement        (&streaming);
+          InterlockedExchangeAdd      (&streaming_bytes, pStream->SrcDataSize);
+
+          QueryPerformanceFrequency   (&pStream->freq);
+          QueryPerformanceCounter     (&pStream->start);
+
+          HRESULT hr =
+            InjectTexture (pStream);
+
+          QueryPerformanceCounter     (&pStream->end);
+
+          InterlockedExchangeSubtract (&streaming_bytes, pStream->SrcDataSize);
+          InterlockedDecrement        (&streaming);
+
+          if (SUCCEEDED (hr))
+            pThread->pool_->postFinished (pStream);
+
+          else
+          {
+            HRESULT hr = S_OK;
+            tex_log->Log ( L"[ Tex. Mgr ] Texture Injection Failure (hr=%x) for texture %x, removing from injectable list...",
+              hr, pStream->checksum);
+            if (injectable_textures.count (pStream->checksum))
+              injectable_textures.erase (pStream->checksum);
+
+            pStream->pDest->Release ();
+            pStream->pSrc = pStream->pDest;
+
+            ((ISKTextureD3D9 *)pStream->pSrc)->must_block = false;
+            ((ISKTextureD3D9 *)pStream->pSrc)->refs--;
+
+            finished_streaming (pStream->checksum);
+          }
+
+          pThread->finishJob ();
+        }
+      }
+      end_load ();
+
+    }
+
+    else if (dwWaitStatus == (wait.mem_trim))
+    {
+      // Yay for magic numbers :P   ==> (8 MiB Min Size, 5 Seconds Between Trims)
+      //
+      const size_t   MIN_SIZE = 8192 * 1024;
+      const uint32_t MIN_AGE  = 5000UL;
+
+      size_t before = streaming_memory::data_len [GetCurrentThreadId ()];
+
+      streaming_memory::trim (MIN_SIZE, timeGetTime () - MIN_AGE);
+
+      size_t now    =  streaming_memory::data_len [GetCurrentThreadId ()];
+
+      if (before != now)
+      {
+        tex_log->Log ( L"[ Mem. Mgr ]  Trimmed %9lzu bytes of temporary memory for tid=%x",
+                         before - now,
+                           GetCurrentThreadId () );
+      }
+    }
+
+    else if (dwWaitStatus != (wait.thread_end))
+    {
+      dll_log->Log ( L"[ Tex. Mgr ] Unexpected Worker Thread Wait Status: %X",
+                       dwWaitStatus );
+    }
+  } while (dwWaitStatus != (wait.thread_end));
+
+  streaming_memory::trim (0, timeGetTime ());
+
+  //CloseHandle (GetCurrentThread ());
+  return 0;
 }
 
-void
-tbf::RenderFix::TextureManager::Hook (void)
+unsigned int
+__stdcall
+SK_TextureThreadPool::Spooler (LPVOID user)
 {
-  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
-                       "D3D9SetRenderState_Override",
-                        D3D9SetRenderState_Detour,
-              (LPVOID*)&D3D9SetRenderState );
+  SK_TextureThreadPool* pPool =
+    (SK_TextureThreadPool *)user;
 
-  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
-                       "D3D9BeginScene_Override",
-                        D3D9BeginScene_Detour,
-              (LPVOID*)&D3D9BeginScene );
+  WaitForSingleObject (pPool->events_.jobs_added, INFINITE);
 
-  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
-                       "D3D9StretchRect_Override",
-                        D3D9StretchRect_Detour,
-              (LPVOID*)&D3D9StretchRect );
+  while (WaitForSingleObject (pPool->events_.shutdown, 0) == WAIT_TIMEOUT) {
+    tbf_tex_load_s* pJob =
+      pPool->getNextJob ();
 
-  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
-                       "D3D9CreateRenderTarget_Override",
-                        D3D9CreateRenderTarget_Detour,
-              (LPVOID*)&D3D9CreateRenderTarget );
+    while (pJob != nullptr)
+    {
+      // Alternate the direction we look for idle workers to reduce
+      //   starvation (important since each thread is pinned to one CPU).
+      static int direction = 1;
+      bool       started   = false;
 
-  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
-                       "D3D9CreateDepthStencilSurface_Override",
-                        D3D9CreateDepthStencilSurface_Detour,
-              (LPVOID*)&D3D9CreateDepthStencilSurface );
+      if (direction > 0)
+      {
+        auto it = pPool->workers_.begin ();
 
-  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
-                       "D3D9CreateTexture_Override",
-                        D3D9CreateTexture_Detour,
-              (LPVOID*)&D3D9CreateTexture );
+        while (it != pPool->workers_.end ()) {
+          if (! (*it)->isBusy ()) {
+            if (! started) {
+              (*it)->startJob (pJob);
+              started = true;
+            } else {
+              (*it)->trim ();
+            }
+          }
 
-  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
-                       "D3D9SetTexture_Override",
-                        D3D9SetTexture_Detour,
-              (LPVOID*)&D3D9SetTexture );
+          ++it;
+        }
+      }
 
-  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
-                       "D3D9SetRenderTarget_Override",
-                        D3D9SetRenderTarget_Detour,
-              (LPVOID*)&D3D9SetRenderTarget );
+      else
+      {
+        auto it = pPool->workers_.rbegin ();
 
-  TBF_CreateDLLHook2 ( config.system.injector.c_str (),
-                       "D3D9SetDepthStencilSurface_Override",
-                        D3D9SetDepthStencilSurface_Detour,
-              (LPVOID*)&D3D9SetDepthStencilSurface );
+        while (it != pPool->workers_.rend ()) {
+          if (! (*it)->isBusy ()) {
+            if (! started) {
+              (*it)->startJob (pJob);
+              started = true;
+            } else {
+              (*it)->trim ();
+            }
+          }
 
-  TBF_CreateDLLHook2 ( L"D3DX9_43.DLL",
-                        "D3DXCreateTextureFromFileInMemoryEx",
-                         D3DXCreateTextureFromFileInMemoryEx_Detour,
-              (LPVOID *)&D3DXCreateTextureFromFileInMemoryEx_Original );
+          ++it;
+        }
+      }
 
-  D3DXSaveTextureToFile =
-    (D3DXSaveTextureToFile_pfn)
-      GetProcAddress ( tbf::RenderFix::d3dx9_43_dll,
-                         "D3DXSaveTextureToFileW" );
+      direction = -direction;
 
-  D3DXSaveSurfaceToFileW =
-    (D3DXSaveSurfaceToFile_pfn)
-      GetProcAddress ( tbf::RenderFix::d3dx9_43_dll,
-                         "D3DXSaveSurfaceToFileW" );
+      // All worker threads are busy, so wait...
+      if (! started)
+      {
+        WaitForSingleObject (pPool->events_.results_waiting, INFINITE);
+      } else {
+        pJob =
+          pPool->getNextJob ();
+      }
+    }
 
-  D3DXCreateTextureFromFile =
-    (D3DXCreateTextureFromFile_pfn)
-      GetProcAddress ( tbf::RenderFix::d3dx9_43_dll,
-                         "D3DXCreateTextureFromFileW" );
+    const int MAX_TIME_BETWEEN_TRIMS = 1500UL;
+    while ( WaitForSingleObject (
+              pPool->events_.jobs_added,
+                MAX_TIME_BETWEEN_TRIMS ) ==
+                               WAIT_TIMEOUT ) {
+      auto it = pPool->workers_.begin ();
 
-  D3DXCreateTextureFromFileEx =
-    (D3DXCreateTextureFromFileEx_pfn)
-      GetProcAddress ( tbf::RenderFix::d3dx9_43_dll,
-                         "D3DXCreateTextureFromFileExW" );
+      while (it != pPool->workers_.end ()) {
+        if (! (*it)->isBusy ()) {
+          (*it)->trim ();
+        }
 
-  D3DXGetImageInfoFromFileInMemory =
-    (D3DXGetImageInfoFromFileInMemory_pfn)
-      GetProcAddress ( tbf::RenderFix::d3dx9_43_dll,
-                         "D3DXGetImageInfoFromFileInMemory" );
+        ++it;
+      }
+    }
+  }
 
-  D3DXGetImageInfoFromFile =
-    (D3DXGetImageInfoFromFile_pfn)
-      GetProcAddress ( tbf::RenderFix::d3dx9_43_dll,
-                         "D3DXGetImageInfoFromFileW" );
+  //CloseHandle (GetCurrentThread ());
+  return 0;
 }
 
-// Skip the purge step on shutdown
-bool shutting_down = false;
-
 void
-tbf::RenderFix::TextureManager::Shutdown (void)
+SK_TextureWorkerThread::finishJob (void)
 {
-  // It is possible for the DLL to be unloaded before the texture manager is
-  //   initialized, in which case a nullptr value for tex_log is the easiest
-  //     way to detect this.
-  if (tex_log == nullptr)
-    return;
+  InterlockedExchangeAdd     (&bytes_loaded_,
+           ((tbf_tex_load_s *)InterlockedCompareExchangePointer ((PVOID *)&job_, nullptr, nullptr))
+                             ->SrcDataSize);
+  InterlockedIncrement       (&jobs_retired_);
+  InterlockedExchangePointer ((PVOID *)&job_, nullptr);
+}
+HMODULE tbf::RenderFix::d3dx9_43_dll = 0;
 
-  // 16.6 ms per-frame (60 FPS)
-  const float frame_time = 16.6f;
 
-  while (! textures_to_stream.empty ())
-    textures_to_stream.pop ();
 
-  shutting_down = true;
 
-  tex_mgr.reset ();
+// Texture entries of every .7z archive as of the last scan, see archive_manifest.h
+#define TBFIX_MANIFEST_FILE    TBFIX_TEXTURE_DIR L"\\inject\\archives.manifest"
 
-  DeleteCriticalSection (&cs_tex_stream);
-  DeleteCriticalSection (&cs_tex_resample);
-#ifdef NO_TLS
-  DeleteCriticalSection (&cs_tex_inject);
-#endif
+//
+// Reads the header of a single archive and records every texture it contains;
+//   this is safe to run concurrently as long as each call has its own scan.
+//
+static void
+TBF_ScanTextureArchive (tbf_archive_scan_s* scan)
+{
+  CFileInStream arc_stream;
 
-  DeleteCriticalSection (&cs_cache);
-  DeleteCriticalSection (&osd_cs);
+  std::unique_ptr <CLookToRead>
+                look_stream (new CLookToRead ());
 
-  CloseHandle (decomp_semaphore);
+  FileInStream_CreateVTable (&arc_stream);
+  LookToRead_CreateVTable   (look_stream.get (), False);
 
-  tex_log->Log ( L"[Perf Stats] At shutdown: %7.2f seconds (%7.2f frames)"
-                 L" saved by cache",
-                   time_saved / 1000.0f,
-                     time_saved / frame_time );
-  tex_log->close ();
+  look_stream->realStream = &arc_stream.s;
+  LookToRead_Init           (look_stream.get ());
 
-  while (! screenshots_to_delete.empty ())
-  {
-    std::wstring file_to_delete = screenshots_to_delete.front ();
-    screenshots_to_delete.pop ();
+  CSzArEx       arc;
+  ISzAlloc      thread_alloc;
+  ISzAlloc      thread_tmp_alloc;
 
-    DeleteFileW (file_to_delete.c_str ());
-  }
+  thread_alloc.Alloc     = SzAlloc;
+  thread_alloc.Free      = SzFree;
 
-  FreeLibrary (d3dx9_43_dll);
-}
+  thread_tmp_alloc.Alloc = SzAllocTemp;
+  thread_tmp_alloc.Free  = SzFreeTemp;
 
-void
-tbf::RenderFix::TextureManager::purge (void)
-{
-  if (shutting_down)
+  if (InFile_OpenW (&arc_stream.file, scan->path.c_str ()))
     return;
 
-  int      released           = 0;
-  int      released_injected  = 0;
-   int64_t reclaimed          = 0;
-   int64_t reclaimed_injected = 0;
-
-  tex_log->Log (L"[ Tex. Mgr ] -- TextureManager::purge (...) -- ");
-
-  // Purge any pending removes
-  getTexture (0);
-
-  tex_log->Log ( L"[ Tex. Mgr ]  ***  Current Cache Size: %6.2f MiB "
-                                           L"(User Limit: %6.2f MiB)",
-                   (double)cacheSizeTotal () / (1024.0 * 1024.0),
-                     (double)config.textures.max_cache_in_mib );
-
-  tex_log->Log (L"[ Tex. Mgr ]   Releasing textures...");
+  SzArEx_Init (&arc);
 
-  std::unordered_map <uint32_t, tbf::RenderFix::Texture *>::iterator it =
-    textures.begin ();
+  if ( SzArEx_Open ( &arc,
+                       &look_stream->s,
+                         &thread_alloc,
+                           &thread_tmp_alloc ) == SZ_OK )
+  {
+    uint32_t i;
 
-  std::vector <tbf::RenderFix::Texture *> unreferenced_textures;
+    wchar_t wszEntry [MAX_PATH];
 
-  while (it != textures.end ()) {
-    if ((*it).second->d3d9_tex->can_free)
-      unreferenced_textures.push_back ((*it).second);
+    for (i = 0; i < arc.NumFiles; i++)
+    {
+      if (SzArEx_IsDir (&arc, i))
+        continue;
 
-    ++it;
-  }
+      if (SzArEx_GetFileNameUtf16 (&arc, i, nullptr) > MAX_PATH)
+        continue;
 
-  std::sort ( unreferenced_textures.begin (),
-                unreferenced_textures.end (),
-      []( tbf::RenderFix::Texture *a,
-          tbf::RenderFix::Texture *b )
-    {
-      return a->d3d9_tex->last_used.QuadPart <
-             b->d3d9_tex->last_used.QuadPart;
-    }
-  );
+      SzArEx_GetFileNameUtf16 (&arc, i, (UInt16 *)wszEntry);
 
-  std::vector <tbf::RenderFix::Texture *>::iterator free_it =
-    unreferenced_textures.begin ();
+      // Truncate to 32-bits --> there's no way in hell a texture will ever be >= 2 GiB
+      size_t fileSize = SzArEx_GetFileSize (&arc, i);
 
-  // We need to over-free, or we will likely be purging every other texture load
-  int64_t target_size =
-    std::max (128, config.textures.max_cache_in_mib - 64) * 1024LL * 1024LL;
-  int64_t start_size =
-    cacheSizeTotal ();
+      wchar_t* wszFullName =
+        _wcslwr (_wcsdup (wszEntry));
 
-  while ( start_size - reclaimed > target_size &&
-            free_it != unreferenced_textures.end () ) {
-    int             tex_refs = -1;
-    ISKTextureD3D9* pSKTex   = (*free_it)->d3d9_tex;
+      if ( wcsstr ( wszFullName, TBFIX_TEXTURE_EXT) )
+      {
+        tbf_load_method_t method = DontCare;
 
-    //
-    // Skip loads that are in-flight so that we do not hitch
-    //
-    if (is_streaming ((*free_it)->crc32)) {
-      ++free_it;
-      continue;
-    }
+        uint32_t checksum;
+        wchar_t* wszUnqualifiedEntry =
+          wszFullName + wcslen (wszFullName);
 
-    //
-    // Do not evict blocking loads, they are generally small and
-    //   will cause performance problems if we have to reload them
-    //     again later.
-    //
-    if (pSKTex->must_block) {
-      ++free_it;
-      continue;
-    }
+        // Strip the path
+        while (  wszUnqualifiedEntry >= wszFullName &&
+                *wszUnqualifiedEntry != L'/')
+          wszUnqualifiedEntry--;
 
-    int64_t ovr_size  = 0;
-    int64_t base_size = 0;
+        if (*wszUnqualifiedEntry == L'/')
+          ++wszUnqualifiedEntry;
 
-    ++free_it;
+        swscanf (wszUnqualifiedEntry, L"%x" TBFIX_TEXTURE_EXT, &checksum);
 
-    base_size = pSKTex->tex_size;
-    ovr_size  = pSKTex->override_size;
-    tex_refs  = pSKTex->Release ();
+        if (wcsstr (wszFullName, L"streaming"))
+          method = Streaming;
+        else if (wcsstr (wszFullName, L"blocking"))
+          method = Blocking;
 
-    if (tex_refs == 0) {
-      if (ovr_size != 0) {
-        reclaimed += ovr_size;
+        tbf_archive_entry_s entry;
+        entry.checksum = checksum;
+        entry.fileno   = i;
+        entry.size     = (uint32_t)fileSize;
+        entry.method   = method;
 
-        released_injected++;
-        reclaimed_injected += ovr_size;
+        scan->entries.push_back (entry);
       }
-    } else {
-      tex_log->Log (L"[ Tex. Mgr ] Invalid reference count (%lu)!", tex_refs);
+
+      free (wszFullName);
     }
 
-    ++released;
-    reclaimed  += base_size;
+    scan->valid = true;
   }
 
-  tex_log->Log ( L"[ Tex. Mgr ]   %4d textures (%4zu remain)",
-                   released,
-                     textures.size () );
+  SzArEx_Free (&arc, &thread_alloc);
+  File_Close  (&arc_stream.file);
+}
 
-  tex_log->Log ( L"[ Tex. Mgr ]   >> Reclaimed %6.2f MiB of memory (%6.2f MiB from %lu inject)",
-                   (double)reclaimed        / (1024.0 * 1024.0),
-                   (double)reclaimed_injected / (1024.0 * 1024.0),
-                           released_injected );
+struct tbf_archive_scan_job_s {
+  std::vector <tbf_archive_scan_s*>* work;
+  volatile LONG                      next;
+  HANDLE                             cancel; // Optional, stop early once signaled
+};
 
-  updateOSD ();
+static unsigned int
+__stdcall
+TBF_ArchiveScanThread (LPVOID user)
+{
+  tbf_archive_scan_job_s* job =
+    (tbf_archive_scan_job_s *)user;
 
-  tex_log->Log (L"[ Tex. Mgr ] ----------- Finished ------------ ");
-}
+  LONG idx;
 
-void
-tbf::RenderFix::TextureManager::reset (void)
-{
-  if (! outstanding_screenshots.empty ())
+  while ((idx = InterlockedIncrement (&job->next) - 1) < (LONG)job->work->size ())
   {
-    tex_log->LogEx (true, L"[Screenshot] A queued screenshot has not finished, delaying device reset...");
+    if ( job->cancel != nullptr &&
+         WaitForSingleObject (job->cancel, 0) == WAIT_OBJECT_0 )
+      break;
 
-    while (! outstanding_screenshots.empty ())
-      ;
-
-    tex_log->LogEx (false, L"done!\n");
+    TBF_ScanTextureArchive ((*job->work) [idx]);
   }
-  
 
-  known.render_targets.clear ();
+  return 0;
+}
 
-  int underflows       = 0;
+static void
+TBF_EnumerateLooseTextures ( const wchar_t*                                   wszPattern,
+                             tbf_load_method_t                                method,
+                             std::unordered_map <uint32_t, tbf_tex_record_s>& textures,
+                             int&                                             files,
+                             LARGE_INTEGER&                                   liSize )
+{
+  WIN32_FIND_DATA fd;
+  HANDLE          hFind = FindFirstFileW (wszPattern, &fd);
 
-  int ext_refs         = 0;
-  int ext_textures     = 0;
+  if (hFind == INVALID_HANDLE_VALUE)
+    return;
 
-  int release_count    = 0;
-  int unreleased_count = 0;
-  int ref_count        = 0;
+  do {
+    if (fd.dwFileAttributes != INVALID_FILE_ATTRIBUTES) {
+      if (wcsstr (_wcslwr (fd.cFileName), TBFIX_TEXTURE_EXT)) {
+        uint32_t checksum;
+        swscanf (fd.cFileName, L"%x" TBFIX_TEXTURE_EXT, &checksum);
 
-  int      released_injected  = 0;
-  uint64_t reclaimed          = 0;
-  uint64_t reclaimed_injected = 0;
+        // Already got this texture...
+        if (textures.count (checksum))
+            continue;
 
-  tex_log->Log (L"[ Tex. Mgr ] -- TextureManager::reset (...) -- ");
+        ++files;
 
-  // Purge any pending removes
-  getTexture (0);
+        LARGE_INTEGER fsize;
 
-  tex_log->Log (L"[ Tex. Mgr ]   Releasing textures...");
+        fsize.HighPart = fd.nFileSizeHigh;
+        fsize.LowPart  = fd.nFileSizeLow;
 
-  std::unordered_map <uint32_t, tbf::RenderFix::Texture *>::iterator it =
-    textures.begin ();
+        liSize.QuadPart += fsize.QuadPart;
 
-  while (it != textures.end ()) {
-    ISKTextureD3D9* pSKTex =
-      (*it).second->d3d9_tex;
+        tbf_tex_record_s rec;
+        rec.size    = (uint32_t)fsize.QuadPart;
+        rec.archive = std::numeric_limits <unsigned int>::max ();
+        rec.method  = method;
 
-    ++it;
+        textures.try_emplace (checksum, rec);
+      }
+    }
+  } while (FindNextFileW (hFind, &fd) != 0);
 
-    bool    can_free  = false;
-    int64_t base_size = 0;
-    int64_t ovr_size  = 0;
+  FindClose (hFind);
+}
 
-    if (pSKTex->can_free) {
-      can_free = true;
-      base_size = pSKTex->tex_size;
-      ovr_size  = pSKTex->override_size;
-    }
+//
+// Builds a complete index of every injectable texture; the result is written
+//   to the supplied containers rather than the live index so that it can also
+//     be used to stage changes from the source watcher thread.
+//
+//   Returns false if hCancel was signaled part-way through, in which case the
+//     index is incomplete and the manifest has not been touched.
+//
+static bool
+TBF_BuildInjectableIndex ( std::unordered_map <uint32_t, tbf_tex_record_s>& textures,
+                           std::vector        <std::wstring>&               arcs,
+                           HANDLE                                           hCancel = nullptr )
+{
+  EnterCriticalSection (&cs_inject_index);
 
-    else {
-      ext_refs     += pSKTex->refs;
-      ext_textures ++;
+  textures.clear ();
+  arcs.clear     ();
 
-      ++unreleased_count;
-      continue;
-    }
+  bool complete = true;
 
-    int tex_refs = pSKTex->Release ();
+  //
+  // Walk injectable textures so we don't have to query the filesystem on every
+  //   texture load to check if a injectable one exists.
+  //
+  if ( GetFileAttributesW (TBFIX_TEXTURE_DIR L"\\inject") !=
+         INVALID_FILE_ATTRIBUTES ) {
+    WIN32_FIND_DATA fd;
+    HANDLE          hFind  = INVALID_HANDLE_VALUE;
+    int             files  = 0;
+    LARGE_INTEGER   liSize = { 0 };
 
-    if (tex_refs == 0) {
-      if (ovr_size != 0) {
-        reclaimed += ovr_size;
+    tex_log->LogEx ( true, L"[Inject Tex] Enumerating injectable textures..." );
 
-        released_injected++;
-        reclaimed_injected += ovr_size;
-      }
+    TBF_EnumerateLooseTextures ( TBFIX_TEXTURE_DIR L"\\inject\\textures\\blocking\\*",
+                                   Blocking,  textures, files, liSize );
+    TBF_EnumerateLooseTextures ( TBFIX_TEXTURE_DIR L"\\inject\\textures\\streaming\\*",
+                                   Streaming, textures, files, liSize );
+    TBF_EnumerateLooseTextures ( TBFIX_TEXTURE_DIR L"\\inject\\textures\\*",
+                                   DontCare,  textures, files, liSize );
 
-      ++release_count;
-      reclaimed += base_size;
+    //
+    // Texture packs come before any .7z archive; they are cheap to index (the
+    //   index is sorted and uncompressed) so there is nothing to cache.
+    //
+    hFind = FindFirstFileW (TBFIX_TEXTURE_DIR L"\\inject\\*" TBF_PACK_EXT, &fd);
 
-      ref_count += 1;
-    }
+    if (hFind != INVALID_HANDLE_VALUE)
+    {
+      do
+      {
+        wchar_t wszQualifiedPackName [MAX_PATH];
+        _swprintf ( wszQualifiedPackName,
+                      L"%s\\inject\\%s",
+                        TBFIX_TEXTURE_DIR,
+                          fd.cFileName );
 
-    else {
-      ++unreleased_count;
-      ext_refs     += tex_refs;
-      ext_textures ++;
-    }
-  }
+        TBF_TexturePack pack;
 
-  tex_log->Log ( L"[ Tex. Mgr ]   %4d textures (%4d references)",
-                   release_count + unreleased_count,
-                     ref_count + ext_refs );
+        if (! pack.open (wszQualifiedPackName))
+        {
+          tex_log->Log ( L"[Inject Tex]  ** Cannot open texture pack: %s",
+                           wszQualifiedPackName );
+          continue;
+        }
 
-  if (ext_refs > 0) {
-    tex_log->Log ( L"[ Tex. Mgr ] >> WARNING: The game is still holding references (%d) to %d textures !!!",
-                     ext_refs, ext_textures );
-  }
+        int tex_count = 0;
 
-  tex_log->Log ( L"[ Mem. Mgr ] === Memory Management Summary ===");
+        for (uint32_t i = 0; i < pack.numEntries (); i++)
+        {
+          const tbf_pack_entry_s* entry =
+            pack.getEntry (i);
 
-  tex_log->Log ( L"[ Mem. Mgr ]  %12.2f MiB Freed",
-                   (double)reclaimed         / (1048576.0) );
-  tex_log->Log ( L"[ Mem. Mgr ]  %12.2f MiB Leaked",
-                   (double)(cacheSizeTotal () - reclaimed)
-                                            / (1048576.0) );
+          // Already got this texture...
+          if ( textures.count         (entry->checksum) ||
+               inject_blacklist.count (entry->checksum) )
+            continue;
 
-  updateOSD ();
+          tbf_tex_record_s rec;
+          rec.size    = entry->size;
+          rec.archive = (unsigned int)arcs.size ();
+          rec.fileno  = i;
+          rec.method  = (tbf_load_method_t)entry->method;
 
-  // Commit this immediately, such that D3D9 Reset will not fail in
-  //   fullscreen mode...
-  TBFix_LoadQueuedTextures ();
-  purge                    ();
+          textures.try_emplace (entry->checksum, rec);
 
-  tex_log->Log (L"[ Tex. Mgr ] ----------- Finished ------------ ");
-}
+          ++tex_count;
+          ++files;
 
-void
-tbf::RenderFix::TextureManager::updateOSD (void)
-{
-  double cache_basic    = (double)cacheSizeBasic    () / (1048576.0f);
-  double cache_injected = (double)cacheSizeInjected () / (1048576.0f);
-  double cache_total    = cache_basic + cache_injected;
+          liSize.QuadPart += rec.size;
+        }
 
-  osd_stats = "";
+        if (tex_count > 0)
+          arcs.push_back (wszQualifiedPackName);
+      } while (FindNextFileW (hFind, &fd) != 0);
 
-  char szFormatted [64];
-  sprintf ( szFormatted, "%6zu Total Textures : %8.2f MiB",
-              numTextures () + numInjectedTextures (),
-                cache_total );
-  osd_stats += szFormatted;
+      FindClose (hFind);
+    }
 
-  if ( tbf::RenderFix::pDevice != nullptr &&
-       tbf::RenderFix::pDevice->GetAvailableTextureMem () / 1048576UL != 4095)
-    sprintf ( szFormatted, "    (%4lu MiB Available)\n",
-              tbf::RenderFix::pDevice->GetAvailableTextureMem () 
-                / 1048576UL );
-  else
-    sprintf (szFormatted, "\n");
+    //
+    // Gather every archive in directory order first; the order determines which
+    //   archive wins when two of them supply the same checksum.
+    //
+    std::vector <tbf_archive_scan_s> scans;
 
-  osd_stats += szFormatted;
+    hFind = FindFirstFileW (TBFIX_TEXTURE_DIR L"\\inject\\*.*", &fd);
 
-  sprintf ( szFormatted, "%6zu  Base Textures : %8.2f MiB    %s\n",
-              numTextures (),
-                cache_basic,
-                  __remap_textures ? "" : "<----" );
+    if (hFind != INVALID_HANDLE_VALUE)
+    {
+      do
+      {
+        if (fd.dwFileAttributes != INVALID_FILE_ATTRIBUTES)
+        {
+          wchar_t* wszArchiveNameLwr =
+            _wcslwr (_wcsdup (fd.cFileName));
 
-  osd_stats += szFormatted;
+          if ( wcsstr (wszArchiveNameLwr, L".7z") )
+          {
+            wchar_t wszQualifiedArchiveName [MAX_PATH];
+            _swprintf ( wszQualifiedArchiveName,
+                          L"%s\\inject\\%s",
+                            TBFIX_TEXTURE_DIR,
+                              fd.cFileName );
 
-  sprintf ( szFormatted, "%6lu   New Textures : %8.2f MiB    %s\n",
-              numInjectedTextures (),
-                cache_injected,
-                  __remap_textures ? "<----" : "" );
+            tbf_archive_scan_s scan;
 
-  osd_stats += szFormatted;
+            scan.path       = wszQualifiedArchiveName;
+            scan.size       = ((uint64_t)fd.nFileSizeHigh << 32ULL) | fd.nFileSizeLow;
+            scan.last_write = ((uint64_t)fd.ftLastWriteTime.dwHighDateTime << 32ULL) |
+                                         fd.ftLastWriteTime.dwLowDateTime;
 
-  sprintf ( szFormatted, "%6lu Cache Hits     : %8.2f Seconds Saved",
-              hits,
-                time_saved / 1000.0f );
+            scans.push_back (scan);
+          }
 
-  osd_stats += szFormatted;
+          free (wszArchiveNameLwr);
+        }
+      } while (FindNextFileW (hFind, &fd) != 0);
 
-  if (debug_tex_id != 0x00) {
-    osd_stats += "\n\n";
+      FindClose (hFind);
+    }
 
-    sprintf ( szFormatted, " Debug Texture : %08x",
-                debug_tex_id );
+    TBF_ArchiveManifest manifest;
+    manifest.load (TBFIX_MANIFEST_FILE);
 
-    osd_stats += szFormatted;
-  }
-}
+    std::vector <tbf_archive_scan_s*> dirty =
+      manifest.apply (scans);
 
-std::vector <uint32_t> textures_used_last_dump;
-             uint32_t  tex_dbg_idx              = 0UL;
+    //
+    // Parse the headers of new / modified archives in parallel
+    //
+    if (! dirty.empty ())
+    {
+      SYSTEM_INFO sysinfo;
+      GetSystemInfo (&sysinfo);
 
-void
-TBFix_LogUsedTextures (void)
-{
-  if (__log_used)
-  {
-    textures_used_last_dump.clear ();
-    tex_dbg_idx = 0;
+      tbf_archive_scan_job_s job;
+      job.work   = &dirty;
+      job.next   = 0;
+      job.cancel = hCancel;
 
-    tex_log->Log (L"[ Tex. Log ] ---------- FrameTrace ----------- ");
+      const size_t num_threads =
+        std::max ( (size_t)1,
+                     std::min ( dirty.size (),
+                                  (size_t)sysinfo.dwNumberOfProcessors ) );
 
-    for ( auto&& it  : textures_used ) {
-      auto tex_record =
-        tbf::RenderFix::tex_mgr.getTexture (it);
+      std::vector <HANDLE> threads;
 
-      // Handle the RARE case where a purge happens immediately following
-      //   the last frame
-      if ( tex_record           != nullptr &&
-           tex_record->d3d9_tex != nullptr )
+      for (size_t i = 1; i < num_threads; i++)
       {
-        ISKTextureD3D9* pSKTex =
-          (ISKTextureD3D9 *)tex_record->d3d9_tex;
+        HANDLE hThread =
+          (HANDLE)_beginthreadex ( nullptr, 0,
+                                     TBF_ArchiveScanThread,
+                                       &job,
+                                         0x00, nullptr );
+
+        if (hThread != 0)
+          threads.push_back (hThread);
+      }
 
-        textures_used_last_dump.push_back (it);
+      // This thread does its share of the work too
+      TBF_ArchiveScanThread (&job);
 
-        tex_log->Log ( L"[ Tex. Log ] %08x.dds  { Base: %6.2f MiB,  "
-                       L"Inject: %6.2f MiB,  Load Time: %8.3f ms }",
-                         it,
-                           (double)pSKTex->tex_size /
-                             (1024.0 * 1024.0),
+      if (! threads.empty ())
+      {
+        WaitForMultipleObjects ((DWORD)threads.size (), threads.data (), TRUE, INFINITE);
 
-                     pSKTex->override_size != 0 ? 
-                       (double)pSKTex->override_size / 
-                             (1024.0 * 1024.0) : 0.0,
+        for ( auto hThread : threads )
+          CloseHandle (hThread);
+      }
 
-                           tbf::RenderFix::tex_mgr.getTexture (it)->load_time );
+      if (job.cancel != nullptr && WaitForSingleObject (job.cancel, 0) == WAIT_OBJECT_0)
+        complete = false;
+
+      for ( auto scan : dirty )
+      {
+        if (complete && (! scan->valid))
+          tex_log->Log ( L"[Inject Tex]  ** Cannot open archive file: %s",
+                           scan->path.c_str () );
       }
     }
 
-    tex_log->Log (L"[ Tex. Log ] ---------- FrameTrace ----------- ");
+    if (! complete)
+    {
+      tex_log->LogEx (false, L" cancelled\n");
 
-    __log_used = false;
-  }
+      LeaveCriticalSection (&cs_inject_index);
+      return false;
+    }
 
-  textures_used.clear ();
-}
+    //
+    // Merge in directory order so that archive indices and precedence are
+    //   identical to a serial scan.
+    //
+    unsigned int archive = (unsigned int)arcs.size ();
 
+    for ( auto& scan : scans )
+    {
+      if (! scan.valid)
+        continue;
 
-CRITICAL_SECTION        SK_TextureWorkerThread::cs_worker_init;
-ULONG                   SK_TextureWorkerThread::num_threads_init = 0UL;
+      int tex_count = 0;
 
-HRESULT
-WINAPI
-ResampleTexture (tbf_tex_load_s* load)
-{
-  QueryPerformanceFrequency (&load->freq);
-  QueryPerformanceCounter   (&load->start);
+      for ( auto& entry : scan.entries )
+      {
+        // Already got this texture...
+        if ( textures.count            (entry.checksum) ||
+             inject_blacklist.count    (entry.checksum) )
+          continue;
 
-  D3DXIMAGE_INFO img_info = { };
+        tbf_tex_record_s rec;
+        rec.size    = entry.size;
+        rec.archive = archive;
+        rec.fileno  = entry.fileno;
+        rec.method  = entry.method;
 
-  D3DXGetImageInfoFromFileInMemory (
-    load->pSrcData,
-      load->SrcDataSize,
-        &img_info );
+        textures.try_emplace (entry.checksum, rec);
 
-  HRESULT hr = E_FAIL;
+        ++tex_count;
+        ++files;
 
-  if (img_info.Depth == 1)
-  {
-    hr =
-    D3DXCreateTextureFromFileInMemoryEx_Original (
-      load->pDevice,
-          load->pSrcData, load->SrcDataSize,
-            img_info.Width, img_info.Height, 0,
-              0, config.textures.uncompressed ? D3DFMT_A8R8G8B8 : img_info.Format,
-                D3DPOOL_DEFAULT,
-                  D3DX_FILTER_TRIANGLE | D3DX_FILTER_DITHER,
-                  D3DX_FILTER_BOX      | D3DX_FILTER_DITHER,
-                    0,
-                      nullptr, nullptr,
-                        &load->pSrc );
-  }
+        liSize.QuadPart += rec.size;
+      }
 
-  else
-  {
-    tex_log->Log (L"[ Tex. Mgr ] Will not resample cubemap...");
+      if (tex_count > 0) {
+        ++archive;
+        arcs.push_back (scan.path);
+      }
+    }
+
+    if ( (! dirty.empty ()) || manifest.size () != scans.size () )
+      TBF_ArchiveManifest::save (TBFIX_MANIFEST_FILE, scans);
+
+    tex_log->LogEx ( false, L" %lu files (%3.1f MiB) [%lu / %lu archives cached]\n",
+                       files, (double)liSize.QuadPart / (1024.0 * 1024.0),
+                         (unsigned long)(scans.size () - dirty.size ()),
+                           (unsigned long) scans.size () );
   }
 
-  delete [] load->pSrcData;
+  LeaveCriticalSection (&cs_inject_index);
 
-  return hr;
+  return complete;
 }
 
-unsigned int
-__stdcall
-SK_TextureWorkerThread::ThreadProc (LPVOID user)
+void
+TBF_RefreshDataSources (void)
 {
-  EnterCriticalSection (&cs_worker_init);
-  {
-    DWORD dwThreadId = GetCurrentThreadId ();
-
-    if (! streaming_memory::data_len.count (dwThreadId))
-    {
-      streaming_memory::data_len [dwThreadId] = 0;
-      streaming_memory::data     [dwThreadId] = nullptr;
-      streaming_memory::data_age [dwThreadId] = 0;
-    }
-  }
-  LeaveCriticalSection (&cs_worker_init);
-
-  SYSTEM_INFO sysinfo;
-  GetSystemInfo (&sysinfo);
+  TBF_BuildInjectableIndex (injectable_textures, archives);
 
-  ULONG thread_num    = InterlockedIncrement (&num_threads_init);
+  source_stager.clear ();
 
-  // If a system has more than 4 CPUs (logical or otherwise), let the last one
-  //   be dedicated to rendering.
-  ULONG processor_num = thread_num % ( sysinfo.dwNumberOfProcessors > 4 ?
-                                         sysinfo.dwNumberOfProcessors - 1 :
-                                         sysinfo.dwNumberOfProcessors );
+  // Rebuilt from scratch if that is safe, otherwise just stop using it
+  if (config.textures.resident_blocking && resident_pool.bytesReserved () > 0)
+  {
+    if (pending_loads () || pending_streams ())
+      resident_pool.forgetAll ();
+    else
+      TBF_StartResidentPool ();
+  }
+}
 
-  // Tales of Symphonia and Zestiria both pin the render thread to the last
-  //   CPU... let's try to keep our worker threads OFF that CPU.
 
-  SetThreadIdealProcessor (GetCurrentThread (),         processor_num);
-  SetThreadAffinityMask   (GetCurrentThread (), (1UL << processor_num) & 0xFFFFFFFF);
+//
+// Called from SKPlugIn_Shutdown, while the texture manager still exists
+//
+void
+TBF_SaveWarmStartSet (void)
+{
+  if (! config.textures.warm_start)
+    return;
 
-  // Ghetto sync. barrier, since Windows 7 does not support them...
-  while ( InterlockedCompareExchange (
-            &num_threads_init,
-              config.textures.worker_threads * 3,
-                config.textures.worker_threads * 3
-          ) < (ULONG)config.textures.worker_threads * 3 )
+  if (warm_start.save (TBFIX_WARM_START_FILE))
   {
-    SwitchToThread ();
+    tex_log->Log ( L"[ Prefetch ] Saved %lu injected textures for the next warm start",
+                     (unsigned long)warm_start.size () );
   }
+}
 
-  SK_TextureWorkerThread* pThread =
-   (SK_TextureWorkerThread *)user;
+//
+// Converts every injectable texture currently known (loose files, .7z archives
+//   and existing packs) into a single texture pack: TBFix_Res\inject\textures.tbfpack
+//
+//   The sources are snapshotted on the render thread and packed by a worker;
+//     the render thread swaps the finished pack in once nothing is loading.
+//
+#define TBFIX_TEXTURE_PACK_FILE TBFIX_TEXTURE_DIR L"\\inject\\textures" TBF_PACK_EXT
+#define TBFIX_TEXTURE_PACK_TEMP TBFIX_TEXTURE_DIR L"\\inject\\~textures.tmp"
 
-  DWORD dwWaitStatus = 0;
+struct tbf_pack_src_s {
+  uint32_t         checksum;
+  tbf_tex_record_s rec;
+};
 
-  struct {
-    const DWORD job_start  = WAIT_OBJECT_0;
-    const DWORD mem_trim   = WAIT_OBJECT_0 + 1;
-    const DWORD thread_end = WAIT_OBJECT_0 + 2;
-  } wait;
+struct tbf_pack_build_s {
+  HANDLE                      hThread  = nullptr;
+  volatile LONG               done     = 0;
+  volatile LONG               total    = 0;
+  volatile LONG               result   = 0;  // 0 = Running, 1 = Finished, -1 = Failed
+  volatile LONG               cancel   = 0;
 
-  do {
-    dwWaitStatus =
-      WaitForMultipleObjects ( 3,
-                                 pThread->control_.ops,
-                                   FALSE,
-                                     INFINITE );
+  bool                        compress = false;
+  std::vector <tbf_pack_src_s> srcs;
+  std::vector <std::wstring>   arcs;
 
-    // New Work Ready
-    if (dwWaitStatus == wait.job_start) {
-      tbf_tex_load_s* pStream = 
-        (tbf_tex_load_s *)InterlockedCompareExchangePointer ((PVOID *)&pThread->job_, nullptr, nullptr);
+  uint32_t                    packed   = 0;
+  uint64_t                    bytes    = 0ULL;
+} static pack_build;
 
-      start_load ();
-      {
-        if (pStream->type == tbf_tex_load_s::Resample)
-        {
-          InterlockedIncrement      (&resampling);
+static unsigned int
+__stdcall
+TBF_TexturePackBuildThread (LPVOID user)
+{
+  UNREFERENCED_PARAMETER (user);
 
-          QueryPerformanceFrequency (&pStream->freq);
-          QueryPerformanceCounter   (&pStream->start);
+  auto& srcs = pack_build.srcs;
+  auto& arcs = pack_build.arcs;
 
-          HRESULT hr =
-            ResampleTexture (pStream);
+  TBF_TexturePackWriter writer;
 
-          QueryPerformanceCounter   (&pStream->end);
+  if (! writer.begin (_wfopen (TBFIX_TEXTURE_PACK_TEMP, L"wb"), (uint32_t)srcs.size ()))
+  {
+    tex_log->Log (L"[Inject Tex] Cannot create texture pack: %s", TBFIX_TEXTURE_PACK_TEMP);
 
-          InterlockedDecrement      (&resampling);
+    InterlockedExchange (&pack_build.result, -1);
+    return 0;
+  }
 
-          if (SUCCEEDED (hr))
-            pThread->pool_->postFinished (pStream);
+  ISzAlloc      thread_alloc;
+  ISzAlloc      thread_tmp_alloc;
 
-          else {
-            tex_log->Log ( L"[ Tex. Mgr ] Texture Resample Failure (hr=%x) for texture %x, blacklisting from future resamples...",
-                             hr, pStream->checksum );
-            resample_blacklist.emplace (pStream->checksum);
+  thread_alloc.Alloc     = SzAlloc;
+  thread_alloc.Free      = SzFree;
 
-            pStream->pDest->Release ();
-            pStream->pSrc = pStream->pDest;
+  thread_tmp_alloc.Alloc = SzAllocTemp;
+  thread_tmp_alloc.Free  = SzFreeTemp;
 
-            ((ISKTextureD3D9 *)pStream->pSrc)->must_block = false;
-            ((ISKTextureD3D9 *)pStream->pSrc)->refs--;
+  CFileInStream arc_stream;
+  std::unique_ptr <CLookToRead>
+                look_stream (new CLookToRead ());
 
-            finished_streaming (pStream->checksum);
-          }
+  FileInStream_CreateVTable (&arc_stream);
+  LookToRead_CreateVTable   (look_stream.get (), False);
 
-          pThread->finishJob ();
-        }
+  look_stream->realStream = &arc_stream.s;
 
-        else
-        {
-          InterlockedIncrement        (&streaming);
-          InterlockedExchangeAdd      (&streaming_bytes, pStream->SrcDataSize);
+  CSzArEx       arc;
+  unsigned int  open_arc  = std::numeric_limits <unsigned int>::max ();
+  bool          arc_valid = false;
 
-          QueryPerformanceFrequency   (&pStream->freq);
-          QueryPerformanceCounter     (&pStream->start);
+  // Kept across SzArEx_Extract calls, this is the decoded solid block cache
+  uint32_t      block_idx = 0xFFFFFFFF;
+  Byte*         out       = nullptr;
+  size_t        out_len   = 0;
 
-          HRESULT hr =
-            InjectTexture (pStream);
+  // The worker maps its own copy of any existing pack, the render thread's
+  //   copies are closed underneath it when the new pack is swapped in.
+  TBF_TexturePack pack;
+  unsigned int    open_pack  = std::numeric_limits <unsigned int>::max ();
+  bool            pack_valid = false;
 
-          QueryPerformanceCounter     (&pStream->end);
+  auto CloseArchive = [&](void) -> void
+  {
+    if (open_arc == std::numeric_limits <unsigned int>::max ())
+      return;
 
-          InterlockedExchangeSubtract (&streaming_bytes, pStream->SrcDataSize);
-          InterlockedDecrement        (&streaming);
+    IAlloc_Free (&thread_alloc, out);
 
-          if (SUCCEEDED (hr))
-            pThread->pool_->postFinished (pStream);
+    out       = nullptr;
+    out_len   = 0;
+    block_idx = 0xFFFFFFFF;
 
-          else
-          {
-            HRESULT hr = S_OK;
-            tex_log->Log ( L"[ Tex. Mgr ] Texture Injection Failure (hr=%x) for texture %x, removing from injectable list...",
-              hr, pStream->checksum);
-            if (injectable_textures.count (pStream->checksum))
-              injectable_textures.erase (pStream->checksum);
+    if (arc_valid)
+      SzArEx_Free (&arc, &thread_alloc);
 
-            pStream->pDest->Release ();
-            pStream->pSrc = pStream->pDest;
+    File_Close (&arc_stream.file);
 
-            ((ISKTextureD3D9 *)pStream->pSrc)->must_block = false;
-            ((ISKTextureD3D9 *)pStream->pSrc)->refs--;
+    open_arc  = std::numeric_limits <unsigned int>::max ();
+    arc_valid = false;
+  };
 
-            finished_streaming (pStream->checksum);
-          }
+  std::vector <uint8_t> data;
 
-          pThread->finishJob ();
-        }
-      }
-      end_load ();
+  for ( auto& src : srcs )
+  {
+    if (InterlockedCompareExchange (&pack_build.cancel, 0, 0))
+      break;
 
-    }
+    const void* pData = nullptr;
+    size_t      size  = 0;
 
-    else if (dwWaitStatus == (wait.mem_trim))
+    // Loose file
+    if (src.rec.archive == std::numeric_limits <unsigned int>::max ())
     {
-      // Yay for magic numbers :P   ==> (8 MiB Min Size, 5 Seconds Between Trims)
-      //
-      const size_t   MIN_SIZE = 8192 * 1024;
-      const uint32_t MIN_AGE  = 5000UL;
+      wchar_t wszFileName [MAX_PATH];
 
-      size_t before = streaming_memory::data_len [GetCurrentThreadId ()];
-
-      streaming_memory::trim (MIN_SIZE, timeGetTime () - MIN_AGE);
+      _swprintf ( wszFileName, L"%s\\inject\\textures\\%s%08x%s",
+                    TBFIX_TEXTURE_DIR,
+                      src.rec.method == Streaming ? L"streaming\\" :
+                      src.rec.method == Blocking  ? L"blocking\\"  : L"",
+                        src.checksum,
+                          TBFIX_TEXTURE_EXT );
 
-      size_t now    =  streaming_memory::data_len [GetCurrentThreadId ()];
+      FILE* fTex = _wfopen (wszFileName, L"rb");
 
-      if (before != now)
+      if (fTex != nullptr)
       {
-        tex_log->Log ( L"[ Mem. Mgr ]  Trimmed %9lzu bytes of temporary memory for tid=%x",
-                         before - now,
-                           GetCurrentThreadId () );
+        data.resize (src.rec.size);
+
+        if (fread (data.data (), 1, src.rec.size, fTex) == src.rec.size)
+        {
+          pData = data.data ();
+          size  = src.rec.size;
+        }
+
+        fclose (fTex);
       }
     }
 
-    else if (dwWaitStatus != (wait.thread_end))
+    // Existing texture pack
+    else if (TBF_IsTexturePackName (arcs [src.rec.archive]))
     {
-      dll_log->Log ( L"[ Tex. Mgr ] Unexpected Worker Thread Wait Status: %X",
-                       dwWaitStatus );
-    }
-  } while (dwWaitStatus != (wait.thread_end));
-
-  streaming_memory::trim (0, timeGetTime ());
-
-  //CloseHandle (GetCurrentThread ());
-  return 0;
-}
-
-unsigned int
-__stdcall
-SK_TextureThreadPool::Spooler (LPVOID user)
-{
-  SK_TextureThreadPool* pPool =
-    (SK_TextureThreadPool *)user;
-
-  WaitForSingleObject (pPool->events_.jobs_added, INFINITE);
+      if (open_pack != src.rec.archive)
+      {
+        pack.close ();
 
-  while (WaitForSingleObject (pPool->events_.shutdown, 0) == WAIT_TIMEOUT) {
-    tbf_tex_load_s* pJob =
-      pPool->getNextJob ();
+        open_pack  = src.rec.archive;
+        pack_valid = pack.open (arcs [src.rec.archive].c_str ());
+      }
 
-    while (pJob != nullptr)
-    {
-      // Alternate the direction we look for idle workers to reduce
-      //   starvation (important since each thread is pinned to one CPU).
-      static int direction = 1;
-      bool       started   = false;
+      const tbf_pack_entry_s* entry =
+        pack_valid ? pack.getEntry (src.rec.fileno) : nullptr;
 
-      if (direction > 0)
+      if (entry != nullptr)
       {
-        auto it = pPool->workers_.begin ();
-
-        while (it != pPool->workers_.end ()) {
-          if (! (*it)->isBusy ()) {
-            if (! started) {
-              (*it)->startJob (pJob);
-              started = true;
-            } else {
-              (*it)->trim ();
-            }
-          }
+        data.resize (entry->size);
 
-          ++it;
+        if (pack.extract (entry, data.data (), data.size ()))
+        {
+          pData = data.data ();
+          size  = entry->size;
         }
       }
+    }
 
-      else
+    // 7-Zip archive
+    else
+    {
+      if (open_arc != src.rec.archive)
       {
-        auto it = pPool->workers_.rbegin ();
+        CloseArchive ();
 
-        while (it != pPool->workers_.rend ()) {
-          if (! (*it)->isBusy ()) {
-            if (! started) {
-              (*it)->startJob (pJob);
-              started = true;
-            } else {
-              (*it)->trim ();
-            }
-          }
+        if (! InFile_OpenW (&arc_stream.file, arcs [src.rec.archive].c_str ()))
+        {
+          open_arc = src.rec.archive;
 
-          ++it;
+          LookToRead_Init (look_stream.get ());
+          SzArEx_Init     (&arc);
+
+          arc_valid =
+            SzArEx_Open (&arc, &look_stream->s, &thread_alloc, &thread_tmp_alloc) == SZ_OK;
         }
       }
 
-      direction = -direction;
-
-      // All worker threads are busy, so wait...
-      if (! started)
+      if (arc_valid)
       {
-        WaitForSingleObject (pPool->events_.results_waiting, INFINITE);
-      } else {
-        pJob =
-          pPool->getNextJob ();
+        size_t offset      = 0;
+        size_t decomp_size = 0;
+
+        if ( SzArEx_Extract ( &arc,          &look_stream->s, src.rec.fileno,
+                              &block_idx,    &out,            &out_len,
+                              &offset,       &decomp_size,
+                              &thread_alloc, &thread_tmp_alloc ) == SZ_OK )
+        {
+          pData = out + offset;
+          size  = decomp_size;
+        }
       }
     }
 
-    const int MAX_TIME_BETWEEN_TRIMS = 1500UL;
-    while ( WaitForSingleObject (
-              pPool->events_.jobs_added,
-                MAX_TIME_BETWEEN_TRIMS ) ==
-                               WAIT_TIMEOUT ) {
-      auto it = pPool->workers_.begin ();
+    if ( pData != nullptr &&
+         writer.add (src.checksum, src.rec.method, pData, (uint32_t)size, pack_build.compress) )
+    {
+      ++pack_build.packed;
+      pack_build.bytes += size;
+    }
 
-      while (it != pPool->workers_.end ()) {
-        if (! (*it)->isBusy ()) {
-          (*it)->trim ();
-        }
+    else
+      tex_log->Log (L"[Inject Tex]  ** Could not pack texture %08x", src.checksum);
 
-        ++it;
-      }
-    }
+    InterlockedIncrement (&pack_build.done);
   }
 
-  //CloseHandle (GetCurrentThread ());
+  CloseArchive ();
+  pack.close   ();
+
+  bool cancelled =
+    InterlockedCompareExchange (&pack_build.cancel, 0, 0) != 0;
+
+  // finish () also closes the file, so it runs even when cancelled
+  if (writer.finish () && (! cancelled))
+    InterlockedExchange (&pack_build.result,  1);
+  else
+    InterlockedExchange (&pack_build.result, -1);
+
   return 0;
 }
 
-void
-SK_TextureWorkerThread::finishJob (void)
+bool
+TBF_StartTexturePackBuild (bool compress)
 {
-  InterlockedExchangeAdd     (&bytes_loaded_,
-           ((tbf_tex_load_s *)InterlockedCompareExchangePointer ((PVOID *)&job_, nullptr, nullptr))
-                             ->SrcDataSize);
-  InterlockedIncrement       (&jobs_retired_);
-  InterlockedExchangePointer ((PVOID *)&job_, nullptr);
-}
-HMODULE tbf::RenderFix::d3dx9_43_dll = 0;
+  if (pack_build.hThread != nullptr)
+    return false;
+
+  pack_build.srcs.clear ();
 
+  for ( auto& it : injectable_textures )
+    pack_build.srcs.push_back (tbf_pack_src_s { it.first, it.second });
 
+  if (pack_build.srcs.empty ())
+    return false;
 
+  // Visit archive entries in order so that solid blocks are only decoded once
+  std::sort ( pack_build.srcs.begin (), pack_build.srcs.end (),
+                [](const tbf_pack_src_s& a, const tbf_pack_src_s& b) {
+                  return a.rec.archive != b.rec.archive ? a.rec.archive < b.rec.archive :
+                         a.rec.fileno  != b.rec.fileno  ? a.rec.fileno  < b.rec.fileno  :
+                                                          a.checksum    < b.checksum;
+                } );
+
+  pack_build.arcs     = archives;
+  pack_build.compress = compress;
+  pack_build.done     = 0;
+  pack_build.total    = (LONG)pack_build.srcs.size ();
+  pack_build.result   = 0;
+  pack_build.cancel   = 0;
+  pack_build.packed   = 0;
+  pack_build.bytes    = 0ULL;
+
+  tex_log->Log ( L"[Inject Tex] Building texture pack (%lu textures)...",
+                   pack_build.srcs.size () );
+
+  pack_build.hThread =
+    (HANDLE)_beginthreadex ( nullptr, 0,
+                               TBF_TexturePackBuildThread,
+                                 nullptr,
+                                   0x00, nullptr );
+
+  if (pack_build.hThread == nullptr)
+    return false;
 
-void
-TBF_RefreshDataSources (void)
-{
-  CFileInStream arc_stream;
+  SetThreadPriority (pack_build.hThread, THREAD_PRIORITY_BELOW_NORMAL);
 
-  std::unique_ptr <CLookToRead>
-                look_stream (new CLookToRead ());
+  return true;
+}
 
-  FileInStream_CreateVTable (&arc_stream);
-  LookToRead_CreateVTable   (look_stream.get (), False);
+bool
+TBF_IsBuildingTexturePack (uint32_t* pDone, uint32_t* pTotal)
+{
+  if (pack_build.hThread == nullptr)
+    return false;
 
-  look_stream->realStream = &arc_stream.s;
-  LookToRead_Init           (look_stream.get ());
+  if (pDone  != nullptr) *pDone  = (uint32_t)InterlockedCompareExchange (&pack_build.done, 0, 0);
+  if (pTotal != nullptr) *pTotal = (uint32_t)pack_build.total;
 
-  injectable_textures.clear ();
-  archives.clear            ();
+  return true;
+}
 
-  //
-  // Walk injectable textures so we don't have to query the filesystem on every
-  //   texture load to check if a injectable one exists.
-  //
-  if ( GetFileAttributesW (TBFIX_TEXTURE_DIR L"\\inject") !=
-         INVALID_FILE_ATTRIBUTES ) {
-    WIN32_FIND_DATA fd;
-    HANDLE          hFind  = INVALID_HANDLE_VALUE;
-    int             files  = 0;
-    LARGE_INTEGER   liSize = { 0 };
+void
+TBF_CancelTexturePackBuild (void)
+{
+  if (pack_build.hThread == nullptr)
+    return;
 
-    tex_log->LogEx ( true, L"[Inject Tex] Enumerating injectable textures..." );
+  InterlockedExchange (&pack_build.cancel, 1);
+  WaitForSingleObject (pack_build.hThread, INFINITE);
+  CloseHandle         (pack_build.hThread);
 
-    hFind = FindFirstFileW (TBFIX_TEXTURE_DIR L"\\inject\\textures\\blocking\\*", &fd);
+  pack_build.hThread = nullptr;
 
-    if (hFind != INVALID_HANDLE_VALUE) {
-      do {
-        if (fd.dwFileAttributes != INVALID_FILE_ATTRIBUTES) {
-          if (wcsstr (_wcslwr (fd.cFileName), TBFIX_TEXTURE_EXT)) {
-            uint32_t checksum;
-            swscanf (fd.cFileName, L"%x" TBFIX_TEXTURE_EXT, &checksum);
+  DeleteFileW (TBFIX_TEXTURE_PACK_TEMP);
+}
 
-            // Already got this texture...
-            if (injectable_textures.count (checksum))
-                continue;
+//
+// Called once per-frame on the render thread, swaps a finished pack in
+//
+static void
+TBF_FinishTexturePackBuild (void)
+{
+  if (pack_build.hThread == nullptr)
+    return;
 
-            ++files;
+  LONG result =
+    InterlockedCompareExchange (&pack_build.result, 0, 0);
 
-            LARGE_INTEGER fsize;
+  if (result == 0)
+    return;
 
-            fsize.HighPart = fd.nFileSizeHigh;
-            fsize.LowPart  = fd.nFileSizeLow;
+  // An old pack may still be mapped for InjectTexture
+  if (result > 0 && (pending_loads () || pending_streams ()))
+    return;
 
-            liSize.QuadPart += fsize.QuadPart;
+  WaitForSingleObject (pack_build.hThread, INFINITE);
+  CloseHandle         (pack_build.hThread);
 
-            tbf_tex_record_s rec;
-            rec.size    = (uint32_t)fsize.QuadPart;
-            rec.archive = std::numeric_limits <unsigned int>::max ();
-            rec.method  = Blocking;
+  pack_build.hThread = nullptr;
+  pack_build.srcs.clear ();
+  pack_build.arcs.clear ();
 
-            injectable_textures.try_emplace ( checksum, rec );
-          }
-        }
-      } while (FindNextFileW (hFind, &fd) != 0);
+  if (result > 0)
+  {
+    TBF_CloseTexturePacks ();
 
-      FindClose (hFind);
+    if (MoveFileExW (TBFIX_TEXTURE_PACK_TEMP, TBFIX_TEXTURE_PACK_FILE, MOVEFILE_REPLACE_EXISTING))
+    {
+      tex_log->Log ( L"[Inject Tex] Built texture pack: %lu textures (%3.1f MiB)",
+                       pack_build.packed, (double)pack_build.bytes / (1024.0 * 1024.0) );
+
+      TBF_RefreshDataSources ();
+      return;
     }
+  }
 
-    hFind = FindFirstFileW (TBFIX_TEXTURE_DIR L"\\inject\\textures\\streaming\\*", &fd);
+  tex_log->Log (L"[Inject Tex]  ** Texture pack build failed");
 
-    if (hFind != INVALID_HANDLE_VALUE) {
-      do {
-        if (fd.dwFileAttributes != INVALID_FILE_ATTRIBUTES) {
-          if (wcsstr (_wcslwr (fd.cFileName), TBFIX_TEXTURE_EXT)) {
-            uint32_t checksum;
-            swscanf (fd.cFileName, L"%x" TBFIX_TEXTURE_EXT, &checksum);
+  DeleteFileW (TBFIX_TEXTURE_PACK_TEMP);
+}
 
-            // Already got this texture...
-            if (injectable_textures.count (checksum))
-                continue;
 
-            ++files;
+//
+// Injection source watcher: monitors TBFix_Res\inject for changes and stages a
+//   rebuilt index that the render thread applies incrementally (only textures
+//     whose source actually changed are reloaded).
+//
+static HANDLE           hInjectWatchThread   = nullptr;
+static HANDLE           hInjectWatchShutdown = nullptr;
+static CRITICAL_SECTION cs_inject_watch      = { };
+
+static struct {
+  bool                                            ready = false;
+  tbf_inject_changes_s                            changes;
+  std::unordered_map <uint32_t, tbf_tex_record_s> textures;
+  std::vector        <std::wstring>               archives;
+} staged_sources;
+
+static unsigned int
+__stdcall
+TBF_InjectWatchThread (LPVOID user)
+{
+  UNREFERENCED_PARAMETER (user);
 
-            LARGE_INTEGER fsize;
+  HANDLE hDir =
+    CreateFileW ( TBFIX_TEXTURE_DIR L"\\inject",
+                    FILE_LIST_DIRECTORY,
+                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                        nullptr,
+                          OPEN_EXISTING,
+                            FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+                              nullptr );
 
-            fsize.HighPart = fd.nFileSizeHigh;
-            fsize.LowPart  = fd.nFileSizeLow;
+  if (hDir == INVALID_HANDLE_VALUE)
+    return 0;
 
-            liSize.QuadPart += fsize.QuadPart;
+  const DWORD dwFilter = FILE_NOTIFY_CHANGE_FILE_NAME  | FILE_NOTIFY_CHANGE_DIR_NAME |
+                         FILE_NOTIFY_CHANGE_SIZE       | FILE_NOTIFY_CHANGE_LAST_WRITE;
 
-            tbf_tex_record_s rec;
-            rec.size    = (uint32_t)fsize.QuadPart;
-            rec.archive = std::numeric_limits <unsigned int>::max ();
-            rec.method  = Streaming;
+  // ReadDirectoryChangesW requires DWORD alignment
+  static DWORD notify_buf [8192];
 
-            injectable_textures.try_emplace (checksum, rec);
-          }
-        }
-      } while (FindNextFileW (hFind, &fd) != 0);
+  OVERLAPPED ov = { };
+  ov.hEvent     = CreateEvent (nullptr, TRUE, FALSE, nullptr);
 
-      FindClose (hFind);
-    }
+  tbf_inject_changes_s changes;
+  bool                 dirty   = false;
+  bool                 reading = false;
+  bool                 run     = true;
 
-    hFind = FindFirstFileW (TBFIX_TEXTURE_DIR L"\\inject\\textures\\*", &fd);
+  while (run)
+  {
+    // Keep a read outstanding even while the index is being rebuilt, so that
+    //   nothing that happens in the meantime is missed.
+    if (! reading)
+    {
+      ResetEvent (ov.hEvent);
 
-    if (hFind != INVALID_HANDLE_VALUE) {
-      do {
-        if (fd.dwFileAttributes != INVALID_FILE_ATTRIBUTES) {
-          if (wcsstr (_wcslwr (fd.cFileName), TBFIX_TEXTURE_EXT)) {
-            uint32_t checksum;
-            swscanf (fd.cFileName, L"%x" TBFIX_TEXTURE_EXT, &checksum);
+      if (! ReadDirectoryChangesW ( hDir, notify_buf, sizeof (notify_buf), TRUE,
+                                      dwFilter, nullptr, &ov, nullptr ))
+        break;
 
-            // Already got this texture...
-            if (injectable_textures.count (checksum))
-                continue;
+      reading = true;
+    }
 
-            ++files;
+    HANDLE wait_objs [] = { hInjectWatchShutdown, ov.hEvent };
 
-            LARGE_INTEGER fsize;
+    // Changes tend to arrive in bursts (e.g. extracting a pack), so wait for
+    //   things to settle down before rebuilding the index.
+    DWORD dwWait =
+      WaitForMultipleObjects (2, wait_objs, FALSE, dirty ? 500UL : INFINITE);
 
-            fsize.HighPart = fd.nFileSizeHigh;
-            fsize.LowPart  = fd.nFileSizeLow;
+    switch (dwWait)
+    {
+      case WAIT_OBJECT_0 + 1:
+      {
+        DWORD dwBytes = 0;
 
-            liSize.QuadPart += fsize.QuadPart;
+        reading = false;
 
-            tbf_tex_record_s rec;
-            rec.size    = (uint32_t)fsize.QuadPart;
-            rec.archive = std::numeric_limits <unsigned int>::max ();
-            rec.method  = DontCare;
+        if (GetOverlappedResult (hDir, &ov, &dwBytes, FALSE) && dwBytes > 0)
+        {
+          const FILE_NOTIFY_INFORMATION* pNotify =
+            (FILE_NOTIFY_INFORMATION *)notify_buf;
 
-            injectable_textures.try_emplace (checksum, rec);
-          }
-        }
-      } while (FindNextFileW (hFind, &fd) != 0);
+          while (true)
+          {
+            TBF_RecordInjectChange ( TBFIX_TEXTURE_DIR L"\\inject\\",
+                                       std::wstring ( pNotify->FileName,
+                                                        pNotify->FileNameLength / sizeof (wchar_t) ),
+                                         changes );
 
-      FindClose (hFind);
-    }
+            if (pNotify->NextEntryOffset == 0)
+              break;
 
-    hFind = FindFirstFileW (TBFIX_TEXTURE_DIR L"\\inject\\*.*", &fd);
+            pNotify =
+              (FILE_NOTIFY_INFORMATION *)((uint8_t *)pNotify + pNotify->NextEntryOffset);
+          }
+        }
 
-    if (hFind != INVALID_HANDLE_VALUE)
-    {
-      int archive = 0;
+        // A zero-byte completion means the buffer overflowed; the rebuilt
+        //   index will still catch additions, removals and size changes.
+        dirty = true;
+      } break;
 
-      do
+      case WAIT_TIMEOUT:
       {
-        if (fd.dwFileAttributes != INVALID_FILE_ATTRIBUTES)
+        std::unordered_map <uint32_t, tbf_tex_record_s> textures;
+        std::vector        <std::wstring>               arcs;
+
+        // Shutdown does not have to wait for a slow scan of every archive
+        if (! TBF_BuildInjectableIndex (textures, arcs, hInjectWatchShutdown))
         {
-          wchar_t* wszArchiveNameLwr =
-            _wcslwr (_wcsdup (fd.cFileName));
+          run = false;
+          break;
+        }
 
-          if ( wcsstr (wszArchiveNameLwr, L".7z") )
+        EnterCriticalSection (&cs_inject_watch);
+        {
+          if (staged_sources.ready)
           {
-            int tex_count = 0;
+            // The render thread has not picked up the last batch yet, keep
+            //   the touched files from both.
+            for ( auto checksum : staged_sources.changes.checksums )
+              changes.checksums.emplace (checksum);
+            for ( auto& arc     : staged_sources.changes.archives  )
+              changes.archives.emplace  (arc);
+          }
+
+          staged_sources.textures = std::move (textures);
+          staged_sources.archives = std::move (arcs);
+          staged_sources.changes  = std::move (changes);
+          staged_sources.ready    = true;
+        }
+        LeaveCriticalSection (&cs_inject_watch);
+
+        changes = tbf_inject_changes_s ();
+        dirty   = false;
+      } break;
 
-            CSzArEx       arc;
-            ISzAlloc      thread_alloc;
-            ISzAlloc      thread_tmp_alloc;
+      default:
+        run = false;
+        break;
+    }
+  }
 
-            thread_alloc.Alloc     = SzAlloc;
-            thread_alloc.Free      = SzFree;
+  if (reading)
+  {
+    DWORD dwBytes = 0;
 
-            thread_tmp_alloc.Alloc = SzAllocTemp;
-            thread_tmp_alloc.Free  = SzFreeTemp;
+    CancelIo            (hDir);
+    GetOverlappedResult (hDir, &ov, &dwBytes, TRUE);
+  }
 
-            wchar_t wszQualifiedArchiveName [MAX_PATH];
-            _swprintf ( wszQualifiedArchiveName,
-                          L"%s\\inject\\%s",
-                            TBFIX_TEXTURE_DIR,
-                              fd.cFileName );
+  CloseHandle (ov.hEvent);
+  CloseHandle (hDir);
 
-            if (InFile_OpenW (&arc_stream.file, wszQualifiedArchiveName))
-            {
-              tex_log->Log ( L"[Inject Tex]  ** Cannot open archive file: %s",
-                               wszQualifiedArchiveName );
-              continue;
-            }
+  return 0;
+}
+
+void
+TBF_StartInjectWatch (void)
+{
+  if (hInjectWatchThread != nullptr)
+    return;
+
+  if ( GetFileAttributesW (TBFIX_TEXTURE_DIR L"\\inject") ==
+         INVALID_FILE_ATTRIBUTES )
+    return;
 
-            SzArEx_Init (&arc);
+  InitializeCriticalSection (&cs_inject_watch);
 
-            if ( SzArEx_Open ( &arc,
-                                 &look_stream->s,
-                                   &thread_alloc,
-                                     &thread_tmp_alloc ) == SZ_OK )
-            {
-              uint32_t i;
+  hInjectWatchShutdown =
+    CreateEvent (nullptr, TRUE, FALSE, nullptr);
 
-              wchar_t wszEntry [MAX_PATH];
+  hInjectWatchThread =
+    (HANDLE)_beginthreadex ( nullptr, 0,
+                               TBF_InjectWatchThread,
+                                 nullptr,
+                                   0x00, nullptr );
 
-              for (i = 0; i < arc.NumFiles; i++)
-              {
-                if (SzArEx_IsDir (&arc, i))
-                  continue;
+  if (hInjectWatchThread != nullptr)
+    SetThreadPriority (hInjectWatchThread, THREAD_PRIORITY_BELOW_NORMAL);
+}
 
-                SzArEx_GetFileNameUtf16 (&arc, i, (UInt16 *)wszEntry);
+void
+TBF_StopInjectWatch (void)
+{
+  if (hInjectWatchThread == nullptr)
+    return;
 
-                // Truncate to 32-bits --> there's no way in hell a texture will ever be >= 2 GiB
-                size_t fileSize = SzArEx_GetFileSize (&arc, i);
+  // The thread may be part-way through an index build; it checks the event
+  //   between archives, and nothing below is safe until it has returned.
+  SetEvent            (hInjectWatchShutdown);
+  WaitForSingleObject (hInjectWatchThread, INFINITE);
 
-                wchar_t* wszFullName =
-                  _wcslwr (_wcsdup (wszEntry));
+  CloseHandle (hInjectWatchThread);
+  CloseHandle (hInjectWatchShutdown);
 
-                if ( wcsstr ( wszFullName, TBFIX_TEXTURE_EXT) )
-                {
-                  tbf_load_method_t method = DontCare;
+  hInjectWatchThread   = nullptr;
+  hInjectWatchShutdown = nullptr;
 
-                  uint32_t checksum;
-                  wchar_t* wszUnqualifiedEntry =
-                    wszFullName + wcslen (wszFullName);
+  DeleteCriticalSection (&cs_inject_watch);
+}
 
-                  // Strip the path
-                  while (  wszUnqualifiedEntry >= wszFullName &&
-                          *wszUnqualifiedEntry != L'/')
-                    wszUnqualifiedEntry--;
+//
+// Called once per-frame on the render thread
+//
+void
+TBF_ProcessInjectableChanges (void)
+{
+  TBF_FinishTexturePackBuild ();
+  TBF_TopUpResidentPool      ();
 
-                  if (*wszUnqualifiedEntry == L'/')
-                    ++wszUnqualifiedEntry;
+  if (hInjectWatchThread == nullptr)
+    return;
 
-                  swscanf (wszUnqualifiedEntry, L"%x" TBFIX_TEXTURE_EXT, &checksum);
+  // Worker threads look records up without a lock, so only swap the index
+  //   while none of them are running.
+  if (pending_loads () || pending_streams ())
+    return;
 
-                  // Already got this texture...
-                  if ( injectable_textures.count (checksum) ||
-                       inject_blacklist.count    (checksum) ) {
-                    free (wszFullName);
-                    continue;
-                  }
+  tbf_inject_changes_s                            changes;
+  std::unordered_map <uint32_t, tbf_tex_record_s> textures;
+  std::vector        <std::wstring>               arcs;
 
-                  if (wcsstr (wszFullName, L"streaming"))
-                    method = Streaming;
-                  else if (wcsstr (wszFullName, L"blocking"))
-                    method = Blocking;
+  EnterCriticalSection (&cs_inject_watch);
+  {
+    if (! staged_sources.ready)
+    {
+      LeaveCriticalSection (&cs_inject_watch);
+      return;
+    }
 
-                  tbf_tex_record_s rec;
-                  rec.size    = (uint32_t)fileSize;
-                  rec.archive = archive;
-                  rec.fileno  = i;
-                  rec.method  = method;
+    textures = std::move (staged_sources.textures);
+    arcs     = std::move (staged_sources.archives);
+    changes  = std::move (staged_sources.changes);
 
-                  injectable_textures.try_emplace (checksum, rec);
+    staged_sources.ready = false;
+  }
+  LeaveCriticalSection (&cs_inject_watch);
 
-                  ++tex_count;
-                  ++files;
+  tbf_inject_delta_s delta;
 
-                  liSize.QuadPart += rec.size;
-                }
+  TBF_DiffInjectableIndex ( injectable_textures, archives,
+                              textures,          arcs,
+                                changes, delta );
 
-                free (wszFullName);
-              }
+  injectable_textures.swap (textures);
+  archives.swap            (arcs);
 
-              if (tex_count > 0) {
-                ++archive;
-                archives.push_back (wszQualifiedArchiveName);
-              }
-            }
+  // Staged bytes may belong to a source that just changed
+  source_stager.clear ();
 
-            SzArEx_Free (&arc, &thread_alloc);
-            File_Close  (&arc_stream.file);
-          }
+  for ( auto list : { &delta.removed, &delta.updated } )
+  {
+    for ( auto checksum : *list )
+      resident_pool.forget (checksum);
+  }
 
-          free (wszArchiveNameLwr);
-        }
-      } while (FindNextFileW (hFind, &fd) != 0);
+  for ( auto list : { &delta.added, &delta.updated } )
+  {
+    for ( auto checksum : *list )
+    {
+      auto inject =
+        injectable_textures.find (checksum);
 
-      FindClose (hFind);
+      if (inject != injectable_textures.end () && inject->second.method == Blocking)
+        resident_topup.emplace (checksum);
     }
+  }
 
-    tex_log->LogEx ( false, L" %lu files (%3.1f MiB)\n",
-                       files, (double)liSize.QuadPart / (1024.0 * 1024.0) );
+  tex_log->Log ( L"[Inject Tex] Data sources changed:  %lu added, %lu removed, %lu updated",
+                   (unsigned long)delta.added.size   (),
+                   (unsigned long)delta.removed.size (),
+                   (unsigned long)delta.updated.size () );
+
+  int reloaded = 0,
+      injected = 0;
+
+  // Nothing to reload for these, the game's own texture is all they have
+  for ( auto checksum : delta.added )
+  {
+    if (tbf::RenderFix::tex_mgr.injectTexture (checksum))
+      ++injected;
   }
 
-  File_Close  (&arc_stream.file);
+  for ( auto list : { &delta.removed, &delta.updated } )
+  {
+    for ( auto checksum : *list )
+    {
+      if (tbf::RenderFix::tex_mgr.getTexture (checksum) != nullptr)
+      {
+        if (tbf::RenderFix::tex_mgr.reloadTexture (checksum))
+          ++reloaded;
+      }
+    }
+  }
+
+  if (reloaded > 0 || injected > 0)
+    tex_log->Log ( L"[Inject Tex]  >> %lu resident textures reloaded, %lu injected",
+                     reloaded, injected );
 }
 
 
 bool
 tbf::RenderFix::TextureManager::reloadTexture (uint32_t checksum)
 {
-  if ( injectable_textures.find (checksum) ==
-         injectable_textures.end () )
+  tbf::RenderFix::Texture* pCacheTex =
+    getTexture (checksum);
+
+  if (pCacheTex == nullptr)
     return false;
 
   EnterCriticalSection        (&cs_tex_stream);
 
   ISKTextureD3D9* pTex = 
-    getTexture (checksum)->d3d9_tex;
+    pCacheTex->d3d9_tex;
 
 
   if (pTex->pTexOverride != nullptr)
@@ -4465,6 +6866,75 @@ tbf::RenderFix::TextureManager::reloadTexture (uint32_t checksum)
     return false;
   }
 
+  // The injection source was removed, the original texture is all we have now
+  if ( injectable_textures.find (checksum) ==
+         injectable_textures.end () )
+  {
+    tex_log->LogEx ( false, L"source removed\n" );
+
+    LeaveCriticalSection (&cs_tex_stream);
+    return true;
+  }
+
+  streamInjection (checksum, pTex);
+
+  LeaveCriticalSection        (&cs_tex_stream);
+
+  if (pending_loads ())
+    TBFix_LoadQueuedTextures ();
+
+  return true;
+}
+
+//
+// For a resident texture whose checksum has only just become injectable; it
+//   has no override to throw away, so reloadTexture would refuse it.
+//
+bool
+tbf::RenderFix::TextureManager::injectTexture (uint32_t checksum)
+{
+  tbf::RenderFix::Texture* pCacheTex =
+    getTexture (checksum);
+
+  if (pCacheTex == nullptr)
+    return false;
+
+  if ( injectable_textures.find (checksum) ==
+         injectable_textures.end () )
+    return false;
+
+  EnterCriticalSection        (&cs_tex_stream);
+
+  ISKTextureD3D9* pTex =
+    pCacheTex->d3d9_tex;
+
+  // Already injected, or on its way
+  if (pTex->pTexOverride != nullptr || is_streaming (checksum))
+  {
+    LeaveCriticalSection (&cs_tex_stream);
+    return false;
+  }
+
+  tex_log->LogEx ( true, L"[Inject Tex] Injecting texture for checksum (%08x)... ",
+                       checksum );
+
+  streamInjection (checksum, pTex);
+
+  LeaveCriticalSection        (&cs_tex_stream);
+
+  if (pending_loads ())
+    TBFix_LoadQueuedTextures ();
+
+  return true;
+}
+
+//
+// Queues a stream job that replaces pTex's override with the current source
+//   for checksum; cs_tex_stream must be held.
+//
+void
+tbf::RenderFix::TextureManager::streamInjection (uint32_t checksum, ISKTextureD3D9* pTex)
+{
   tbf_tex_record_s record = injectable_textures [checksum];
 
   if (record.method == DontCare)
@@ -4540,13 +7010,6 @@ tbf::RenderFix::TextureManager::reloadTexture (uint32_t checksum)
 
     stream_pool.postJob (load_op);
   }
-
-  LeaveCriticalSection        (&cs_tex_stream);
-
-  if (pending_loads ())
-    TBFix_LoadQueuedTextures ();
-
-  return true;
 }
 
 void 
@@ -4563,6 +7026,41 @@ tbf::RenderFix::TextureManager::wantsScreenshot (void)
   return want_screenshot;
 }
 
+//
+// A capture waiting on the GPU: the frame is copied into a staging render
+//   target when it is taken, the copy into system memory happens a frame or
+//     two later once an event query issued behind the first copy has passed,
+//       so GetRenderTargetData no longer waits for the GPU to catch up.
+//
+#define TBF_SCREENSHOT_READBACK_FRAMES 4 // Stop waiting on the query after this many
+
+struct tbf_screenshot_readback_s {
+  IDirect3DSurface9* pResolved = nullptr;
+  IDirect3DQuery9*   pQuery    = nullptr;
+  D3DSURFACE_DESC    desc      = { };
+  tbf_screenshot_s*  shot      = nullptr;
+  int                frames    = 0;
+
+  void release (void)
+  {
+    if (pResolved != nullptr) pResolved->Release ();
+    if (pQuery    != nullptr) pQuery->Release    ();
+
+    delete shot;
+
+    pResolved = nullptr;
+    pQuery    = nullptr;
+    shot      = nullptr;
+    frames    = 0;
+  }
+} static screenshot_readback;
+
+void
+TBF_ReleaseScreenshotReadback (void)
+{
+  screenshot_readback.release ();
+}
+
 HRESULT
 tbf::RenderFix::TextureManager::takeScreenshot (IDirect3DSurface9* pSurf)
 {
@@ -4575,6 +7073,10 @@ tbf::RenderFix::TextureManager::takeScreenshot (IDirect3DSurface9* pSurf)
   if (FAILED (hr))
     return hr;
 
+  // Still waiting on the last one, wantsScreenshot () stays true until then
+  if (screenshot_readback.shot != nullptr)
+    return S_FALSE;
+
   static int count = 0;
 
   wchar_t wszOut   [MAX_PATH] = { };
@@ -4611,145 +7113,148 @@ tbf::RenderFix::TextureManager::takeScreenshot (IDirect3DSurface9* pSurf)
 
   want_screenshot = false;
 
-  static D3DXLoadSurfaceFromSurface_pfn
-    D3DXLoadSurfaceFromSurface =
-      (D3DXLoadSurfaceFromSurface_pfn)
-        GetProcAddress ( d3dx9_43_dll, "D3DXLoadSurfaceFromSurface" );
-
-  extern HMODULE hInjectorDLL;
-  
-  typedef void (WINAPI *SK_SteamAPI_AddScreenshotToLibrary_pfn)
-    (const char *pchFilename, const char *pchThumbnailFilename, int nWidth, int nHeight);
-  
-  static SK_SteamAPI_AddScreenshotToLibrary_pfn
-    SK_SteamAPI_AddScreenshotToLibrary =
-      (SK_SteamAPI_AddScreenshotToLibrary_pfn)
-        GetProcAddress ( hInjectorDLL,
-                           "SK_SteamAPI_AddScreenshotToLibrary" );
-
-  IDirect3DSurface9* pSurfScreenshot = nullptr;
-
-  if (SUCCEEDED ( D3D9CreateRenderTarget ( tbf::RenderFix::pDevice,
-                                             desc.Width, desc.Height,
-                                               desc.Format, desc.MultiSampleType, desc.MultiSampleQuality,
-                                                 TRUE,
-                                                   &pSurfScreenshot, nullptr
-                                         )
-                )
+  auto& readback = screenshot_readback;
+
+  if ( FAILED ( D3D9CreateRenderTarget ( tbf::RenderFix::pDevice,
+                                           desc.Width, desc.Height,
+                                             desc.Format, D3DMULTISAMPLE_NONE, 0,
+                                               FALSE,
+                                                 &readback.pResolved, nullptr
+                                       )
+              )
      )
   {
-    if ( SUCCEEDED ( D3D9StretchRect ( tbf::RenderFix::pDevice,
-                                         pSurf,           nullptr,
-                                         pSurfScreenshot, nullptr,
-                                           D3DTEXF_NONE
-                                     )
-                   )
-       )
-    {
-      outstanding_screenshots.emplace (pSurfScreenshot);
-
-      struct screenshot_params_s {
-        D3DSURFACE_DESC    desc;
-        IDirect3DSurface9* pSurf;
-        std::wstring       name_w, thumbnail_w;
-        std::string        name, thumbnail;
-      } *params =
-
-        new screenshot_params_s {
-          desc,
-            pSurfScreenshot,
-              wszOut, wszThumb,
-               szOut,  szThumb
-        };
-
-      CreateThread ( nullptr, 0,
-                       [](LPVOID user) ->
-                       DWORD
-      {
-        D3DXIMAGE_FILEFORMAT format = config.screenshots.keep ?
-           D3DXIFF_PNG : D3DXIFF_TGA;
+    readback.release ();
+    return E_FAIL;
+  }
+
+  if ( FAILED ( D3D9StretchRect ( tbf::RenderFix::pDevice,
+                                    pSurf,              nullptr,
+                                    readback.pResolved, nullptr,
+                                      D3DTEXF_NONE
+                                )
+              )
+     )
+  {
+    readback.release ();
+    return E_FAIL;
+  }
 
-        screenshot_params_s* params =
-          (screenshot_params_s *)user;
+  // Without a query the readback simply happens on the next frame
+  if (SUCCEEDED (tbf::RenderFix::pDevice->CreateQuery (D3DQUERYTYPE_EVENT, &readback.pQuery)))
+    readback.pQuery->Issue (D3DISSUE_END);
 
-        HRESULT hr =
-          D3DXSaveSurfaceToFileW ( params->name_w.c_str (),
-                                     format, params->pSurf,
-                                       nullptr, nullptr );
+  readback.desc = desc;
+  readback.shot = new tbf_screenshot_s;
 
-        bool with_thumbnail = false;
+  readback.shot->file      = wszOut;
+  readback.shot->file_ansi =  szOut;
 
-        if (config.screenshots.import_to_steam && SUCCEEDED (hr))
-        {
-          CComPtr <IDirect3DSurface9> pSurfThumb = nullptr;
-
-          if (SUCCEEDED ( D3D9CreateRenderTarget ( tbf::RenderFix::pDevice,
-                                                     200, (UINT)(((float)params->desc.Height / (float)params->desc.Width) * 200),
-                                                       params->desc.Format,
-                                                         D3DMULTISAMPLE_NONE, 0,
-                                                           TRUE, &pSurfThumb,
-                                                             nullptr
-                                                 )
-                        )
-             )
-          {
-            outstanding_screenshots.emplace (pSurfThumb);
-
-            // Slightly higher quality filtering than if we just used StretchRect with a linear filter,+
-            //   (200 x ...) pixels still sucks, but we can make it suck just a little bit less.
-            if (SUCCEEDED ( D3DXLoadSurfaceFromSurface ( pSurfThumb,
-                                                           nullptr, nullptr,
-                                                             params->pSurf,
-                                                               nullptr, nullptr,
-                                                                 D3DX_DEFAULT, 0xFF000000
-                                                       )
-                          )
-               )
-            {
-              if ( SUCCEEDED (
-                     D3DXSaveSurfaceToFileW ( params->thumbnail_w.c_str (),
-                                                D3DXIFF_TGA, pSurfThumb,
-                                                  nullptr, nullptr
-                                            )
-                             )
-                 )
-              {
-                SK_SteamAPI_AddScreenshotToLibrary (params->name.c_str (), params->thumbnail.c_str (), params->desc.Width, params->desc.Height);
-                with_thumbnail = true;
-              }
-            }
+  if (config.screenshots.import_to_steam)
+  {
+    readback.shot->thumbnail      = wszThumb;
+    readback.shot->thumbnail_ansi =  szThumb;
+  }
 
-            outstanding_screenshots.erase (pSurfThumb);
-          }
+  return S_OK;
+}
 
-          if (! with_thumbnail)
-            SK_SteamAPI_AddScreenshotToLibrary (params->name.c_str (), nullptr, params->desc.Width, params->desc.Height);
-        }
+//
+// Called once per-frame on the render thread; hands a captured frame to the
+//   encoder thread once the GPU is done copying it.
+//
+void
+tbf::RenderFix::TextureManager::readBackScreenshot (void)
+{
+  auto& readback = screenshot_readback;
 
-        outstanding_screenshots.erase (params->pSurf);
+  if (readback.shot == nullptr)
+    return;
 
-        params->pSurf->Release ();
+  if ( readback.pQuery != nullptr                               &&
+       readback.pQuery->GetData (nullptr, 0, 0x00) == S_FALSE    &&
+       ++readback.frames < TBF_SCREENSHOT_READBACK_FRAMES )
+    return;
 
-        delete params;
-      
-        CloseHandle (GetCurrentThread ());
-      
-        return 0;
-      },
+  const D3DSURFACE_DESC& desc = readback.desc;
 
-      params,
-        0,
-          nullptr
-      );
-    } 
+  CComPtr <IDirect3DSurface9> pSurfSysMem = nullptr;
 
-    else {
-      pSurfScreenshot->Release ();
-      return E_FAIL;
+  if ( FAILED ( tbf::RenderFix::pDevice->CreateOffscreenPlainSurface (
+                  desc.Width, desc.Height,
+                    desc.Format, D3DPOOL_SYSTEMMEM,
+                      &pSurfSysMem, nullptr )
+              ) ||
+       FAILED ( tbf::RenderFix::pDevice->GetRenderTargetData (readback.pResolved, pSurfSysMem) )
+     )
+  {
+    tex_log->Log (L"[Screenshot] Could not read back the captured frame");
+    readback.release ();
+    return;
+  }
+
+  // The encoder only understands 32-bit BGRA, anything else is converted once here
+  if (desc.Format != D3DFMT_A8R8G8B8 && desc.Format != D3DFMT_X8R8G8B8)
+  {
+    static D3DXLoadSurfaceFromSurface_pfn
+      D3DXLoadSurfaceFromSurface =
+        (D3DXLoadSurfaceFromSurface_pfn)
+          GetProcAddress ( d3dx9_43_dll, "D3DXLoadSurfaceFromSurface" );
+
+    CComPtr <IDirect3DSurface9> pSurfConverted = nullptr;
+
+    if ( FAILED ( tbf::RenderFix::pDevice->CreateOffscreenPlainSurface (
+                    desc.Width, desc.Height,
+                      D3DFMT_A8R8G8B8, D3DPOOL_SYSTEMMEM,
+                        &pSurfConverted, nullptr )
+                ) ||
+         FAILED ( D3DXLoadSurfaceFromSurface ( pSurfConverted, nullptr, nullptr,
+                                                 pSurfSysMem,    nullptr, nullptr,
+                                                   D3DX_FILTER_NONE, 0x00 )
+                )
+       )
+    {
+      tex_log->Log (L"[Screenshot] Could not convert the captured frame");
+      readback.release ();
+      return;
     }
+
+    pSurfSysMem = pSurfConverted;
   }
 
-  return S_OK;
+  D3DLOCKED_RECT lock = { };
+
+  if (FAILED (pSurfSysMem->LockRect (&lock, nullptr, D3DLOCK_READONLY)))
+  {
+    readback.release ();
+    return;
+  }
+
+  tbf_screenshot_s* shot =
+    readback.shot;
+
+  shot->width  = desc.Width;
+  shot->height = desc.Height;
+  shot->pixels.resize ((size_t)desc.Width * desc.Height);
+
+  for (UINT y = 0; y < desc.Height; y++)
+  {
+    const uint32_t* src =
+      (const uint32_t *)((const uint8_t *)lock.pBits + (size_t)y * lock.Pitch);
+          uint32_t* dst = &shot->pixels [(size_t)y * desc.Width];
+
+    // X8R8G8B8 leaves garbage in the alpha channel
+    for (UINT x = 0; x < desc.Width; x++)
+      dst [x] = src [x] | 0xFF000000;
+  }
+
+  pSurfSysMem->UnlockRect ();
+
+  // The queue owns it now, even if it turns it down
+  readback.shot = nullptr;
+  readback.release ();
+
+  TBF_QueueScreenshot (shot);
 }
 
 
@@ -0,0 +1,358 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include "usage_model.h"
+#include "log.h"
+
+#include <algorithm>
+
+extern iSK_Logger* tex_log;
+
+bool
+TBF_TextureUsageModel::load (const wchar_t* wszFileName)
+{
+  FILE* fModel =
+    _wfopen (wszFileName, L"rb");
+
+  if (fModel == nullptr)
+    return false;
+
+  uint32_t magic   = 0,
+           version = 0,
+           keys    = 0;
+
+  bool ok =
+    fread (&magic,   sizeof (uint32_t), 1, fModel) == 1 && magic   == MAGIC   &&
+    fread (&version, sizeof (uint32_t), 1, fModel) == 1 && version == VERSION &&
+    fread (&keys,    sizeof (uint32_t), 1, fModel) == 1;
+
+  for (uint32_t i = 0; ok && i < keys; i++)
+  {
+    uint32_t key   = 0,
+             count = 0;
+
+    ok = fread (&key,   sizeof (uint32_t), 1, fModel) == 1 &&
+         fread (&count, sizeof (uint32_t), 1, fModel) == 1 &&
+         count <= MAX_SUCCESSORS;
+
+    std::vector <successor_s>& succ =
+      successors_ [key];
+
+    for (uint32_t j = 0; ok && j < count; j++)
+    {
+      successor_s s;
+
+      ok = fread (&s.checksum, sizeof (uint32_t), 1, fModel) == 1 &&
+           fread (&s.weight,   sizeof (uint16_t), 1, fModel) == 1;
+
+      if (ok)
+        succ.push_back (s);
+    }
+  }
+
+  fclose (fModel);
+
+  if (! ok)
+  {
+    tex_log->Log ( L"[ Prefetch ] Usage model '%s' is invalid, starting over.",
+                     wszFileName );
+    successors_.clear ();
+  }
+
+  return ok;
+}
+
+bool
+TBF_TextureUsageModel::save (const wchar_t* wszFileName)
+{
+  FILE* fModel =
+    _wfopen (wszFileName, L"wb");
+
+  if (fModel == nullptr)
+    return false;
+
+  uint32_t magic   = MAGIC,
+           version = VERSION,
+           keys    = (uint32_t)successors_.size ();
+
+  fwrite (&magic,   sizeof (uint32_t), 1, fModel);
+  fwrite (&version, sizeof (uint32_t), 1, fModel);
+  fwrite (&keys,    sizeof (uint32_t), 1, fModel);
+
+  for ( auto& it : successors_ )
+  {
+    uint32_t count = (uint32_t)it.second.size ();
+
+    fwrite (&it.first, sizeof (uint32_t), 1, fModel);
+    fwrite (&count,    sizeof (uint32_t), 1, fModel);
+
+    for ( auto& s : it.second )
+    {
+      fwrite (&s.checksum, sizeof (uint32_t), 1, fModel);
+      fwrite (&s.weight,   sizeof (uint16_t), 1, fModel);
+    }
+  }
+
+  bool ret = (ferror (fModel) == 0);
+
+  fclose (fModel);
+
+  return ret;
+}
+
+bool
+TBF_TextureUsageModel::firstUse (uint32_t checksum, uint32_t frame)
+{
+  if (! session_seen_.emplace (checksum).second)
+    return false;
+
+  session_.push_back (std::make_pair (checksum, frame));
+
+  return true;
+}
+
+void
+TBF_TextureUsageModel::predict ( uint32_t checksum, std::vector <uint32_t>& out,
+                                 uint16_t min_weight ) const
+{
+  auto it =
+    successors_.find (checksum);
+
+  if (it == successors_.end ())
+    return;
+
+  for ( auto& s : it->second )
+  {
+    if (s.weight >= min_weight)
+      out.push_back (s.checksum);
+  }
+}
+
+void
+TBF_TextureUsageModel::commitSession (void)
+{
+  // Older sessions fade out; a pair has to keep showing up to stay predicted
+  for ( auto& it : successors_ )
+  {
+    for ( auto& s : it.second )
+      s.weight = (uint16_t)((s.weight * 3) / 4);
+  }
+
+  std::unordered_map <uint32_t, uint32_t> weights;
+
+  for (size_t i = 0; i < session_.size (); i++)
+  {
+    std::vector <successor_s>& succ =
+      successors_ [session_ [i].first];
+
+    weights.clear ();
+
+    for ( auto& s : succ )
+      weights [s.checksum] = s.weight;
+
+    for ( size_t j = i + 1;
+                 j < session_.size () && j - i <= 256 &&
+                 session_ [j].second - session_ [i].second <= WINDOW_FRAMES;
+               ++j )
+    {
+      weights [session_ [j].first] += WEIGHT_HIT;
+    }
+
+    succ.clear ();
+
+    for ( auto& w : weights )
+    {
+      if (w.second > 0)
+        succ.push_back ({ w.first, (uint16_t)std::min (w.second, (uint32_t)0xFFFF) });
+    }
+
+    std::sort ( succ.begin (), succ.end (),
+                  [](const successor_s& a, const successor_s& b) {
+                    return a.weight > b.weight;
+                  } );
+
+    if (succ.size () > MAX_SUCCESSORS)
+      succ.resize (MAX_SUCCESSORS);
+  }
+
+  // Drop whatever decayed to nothing
+  for (auto it = successors_.begin (); it != successors_.end (); )
+  {
+    auto& succ = it->second;
+
+    succ.erase ( std::remove_if ( succ.begin (), succ.end (),
+                                    [](const successor_s& s) { return s.weight == 0; } ),
+                   succ.end () );
+
+    if (succ.empty ())
+      it = successors_.erase (it);
+    else
+      ++it;
+  }
+
+  session_.clear      ();
+  session_seen_.clear ();
+}
+
+bool
+TBF_TextureUsageModel::appendSession (const wchar_t* wszTraceFile) const
+{
+  if (session_.empty ())
+    return false;
+
+  FILE* fTrace =
+    _wfopen (wszTraceFile, L"ab");
+
+  if (fTrace == nullptr)
+    return false;
+
+  fseek (fTrace, 0, SEEK_END);
+
+  const long size  = ftell (fTrace);
+  uint32_t   count = (uint32_t)session_.size ();
+
+  // A few KiB per session; a trace this large has plenty to learn from
+  if ( size < 0 ||
+       size + (long)sizeof (uint32_t) * (1L + 2L * count) > MAX_TRACE_SIZE )
+  {
+    fclose (fTrace);
+    return false;
+  }
+
+  if (size == 0)
+  {
+    uint32_t hdr [2] = { TRACE_MAGIC, TRACE_VERSION };
+    fwrite (hdr, sizeof hdr, 1, fTrace);
+  }
+
+  fwrite (&count, sizeof (uint32_t), 1, fTrace);
+
+  for ( auto& use : session_ )
+  {
+    fwrite (&use.first,  sizeof (uint32_t), 1, fTrace);
+    fwrite (&use.second, sizeof (uint32_t), 1, fTrace);
+  }
+
+  bool ret = (ferror (fTrace) == 0);
+
+  fclose (fTrace);
+
+  return ret;
+}
+
+bool
+TBF_TextureUsageModel::loadSessions ( const wchar_t*                      wszTraceFile,
+                                      std::vector <tbf_usage_session_t>& sessions )
+{
+  sessions.clear ();
+
+  FILE* fTrace =
+    _wfopen (wszTraceFile, L"rb");
+
+  if (fTrace == nullptr)
+    return false;
+
+  fseek (fTrace, 0, SEEK_END);
+  const long file_size = ftell (fTrace);
+  fseek (fTrace, 0, SEEK_SET);
+
+  uint32_t hdr [2] = { };
+
+  bool ok =
+    fread (hdr, sizeof hdr, 1, fTrace) == 1 &&
+    hdr [0] == TRACE_MAGIC && hdr [1] == TRACE_VERSION;
+
+  // A session cut short (the game died while writing it) ends the trace
+  uint32_t count = 0;
+
+  while ( ok && fread (&count, sizeof (uint32_t), 1, fTrace) == 1 &&
+                (uint64_t)count * 2ULL * sizeof (uint32_t) <=
+                  (uint64_t)(file_size - ftell (fTrace)) )
+  {
+    tbf_usage_session_t session (count);
+
+    for ( auto& use : session )
+    {
+      fread (&use.first,  sizeof (uint32_t), 1, fTrace);
+      fread (&use.second, sizeof (uint32_t), 1, fTrace);
+    }
+
+    sessions.emplace_back (std::move (session));
+  }
+
+  fclose (fTrace);
+
+  return ok;
+}
+
+void
+TBF_TextureUsageModel::trainSession (const tbf_usage_session_t& session)
+{
+  session_.clear      ();
+  session_seen_.clear ();
+
+  for ( auto& use : session )
+    firstUse (use.first, use.second);
+
+  commitSession ();
+}
+
+void
+TBF_TextureUsageModel::evaluate ( const tbf_usage_session_t& session, uint16_t min_weight,
+                                  tbf_usage_eval_s&          eval ) const
+{
+  // Checksum -> frame it was first predicted in
+  std::unordered_map <uint32_t, uint32_t> predicted;
+  std::unordered_set <uint32_t>           seen;
+  std::vector        <uint32_t>           next;
+
+  for ( auto& use : session )
+  {
+    if (! seen.emplace (use.first).second)
+      continue;
+
+    ++eval.first_uses;
+
+    auto it =
+      predicted.find (use.first);
+
+    if (it != predicted.end ())
+    {
+      ++eval.covered;
+      eval.lead_frames += use.second - it->second;
+    }
+
+    // The game does not stage what it already has
+    next.clear ();
+    predict (use.first, next, min_weight);
+
+    for ( auto checksum : next )
+    {
+      if ( (! seen.count (checksum)) &&
+           predicted.emplace (checksum, use.second).second )
+        ++eval.predicted;
+    }
+  }
+}
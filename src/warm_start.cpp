@@ -0,0 +1,118 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "warm_start.h"
+
+#include <cstdio>
+#include <algorithm>
+
+void
+TBF_WarmStartSet::use (uint32_t checksum, uint32_t frame)
+{
+  auto it =
+    session_.find (checksum);
+
+  if (it == session_.end ())
+    session_.emplace (checksum, tbf_warm_entry_s { checksum, frame, 1 });
+  else
+    ++it->second.frames_used;
+}
+
+bool
+TBF_WarmStartSet::save (const wchar_t* wszFileName) const
+{
+  // Nothing was injected (e.g. the game never got past the intro), keep the old list
+  if (session_.empty ())
+    return false;
+
+  std::vector <tbf_warm_entry_s> entries;
+  entries.reserve (session_.size ());
+
+  for ( auto& it : session_ )
+    entries.push_back (it.second);
+
+  std::sort ( entries.begin (), entries.end (),
+                [](const tbf_warm_entry_s& a, const tbf_warm_entry_s& b) {
+                  return a.first_frame != b.first_frame ?
+                           a.first_frame <  b.first_frame :
+                           a.frames_used >  b.frames_used;
+                } );
+
+  FILE* fWarm =
+    _wfopen (wszFileName, L"wb");
+
+  if (fWarm == nullptr)
+    return false;
+
+  uint32_t magic   = MAGIC,
+           version = VERSION,
+           count   = (uint32_t)entries.size ();
+
+  fwrite (&magic,   sizeof (uint32_t), 1, fWarm);
+  fwrite (&version, sizeof (uint32_t), 1, fWarm);
+  fwrite (&count,   sizeof (uint32_t), 1, fWarm);
+
+  fwrite (entries.data (), sizeof (tbf_warm_entry_s), count, fWarm);
+
+  bool ret = (ferror (fWarm) == 0);
+
+  fclose (fWarm);
+
+  return ret;
+}
+
+bool
+TBF_WarmStartSet::load (const wchar_t* wszFileName, std::vector <tbf_warm_entry_s>& entries)
+{
+  entries.clear ();
+
+  FILE* fWarm =
+    _wfopen (wszFileName, L"rb");
+
+  if (fWarm == nullptr)
+    return false;
+
+  uint32_t magic   = 0,
+           version = 0,
+           count   = 0;
+
+  bool ok =
+    fread (&magic,   sizeof (uint32_t), 1, fWarm) == 1 && magic   == MAGIC   &&
+    fread (&version, sizeof (uint32_t), 1, fWarm) == 1 && version == VERSION &&
+    fread (&count,   sizeof (uint32_t), 1, fWarm) == 1 && count   <  (1UL << 20);
+
+  if (ok)
+  {
+    entries.resize (count);
+
+    ok = fread (entries.data (), sizeof (tbf_warm_entry_s), count, fWarm) == count;
+  }
+
+  fclose (fWarm);
+
+  if (! ok)
+    entries.clear ();
+
+  return ok;
+}
@@ -0,0 +1,367 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+//
+// Screenshot encoder on synthetic framebuffers (see image_encode.h)
+//
+//   Times the BGRA -> RGBA swizzle, the thumbnail's box downscale (against
+//     the one pixel per iteration loop it replaced, which must agree with it
+//       exactly) and PNG encoding with 1..N threads deflating bands of rows.
+//         With zlib on the host, every PNG is inflated again and compared
+//           with the framebuffer it came from.
+//
+//   usage:  bench_image_encode [-r <repeats>]
+//
+
+#include "tbf_test.h"
+#include "tbf_bench.h"
+#include "image_encode.h"
+
+#include <emmintrin.h>
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#ifdef TBF_BENCH_ZLIB
+# include <zlib.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// render.cpp has the real one
+uint32_t
+crc32 (uint32_t crc, const void *buf, size_t size)
+{
+  const uint8_t* p = (const uint8_t *)buf;
+
+  crc = ~crc;
+
+  while (size-- > 0)
+  {
+    crc ^= *p++;
+
+    for (int k = 0; k < 8; k++)
+      crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+  }
+
+  return ~crc;
+}
+
+// A frame with some of everything: gradients, flat areas, and noise
+static std::vector <uint32_t>
+make_frame (uint32_t width, uint32_t height)
+{
+  std::vector <uint32_t> frame ((size_t)width * height);
+  uint32_t               seed = width * 31U + height;
+
+  for (uint32_t y = 0; y < height; y++)
+  {
+    for (uint32_t x = 0; x < width; x++)
+    {
+      seed = seed * 1664525U + 1013904223U;
+
+      uint32_t b = (x * 255U) / width;
+      uint32_t g = (y * 255U) / height;
+      uint32_t r = ((x / 64 + y / 64) & 1) ? 200U : 40U;
+
+      // Noisy bottom third, like foliage or particles
+      if (y > (height * 2) / 3)
+        r = (r + (seed >> 24)) & 0xFF;
+
+      frame [(size_t)y * width + x] = (seed & 0xFF000000U) | (r << 16) | (g << 8) | b;
+    }
+  }
+
+  return frame;
+}
+
+// The loop TBF_BoxDownscaleBGRA had before it took four pixels at a time
+static void
+box_downscale_1px ( const uint32_t* src, uint32_t src_width, uint32_t src_height,
+                          uint32_t* dst, uint32_t dst_width, uint32_t dst_height )
+{
+  const __m128i zero = _mm_setzero_si128 ();
+
+  for (uint32_t y = 0; y < dst_height; y++)
+  {
+    uint32_t y0 = (uint32_t)(((uint64_t) y      * src_height) / dst_height);
+    uint32_t y1 = (uint32_t)(((uint64_t)(y + 1) * src_height) / dst_height);
+
+    if (y1 <= y0) y1 = y0 + 1;
+
+    for (uint32_t x = 0; x < dst_width; x++)
+    {
+      uint32_t x0 = (uint32_t)(((uint64_t) x      * src_width) / dst_width);
+      uint32_t x1 = (uint32_t)(((uint64_t)(x + 1) * src_width) / dst_width);
+
+      if (x1 <= x0) x1 = x0 + 1;
+
+      __m128i sum = zero;
+
+      for (uint32_t sy = y0; sy < y1; sy++)
+      {
+        const uint32_t* row = src + (size_t)sy * src_width;
+
+        for (uint32_t sx = x0; sx < x1; sx++)
+        {
+          __m128i px =
+            _mm_cvtsi32_si128 ((int)row [sx]);
+
+          px  = _mm_unpacklo_epi16 (_mm_unpacklo_epi8 (px, zero), zero);
+          sum = _mm_add_epi32      (sum, px);
+        }
+      }
+
+      uint32_t area = (x1 - x0) * (y1 - y0);
+
+      uint32_t lanes [4];
+      _mm_storeu_si128 ((__m128i *)lanes, sum);
+
+      dst [(size_t)y * dst_width + x] =
+        ( ((lanes [0] + area / 2) / area)       ) |
+        ( ((lanes [1] + area / 2) / area) <<  8 ) |
+        ( ((lanes [2] + area / 2) / area) << 16 ) |
+        ( ((lanes [3] + area / 2) / area) << 24 );
+    }
+  }
+}
+
+static void
+encode_png (const wchar_t* wszFileName, const std::vector <uint32_t>& frame,
+            uint32_t width, uint32_t height, int threads)
+{
+  TBF_PNGEncoder png;
+
+  png.begin (frame.data (), width, height, threads);
+
+  std::atomic <size_t>      next (0);
+  std::vector <std::thread> helpers;
+
+  auto work = [&]
+  {
+    for (size_t band = next++; band < png.numBands (); band = next++)
+      png.deflateBand (band);
+  };
+
+  for (int i = 1; i < threads; i++)
+    helpers.emplace_back (work);
+
+  work ();
+
+  for (auto& helper : helpers)
+    helper.join ();
+
+  TBF_CHECK (png.finish (wszFileName));
+}
+
+#ifdef TBF_BENCH_ZLIB
+// Inflates the IDAT stream, undoes the Sub filter and compares every pixel
+static bool
+png_matches (const char* szFileName, const std::vector <uint32_t>& frame,
+             uint32_t width, uint32_t height)
+{
+  std::vector <uint8_t> file ((size_t)fs::file_size (szFileName));
+
+  FILE* fPNG = fopen (szFileName, "rb");
+  file.resize (fread (file.data (), 1, file.size (), fPNG));
+  fclose (fPNG);
+
+  std::vector <uint8_t> zlib;
+
+  for (size_t pos = 8; pos + 12 <= file.size ();)
+  {
+    uint32_t len = ((uint32_t)file [pos]     << 24) | ((uint32_t)file [pos + 1] << 16) |
+                   ((uint32_t)file [pos + 2] <<  8) |  (uint32_t)file [pos + 3];
+
+    if (pos + 12 + len > file.size ())
+      return false;
+
+    uint32_t crc = ((uint32_t)file [pos + 8 + len]  << 24) | ((uint32_t)file [pos + 9 + len]  << 16) |
+                   ((uint32_t)file [pos + 10 + len] <<  8) |  (uint32_t)file [pos + 11 + len];
+
+    if (crc != crc32 (0, &file [pos + 4], len + 4))
+      return false;
+
+    if (! memcmp (&file [pos + 4], "IDAT", 4))
+      zlib.insert (zlib.end (), &file [pos + 8], &file [pos + 8] + len);
+
+    pos += 12 + len;
+  }
+
+  const size_t          stride = (size_t)width * 4 + 1;
+  std::vector <uint8_t> raw (stride * height);
+  uLongf                raw_len = (uLongf)raw.size ();
+
+  if ( uncompress (raw.data (), &raw_len, zlib.data (), (uLong)zlib.size ()) != Z_OK ||
+       raw_len != raw.size () )
+    return false;
+
+  for (uint32_t y = 0; y < height; y++)
+  {
+    uint8_t* row = &raw [y * stride];
+
+    if (row [0] != 1)
+      return false;
+
+    for (size_t x = 4; x < (size_t)width * 4; x++)
+      row [1 + x] = (uint8_t)(row [1 + x] + row [1 + x - 4]);
+
+    for (uint32_t x = 0; x < width; x++)
+    {
+      uint32_t px = frame [(size_t)y * width + x];
+
+      if ( row [1 + x * 4 + 0] != ((px >> 16) & 0xFF) ||
+           row [1 + x * 4 + 1] != ((px >>  8) & 0xFF) ||
+           row [1 + x * 4 + 2] != ( px        & 0xFF) ||
+           row [1 + x * 4 + 3] != 0xFF )
+        return false;
+    }
+  }
+
+  return true;
+}
+#endif
+
+int
+main (int argc, char** argv)
+{
+  int repeats = tbf_bench_quick () ? 1 : 5;
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (! strcmp (argv [i], "-r")) repeats = atoi (argv [i + 1]);
+  }
+
+  struct { uint32_t width, height; } sizes [] = {
+    { 1280,  720 }, { 1920, 1080 }, { 3840, 2160 }
+  };
+
+  std::vector <int> thread_counts = { 1, 2, 4 };
+
+  const int hw_threads =
+    std::max (1, (int)std::thread::hardware_concurrency ());
+
+  if (hw_threads > 4)
+    thread_counts.push_back (hw_threads);
+
+  for ( auto& size : sizes )
+  {
+    if (tbf_bench_quick () && size.width > 1280)
+      break;
+
+    const uint32_t width  = size.width,
+                   height = size.height;
+    const double   mpix   = (double)width * height / 1e6;
+
+    std::vector <uint32_t> frame = make_frame (width, height);
+    std::vector <uint32_t> rgba  (frame.size ());
+
+    printf ("%ux%u\n", width, height);
+
+    // Swizzle
+    double start = tbf_bench_ms ();
+
+    for (int r = 0; r < repeats; r++)
+      TBF_SwizzleBGRAtoRGBA (frame.data (), rgba.data (), frame.size ());
+
+    double ms = (tbf_bench_ms () - start) / repeats;
+
+    printf ("  swizzle              %8.2f ms  %8.1f MPix/s\n", ms, mpix / (ms / 1000.0));
+
+    // Steam thumbnail, as TBF_EncodeScreenshot sizes it
+    const uint32_t thumb_width  = 200;
+    const uint32_t thumb_height =
+      std::max (1U, (uint32_t)(((float)height / (float)width) * 200));
+
+    std::vector <uint32_t> thumb_1px ((size_t)thumb_width * thumb_height);
+    std::vector <uint32_t> thumb_4px ((size_t)thumb_width * thumb_height);
+
+    start = tbf_bench_ms ();
+
+    for (int r = 0; r < repeats; r++)
+      box_downscale_1px ( frame.data (),     width,       height,
+                          thumb_1px.data (), thumb_width, thumb_height );
+
+    double ms_1px = (tbf_bench_ms () - start) / repeats;
+
+    start = tbf_bench_ms ();
+
+    for (int r = 0; r < repeats; r++)
+      TBF_BoxDownscaleBGRA ( frame.data (),     width,       height,
+                             thumb_4px.data (), thumb_width, thumb_height );
+
+    double ms_4px = (tbf_bench_ms () - start) / repeats;
+
+    printf ( "  thumbnail 1 px/iter  %8.2f ms  %8.1f MPix/s\n"
+             "  thumbnail 4 px/iter  %8.2f ms  %8.1f MPix/s\n",
+               ms_1px, mpix / (ms_1px / 1000.0),
+               ms_4px, mpix / (ms_4px / 1000.0) );
+
+    TBF_CHECK (thumb_1px == thumb_4px);
+
+    // Odd sizes leave a tail on every row of every box
+    std::vector <uint32_t> odd_1px (37 * 23), odd_4px (37 * 23);
+
+    box_downscale_1px    (frame.data (), width, height, odd_1px.data (), 37, 23);
+    TBF_BoxDownscaleBGRA (frame.data (), width, height, odd_4px.data (), 37, 23);
+
+    TBF_CHECK (odd_1px == odd_4px);
+
+    // TGA, for reference
+    start = tbf_bench_ms ();
+
+    for (int r = 0; r < repeats; r++)
+      TBF_CHECK (TBF_WriteTGA (L"bench_image_encode.tga", frame.data (), width, height));
+
+    ms = (tbf_bench_ms () - start) / repeats;
+
+    printf ("  tga                  %8.2f ms  %8.1f MPix/s\n", ms, mpix / (ms / 1000.0));
+
+    // PNG
+    for (int threads : thread_counts)
+    {
+      start = tbf_bench_ms ();
+
+      for (int r = 0; r < repeats; r++)
+        encode_png (L"bench_image_encode.png", frame, width, height, threads);
+
+      ms = (tbf_bench_ms () - start) / repeats;
+
+      printf ( "  png, %2d thread(s)    %8.2f ms  %8.1f MPix/s  %5.1f%% of raw\n",
+                 threads, ms, mpix / (ms / 1000.0),
+                   100.0 * (double)fs::file_size ("bench_image_encode.png") /
+                           ((double)width * height * 4.0) );
+
+#ifdef TBF_BENCH_ZLIB
+      TBF_CHECK (png_matches ("bench_image_encode.png", frame, width, height));
+#endif
+    }
+  }
+
+  fs::remove ("bench_image_encode.tga");
+  fs::remove ("bench_image_encode.png");
+
+  return TBF_TEST_RESULT ();
+}
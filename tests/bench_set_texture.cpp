@@ -0,0 +1,287 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+//
+// The per-bind bookkeeping in D3D9SetTexture_Detour on a mock device's bind
+//   stream, against what it did before it was trimmed:
+//
+//     before:  QueryInterface to recognize a wrapped texture, emplace into an
+//                unordered_set, a clock read for last_used and a lookup in
+//                  the set of NPOT textures
+//     after:   a vtable compare, a frame generation stamp that lets only the
+//                first bind of a frame reach a TBF_FrameSet, the NPOT flag
+//                  read from the texture
+//
+//   Each frame ends like TBFix_LogUsedTextures: walk the used set, clear it.
+//     Both ways must find the same textures used and clamp the same binds.
+//
+//   usage:  bench_set_texture [-f <frames>]
+//
+
+#include "tbf_test.h"
+#include "tbf_bench.h"
+#include "frame_set.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+#include <vector>
+
+static const int NUM_WRAPPED  = 3000;  // Injectable / cached game textures
+static const int NUM_FOREIGN  = 200;   // Render targets and the like
+static const int WORKING_SET  = 600;   // Distinct textures bound per frame
+static const int FRAME_BINDS  = 6000;  // Sampler binds per frame
+
+struct mock_iid_s {
+  uint32_t data [4];
+};
+
+static const mock_iid_s IID_MockSKTexture = { { 0x3a8f0dc4U, 0x11e5a4b3U, 0x89e1f2d4U, 0x7c0e53aaU } };
+
+// Stand-in for IDirect3DBaseTexture9, only what the detour calls
+class mock_texture_s
+{
+public:
+  virtual ~mock_texture_s (void) = default;
+
+  virtual long QueryInterface (const mock_iid_s& riid, void** ppvObj)
+  {
+    (void)riid;
+
+    *ppvObj = nullptr;
+
+    return -1; // E_NOINTERFACE
+  }
+};
+
+// Stand-in for ISKTextureD3D9
+class mock_sk_texture_s : public mock_texture_s
+{
+public:
+  long QueryInterface (const mock_iid_s& riid, void** ppvObj) override
+  {
+    if (! memcmp (&riid, &IID_MockSKTexture, sizeof (mock_iid_s)))
+    {
+      *ppvObj = this;
+      return 0;    // S_OK
+    }
+
+    return mock_texture_s::QueryInterface (riid, ppvObj);
+  }
+
+  uint32_t tex_crc32     = 0;
+  bool     npot          = false;
+  uint32_t last_used     = 0;  // After: frame generation
+  int64_t  last_used_qpc = 0;  // Before: clock sample
+};
+
+static void* mock_sk_vftable = nullptr;
+
+static uint32_t seed = 4242;
+
+static uint32_t
+rnd (void)
+{
+  seed = seed * 1664525U + 1013904223U;
+  return seed >> 8;
+}
+
+// QueryPerformanceCounter on the host
+static int64_t
+qpc (void)
+{
+  return std::chrono::steady_clock::now ().time_since_epoch ().count ();
+}
+
+struct frame_result_s {
+  std::vector <uint32_t> used;
+  uint64_t               clamped = 0;
+};
+
+static void
+frame_before ( const std::vector <mock_texture_s *>& binds,
+               std::unordered_set <uint32_t>&       used,
+               const std::unordered_set <uint32_t>& npot,
+               frame_result_s&                      result )
+{
+  for ( auto* pTexture : binds )
+  {
+    void* dontcare;
+
+    if ( pTexture != nullptr &&
+         pTexture->QueryInterface (IID_MockSKTexture, &dontcare) == 0 )
+    {
+      mock_sk_texture_s* pSKTex =
+        (mock_sk_texture_s *)pTexture;
+
+      used.emplace (pSKTex->tex_crc32);
+
+      pSKTex->last_used_qpc = qpc ();
+
+      if (npot.count (pSKTex->tex_crc32))
+        ++result.clamped;
+    }
+  }
+
+  for ( auto it : used )
+    result.used.push_back (it);
+
+  used.clear ();
+}
+
+static void
+frame_after ( const std::vector <mock_texture_s *>& binds,
+              TBF_FrameSet&                        used,
+              uint32_t&                            texture_frame,
+              frame_result_s&                      result )
+{
+  for ( auto* pTexture : binds )
+  {
+    if (pTexture != nullptr && *(void **)pTexture == mock_sk_vftable)
+    {
+      mock_sk_texture_s* pSKTex =
+        (mock_sk_texture_s *)pTexture;
+
+      if (pSKTex->last_used != texture_frame)
+      {
+        pSKTex->last_used = texture_frame;
+        used.insert (pSKTex->tex_crc32);
+      }
+
+      if (pSKTex->npot)
+        ++result.clamped;
+    }
+  }
+
+  for ( auto it : used )
+    result.used.push_back (it);
+
+  used.clear ();
+
+  ++texture_frame;
+}
+
+int
+main (int argc, char** argv)
+{
+  int frames = tbf_bench_quick () ? 20 : 2000;
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (! strcmp (argv [i], "-f")) frames = atoi (argv [i + 1]);
+  }
+
+  std::vector <mock_sk_texture_s> wrapped (NUM_WRAPPED);
+  std::vector <mock_texture_s>    foreign (NUM_FOREIGN);
+
+  std::unordered_set <uint32_t> npot_set;
+
+  for ( auto& tex : wrapped )
+  {
+    tex.tex_crc32 = rnd () * 2654435761U;
+    tex.npot      = (rnd () % 8) == 0;
+
+    if (tex.npot)
+      npot_set.emplace (tex.tex_crc32);
+  }
+
+  mock_sk_vftable = *(void **)&wrapped [0];
+
+  //
+  // Each frame binds a working set drawn from one of a few areas, most of
+  //   them many times over, with render targets and unbinds mixed in
+  //
+  std::vector <std::vector <mock_texture_s *>> frame_binds (16);
+
+  for ( auto& binds : frame_binds )
+  {
+    const int area = rnd () % (NUM_WRAPPED / WORKING_SET);
+
+    binds.reserve (FRAME_BINDS);
+
+    for (int i = 0; i < FRAME_BINDS; i++)
+    {
+      uint32_t r = rnd ();
+
+      if      (r % 16 == 0) binds.push_back (&foreign [rnd () % NUM_FOREIGN]);
+      else if (r % 16 == 1) binds.push_back (nullptr);
+      else                  binds.push_back (&wrapped [area * WORKING_SET + rnd () % WORKING_SET]);
+    }
+  }
+
+  std::unordered_set <uint32_t> used_before;
+  TBF_FrameSet                  used_after (2048);
+  uint32_t                      texture_frame = 1;
+
+  used_before.reserve (2048);
+
+  // Agree frame for frame
+  for ( auto& binds : frame_binds )
+  {
+    frame_result_s before, after;
+
+    frame_before (binds, used_before, npot_set, before);
+    frame_after  (binds, used_after,  texture_frame, after);
+
+    TBF_CHECK_EQ (before.clamped, after.clamped);
+
+    std::sort (before.used.begin (), before.used.end ());
+    std::sort (after.used.begin  (), after.used.end  ());
+
+    TBF_CHECK (before.used == after.used);
+  }
+
+  frame_result_s result;
+
+  double start = tbf_bench_ms ();
+
+  for (int f = 0; f < frames; f++)
+  {
+    frame_before (frame_binds [f % frame_binds.size ()], used_before, npot_set, result);
+    result.used.clear ();
+  }
+
+  double ms_before = tbf_bench_ms () - start;
+
+  start = tbf_bench_ms ();
+
+  for (int f = 0; f < frames; f++)
+  {
+    frame_after (frame_binds [f % frame_binds.size ()], used_after, texture_frame, result);
+    result.used.clear ();
+  }
+
+  double ms_after = tbf_bench_ms () - start;
+
+  tbf_bench_keep (result.clamped);
+
+  const double binds = (double)frames * FRAME_BINDS;
+
+  printf ( "%d frames of %d binds (%d textures each)\n"
+           "  before  %8.2f ms  %6.2f ns/bind\n"
+           "  after   %8.2f ms  %6.2f ns/bind\n",
+             frames, FRAME_BINDS, WORKING_SET,
+               ms_before, ms_before * 1e6 / binds,
+               ms_after,  ms_after  * 1e6 / binds );
+
+  return TBF_TEST_RESULT ();
+}
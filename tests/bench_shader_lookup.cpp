@@ -0,0 +1,255 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+//
+// Shader bind bookkeeping from D3D9SetVertexShader_Detour on a synthetic
+//   bind stream, against what it did before TBF_ShaderCache:
+//
+//     before:  std::unordered_map <void*, uint32_t>, probed up to three times
+//                per bind (operator[] inserting a zero for null shaders) and
+//                  an unordered_set of the shaders used this frame
+//     after:   TBF_ShaderCache, the record's frame stamp and a TBF_FrameSet
+//
+//   Shaders are heap objects, a scene binds a few dozen of them over and
+//     over. Both ways must agree on every checksum and every frame's set.
+//
+//   usage:  bench_shader_lookup [-f <frames>]
+//
+
+#include "tbf_test.h"
+#include "tbf_bench.h"
+#include "shader_cache.h"
+#include "frame_set.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+static const int NUM_SHADERS = 2500;  // Created over a session
+static const int SCENE       = 90;    // Distinct shaders bound per frame
+static const int FRAME_BINDS = 4000;  // SetVertexShader calls per frame
+
+// Stand-in for IDirect3DVertexShader9; the checksum is what GetFunction + crc32 yields
+struct mock_shader_s {
+  uint32_t crc32;
+  uint8_t  body [92];
+};
+
+static uint32_t seed = 31337;
+
+static uint32_t
+rnd (void)
+{
+  seed = seed * 1664525U + 1013904223U;
+  return seed >> 8;
+}
+
+struct frame_result_s {
+  uint64_t               checksums = 0; // Sum over every bind
+  std::vector <uint32_t> used;
+};
+
+static void
+frame_before ( const std::vector <mock_shader_s *>&     binds,
+               std::unordered_map <void *, uint32_t>& checksums,
+               std::unordered_set <uint32_t>&         used,
+               frame_result_s&                        result )
+{
+  void* g_pVS = nullptr;
+
+  for ( auto* pShader : binds )
+  {
+    uint32_t vs_checksum = 0;
+
+    if (g_pVS != pShader)
+    {
+      if (pShader != nullptr)
+      {
+        if (checksums.find (pShader) == checksums.end ())
+          checksums [pShader] = pShader->crc32;
+      }
+    }
+
+    vs_checksum = checksums [pShader];
+    g_pVS       = pShader;
+
+    if (vs_checksum != 0x00)
+      used.emplace (vs_checksum);
+
+    result.checksums += vs_checksum;
+  }
+
+  for ( auto it : used )
+    result.used.push_back (it);
+
+  used.clear ();
+}
+
+static void
+frame_after ( const std::vector <mock_shader_s *>& binds,
+              TBF_ShaderCache&                    checksums,
+              TBF_FrameSet&                       used,
+              uint32_t&                           frame,
+              frame_result_s&                     result )
+{
+  for ( auto* pShader : binds )
+  {
+    tbf_shader_record_s* rec =
+      checksums.find (pShader);
+
+    if (rec == nullptr && pShader != nullptr)
+      rec = checksums.insert (pShader, pShader->crc32);
+
+    const uint32_t vs_checksum = rec != nullptr ? rec->crc32 : 0x00;
+
+    if (vs_checksum != 0x00)
+    {
+      if (rec->frame != frame)
+      {
+        rec->frame = frame;
+        used.insert (vs_checksum);
+      }
+    }
+
+    result.checksums += vs_checksum;
+  }
+
+  for ( auto it : used )
+    result.used.push_back (it);
+
+  used.clear ();
+
+  ++frame;
+}
+
+int
+main (int argc, char** argv)
+{
+  int frames = tbf_bench_quick () ? 20 : 2000;
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (! strcmp (argv [i], "-f")) frames = atoi (argv [i + 1]);
+  }
+
+  // Allocated one at a time like the runtime does, so addresses are spread out
+  std::vector <std::unique_ptr <mock_shader_s>> shaders;
+  std::vector <std::unique_ptr <uint8_t []>>    spacers;
+
+  for (int i = 0; i < NUM_SHADERS; i++)
+  {
+    shaders.emplace_back (new mock_shader_s ());
+    shaders.back ()->crc32 = (rnd () << 8) | 1;
+
+    spacers.emplace_back (new uint8_t [16 + rnd () % 512]);
+  }
+
+  //
+  // Each frame draws one area's scene: runs of the same shader, a few
+  //   shared ones (UI, post-processing) and the odd null bind
+  //
+  std::vector <std::vector <mock_shader_s *>> frame_binds (16);
+
+  for ( auto& binds : frame_binds )
+  {
+    const int area = rnd () % (NUM_SHADERS / SCENE);
+
+    binds.reserve (FRAME_BINDS);
+
+    while (binds.size () < (size_t)FRAME_BINDS)
+    {
+      uint32_t r = rnd ();
+
+      mock_shader_s* pShader =
+        r % 32 == 0 ? nullptr                                :
+        r % 8  == 1 ? shaders [rnd () % 8].get ()            :
+                      shaders [area * SCENE + rnd () % SCENE].get ();
+
+      for (uint32_t run = 1 + rnd () % 4; run > 0 && binds.size () < (size_t)FRAME_BINDS; run--)
+        binds.push_back (pShader);
+    }
+  }
+
+  std::unordered_map <void *, uint32_t> map_before;
+  std::unordered_set <uint32_t>         used_before;
+  TBF_ShaderCache                       cache_after;
+  TBF_FrameSet                          used_after (1024);
+  uint32_t                              frame = 1;
+
+  // Agree frame for frame
+  for ( auto& binds : frame_binds )
+  {
+    frame_result_s before, after;
+
+    frame_before (binds, map_before,  used_before,        before);
+    frame_after  (binds, cache_after, used_after,  frame, after);
+
+    TBF_CHECK_EQ (before.checksums, after.checksums);
+
+    std::sort (before.used.begin (), before.used.end ());
+    std::sort (after.used.begin  (), after.used.end  ());
+
+    TBF_CHECK (before.used == after.used);
+  }
+
+  // The map picked up a zero entry for null; the cache never sees null
+  TBF_CHECK_EQ (map_before.size (), cache_after.size () + 1);
+  TBF_CHECK    (map_before.count (nullptr) == 1);
+
+  frame_result_s result;
+
+  double start = tbf_bench_ms ();
+
+  for (int f = 0; f < frames; f++)
+  {
+    frame_before (frame_binds [f % frame_binds.size ()], map_before, used_before, result);
+    result.used.clear ();
+  }
+
+  double ms_before = tbf_bench_ms () - start;
+
+  start = tbf_bench_ms ();
+
+  for (int f = 0; f < frames; f++)
+  {
+    frame_after (frame_binds [f % frame_binds.size ()], cache_after, used_after, frame, result);
+    result.used.clear ();
+  }
+
+  double ms_after = tbf_bench_ms () - start;
+
+  tbf_bench_keep (result.checksums);
+
+  const double binds = (double)frames * FRAME_BINDS;
+
+  printf ( "%d frames of %d binds (%d shaders each, %lu known)\n"
+           "  before  %8.2f ms  %6.2f ns/bind\n"
+           "  after   %8.2f ms  %6.2f ns/bind\n",
+             frames, FRAME_BINDS, SCENE, (unsigned long)cache_after.size (),
+               ms_before, ms_before * 1e6 / binds,
+               ms_after,  ms_after  * 1e6 / binds );
+
+  return TBF_TEST_RESULT ();
+}
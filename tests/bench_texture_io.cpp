@@ -0,0 +1,423 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+//
+// Loose texture loading: read, mapped, and mapped behind the read-ahead
+//   stage (see texture_io.h)
+//
+//   Writes a set of .dds-sized files and has a few worker threads load all
+//     of them the way InjectTexture does: read into a per-thread buffer that
+//       grows to fit (streaming_memory), or mapped, and then "decoded" by
+//         <passes> passes over every byte. The staged run posts every file to
+//           a TBF_ReadAhead first, as SK_StreamSplitter does; workers decode
+//             what it read and map what it turned away (the budget is full).
+//
+//   Each run happens in a child process of its own so that peak RSS is that
+//     run's alone; cold runs drop the files from the page cache first.
+//
+//   usage:  bench_texture_io [-m <MiB>] [-t <threads>] [-p <passes>]
+//
+
+#include "tbf_test.h"
+#include "tbf_bench.h"
+#include "texture_io.h"
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static const char* szTree = "bench_texture_io.d";
+
+// Matches streaming_memory::alloc and SK_TextureIOStage
+static const size_t MIN_STAGING         = 8192 * 1024;
+static const size_t MAX_BYTES_IN_FLIGHT = 64ULL * 1024ULL * 1024ULL;
+
+enum tbf_io_mode_t { Read, Mapped, Staged };
+
+static const char* mode_names [] = { "read", "mapped", "staged" };
+
+struct tbf_bench_run_s {
+  double   ms;
+  double   peak_rss;
+  uint64_t hash;
+  size_t   prefetched;
+};
+
+static int passes = 1;
+
+// Stand-in for D3DX: touches every byte once per pass
+static uint64_t
+decode (const void* pData, size_t len)
+{
+  const uint8_t* src  = (const uint8_t *)pData;
+  uint64_t       hash = 0xcbf29ce484222325ULL;
+
+  for (int pass = 0; pass < passes; pass++)
+  {
+    size_t i = 0;
+
+    for (; i + sizeof (uint64_t) <= len; i += sizeof (uint64_t))
+    {
+      uint64_t word;
+      memcpy (&word, src + i, sizeof (uint64_t));
+
+      hash = (hash ^ word) * 0x100000001b3ULL;
+    }
+
+    for (; i < len; i++)
+      hash = (hash ^ src [i]) * 0x100000001b3ULL;
+  }
+
+  return hash;
+}
+
+static std::vector <std::wstring>
+write_files (size_t total_bytes)
+{
+  std::vector <std::wstring> files;
+
+  fs::remove_all       (szTree);
+  fs::create_directory (szTree);
+
+  // 128 KiB to 4 MiB plus a DDS header, roughly what texture mods ship
+  static const size_t sizes [] = { 128 << 10, 256 << 10, 512 << 10,
+                                   1   << 20, 2   << 20, 4   << 20 };
+
+  std::vector <uint8_t> body (4 << 20);
+  uint32_t              seed = 0x2545f491U;
+
+  for (auto& byte : body)
+  {
+    seed = seed * 1664525U + 1013904223U;
+    byte = (uint8_t)(seed >> 24);
+  }
+
+  size_t written = 0;
+
+  for (int i = 0; written < total_bytes; i++)
+  {
+    size_t size = sizes [i % (sizeof (sizes) / sizeof (sizes [0]))] + 128;
+
+    char szName [32];
+    snprintf (szName, 32, "%08X.dds", 0x10000000U + i);
+
+    fs::path path = fs::path (szTree) / szName;
+    FILE*    fDDS = fopen (path.string ().c_str (), "wb");
+
+    // Each file differs from the last so that the hashes mean something
+    body [i % body.size ()] ^= 0x5a;
+
+    fwrite (body.data (), 1, size, fDDS);
+    fclose (fDDS);
+
+    files.push_back (path.wstring ());
+    written += size;
+  }
+
+  sync ();
+
+  return files;
+}
+
+// Drops the files from the page cache, or pulls them in through a small
+//   buffer that adds nothing to the run's peak RSS
+static void
+set_cache (const std::vector <std::wstring>& files, bool cold)
+{
+  static char buffer [64 << 10];
+
+  for (auto& file : files)
+  {
+    int fd = open (fs::path (file).string ().c_str (), O_RDONLY);
+
+    if (fd < 0)
+      continue;
+
+    if (cold)
+      posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED);
+
+    else while (read (fd, buffer, sizeof (buffer)) > 0)
+      ;
+
+    close (fd);
+  }
+}
+
+//
+// The pools' job queue: a file to load, or the data the read-ahead stage
+//   already has for it
+//
+struct tbf_bench_job_s {
+  size_t file;
+  void*  pData;
+  size_t size;
+};
+
+struct tbf_bench_queue_s {
+  std::mutex                    lock;
+  std::condition_variable       posted;
+  std::deque <tbf_bench_job_s>  jobs;
+  size_t                        remaining;
+
+  void post (const tbf_bench_job_s& job)
+  {
+    {
+      std::lock_guard <std::mutex> guard (lock);
+      jobs.push_back (job);
+    }
+
+    posted.notify_one ();
+  }
+
+  // false once every file has been handed out
+  bool take (tbf_bench_job_s& job)
+  {
+    std::unique_lock <std::mutex> guard (lock);
+
+    posted.wait (guard, [&] { return remaining == 0 || (! jobs.empty ()); });
+
+    if (jobs.empty ())
+      return false;
+
+    job = jobs.front ();
+    jobs.pop_front ();
+
+    if (--remaining == 0)
+      posted.notify_all ();
+
+    return true;
+  }
+};
+
+static void
+read_ahead_complete (void* user, void* pData, size_t size)
+{
+  auto* job   = (tbf_bench_job_s *)user;
+  auto* queue = (tbf_bench_queue_s *)job->pData;
+
+  job->pData = pData;
+  job->size  = size;
+
+  queue->post (*job);
+
+  delete job;
+}
+
+static tbf_bench_run_s
+load_all (const std::vector <std::wstring>& files, tbf_io_mode_t mode, int threads)
+{
+  tbf_bench_queue_s      queue;
+  std::atomic <uint64_t> hash       (0);
+  std::atomic <size_t>   prefetched (0);
+
+  queue.remaining = files.size ();
+
+  double start = tbf_bench_ms ();
+
+  std::vector <std::thread> workers;
+
+  for (int t = 0; t < threads; t++)
+  {
+    workers.emplace_back ([&]
+    {
+      void*  staging     = nullptr;
+      size_t staging_len = 0;
+
+      tbf_bench_job_s job;
+
+      while (queue.take (job))
+      {
+        if (job.pData != nullptr)
+        {
+          hash += decode (job.pData, job.size);
+          free   (job.pData);
+
+          ++prefetched;
+
+          continue;
+        }
+
+        TBF_TextureFile tex_file;
+
+        if (! tex_file.open (files [job.file].c_str (), mode != Read))
+          continue;
+
+        size_t size = tex_file.size ();
+
+        if (tex_file.view () != nullptr)
+          hash += decode (tex_file.view (), size);
+
+        else
+        {
+          if (staging_len < size)
+          {
+            free (staging);
+
+            staging_len = size < MIN_STAGING ? MIN_STAGING : size;
+            staging     = malloc (staging_len);
+          }
+
+          hash += decode (staging, tex_file.read (staging, size));
+        }
+      }
+
+      free (staging);
+    });
+  }
+
+  {
+    TBF_ReadAhead read_ahead (read_ahead_complete, MAX_BYTES_IN_FLIGHT);
+
+    for (size_t i = 0; i < files.size (); i++)
+    {
+      if (mode == Staged)
+      {
+        auto* job = new tbf_bench_job_s { i, &queue, 0 };
+
+        if (read_ahead.submit (files [i].c_str (), job))
+          continue;
+
+        delete job;
+      }
+
+      queue.post ({ i, nullptr, 0 });
+    }
+
+    for (auto& worker : workers)
+      worker.join ();
+  }
+
+  return { tbf_bench_ms () - start, tbf_bench_peak_rss_mib (),
+             hash.load (), prefetched.load () };
+}
+
+// One run per child process, so that peak RSS belongs to that run only
+static bool
+run_child (const std::vector <std::wstring>& files, tbf_io_mode_t mode, bool cold, int threads,
+           tbf_bench_run_s& run)
+{
+  int fds [2];
+
+  if (pipe (fds) != 0)
+    return false;
+
+  pid_t pid = fork ();
+
+  if (pid == 0)
+  {
+    close (fds [0]);
+
+    set_cache (files, cold);
+
+    tbf_bench_run_s result =
+      load_all (files, mode, threads);
+
+    bool ok = write (fds [1], &result, sizeof (result)) == sizeof (result);
+
+    _exit (ok ? 0 : 1);
+  }
+
+  close (fds [1]);
+
+  bool ok =
+    pid > 0 && read (fds [0], &run, sizeof (run)) == sizeof (run);
+
+  close (fds [0]);
+
+  int status = 0;
+
+  if (pid > 0)
+    waitpid (pid, &status, 0);
+
+  return ok && WIFEXITED (status) && WEXITSTATUS (status) == 0;
+}
+
+int
+main (int argc, char** argv)
+{
+  size_t total_mib = tbf_bench_quick () ? 16 : 512;
+  int    threads   = 4;
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (! strcmp (argv [i], "-m")) total_mib = strtoul (argv [i + 1], nullptr, 10);
+    if (! strcmp (argv [i], "-t")) threads   = atoi    (argv [i + 1]);
+    if (! strcmp (argv [i], "-p")) passes    = atoi    (argv [i + 1]);
+  }
+
+  std::vector <std::wstring> files =
+    write_files (total_mib << 20);
+
+  double total = 0.0;
+
+  for (auto& file : files)
+    total += (double)fs::file_size (file) / (1024.0 * 1024.0);
+
+  printf ( "%zu files, %.1f MiB, %d threads, %d decode pass(es)\n",
+             files.size (), total, threads, passes );
+
+  uint64_t hash  = 0;
+  bool     first = true;
+
+  for (bool cold : { true, false })
+  {
+    for (tbf_io_mode_t mode : { Read, Mapped, Staged })
+    {
+      tbf_bench_run_s run = { };
+
+      TBF_CHECK (run_child (files, mode, cold, threads, run));
+
+      printf ( "  %-6s  %-4s  %8.1f ms  %8.1f MiB/s  peak RSS %7.1f MiB"
+               "  prefetched %zu\n",
+                 mode_names [mode], cold ? "cold" : "warm",
+                   run.ms, total / (run.ms / 1000.0), run.peak_rss,
+                     run.prefetched );
+
+      // Every way has to hand the decoder the same bytes
+      if (first)
+        hash = run.hash;
+
+      TBF_CHECK_EQ (run.hash, hash);
+      first = false;
+
+      if (mode == Staged)
+        TBF_CHECK (run.prefetched > 0);
+    }
+  }
+
+  fs::remove_all (szTree);
+
+  return TBF_TEST_RESULT ();
+}
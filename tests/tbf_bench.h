@@ -0,0 +1,79 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__BENCH_H__
+#define __TBF__BENCH_H__
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#ifndef _WIN32
+# include <sys/resource.h>
+#endif
+
+//
+// Just enough of a harness for the host benchmarks: a clock, the process's
+//   peak RSS, and a quick mode. ctest runs every benchmark with
+//     TBF_BENCH_QUICK set, on a data set small enough that the run only
+//       checks that each way of doing the work produced the same result.
+//
+static inline bool
+tbf_bench_quick (void)
+{
+  return getenv ("TBF_BENCH_QUICK") != nullptr;
+}
+
+static inline double
+tbf_bench_ms (void)
+{
+  using namespace std::chrono;
+
+  return duration <double, std::milli> (
+    steady_clock::now ().time_since_epoch ()
+  ).count ();
+}
+
+// Peak resident set of this process in MiB, 0 where that is not known
+static inline double
+tbf_bench_peak_rss_mib (void)
+{
+#ifndef _WIN32
+  struct rusage usage = { };
+
+  if (getrusage (RUSAGE_SELF, &usage) == 0)
+    return (double)usage.ru_maxrss / 1024.0; // KiB on Linux
+#endif
+  return 0.0;
+}
+
+// Keeps the optimizer from discarding work whose result is not otherwise used
+template <typename T>
+static inline void
+tbf_bench_keep (const T& value)
+{
+  static volatile T sink;
+  sink = value;
+  (void)sink;
+}
+
+#endif /* __TBF__BENCH_H__ */
@@ -0,0 +1,50 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__TEST_H__
+#define __TBF__TEST_H__
+
+#include <cstdio>
+
+//
+// Just enough of a test harness for the host tests: every failed check is
+//   printed and counted, main returns the count.
+//
+static int tbf_test_failures = 0;
+
+#define TBF_CHECK(expr)                                             \
+  do {                                                              \
+    if (! (expr)) {                                                 \
+      fprintf (stderr, "%s:%d: CHECK (%s) failed\n",                \
+                 __FILE__, __LINE__, #expr);                        \
+      ++tbf_test_failures;                                          \
+    }                                                               \
+  } while (0)
+
+#define TBF_CHECK_EQ(a,b) TBF_CHECK ((a) == (b))
+
+#define TBF_TEST_RESULT()                                           \
+  ( tbf_test_failures == 0 ?                                        \
+      (printf ("OK\n"), 0) :                                        \
+      (printf ("%d check(s) failed\n", tbf_test_failures), 1) )
+
+#endif /* __TBF__TEST_H__ */
@@ -0,0 +1,323 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "archive_manifest.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static const char*    szTree          = "test_archive_manifest.d";
+static const wchar_t* wszManifest     = L"test_archive_manifest.d/archives.manifest";
+
+static const int      NUM_ARCHIVES    = 1500;
+static const int      ENTRIES_PER_ARC = 64;
+
+//
+// Stand-in for a .7z archive: an entry count, the entries, then a body the
+//   scanner has to read through like a real archive header
+//
+static void
+write_archive (const fs::path& path, int seed, size_t body)
+{
+  FILE* fArc = fopen (path.string ().c_str (), "wb");
+
+  uint32_t count = ENTRIES_PER_ARC;
+  fwrite (&count, sizeof (uint32_t), 1, fArc);
+
+  for (uint32_t i = 0; i < count; i++)
+  {
+    tbf_archive_entry_s entry;
+
+    entry.checksum = (uint32_t)seed * 0x9e3779b1U + i;
+    entry.fileno   = i;
+    entry.size     = 4096 + i;
+    entry.method   = (tbf_load_method_t)(i % 3);
+
+    fwrite (&entry, sizeof (entry), 1, fArc);
+  }
+
+  std::vector <uint8_t> filler (body, (uint8_t)seed);
+  fwrite (filler.data (), 1, filler.size (), fArc);
+
+  fclose (fArc);
+}
+
+static void
+scan_archive (tbf_archive_scan_s* scan)
+{
+  std::string path;
+
+  for ( wchar_t ch : scan->path ) path += (char)ch;
+
+  FILE* fArc = fopen (path.c_str (), "rb");
+
+  if (fArc == nullptr)
+    return;
+
+  std::vector <uint8_t> data ((size_t)scan->size);
+
+  uint32_t count = 0;
+
+  if ( fread (data.data (), 1, data.size (), fArc) == data.size () && data.size () >= 4 )
+  {
+    memcpy (&count, data.data (), sizeof (uint32_t));
+
+    if (4 + count * sizeof (tbf_archive_entry_s) <= data.size ())
+    {
+      scan->entries.resize (count);
+      memcpy (scan->entries.data (), data.data () + 4, count * sizeof (tbf_archive_entry_s));
+      scan->valid = true;
+    }
+  }
+
+  fclose (fArc);
+}
+
+// What TBF_BuildInjectableIndex gathers from the directory listing
+static std::vector <tbf_archive_scan_s>
+list_archives (void)
+{
+  std::vector <tbf_archive_scan_s> scans;
+
+  for ( auto& file : fs::directory_iterator (szTree) )
+  {
+    if (file.path ().extension () != ".7z")
+      continue;
+
+    tbf_archive_scan_s scan;
+
+    scan.path       = file.path ().wstring ();
+    scan.size       = (uint64_t)fs::file_size (file.path ());
+    scan.last_write = (uint64_t)fs::last_write_time (file.path ()).time_since_epoch ().count ();
+
+    scans.push_back (scan);
+  }
+
+  return scans;
+}
+
+struct discovery_s {
+  std::vector <tbf_archive_scan_s> scans;
+  size_t                           parsed = 0;
+  bool                             saved  = false;
+  double                           ms     = 0.0;
+};
+
+// One startup's worth of discovery
+static discovery_s
+discover (void)
+{
+  auto start = std::chrono::steady_clock::now ();
+
+  discovery_s result;
+
+  result.scans = list_archives ();
+
+  TBF_ArchiveManifest manifest;
+  manifest.load (wszManifest);
+
+  std::vector <tbf_archive_scan_s*> dirty =
+    manifest.apply (result.scans);
+
+  for ( auto scan : dirty )
+    scan_archive (scan);
+
+  result.parsed = dirty.size ();
+
+  if ( (! dirty.empty ()) || manifest.size () != result.scans.size () )
+    result.saved = TBF_ArchiveManifest::save (wszManifest, result.scans);
+
+  result.ms =
+    std::chrono::duration <double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+
+  return result;
+}
+
+static const tbf_archive_scan_s*
+find_scan (const discovery_s& run, const fs::path& path)
+{
+  for ( auto& scan : run.scans )
+    if (scan.path == path.wstring ())
+      return &scan;
+
+  return nullptr;
+}
+
+static bool
+same_entries (const tbf_archive_scan_s* a, const tbf_archive_scan_s* b)
+{
+  return a != nullptr && b != nullptr && a->entries.size () == b->entries.size () &&
+           ! memcmp ( a->entries.data (), b->entries.data (),
+                        a->entries.size () * sizeof (tbf_archive_entry_s) );
+}
+
+int
+main (void)
+{
+  fs::remove_all     (szTree);
+  fs::create_directory (szTree);
+
+  for (int i = 0; i < NUM_ARCHIVES; i++)
+    write_archive (fs::path (szTree) / ("pack" + std::to_string (i) + ".7z"), i, 16384);
+
+  // Cold: no manifest, every archive is parsed and the manifest written
+  discovery_s cold = discover ();
+
+  TBF_CHECK_EQ (cold.scans.size (), (size_t)NUM_ARCHIVES);
+  TBF_CHECK_EQ (cold.parsed,        (size_t)NUM_ARCHIVES);
+  TBF_CHECK    (cold.saved);
+
+  // Warm: nothing changed, nothing parsed or written, same entries
+  discovery_s warm = discover ();
+
+  TBF_CHECK_EQ (warm.parsed, 0U);
+  TBF_CHECK    (! warm.saved);
+
+  bool all_cached = warm.scans.size () == cold.scans.size ();
+
+  for ( auto& scan : warm.scans )
+  {
+    all_cached = all_cached && scan.cached && scan.valid &&
+                   same_entries (&scan, find_scan (cold, scan.path));
+  }
+
+  TBF_CHECK (all_cached);
+
+  printf ( "%d archives: cold %.1f ms, warm %.1f ms\n",
+             NUM_ARCHIVES, cold.ms, warm.ms );
+
+  // Stale: one archive rewritten with a different size, one touched with
+  //   the same size, one removed and one added
+  const fs::path grown   = fs::path (szTree) / "pack7.7z",
+                 touched = fs::path (szTree) / "pack8.7z",
+                 removed = fs::path (szTree) / "pack9.7z",
+                 added   = fs::path (szTree) / "new.7z";
+
+  write_archive (grown, 1000007, 20000);
+
+  fs::last_write_time (touched, fs::last_write_time (touched) + std::chrono::seconds (5));
+  fs::remove          (removed);
+
+  write_archive (added, 2000000, 100);
+
+  discovery_s stale = discover ();
+
+  TBF_CHECK_EQ (stale.scans.size (), (size_t)NUM_ARCHIVES);
+  TBF_CHECK_EQ (stale.parsed,        3U);
+  TBF_CHECK    (stale.saved);
+
+  TBF_CHECK (find_scan (stale, grown)   != nullptr && ! find_scan (stale, grown)->cached);
+  TBF_CHECK (find_scan (stale, touched) != nullptr && ! find_scan (stale, touched)->cached);
+  TBF_CHECK (find_scan (stale, added)   != nullptr && ! find_scan (stale, added)->cached);
+  TBF_CHECK (find_scan (stale, removed) == nullptr);
+
+  TBF_CHECK (! same_entries (find_scan (stale, grown), find_scan (cold, grown)));
+  TBF_CHECK (  same_entries (find_scan (stale, touched), find_scan (cold, touched)));
+
+  // ... and the rescan is what the next startup sees
+  discovery_s again = discover ();
+
+  TBF_CHECK_EQ (again.parsed, 0U);
+  TBF_CHECK    (same_entries (find_scan (again, grown), find_scan (stale, grown)));
+
+  //
+  // Damaged manifests: whatever comes before the damage is kept, nothing is
+  //   allocated from a count the file cannot back
+  //
+  std::vector <uint8_t> good;
+  {
+    FILE* fIn = fopen ("test_archive_manifest.d/archives.manifest", "rb");
+
+    fseek (fIn, 0, SEEK_END);
+    good.resize ((size_t)ftell (fIn));
+    fseek (fIn, 0, SEEK_SET);
+
+    TBF_CHECK_EQ (fread (good.data (), 1, good.size (), fIn), good.size ());
+    fclose (fIn);
+  }
+
+  auto write_manifest = [] (const std::vector <uint8_t>& data)
+  {
+    FILE* fOut = fopen ("test_archive_manifest.d/archives.manifest", "wb");
+    fwrite (data.data (), 1, data.size (), fOut);
+    fclose (fOut);
+  };
+
+  // Entry count of the first archive, just past its path, size and time
+  uint32_t path_len;
+  memcpy (&path_len, good.data () + 12, sizeof (uint32_t));
+
+  const size_t count_offset =
+    16 + path_len * sizeof (wchar_t) + 2 * sizeof (uint64_t);
+
+  std::vector <uint8_t> huge = good;
+  const uint32_t        bogus = 0xffffffffU;
+
+  memcpy (huge.data () + count_offset, &bogus, sizeof (uint32_t));
+  write_manifest (huge);
+
+  TBF_ArchiveManifest damaged;
+
+  TBF_CHECK    (! damaged.load (wszManifest));
+  TBF_CHECK_EQ (damaged.size (), 0U);
+
+  // Just more entries than there are bytes left
+  const uint32_t one_too_many =
+    (uint32_t)((good.size () - count_offset - 4) / sizeof (tbf_archive_entry_s)) + 1;
+
+  memcpy (huge.data () + count_offset, &one_too_many, sizeof (uint32_t));
+  write_manifest (huge);
+
+  TBF_CHECK (! damaged.load (wszManifest));
+
+  // Cut short anywhere in the first few archives
+  const size_t record = count_offset + 4 + ENTRIES_PER_ARC * sizeof (tbf_archive_entry_s) - 12;
+
+  bool truncation_ok = true;
+
+  for (size_t len = 0; len < 12 + record * 3; len += 7)
+  {
+    write_manifest (std::vector <uint8_t> (good.begin (), good.begin () + len));
+
+    TBF_ArchiveManifest cut;
+
+    truncation_ok = truncation_ok && ! cut.load (wszManifest) && cut.size () <= 3;
+  }
+
+  TBF_CHECK (truncation_ok);
+
+  // Bad magic
+  std::vector <uint8_t> bad_magic = good;
+  bad_magic [0] ^= 0xff;
+  write_manifest (bad_magic);
+
+  TBF_CHECK (! damaged.load (wszManifest));
+
+  fs::remove_all (szTree);
+
+  return TBF_TEST_RESULT ();
+}
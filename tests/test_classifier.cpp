@@ -0,0 +1,132 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "classifier.h"
+
+#include <cstdio>
+#include <vector>
+
+static void
+bind (TBF_LoadClassifier& classifier, uint32_t checksum, int count, int early, float delay_ms)
+{
+  for (int i = 0; i < count; i++)
+    classifier.firstBind (checksum, delay_ms, i >= early);
+}
+
+int
+main (void)
+{
+  const uint32_t raced   = 0x1000, // Bound before its override, every time
+                 eager   = 0x2000, // Sometimes early
+                 lazy    = 0x3000, // Blocking, first used long after creation
+                 unknown = 0x4000,
+                 few     = 0x5000; // Not enough evidence
+
+  TBF_LoadClassifier classifier;
+
+  bool urgent = false;
+
+  // No history: whatever the texture was authored as
+  TBF_CHECK_EQ (classifier.classify (unknown, Streaming, &urgent), Streaming);
+  TBF_CHECK    (! urgent);
+  TBF_CHECK_EQ (classifier.classify (unknown, Blocking,  &urgent), Blocking);
+  TBF_CHECK    (urgent);
+
+  bind (classifier, raced, 4, 4,   10.0f);
+  bind (classifier, eager, 4, 1,  200.0f);
+  bind (classifier, lazy,  4, 0, 5000.0f);
+  bind (classifier, few,   2, 2,   10.0f);
+
+  // This session's measurements only count once committed
+  TBF_CHECK_EQ (classifier.classify (raced, Streaming, &urgent), Streaming);
+
+  classifier.commitSession ();
+
+  TBF_CHECK_EQ (classifier.classify (raced, Streaming, &urgent), Blocking);
+  TBF_CHECK    (urgent);
+  TBF_CHECK_EQ (classifier.classify (raced, DontCare,  &urgent), Blocking);
+
+  TBF_CHECK_EQ (classifier.classify (eager, Streaming, &urgent), Streaming);
+  TBF_CHECK    (urgent);
+
+  TBF_CHECK_EQ (classifier.classify (lazy,  Blocking,  &urgent), Streaming);
+  TBF_CHECK    (! urgent);
+  TBF_CHECK_EQ (classifier.classify (lazy,  Streaming, &urgent), Streaming);
+  TBF_CHECK    (! urgent);
+
+  TBF_CHECK_EQ (classifier.classify (few,   Streaming, &urgent), Streaming);
+  TBF_CHECK_EQ (classifier.classify (raced, Blocking,  &urgent), Blocking);
+
+  TBF_CHECK_EQ (classifier.numUpgraded   (), 2U);
+  TBF_CHECK_EQ (classifier.numDowngraded (), 1U);
+
+  // Older sessions decay: a texture that stopped racing is trusted again
+  for (int session = 0; session < 8; session++)
+  {
+    bind (classifier, raced, 4, 0, 10.0f);
+    classifier.commitSession ();
+  }
+
+  TBF_CHECK_EQ (classifier.classify (raced, Streaming, &urgent), Streaming);
+  TBF_CHECK    (! urgent);
+
+  // Persisted history survives a round trip
+  const wchar_t* wszFile = L"test_classifier.tbfc";
+
+  TBF_CHECK (classifier.save (wszFile));
+
+  TBF_LoadClassifier loaded;
+
+  TBF_CHECK    (loaded.load (wszFile));
+  TBF_CHECK_EQ (loaded.classify (eager, Streaming, &urgent), Streaming);
+  TBF_CHECK    (urgent);
+  TBF_CHECK_EQ (loaded.classify (lazy,  Blocking,  &urgent), Streaming);
+  TBF_CHECK_EQ (loaded.classify (few,   Streaming, &urgent), Streaming);
+  TBF_CHECK    (urgent == false);
+
+  // A truncated file is rejected and leaves no history behind
+  std::vector <char> data (64 * 1024);
+
+  FILE* fStats = fopen ("test_classifier.tbfc", "rb");
+  TBF_CHECK (fStats != nullptr);
+
+  data.resize (fread (data.data (), 1, data.size (), fStats));
+  fclose (fStats);
+
+  TBF_CHECK (data.size () > 12);
+
+  fStats = fopen ("test_classifier.tbfc", "wb");
+  fwrite (data.data (), 1, data.size () - 1, fStats);
+  fclose (fStats);
+
+  TBF_LoadClassifier truncated;
+
+  TBF_CHECK    (! truncated.load (wszFile));
+  TBF_CHECK_EQ (truncated.classify (lazy, Blocking, &urgent), Blocking);
+
+  remove ("test_classifier.tbfc");
+
+  TBF_CHECK (! truncated.load (wszFile));
+
+  return TBF_TEST_RESULT ();
+}
@@ -0,0 +1,140 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "constant_patch.h"
+
+#include <cmath>
+
+static const tbf_vs_patch_s*
+lookup (const TBF_ConstantPatchTable& table, float x, float y)
+{
+  const float c240 [4] = { x, y, 0.0f, 0.0f };
+
+  return table.find (c240);
+}
+
+int
+main (void)
+{
+  TBF_ConstantPatchTable table;
+  tbf_quality_s          quality;
+
+  TBF_CHECK (! table.current (1920, 1080, quality));
+
+  table.build (1920, 1080, quality);
+
+  TBF_CHECK (table.current (1920, 1080, quality));
+  TBF_CHECK (! table.current (2560, 1080, quality));
+
+  tbf_quality_s changed = quality;
+  changed.postproc_ratio = 1.0f;
+
+  TBF_CHECK (! table.current (1920, 1080, changed));
+
+  changed = quality;
+  changed.env_shadow_rescale = 2;
+
+  TBF_CHECK (! table.current (1920, 1080, changed));
+
+  // Default quality at 1920x1080: shadows 4x (64x64 maps 8x), environment
+  //   shadows 2x, post-processing at half resolution
+  for (uint32_t dim = 64; dim <= 2048; dim <<= 1)
+  {
+    const tbf_vs_patch_s* patch =
+      lookup (table, -1.0f / dim, 1.0f / dim);
+
+    const uint32_t scaled = dim <= 256 ? dim << (dim == 64 ? 3 : 2) :
+                                         dim << 1;
+
+    TBF_CHECK (patch != nullptr);
+
+    if (patch != nullptr)
+    {
+      TBF_CHECK_EQ (patch->kind, dim <= 256 ? tbf_vs_patch_s::ModelShadow :
+                                               tbf_vs_patch_s::EnvShadow);
+      TBF_CHECK_EQ (patch->data [0], -1.0f / scaled);
+      TBF_CHECK_EQ (patch->data [1],  1.0f / scaled);
+    }
+  }
+
+  const tbf_vs_patch_s* post =
+    lookup (table, -1.0f / 1024.0f, 1.0f / 512.0f);
+
+  TBF_CHECK (post != nullptr && post->kind == tbf_vs_patch_s::PostProcess);
+
+  if (post != nullptr)
+  {
+    TBF_CHECK_EQ (post->data [0], -1.0f / 960.0f);
+    TBF_CHECK_EQ (post->data [1],  1.0f / 540.0f);
+  }
+
+  // The same shadow maps at full resolution, no post-processing pattern
+  changed                = quality;
+  changed.shadow_rescale = 0;
+  changed.postproc_ratio = 0.0f;
+
+  table.build (2560, 1440, changed);
+
+  TBF_CHECK (table.current (2560, 1440, changed));
+  TBF_CHECK (lookup (table, -1.0f / 1024.0f, 1.0f / 512.0f) == nullptr);
+  TBF_CHECK (lookup (table, -1.0f / 64.0f,   1.0f / 64.0f)  != nullptr &&
+             lookup (table, -1.0f / 64.0f,   1.0f / 64.0f)->data [1] == 1.0f / 64.0f);
+
+  table.build (1920, 1080, quality);
+
+  // Exact bit patterns only
+  TBF_CHECK (lookup (table, 1.0f / 64.0f, 1.0f / 64.0f)                              == nullptr);
+  TBF_CHECK (lookup (table, -1.0f / 64.0f, nextafterf (1.0f / 64.0f, 1.0f))          == nullptr);
+  TBF_CHECK (lookup (table, -1.0f / 4096.0f, 1.0f / 4096.0f)                         == nullptr);
+  TBF_CHECK (lookup (table, 0.0f, 0.0f)                                              == nullptr);
+
+  // Adding a pattern twice replaces it
+  table.add (-1.0f / 64.0f, 1.0f / 64.0f, tbf_vs_patch_s::EnvShadow, 1.0f, 2.0f);
+
+  const tbf_vs_patch_s* replaced =
+    lookup (table, -1.0f / 64.0f, 1.0f / 64.0f);
+
+  TBF_CHECK (replaced != nullptr && replaced->kind == tbf_vs_patch_s::EnvShadow &&
+                                    replaced->data [0] == 1.0f);
+
+  // Up to half the table's slots, every one still found
+  table.clear ();
+
+  for (uint32_t i = 0; i < TBF_ConstantPatchTable::SLOTS / 2; i++)
+    table.add (-1.0f / (float)(1 << i), (float)i, tbf_vs_patch_s::PostProcess, (float)i, 0.0f);
+
+  for (uint32_t i = 0; i < TBF_ConstantPatchTable::SLOTS / 2; i++)
+  {
+    const tbf_vs_patch_s* patch =
+      lookup (table, -1.0f / (float)(1 << i), (float)i);
+
+    TBF_CHECK (patch != nullptr && patch->data [0] == (float)i);
+  }
+
+  table.clear ();
+
+  TBF_CHECK (lookup (table, -1.0f, 0.0f) == nullptr);
+  TBF_CHECK (! table.current (1920, 1080, quality));
+
+  return TBF_TEST_RESULT ();
+}
@@ -0,0 +1,368 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "device_shadow.h"
+
+#include <cstring>
+#include <vector>
+
+//
+// Replays a random stream of the calls TBF_DeviceShadow is fed from: each is
+//   applied to a mock device the way the runtime would, and passed on to the
+//     shadow the way the detours in render.cpp / textures.cpp do. Whenever a
+//       hot path would ask, the shadow has to give the same answers as the
+//         device's Get* methods, and give back every reference it took.
+//
+
+struct mock_surface_s : IDirect3DSurface9
+{
+  ULONG   Release (void) override { return --refs; }
+  HRESULT GetDesc (D3DSURFACE_DESC* pDesc) override
+  {
+    *pDesc = desc;
+    return S_OK;
+  }
+
+  D3DSURFACE_DESC desc = { };
+  ULONG           refs = 1;
+};
+
+struct mock_decl_s : IDirect3DVertexDeclaration9
+{
+  ULONG   Release        (void) override { return --refs; }
+  HRESULT GetDeclaration (D3DVERTEXELEMENT9* pElement, UINT* pNumElements) override
+  {
+    if (pElement != nullptr)
+    {
+      if (*pNumElements < (UINT)elems.size ())
+        return E_FAIL;
+
+      memcpy (pElement, elems.data (), elems.size () * sizeof (D3DVERTEXELEMENT9));
+      ++reads;
+    }
+
+    *pNumElements = (UINT)elems.size ();
+
+    return S_OK;
+  }
+
+  std::vector <D3DVERTEXELEMENT9> elems;
+  ULONG                           refs  = 1;
+  int                             reads = 0;
+};
+
+struct mock_device_s : IDirect3DDevice9
+{
+  HRESULT GetRenderTarget (DWORD RenderTargetIndex, IDirect3DSurface9** ppRenderTarget) override
+  {
+    ++rt_queries;
+
+    if (RenderTargetIndex != 0 || rt0 == nullptr)
+      return E_FAIL; // D3DERR_NOTFOUND
+
+    ++rt0->refs;
+    *ppRenderTarget = rt0;
+
+    return S_OK;
+  }
+
+  HRESULT GetVertexDeclaration (IDirect3DVertexDeclaration9** ppDecl) override
+  {
+    ++decl_queries;
+
+    if (decl != nullptr)
+      ++decl->refs;
+
+    *ppDecl = decl;
+
+    return S_OK;
+  }
+
+  mock_surface_s* rt0          = nullptr;
+  mock_decl_s*    decl         = nullptr;
+
+  // A state block records (only) the vertex declaration here
+  bool            recording    = false;
+  bool            block_decl   = false;
+  mock_decl_s*    block_value  = nullptr;
+
+  int             rt_queries   = 0;
+  int             decl_queries = 0;
+};
+
+static uint32_t seed = 777;
+
+static uint32_t
+rnd (void)
+{
+  seed = seed * 1664525U + 1013904223U;
+  return seed >> 8;
+}
+
+static mock_decl_s
+make_decl (uint32_t variant)
+{
+  mock_decl_s decl;
+
+  decl.elems.push_back ({ 0, 0, D3DDECLTYPE_FLOAT3, 0, D3DDECLUSAGE_POSITION, 0 });
+
+  for (uint32_t i = 0; i < variant % 4; i++)
+  {
+    decl.elems.push_back ( { 0, (WORD)(12 + 8 * i), D3DDECLTYPE_FLOAT2, 0,
+                               D3DDECLUSAGE_TEXCOORD, (BYTE)i } );
+  }
+
+  if (variant & 4)
+    decl.elems.push_back ({ 1, 0, D3DDECLTYPE_D3DCOLOR, 0, D3DDECLUSAGE_COLOR, 0 });
+
+  decl.elems.push_back (D3DDECL_END ());
+
+  return decl;
+}
+
+static bool
+same_elements (const D3DVERTEXELEMENT9* pElems, UINT num, const mock_decl_s* decl)
+{
+  if (decl == nullptr)
+    return pElems == nullptr;
+
+  return pElems != nullptr && num == decl->elems.size () &&
+    (! memcmp (pElems, decl->elems.data (), num * sizeof (D3DVERTEXELEMENT9)));
+}
+
+static void
+replay (bool decl_hooked, int calls)
+{
+  mock_device_s                device;
+  std::vector <mock_surface_s> surfaces (6);
+  std::vector <mock_decl_s>    decls;
+  std::vector <mock_decl_s>    fvf_decls;  // The runtime's own, one per FVF
+
+  for (size_t i = 0; i < surfaces.size (); i++)
+  {
+    surfaces [i].desc.Format = i == 0 ? D3DFMT_X8R8G8B8 : D3DFMT_A16B16G16R16F;
+    surfaces [i].desc.Width  = 1920 >> (i / 2);
+    surfaces [i].desc.Height = 1080 >> (i / 2);
+  }
+
+  for (uint32_t i = 0; i < 8; i++) decls.push_back     (make_decl (i));
+  for (uint32_t i = 0; i < 3; i++) fvf_decls.push_back (make_decl (i * 3));
+
+  device.rt0 = &surfaces [0];
+
+  TBF_DeviceShadow shadow;
+
+  shadow.decl_hooked = decl_hooked;
+  shadow.attach (&device);
+
+  // How often the shadow may have had to ask
+  int forgets = 1, // attach
+      queries = 0;
+
+  for (int call = 0; call < calls; call++)
+  {
+    switch (rnd () % 16)
+    {
+      // SetRenderTarget (0, ...); never recorded into a state block
+      case 0: case 1: case 2:
+      {
+        device.rt0 = &surfaces [rnd () % surfaces.size ()];
+        shadow.setRenderTarget (device.rt0);
+      } break;
+
+      // SetVertexDeclaration
+      case 3: case 4: case 5: case 6:
+      {
+        mock_decl_s* decl = &decls [rnd () % decls.size ()];
+
+        if (device.recording)
+        {
+          device.block_decl  = true;
+          device.block_value = decl;
+        }
+
+        else
+        {
+          device.decl = decl;
+          shadow.setVertexDecl (decl);
+        }
+      } break;
+
+      // SetFVF, the detour passes it on either way
+      case 7:
+      {
+        mock_decl_s* decl = &fvf_decls [rnd () % fvf_decls.size ()];
+
+        if (device.recording)
+        {
+          device.block_decl  = true;
+          device.block_value = decl;
+        }
+
+        else
+          device.decl = decl;
+
+        ++forgets;
+        shadow.setFVF ();
+      } break;
+
+      // BeginStateBlock / EndStateBlock
+      case 8:
+      {
+        device.recording = (! device.recording);
+
+        if (device.recording)
+          device.block_decl = false;
+      } break;
+
+      // IDirect3DStateBlock9::Apply
+      case 9:
+      {
+        if (device.recording)
+          break;
+
+        if (device.block_decl)
+          device.decl = device.block_value;
+
+        ++forgets;
+        shadow.invalidate ();
+      } break;
+
+      // Reset
+      case 10:
+      {
+        if (device.recording)
+          break;
+
+        device.rt0  = &surfaces [0];
+        device.decl = nullptr;
+
+        ++forgets;
+        shadow.invalidate ();
+      } break;
+
+      // What the hot paths ask for
+      default:
+      {
+        ++queries;
+
+        D3DSURFACE_DESC    desc = { };
+        IDirect3DSurface9* pSurf =
+          shadow.renderTarget (&desc);
+
+        TBF_CHECK (pSurf == device.rt0);
+        TBF_CHECK (! memcmp (&desc, &device.rt0->desc, sizeof (desc)));
+
+        TBF_CHECK (shadow.vertexDecl () == device.decl);
+
+        UINT                     num    = 0;
+        const D3DVERTEXELEMENT9* pElems =
+          shadow.vertexElements (&num);
+
+        TBF_CHECK (same_elements (pElems, num, device.decl));
+      } break;
+    }
+  }
+
+  // Every reference the shadow took, it gave back
+  for ( auto& surface : surfaces  ) TBF_CHECK_EQ (surface.refs, 1U);
+  for ( auto& decl    : decls     ) TBF_CHECK_EQ (decl.refs,    1U);
+  for ( auto& decl    : fvf_decls ) TBF_CHECK_EQ (decl.refs,    1U);
+
+  // Render target 0 is always shadowed
+  TBF_CHECK (device.rt_queries <= forgets);
+
+  if (decl_hooked)
+    TBF_CHECK   (device.decl_queries <= forgets);
+  else
+    TBF_CHECK_EQ (device.decl_queries, queries * 2);
+
+  printf ( "%s: %d queries, %d GetRenderTarget, %d GetVertexDeclaration\n",
+             decl_hooked ? "hooked" : "unhooked", queries,
+               device.rt_queries, device.decl_queries );
+}
+
+int
+main (void)
+{
+  replay (true,  20000);
+  replay (false, 20000);
+
+  //
+  // A declaration freed while unbound, and another one created at its
+  //   address, has to be read again once it is bound
+  //
+  {
+    mock_device_s  device;
+    mock_surface_s rt;
+    mock_decl_s    a = make_decl (1),
+                   b = make_decl (2);
+
+    device.rt0 = &rt;
+
+    TBF_DeviceShadow shadow;
+
+    shadow.decl_hooked = true;
+    shadow.attach (&device);
+
+    auto bound = [&](mock_decl_s* decl) -> bool {
+      UINT                     num    = 0;
+      const D3DVERTEXELEMENT9* pElems =
+        shadow.vertexElements (&num);
+
+      return same_elements (pElems, num, decl);
+    };
+
+    device.decl = &a; shadow.setVertexDecl (&a);
+    TBF_CHECK (bound (&a));
+
+    device.decl = &b; shadow.setVertexDecl (&b);
+    TBF_CHECK (bound (&b));
+
+    a.elems = make_decl (7).elems;
+
+    device.decl = &a; shadow.setVertexDecl (&a);
+    TBF_CHECK (bound (&a));
+
+    // Bound again, nothing changed; no need to ask
+    const int reads = a.reads;
+
+    shadow.setVertexDecl (&a);
+    TBF_CHECK    (bound (&a));
+    TBF_CHECK_EQ (a.reads, reads);
+
+    TBF_CHECK_EQ (device.decl_queries, 0);
+  }
+
+  // Nothing attached (no device yet)
+  {
+    TBF_DeviceShadow shadow;
+    UINT             num = 0;
+
+    TBF_CHECK (shadow.renderTarget   ()     == nullptr);
+    TBF_CHECK (shadow.vertexDecl     ()     == nullptr);
+    TBF_CHECK (shadow.vertexElements (&num) == nullptr);
+  }
+
+  return TBF_TEST_RESULT ();
+}
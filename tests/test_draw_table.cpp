@@ -0,0 +1,389 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "draw_table.h"
+
+#include <cstring>
+
+//
+// The state TBF_ShouldSkipRenderPass used to read on every draw, laid out
+//   the way render.cpp keeps it.
+//
+struct world_s {
+  struct {
+    uint32_t crc32;
+    bool     clamp_coords;
+    bool     cancel_draws;
+  } tracked_vs, tracked_ps;
+
+  struct {
+    bool     keep_ui_sharp;
+    bool     clamp_skit_coords;
+    bool     clamp_map_coords;
+  } textures;
+
+  struct {
+    bool     hollow_eye_mode;
+    uint32_t hollow_eye_vs_crc32;
+    bool     disable_pause_dim;
+    uint32_t pause_dim_ps_crc32;
+    bool     disable_smoke;
+    uint32_t smoke_ps_crc32;
+  } fun_stuff;
+
+  uint32_t aspect_ratio_trigger;
+
+  struct {
+    std::unordered_set <uint32_t> pixel_shaders;
+    std::unordered_set <uint32_t> vertex_shaders;
+    std::unordered_set <uint32_t> textures;
+  } whitelist;
+};
+
+//
+// The inline predicate from before the decision table, reduced to what it
+//   did with each rule: counted needs_aspect, touched the tracked shaders,
+//     clamped / biased sampler 0, returned early or went for the HUD
+//       viewport (assuming aspect correction is on for a textured strip).
+//
+static tbf_draw_decision_s
+legacy (const world_s& w, uint32_t vs_checksum, uint32_t ps_checksum, uint32_t tex0)
+{
+  tbf_draw_decision_s out = { };
+
+  if (vs_checksum == w.aspect_ratio_trigger || w.aspect_ratio_trigger == 0x00)
+    out.aspect_trigger = true;
+
+  const bool tracked_vs = ( vs_checksum == w.tracked_vs.crc32 );
+  const bool tracked_ps = ( ps_checksum == w.tracked_ps.crc32 );
+
+  out.tracked_vs = tracked_vs;
+  out.tracked_ps = tracked_ps;
+
+  bool clamp   = false;
+  bool sharpen = false;
+
+  if (ps_checksum == w.tracked_ps.crc32 && w.tracked_ps.clamp_coords)
+    clamp = true;
+
+  if (vs_checksum == w.tracked_vs.crc32 && w.tracked_vs.clamp_coords)
+    clamp = true;
+
+  if (w.textures.keep_ui_sharp && ps_checksum == 0x17c397fb) sharpen = true;
+
+  if (                                                         clamp ||
+       ( w.textures.clamp_skit_coords && ps_checksum == 0x872e7c85 ) ||
+       ( w.textures.clamp_map_coords  && ps_checksum == 0xc954a649 ) )
+  {
+    sharpen   = true;
+    out.clamp = true;
+  }
+
+  out.sharpen = sharpen;
+
+  out.skip = true;
+
+  if (tracked_vs && w.tracked_vs.cancel_draws)
+    return out;
+
+  if (tracked_ps && w.tracked_ps.cancel_draws)
+    return out;
+
+  if (w.fun_stuff.hollow_eye_mode && vs_checksum == w.fun_stuff.hollow_eye_vs_crc32)
+    return out;
+
+  if (w.fun_stuff.disable_pause_dim && ps_checksum == w.fun_stuff.pause_dim_ps_crc32)
+    return out;
+
+  if (w.fun_stuff.disable_smoke   && ps_checksum == w.fun_stuff.smoke_ps_crc32 && tex0 == 0x16f618a8)
+    return out;
+
+  out.skip = false;
+
+  if ( w.whitelist.vertex_shaders.count (vs_checksum) ||
+       w.whitelist.pixel_shaders.count  (ps_checksum) ||
+       w.whitelist.textures.count       (tex0) )
+    out.aspect_hud = true;
+
+  return out;
+}
+
+// Mirrors TBF_CurrentDrawRules
+static tbf_draw_rules_s
+rules_for (const world_s& w)
+{
+  tbf_draw_rules_s rules;
+
+  rules.tracked_vs        = w.tracked_vs.crc32;
+  rules.tracked_ps        = w.tracked_ps.crc32;
+  rules.tracked_vs_clamp  = w.tracked_vs.clamp_coords;
+  rules.tracked_vs_cancel = w.tracked_vs.cancel_draws;
+  rules.tracked_ps_clamp  = w.tracked_ps.clamp_coords;
+  rules.tracked_ps_cancel = w.tracked_ps.cancel_draws;
+
+  rules.keep_ui_sharp     = w.textures.keep_ui_sharp;
+  rules.clamp_skit_coords = w.textures.clamp_skit_coords;
+  rules.clamp_map_coords  = w.textures.clamp_map_coords;
+
+  rules.hollow_eye_mode   = w.fun_stuff.hollow_eye_mode;
+  rules.hollow_eye_vs     = w.fun_stuff.hollow_eye_vs_crc32;
+  rules.disable_pause_dim = w.fun_stuff.disable_pause_dim;
+  rules.pause_dim_ps      = w.fun_stuff.pause_dim_ps_crc32;
+  rules.disable_smoke     = w.fun_stuff.disable_smoke;
+  rules.smoke_ps          = w.fun_stuff.smoke_ps_crc32;
+
+  rules.aspect_trigger    = w.aspect_ratio_trigger;
+
+  rules.hud_vs            = &w.whitelist.vertex_shaders;
+  rules.hud_ps            = &w.whitelist.pixel_shaders;
+  rules.hud_tex           = &w.whitelist.textures;
+
+  return rules;
+}
+
+// aspect_hud is never looked at for a skipped draw
+static bool
+same (const tbf_draw_decision_s& a, const tbf_draw_decision_s& b)
+{
+  return a.tracked_vs     == b.tracked_vs     && a.tracked_ps == b.tracked_ps &&
+         a.clamp          == b.clamp          && a.sharpen    == b.sharpen    &&
+         a.skip           == b.skip           &&
+         a.aspect_trigger == b.aspect_trigger &&
+       ( a.skip || a.aspect_hud == b.aspect_hud );
+}
+
+// Every CRC a rule compares against, plus a couple nobody does
+static const uint32_t pool [] = {
+  0x00000000, 0x17c397fb, 0x872e7c85, 0xc954a649, 0x16f618a8,
+  0x0000abcd, 0x12345678, 0xdeadbeef
+};
+
+static const size_t POOL = sizeof (pool) / sizeof (pool [0]);
+
+static uint32_t seed = 1;
+
+static uint32_t
+next (uint32_t n)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) % n;
+}
+
+static void
+randomize (world_s& w)
+{
+  w.tracked_vs.crc32                 = pool [next (POOL)];
+  w.tracked_vs.clamp_coords          = next (2) != 0;
+  w.tracked_vs.cancel_draws          = next (4) == 0;
+  w.tracked_ps.crc32                 = pool [next (POOL)];
+  w.tracked_ps.clamp_coords          = next (2) != 0;
+  w.tracked_ps.cancel_draws          = next (4) == 0;
+
+  w.textures.keep_ui_sharp           = next (2) != 0;
+  w.textures.clamp_skit_coords       = next (2) != 0;
+  w.textures.clamp_map_coords        = next (2) != 0;
+
+  w.fun_stuff.hollow_eye_mode        = next (2) != 0;
+  w.fun_stuff.hollow_eye_vs_crc32    = pool [next (POOL)];
+  w.fun_stuff.disable_pause_dim      = next (2) != 0;
+  w.fun_stuff.pause_dim_ps_crc32     = pool [next (POOL)];
+  w.fun_stuff.disable_smoke          = next (2) != 0;
+  w.fun_stuff.smoke_ps_crc32         = pool [next (POOL)];
+
+  w.aspect_ratio_trigger             = next (3) == 0 ? 0x00 : pool [next (POOL)];
+
+  w.whitelist.vertex_shaders.clear ();
+  w.whitelist.pixel_shaders.clear  ();
+  w.whitelist.textures.clear       ();
+
+  for (uint32_t i = 0; i < next (3); i++) w.whitelist.vertex_shaders.insert (pool [next (POOL)]);
+  for (uint32_t i = 0; i < next (3); i++) w.whitelist.pixel_shaders.insert  (pool [next (POOL)]);
+  for (uint32_t i = 0; i < next (3); i++) w.whitelist.textures.insert       (pool [next (POOL)]);
+}
+
+int
+main (void)
+{
+  static world_s        world;
+  TBF_DrawDecisionTable table (64);
+
+  int      mismatches = 0;
+  uint32_t signature  = 0x00;
+
+  for (int round = 0; round < 2000; round++)
+  {
+    randomize (world);
+
+    // Every few rounds only one whitelist entry is swapped for another
+    if (round % 4 == 3)
+    {
+      randomize (world);
+
+      world.whitelist.textures.clear ();
+      world.whitelist.textures.insert (pool [0]);
+
+      const tbf_draw_rules_s before = rules_for (world);
+
+      if (signature != TBF_DrawRulesSignature (before))
+        table.clear ();
+
+      signature = TBF_DrawRulesSignature (before);
+
+      for (size_t vs = 0; vs < POOL; vs++)
+      {
+        if (table.find (pool [vs], pool [1], pool [4]) == nullptr)
+          table.insert (pool [vs], pool [1], pool [4], TBF_DecideDraw (before, pool [vs], pool [1], pool [4]));
+      }
+
+      world.whitelist.textures.clear ();
+      world.whitelist.textures.insert (pool [4]);
+    }
+
+    // What TBF_RefreshDrawDecisions does once per frame
+    const tbf_draw_rules_s rules = rules_for (world);
+
+    const bool changed =
+      TBF_DrawRulesSignature (rules) != signature;
+
+    if (changed)
+    {
+      table.clear ();
+      signature = TBF_DrawRulesSignature (rules);
+    }
+
+    // Twice over every draw: decided the first time, looked up the second
+    for (int pass = 0; pass < 2; pass++)
+    {
+      for (size_t vs  = 0; vs  < POOL; vs++)
+      for (size_t ps  = 0; ps  < POOL; ps++)
+      for (size_t tex = 0; tex < POOL; tex++)
+      {
+        const tbf_draw_decision_s* decision =
+          table.find (pool [vs], pool [ps], pool [tex]);
+
+        if (changed)
+          TBF_CHECK ((decision == nullptr) == (pass == 0));
+
+        if (decision == nullptr)
+          decision = table.insert ( pool [vs], pool [ps], pool [tex],
+                                      TBF_DecideDraw (rules, pool [vs], pool [ps], pool [tex]) );
+
+        if (! same (*decision, legacy (world, pool [vs], pool [ps], pool [tex])))
+          ++mismatches;
+      }
+    }
+
+    TBF_CHECK_EQ (table.size (), POOL * POOL * POOL);
+  }
+
+  TBF_CHECK_EQ (mismatches, 0);
+
+  //
+  // The signature follows every input, whitelist contents included, and
+  //   nothing else
+  //
+  {
+    world_s w;
+
+    randomize (w);
+
+    w.whitelist.vertex_shaders = { 0x11111111, 0x22222222, 0x33333333 };
+
+    const uint32_t base = TBF_DrawRulesSignature (rules_for (w));
+
+    world_s same_keys = w;
+
+    same_keys.whitelist.vertex_shaders = { 0x33333333, 0x11111111, 0x22222222 };
+    same_keys.whitelist.vertex_shaders.reserve (64);
+
+    TBF_CHECK_EQ (TBF_DrawRulesSignature (rules_for (same_keys)), base);
+
+    // Same size, one key different
+    world_s swapped = w;
+
+    swapped.whitelist.vertex_shaders.erase  (0x22222222);
+    swapped.whitelist.vertex_shaders.insert (0x44444444);
+
+    TBF_CHECK    (TBF_DrawRulesSignature (rules_for (swapped)) != base);
+
+    // The same key in another list
+    world_s moved = w;
+
+    moved.whitelist.vertex_shaders.erase (0x33333333);
+    moved.whitelist.pixel_shaders.insert (0x33333333);
+
+    TBF_CHECK    (TBF_DrawRulesSignature (rules_for (moved)) != base);
+
+    world_s t = w; t.tracked_vs.clamp_coords     = ! t.tracked_vs.clamp_coords;
+    TBF_CHECK    (TBF_DrawRulesSignature (rules_for (t)) != base);
+
+    t = w; t.fun_stuff.disable_smoke = ! t.fun_stuff.disable_smoke;
+    TBF_CHECK    (TBF_DrawRulesSignature (rules_for (t)) != base);
+
+    t = w; t.aspect_ratio_trigger ^= 1;
+    TBF_CHECK    (TBF_DrawRulesSignature (rules_for (t)) != base);
+
+    // A decision taken before the swap does not survive a refresh
+    TBF_DrawDecisionTable cached;
+
+    const tbf_draw_rules_s before = rules_for (w),
+                           after  = rules_for (swapped);
+
+    cached.insert (0x22222222, 0, 0, TBF_DecideDraw (before, 0x22222222, 0, 0));
+
+    TBF_CHECK (cached.find (0x22222222, 0, 0)->aspect_hud);
+
+    if (TBF_DrawRulesSignature (after) != TBF_DrawRulesSignature (before))
+      cached.clear ();
+
+    TBF_CHECK (cached.find (0x22222222, 0, 0) == nullptr);
+    TBF_CHECK (! TBF_DecideDraw (after, 0x22222222, 0, 0).aspect_hud);
+  }
+
+  // No whitelists at all
+  tbf_draw_rules_s bare;
+
+  TBF_CHECK (! TBF_DecideDraw (bare, 1, 2, 3).aspect_hud);
+  TBF_CHECK (  TBF_DecideDraw (bare, 1, 2, 3).aspect_trigger);
+
+  // The table starts over past MAX_ENTRIES instead of growing forever
+  TBF_DrawDecisionTable big;
+  tbf_draw_decision_s   skip = { };
+
+  skip.skip = true;
+
+  for (uint32_t i = 0; i < TBF_DrawDecisionTable::MAX_ENTRIES; i++)
+    big.insert (i, i * 3, i * 7, skip);
+
+  TBF_CHECK_EQ (big.size (), TBF_DrawDecisionTable::MAX_ENTRIES);
+  TBF_CHECK    (big.find (12345, 12345 * 3, 12345 * 7) != nullptr);
+  TBF_CHECK    (big.find (12345, 12345 * 3, 12345 * 7)->skip);
+
+  big.insert (0xffffffff, 0, 0, skip);
+
+  TBF_CHECK_EQ (big.size (), 1U);
+  TBF_CHECK    (big.find (12345, 12345 * 3, 12345 * 7) == nullptr);
+  TBF_CHECK    (big.find (0xffffffff, 0, 0)            != nullptr);
+
+  return TBF_TEST_RESULT ();
+}
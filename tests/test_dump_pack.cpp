@@ -0,0 +1,243 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "dump_pack.h"
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static const char*    szTree   = "test_dump_pack.d";
+static const wchar_t* wszData  = L"test_dump_pack.d/textures.dumppack";
+static const wchar_t* wszIndex = L"test_dump_pack.d/textures.dumpidx";
+
+static const int      NUM_DUMPS = 300;
+
+// What each checksum should extract to: format and bytes
+struct tbf_expected_s {
+  uint32_t              format;
+  std::vector <uint8_t> data;
+};
+
+static std::vector <uint8_t>
+make_dump (uint32_t checksum, size_t size)
+{
+  std::vector <uint8_t> data (size);
+  uint32_t              seed = checksum;
+
+  for (auto& byte : data)
+  {
+    seed = seed * 1664525U + 1013904223U;
+    byte = (uint8_t)(seed >> 24);
+  }
+
+  return data;
+}
+
+static std::vector <uint8_t>
+read_file (const fs::path& path)
+{
+  std::vector <uint8_t> data ((size_t)fs::file_size (path));
+
+  FILE* fFile = fopen (path.string ().c_str (), "rb");
+
+  if (fFile != nullptr)
+  {
+    data.resize (fread (data.data (), 1, data.size (), fFile));
+    fclose      (fFile);
+  }
+
+  return data;
+}
+
+//
+// Extracts everything the way TBF_ExtractDumpPack does, to
+//   <tree>/<format>/<checksum>.dds, and compares it with what was dumped
+//
+static void
+check_extract (TBF_DumpPack& pack, const std::map <uint32_t, tbf_expected_s>& expected)
+{
+  fs::remove_all (fs::path (szTree) / "extract");
+
+  auto entries =
+    pack.entries ();
+
+  TBF_CHECK_EQ (entries.size (), expected.size ());
+
+  for ( auto& entry : entries )
+  {
+    auto it = expected.find (entry.checksum);
+
+    TBF_CHECK (it != expected.end ());
+
+    if (it == expected.end ())
+      continue;
+
+    TBF_CHECK_EQ (entry.format, it->second.format);
+
+    fs::path dir =
+      fs::path (szTree) / "extract" / std::to_string (entry.format);
+
+    fs::create_directories (dir);
+
+    char szName [16];
+    snprintf (szName, 16, "%08x.dds", entry.checksum);
+
+    TBF_CHECK (pack.extract (entry, (dir / szName).wstring ().c_str ()));
+    TBF_CHECK (read_file (dir / szName) == it->second.data);
+  }
+
+  for ( auto& it : expected )
+  {
+    tbf_dump_entry_s entry;
+    TBF_CHECK (pack.find (it.first, &entry));
+  }
+}
+
+int
+main (void)
+{
+  fs::remove_all       (szTree);
+  fs::create_directory (szTree);
+
+  std::map <uint32_t, tbf_expected_s> expected;
+
+  static const uint32_t formats [] = { 827611204U,   // DXT1
+                                       894720068U,   // DXT5
+                                       21U };        // A8R8G8B8
+
+  // A session's worth of dumps
+  {
+    TBF_DumpPack pack;
+
+    TBF_CHECK (pack.open (wszData, wszIndex));
+
+    for (int i = 0; i < NUM_DUMPS; i++)
+    {
+      uint32_t checksum = 0x9e3779b1U * (uint32_t)(i + 1);
+      uint32_t format   = formats [i % 3];
+      size_t   size     = 128 + (size_t)(i % 17) * 4096 + (size_t)i;
+
+      auto data = make_dump (checksum, size);
+
+      TBF_CHECK (pack.append (checksum, format, data.data (), (uint32_t)data.size ()));
+
+      expected [checksum] = { format, data };
+    }
+
+    // Dumped again (the newest record wins) and deleted (it is gone)
+    uint32_t redumped = 0x9e3779b1U * 7U;
+    uint32_t deleted  = 0x9e3779b1U * 8U;
+
+    auto data = make_dump (redumped ^ 0xffffffffU, 9000);
+
+    TBF_CHECK (pack.append (redumped, 21U, data.data (), (uint32_t)data.size ()));
+    expected [redumped] = { 21U, data };
+
+    TBF_CHECK   (pack.remove (deleted));
+    TBF_CHECK   (! pack.remove (deleted));
+    expected.erase (deleted);
+
+    tbf_dump_entry_s entry;
+    TBF_CHECK (! pack.find (deleted, &entry));
+
+    check_extract (pack, expected);
+  }
+
+  // The next session sees the same textures
+  {
+    TBF_DumpPack pack;
+
+    TBF_CHECK     (pack.open (wszData, wszIndex));
+    check_extract (pack, expected);
+  }
+
+  const uint64_t index_size = fs::file_size (wszIndex);
+
+  //
+  // A session that died after writing an index record but before its data
+  //   reached the disk: the record is dropped and the index rewritten, so
+  //     the next append can have the space.
+  //
+  {
+    TBF_DumpPack pack;
+
+    TBF_CHECK (pack.open (wszData, wszIndex));
+
+    auto data = make_dump (0x12345678U, 50000);
+
+    TBF_CHECK (pack.append (0x12345678U, 21U, data.data (), (uint32_t)data.size ()));
+  }
+
+  fs::resize_file (wszData, fs::file_size (wszData) - 1);
+
+  {
+    TBF_DumpPack pack;
+
+    TBF_CHECK     (pack.open (wszData, wszIndex));
+    TBF_CHECK_EQ  (fs::file_size (wszIndex), index_size);
+
+    tbf_dump_entry_s entry;
+    TBF_CHECK     (! pack.find (0x12345678U, &entry));
+
+    auto data = make_dump (0x0badf00dU, 777);
+
+    TBF_CHECK (pack.append (0x0badf00dU, 894720068U, data.data (), (uint32_t)data.size ()));
+    expected [0x0badf00dU] = { 894720068U, data };
+
+    check_extract (pack, expected);
+  }
+
+  // Half a record at the end of the index: cut off
+  {
+    FILE* fIndex = fopen (fs::path (wszIndex).string ().c_str (), "ab");
+    fwrite ("partial", 1, 7, fIndex);
+    fclose (fIndex);
+
+    TBF_DumpPack pack;
+
+    TBF_CHECK     (pack.open (wszData, wszIndex));
+    TBF_CHECK_EQ  ( (fs::file_size (wszIndex) - 2 * sizeof (uint32_t)) %
+                      sizeof (tbf_dump_entry_s), 0U );
+    check_extract (pack, expected);
+  }
+
+  // Not an index at all
+  {
+    FILE* fIndex = fopen (fs::path (wszIndex).string ().c_str (), "r+b");
+    fwrite ("XXXX", 1, 4, fIndex);
+    fclose (fIndex);
+
+    TBF_DumpPack pack;
+
+    TBF_CHECK (! pack.open   (wszData, wszIndex));
+    TBF_CHECK (! pack.isOpen ());
+  }
+
+  fs::remove_all (szTree);
+
+  return TBF_TEST_RESULT ();
+}
@@ -0,0 +1,428 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+//
+// The per-frame tracking must not touch the heap once it has seen a frame:
+//   every set is generation-stamped and keeps its slots across clear (), the
+//     shader records and draw decisions are reused. Global operator new is
+//       replaced with a counting one, a recorded frame is driven through the
+//         same containers D3D9EndFrame_Post clears, and after warm-up the
+//           count has to stay put.
+//
+#include "tbf_test.h"
+#include "replay.h"
+#include "shader_cache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+static size_t allocations = 0;
+
+void*
+operator new (size_t size)
+{
+  ++allocations;
+
+  void* ptr = malloc (size != 0 ? size : 1);
+
+  if (ptr == nullptr)
+    throw std::bad_alloc ();
+
+  return ptr;
+}
+
+void* operator new[]    (size_t size)                 { return operator new (size); }
+void  operator delete   (void* ptr) noexcept          { free (ptr); }
+void  operator delete[] (void* ptr) noexcept          { free (ptr); }
+void  operator delete   (void* ptr, size_t) noexcept  { free (ptr); }
+void  operator delete[] (void* ptr, size_t) noexcept  { free (ptr); }
+
+static const char* szFile = "test_frame_alloc.bin";
+
+static const uint32_t NUM_SHADERS  = 120;
+static const uint32_t NUM_TEXTURES = 600;
+static const uint32_t NUM_BUFFERS  = 80;
+static const uint32_t NUM_TARGETS  = 8;  // The first textures double as render targets
+static const uint32_t PASSES       = 400;
+
+// Stand-ins for the game's D3D objects, only their addresses matter
+static char shader_objs  [NUM_SHADERS];
+static char texture_objs [NUM_TEXTURES];
+static char buffer_objs  [NUM_BUFFERS];
+static char decl_objs    [4];
+
+static uint32_t shader_crc  (uint32_t idx) { return 0x5000 + idx; }
+static uint32_t texture_crc (uint32_t idx) { return 0x7000 + idx; }
+
+static std::vector <tbf_trace_record_s> frame;
+
+static void
+rec ( tbf_trace_op op,       uint16_t slot = 0,
+      uint32_t     arg0 = 0, uint32_t arg1 = 0, uint32_t arg2 = 0 )
+{
+  tbf_trace_record_s r = { };
+
+  r.op       = (uint8_t)op;
+  r.slot     = slot;
+  r.time     = frame.size () * 1000ULL;
+  r.cost     = 10;
+  r.args [0] = arg0;
+  r.args [1] = arg1;
+  r.args [2] = arg2;
+
+  frame.push_back (r);
+}
+
+//
+// One frame of a scene: a few hundred passes, each binding shaders, textures
+//   and a vertex buffer, setting some state and drawing. SetStreamSource's
+//     offset argument says which of the mock buffers was bound.
+//
+static void
+record_frame (void)
+{
+  uint32_t seed = 0x2545f491;
+
+  auto next = [&](uint32_t range) -> uint32_t {
+    seed = seed * 1664525 + 1013904223;
+    return (seed >> 8) % range;
+  };
+
+  rec (tbf_trace_op::SetRenderTarget, 0, 1920, 1080);
+
+  for (uint32_t pass = 0; pass < PASSES; pass++)
+  {
+    if (pass % 50 == 0)
+      rec (tbf_trace_op::SetRenderTarget, 0, 512, 512);
+
+    rec (tbf_trace_op::SetVertexShader, 0, shader_crc (next (NUM_SHADERS / 2)));
+    rec (tbf_trace_op::SetPixelShader,  0, shader_crc (NUM_SHADERS / 2 + next (NUM_SHADERS / 2)));
+
+    for (uint16_t sampler = 0; sampler < 4; sampler++)
+      rec (tbf_trace_op::SetTexture, sampler, texture_crc (next (NUM_TEXTURES)));
+
+    rec (tbf_trace_op::SetStreamSource, 0, next (NUM_BUFFERS), 32, next (4) == 0);
+
+    rec (tbf_trace_op::SetRenderState,  D3DRS_ZENABLE,  next (2));
+    rec (tbf_trace_op::SetSamplerState, 0,              D3DSAMP_ADDRESSU, 1 + 2 * next (2));
+
+    rec (tbf_trace_op::DrawIndexedPrimitive, 4, 3 * (1 + next (1000)), 0, 1 + next (1000));
+  }
+
+  rec (tbf_trace_op::EndFrame);
+}
+
+//
+// The tracking D3D9EndFrame_Post resets, keyed the way render.h keys it
+//
+struct frame_tracking_s
+{
+  TBF_ShaderCache         shaders;
+  TBF_DrawDecisionTable   decisions;
+  TBF_StateCache          state_cache;
+  tbf_draw_rules_s        rules;
+
+  struct {
+    TBF_FrameSet                  pixel_shaders;
+    TBF_FrameSet                  vertex_shaders;
+    uint32_t                      frame = 1;
+
+    struct {
+      TBF_FrameSetT <const void *> dynamic;
+      TBF_FrameSetT <const void *> immutable;
+    } vertex_buffers;
+  } last_frame;
+
+  struct {
+    const void*    tracking_tex = &texture_objs [3];
+    TBF_FrameSet   pixel_shaders;
+    TBF_FrameSet   vertex_shaders;
+    bool           active       = false;
+  } tracked_rt;
+
+  struct {
+    uint32_t       crc32        = shader_crc (7);
+    bool           active       = false;
+    TBF_FrameSet   used_textures;
+  } tracked_vs;
+
+  struct {
+    const void*                  vertex_buffer = &buffer_objs [11];
+    bool                         active        = false;
+    TBF_FrameSet                 vertex_shaders;
+    TBF_FrameSet                 pixel_shaders;
+    TBF_FrameSet                 textures;
+    TBF_FrameSetT <const void *> vertex_decls;
+  } tracked_vb;
+
+  TBF_FrameSetT <const void *> used_render_targets;
+
+  uint32_t vs = 0x00, ps = 0x00, tex [4] = { };
+  uint64_t draws_skipped = 0;
+
+  void bindShader (uint32_t crc32, TBF_FrameSet& used)
+  {
+    const void* pShader = &shader_objs [crc32 - shader_crc (0)];
+
+    tbf_shader_record_s* shader = shaders.find (pShader);
+
+    if (shader == nullptr)
+      shader = shaders.insert (pShader, crc32);
+
+    if (shader->frame != last_frame.frame)
+    {
+      shader->frame = last_frame.frame;
+      used.insert (crc32);
+    }
+  }
+
+  void replay (const tbf_trace_record_s& rec)
+  {
+    switch ((tbf_trace_op)rec.op)
+    {
+      case tbf_trace_op::EndFrame:
+        used_render_targets.clear ();
+        state_cache.endFrame      ();
+        state_cache.invalidate    ();
+
+        last_frame.pixel_shaders.clear            ();
+        last_frame.vertex_shaders.clear           ();
+        last_frame.vertex_buffers.dynamic.clear   ();
+        last_frame.vertex_buffers.immutable.clear ();
+        ++last_frame.frame;
+
+        tracked_rt.pixel_shaders.clear  ();
+        tracked_rt.vertex_shaders.clear ();
+        tracked_rt.active = false;
+
+        tracked_vs.used_textures.clear ();
+        tracked_vs.active = false;
+
+        tracked_vb.vertex_shaders.clear ();
+        tracked_vb.pixel_shaders.clear  ();
+        tracked_vb.textures.clear       ();
+        tracked_vb.vertex_decls.clear   ();
+        tracked_vb.active = false;
+        break;
+
+      case tbf_trace_op::SetVertexShader:
+        vs = rec.args [0];
+        bindShader (vs, last_frame.vertex_shaders);
+        tracked_vs.active = (vs == tracked_vs.crc32);
+        break;
+
+      case tbf_trace_op::SetPixelShader:
+        ps = rec.args [0];
+        bindShader (ps, last_frame.pixel_shaders);
+        break;
+
+      case tbf_trace_op::SetTexture:
+      {
+        const uint32_t idx = rec.args [0] - texture_crc (0);
+
+        tex [rec.slot] = rec.args [0];
+
+        if (idx < NUM_TARGETS)
+          used_render_targets.insert (&texture_objs [idx]);
+
+        if (rec.slot == 0)
+          tracked_rt.active = (&texture_objs [idx] == tracked_rt.tracking_tex);
+
+        if (tracked_vs.active)
+          tracked_vs.used_textures.insert (rec.args [0]);
+      } break;
+
+      case tbf_trace_op::SetRenderTarget:
+        state_cache.targetChanged ();
+        break;
+
+      case tbf_trace_op::SetStreamSource:
+      {
+        const void* pBuffer = &buffer_objs [rec.args [0]];
+
+        if (rec.args [2])
+          last_frame.vertex_buffers.dynamic.insert   (pBuffer);
+        else
+          last_frame.vertex_buffers.immutable.insert (pBuffer);
+
+        tracked_vb.active = (pBuffer == tracked_vb.vertex_buffer);
+      } break;
+
+      case tbf_trace_op::SetRenderState:
+        state_cache.renderState ((D3DRENDERSTATETYPE)rec.slot, rec.args [0]);
+        break;
+
+      case tbf_trace_op::SetSamplerState:
+        state_cache.samplerState (rec.slot, (D3DSAMPLERSTATETYPE)rec.args [0], rec.args [1]);
+        break;
+
+      case tbf_trace_op::DrawIndexedPrimitive:
+      {
+        const tbf_draw_decision_s* decision =
+          decisions.find (vs, ps, tex [0]);
+
+        if (decision == nullptr)
+          decision = decisions.insert (vs, ps, tex [0], TBF_DecideDraw (rules, vs, ps, tex [0]));
+
+        if (decision->skip)
+          ++draws_skipped;
+
+        if (tracked_rt.active)
+        {
+          tracked_rt.vertex_shaders.insert (vs);
+          tracked_rt.pixel_shaders.insert  (ps);
+        }
+
+        if (tracked_vb.active)
+        {
+          tracked_vb.vertex_shaders.insert (vs);
+          tracked_vb.pixel_shaders.insert  (ps);
+
+          for ( auto crc32 : tex )
+            tracked_vb.textures.insert (crc32);
+
+          tracked_vb.vertex_decls.insert (&decl_objs [vs & 3]);
+        }
+      } break;
+
+      default:
+        break;
+    }
+  }
+};
+
+static void
+write_trace (uint32_t frames)
+{
+  FILE* fOut = fopen (szFile, "wb");
+
+  tbf_trace_header_s header;
+
+  header.magic       = TBF_TRACE_MAGIC;
+  header.version     = TBF_TRACE_VERSION;
+  header.record_size = sizeof (tbf_trace_record_s);
+  header.ops         = (uint32_t)tbf_trace_op::Count;
+  header.frequency   = 10000000;
+
+  fwrite (&header, sizeof (header), 1, fOut);
+
+  for (uint32_t i = 0; i < frames; i++)
+    fwrite (frame.data (), sizeof (tbf_trace_record_s), frame.size (), fOut);
+
+  fclose (fOut);
+}
+
+static size_t
+replay_allocations (uint32_t frames, tbf_replay_stats_s& stats)
+{
+  write_trace (frames);
+
+  TBF_TraceReplay replay;
+
+  TBF_CHECK (replay.load (szFile));
+  TBF_CHECK_EQ (replay.records ().size (), frames * frame.size ());
+
+  tbf_replay_config_s config;
+
+  const size_t before = allocations;
+
+  replay.run (config, stats);
+
+  return allocations - before;
+}
+
+int
+main (void)
+{
+  record_frame ();
+
+  // The counter sees this test's own allocations
+  {
+    const size_t before = allocations;
+
+    std::vector <int> v (16);
+
+    TBF_CHECK_EQ (allocations - before, 1U);
+  }
+
+  frame_tracking_s tracking;
+
+  // Warm-up: the first frame grows the sets and fills the shader records and
+  //   decisions, the second must already be free
+  for ( auto& r : frame ) tracking.replay (r);
+
+  const size_t warm_start = allocations;
+
+  for ( auto& r : frame ) tracking.replay (r);
+
+  TBF_CHECK_EQ (allocations - warm_start, 0U);
+
+  TBF_CHECK_EQ (tracking.shaders.size (), (size_t)NUM_SHADERS);
+  TBF_CHECK (tracking.last_frame.frame == 3);
+
+  const size_t steady = allocations;
+
+  uint64_t unique_vs = 0, unique_tex = 0, vb_draws = 0;
+
+  for (int i = 0; i < 200; i++)
+  {
+    for ( auto& r : frame )
+    {
+      // Just before the frame ends, while the sets are still full
+      if ((tbf_trace_op)r.op == tbf_trace_op::EndFrame)
+      {
+        unique_vs  += tracking.last_frame.vertex_shaders.size ();
+        unique_tex += tracking.tracked_vs.used_textures.size  ();
+        vb_draws   += tracking.tracked_vb.vertex_shaders.size ();
+      }
+
+      tracking.replay (r);
+    }
+  }
+
+  TBF_CHECK_EQ (allocations - steady, 0U);
+
+  // The frames did fill the sets every time round
+  TBF_CHECK (unique_vs  > 0 && unique_vs  % 200 == 0);
+  TBF_CHECK (unique_tex > 0 && unique_tex % 200 == 0);
+  TBF_CHECK (vb_draws   > 0 && vb_draws   % 200 == 0);
+
+  //
+  // The trace replay tool's own tracking: whatever it allocates for the
+  //   tables is paid once, not per frame
+  //
+  tbf_replay_stats_s short_stats, long_stats;
+
+  const size_t short_allocs = replay_allocations (2,  short_stats);
+  const size_t long_allocs  = replay_allocations (64, long_stats);
+
+  TBF_CHECK_EQ (short_stats.frames,  2U);
+  TBF_CHECK_EQ (long_stats.frames,  64U);
+  TBF_CHECK    (long_stats.unique_vs == short_stats.unique_vs * 32);
+  TBF_CHECK_EQ (long_allocs, short_allocs);
+
+  remove (szFile);
+
+  return TBF_TEST_RESULT ();
+}
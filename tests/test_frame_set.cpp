@@ -0,0 +1,93 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "frame_set.h"
+
+#include <vector>
+
+int
+main (void)
+{
+  TBF_FrameSet set (4);
+
+  TBF_CHECK (set.empty ());
+  TBF_CHECK (set.insert   (7));
+  TBF_CHECK (set.contains (7));
+  TBF_CHECK (! set.insert (7));
+  TBF_CHECK (! set.contains (8));
+  TBF_CHECK_EQ (set.size (), 1U);
+
+  // Well past the initial capacity; nothing lost while growing
+  for (uint32_t i = 100; i < 5100; i++)
+    TBF_CHECK (set.insert (i * 16));
+
+  TBF_CHECK_EQ (set.size (), 5001U);
+
+  for (uint32_t i = 100; i < 5100; i++)
+    TBF_CHECK (set.contains (i * 16));
+
+  TBF_CHECK (set.contains (7));
+
+  // Insertion order
+  std::vector <uint32_t> keys (set.begin (), set.end ());
+
+  TBF_CHECK_EQ (keys.front (), 7U);
+  TBF_CHECK_EQ (keys [1],      1600U);
+  TBF_CHECK_EQ (keys.back  (), 5099U * 16);
+
+  // Clearing is a new generation, every key is gone
+  set.clear ();
+
+  TBF_CHECK (set.empty ());
+  TBF_CHECK (! set.contains (7));
+  TBF_CHECK (! set.contains (1600));
+  TBF_CHECK (set.insert (1600));
+
+  // Many frames in a row, one key each
+  for (uint32_t frame = 0; frame < 1000; frame++)
+  {
+    set.clear ();
+
+    TBF_CHECK (set.insert (frame));
+    TBF_CHECK (! set.contains (frame - 1));
+  }
+
+  // Pointer keys, heap-aligned and otherwise
+  std::vector <uint64_t> objects (256);
+
+  TBF_FrameSetT <const void*> ptrs;
+
+  for ( auto& obj : objects )
+    TBF_CHECK (ptrs.insert (&obj));
+
+  for ( auto& obj : objects )
+  {
+    TBF_CHECK (ptrs.contains (&obj));
+    TBF_CHECK (! ptrs.insert (&obj));
+  }
+
+  TBF_CHECK (! ptrs.contains (nullptr));
+  TBF_CHECK_EQ (ptrs.size (), objects.size ());
+
+  return TBF_TEST_RESULT ();
+}
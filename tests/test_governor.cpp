@@ -0,0 +1,267 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "governor.h"
+
+//
+// Feeds frames of frame_ms until the level changes; the time that took, or
+//   -1 if it did not happen within limit_ms
+//
+static float
+until_change (TBF_QualityGovernor& gov, float frame_ms, float limit_ms)
+{
+  for (float elapsed = frame_ms; elapsed <= limit_ms; elapsed += frame_ms)
+  {
+    if (gov.sample (frame_ms))
+      return elapsed;
+  }
+
+  return -1.0f;
+}
+
+// Whole 30-frame windows, none of which may change the level
+static void
+feed (TBF_QualityGovernor& gov, float frame_ms, int windows)
+{
+  for (int frame = 0; frame < windows * 30; frame++)
+    TBF_CHECK (! gov.sample (frame_ms));
+}
+
+static bool
+near (float elapsed, float expected, float window_ms)
+{
+  return elapsed >= expected && elapsed <= expected + window_ms;
+}
+
+static int
+notches (const tbf_quality_s& a, const tbf_quality_s& b)
+{
+  return (a.shadow_rescale      != b.shadow_rescale)      +
+         (a.env_shadow_rescale  != b.env_shadow_rescale)  +
+         (a.postproc_ratio      != b.postproc_ratio)      +
+         (a.high_res_bloom      != b.high_res_bloom)      +
+         (a.high_res_reflection != b.high_res_reflection);
+}
+
+int
+main (void)
+{
+  // 60 FPS target: slow above 18.3 ms, met at or below 17.2 ms
+  const float slow      = 40.0f; // 1.2 s windows
+  const float fast      = 10.0f; // 0.3 s windows
+  const float slow_win  = slow * 30;
+  const float fast_win  = fast * 30;
+
+  TBF_QualityGovernor gov;
+
+  gov.configure (60.0f, 3);
+
+  TBF_CHECK_EQ (gov.level    (), 0);
+  TBF_CHECK_EQ (gov.maxLevel (), 3);
+
+  //
+  // Step down: three slow windows in a row, but never within the cooldown
+  //
+  float t = until_change (gov, slow, 60000.0f);
+
+  TBF_CHECK    (near (t, 10000.0f, slow_win));
+  TBF_CHECK_EQ (gov.level (), 1);
+  TBF_CHECK    (gov.average () > 39.0f && gov.average () < 41.0f);
+
+  t = until_change (gov, slow, 60000.0f);
+
+  TBF_CHECK    (near (t, 10000.0f, slow_win));
+  TBF_CHECK_EQ (gov.level (), 2);
+
+  // Slow windows have to be consecutive
+  gov.reset     ();
+  gov.configure (60.0f, 3);
+  feed          (gov, fast, 34); // Past the cooldown
+
+  for (int i = 0; i < 20; i++)
+  {
+    feed (gov, slow, 2);
+    feed (gov, fast, 1);
+  }
+
+  TBF_CHECK_EQ (gov.level (), 0);
+
+  // Exactly SLOW_WINDOWS is enough once the cooldown is over
+  t = until_change (gov, slow, slow_win * 3);
+
+  TBF_CHECK    (t > 0.0f);
+  TBF_CHECK_EQ (gov.level (), 1);
+
+  // Hitches are not frame times
+  gov.reset ();
+  feed      (gov, 300.0f, 20);
+
+  TBF_CHECK_EQ (gov.level   (), 0);
+  TBF_CHECK_EQ (gov.average (), 0.0f);
+
+  // Never past the maximum level
+  gov.reset ();
+
+  for (int i = 0; i < 3; i++)
+    TBF_CHECK (until_change (gov, slow, 60000.0f) > 0.0f);
+
+  TBF_CHECK_EQ (gov.level (), 3);
+  TBF_CHECK    (until_change (gov, slow, 120000.0f) < 0.0f);
+
+  // A new (lower) maximum takes effect immediately
+  gov.configure (60.0f, 1);
+
+  TBF_CHECK_EQ (gov.level (), 1);
+
+  //
+  // Step up is a probe after PROBE_BASE_MS of meeting the target; a probe
+  //   that gets undone makes the next one wait twice as long, up to
+  //     PROBE_MAX_MS
+  //
+  gov.reset     ();
+  gov.configure (60.0f, 3);
+
+  TBF_CHECK    (until_change (gov, slow, 60000.0f) > 0.0f);
+  TBF_CHECK_EQ (gov.level (), 1);
+
+  float probe = 20000.0f;
+
+  for (int i = 0; i < 6; i++)
+  {
+    t = until_change (gov, fast, 1000000.0f);
+
+    TBF_CHECK    (near (t, probe, fast_win * 2));
+    TBF_CHECK_EQ (gov.level (), 0);
+
+    // Undone right away
+    t = until_change (gov, slow, 60000.0f);
+
+    TBF_CHECK    (near (t, 10000.0f, slow_win));
+    TBF_CHECK_EQ (gov.level (), 1);
+
+    probe = probe * 2.0f < 320000.0f ? probe * 2.0f : 320000.0f;
+  }
+
+  TBF_CHECK_EQ (probe, 320000.0f);
+
+  // A probe that holds for PROBE_HOLD_MS resets the back-off
+  t = until_change (gov, fast, 1000000.0f);
+
+  TBF_CHECK    (near (t, 320000.0f, fast_win * 2));
+  TBF_CHECK_EQ (gov.level (), 0);
+
+  feed (gov, fast, 204); // 61.2 s
+
+  TBF_CHECK    (until_change (gov, slow, 60000.0f) > 0.0f);
+  TBF_CHECK_EQ (gov.level (), 1);
+
+  t = until_change (gov, fast, 1000000.0f);
+
+  TBF_CHECK    (near (t, 20000.0f, fast_win * 2));
+  TBF_CHECK_EQ (gov.level (), 0);
+
+  // Close to the target but not under OK_RATIO: neither up nor down
+  gov.reset ();
+
+  TBF_CHECK (until_change (gov, slow, 60000.0f) > 0.0f);
+  TBF_CHECK (until_change (gov, 17.7f, 600000.0f) < 0.0f);
+
+  //
+  // degrade (): reflection, bloom, then env shadows / shadows / post in turn
+  //
+  tbf_quality_s user;
+
+  user.high_res_reflection = true;
+  user.high_res_bloom      = true;
+  user.env_shadow_rescale  = 2;
+  user.shadow_rescale      = 1;
+  user.postproc_ratio      = 2.0f;
+
+  int max_level = -1;
+
+  tbf_quality_s q = TBF_QualityGovernor::degrade (user, 0, &max_level);
+
+  TBF_CHECK_EQ (notches (q, user), 0);
+  TBF_CHECK_EQ (max_level,         7);
+
+  tbf_quality_s levels [8];
+
+  for (int level = 0; level <= 7; level++)
+    levels [level] = TBF_QualityGovernor::degrade (user, level);
+
+  for (int level = 1; level <= 7; level++)
+    TBF_CHECK_EQ (notches (levels [level - 1], levels [level]), 1);
+
+  TBF_CHECK (! levels [1].high_res_reflection && levels [1].high_res_bloom);
+  TBF_CHECK (! levels [2].high_res_bloom);
+  TBF_CHECK_EQ (levels [3].env_shadow_rescale, 1);
+  TBF_CHECK_EQ (levels [4].shadow_rescale,     0);
+  TBF_CHECK_EQ (levels [5].postproc_ratio,     1.0f);
+  TBF_CHECK_EQ (levels [6].env_shadow_rescale, 0);
+  TBF_CHECK_EQ (levels [7].postproc_ratio,     0.5f);
+
+  // Past the maximum is the same as the maximum
+  TBF_CHECK_EQ (notches (TBF_QualityGovernor::degrade (user, 100), levels [7]), 0);
+
+  // Defaults: env shadows, then both halves of the promoted shadow maps
+  tbf_quality_s defaults;
+
+  TBF_QualityGovernor::degrade (defaults, 0, &max_level);
+
+  TBF_CHECK_EQ (max_level, 3);
+  TBF_CHECK_EQ (TBF_QualityGovernor::degrade (defaults, 1).env_shadow_rescale,  0);
+  TBF_CHECK_EQ (TBF_QualityGovernor::degrade (defaults, 1).shadow_rescale,     -2);
+  TBF_CHECK_EQ (TBF_QualityGovernor::degrade (defaults, 2).shadow_rescale,     -1);
+  TBF_CHECK_EQ (TBF_QualityGovernor::degrade (defaults, 3).shadow_rescale,      0);
+
+  // Nothing to take off
+  tbf_quality_s minimal;
+
+  minimal.shadow_rescale     = 0;
+  minimal.env_shadow_rescale = 0;
+
+  TBF_QualityGovernor::degrade (minimal, 5, &max_level);
+
+  TBF_CHECK_EQ (max_level, 0);
+
+  // Shadow map scaling at each step: negative rescales promote 64x64 maps
+  //   one step further, so every model shadow ends up the same size
+  const tbf_quality_s level2 = TBF_QualityGovernor::degrade (defaults, 2),
+                      level3 = TBF_QualityGovernor::degrade (defaults, 3);
+
+  TBF_CHECK_EQ (TBF_ShadowBitShift (defaults,  64), 3U);
+  TBF_CHECK_EQ (TBF_ShadowBitShift (defaults, 128), 2U);
+  TBF_CHECK_EQ (TBF_ShadowBitShift (level2,    64), 2U);
+  TBF_CHECK_EQ (TBF_ShadowBitShift (level2,   128), 1U);
+  TBF_CHECK_EQ (TBF_ShadowBitShift (level3,    64), 0U);
+  TBF_CHECK_EQ (TBF_ShadowBitShift (minimal,  256), 0U);
+
+  tbf_quality_s positive;
+
+  positive.shadow_rescale = 2;
+
+  TBF_CHECK_EQ (TBF_ShadowBitShift (positive, 64),  2U);
+  TBF_CHECK_EQ (TBF_ShadowBitShift (positive, 256), 2U);
+
+  return TBF_TEST_RESULT ();
+}
@@ -0,0 +1,204 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "inject_index.h"
+
+#include <algorithm>
+
+typedef std::unordered_map <uint32_t, tbf_tex_record_s> index_t;
+
+static const std::wstring inject_dir = L"TBFix_Res\\inject\\";
+
+static tbf_tex_record_s
+loose (size_t size, tbf_load_method_t method = DontCare)
+{
+  tbf_tex_record_s rec;
+
+  rec.size   = size;
+  rec.method = method;
+
+  return rec;
+}
+
+static tbf_tex_record_s
+packed (unsigned int archive, int fileno, size_t size)
+{
+  tbf_tex_record_s rec;
+
+  rec.archive = archive;
+  rec.fileno  = fileno;
+  rec.size    = size;
+
+  return rec;
+}
+
+static bool
+has (std::vector <uint32_t> list, std::vector <uint32_t> expected)
+{
+  std::sort (list.begin     (), list.end     ());
+  std::sort (expected.begin (), expected.end ());
+
+  return list == expected;
+}
+
+static tbf_inject_delta_s
+diff ( const index_t& old_index, const std::vector <std::wstring>& old_arcs,
+       const index_t& new_index, const std::vector <std::wstring>& new_arcs,
+       std::initializer_list <const wchar_t*> events )
+{
+  tbf_inject_changes_s changes;
+
+  for ( auto name : events )
+    TBF_RecordInjectChange (inject_dir, name, changes);
+
+  tbf_inject_delta_s delta;
+
+  TBF_DiffInjectableIndex (old_index, old_arcs, new_index, new_arcs, changes, delta);
+
+  return delta;
+}
+
+int
+main (void)
+{
+  // What file events turn into
+  tbf_inject_changes_s changes;
+
+  TBF_RecordInjectChange (inject_dir, L"textures\\blocking\\0000ABCD.dds", changes);
+  TBF_RecordInjectChange (inject_dir, L"textures\\1234.DDS",               changes);
+  TBF_RecordInjectChange (inject_dir, L"Extra.7z",                         changes);
+  TBF_RecordInjectChange (inject_dir, L"textures.tbfpack",                 changes);
+  TBF_RecordInjectChange (inject_dir, L"archives.manifest",                changes);
+  TBF_RecordInjectChange (inject_dir, L"textures\\readme.txt",             changes);
+  TBF_RecordInjectChange (inject_dir, L"textures\\not_hex.dds",            changes);
+
+  TBF_CHECK_EQ (changes.checksums.size (), 2U);
+  TBF_CHECK    (changes.checksums.count (0xabcd));
+  TBF_CHECK    (changes.checksums.count (0x1234));
+
+  // Same spelling as TBF_GetInjectSourceName, whatever the case on disk
+  TBF_CHECK_EQ (changes.archives.size (), 2U);
+  TBF_CHECK    (changes.archives.count (L"tbfix_res\\inject\\extra.7z"));
+  TBF_CHECK    (changes.archives.count (L"tbfix_res\\inject\\textures.tbfpack"));
+
+  const std::vector <std::wstring> arcs = { L"TBFix_Res\\inject\\A.7z",
+                                            L"TBFix_Res\\inject\\B.7z" };
+
+  index_t base;
+
+  base [0x1]  = loose  (100);
+  base [0x2]  = loose  (200);
+  base [0x3]  = loose  (300, Blocking);
+  base [0x10] = packed (0, 0, 1000);
+  base [0x11] = packed (0, 1, 1100);
+  base [0x20] = packed (1, 0, 2000);
+
+  // Nothing happened
+  tbf_inject_delta_s delta =
+    diff (base, arcs, base, arcs, { });
+
+  TBF_CHECK (delta.added.empty () && delta.removed.empty () && delta.updated.empty ());
+
+  // Added, and a loose file rewritten with the same size
+  index_t next = base;
+  next [0x4] = loose (400);
+
+  delta = diff (base, arcs, next, arcs, { L"textures\\00000004.dds", L"textures\\00000001.dds" });
+
+  TBF_CHECK (has (delta.added,   { 0x4 }));
+  TBF_CHECK (has (delta.removed, { }));
+  TBF_CHECK (has (delta.updated, { 0x1 }));
+
+  // Modified without an event (the notification buffer overflowed), but
+  //   the size gives it away
+  next = base;
+  next [0x2].size = 250;
+
+  delta = diff (base, arcs, next, arcs, { });
+
+  TBF_CHECK (has (delta.updated, { 0x2 }));
+
+  // Renamed: one checksum goes, another comes
+  next = base;
+  next.erase (0x2);
+  next [0x5] = loose (200);
+
+  delta = diff (base, arcs, next, arcs, { L"textures\\00000002.dds", L"textures\\00000005.dds" });
+
+  TBF_CHECK (has (delta.added,   { 0x5 }));
+  TBF_CHECK (has (delta.removed, { 0x2 }));
+  TBF_CHECK (delta.updated.empty ());
+
+  // Moved from the blocking folder to the streaming one
+  next = base;
+  next [0x3].method = Streaming;
+
+  delta = diff ( base, arcs, next, arcs, { L"textures\\blocking\\00000003.dds",
+                                           L"textures\\streaming\\00000003.dds" } );
+
+  TBF_CHECK (has (delta.updated, { 0x3 }));
+  TBF_CHECK (delta.added.empty () && delta.removed.empty ());
+
+  // Archive A removed: B's index shifts, its textures did not change
+  const std::vector <std::wstring> only_b = { L"TBFix_Res\\inject\\B.7z" };
+
+  next = base;
+  next.erase (0x10);
+  next.erase (0x11);
+  next [0x20] = packed (0, 0, 2000);
+
+  delta = diff (base, arcs, next, only_b, { L"A.7z" });
+
+  TBF_CHECK (has (delta.removed, { 0x10, 0x11 }));
+  TBF_CHECK (delta.added.empty () && delta.updated.empty ());
+
+  // Archive B rewritten in place, same layout: only the event tells
+  delta = diff (base, arcs, base, arcs, { L"b.7Z" });
+
+  TBF_CHECK (has (delta.updated, { 0x20 }));
+
+  // An entry that moved to the other archive, or within one
+  next = base;
+  next [0x11] = packed (1, 1, 1100);
+  next [0x10] = packed (0, 5, 1000);
+
+  delta = diff (base, arcs, next, arcs, { });
+
+  TBF_CHECK (has (delta.updated, { 0x10, 0x11 }));
+
+  // A loose file now overrides an archive entry, and the other way around
+  next = base;
+  next [0x20] = loose  (2000);
+  next [0x1]  = packed (1, 1, 100);
+
+  delta = diff (base, arcs, next, arcs, { L"textures\\00000020.dds", L"B.7z" });
+
+  TBF_CHECK (has (delta.updated, { 0x1, 0x20 }));
+
+  // Writing our own manifest changes nothing
+  delta = diff (base, arcs, base, arcs, { L"archives.manifest" });
+
+  TBF_CHECK (delta.updated.empty ());
+
+  return TBF_TEST_RESULT ();
+}
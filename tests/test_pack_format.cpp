@@ -0,0 +1,186 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "pack_format.h"
+
+#include <cstring>
+#include <vector>
+
+static std::vector <uint8_t>
+build_pack (bool compress)
+{
+  std::vector <uint8_t> compressible (300000, 'a');
+  std::vector <uint8_t> noise        (10000);
+
+  uint32_t seed = 1;
+
+  for ( auto& b : noise )
+    b = (uint8_t)((seed = seed * 1103515245 + 12345) >> 16);
+
+  const char* szFile = "test_pack_format.tbfpack";
+
+  FILE* fPack = fopen (szFile, "wb");
+
+  TBF_TexturePackWriter writer;
+
+  TBF_CHECK (writer.begin (fPack, 3));
+  TBF_CHECK (writer.add   (0xdeadbeef, 1, noise.data (),        (uint32_t)noise.size (),        compress));
+  TBF_CHECK (writer.add   (0x0000abcd, 0, compressible.data (), (uint32_t)compressible.size (), compress));
+  TBF_CHECK (writer.add   (0x00000012, 2, "tiny",               4,                              compress));
+
+  // Over the reserved index
+  TBF_CHECK (! writer.add (0x00000013, 2, "full", 4, compress));
+
+  TBF_CHECK (writer.finish ());
+
+  std::vector <uint8_t> data;
+
+  FILE* fRead = fopen (szFile, "rb");
+
+  fseek (fRead, 0, SEEK_END);
+  data.resize ((size_t)ftell (fRead));
+  fseek (fRead, 0, SEEK_SET);
+
+  TBF_CHECK_EQ (fread (data.data (), 1, data.size (), fRead), data.size ());
+
+  fclose (fRead);
+  remove (szFile);
+
+  return data;
+}
+
+static void
+test_round_trip (bool compress)
+{
+  std::vector <uint8_t> data = build_pack (compress);
+  TBF_TexturePackView   view;
+
+  TBF_CHECK    (view.attach (data.data (), data.size ()));
+  TBF_CHECK_EQ (view.numEntries (), 3U);
+
+  // Sorted by checksum
+  TBF_CHECK_EQ (view.getEntry (0)->checksum, 0x00000012U);
+  TBF_CHECK_EQ (view.getEntry (1)->checksum, 0x0000abcdU);
+  TBF_CHECK_EQ (view.getEntry (2)->checksum, 0xdeadbeefU);
+  TBF_CHECK    (view.getEntry (3) == nullptr);
+
+  const tbf_pack_entry_s* entry = view.findEntry (0x0000abcd);
+
+  TBF_CHECK    (entry != nullptr);
+  TBF_CHECK    (view.findEntry (0x0000abce) == nullptr);
+
+  if (entry == nullptr)
+    return;
+
+  TBF_CHECK_EQ (entry->method,               0U);
+  TBF_CHECK_EQ (entry->size,                 300000U);
+  TBF_CHECK_EQ (entry->offset % TBF_PACK_ALIGNMENT, 0ULL);
+  TBF_CHECK_EQ (entry->compression, compress ? (uint32_t)TBF_PACK_LZMA : (uint32_t)TBF_PACK_STORED);
+
+  std::vector <uint8_t> out (entry->size);
+
+  TBF_CHECK    (view.extract (entry, out.data (), out.size ()));
+  TBF_CHECK    (out == std::vector <uint8_t> (300000, 'a'));
+
+  // Too small a buffer
+  TBF_CHECK    (! view.extract (entry, out.data (), out.size () - 1));
+
+  // Random data is never worth compressing
+  TBF_CHECK_EQ (view.findEntry (0xdeadbeef)->compression, (uint32_t)TBF_PACK_STORED);
+
+  entry = view.findEntry (0x00000012);
+
+  TBF_CHECK    (entry != nullptr && memcmp (view.getPayload (entry), "tiny", 4) == 0);
+}
+
+static void
+test_rejects_corrupt (void)
+{
+  std::vector <uint8_t> data = build_pack (false);
+  TBF_TexturePackView   view;
+
+  tbf_pack_entry_s* index =
+    (tbf_pack_entry_s *)(data.data () + sizeof (tbf_pack_header_s));
+
+  // Truncated anywhere
+  TBF_CHECK (! view.attach (data.data (), sizeof (tbf_pack_header_s) - 1));
+  TBF_CHECK (! view.attach (data.data (), sizeof (tbf_pack_header_s) + sizeof (tbf_pack_entry_s)));
+
+  // 00000012 was added last, so its payload is the one at the end of the file
+  TBF_CHECK (! view.attach (data.data (), index [0].offset + index [0].stored_size - 1));
+
+  // An offset chosen so that offset + stored_size wraps around to a small value
+  {
+    std::vector <uint8_t> bad (data);
+    auto                  idx = (tbf_pack_entry_s *)(bad.data () + sizeof (tbf_pack_header_s));
+
+    idx [0].offset = ~0ULL - 1ULL;
+
+    TBF_CHECK (! view.attach (bad.data (), bad.size ()));
+  }
+
+  // Stored entries must be exactly as large as they claim
+  {
+    std::vector <uint8_t> bad (data);
+    auto                  idx = (tbf_pack_entry_s *)(bad.data () + sizeof (tbf_pack_header_s));
+
+    idx [0].size += 1;
+
+    TBF_CHECK (! view.attach (bad.data (), bad.size ()));
+  }
+
+  // Unsorted index
+  {
+    std::vector <uint8_t> bad (data);
+    auto                  idx = (tbf_pack_entry_s *)(bad.data () + sizeof (tbf_pack_header_s));
+
+    std::swap (idx [0], idx [1]);
+
+    TBF_CHECK (! view.attach (bad.data (), bad.size ()));
+  }
+
+  // Wrong magic / version
+  {
+    std::vector <uint8_t> bad (data);
+
+    ((tbf_pack_header_s *)bad.data ())->version = TBF_PACK_VERSION + 1;
+
+    TBF_CHECK (! view.attach (bad.data (), bad.size ()));
+  }
+
+  // A failed attach leaves nothing behind
+  TBF_CHECK_EQ (view.numEntries (), 0U);
+  TBF_CHECK    (view.findEntry (index [0].checksum) == nullptr);
+
+  TBF_CHECK    (view.attach (data.data (), data.size ()));
+}
+
+int
+main (void)
+{
+  test_round_trip      (false);
+  test_round_trip      (true);
+  test_rejects_corrupt ();
+
+  return TBF_TEST_RESULT ();
+}
@@ -0,0 +1,69 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "shader_bytecode.h"
+
+#include <vector>
+
+int
+main (void)
+{
+  // vs_3_0 / ps_2_0: version token, a few instructions, D3DSIO_END
+  std::vector <uint32_t> vs = { 0xFFFE0300, 0x0200001F, 0x80000000, 0x900F0000, 0x0000FFFF };
+  std::vector <uint32_t> ps = { 0xFFFF0200, 0x02000001, 0x800F0800, 0xA0E40000, 0x0000FFFF };
+
+  const size_t vs_len = vs.size () * sizeof (uint32_t);
+  const size_t ps_len = ps.size () * sizeof (uint32_t);
+
+  TBF_CHECK   (TBF_IsShaderBytecode (tbf_shader_stage::Vertex, vs.data (), vs_len));
+  TBF_CHECK   (TBF_IsShaderBytecode (tbf_shader_stage::Pixel,  ps.data (), ps_len));
+
+  // Wrong stage
+  TBF_CHECK (! TBF_IsShaderBytecode (tbf_shader_stage::Pixel,  vs.data (), vs_len));
+  TBF_CHECK (! TBF_IsShaderBytecode (tbf_shader_stage::Vertex, ps.data (), ps_len));
+
+  // Truncated, partial token, too short, missing
+  TBF_CHECK (! TBF_IsShaderBytecode (tbf_shader_stage::Vertex, vs.data (), vs_len - 4));
+  TBF_CHECK (! TBF_IsShaderBytecode (tbf_shader_stage::Vertex, vs.data (), vs_len - 1));
+  TBF_CHECK (! TBF_IsShaderBytecode (tbf_shader_stage::Vertex, vs.data (), 4));
+  TBF_CHECK (! TBF_IsShaderBytecode (tbf_shader_stage::Vertex, nullptr,    vs_len));
+
+  // Shortest valid program
+  const uint32_t empty [2] = { 0xFFFF0101, 0x0000FFFF };
+
+  TBF_CHECK   (TBF_IsShaderBytecode (tbf_shader_stage::Pixel, empty, sizeof (empty)));
+
+  // Shader models outside 1.x - 3.0
+  vs [0] = 0xFFFE0400;
+  TBF_CHECK (! TBF_IsShaderBytecode (tbf_shader_stage::Vertex, vs.data (), vs_len));
+
+  vs [0] = 0xFFFE0000;
+  TBF_CHECK (! TBF_IsShaderBytecode (tbf_shader_stage::Vertex, vs.data (), vs_len));
+
+  // Not bytecode at all
+  const char text [] = "vs_3_0\ndcl_position v0\n";
+
+  TBF_CHECK (! TBF_IsShaderBytecode (tbf_shader_stage::Vertex, text, sizeof (text) - 1));
+
+  return TBF_TEST_RESULT ();
+}
@@ -0,0 +1,98 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "shader_cache.h"
+
+#include <vector>
+
+static const void*
+shader (uint32_t i)
+{
+  // Never dereferenced; spaced like heap objects
+  return (const void *)(uintptr_t)(0x10000 + i * 16);
+}
+
+int
+main (void)
+{
+  TBF_ShaderCache cache (16);
+
+  TBF_CHECK (cache.find   (nullptr)    == nullptr);
+  TBF_CHECK (cache.find   (shader (0)) == nullptr);
+
+  tbf_shader_record_s* first =
+    cache.insert (shader (0), 0xaaaa);
+
+  TBF_CHECK     (first != nullptr);
+  TBF_CHECK_EQ  (first->crc32, 0xaaaaU);
+  TBF_CHECK     (cache.find (shader (0)) == first);
+  TBF_CHECK     (cache.find (shader (0)) == first); // From the recent slot
+
+  // Inserting again updates the record in place
+  TBF_CHECK     (cache.insert (shader (0), 0xbbbb) == first);
+  TBF_CHECK_EQ  (first->crc32, 0xbbbbU);
+
+  first->frame = 42;
+
+  // Enough to grow the table several times and fill many record blocks
+  std::vector <tbf_shader_record_s*> recs;
+
+  for (uint32_t i = 1; i < 5000; i++)
+    recs.push_back (cache.insert (shader (i), i));
+
+  TBF_CHECK_EQ (cache.size (), 5000U);
+
+  // Records never move
+  TBF_CHECK    (cache.find (shader (0)) == first);
+  TBF_CHECK_EQ (first->frame, 42U);
+
+  for (uint32_t i = 1; i < 5000; i++)
+  {
+    tbf_shader_record_s* rec = cache.find (shader (i));
+
+    TBF_CHECK    (rec == recs [i - 1]);
+    TBF_CHECK_EQ (rec->crc32, i);
+  }
+
+  // More shaders than recent slots, round after round; whatever a recent
+  //   slot holds, find () has to agree with the table
+  for (int pass = 0; pass < 4; pass++)
+  {
+    for (uint32_t i = 1; i < 1 + 4 * TBF_ShaderCache::RECENT_SLOTS; i += 3)
+      TBF_CHECK (cache.find (shader (i)) == recs [i - 1]);
+  }
+
+  cache.clear ();
+
+  TBF_CHECK_EQ (cache.size (), 0U);
+  TBF_CHECK    (cache.find (shader (0)) == nullptr);
+  TBF_CHECK    (cache.find (shader (1)) == nullptr);
+
+  tbf_shader_record_s* again =
+    cache.insert (shader (1), 0x1234);
+
+  TBF_CHECK    (cache.find (shader (1)) == again);
+  TBF_CHECK_EQ (again->frame,           0U);
+
+  return TBF_TEST_RESULT ();
+}
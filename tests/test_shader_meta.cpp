@@ -0,0 +1,317 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "shader_meta.h"
+
+#include <cstring>
+#include <vector>
+
+// Just to get at the on-disk limits
+struct meta_limits_s : TBF_ShaderMetaCache {
+  using TBF_ShaderMetaCache::MAGIC;
+  using TBF_ShaderMetaCache::VERSION;
+  using TBF_ShaderMetaCache::MAX_DEPTH;
+  using TBF_ShaderMetaCache::MAX_CONSTANTS;
+};
+
+static const wchar_t* wszFile = L"test_shader_meta.tbfs";
+static const char*    szFile  =  "test_shader_meta.tbfs";
+
+static tbf_shader_constant_s
+constant (const char* name, UINT reg)
+{
+  tbf_shader_constant_s c = { };
+
+  strncpy (c.Name, name, sizeof (c.Name) - 1);
+
+  c.RegisterSet   = D3DXRS_FLOAT4;
+  c.RegisterIndex = reg;
+  c.RegisterCount = 1;
+  c.Class         = D3DXPC_VECTOR;
+  c.Type          = D3DXPT_FLOAT;
+  c.Rows          = 1;
+  c.Columns       = 4;
+  c.Elements      = 1;
+
+  return c;
+}
+
+static std::vector <uint8_t>
+read_file (void)
+{
+  std::vector <uint8_t> data (1024 * 1024);
+
+  FILE* fIn = fopen (szFile, "rb");
+
+  if (fIn == nullptr)
+    return std::vector <uint8_t> ();
+
+  data.resize (fread (data.data (), 1, data.size (), fIn));
+  fclose (fIn);
+
+  return data;
+}
+
+static void
+write_file (const uint8_t* data, size_t size)
+{
+  FILE* fOut = fopen (szFile, "wb");
+
+  fwrite (data, 1, size, fOut);
+  fclose (fOut);
+}
+
+//
+// Hand-written cache files, for what save () would never produce
+//
+struct builder_s {
+  std::vector <uint8_t> data;
+
+  builder_s& u32 (uint32_t v) { data.insert (data.end (), (uint8_t *)&v, (uint8_t *)&v + 4); return *this; }
+  builder_s& u64 (uint64_t v) { data.insert (data.end (), (uint8_t *)&v, (uint8_t *)&v + 8); return *this; }
+
+  // One entry with constants; the caller appends the constant list
+  builder_s& entry (void)
+  {
+    return u32 (meta_limits_s::MAGIC).u32 (meta_limits_s::VERSION).u32 (1)
+          .u64 (0x1234).u32 (64).u32 (0xcafe).u32 (1);
+  }
+
+  builder_s& constant (uint32_t name_len, uint32_t members)
+  {
+    u32 (name_len).u32 (D3DXRS_FLOAT4).u32 (0).u32 (1)
+                  .u32 (D3DXPC_VECTOR).u32 (D3DXPT_FLOAT).u32 (1).u32 (4).u32 (1);
+
+    // A length the loader must refuse is not followed by that many bytes
+    data.insert (data.end (), name_len < 256 ? name_len : 256, 'x');
+
+    return u32 (members);
+  }
+
+  bool load (TBF_ShaderMetaCache& cache) const
+  {
+    write_file (data.data (), data.size ());
+    return cache.load (wszFile);
+  }
+};
+
+int
+main (void)
+{
+  const uint32_t bytecode [] = { 0xFFFE0300, 0x0000FFFF };
+
+  uint64_t h0 = TBF_ShaderMetaCache::hash (bytecode, sizeof (bytecode));
+  uint64_t h1 = TBF_ShaderMetaCache::hash (bytecode, sizeof (bytecode) - 4);
+
+  TBF_CHECK (h0 == TBF_ShaderMetaCache::hash (bytecode, sizeof (bytecode)));
+  TBF_CHECK (h0 != h1);
+
+  //
+  // Round trip
+  //
+  TBF_ShaderMetaCache cache;
+
+  tbf_shader_meta_s* plain =
+    cache.insert (8, h0, 0x11111111);
+
+  tbf_shader_meta_s* rich  =
+    cache.insert (4, h1, 0x22222222);
+
+  tbf_shader_constant_s light = constant ("light", 10);
+  light.Class = D3DXPC_STRUCT;
+
+  light.struct_members.push_back (constant ("light.pos",   10));
+  light.struct_members.push_back (constant ("light.color", 11));
+  light.struct_members [1].struct_members.push_back (constant ("deep", 12));
+
+  std::vector <tbf_shader_constant_s> constants =
+    { constant ("worldViewProj", 0), light, constant (std::string (127, 'n').c_str (), 200) };
+
+  cache.setConstants (rich, constants);
+
+  TBF_CHECK    (cache.dirty ());
+  TBF_CHECK    (plain != nullptr && ! plain->has_constants);
+  TBF_CHECK    (cache.save (wszFile));
+  TBF_CHECK    (! cache.dirty ());
+
+  TBF_ShaderMetaCache loaded;
+
+  TBF_CHECK    (loaded.load (wszFile));
+  TBF_CHECK_EQ (loaded.size (), 2U);
+  TBF_CHECK    (! loaded.dirty ());
+
+  tbf_shader_meta_s* meta = loaded.find (8, h0);
+
+  TBF_CHECK    (meta != nullptr && meta->crc32 == 0x11111111 && ! meta->has_constants);
+  TBF_CHECK    (loaded.find (4, h0) == nullptr);
+
+  meta = loaded.findCRC (0x22222222);
+
+  TBF_CHECK    (meta != nullptr && meta == loaded.find (4, h1));
+
+  if (meta != nullptr)
+  {
+    TBF_CHECK    (meta->has_constants);
+    TBF_CHECK_EQ (meta->constants.size (), 3U);
+
+    if (meta->constants.size () == 3)
+    {
+      const tbf_shader_constant_s& c = meta->constants [1];
+
+      TBF_CHECK    (! strcmp (meta->constants [0].Name, "worldViewProj"));
+      TBF_CHECK_EQ (strlen (meta->constants [2].Name), 127U);
+      TBF_CHECK_EQ (meta->constants [2].RegisterIndex, 200U);
+
+      TBF_CHECK    (! strcmp (c.Name, "light"));
+      TBF_CHECK_EQ (c.Class,                 D3DXPC_STRUCT);
+      TBF_CHECK_EQ (c.Type,                  D3DXPT_FLOAT);
+      TBF_CHECK_EQ (c.RegisterSet,           D3DXRS_FLOAT4);
+      TBF_CHECK_EQ (c.Columns,               4U);
+      TBF_CHECK_EQ (c.struct_members.size (), 2U);
+
+      if (c.struct_members.size () == 2)
+      {
+        TBF_CHECK    (! strcmp (c.struct_members [1].Name, "light.color"));
+        TBF_CHECK_EQ (c.struct_members [1].RegisterIndex,          11U);
+        TBF_CHECK_EQ (c.struct_members [1].struct_members.size (), 1U);
+      }
+    }
+  }
+
+  //
+  // Truncated anywhere: rejected, nothing half-loaded
+  //
+  std::vector <uint8_t> full = read_file ();
+
+  TBF_CHECK (full.size () > 12);
+
+  int accepted = 0;
+
+  for (size_t len = 0; len < full.size (); len++)
+  {
+    write_file (full.data (), len);
+
+    TBF_ShaderMetaCache truncated;
+
+    if (truncated.load (wszFile) || truncated.size () != 0)
+      ++accepted;
+  }
+
+  TBF_CHECK_EQ (accepted, 0);
+
+  //
+  // Hand-written files
+  //
+  {
+    TBF_ShaderMetaCache c;
+
+    // The limits themselves are fine
+    builder_s ok;
+    ok.entry ().u32 (1).constant (127, 0);
+
+    TBF_CHECK    (ok.load (c));
+    TBF_CHECK_EQ (c.size (), 1U);
+
+    // Name that would not fit Name [128] with its terminator
+    builder_s long_name;
+    long_name.entry ().u32 (1).constant (128, 0);
+
+    TBF_CHECK    (! long_name.load (c));
+    TBF_CHECK_EQ (c.size (), 0U);
+
+    builder_s huge_name;
+    huge_name.entry ().u32 (1).constant (0xffffffff, 0);
+
+    TBF_CHECK    (! huge_name.load (c));
+
+    // More constants than any shader has
+    builder_s most, too_many;
+
+    most.entry     ().u32 (meta_limits_s::MAX_CONSTANTS);
+    too_many.entry ().u32 (meta_limits_s::MAX_CONSTANTS + 1);
+
+    for (uint32_t i = 0; i < meta_limits_s::MAX_CONSTANTS; i++)
+    {
+      most.constant     (1, 0);
+      too_many.constant (1, 0);
+    }
+
+    too_many.constant (1, 0);
+
+    TBF_CHECK    (most.load (c));
+    TBF_CHECK    (! too_many.load (c));
+
+    builder_s way_too_many;
+    way_too_many.entry ().u32 (0xffffffff);
+
+    TBF_CHECK    (! way_too_many.load (c));
+    TBF_CHECK_EQ (c.size (), 0U);
+
+    // Every constant's member list is read, even an empty one, so a chain of
+    //   MAX_DEPTH nested constants is the deepest accepted
+    builder_s deepest, too_deep;
+
+    deepest.entry  ().u32 (1);
+    too_deep.entry ().u32 (1);
+
+    for (uint32_t depth = 1; depth < meta_limits_s::MAX_DEPTH; depth++)
+    {
+      deepest.constant  (4, 1);
+      too_deep.constant (4, 1);
+    }
+
+    deepest.constant  (4, 0);
+    too_deep.constant (4, 1).constant (4, 0);
+
+    TBF_CHECK    (deepest.load (c));
+    TBF_CHECK    (! too_deep.load (c));
+    TBF_CHECK_EQ (c.size (), 0U);
+
+    // Bad header, bad flag
+    builder_s bad_magic;
+    bad_magic.u32 (0x12345678).u32 (meta_limits_s::VERSION).u32 (0);
+
+    TBF_CHECK    (! bad_magic.load (c));
+
+    builder_s bad_flag;
+    bad_flag.u32 (meta_limits_s::MAGIC).u32 (meta_limits_s::VERSION).u32 (1)
+            .u64 (1).u32 (4).u32 (2).u32 (2);
+
+    TBF_CHECK    (! bad_flag.load (c));
+
+    // An empty cache is a valid cache
+    builder_s empty;
+    empty.u32 (meta_limits_s::MAGIC).u32 (meta_limits_s::VERSION).u32 (0);
+
+    TBF_CHECK    (empty.load (c));
+    TBF_CHECK_EQ (c.size (), 0U);
+  }
+
+  remove (szFile);
+
+  TBF_ShaderMetaCache missing;
+
+  TBF_CHECK (! missing.load (wszFile));
+
+  return TBF_TEST_RESULT ();
+}
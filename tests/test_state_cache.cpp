@@ -0,0 +1,151 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "state_cache.h"
+
+int
+main (void)
+{
+  static TBF_StateCache cache;
+
+  // Render states
+  TBF_CHECK   (cache.renderState (D3DRS_ZENABLE, 1));
+  TBF_CHECK   (! cache.renderState (D3DRS_ZENABLE, 1));
+  TBF_CHECK   (cache.renderState (D3DRS_ZENABLE, 0));
+  TBF_CHECK   (cache.renderState (D3DRS_ALPHABLENDENABLE, 0));
+  TBF_CHECK   (! cache.renderState (D3DRS_ALPHABLENDENABLE, 0));
+  TBF_CHECK   (cache.renderState ((D3DRENDERSTATETYPE)4096, 0));
+  TBF_CHECK   (cache.renderState ((D3DRENDERSTATETYPE)4096, 0)); // Never cached
+
+  cache.invalidate ();
+
+  TBF_CHECK   (cache.renderState (D3DRS_ZENABLE, 0));
+  TBF_CHECK   (! cache.renderState (D3DRS_ZENABLE, 0));
+
+  // Sampler states; vertex texture samplers have their own slots
+  TBF_CHECK   (cache.samplerState (0, D3DSAMP_ADDRESSU, 3));
+  TBF_CHECK   (! cache.samplerState (0, D3DSAMP_ADDRESSU, 3));
+  TBF_CHECK   (cache.samplerState (1, D3DSAMP_ADDRESSU, 3));
+  TBF_CHECK   (cache.samplerState (D3DVERTEXTEXTURESAMPLER0, D3DSAMP_ADDRESSU, 3));
+  TBF_CHECK   (! cache.samplerState (D3DVERTEXTEXTURESAMPLER0, D3DSAMP_ADDRESSU, 3));
+  TBF_CHECK   (! cache.samplerState (0, D3DSAMP_ADDRESSU, 3));
+  TBF_CHECK   (cache.samplerState (D3DVERTEXTEXTURESAMPLER3, D3DSAMP_DMAPOFFSET, 1));
+  TBF_CHECK   (! cache.samplerState (D3DVERTEXTEXTURESAMPLER3, D3DSAMP_DMAPOFFSET, 1));
+
+  // Not cached: the displacement map sampler, out of range samplers / types
+  TBF_CHECK   (cache.samplerState (D3DDMAPSAMPLER, D3DSAMP_ADDRESSU, 3));
+  TBF_CHECK   (cache.samplerState (D3DDMAPSAMPLER, D3DSAMP_ADDRESSU, 3));
+  TBF_CHECK   (cache.samplerState (16, D3DSAMP_ADDRESSU, 3));
+  TBF_CHECK   (cache.samplerState (16, D3DSAMP_ADDRESSU, 3));
+  TBF_CHECK   (cache.samplerState (0, (D3DSAMPLERSTATETYPE)14, 0));
+  TBF_CHECK   (cache.samplerState (0, (D3DSAMPLERSTATETYPE)14, 0));
+
+  // Viewport
+  D3DVIEWPORT9 vp  = { 0, 0, 1920, 1080, 0.0f, 1.0f };
+  D3DVIEWPORT9 out = { };
+
+  TBF_CHECK   (! cache.getViewport (&out));
+  TBF_CHECK   (cache.viewport (&vp));
+  TBF_CHECK   (! cache.viewport (&vp));
+  TBF_CHECK   (cache.getViewport (&out));
+  TBF_CHECK_EQ (out.Width, 1920U);
+
+  vp.MaxZ = 0.5f;
+
+  TBF_CHECK   (cache.viewport (&vp));
+  TBF_CHECK   (cache.viewport (nullptr));
+
+  // A new render target resets viewport and scissor, not render states
+  RECT rect = { 0, 0, 640, 480 };
+
+  TBF_CHECK   (cache.scissorRect (&rect));
+  TBF_CHECK   (! cache.scissorRect (&rect));
+
+  cache.targetChanged ();
+
+  TBF_CHECK   (! cache.getViewport (&out));
+  TBF_CHECK   (cache.viewport    (&vp));
+  TBF_CHECK   (cache.scissorRect (&rect));
+  TBF_CHECK   (! cache.renderState (D3DRS_ZENABLE, 0));
+
+  rect.right = 320;
+
+  TBF_CHECK   (cache.scissorRect (&rect));
+  TBF_CHECK   (cache.scissorRect (nullptr));
+
+  // Per-frame counters are latched by endFrame ()
+  cache.endFrame   ();
+  cache.invalidate ();
+
+  TBF_CHECK   (cache.renderState (D3DRS_BLENDOPALPHA, 1));
+  TBF_CHECK   (! cache.renderState (D3DRS_BLENDOPALPHA, 1));
+  TBF_CHECK   (! cache.renderState (D3DRS_BLENDOPALPHA, 1));
+
+  TBF_CHECK_EQ (cache.filtered ().render_states, 4U); // From the frame before
+
+  cache.endFrame ();
+
+  TBF_CHECK_EQ (cache.issued   ().render_states, 1U);
+  TBF_CHECK_EQ (cache.filtered ().render_states, 2U);
+  TBF_CHECK_EQ (cache.filtered ().total (),      2U);
+
+  cache.endFrame ();
+
+  TBF_CHECK_EQ (cache.issued ().total (), 0U);
+
+  // A recording state block gets every call, the device none of them
+  TBF_CHECK   (cache.renderState (D3DRS_CULLMODE, D3DCULL_CW));
+
+  cache.beginRecording ();
+
+  TBF_CHECK   (cache.recording ());
+  TBF_CHECK   (cache.renderState  (D3DRS_CULLMODE, D3DCULL_CW));
+  TBF_CHECK   (cache.renderState  (D3DRS_CULLMODE, D3DCULL_NONE));
+  TBF_CHECK   (cache.renderState  (D3DRS_CULLMODE, D3DCULL_NONE));
+  TBF_CHECK   (cache.samplerState (0, D3DSAMP_ADDRESSU,  D3DTADDRESS_CLAMP));
+  TBF_CHECK   (cache.samplerState (0, D3DSAMP_ADDRESSU,  D3DTADDRESS_CLAMP));
+  TBF_CHECK   (cache.viewport     (&vp));
+  TBF_CHECK   (cache.viewport     (&vp));
+  TBF_CHECK   (cache.scissorRect  (&rect));
+  TBF_CHECK   (cache.scissorRect  (&rect));
+
+  cache.endRecording ();
+
+  TBF_CHECK   (! cache.recording ());
+  TBF_CHECK   (! cache.renderState (D3DRS_CULLMODE, D3DCULL_CW));
+  TBF_CHECK   (cache.renderState   (D3DRS_CULLMODE, D3DCULL_NONE));
+
+  // Applying it changes the device behind the cache's back
+  cache.invalidate ();
+
+  TBF_CHECK   (cache.renderState   (D3DRS_CULLMODE, D3DCULL_NONE));
+  TBF_CHECK   (! cache.renderState (D3DRS_CULLMODE, D3DCULL_NONE));
+
+  cache.endFrame ();
+
+  TBF_CHECK_EQ (cache.issued   ().render_states, 3U);
+  TBF_CHECK_EQ (cache.filtered ().render_states, 2U);
+  TBF_CHECK_EQ (cache.issued   ().total (),      3U);
+
+  return TBF_TEST_RESULT ();
+}
@@ -0,0 +1,275 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "replay.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const char* szFile = "test_trace_replay.bin";
+
+static std::vector <tbf_trace_record_s> trace;
+
+static void
+rec ( tbf_trace_op op,       uint8_t  flags = 0, uint16_t slot = 0,
+      uint32_t     arg0 = 0, uint32_t arg1  = 0, uint32_t arg2 = 0 )
+{
+  tbf_trace_record_s r = { };
+
+  r.op       = (uint8_t)op;
+  r.flags    = flags;
+  r.slot     = slot;
+  r.time     = trace.size () * 1000ULL;
+  r.cost     = 10;
+  r.args [0] = arg0;
+  r.args [1] = arg1;
+  r.args [2] = arg2;
+
+  trace.push_back (r);
+}
+
+static void
+c240 (float x, float y, uint8_t flags)
+{
+  uint32_t bits [2];
+  const float xy [2] = { x, y };
+
+  memcpy (bits, xy, sizeof (bits));
+
+  rec (tbf_trace_op::SetVertexShaderConstantF, flags, 240, 1, bits [0], bits [1]);
+}
+
+static void
+write (uint32_t version, uint32_t record_size, size_t extra_bytes = 0)
+{
+  FILE* fOut = fopen (szFile, "wb");
+
+  tbf_trace_header_s header;
+
+  header.magic       = TBF_TRACE_MAGIC;
+  header.version     = version;
+  header.record_size = record_size;
+  header.ops         = (uint32_t)tbf_trace_op::Count;
+  header.frequency   = 10000000;
+
+  fwrite (&header, sizeof (header), 1, fOut);
+
+  for ( auto& r : trace )
+  {
+    if (version == 1)
+    {
+      tbf_trace_record_v1_s old;
+
+      old.op    = r.op;
+      old.flags = r.flags;
+      old.slot  = r.slot;
+      old.time  = (uint32_t)r.time;
+      old.cost  = r.cost;
+
+      memcpy (old.args, r.args, sizeof (old.args));
+
+      fwrite (&old, sizeof (old), 1, fOut);
+    }
+
+    else
+      fwrite (&r, sizeof (r), 1, fOut);
+  }
+
+  // Start of a record the capture never finished
+  for (size_t i = 0; i < extra_bytes; i++)
+    fputc (0x42, fOut);
+
+  fclose (fOut);
+}
+
+int
+main (void)
+{
+  const uint32_t smoke_ps  = 0x11111111,
+                 smoke_tex = 0x16f618a8;
+
+  // Frame 1: the back buffer and a smaller target, the c240 uploads the
+  //   hooks patch, draws, and state the cache should filter
+  rec  (tbf_trace_op::SetRenderTarget, 0, 0, 2560, 1440);
+  rec  (tbf_trace_op::SetRenderTarget, 0, 0, 1024,  512);
+
+  c240 (-1.0f / 2048.0f, 1.0f / 1024.0f, TBF_TRACE_MODIFIED); // Post-processing at 2560
+  c240 (-1.0f /   64.0f, 1.0f /   64.0f, TBF_TRACE_MODIFIED); // Model shadow
+  c240 ( 0.5f,           0.5f,           0);
+
+  rec  (tbf_trace_op::SetVertexShader, 0, 0, 0xA);
+  rec  (tbf_trace_op::SetPixelShader,  0, 0, 0xB);
+  rec  (tbf_trace_op::SetTexture,      0, 0, 0xC);
+  rec  (tbf_trace_op::SetTexture,      0, 1, 0xD);
+
+  rec  (tbf_trace_op::DrawIndexedPrimitive);
+  rec  (tbf_trace_op::DrawIndexedPrimitive);
+  rec  (tbf_trace_op::DrawPrimitive);
+
+  rec  (tbf_trace_op::SetRenderState,  0,                 D3DRS_ZENABLE, 1);
+  rec  (tbf_trace_op::SetRenderState,  TBF_TRACE_SKIPPED, D3DRS_ZENABLE, 1);
+  rec  (tbf_trace_op::SetSamplerState, 0,                 0, D3DSAMP_ADDRESSU, D3DTADDRESS_CLAMP);
+  rec  (tbf_trace_op::SetSamplerState, TBF_TRACE_SKIPPED, 0, D3DSAMP_ADDRESSU, D3DTADDRESS_CLAMP);
+  rec  (tbf_trace_op::SetViewport,     0,                 0, 0, 2560, 1440);
+  rec  (tbf_trace_op::SetViewport,     TBF_TRACE_SKIPPED, 0, 0, 2560, 1440);
+  rec  (tbf_trace_op::SetScissorRect,  0,                 0, 0, 2560, 1440);
+  rec  (tbf_trace_op::SetScissorRect,  TBF_TRACE_SKIPPED, 0, 0, 2560, 1440);
+
+  rec  (tbf_trace_op::EndFrame,        0, 0, 1);
+
+  // Frame 2: the state cache starts over, the decision table does not
+  rec  (tbf_trace_op::SetRenderState,  0,                 D3DRS_ZENABLE, 1);
+
+  rec  (tbf_trace_op::SetPixelShader,  0, 0, smoke_ps);
+  rec  (tbf_trace_op::SetTexture,      0, 0, smoke_tex);
+  rec  (tbf_trace_op::DrawPrimitive,   TBF_TRACE_SKIPPED);
+
+  rec  (tbf_trace_op::SetPixelShader,  0, 0, 0xB);
+  rec  (tbf_trace_op::SetTexture,      0, 0, 0xC);
+  rec  (tbf_trace_op::DrawPrimitive);
+
+  rec  (tbf_trace_op::EndFrame,        0, 0, 2);
+
+  // Written by a newer plugin; counted, otherwise ignored
+  rec  ((tbf_trace_op)200);
+
+  // Past the point a 32-bit time wraps
+  trace.back ().time = 0x123456789ULL;
+
+  tbf_replay_config_s config;
+
+  config.rules.disable_smoke = true;
+  config.rules.smoke_ps      = smoke_ps;
+
+  // Version 2, with a partial record at the end
+  write (TBF_TRACE_VERSION, sizeof (tbf_trace_record_s), 7);
+
+  TBF_TraceReplay replay;
+
+  TBF_CHECK (replay.load (szFile));
+  TBF_CHECK_EQ (replay.header  ().version,    TBF_TRACE_VERSION);
+  TBF_CHECK_EQ (replay.header  ().frequency,  10000000);
+  TBF_CHECK_EQ (replay.records ().size (),    trace.size ());
+  TBF_CHECK_EQ (replay.records ().back ().time, 0x123456789ULL);
+
+  uint32_t width = 0, height = 0;
+
+  TBF_CHECK (replay.largestTarget (&width, &height));
+  TBF_CHECK_EQ (width,  2560U);
+  TBF_CHECK_EQ (height, 1440U);
+
+  tbf_replay_stats_s stats;
+
+  replay.run (config, stats);
+
+  TBF_CHECK_EQ (stats.frames,      2U);
+  TBF_CHECK_EQ (stats.unknown_ops, 1U);
+
+  TBF_CHECK_EQ (stats.ops [(int)tbf_trace_op::DrawPrimitive].count,        3U);
+  TBF_CHECK_EQ (stats.ops [(int)tbf_trace_op::DrawPrimitive].live_skipped, 1U);
+  TBF_CHECK_EQ (stats.ops [(int)tbf_trace_op::DrawPrimitive].live_cost,    30U);
+
+  // (A, B, C) twice more after its miss, including in frame 2
+  TBF_CHECK_EQ (stats.decision_misses,     2U);
+  TBF_CHECK_EQ (stats.decision_hits,       3U);
+  TBF_CHECK_EQ (stats.decision_mismatches, 0U);
+  TBF_CHECK_EQ (stats.draws_skipped,       1U);
+
+  TBF_CHECK_EQ (stats.device.calls [(int)tbf_trace_op::DrawPrimitive],        2U);
+  TBF_CHECK_EQ (stats.device.calls [(int)tbf_trace_op::DrawIndexedPrimitive], 2U);
+
+  // Resolution taken from the largest target, so the 2560 post-processing
+  //   pattern is the one that matches
+  TBF_CHECK_EQ (stats.c240_uploads, 3U);
+  TBF_CHECK_EQ (stats.c240_patched, 2U);
+  TBF_CHECK_EQ (stats.c240_agree,   3U);
+
+  TBF_CHECK_EQ (stats.state_calls,    9U);
+  TBF_CHECK_EQ (stats.state_filtered, 4U);
+  TBF_CHECK_EQ (stats.state_agree,    9U);
+
+  TBF_CHECK_EQ (stats.device.calls [(int)tbf_trace_op::SetRenderState],  2U);
+  TBF_CHECK_EQ (stats.device.calls [(int)tbf_trace_op::SetSamplerState], 1U);
+
+  TBF_CHECK_EQ (stats.unique_vs,  1U);
+  TBF_CHECK_EQ (stats.unique_ps,  3U);
+  TBF_CHECK_EQ (stats.unique_tex, 4U);
+
+  // At 1920x1080 the 2560 pattern is left alone; the capture disagrees
+  config.width  = 1920;
+  config.height = 1080;
+
+  tbf_replay_stats_s at_1080p;
+
+  replay.run (config, at_1080p);
+
+  TBF_CHECK_EQ (at_1080p.c240_patched, 1U);
+  TBF_CHECK_EQ (at_1080p.c240_agree,   2U);
+
+  // Version 1: same calls, 32-bit time
+  write (1, sizeof (tbf_trace_record_v1_s));
+
+  TBF_TraceReplay v1;
+
+  TBF_CHECK (v1.load (szFile));
+  TBF_CHECK_EQ (v1.header  ().version, 1U);
+  TBF_CHECK_EQ (v1.records ().size (), trace.size ());
+  TBF_CHECK_EQ (v1.records ().back ().time, 0x23456789ULL);
+
+  bool same = v1.records ().size () == trace.size ();
+
+  for (size_t i = 0; same && i + 1 < trace.size (); i++)
+  {
+    const tbf_trace_record_s& a = v1.records () [i],
+                              & b = trace       [i];
+
+    same = a.op   == b.op   && a.flags == b.flags && a.slot == b.slot &&
+           a.time == b.time && a.cost  == b.cost  &&
+           ! memcmp (a.args, b.args, sizeof (a.args));
+  }
+
+  TBF_CHECK (same);
+
+  // Record sizes that do not match the version, other files
+  write (1,                 sizeof (tbf_trace_record_s));
+  TBF_CHECK (! v1.load (szFile));
+
+  write (TBF_TRACE_VERSION, sizeof (tbf_trace_record_v1_s));
+  TBF_CHECK (! v1.load (szFile));
+
+  write (TBF_TRACE_VERSION + 1, sizeof (tbf_trace_record_s));
+  TBF_CHECK (! v1.load (szFile));
+
+  FILE* fOut = fopen (szFile, "wb");
+  fputs ("TBFS, not a trace", fOut);
+  fclose (fOut);
+
+  TBF_CHECK (! v1.load (szFile));
+
+  remove (szFile);
+
+  TBF_CHECK (! v1.load (szFile));
+
+  return TBF_TEST_RESULT ();
+}
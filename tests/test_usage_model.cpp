@@ -0,0 +1,225 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "usage_model.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+static const wchar_t* wszTrace = L"test_usage_model.trace";
+static const wchar_t* wszModel = L"test_usage_model.model";
+
+static const int NUM_AREAS     = 8;
+static const int AREA_TEXTURES = 24;
+
+static uint32_t seed = 12345;
+
+static uint32_t
+rnd (void)
+{
+  seed = seed * 1664525U + 1013904223U;
+  return seed >> 8;
+}
+
+//
+// A play session: the title screen and camp, then two other areas; each
+//   uses the same textures in about the same order every time (a few are
+//     swapped) and one-off noise
+//
+static tbf_usage_session_t
+make_session (void)
+{
+  tbf_usage_session_t session;
+  uint32_t            frame = 1;
+
+  for (int visit = 0; visit < 4; visit++)
+  {
+    uint32_t area = visit < 2 ? visit : 2 + rnd () % (NUM_AREAS - 2);
+
+    std::vector <uint32_t> textures;
+
+    for (int i = 0; i < AREA_TEXTURES; i++)
+      textures.push_back (0x10000000U + area * 0x1000U + (uint32_t)i);
+
+    for (int swaps = 0; swaps < 3; swaps++)
+      std::swap (textures [rnd () % AREA_TEXTURES], textures [rnd () % AREA_TEXTURES]);
+
+    for ( auto checksum : textures )
+    {
+      session.emplace_back (checksum, frame);
+      frame += 1 + rnd () % 4;
+    }
+
+    session.emplace_back (0xF0000000U | (rnd () & 0xFFFFFF), frame);
+
+    // Travelling to the next area
+    frame += 2000;
+  }
+
+  // Areas visited twice are only first used once
+  tbf_usage_session_t firsts;
+  std::vector <uint32_t> seen;
+
+  for ( auto& use : session )
+  {
+    if (std::find (seen.begin (), seen.end (), use.first) == seen.end ())
+    {
+      seen.push_back   (use.first);
+      firsts.push_back (use);
+    }
+  }
+
+  return firsts;
+}
+
+int
+main (void)
+{
+  fs::remove (wszTrace);
+  fs::remove (wszModel);
+
+  std::vector <tbf_usage_session_t> played;
+
+  for (int i = 0; i < 24; i++)
+    played.push_back (make_session ());
+
+  //
+  // The game: first uses, record the session, fold it into the model
+  //
+  TBF_TextureUsageModel game;
+
+  for ( auto& session : played )
+  {
+    for ( auto& use : session )
+      TBF_CHECK (game.firstUse (use.first, use.second));
+
+    TBF_CHECK (! game.firstUse (session [0].first, session [0].second));
+
+    TBF_CHECK (game.appendSession (wszTrace));
+    game.commitSession ();
+  }
+
+  TBF_CHECK (game.save (wszModel));
+
+  // Nothing to record once the session is folded in
+  TBF_CHECK (! game.appendSession (wszTrace));
+
+  //
+  // The trace holds every session as played
+  //
+  std::vector <tbf_usage_session_t> traced;
+
+  TBF_CHECK    (TBF_TextureUsageModel::loadSessions (wszTrace, traced));
+  TBF_CHECK    (traced == played);
+
+  //
+  // Training offline from the trace gives the game's model
+  //
+  TBF_TextureUsageModel offline,
+                        loaded;
+
+  for ( auto& session : traced )
+    offline.trainSession (session);
+
+  TBF_CHECK    (loaded.load (wszModel));
+  TBF_CHECK_EQ (offline.numKeys (), game.numKeys ());
+  TBF_CHECK_EQ (loaded.numKeys  (), game.numKeys ());
+
+  for ( auto& use : played.back () )
+  {
+    std::vector <uint32_t> a, b, c;
+
+    game.predict    (use.first, a);
+    offline.predict (use.first, b);
+    loaded.predict  (use.first, c);
+
+    std::sort (a.begin (), a.end ());
+    std::sort (b.begin (), b.end ());
+    std::sort (c.begin (), c.end ());
+
+    TBF_CHECK (a == b);
+    TBF_CHECK (a == c);
+  }
+
+  //
+  // Evaluated like the tool does it: recurring areas are predicted well,
+  //   one-off noise never is
+  //
+  tbf_usage_session_t next = make_session ();
+
+  tbf_usage_eval_s cold, warm, strict;
+
+  TBF_TextureUsageModel empty;
+
+  empty.evaluate   (next, TBF_TextureUsageModel::WEIGHT_PREDICT, cold);
+  offline.evaluate (next, TBF_TextureUsageModel::WEIGHT_PREDICT, warm);
+  offline.evaluate (next, 0xFFFF,                                strict);
+
+  TBF_CHECK_EQ (cold.first_uses,  (uint64_t)next.size ());
+  TBF_CHECK_EQ (cold.predicted,   0ULL);
+  TBF_CHECK_EQ (cold.covered,     0ULL);
+
+  TBF_CHECK_EQ (warm.first_uses,  (uint64_t)next.size ());
+  TBF_CHECK    (warm.covered     <= warm.predicted);
+  TBF_CHECK    (warm.covered * 10 >= warm.first_uses * 4);  // recall    >= 40%
+  TBF_CHECK    (warm.covered * 10 >= warm.predicted  * 7);  // precision >= 70%
+  TBF_CHECK    (warm.lead_frames  >  warm.covered);
+
+  TBF_CHECK_EQ (strict.predicted, 0ULL);
+
+  printf ( "recall %.1f%%, precision %.1f%%, %llu predictions\n",
+             100.0 * warm.covered / warm.first_uses,
+             100.0 * warm.covered / warm.predicted,
+               (unsigned long long)warm.predicted );
+
+  // A count that asks for more than the file holds
+  {
+    FILE* fTrace = fopen ("test_usage_model.trace", "ab");
+    uint32_t huge = 0x40000000U;
+    fwrite (&huge, sizeof (uint32_t), 1, fTrace);
+    fclose (fTrace);
+
+    TBF_CHECK    (TBF_TextureUsageModel::loadSessions (wszTrace, traced));
+    TBF_CHECK    (traced == played);
+  }
+
+  //
+  // A session cut short ends the trace, the rest is still there
+  //
+  fs::resize_file (wszTrace, fs::file_size (wszTrace) - 8);
+
+  TBF_CHECK    (TBF_TextureUsageModel::loadSessions (wszTrace, traced));
+  TBF_CHECK_EQ (traced.size (), played.size () - 1);
+
+  // Not a trace
+  TBF_CHECK (! TBF_TextureUsageModel::loadSessions (wszModel, traced));
+  TBF_CHECK (traced.empty ());
+
+  fs::remove (wszTrace);
+  fs::remove (wszModel);
+
+  return TBF_TEST_RESULT ();
+}
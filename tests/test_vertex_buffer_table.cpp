@@ -0,0 +1,213 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "vertex_buffer_table.h"
+
+#include <vector>
+
+//
+// Mock vertex buffers out of a fixed pool, freed addresses handed out again
+//   first, the way the game's allocator recycles them over a long session
+//
+struct mock_vb_s {
+  uint64_t pad [4];
+};
+
+static const size_t POOL_SIZE = 256;
+
+static mock_vb_s pool [POOL_SIZE];
+
+struct mock_heap_s {
+  std::vector <mock_vb_s *> free_list;
+  bool                      live    [POOL_SIZE] = { };
+  tbf_vb_usage              usage   [POOL_SIZE] = { };
+  size_t                    count = 0;
+
+  mock_heap_s (void)
+  {
+    for (size_t i = POOL_SIZE; i > 0; i--)
+      free_list.push_back (&pool [i - 1]);
+  }
+
+  mock_vb_s* create (bool dynamic)
+  {
+    mock_vb_s* vb = free_list.back ();
+    free_list.pop_back ();
+
+    live  [vb - pool] = true;
+    usage [vb - pool] = dynamic ? tbf_vb_usage::Dynamic : tbf_vb_usage::Immutable;
+
+    ++count;
+
+    return vb;
+  }
+
+  void release (mock_vb_s* vb)
+  {
+    live [vb - pool] = false;
+    free_list.push_back (vb);
+
+    --count;
+  }
+};
+
+int
+main (void)
+{
+  TBF_VertexBufferTable table (16);
+
+  // Basics
+  TBF_CHECK    (table.find (&pool [0]) == tbf_vb_usage::Unknown);
+  TBF_CHECK    (table.find (nullptr)   == tbf_vb_usage::Unknown);
+
+  table.created (&pool [0], true);
+  table.created (&pool [1], false);
+  table.created (nullptr,   true);
+
+  TBF_CHECK    (table.find (&pool [0]) == tbf_vb_usage::Dynamic);
+  TBF_CHECK    (table.find (&pool [1]) == tbf_vb_usage::Immutable);
+  TBF_CHECK_EQ (table.size (), 2U);
+
+  // Created again at the same address without a release seen: overwritten
+  table.created (&pool [0], false);
+
+  TBF_CHECK    (table.find (&pool [0]) == tbf_vb_usage::Immutable);
+  TBF_CHECK_EQ (table.size (), 2U);
+
+  TBF_CHECK    (table.released (&pool [0]));
+  TBF_CHECK    (! table.released (&pool [0]));
+  TBF_CHECK    (! table.released (&pool [5]));
+  TBF_CHECK    (table.find (&pool [0]) == tbf_vb_usage::Unknown);
+  TBF_CHECK    (table.find (&pool [1]) == tbf_vb_usage::Immutable);
+  TBF_CHECK_EQ (table.size (), 1U);
+
+  table.clear ();
+
+  TBF_CHECK_EQ (table.size (), 0U);
+  TBF_CHECK    (table.find (&pool [1]) == tbf_vb_usage::Unknown);
+
+  //
+  // A long session: buffers created and released at random, addresses reused
+  //   straight away, some buffers never seen created (made before the hooks
+  //     went in) and classified on first bind instead
+  //
+  mock_heap_s heap;
+
+  std::vector <mock_vb_s *> live;
+
+  uint32_t seed = 0x9e3779b9;
+
+  auto next = [&](uint32_t range) -> uint32_t {
+    seed = seed * 1664525 + 1013904223;
+    return (seed >> 8) % range;
+  };
+
+  // Loading the first area: every buffer the pool holds
+  while (heap.count < POOL_SIZE)
+  {
+    mock_vb_s* vb = heap.create (next (3) == 0);
+
+    table.created (vb, heap.usage [vb - pool] == tbf_vb_usage::Dynamic);
+    live.push_back (vb);
+  }
+
+  TBF_CHECK_EQ (table.size (), POOL_SIZE);
+
+  const size_t settled_capacity = table.capacity ();
+
+  int stale = 0;
+
+  for (int op = 0; op < 400000; op++)
+  {
+    const uint32_t what = next (100);
+
+    if (what < 30 && heap.count < POOL_SIZE)
+    {
+      mock_vb_s* vb = heap.create (next (3) == 0);
+
+      if (next (20) != 0)
+        table.created (vb, heap.usage [vb - pool] == tbf_vb_usage::Dynamic);
+
+      live.push_back (vb);
+    }
+
+    else if (what < 60 && ! live.empty ())
+    {
+      const size_t idx = next ((uint32_t)live.size ());
+
+      mock_vb_s* vb = live [idx];
+
+      live [idx] = live.back ();
+      live.pop_back ();
+
+      heap.release  (vb);
+      table.released (vb);
+    }
+
+    // A bind: what SetStreamSource would get back
+    else if (! live.empty ())
+    {
+      mock_vb_s* vb = live [next ((uint32_t)live.size ())];
+
+      tbf_vb_usage usage = table.find (vb);
+
+      if (usage == tbf_vb_usage::Unknown)
+      {
+        usage = heap.usage [vb - pool];
+        table.created (vb, usage == tbf_vb_usage::Dynamic);
+      }
+
+      else if (usage != heap.usage [vb - pool])
+        ++stale;
+    }
+
+    TBF_CHECK (table.size () <= heap.count);
+  }
+
+  TBF_CHECK_EQ (stale, 0);
+
+  // Only live buffers are left, and the table stopped growing long ago
+  TBF_CHECK (settled_capacity >= POOL_SIZE);
+  TBF_CHECK_EQ (table.capacity (), settled_capacity);
+
+  for (size_t i = 0; i < POOL_SIZE; i++)
+  {
+    const tbf_vb_usage usage = table.find (&pool [i]);
+
+    if (! heap.live [i])
+      TBF_CHECK (usage == tbf_vb_usage::Unknown);
+    else
+      TBF_CHECK (usage == tbf_vb_usage::Unknown || usage == heap.usage [i]);
+  }
+
+  // Tearing everything down empties the table
+  for ( auto vb : live )
+  {
+    heap.release   (vb);
+    table.released (vb);
+  }
+
+  TBF_CHECK_EQ (table.size (), 0U);
+
+  return TBF_TEST_RESULT ();
+}
@@ -0,0 +1,187 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#include "tbf_test.h"
+#include "warm_start.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+static const wchar_t* wszWarm  = L"test_warm_start.warm";
+static const char*     szWarm  =  "test_warm_start.warm";
+
+int
+main (void)
+{
+  fs::remove (wszWarm);
+
+  std::vector <tbf_warm_entry_s> entries;
+
+  // Nothing saved yet
+  TBF_CHECK (! TBF_WarmStartSet::load (wszWarm, entries));
+  TBF_CHECK (entries.empty ());
+
+  //
+  // A session that never injected anything does not write (or replace) a list
+  //
+  {
+    TBF_WarmStartSet nothing;
+
+    TBF_CHECK    (! nothing.save (wszWarm));
+    TBF_CHECK    (! fs::exists   (wszWarm));
+  }
+
+  //
+  // The title screen (frame 10), camp (500) and a town (900); the session
+  //   reports every frame a texture is bound in, in no particular order
+  //
+  TBF_WarmStartSet session;
+
+  session.use (0x3000, 900);  // Town, bound for 1 frame
+  session.use (0x1002, 10);   // Title, 3 frames
+  session.use (0x1001, 10);   // Title, 5 frames
+  session.use (0x2000, 500);  // Camp
+
+  for (uint32_t frame = 11; frame < 15; frame++)
+    session.use (0x1001, frame);
+
+  for (uint32_t frame = 11; frame < 13; frame++)
+    session.use (0x1002, frame);
+
+  session.use (0x3001, 900);  // Town, 2 frames
+  session.use (0x3001, 901);
+  session.use (0x2000, 501);
+
+  // Seen again later, first use stays at 10
+  session.use (0x1002, 2000);
+
+  TBF_CHECK_EQ (session.size (), 5UL);
+  TBF_CHECK    (session.save (wszWarm));
+
+  //
+  // Reloaded in order of first use, ties broken by how often each was used
+  //
+  TBF_CHECK    (TBF_WarmStartSet::load (wszWarm, entries));
+  TBF_CHECK_EQ (entries.size (), 5UL);
+
+  const tbf_warm_entry_s expected [] = {
+    { 0x1001, 10,  5 },
+    { 0x1002, 10,  4 },
+    { 0x2000, 500, 2 },
+    { 0x3001, 900, 2 },
+    { 0x3000, 900, 1 },
+  };
+
+  for (size_t i = 0; i < entries.size () && i < 5; i++)
+  {
+    TBF_CHECK_EQ (entries [i].checksum,    expected [i].checksum);
+    TBF_CHECK_EQ (entries [i].first_frame, expected [i].first_frame);
+    TBF_CHECK_EQ (entries [i].frames_used, expected [i].frames_used);
+  }
+
+  for (size_t i = 1; i < entries.size (); i++)
+  {
+    TBF_CHECK (entries [i - 1].first_frame <= entries [i].first_frame);
+  }
+
+  //
+  // A later session with nothing to show keeps the saved list
+  //
+  {
+    TBF_WarmStartSet nothing;
+
+    std::vector <tbf_warm_entry_s> kept;
+
+    TBF_CHECK    (! nothing.save (wszWarm));
+    TBF_CHECK    (TBF_WarmStartSet::load (wszWarm, kept));
+    TBF_CHECK_EQ (kept.size (), entries.size ());
+  }
+
+  //
+  // Planning against the staging budget: first use order is kept, textures no
+  //   longer injectable are skipped, the first one that does not fit ends it
+  //
+  std::unordered_map <uint32_t, size_t> sizes = {
+    { 0x1001, 400 }, { 0x1002, 0 }, { 0x2000, 300 }, { 0x3001, 500 }, { 0x3000, 100 }
+  };
+
+  auto size_of = [&](uint32_t checksum) -> size_t { return sizes [checksum]; };
+
+  std::vector <uint32_t> plan =
+    TBF_WarmStartSet::plan (entries, 1000, size_of);
+
+  TBF_CHECK    ((plan == std::vector <uint32_t> { 0x1001, 0x2000 }));
+
+  // The town's small texture would fit, but is used after camp which does not
+  plan = TBF_WarmStartSet::plan (entries, 699, size_of);
+  TBF_CHECK    ((plan == std::vector <uint32_t> { 0x1001 }));
+
+  plan = TBF_WarmStartSet::plan (entries, 1300, size_of);
+  TBF_CHECK    ((plan == std::vector <uint32_t> { 0x1001, 0x2000, 0x3001, 0x3000 }));
+
+  plan = TBF_WarmStartSet::plan (entries, 399, size_of);
+  TBF_CHECK    (plan.empty ());
+
+  //
+  // Damaged lists load as nothing at all
+  //
+  const uintmax_t good_size = fs::file_size (wszWarm);
+
+  // Cut short
+  fs::resize_file (wszWarm, good_size - 4);
+
+  TBF_CHECK (! TBF_WarmStartSet::load (wszWarm, entries));
+  TBF_CHECK (entries.empty ());
+
+  // A count far past anything that was ever saved
+  {
+    FILE* fWarm = fopen (szWarm, "r+b");
+    uint32_t huge = 0x40000000U;
+    fseek  (fWarm, 8, SEEK_SET);
+    fwrite (&huge, sizeof (uint32_t), 1, fWarm);
+    fclose (fWarm);
+
+    TBF_CHECK (! TBF_WarmStartSet::load (wszWarm, entries));
+    TBF_CHECK (entries.empty ());
+  }
+
+  // Another version
+  {
+    TBF_CHECK (session.save (wszWarm));
+
+    FILE* fWarm = fopen (szWarm, "r+b");
+    uint32_t version = 2;
+    fseek  (fWarm, 4, SEEK_SET);
+    fwrite (&version, sizeof (uint32_t), 1, fWarm);
+    fclose (fWarm);
+
+    TBF_CHECK (! TBF_WarmStartSet::load (wszWarm, entries));
+    TBF_CHECK (entries.empty ());
+  }
+
+  fs::remove (wszWarm);
+
+  return TBF_TEST_RESULT ();
+}
@@ -0,0 +1,92 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+//
+// Stand-in for the handful of Win32 types and CRT extensions the host tests
+//   and tools reach through the plugin's headers. Not a general replacement;
+//     add to it as they need more.
+//
+#ifndef __TBF__HOST_WINDOWS_H__
+#define __TBF__HOST_WINDOWS_H__
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+#include <mutex>
+#include <string>
+
+typedef uint8_t  BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef uint32_t ULONG;
+typedef int32_t  LONG;
+typedef uint32_t UINT;
+typedef int32_t  BOOL;
+
+typedef LONG     HRESULT;
+
+#define S_OK         ((HRESULT)0L)
+#define E_FAIL       ((HRESULT)0x80004005L)
+
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr)    (((HRESULT)(hr)) <  0)
+
+struct RECT {
+  LONG left;
+  LONG top;
+  LONG right;
+  LONG bottom;
+};
+
+static inline FILE*
+_wfopen (const wchar_t* wszFileName, const wchar_t* wszMode)
+{
+  std::string name, mode;
+
+  for (const wchar_t* p = wszFileName; *p != L'\0'; p++) name += (char)*p;
+  for (const wchar_t* p = wszMode;     *p != L'\0'; p++) mode += (char)*p;
+
+  return fopen (name.c_str (), mode.c_str ());
+}
+
+static inline int
+_fseeki64 (FILE* fFile, int64_t offset, int origin)
+{
+  return fseeko (fFile, (off_t)offset, origin);
+}
+
+static inline int64_t
+_ftelli64 (FILE* fFile)
+{
+  return (int64_t)ftello (fFile);
+}
+
+// Recursive, like the real thing
+typedef std::recursive_mutex CRITICAL_SECTION;
+
+static inline void InitializeCriticalSection (CRITICAL_SECTION*)    { }
+static inline void DeleteCriticalSection     (CRITICAL_SECTION*)    { }
+static inline void EnterCriticalSection      (CRITICAL_SECTION* cs) { cs->lock   (); }
+static inline void LeaveCriticalSection      (CRITICAL_SECTION* cs) { cs->unlock (); }
+
+#endif /* __TBF__HOST_WINDOWS_H__ */
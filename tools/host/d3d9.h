@@ -0,0 +1,139 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+//
+// Stand-in for the parts of d3d9.h the host tests and tools need; enumerant
+//   values match the SDK.
+//
+#ifndef __TBF__HOST_D3D9_H__
+#define __TBF__HOST_D3D9_H__
+
+#include "Windows.h"
+
+enum D3DRENDERSTATETYPE {
+  D3DRS_ZENABLE          =   7,
+  D3DRS_CULLMODE         =  22,
+  D3DRS_ALPHABLENDENABLE =  27,
+  D3DRS_BLENDOPALPHA     = 209
+};
+
+enum D3DSAMPLERSTATETYPE {
+  D3DSAMP_ADDRESSU       =   1,
+  D3DSAMP_ADDRESSV       =   2,
+  D3DSAMP_ADDRESSW       =   3,
+  D3DSAMP_MAGFILTER      =   5,
+  D3DSAMP_MIPMAPLODBIAS  =   8,
+  D3DSAMP_DMAPOFFSET     =  13
+};
+
+enum D3DCULL {
+  D3DCULL_NONE           =   1,
+  D3DCULL_CW             =   2,
+  D3DCULL_CCW            =   3
+};
+
+enum D3DTEXTUREADDRESS {
+  D3DTADDRESS_WRAP       =   1,
+  D3DTADDRESS_CLAMP      =   3
+};
+
+#define D3DDMAPSAMPLER           256
+#define D3DVERTEXTEXTURESAMPLER0 (D3DDMAPSAMPLER + 1)
+#define D3DVERTEXTEXTURESAMPLER1 (D3DDMAPSAMPLER + 2)
+#define D3DVERTEXTEXTURESAMPLER2 (D3DDMAPSAMPLER + 3)
+#define D3DVERTEXTEXTURESAMPLER3 (D3DDMAPSAMPLER + 4)
+
+struct D3DVIEWPORT9 {
+  DWORD X;
+  DWORD Y;
+  DWORD Width;
+  DWORD Height;
+  float MinZ;
+  float MaxZ;
+};
+
+enum D3DFORMAT {
+  D3DFMT_A8R8G8B8          =  21,
+  D3DFMT_X8R8G8B8          =  22,
+  D3DFMT_D24S8             =  75,
+  D3DFMT_A16B16G16R16F     = 113
+};
+
+struct D3DSURFACE_DESC {
+  D3DFORMAT Format;
+  DWORD     Type;
+  DWORD     Usage;
+  DWORD     Pool;
+  DWORD     MultiSampleType;
+  DWORD     MultiSampleQuality;
+  UINT      Width;
+  UINT      Height;
+};
+
+enum D3DDECLTYPE {
+  D3DDECLTYPE_FLOAT2       =   1,
+  D3DDECLTYPE_FLOAT3       =   2,
+  D3DDECLTYPE_D3DCOLOR     =   4,
+  D3DDECLTYPE_UNUSED       =  17
+};
+
+enum D3DDECLUSAGE {
+  D3DDECLUSAGE_POSITION    =   0,
+  D3DDECLUSAGE_NORMAL      =   3,
+  D3DDECLUSAGE_TEXCOORD    =   5,
+  D3DDECLUSAGE_COLOR       =  10
+};
+
+struct D3DVERTEXELEMENT9 {
+  WORD Stream;
+  WORD Offset;
+  BYTE Type;
+  BYTE Method;
+  BYTE Usage;
+  BYTE UsageIndex;
+};
+
+#define MAXD3DDECLLENGTH 64
+#define D3DDECL_END()    { 0xFF, 0, D3DDECLTYPE_UNUSED, 0, 0, 0 }
+
+//
+// Only the methods host code calls, for tests to mock; the real interfaces
+//   are COM and have many more, in a different order
+//
+struct IDirect3DSurface9 {
+  virtual ULONG   Release        (void)                           = 0;
+  virtual HRESULT GetDesc        (D3DSURFACE_DESC* pDesc)         = 0;
+};
+
+struct IDirect3DVertexDeclaration9 {
+  virtual ULONG   Release        (void)                           = 0;
+  virtual HRESULT GetDeclaration (D3DVERTEXELEMENT9* pElement,
+                                  UINT*              pNumElements) = 0;
+};
+
+struct IDirect3DDevice9 {
+  virtual HRESULT GetRenderTarget      (DWORD                         RenderTargetIndex,
+                                        IDirect3DSurface9**           ppRenderTarget) = 0;
+  virtual HRESULT GetVertexDeclaration (IDirect3DVertexDeclaration9** ppDecl)         = 0;
+};
+
+#endif /* __TBF__HOST_D3D9_H__ */
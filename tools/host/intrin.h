@@ -0,0 +1,39 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+//
+// Stand-in for the MSVC intrinsics the host tests and tools reach.
+//
+#ifndef __TBF__HOST_INTRIN_H__
+#define __TBF__HOST_INTRIN_H__
+
+#include <cstdint>
+
+static inline uint64_t
+_rotl64 (uint64_t value, int shift)
+{
+  shift &= 63;
+
+  return shift == 0 ? value : (value << shift) | (value >> (64 - shift));
+}
+
+#endif /* __TBF__HOST_INTRIN_H__ */
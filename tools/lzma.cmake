@@ -0,0 +1,32 @@
+#
+# The subset of the bundled LZMA SDK that host tools and tests need, built
+#   single-threaded; include/ is the include root (sources use <lzma/...>).
+#
+get_filename_component (TBF_ROOT "${CMAKE_CURRENT_LIST_DIR}/.." ABSOLUTE)
+
+if (NOT TARGET tbf_lzma)
+  add_library (tbf_lzma STATIC
+    ${TBF_ROOT}/src/lzma/7zAlloc.c
+    ${TBF_ROOT}/src/lzma/7zArcIn.c
+    ${TBF_ROOT}/src/lzma/7zBuf.c
+    ${TBF_ROOT}/src/lzma/7zCrc.c
+    ${TBF_ROOT}/src/lzma/7zCrcOpt.c
+    ${TBF_ROOT}/src/lzma/7zDec.c
+    ${TBF_ROOT}/src/lzma/7zFile.c
+    ${TBF_ROOT}/src/lzma/7zStream.c
+    ${TBF_ROOT}/src/lzma/Alloc.c
+    ${TBF_ROOT}/src/lzma/Bcj2.c
+    ${TBF_ROOT}/src/lzma/Bra.c
+    ${TBF_ROOT}/src/lzma/Bra86.c
+    ${TBF_ROOT}/src/lzma/BraIA64.c
+    ${TBF_ROOT}/src/lzma/CpuArch.c
+    ${TBF_ROOT}/src/lzma/Delta.c
+    ${TBF_ROOT}/src/lzma/LzFind.c
+    ${TBF_ROOT}/src/lzma/Lzma2Dec.c
+    ${TBF_ROOT}/src/lzma/LzmaDec.c
+    ${TBF_ROOT}/src/lzma/LzmaEnc.c
+    ${TBF_ROOT}/src/lzma/LzmaLib.c )
+
+  target_compile_definitions (tbf_lzma PUBLIC _7ZIP_ST)
+  target_include_directories (tbf_lzma PUBLIC ${TBF_ROOT}/include)
+endif ()
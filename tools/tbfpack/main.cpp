@@ -0,0 +1,545 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+//
+// tbfpack - Texture pack converter
+//
+//   Builds TBFix_Res\inject\textures.tbfpack from the same sources, and with
+//     the same precedence, as the in-game "Build Texture Pack" button:
+//
+//       textures\blocking  >  textures\streaming  >  textures  >  *.tbfpack  >  *.7z
+//
+//   usage:  tbfpack build [-z] <inject dir> <out.tbfpack>
+//           tbfpack list   <pack>
+//           tbfpack verify <pack>
+//
+
+#include "pack_format.h"
+
+#include <lzma/7z.h>
+#include <lzma/7zAlloc.h>
+#include <lzma/7zCrc.h>
+#include <lzma/7zFile.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Matches tbf_load_method_t
+enum { Streaming = 0, Blocking = 1, DontCare = 2 };
+
+enum tbf_src_kind_t { Loose, Pack, Archive };
+
+struct tbf_src_s {
+  uint32_t       checksum;
+  uint32_t       method;
+  uint32_t       size;
+  tbf_src_kind_t kind;
+  size_t         container; // Index into containers, unused for Loose
+  uint32_t       fileno;
+  fs::path       path;      // Loose only
+};
+
+static std::string
+lower (std::string str)
+{
+  std::transform (str.begin (), str.end (), str.begin (), [](unsigned char c) { return (char)tolower (c); });
+  return str;
+}
+
+// <hex>.dds, anything else is not an injectable texture
+static bool
+parse_texture_name (const std::string& name, uint32_t* pChecksum)
+{
+  std::string lwr = lower (name);
+
+  if (lwr.size () <= 4 || lwr.compare (lwr.size () - 4, 4, ".dds") != 0)
+    return false;
+
+  return sscanf (lwr.c_str (), "%x", pChecksum) == 1;
+}
+
+static bool
+read_file (const fs::path& path, std::vector <uint8_t>& data)
+{
+  FILE* fIn = fopen (path.string ().c_str (), "rb");
+
+  if (fIn == nullptr)
+    return false;
+
+  std::error_code ec;
+  uint64_t        size = fs::file_size (path, ec);
+
+  data.resize (ec ? 0 : (size_t)size);
+
+  bool ok = (! ec) && fread (data.data (), 1, data.size (), fIn) == data.size ();
+
+  fclose (fIn);
+
+  return ok;
+}
+
+static std::vector <fs::path>
+sorted_files (const fs::path& dir, const char* ext)
+{
+  std::vector <fs::path> files;
+  std::error_code        ec;
+
+  for ( auto& it : fs::directory_iterator (dir, ec) )
+  {
+    if (it.is_regular_file () && (ext == nullptr || lower (it.path ().extension ().string ()) == ext))
+      files.push_back (it.path ());
+  }
+
+  // NTFS enumerates in case-insensitive name order, which is what the game sees
+  std::sort ( files.begin (), files.end (),
+                [](const fs::path& a, const fs::path& b) {
+                  return lower (a.filename ().string ()) < lower (b.filename ().string ());
+                } );
+
+  return files;
+}
+
+
+class TBF_ArchiveReader
+{
+public:
+   TBF_ArchiveReader (void) {
+    alloc_.Alloc     = SzAlloc;     alloc_.Free     = SzFree;
+    tmp_alloc_.Alloc = SzAllocTemp; tmp_alloc_.Free = SzFreeTemp;
+
+    FileInStream_CreateVTable (&stream_);
+    LookToRead_CreateVTable   (&look_, False);
+
+    look_.realStream = &stream_.s;
+  }
+  ~TBF_ArchiveReader (void) { close (); }
+
+  bool open (const fs::path& path)
+  {
+    close ();
+
+    if (InFile_Open (&stream_.file, path.string ().c_str ()))
+      return false;
+
+    file_open_ = true;
+
+    LookToRead_Init (&look_);
+    SzArEx_Init     (&arc_);
+
+    valid_ = SzArEx_Open (&arc_, &look_.s, &alloc_, &tmp_alloc_) == SZ_OK;
+
+    return valid_;
+  }
+
+  void close (void)
+  {
+    IAlloc_Free (&alloc_, out_);
+
+    out_       = nullptr;
+    out_len_   = 0;
+    block_idx_ = 0xFFFFFFFF;
+
+    if (valid_)
+      SzArEx_Free (&arc_, &alloc_);
+
+    if (file_open_)
+      File_Close (&stream_.file);
+
+    valid_     = false;
+    file_open_ = false;
+  }
+
+  uint32_t numFiles (void) const { return valid_ ? arc_.NumFiles : 0; }
+
+  // Lowercase, '/' separated; non-ASCII characters are dropped
+  bool getName (uint32_t idx, std::string& name)
+  {
+    if (SzArEx_IsDir (&arc_, idx))
+      return false;
+
+    std::vector <UInt16> wide (SzArEx_GetFileNameUtf16 (&arc_, idx, nullptr));
+
+    SzArEx_GetFileNameUtf16 (&arc_, idx, wide.data ());
+
+    name.clear ();
+
+    for ( auto ch : wide )
+    {
+      if (ch != 0 && ch < 0x80)
+        name.push_back ((char)tolower (ch));
+    }
+
+    return true;
+  }
+
+  uint32_t getSize (uint32_t idx) const { return (uint32_t)SzArEx_GetFileSize (&arc_, idx); }
+
+  // Solid blocks stay decoded between calls, so extract in file order
+  const uint8_t* extract (uint32_t idx, size_t* pSize)
+  {
+    size_t offset = 0;
+
+    if ( SzArEx_Extract ( &arc_,   &look_.s,   idx,
+                          &block_idx_, &out_,  &out_len_,
+                          &offset, pSize,
+                          &alloc_, &tmp_alloc_ ) != SZ_OK )
+      return nullptr;
+
+    return out_ + offset;
+  }
+
+private:
+  ISzAlloc      alloc_;
+  ISzAlloc      tmp_alloc_;
+  CFileInStream stream_;
+  CLookToRead   look_;
+  CSzArEx       arc_;
+
+  bool          file_open_ = false;
+  bool          valid_     = false;
+
+  uint32_t      block_idx_ = 0xFFFFFFFF;
+  Byte*         out_       = nullptr;
+  size_t        out_len_   = 0;
+};
+
+
+static int
+TBF_BuildPack (const fs::path& inject_dir, const fs::path& out_file, bool compress)
+{
+  std::vector <tbf_src_s>      srcs;
+  std::vector <fs::path>       containers;
+  std::unordered_set <uint32_t> seen;
+
+  auto AddLoose = [&](const fs::path& dir, uint32_t method)
+  {
+    for ( auto& file : sorted_files (dir, ".dds") )
+    {
+      uint32_t checksum;
+
+      if (! parse_texture_name (file.filename ().string (), &checksum))
+        continue;
+
+      if (! seen.insert (checksum).second)
+        continue;
+
+      std::error_code ec;
+
+      srcs.push_back ( tbf_src_s { checksum, method, (uint32_t)fs::file_size (file, ec),
+                                   Loose, 0, 0, file } );
+    }
+  };
+
+  AddLoose (inject_dir / "textures" / "blocking",  Blocking);
+  AddLoose (inject_dir / "textures" / "streaming", Streaming);
+  AddLoose (inject_dir / "textures",               DontCare);
+
+  std::error_code ec;
+
+  for ( auto& file : sorted_files (inject_dir, ".tbfpack") )
+  {
+    if (fs::equivalent (file, out_file, ec))
+      continue;
+
+    std::vector <uint8_t> data;
+    TBF_TexturePackView   view;
+
+    if (! (read_file (file, data) && view.attach (data.data (), data.size ())))
+    {
+      fprintf (stderr, "Cannot open texture pack: %s\n", file.string ().c_str ());
+      continue;
+    }
+
+    for (uint32_t i = 0; i < view.numEntries (); i++)
+    {
+      const tbf_pack_entry_s* entry = view.getEntry (i);
+
+      if (seen.insert (entry->checksum).second)
+        srcs.push_back ( tbf_src_s { entry->checksum, entry->method, entry->size,
+                                     Pack, containers.size (), i, fs::path () } );
+    }
+
+    containers.push_back (file);
+  }
+
+  for ( auto& file : sorted_files (inject_dir, ".7z") )
+  {
+    TBF_ArchiveReader arc;
+
+    if (! arc.open (file))
+    {
+      fprintf (stderr, "Cannot open archive: %s\n", file.string ().c_str ());
+      continue;
+    }
+
+    for (uint32_t i = 0; i < arc.numFiles (); i++)
+    {
+      std::string name;
+
+      if (! arc.getName (i, name))
+        continue;
+
+      uint32_t checksum;
+
+      if (! parse_texture_name (name.substr (name.find_last_of ('/') + 1), &checksum))
+        continue;
+
+      uint32_t method =
+        name.find ("streaming") != std::string::npos ? Streaming :
+        name.find ("blocking")  != std::string::npos ? Blocking  : DontCare;
+
+      if (seen.insert (checksum).second)
+        srcs.push_back ( tbf_src_s { checksum, method, arc.getSize (i),
+                                     Archive, containers.size (), i, fs::path () } );
+    }
+
+    containers.push_back (file);
+  }
+
+  if (srcs.empty ())
+  {
+    fprintf (stderr, "No injectable textures in %s\n", inject_dir.string ().c_str ());
+    return 1;
+  }
+
+  // Same order as the game: loose files first, then each container front to back
+  std::stable_sort ( srcs.begin (), srcs.end (),
+                       [](const tbf_src_s& a, const tbf_src_s& b) {
+                         if (a.kind == Loose || b.kind == Loose)
+                           return a.kind == Loose && b.kind != Loose;
+                         return a.container != b.container ? a.container < b.container :
+                                                             a.fileno    < b.fileno;
+                       } );
+
+  fs::path temp_file (out_file);
+           temp_file += ".tmp";
+
+  TBF_TexturePackWriter writer;
+
+  if (! writer.begin (fopen (temp_file.string ().c_str (), "wb"), (uint32_t)srcs.size ()))
+  {
+    fprintf (stderr, "Cannot create %s\n", temp_file.string ().c_str ());
+    return 1;
+  }
+
+  std::vector <uint8_t>  data;
+  std::vector <uint8_t>  pack_data;
+  TBF_TexturePackView    pack;
+  size_t                 open_pack = SIZE_MAX;
+  TBF_ArchiveReader      arc;
+  size_t                 open_arc  = SIZE_MAX;
+
+  uint32_t packed = 0;
+  uint64_t bytes  = 0ULL;
+
+  for ( auto& src : srcs )
+  {
+    const void* pData = nullptr;
+    size_t      size  = 0;
+
+    if (src.kind == Loose)
+    {
+      if (read_file (src.path, data))
+      {
+        pData = data.data ();
+        size  = data.size ();
+      }
+    }
+
+    else if (src.kind == Pack)
+    {
+      if (open_pack != src.container)
+      {
+        open_pack = src.container;
+
+        if (! (read_file (containers [open_pack], pack_data) && pack.attach (pack_data.data (), pack_data.size ())))
+          pack.detach ();
+      }
+
+      const tbf_pack_entry_s* entry = pack.getEntry (src.fileno);
+
+      if (entry != nullptr)
+      {
+        data.resize (entry->size);
+
+        if (pack.extract (entry, data.data (), data.size ()))
+        {
+          pData = data.data ();
+          size  = data.size ();
+        }
+      }
+    }
+
+    else
+    {
+      if (open_arc != src.container)
+      {
+        open_arc = src.container;
+        arc.open (containers [open_arc]);
+      }
+
+      pData = arc.extract (src.fileno, &size);
+    }
+
+    if ( pData != nullptr &&
+         writer.add (src.checksum, src.method, pData, (uint32_t)size, compress) )
+    {
+      ++packed;
+      bytes += size;
+    }
+
+    else
+      fprintf (stderr, "Could not pack texture %08x\n", src.checksum);
+  }
+
+  arc.close ();
+
+  if (! writer.finish ())
+  {
+    fs::remove (temp_file, ec);
+
+    fprintf (stderr, "Cannot write %s\n", temp_file.string ().c_str ());
+    return 1;
+  }
+
+  fs::rename (temp_file, out_file, ec);
+
+  if (ec)
+  {
+    fprintf (stderr, "Cannot replace %s: %s\n", out_file.string ().c_str (), ec.message ().c_str ());
+    return 1;
+  }
+
+  printf ( "%s: %u textures (%3.1f MiB)\n", out_file.string ().c_str (),
+             packed, (double)bytes / (1024.0 * 1024.0) );
+
+  return packed == srcs.size () ? 0 : 2;
+}
+
+static int
+TBF_ListPack (const fs::path& file, bool verify)
+{
+  std::vector <uint8_t> data;
+  TBF_TexturePackView   view;
+
+  if (! read_file (file, data))
+  {
+    fprintf (stderr, "Cannot read %s\n", file.string ().c_str ());
+    return 1;
+  }
+
+  if (! view.attach (data.data (), data.size ()))
+  {
+    fprintf (stderr, "%s: not a valid texture pack\n", file.string ().c_str ());
+    return 1;
+  }
+
+  static const char* methods [] = { "streaming", "blocking", "dontcare" };
+
+  std::vector <uint8_t> out;
+  uint32_t              bad = 0;
+
+  for (uint32_t i = 0; i < view.numEntries (); i++)
+  {
+    const tbf_pack_entry_s* entry = view.getEntry (i);
+
+    if (verify)
+    {
+      out.resize (entry->size);
+
+      if (! view.extract (entry, out.data (), out.size ()))
+      {
+        printf ("%08x  ** cannot extract\n", entry->checksum);
+        ++bad;
+      }
+    }
+
+    else
+    {
+      printf ( "%08x  %-9s  %-6s  %10u  %10u  @%llu\n",
+                 entry->checksum,
+                   entry->method < 3 ? methods [entry->method] : "?",
+                     entry->compression == TBF_PACK_LZMA ? "lzma" : "stored",
+                       entry->size, entry->stored_size,
+                         (unsigned long long)entry->offset );
+    }
+  }
+
+  if (verify)
+    printf ("%s: %u entries, %u bad\n", file.string ().c_str (), view.numEntries (), bad);
+
+  return bad == 0 ? 0 : 2;
+}
+
+static int
+usage (void)
+{
+  fprintf ( stderr,
+              "usage:  tbfpack build [-z] <inject dir> <out.tbfpack>\n"
+              "        tbfpack list   <pack>\n"
+              "        tbfpack verify <pack>\n" );
+  return 1;
+}
+
+int
+main (int argc, char** argv)
+{
+  if (argc < 3)
+    return usage ();
+
+  CrcGenerateTable ();
+
+  std::string cmd (argv [1]);
+
+  if (cmd == "build")
+  {
+    bool compress = false;
+    int  arg      = 2;
+
+    if (strcmp (argv [arg], "-z") == 0)
+    {
+      compress = true;
+      ++arg;
+    }
+
+    if (argc - arg != 2)
+      return usage ();
+
+    return TBF_BuildPack (argv [arg], argv [arg + 1], compress);
+  }
+
+  if (cmd == "list"   && argc == 3) return TBF_ListPack (argv [2], false);
+  if (cmd == "verify" && argc == 3) return TBF_ListPack (argv [2], true);
+
+  return usage ();
+}
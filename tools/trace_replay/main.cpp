@@ -0,0 +1,210 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+//
+// trace_replay - Replays a call trace (Render.TraceFrames) outside the game
+//
+//   Feeds the recorded calls through the draw decision table, the c240 patch
+//     table, the state cache and the per-frame sets, against a mock device,
+//       and reports what each would have done next to what the hooks did
+//         live. With -n, the replay is repeated and timed, so changes to
+//           those tables can be benchmarked without the game.
+//
+//   usage:  trace_replay [-n runs] [-w width -h height]
+//                        [-s shadow_rescale] [-e env_shadow_rescale]
+//                        [-p postproc_ratio] <trace.bin>
+//
+
+#include "replay.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const char* op_names [] = {
+  "EndFrame",
+  "SetVertexShader",
+  "SetPixelShader",
+  "SetTexture",
+  "SetRenderTarget",
+  "SetStreamSource",
+  "SetVertexShaderConstantF",
+  "SetPixelShaderConstantF",
+  "DrawPrimitive",
+  "DrawIndexedPrimitive",
+  "DrawPrimitiveUP",
+  "DrawIndexedPrimitiveUP",
+  "SetRenderState",
+  "SetSamplerState",
+  "SetViewport",
+  "SetScissorRect"
+};
+
+static_assert ( sizeof (op_names) / sizeof (op_names [0]) == (size_t)tbf_trace_op::Count,
+                "op_names is out of date" );
+
+static int
+usage (void)
+{
+  fprintf ( stderr,
+              "usage: trace_replay [-n runs] [-w width -h height]\n"
+              "                    [-s shadow_rescale] [-e env_shadow_rescale]\n"
+              "                    [-p postproc_ratio] <trace.bin>\n" );
+  return 2;
+}
+
+static double
+percent (uint64_t part, uint64_t whole)
+{
+  return whole != 0 ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+int
+main (int argc, char** argv)
+{
+  tbf_replay_config_s config;
+  int                 runs = 0;
+  const char*         path = nullptr;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const bool value = (i + 1 < argc);
+
+         if (! strcmp (argv [i], "-n") && value) runs                              = atoi (argv [++i]);
+    else if (! strcmp (argv [i], "-w") && value) config.width                      = (uint32_t)atoi (argv [++i]);
+    else if (! strcmp (argv [i], "-h") && value) config.height                     = (uint32_t)atoi (argv [++i]);
+    else if (! strcmp (argv [i], "-s") && value) config.quality.shadow_rescale     = atoi (argv [++i]);
+    else if (! strcmp (argv [i], "-e") && value) config.quality.env_shadow_rescale = atoi (argv [++i]);
+    else if (! strcmp (argv [i], "-p") && value) config.quality.postproc_ratio     = (float)atof (argv [++i]);
+    else if (argv [i][0] != '-' && path == nullptr)
+      path = argv [i];
+    else
+      return usage ();
+  }
+
+  if (path == nullptr)
+    return usage ();
+
+  TBF_TraceReplay replay;
+
+  if (! replay.load (path))
+  {
+    fprintf (stderr, "%s: not a TBFT call trace (version 1 or 2)\n", path);
+    return 1;
+  }
+
+  const tbf_trace_header_s& header = replay.header ();
+
+  if (config.width == 0 || config.height == 0)
+  {
+    config.width  = 1920;
+    config.height = 1080;
+
+    replay.largestTarget (&config.width, &config.height);
+  }
+
+  tbf_replay_stats_s stats;
+
+  replay.run (config, stats);
+
+  const double   freq  = header.frequency > 0 ? (double)header.frequency : 1.0;
+  const uint64_t span  = replay.records ().empty () ? 0 :
+                           replay.records ().back ().time - replay.records ().front ().time;
+
+  printf ( "%s: version %u, %zu calls, %u frames over %.2f s, %ux%u\n\n",
+             path, header.version, replay.records ().size (), stats.frames,
+               (double)span / freq, config.width, config.height );
+
+  printf ( "%-26s %10s %10s %10s %10s %12s\n",
+             "call", "count", "skipped", "modified", "to driver", "live us/call" );
+
+  for (int op = 0; op < (int)tbf_trace_op::Count; op++)
+  {
+    const tbf_replay_op_stats_s& s = stats.ops [op];
+
+    if (s.count == 0)
+      continue;
+
+    printf ( "%-26s %10llu %10llu %10llu %10llu %12.3f\n",
+               op_names [op],
+               (unsigned long long)s.count,
+               (unsigned long long)s.live_skipped,
+               (unsigned long long)s.live_modified,
+               (unsigned long long)stats.device.calls [op],
+               1000000.0 * (double)s.live_cost / freq / (double)s.count );
+  }
+
+  if (stats.unknown_ops != 0)
+    printf ("%-26s %10llu\n", "(unknown)", (unsigned long long)stats.unknown_ops);
+
+  const uint64_t lookups = stats.decision_hits + stats.decision_misses;
+  const uint32_t frames  = stats.frames != 0 ? stats.frames : 1;
+
+  printf ( "\ndraw decisions:   %llu lookups, %.2f%% hits, %llu mismatches; "
+             "%llu skipped, %llu clamped, %llu sharpened\n",
+             (unsigned long long)lookups, percent (stats.decision_hits, lookups),
+             (unsigned long long)stats.decision_mismatches,
+             (unsigned long long)stats.draws_skipped,
+             (unsigned long long)stats.draws_clamped,
+             (unsigned long long)stats.draws_sharpened );
+
+  printf ( "c240 patches:     %llu uploads, %llu patched, %.2f%% agree with the capture\n",
+             (unsigned long long)stats.c240_uploads,
+             (unsigned long long)stats.c240_patched,
+             percent (stats.c240_agree, stats.c240_uploads) );
+
+  printf ( "state cache:      %llu calls, %.2f%% filtered, %.2f%% agree with the capture\n",
+             (unsigned long long)stats.state_calls,
+             percent (stats.state_filtered, stats.state_calls),
+             percent (stats.state_agree,    stats.state_calls) );
+
+  printf ( "per frame:        %.1f vertex shaders, %.1f pixel shaders, %.1f textures\n",
+             (double)stats.unique_vs  / frames,
+             (double)stats.unique_ps  / frames,
+             (double)stats.unique_tex / frames );
+
+  if (runs > 0)
+  {
+    auto start = std::chrono::steady_clock::now ();
+
+    for (int run = 0; run < runs; run++)
+    {
+      tbf_replay_stats_s discard;
+      replay.run (config, discard);
+    }
+
+    const double ns =
+      (double)std::chrono::duration_cast <std::chrono::nanoseconds> (
+        std::chrono::steady_clock::now () - start
+      ).count ();
+
+    printf ( "\nreplay:           %d runs, %.1f ns/call, %.3f ms/frame\n",
+               runs,
+               ns / runs / (replay.records ().empty () ? 1 : replay.records ().size ()),
+               ns / runs / frames / 1000000.0 );
+  }
+
+  return stats.decision_mismatches != 0 ? 1 : 0;
+}
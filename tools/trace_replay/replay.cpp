@@ -0,0 +1,314 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "replay.h"
+
+#include <cstdio>
+#include <cstring>
+
+bool
+TBF_TraceReplay::load (const char* szFileName)
+{
+  records_.clear ();
+
+  FILE* fTrace = fopen (szFileName, "rb");
+
+  if (fTrace == nullptr)
+    return false;
+
+  bool ok =
+    fread (&header_, sizeof (tbf_trace_header_s), 1, fTrace) == 1 &&
+    header_.magic == TBF_TRACE_MAGIC;
+
+  const bool v1 = ok && header_.version == 1;
+
+  ok = ok && ( (v1 && header_.record_size == sizeof (tbf_trace_record_v1_s)) ||
+               (header_.version     == TBF_TRACE_VERSION &&
+                header_.record_size == sizeof (tbf_trace_record_s)) );
+
+  // Up to the last whole record; a capture cut short by the game exiting
+  //   can end on a partial one
+  while (ok)
+  {
+    tbf_trace_record_s rec;
+
+    if (v1)
+    {
+      tbf_trace_record_v1_s old;
+
+      if (fread (&old, sizeof (tbf_trace_record_v1_s), 1, fTrace) != 1)
+        break;
+
+      rec.op    = old.op;
+      rec.flags = old.flags;
+      rec.slot  = old.slot;
+      rec.time  = old.time;
+      rec.cost  = old.cost;
+
+      memcpy (rec.args, old.args, sizeof (rec.args));
+    }
+
+    else if (fread (&rec, sizeof (tbf_trace_record_s), 1, fTrace) != 1)
+      break;
+
+    records_.push_back (rec);
+  }
+
+  ok = ok && ferror (fTrace) == 0;
+
+  fclose (fTrace);
+
+  return ok;
+}
+
+bool
+TBF_TraceReplay::largestTarget (uint32_t* pWidth, uint32_t* pHeight) const
+{
+  uint64_t largest = 0;
+
+  for ( auto& rec : records_ )
+  {
+    if ( rec.op   == (uint8_t)tbf_trace_op::SetRenderTarget && rec.slot == 0 &&
+         (uint64_t)rec.args [0] * rec.args [1] > largest )
+    {
+      largest  = (uint64_t)rec.args [0] * rec.args [1];
+      *pWidth  = rec.args [0];
+      *pHeight = rec.args [1];
+    }
+  }
+
+  return largest != 0;
+}
+
+static bool
+TBF_SameDecision (const tbf_draw_decision_s& a, const tbf_draw_decision_s& b)
+{
+  return a.tracked_vs     == b.tracked_vs     && a.tracked_ps == b.tracked_ps &&
+         a.clamp          == b.clamp          && a.sharpen    == b.sharpen    &&
+         a.skip           == b.skip           &&
+         a.aspect_trigger == b.aspect_trigger && a.aspect_hud == b.aspect_hud;
+}
+
+void
+TBF_TraceReplay::run (const tbf_replay_config_s& config, tbf_replay_stats_s& stats) const
+{
+  TBF_StateCache         state_cache;
+  TBF_DrawDecisionTable  decisions;
+  TBF_ConstantPatchTable patches;
+  TBF_FrameSet           frame_vs, frame_ps, frame_tex;
+
+  uint32_t width  = config.width,
+           height = config.height;
+
+  if (width == 0 || height == 0)
+  {
+    width  = 1920;
+    height = 1080;
+
+    largestTarget (&width, &height);
+  }
+
+  uint32_t vs = 0x00, ps = 0x00, tex0 = 0x00;
+
+  for ( auto& rec : records_ )
+  {
+    if (rec.op >= (uint8_t)tbf_trace_op::Count)
+    {
+      ++stats.unknown_ops;
+      continue;
+    }
+
+    const tbf_trace_op op = (tbf_trace_op)rec.op;
+
+    tbf_replay_op_stats_s& op_stats = stats.ops [rec.op];
+
+    ++op_stats.count;
+
+    op_stats.live_cost += rec.cost;
+
+    if (rec.flags & TBF_TRACE_SKIPPED)  ++op_stats.live_skipped;
+    if (rec.flags & TBF_TRACE_MODIFIED) ++op_stats.live_modified;
+
+    bool forward  = true;
+    bool filtered = false;
+
+    switch (op)
+    {
+      case tbf_trace_op::EndFrame:
+        // What D3D9EndFrame_Pre does with these
+        state_cache.endFrame   ();
+        state_cache.invalidate ();
+
+        stats.unique_vs  += frame_vs.size  ();
+        stats.unique_ps  += frame_ps.size  ();
+        stats.unique_tex += frame_tex.size ();
+
+        frame_vs.clear  ();
+        frame_ps.clear  ();
+        frame_tex.clear ();
+
+        ++stats.frames;
+        break;
+
+      case tbf_trace_op::SetVertexShader:
+        vs = rec.args [0];
+
+        if (vs != 0x00)
+          frame_vs.insert (vs);
+        break;
+
+      case tbf_trace_op::SetPixelShader:
+        ps = rec.args [0];
+
+        if (ps != 0x00)
+          frame_ps.insert (ps);
+        break;
+
+      case tbf_trace_op::SetTexture:
+        if (rec.slot == 0)
+          tex0 = rec.args [0];
+
+        if (rec.args [0] != 0x00)
+          frame_tex.insert (rec.args [0]);
+        break;
+
+      case tbf_trace_op::SetRenderTarget:
+        if (rec.slot == 0)
+          state_cache.targetChanged ();
+        break;
+
+      case tbf_trace_op::SetVertexShaderConstantF:
+        if (rec.slot == 240 && rec.args [0] == 1)
+        {
+          if (! patches.current (width, height, config.quality))
+            patches.build (width, height, config.quality);
+
+          float c240 [2];
+          memcpy (c240, &rec.args [1], sizeof (c240));
+
+          const bool patched = patches.find (c240) != nullptr;
+
+          ++stats.c240_uploads;
+
+          if (patched)
+            ++stats.c240_patched;
+
+          if (patched == ((rec.flags & TBF_TRACE_MODIFIED) != 0))
+            ++stats.c240_agree;
+        }
+        break;
+
+      case tbf_trace_op::DrawPrimitive:
+      case tbf_trace_op::DrawIndexedPrimitive:
+      case tbf_trace_op::DrawPrimitiveUP:
+      case tbf_trace_op::DrawIndexedPrimitiveUP:
+      {
+        // TBF_ShouldSkipRenderPass
+        const tbf_draw_decision_s* decision =
+          decisions.find (vs, ps, tex0);
+
+        if (decision == nullptr)
+        {
+          ++stats.decision_misses;
+
+          decision =
+            decisions.insert (vs, ps, tex0, TBF_DecideDraw (config.rules, vs, ps, tex0));
+        }
+
+        else
+        {
+          ++stats.decision_hits;
+
+          if (! TBF_SameDecision (*decision, TBF_DecideDraw (config.rules, vs, ps, tex0)))
+            ++stats.decision_mismatches;
+        }
+
+        if (decision->clamp)   ++stats.draws_clamped;
+        if (decision->sharpen) ++stats.draws_sharpened;
+
+        if (decision->skip)
+        {
+          ++stats.draws_skipped;
+          forward = false;
+        }
+      } break;
+
+      //
+      // Every call that went through the state cache is in the trace, the
+      //   hooks' own sampler writes for clamped / sharpened draws included
+      //
+      case tbf_trace_op::SetRenderState:
+        filtered = ! state_cache.renderState ((D3DRENDERSTATETYPE)rec.slot, rec.args [0]);
+        break;
+
+      case tbf_trace_op::SetSamplerState:
+        filtered = ! state_cache.samplerState (rec.slot, (D3DSAMPLERSTATETYPE)rec.args [0], rec.args [1]);
+        break;
+
+      case tbf_trace_op::SetViewport:
+      {
+        D3DVIEWPORT9 vp = { rec.args [0] >> 16, rec.args [0] & 0xFFFF,
+                            rec.args [1],       rec.args [2],
+                            0.0f,               1.0f };
+
+        filtered = ! state_cache.viewport (&vp);
+      } break;
+
+      case tbf_trace_op::SetScissorRect:
+      {
+        RECT rect = { (LONG)(rec.args [0] >> 16), (LONG)(rec.args [0] & 0xFFFF),
+                      (LONG) rec.args [1],        (LONG) rec.args [2] };
+
+        filtered = ! state_cache.scissorRect (&rect);
+      } break;
+
+      default:
+        break;
+    }
+
+    switch (op)
+    {
+      case tbf_trace_op::SetRenderState:
+      case tbf_trace_op::SetSamplerState:
+      case tbf_trace_op::SetViewport:
+      case tbf_trace_op::SetScissorRect:
+        ++stats.state_calls;
+
+        if (filtered)
+          ++stats.state_filtered;
+
+        if (filtered == ((rec.flags & TBF_TRACE_SKIPPED) != 0))
+          ++stats.state_agree;
+
+        forward = ! filtered;
+        break;
+
+      default:
+        break;
+    }
+
+    if (forward)
+      stats.device.call (op);
+  }
+}
@@ -0,0 +1,115 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#ifndef __TBF__TRACE_REPLAY_H__
+#define __TBF__TRACE_REPLAY_H__
+
+#include <cstdint>
+#include <vector>
+
+#include "trace_format.h"
+#include "draw_table.h"
+#include "constant_patch.h"
+#include "state_cache.h"
+#include "frame_set.h"
+
+//
+// Stands in for the driver: counts what the hooks would have let through
+//
+struct tbf_mock_device_s {
+  uint64_t calls [(int)tbf_trace_op::Count] = { };
+
+  void call (tbf_trace_op op) { ++calls [(int)op]; }
+};
+
+//
+// What the hooks are configured with during a replay; should match the
+//   capture for the live / replay comparisons to mean anything
+//
+struct tbf_replay_config_s {
+  uint32_t         width  = 0; // 0 = largest render target 0 in the trace
+  uint32_t         height = 0;
+  tbf_quality_s    quality;
+  tbf_draw_rules_s rules;
+};
+
+struct tbf_replay_op_stats_s {
+  uint64_t count         = 0;
+  uint64_t live_skipped  = 0; // TBF_TRACE_SKIPPED in the trace
+  uint64_t live_modified = 0; // TBF_TRACE_MODIFIED in the trace
+  uint64_t live_cost     = 0; // Ticks, detour and original call
+};
+
+struct tbf_replay_stats_s {
+  tbf_replay_op_stats_s ops [(int)tbf_trace_op::Count];
+  uint64_t              unknown_ops         = 0;
+  uint32_t              frames              = 0;
+
+  // TBF_DrawDecisionTable
+  uint64_t              decision_hits       = 0;
+  uint64_t              decision_misses     = 0;
+  uint64_t              decision_mismatches = 0; // Cached != decided afresh
+  uint64_t              draws_skipped       = 0;
+  uint64_t              draws_clamped       = 0;
+  uint64_t              draws_sharpened     = 0;
+
+  // TBF_ConstantPatchTable
+  uint64_t              c240_uploads        = 0;
+  uint64_t              c240_patched        = 0;
+  uint64_t              c240_agree          = 0; // Patched here == modified live
+
+  // TBF_StateCache
+  uint64_t              state_calls         = 0;
+  uint64_t              state_filtered      = 0;
+  uint64_t              state_agree         = 0; // Filtered here == skipped live
+
+  // TBF_FrameSet, summed over frames
+  uint64_t              unique_vs           = 0;
+  uint64_t              unique_ps           = 0;
+  uint64_t              unique_tex          = 0;
+
+  tbf_mock_device_s     device;
+};
+
+//
+// Reads a TBFT trace (version 1 or 2) and feeds it through the same tables
+//   the render hooks use, against a mock device.
+//
+class TBF_TraceReplay
+{
+public:
+  bool load (const char* szFileName);
+
+  const tbf_trace_header_s&               header  (void) const { return header_;  }
+  const std::vector <tbf_trace_record_s>& records (void) const { return records_; }
+
+  // Largest render target 0 bound during the capture, normally the back buffer
+  bool largestTarget (uint32_t* pWidth, uint32_t* pHeight) const;
+
+  void run (const tbf_replay_config_s& config, tbf_replay_stats_s& stats) const;
+
+private:
+  tbf_trace_header_s               header_ = { };
+  std::vector <tbf_trace_record_s> records_;
+};
+
+#endif /* __TBF__TRACE_REPLAY_H__ */
@@ -0,0 +1,184 @@
+/**
+ * This file is part of Tales of Berseria "Fix".
+ *
+ * Tales of Berseria "Fix" is free software : you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License
+ * as published by The Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * Tales of Berseria "Fix" is distributed in the hope that it will be
+ * useful,
+ *
+ * But WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tales of Berseria "Fix".
+ *
+ *   If not, see <http://www.gnu.org/licenses/>.
+ *
+**/
+
+#define _CRT_SECURE_NO_WARNINGS
+
+//
+// usage_model - Offline trainer / evaluator for predictive prefetching
+//
+//   The game appends every session's first uses of injectable textures to
+//     TBFix_Res\texture_usage.trace (Texture.System/PredictivePrefetch).
+//
+//   usage:  usage_model train <trace> <out.model>
+//           usage_model eval  <trace> [-m <start.model>] [-w <min weight> ...]
+//
+//     train  learns from every session in order, as the game would have,
+//              and writes a model the game can load.
+//
+//     eval   replays each session against the model trained on the ones
+//              before it, then learns from it; prints precision, recall and
+//                lead time for each prediction threshold.
+//
+
+#include "usage_model.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static std::wstring
+widen (const char* str)
+{
+  return std::wstring (str, str + strlen (str));
+}
+
+static int
+usage (void)
+{
+  fprintf ( stderr,
+              "usage:  usage_model train <trace> <out.model>\n"
+              "        usage_model eval  <trace> [-m <start.model>] [-w <min weight> ...]\n" );
+  return 2;
+}
+
+static bool
+load_trace (const char* szTrace, std::vector <tbf_usage_session_t>& sessions)
+{
+  if (! TBF_TextureUsageModel::loadSessions (widen (szTrace).c_str (), sessions))
+  {
+    fprintf (stderr, "%s: not a usage trace\n", szTrace);
+    return false;
+  }
+
+  size_t uses = 0;
+
+  for ( auto& session : sessions )
+    uses += session.size ();
+
+  printf ("%s: %zu sessions, %zu first uses\n", szTrace, sessions.size (), uses);
+
+  return true;
+}
+
+static int
+train (int argc, char** argv)
+{
+  if (argc != 4)
+    return usage ();
+
+  std::vector <tbf_usage_session_t> sessions;
+
+  if (! load_trace (argv [2], sessions))
+    return 1;
+
+  TBF_TextureUsageModel model;
+
+  for ( auto& session : sessions )
+    model.trainSession (session);
+
+  if (! model.save (widen (argv [3]).c_str ()))
+  {
+    fprintf (stderr, "%s: could not write the model\n", argv [3]);
+    return 1;
+  }
+
+  printf ("%s: %zu textures with successors\n", argv [3], model.numKeys ());
+
+  return 0;
+}
+
+static int
+eval (int argc, char** argv)
+{
+  if (argc < 3)
+    return usage ();
+
+  std::vector <uint16_t> weights;
+  TBF_TextureUsageModel  model;
+
+  for (int i = 3; i < argc; i++)
+  {
+    if (! strcmp (argv [i], "-m") && i + 1 < argc)
+    {
+      if (! model.load (widen (argv [++i]).c_str ()))
+      {
+        fprintf (stderr, "%s: not a usage model\n", argv [i]);
+        return 1;
+      }
+    }
+
+    else if (! strcmp (argv [i], "-w") && i + 1 < argc)
+      weights.push_back ((uint16_t)atoi (argv [++i]));
+
+    else
+      return usage ();
+  }
+
+  if (weights.empty ())
+    weights = { TBF_TextureUsageModel::WEIGHT_HIT,
+                TBF_TextureUsageModel::WEIGHT_PREDICT,
+                8, 12, 16 };
+
+  std::vector <tbf_usage_session_t> sessions;
+
+  if (! load_trace (argv [2], sessions))
+    return 1;
+
+  std::vector <tbf_usage_eval_s> evals (weights.size ());
+
+  for ( auto& session : sessions )
+  {
+    for (size_t i = 0; i < weights.size (); i++)
+      model.evaluate (session, weights [i], evals [i]);
+
+    model.trainSession (session);
+  }
+
+  printf ("  min weight  predicted     covered  precision  recall  mean lead (frames)\n");
+
+  for (size_t i = 0; i < weights.size (); i++)
+  {
+    const tbf_usage_eval_s& e = evals [i];
+
+    printf ( "  %10u  %9llu  %10llu  %8.1f%%  %5.1f%%  %10.1f%s\n",
+               weights [i],
+                 (unsigned long long)e.predicted, (unsigned long long)e.covered,
+                   e.predicted  ? 100.0 * e.covered / e.predicted  : 0.0,
+                   e.first_uses ? 100.0 * e.covered / e.first_uses : 0.0,
+                   e.covered    ? (double)e.lead_frames / e.covered : 0.0,
+                     weights [i] == TBF_TextureUsageModel::WEIGHT_PREDICT ?
+                       "  (game)" : "" );
+  }
+
+  return 0;
+}
+
+int
+main (int argc, char** argv)
+{
+  if (argc >= 2 && ! strcmp (argv [1], "train")) return train (argc, argv);
+  if (argc >= 2 && ! strcmp (argv [1], "eval"))  return eval  (argc, argv);
+
+  return usage ();
+}